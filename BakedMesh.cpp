@@ -0,0 +1,526 @@
+#include "BakedMesh.h"
+#include "Hash.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjImporter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace DirectX;
+
+// The file layout depends on these never changing
+static_assert(sizeof(BakedMeshHeader) == 72, "BakedMeshHeader layout changed");
+static_assert(sizeof(BakedSection) == 32, "BakedSection layout changed");
+static_assert(sizeof(BakedSubmesh) == 40, "BakedSubmesh layout changed");
+static_assert(sizeof(BakedLod) == 16, "BakedLod layout changed");
+static_assert(sizeof(Meshlet) == 56, "Meshlet layout changed");
+
+static unsigned long long AlignUp(unsigned long long value, unsigned long long alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// --------------------------------------------------------
+// Size and last modification time of a file, used to tell
+// whether a bake is older than the file it came from
+// --------------------------------------------------------
+bool GetSourceFileInfo(const std::string& path, unsigned long long& size, long long& modifiedTime)
+{
+#ifdef _MSC_VER
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0)
+		return false;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+#endif
+
+	size = (unsigned long long)info.st_size;
+	modifiedTime = (long long)info.st_mtime;
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Constructor - Starts with no sections and empty bounds
+// --------------------------------------------------------
+BakedMeshWriter::BakedMeshWriter()
+{
+	memset(&header, 0, sizeof(header));
+	header.magic = BakedMeshMagic;
+	header.version = BakedMeshVersion;
+	header.headerSize = sizeof(BakedMeshHeader);
+}
+
+void BakedMeshWriter::SetBounds(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	header.boundsMin = boundsMin;
+	header.boundsMax = boundsMax;
+}
+
+void BakedMeshWriter::SetSource(unsigned long long sourceSize, long long sourceTime)
+{
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+}
+
+// --------------------------------------------------------
+// Adds a section to write
+//
+// type         - BakedSectionType (or a newer type)
+// elementSize  - Bytes per element
+// elementCount - Number of elements
+// data         - The elements (not copied)
+// --------------------------------------------------------
+void BakedMeshWriter::AddSection(unsigned int type, unsigned int elementSize, unsigned int elementCount, const void* data)
+{
+	PendingSection section;
+	section.type = type;
+	section.elementSize = elementSize;
+	section.elementCount = elementCount;
+	section.data = data;
+	sections.push_back(section);
+}
+
+// --------------------------------------------------------
+// Lays out the whole file in memory, checksum included
+// --------------------------------------------------------
+bool BakedMeshWriter::WriteToMemory(std::vector<unsigned char>& out) const
+{
+	unsigned int sectionCount = (unsigned int)sections.size();
+
+	// Work out where everything goes
+	std::vector<BakedSection> table(sectionCount);
+	unsigned long long offset = sizeof(BakedMeshHeader) + sizeof(BakedSection) * sectionCount;
+	for (unsigned int i = 0; i < sectionCount; i++)
+	{
+		offset = AlignUp(offset, BakedSectionAlignment);
+
+		BakedSection& s = table[i];
+		memset(&s, 0, sizeof(s));
+		s.type = sections[i].type;
+		s.elementSize = sections[i].elementSize;
+		s.elementCount = sections[i].elementCount;
+		s.offset = offset;
+		s.size = (unsigned long long)s.elementSize * s.elementCount;
+
+		offset += s.size;
+	}
+
+	unsigned long long fileSize = AlignUp(offset, BakedSectionAlignment);
+	if (fileSize != (size_t)fileSize)
+		return false;
+
+	// Padding stays zeroed so the checksum is repeatable
+	out.assign((size_t)fileSize, 0);
+
+	if (sectionCount > 0)
+		memcpy(&out[sizeof(BakedMeshHeader)], table.data(), sizeof(BakedSection) * sectionCount);
+
+	for (unsigned int i = 0; i < sectionCount; i++)
+	{
+		if (table[i].size > 0)
+			memcpy(&out[(size_t)table[i].offset], sections[i].data, (size_t)table[i].size);
+	}
+
+	BakedMeshHeader finalHeader = header;
+	finalHeader.sectionCount = sectionCount;
+	finalHeader.fileSize = fileSize;
+	finalHeader.checksum = Fnv1a32(&out[sizeof(BakedMeshHeader)], (size_t)fileSize - sizeof(BakedMeshHeader));
+	memcpy(&out[0], &finalHeader, sizeof(BakedMeshHeader));
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes the file to disk
+// --------------------------------------------------------
+bool BakedMeshWriter::Write(const std::string& path) const
+{
+	std::vector<unsigned char> bytes;
+	if (!WriteToMemory(bytes))
+		return false;
+
+	FILE* file = 0;
+#ifdef _MSC_VER
+	if (fopen_s(&file, path.c_str(), "wb") != 0)
+		file = 0;
+#else
+	file = fopen(path.c_str(), "wb");
+#endif
+	if (!file)
+		return false;
+
+	bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	return fclose(file) == 0 && written;
+}
+
+
+// --------------------------------------------------------
+// Constructor - Starts with nothing open
+// --------------------------------------------------------
+BakedMesh::BakedMesh()
+	:
+	data(0),
+	size(0)
+{
+}
+
+// --------------------------------------------------------
+// Maps a baked mesh file and checks that it's valid
+//
+// verifyChecksum - Also check the contents against the
+//                  checksum?  This reads the whole file.
+// --------------------------------------------------------
+bool BakedMesh::Open(const std::string& path, bool verifyChecksum)
+{
+	Close();
+	if (!file.Open(path))
+		return false;
+
+	data = (const unsigned char*)file.GetData();
+	size = file.GetSize();
+	if (!Validate(verifyChecksum))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Uses baked mesh data that's already in memory, which
+// must stay valid until this is closed
+// --------------------------------------------------------
+bool BakedMesh::OpenFromMemory(const void* data, size_t size, bool verifyChecksum)
+{
+	Close();
+	this->data = (const unsigned char*)data;
+	this->size = size;
+	if (!Validate(verifyChecksum))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Unmaps the file - any pointers into it become invalid
+// --------------------------------------------------------
+void BakedMesh::Close()
+{
+	file.Close();
+	data = 0;
+	size = 0;
+}
+
+bool BakedMesh::IsOpen() const
+{
+	return data != 0;
+}
+
+// --------------------------------------------------------
+// Whether this was baked from the given file as it is now
+// (same size and modification time)
+// --------------------------------------------------------
+bool BakedMesh::MatchesSource(const std::string& sourcePath) const
+{
+	unsigned long long sourceSize = 0;
+	long long sourceTime = 0;
+	if (!IsOpen() || !GetSourceFileInfo(sourcePath, sourceSize, sourceTime))
+		return false;
+
+	const BakedMeshHeader& header = GetHeader();
+	return header.sourceSize == sourceSize && header.sourceTime == sourceTime;
+}
+
+const BakedMeshHeader& BakedMesh::GetHeader() const
+{
+	return *(const BakedMeshHeader*)data;
+}
+
+// --------------------------------------------------------
+// Finds the first section of a type, or returns null
+// --------------------------------------------------------
+const void* BakedMesh::FindSection(unsigned int type, unsigned int* elementCount, unsigned int* elementSize) const
+{
+	if (!IsOpen())
+		return 0;
+
+	const BakedSection* table = (const BakedSection*)(data + sizeof(BakedMeshHeader));
+	for (unsigned int i = 0; i < GetHeader().sectionCount; i++)
+	{
+		if (table[i].type != type)
+			continue;
+
+		if (elementCount) *elementCount = table[i].elementCount;
+		if (elementSize) *elementSize = table[i].elementSize;
+		return data + table[i].offset;
+	}
+
+	if (elementCount) *elementCount = 0;
+	if (elementSize) *elementSize = 0;
+	return 0;
+}
+
+// --------------------------------------------------------
+// Getters for the standard sections
+// --------------------------------------------------------
+const Vertex* BakedMesh::GetVertices() const
+{
+	return (const Vertex*)FindSection(BakedSectionVertices);
+}
+
+unsigned int BakedMesh::GetVertexCount() const
+{
+	unsigned int count = 0;
+	FindSection(BakedSectionVertices, &count);
+	return count;
+}
+
+const void* BakedMesh::GetIndices() const
+{
+	return FindSection(BakedSectionIndices);
+}
+
+unsigned int BakedMesh::GetIndexCount() const
+{
+	unsigned int count = 0;
+	FindSection(BakedSectionIndices, &count);
+	return count;
+}
+
+bool BakedMesh::Uses16BitIndices() const
+{
+	unsigned int elementSize = 0;
+	FindSection(BakedSectionIndices, 0, &elementSize);
+	return elementSize == sizeof(unsigned short);
+}
+
+const BakedSubmesh* BakedMesh::GetSubmeshes() const
+{
+	return (const BakedSubmesh*)FindSection(BakedSectionSubmeshes);
+}
+
+unsigned int BakedMesh::GetSubmeshCount() const
+{
+	unsigned int count = 0;
+	FindSection(BakedSectionSubmeshes, &count);
+	return count;
+}
+
+const BakedLod* BakedMesh::GetLods() const
+{
+	return (const BakedLod*)FindSection(BakedSectionLods);
+}
+
+unsigned int BakedMesh::GetLodCount() const
+{
+	unsigned int count = 0;
+	FindSection(BakedSectionLods, &count);
+	return count;
+}
+
+const Meshlet* BakedMesh::GetMeshlets() const
+{
+	return (const Meshlet*)FindSection(BakedSectionMeshlets);
+}
+
+unsigned int BakedMesh::GetMeshletCount() const
+{
+	unsigned int count = 0;
+	FindSection(BakedSectionMeshlets, &count);
+	return count;
+}
+
+// --------------------------------------------------------
+// Makes sure every offset and size stays inside the file,
+// so nothing read through the getters can go out of bounds
+// --------------------------------------------------------
+bool BakedMesh::Validate(bool verifyChecksum)
+{
+	if (!data || size < sizeof(BakedMeshHeader))
+		return false;
+
+	const BakedMeshHeader& header = GetHeader();
+	if (header.magic != BakedMeshMagic ||
+		header.version != BakedMeshVersion ||
+		header.headerSize != sizeof(BakedMeshHeader) ||
+		header.fileSize != size)
+		return false;
+
+	unsigned long long tableEnd = sizeof(BakedMeshHeader) + (unsigned long long)sizeof(BakedSection) * header.sectionCount;
+	if (tableEnd > size)
+		return false;
+
+	const BakedSection* table = (const BakedSection*)(data + sizeof(BakedMeshHeader));
+	for (unsigned int i = 0; i < header.sectionCount; i++)
+	{
+		const BakedSection& s = table[i];
+		if (s.offset % BakedSectionAlignment != 0 ||
+			s.offset < tableEnd ||
+			s.offset > size ||
+			s.size > size - s.offset ||
+			s.size != (unsigned long long)s.elementSize * s.elementCount)
+			return false;
+
+		// Known sections must hold what they claim to
+		if ((s.type == BakedSectionVertices && s.elementSize != sizeof(Vertex)) ||
+			(s.type == BakedSectionIndices && s.elementSize != 2 && s.elementSize != 4) ||
+			(s.type == BakedSectionSubmeshes && s.elementSize != sizeof(BakedSubmesh)) ||
+			(s.type == BakedSectionLods && s.elementSize != sizeof(BakedLod)) ||
+			(s.type == BakedSectionMeshlets && s.elementSize != sizeof(Meshlet)))
+			return false;
+	}
+
+	// Every level of detail has to be inside the index section
+	unsigned int indexCount = GetIndexCount();
+	const BakedLod* lods = GetLods();
+	for (unsigned int i = 0; i < GetLodCount(); i++)
+	{
+		if (lods[i].firstIndex > indexCount || lods[i].indexCount > indexCount - lods[i].firstIndex)
+			return false;
+	}
+
+	// Same for every meshlet
+	const Meshlet* meshlets = GetMeshlets();
+	for (unsigned int i = 0; i < GetMeshletCount(); i++)
+	{
+		if (meshlets[i].firstIndex > indexCount || meshlets[i].triangleCount > (indexCount - meshlets[i].firstIndex) / 3)
+			return false;
+	}
+
+	if (verifyChecksum && header.checksum != Fnv1a32(data + sizeof(BakedMeshHeader), size - sizeof(BakedMeshHeader)))
+		return false;
+
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Writes imported geometry to a baked mesh file
+//
+// path       - The .bmesh file to write
+// mesh       - Vertices, indices, levels of detail and
+//              meshlets
+// submeshes  - Index ranges, or empty for one covering
+//              the whole (finest level of the) mesh
+// sourceSize - Size of the file the mesh came from
+// sourceTime - Modification time of that file
+// --------------------------------------------------------
+bool WriteBakedMesh(
+	const std::string& path,
+	const ImportedMesh& mesh,
+	const std::vector<BakedSubmesh>& submeshes,
+	unsigned long long sourceSize,
+	long long sourceTime)
+{
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	unsigned int indexCount = mesh.uses16BitIndices ?
+		(unsigned int)mesh.indices16.size() :
+		(unsigned int)mesh.indices32.size();
+
+	XMFLOAT3 boundsMin(0, 0, 0);
+	XMFLOAT3 boundsMax(0, 0, 0);
+	if (vertexCount > 0)
+	{
+		XMVECTOR minimum = XMLoadFloat3(&mesh.vertices[0].Position);
+		XMVECTOR maximum = minimum;
+		for (unsigned int i = 1; i < vertexCount; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(&mesh.vertices[i].Position);
+			minimum = XMVectorMin(minimum, p);
+			maximum = XMVectorMax(maximum, p);
+		}
+		XMStoreFloat3(&boundsMin, minimum);
+		XMStoreFloat3(&boundsMax, maximum);
+	}
+
+	// One submesh for everything, unless told otherwise
+	std::vector<BakedSubmesh> wholeMesh;
+	const std::vector<BakedSubmesh>* finalSubmeshes = &submeshes;
+	if (submeshes.empty())
+	{
+		BakedSubmesh submesh = {};
+		submesh.firstIndex = 0;
+		submesh.indexCount = mesh.lods.empty() ? indexCount : mesh.lods[0].indexCount;
+		submesh.boundsMin = boundsMin;
+		submesh.boundsMax = boundsMax;
+		wholeMesh.push_back(submesh);
+		finalSubmeshes = &wholeMesh;
+	}
+
+	BakedMeshWriter writer;
+	writer.SetBounds(boundsMin, boundsMax);
+	writer.SetSource(sourceSize, sourceTime);
+	writer.AddSection(BakedSectionVertices, sizeof(Vertex), vertexCount, mesh.vertices.data());
+	if (mesh.uses16BitIndices)
+		writer.AddSection(BakedSectionIndices, sizeof(unsigned short), indexCount, mesh.indices16.data());
+	else
+		writer.AddSection(BakedSectionIndices, sizeof(unsigned int), indexCount, mesh.indices32.data());
+	writer.AddSection(BakedSectionSubmeshes, sizeof(BakedSubmesh), (unsigned int)finalSubmeshes->size(), finalSubmeshes->data());
+
+	std::vector<BakedLod> lods(mesh.lods.size());
+	for (size_t i = 0; i < mesh.lods.size(); i++)
+	{
+		lods[i].firstIndex = mesh.lods[i].firstIndex;
+		lods[i].indexCount = mesh.lods[i].indexCount;
+		lods[i].error = mesh.lods[i].error;
+		lods[i].reserved = 0;
+	}
+	if (!lods.empty())
+		writer.AddSection(BakedSectionLods, sizeof(BakedLod), (unsigned int)lods.size(), lods.data());
+	if (!mesh.meshlets.empty())
+		writer.AddSection(BakedSectionMeshlets, sizeof(Meshlet), (unsigned int)mesh.meshlets.size(), mesh.meshlets.data());
+
+	return writer.Write(path);
+}
+
+// --------------------------------------------------------
+// The offline bake step - imports an OBJ file, builds its
+// levels of detail, reorders it all for the GPU, splits it
+// into meshlets (time spent here is paid once, not on every
+// load) and writes it back out as a baked mesh, remembering
+// which version of the OBJ it came from
+//
+// error - Optional - why an OBJ that's there couldn't be
+//         baked (left alone if it just doesn't exist)
+// --------------------------------------------------------
+bool BakeObj(const std::string& objPath, const std::string& bakedPath, JobSystem* jobs, std::string* error)
+{
+	unsigned long long sourceSize = 0;
+	long long sourceTime = 0;
+	if (!GetSourceFileInfo(objPath, sourceSize, sourceTime))
+		return false;
+
+	ImportedMesh mesh;
+	ObjImportStats stats;
+	if (!ImportObj(objPath, mesh, jobs, &stats))
+	{
+		if (error)
+			*error = stats.error;
+		return false;
+	}
+
+	BuildLodChain(mesh);
+
+	MeshOptimizeOptions options;
+	options.overdraw = true;
+	OptimizeMesh(mesh, options);
+	BuildMeshlets(mesh);
+
+	if (!WriteBakedMesh(bakedPath, mesh, std::vector<BakedSubmesh>(), sourceSize, sourceTime))
+	{
+		if (error)
+			*error = "couldn't write " + bakedPath;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshletBuilder.h"
+#include "Vertex.h"
+
+struct ImportedMesh;
+class JobSystem;
+
+// --------------------------------------------------------
+// Baked mesh files (.bmesh) - geometry stored exactly as
+// the GPU wants it, so loading is just mapping the file and
+// pointing D3D11_SUBRESOURCE_DATA::pSysMem into it.
+//
+// Layout:
+//   BakedMeshHeader
+//   BakedSection[sectionCount]
+//   Section data, each starting on a 16-byte boundary
+//
+// Everything after the header is covered by the checksum.
+// Unknown section types are skipped, so new ones can be
+// added without breaking older loaders.
+// --------------------------------------------------------
+static const unsigned int BakedMeshMagic = 0x48534D42;	// "BMSH"
+static const unsigned int BakedMeshVersion = 4;	// 2: Levels of detail, 3: Meshlets, 4: Measured level errors
+static const unsigned int BakedSectionAlignment = 16;
+
+enum BakedSectionType
+{
+	BakedSectionVertices = 1,	// Vertex[]
+	BakedSectionIndices = 2,	// unsigned short[] or unsigned int[] (see elementSize)
+	BakedSectionSubmeshes = 3,	// BakedSubmesh[]
+	BakedSectionLods = 4,		// BakedLod[], finest first (optional)
+	BakedSectionMeshlets = 5	// Meshlet[], covering the finest level (optional)
+};
+
+struct BakedMeshHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int headerSize;		// sizeof(BakedMeshHeader), as written
+	unsigned int sectionCount;
+	unsigned long long fileSize;
+
+	// The file this was baked from, for spotting stale bakes
+	unsigned long long sourceSize;
+	long long sourceTime;
+
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+
+	unsigned int checksum;			// FNV-1a of everything after the header
+	unsigned int reserved;
+};
+
+struct BakedSection
+{
+	unsigned int type;				// BakedSectionType
+	unsigned int elementSize;
+	unsigned int elementCount;
+	unsigned int reserved;
+	unsigned long long offset;		// From the start of the file
+	unsigned long long size;		// elementSize * elementCount
+};
+
+// A range of indices drawn with one material
+struct BakedSubmesh
+{
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	unsigned int material;
+	unsigned int reserved;
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+};
+
+// A level of detail - a range of the index section, which
+// holds every level one after another.  Submesh ranges are
+// for the finest level.
+struct BakedLod
+{
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	float error;					// Largest distance from the finest level, in mesh units
+	unsigned int reserved;
+};
+
+// --------------------------------------------------------
+// Builds a baked mesh file from sections of raw data.  The
+// data isn't copied, so it must stay valid until written.
+// --------------------------------------------------------
+class BakedMeshWriter
+{
+public:
+	BakedMeshWriter();
+
+	void SetBounds(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+	void SetSource(unsigned long long sourceSize, long long sourceTime);
+	void AddSection(unsigned int type, unsigned int elementSize, unsigned int elementCount, const void* data);
+
+	bool WriteToMemory(std::vector<unsigned char>& out) const;
+	bool Write(const std::string& path) const;
+
+private:
+	struct PendingSection
+	{
+		unsigned int type;
+		unsigned int elementSize;
+		unsigned int elementCount;
+		const void* data;
+	};
+
+	std::vector<PendingSection> sections;
+	BakedMeshHeader header;
+};
+
+// --------------------------------------------------------
+// A baked mesh file, mapped into memory and validated.
+// Every pointer returned points straight into the file.
+// --------------------------------------------------------
+class BakedMesh
+{
+public:
+	BakedMesh();
+
+	bool Open(const std::string& path, bool verifyChecksum = true);
+	bool OpenFromMemory(const void* data, size_t size, bool verifyChecksum = true);
+	void Close();
+	bool IsOpen() const;
+
+	bool MatchesSource(const std::string& sourcePath) const;
+
+	const BakedMeshHeader& GetHeader() const;
+	const void* FindSection(unsigned int type, unsigned int* elementCount = 0, unsigned int* elementSize = 0) const;
+
+	const Vertex* GetVertices() const;
+	unsigned int GetVertexCount() const;
+
+	const void* GetIndices() const;
+	unsigned int GetIndexCount() const;
+	bool Uses16BitIndices() const;
+
+	const BakedSubmesh* GetSubmeshes() const;
+	unsigned int GetSubmeshCount() const;
+
+	const BakedLod* GetLods() const;
+	unsigned int GetLodCount() const;
+
+	const Meshlet* GetMeshlets() const;
+	unsigned int GetMeshletCount() const;
+
+private:
+	MappedFile file;
+	const unsigned char* data;
+	size_t size;
+
+	bool Validate(bool verifyChecksum);
+};
+
+bool GetSourceFileInfo(const std::string& path, unsigned long long& size, long long& modifiedTime);
+
+bool WriteBakedMesh(
+	const std::string& path,
+	const ImportedMesh& mesh,
+	const std::vector<BakedSubmesh>& submeshes,
+	unsigned long long sourceSize = 0,
+	long long sourceTime = 0);
+
+bool BakeObj(const std::string& objPath, const std::string& bakedPath, JobSystem* jobs = 0, std::string* error = 0);
@@ -0,0 +1,637 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+
+using namespace DirectX;
+
+typedef std::chrono::steady_clock BvhClock;
+
+// Buckets item centers are sorted into along an axis when
+// looking for the best split
+static const unsigned int SplitBinCount = 16;
+
+// Rotations have to shrink a node by at least this much of
+// its area, so floating point noise doesn't keep swapping
+// the same two subtrees back and forth
+static const float MinRotationGain = 0.001f;
+
+// Traversal stack space to start with - it grows if needed
+static const unsigned int InitialStackSize = 64;
+
+// --------------------------------------------------------
+// Small box helpers
+// --------------------------------------------------------
+
+// Half the surface area - only ever compared, so the 2 is left out
+static float HalfArea(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	float x = boundsMax.x - boundsMin.x;
+	float y = boundsMax.y - boundsMin.y;
+	float z = boundsMax.z - boundsMin.z;
+	return x * y + y * z + z * x;
+}
+
+static void EmptyBox(XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)
+{
+	boundsMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	boundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+static void GrowBox(XMFLOAT3& boundsMin, XMFLOAT3& boundsMax, const XMFLOAT3& otherMin, const XMFLOAT3& otherMax)
+{
+	boundsMin.x = std::min(boundsMin.x, otherMin.x);
+	boundsMin.y = std::min(boundsMin.y, otherMin.y);
+	boundsMin.z = std::min(boundsMin.z, otherMin.z);
+	boundsMax.x = std::max(boundsMax.x, otherMax.x);
+	boundsMax.y = std::max(boundsMax.y, otherMax.y);
+	boundsMax.z = std::max(boundsMax.z, otherMax.z);
+}
+
+// Area of the box around two others, without storing it
+static float UnionArea(const BvhNode& a, const BvhNode& b)
+{
+	XMFLOAT3 boundsMin = a.boundsMin;
+	XMFLOAT3 boundsMax = a.boundsMax;
+	GrowBox(boundsMin, boundsMax, b.boundsMin, b.boundsMax);
+	return HalfArea(boundsMin, boundsMax);
+}
+
+static bool BoxesOverlap(const XMFLOAT3& aMin, const XMFLOAT3& aMax, const XMFLOAT3& bMin, const XMFLOAT3& bMax)
+{
+	return
+		aMin.x <= bMax.x && aMax.x >= bMin.x &&
+		aMin.y <= bMax.y && aMax.y >= bMin.y &&
+		aMin.z <= bMax.z && aMax.z >= bMin.z;
+}
+
+static bool SphereOverlapsBox(const XMFLOAT3& center, float radiusSq, const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	// Distance from the center to the closest point in the box
+	float dx = std::max(std::max(boundsMin.x - center.x, center.x - boundsMax.x), 0.0f);
+	float dy = std::max(std::max(boundsMin.y - center.y, center.y - boundsMax.y), 0.0f);
+	float dz = std::max(std::max(boundsMin.z - center.z, center.z - boundsMax.z), 0.0f);
+	return dx * dx + dy * dy + dz * dz <= radiusSq;
+}
+
+// --------------------------------------------------------
+// Slab test - returns how far along the ray it enters the
+// box (0 if it starts inside), or FLT_MAX if it misses or
+// only gets there after maxDistance
+// --------------------------------------------------------
+static float RayBoxDistance(
+	const XMFLOAT3& origin,
+	const XMFLOAT3& inverseDirection,
+	float maxDistance,
+	const XMFLOAT3& boundsMin,
+	const XMFLOAT3& boundsMax)
+{
+	float x1 = (boundsMin.x - origin.x) * inverseDirection.x;
+	float x2 = (boundsMax.x - origin.x) * inverseDirection.x;
+	float y1 = (boundsMin.y - origin.y) * inverseDirection.y;
+	float y2 = (boundsMax.y - origin.y) * inverseDirection.y;
+	float z1 = (boundsMin.z - origin.z) * inverseDirection.z;
+	float z2 = (boundsMax.z - origin.z) * inverseDirection.z;
+
+	float enter = std::max(std::max(std::min(x1, x2), std::min(y1, y2)), std::max(std::min(z1, z2), 0.0f));
+	float exit = std::min(std::min(std::max(x1, x2), std::max(y1, y2)), std::min(std::max(z1, z2), maxDistance));
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+
+// --------------------------------------------------------
+// Constructor - Starts empty
+// --------------------------------------------------------
+Bvh::Bvh()
+	:
+	maxLeafItems(4)
+{
+}
+
+unsigned int Bvh::GetItemCount() const { return (unsigned int)items.size(); }
+const std::vector<BvhNode>& Bvh::GetNodes() const { return nodes; }
+const BvhStats& Bvh::GetStats() const { return stats; }
+
+void Bvh::Clear()
+{
+	nodes.clear();
+	items.clear();
+	itemBoxes.clear();
+	stats = BvhStats();
+}
+
+// --------------------------------------------------------
+// Builds a new tree over a set of boxes, replacing the old
+// one.  Items are the boxes' indices.
+//
+// boundsMins   - Each box's minimum corner
+// boundsMaxs   - Each box's maximum corner
+// count        - Number of boxes
+// maxLeafItems - Nodes with more items than this are split
+// --------------------------------------------------------
+void Bvh::Build(
+	const XMFLOAT3* boundsMins,
+	const XMFLOAT3* boundsMaxs,
+	unsigned int count,
+	unsigned int maxLeafItems)
+{
+	BvhClock::time_point start = BvhClock::now();
+
+	Clear();
+	if (count == 0)
+		return;
+
+	this->maxLeafItems = std::max(maxLeafItems, 1u);
+
+	buildItems.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		BuildItem& b = buildItems[i];
+		b.item = i;
+		b.boundsMin = boundsMins[i];
+		b.boundsMax = boundsMaxs[i];
+		b.center = XMFLOAT3(
+			(boundsMins[i].x + boundsMaxs[i].x) * 0.5f,
+			(boundsMins[i].y + boundsMaxs[i].y) * 0.5f,
+			(boundsMins[i].z + boundsMaxs[i].z) * 0.5f);
+	}
+
+	// A binary tree with count leaves at most has 2 * count - 1
+	// nodes, so reserving that keeps node references valid
+	nodes.reserve(count * 2);
+	BvhNode root = {};
+	root.first = 0;
+	root.count = count;
+	nodes.push_back(root);
+	float cost = Subdivide(0, 1);
+
+	// Items (and their boxes) in leaf order, so leaves read them in a row
+	items.resize(count);
+	itemBoxes.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		items[i] = buildItems[i].item;
+		itemBoxes[i].boundsMin = buildItems[i].boundsMin;
+		itemBoxes[i].boundsMax = buildItems[i].boundsMax;
+	}
+
+	stats.nodeCount = (unsigned int)nodes.size();
+	stats.leafCount = (stats.nodeCount + 1) / 2;
+	stats.cost = cost / std::max(HalfArea(nodes[0].boundsMin, nodes[0].boundsMax), FLT_MIN);
+	stats.buildCost = stats.cost;
+	stats.buildMs = std::chrono::duration<double, std::milli>(BvhClock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Fits a node to its items, then splits it in two (and so
+// on down) until nodes are small enough.  Splits are picked
+// by binning item centers along each axis and choosing the
+// bin boundary where (items * area) summed over both halves
+// is smallest.  Returns the subtree's unnormalized cost.
+// --------------------------------------------------------
+float Bvh::Subdivide(unsigned int node, unsigned int depth)
+{
+	BvhNode& n = nodes[node];
+	stats.depth = std::max(stats.depth, depth);
+
+	XMFLOAT3 centerMin, centerMax;
+	EmptyBox(n.boundsMin, n.boundsMax);
+	EmptyBox(centerMin, centerMax);
+	BuildItem* begin = buildItems.data() + n.first;
+	BuildItem* end = begin + n.count;
+	for (BuildItem* b = begin; b != end; b++)
+	{
+		GrowBox(n.boundsMin, n.boundsMax, b->boundsMin, b->boundsMax);
+		GrowBox(centerMin, centerMax, b->center, b->center);
+	}
+
+	float area = HalfArea(n.boundsMin, n.boundsMax);
+	if (n.count <= maxLeafItems)
+		return area * n.count;
+
+	// Best bin boundary over every axis
+	int bestAxis = -1;
+	unsigned int bestSplit = 0;
+	float bestCost = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float low = (&centerMin.x)[axis];
+		float extent = (&centerMax.x)[axis] - low;
+		if (extent <= 0.0f)
+			continue;
+
+		unsigned int binCounts[SplitBinCount] = {};
+		XMFLOAT3 binMins[SplitBinCount], binMaxs[SplitBinCount];
+		for (unsigned int b = 0; b < SplitBinCount; b++)
+			EmptyBox(binMins[b], binMaxs[b]);
+
+		float scale = SplitBinCount / extent;
+		for (BuildItem* b = begin; b != end; b++)
+		{
+			unsigned int bin = std::min((unsigned int)(((&b->center.x)[axis] - low) * scale), SplitBinCount - 1);
+			binCounts[bin]++;
+			GrowBox(binMins[bin], binMaxs[bin], b->boundsMin, b->boundsMax);
+		}
+
+		// Sweep from the right to get the cost of everything past
+		// each boundary, then from the left to finish each split
+		float rightCosts[SplitBinCount];
+		XMFLOAT3 sweepMin, sweepMax;
+		EmptyBox(sweepMin, sweepMax);
+		unsigned int sweepCount = 0;
+		for (unsigned int b = SplitBinCount - 1; b > 0; b--)
+		{
+			GrowBox(sweepMin, sweepMax, binMins[b], binMaxs[b]);
+			sweepCount += binCounts[b];
+			rightCosts[b] = sweepCount > 0 ? HalfArea(sweepMin, sweepMax) * sweepCount : 0.0f;
+		}
+
+		EmptyBox(sweepMin, sweepMax);
+		sweepCount = 0;
+		for (unsigned int b = 1; b < SplitBinCount; b++)
+		{
+			GrowBox(sweepMin, sweepMax, binMins[b - 1], binMaxs[b - 1]);
+			sweepCount += binCounts[b - 1];
+			if (sweepCount == 0 || sweepCount == n.count)
+				continue;
+
+			float cost = HalfArea(sweepMin, sweepMax) * sweepCount + rightCosts[b];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	// Items before middle go left, the rest go right
+	BuildItem* middle = begin + n.count / 2;
+	if (bestAxis >= 0)
+	{
+		float low = (&centerMin.x)[bestAxis];
+		float scale = SplitBinCount / ((&centerMax.x)[bestAxis] - low);
+		middle = std::partition(begin, end, [&](const BuildItem& b)
+			{
+				return std::min((unsigned int)(((&b.center.x)[bestAxis] - low) * scale), SplitBinCount - 1) < bestSplit;
+			});
+	}
+
+	// Every center in the same place (or rounding put them all
+	// on one side) - any even split is as good as another
+	if (middle == begin || middle == end)
+		middle = begin + n.count / 2;
+
+	unsigned int left = (unsigned int)nodes.size();
+	BvhNode child = {};
+	child.first = n.first;
+	child.count = (unsigned int)(middle - begin);
+	nodes.push_back(child);
+	child.first = n.first + child.count;
+	child.count = n.count - child.count;
+	nodes.push_back(child);
+
+	n.first = left;
+	n.count = 0;
+
+	return area + Subdivide(left, depth + 1) + Subdivide(left + 1, depth + 1);
+}
+
+// --------------------------------------------------------
+// Refits every node to the items' new boxes, keeping the
+// tree's shape (apart from rotations).  Items must be the
+// same ones the tree was built with.
+//
+// boundsMins - Each box's new minimum corner
+// boundsMaxs - Each box's new maximum corner
+// rotate     - Whether to also improve the tree as it goes
+// --------------------------------------------------------
+void Bvh::Refit(const XMFLOAT3* boundsMins, const XMFLOAT3* boundsMaxs, bool rotate)
+{
+	BvhClock::time_point start = BvhClock::now();
+
+	stats.rotations = 0;
+	if (!nodes.empty())
+	{
+		float cost = RefitNode(0, boundsMins, boundsMaxs, rotate);
+		stats.cost = cost / std::max(HalfArea(nodes[0].boundsMin, nodes[0].boundsMax), FLT_MIN);
+	}
+
+	stats.refitMs = std::chrono::duration<double, std::milli>(BvhClock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Children first, then maybe a rotation, then this node's
+// box.  Returns the subtree's unnormalized cost.
+// --------------------------------------------------------
+float Bvh::RefitNode(unsigned int node, const XMFLOAT3* boundsMins, const XMFLOAT3* boundsMaxs, bool rotate)
+{
+	BvhNode& n = nodes[node];
+	if (n.count > 0)
+	{
+		EmptyBox(n.boundsMin, n.boundsMax);
+		for (unsigned int i = n.first; i < n.first + n.count; i++)
+		{
+			ItemBox& box = itemBoxes[i];
+			box.boundsMin = boundsMins[items[i]];
+			box.boundsMax = boundsMaxs[items[i]];
+			GrowBox(n.boundsMin, n.boundsMax, box.boundsMin, box.boundsMax);
+		}
+		return HalfArea(n.boundsMin, n.boundsMax) * n.count;
+	}
+
+	float childCost =
+		RefitNode(n.first, boundsMins, boundsMaxs, rotate) +
+		RefitNode(n.first + 1, boundsMins, boundsMaxs, rotate);
+
+	// Only the inner child's area changes, and only by the gain
+	if (rotate)
+		childCost -= TryRotation(node);
+
+	const BvhNode& left = nodes[n.first];
+	const BvhNode& right = nodes[n.first + 1];
+	n.boundsMin = left.boundsMin;
+	n.boundsMax = left.boundsMax;
+	GrowBox(n.boundsMin, n.boundsMax, right.boundsMin, right.boundsMax);
+	return HalfArea(n.boundsMin, n.boundsMax) + childCost;
+}
+
+// --------------------------------------------------------
+// Swaps one child with one of the other child's children,
+// if any of the four possible swaps shrinks the inner child
+// they share.  The node's own box can't change, since it
+// holds the same items either way.  Returns how much the
+// inner child shrank, or 0 if nothing was swapped.
+// --------------------------------------------------------
+float Bvh::TryRotation(unsigned int node)
+{
+	const BvhNode& n = nodes[node];
+	unsigned int children[2] = { n.first, n.first + 1 };
+
+	unsigned int bestA = 0, bestB = 0, bestInner = 0;
+	float bestGain = 0.0f;
+	for (unsigned int side = 0; side < 2; side++)
+	{
+		// Swapping the child a with a grandchild under the child inner
+		const BvhNode& a = nodes[children[side]];
+		const BvhNode& inner = nodes[children[1 - side]];
+		if (inner.count > 0)
+			continue;
+
+		float innerArea = HalfArea(inner.boundsMin, inner.boundsMax);
+		for (unsigned int g = 0; g < 2; g++)
+		{
+			// What's left under inner is a and the other grandchild
+			const BvhNode& kept = nodes[inner.first + 1 - g];
+			float gain = innerArea - UnionArea(a, kept);
+			if (gain > bestGain && gain > innerArea * MinRotationGain)
+			{
+				bestGain = gain;
+				bestA = children[side];
+				bestB = inner.first + g;
+				bestInner = children[1 - side];
+			}
+		}
+	}
+
+	if (bestGain <= 0.0f)
+		return 0.0f;
+
+	// Nodes refer to their children by index, so swapping two
+	// nodes moves their whole subtrees along with them
+	std::swap(nodes[bestA], nodes[bestB]);
+
+	BvhNode& inner = nodes[bestInner];
+	inner.boundsMin = nodes[inner.first].boundsMin;
+	inner.boundsMax = nodes[inner.first].boundsMax;
+	GrowBox(inner.boundsMin, inner.boundsMax, nodes[inner.first + 1].boundsMin, nodes[inner.first + 1].boundsMax);
+
+	stats.rotations++;
+	return bestGain;
+}
+
+// --------------------------------------------------------
+// Every item at or below a node, with no further tests
+// --------------------------------------------------------
+void Bvh::AddSubtree(unsigned int node, std::vector<unsigned int>& items) const
+{
+	std::vector<unsigned int> stack;
+	stack.reserve(InitialStackSize);
+	stack.push_back(node);
+	while (!stack.empty())
+	{
+		const BvhNode& n = nodes[stack.back()];
+		stack.pop_back();
+
+		if (n.count > 0)
+			items.insert(items.end(), this->items.begin() + n.first, this->items.begin() + n.first + n.count);
+		else
+		{
+			stack.push_back(n.first);
+			stack.push_back(n.first + 1);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Appends every item whose box is at least partly inside a
+// frustum.  Nodes entirely inside add everything under them
+// without testing each item.
+// --------------------------------------------------------
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& items) const
+{
+	if (nodes.empty())
+		return;
+
+	std::vector<unsigned int> stack;
+	stack.reserve(InitialStackSize);
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		unsigned int node = stack.back();
+		const BvhNode& n = nodes[node];
+		stack.pop_back();
+
+		// The corner furthest along each plane's normal decides
+		// whether any of the box is inside, and the nearest
+		// corner whether all of it is
+		bool outside = false;
+		bool inside = true;
+		for (unsigned int p = 0; p < FrustumPlaneCount && !outside; p++)
+		{
+			const XMFLOAT4& plane = frustum.planes[p];
+			float furthest =
+				plane.x * (plane.x >= 0.0f ? n.boundsMax.x : n.boundsMin.x) +
+				plane.y * (plane.y >= 0.0f ? n.boundsMax.y : n.boundsMin.y) +
+				plane.z * (plane.z >= 0.0f ? n.boundsMax.z : n.boundsMin.z) + plane.w;
+			float nearest =
+				plane.x * (plane.x >= 0.0f ? n.boundsMin.x : n.boundsMax.x) +
+				plane.y * (plane.y >= 0.0f ? n.boundsMin.y : n.boundsMax.y) +
+				plane.z * (plane.z >= 0.0f ? n.boundsMin.z : n.boundsMax.z) + plane.w;
+			outside = furthest < 0.0f;
+			inside = inside && nearest >= 0.0f;
+		}
+
+		if (outside)
+			continue;
+
+		if (inside)
+			AddSubtree(node, items);
+		else if (n.count > 0)
+		{
+			for (unsigned int i = n.first; i < n.first + n.count; i++)
+			{
+				if (BoxInFrustum(frustum, itemBoxes[i].boundsMin, itemBoxes[i].boundsMax))
+					items.push_back(this->items[i]);
+			}
+		}
+		else
+		{
+			stack.push_back(n.first);
+			stack.push_back(n.first + 1);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Appends every item whose box touches a sphere
+// --------------------------------------------------------
+void Bvh::QuerySphere(const XMFLOAT3& center, float radius, std::vector<unsigned int>& items) const
+{
+	if (nodes.empty())
+		return;
+
+	float radiusSq = radius * radius;
+	std::vector<unsigned int> stack;
+	stack.reserve(InitialStackSize);
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const BvhNode& n = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!SphereOverlapsBox(center, radiusSq, n.boundsMin, n.boundsMax))
+			continue;
+
+		if (n.count > 0)
+		{
+			for (unsigned int i = n.first; i < n.first + n.count; i++)
+			{
+				if (SphereOverlapsBox(center, radiusSq, itemBoxes[i].boundsMin, itemBoxes[i].boundsMax))
+					items.push_back(this->items[i]);
+			}
+		}
+		else
+		{
+			stack.push_back(n.first);
+			stack.push_back(n.first + 1);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Appends every item whose box overlaps another box
+// --------------------------------------------------------
+void Bvh::QueryBox(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, std::vector<unsigned int>& items) const
+{
+	if (nodes.empty())
+		return;
+
+	std::vector<unsigned int> stack;
+	stack.reserve(InitialStackSize);
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const BvhNode& n = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!BoxesOverlap(boxMin, boxMax, n.boundsMin, n.boundsMax))
+			continue;
+
+		if (n.count > 0)
+		{
+			for (unsigned int i = n.first; i < n.first + n.count; i++)
+			{
+				if (BoxesOverlap(boxMin, boxMax, itemBoxes[i].boundsMin, itemBoxes[i].boundsMax))
+					items.push_back(this->items[i]);
+			}
+		}
+		else
+		{
+			stack.push_back(n.first);
+			stack.push_back(n.first + 1);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Finds the item whose box the ray enters first, visiting
+// the nearer child first so farther ones are usually
+// skipped.  Returns false if the ray hits nothing within
+// maxDistance.
+//
+// origin      - Where the ray starts
+// direction   - Which way it goes (distances are in units
+//               of its length)
+// maxDistance - How far to look
+// hit         - The closest item and its distance, on success
+// --------------------------------------------------------
+bool Bvh::Raycast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, BvhRayHit& hit) const
+{
+	if (nodes.empty())
+		return false;
+
+	// Division by zero gives infinity, which the slab test handles
+	XMFLOAT3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+	float closest = maxDistance;
+	bool found = false;
+
+	std::vector<unsigned int> stack;
+	stack.reserve(InitialStackSize);
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const BvhNode& n = nodes[stack.back()];
+		stack.pop_back();
+
+		// Checked again here, since something nearer may have been hit
+		// since this node was pushed
+		if (RayBoxDistance(origin, inverseDirection, closest, n.boundsMin, n.boundsMax) == FLT_MAX)
+			continue;
+
+		if (n.count > 0)
+		{
+			for (unsigned int i = n.first; i < n.first + n.count; i++)
+			{
+				float distance = RayBoxDistance(origin, inverseDirection, closest, itemBoxes[i].boundsMin, itemBoxes[i].boundsMax);
+				if (distance != FLT_MAX && (!found || distance < closest))
+				{
+					closest = distance;
+					hit.item = items[i];
+					hit.distance = distance;
+					found = true;
+				}
+			}
+			continue;
+		}
+
+		// Farther child goes on the stack first, so the nearer one's next
+		const BvhNode& left = nodes[n.first];
+		const BvhNode& right = nodes[n.first + 1];
+		float leftDistance = RayBoxDistance(origin, inverseDirection, closest, left.boundsMin, left.boundsMax);
+		float rightDistance = RayBoxDistance(origin, inverseDirection, closest, right.boundsMin, right.boundsMax);
+		unsigned int nearer = leftDistance <= rightDistance ? n.first : n.first + 1;
+		unsigned int farther = nearer == n.first ? n.first + 1 : n.first;
+		float nearerDistance = std::min(leftDistance, rightDistance);
+		float fartherDistance = std::max(leftDistance, rightDistance);
+
+		if (fartherDistance != FLT_MAX)
+			stack.push_back(farther);
+		if (nearerDistance != FLT_MAX)
+			stack.push_back(nearer);
+	}
+
+	return found;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Frustum.h"
+
+// --------------------------------------------------------
+// A bounding volume hierarchy over a set of boxes (usually
+// one per entity, in world space), for answering "what's
+// in here?" without testing every box:
+//
+//  - Frustum queries, for culling
+//  - Ray casts, for picking
+//  - Sphere and box queries, for whatever's nearby
+//
+// Build() splits boxes by the surface area heuristic, which
+// weighs each split by how likely a random ray or query is
+// to have to look inside each half.  When boxes move, Refit()
+// grows and shrinks the existing nodes to fit, which is much
+// cheaper than rebuilding but slowly makes the tree worse -
+// so it also applies tree rotations (Kopta et al., "Fast,
+// Effective BVH Updates for Animated Scenes"), swapping a
+// child with a grandchild wherever that shrinks the tree.
+// Rebuild once the boxes have moved a lot - comparing the
+// stats' cost to buildCost says how much worse it's gotten.
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+struct BvhNode
+{
+	DirectX::XMFLOAT3 boundsMin;
+	unsigned int first;		// First item for leaves, first of two child nodes otherwise
+	DirectX::XMFLOAT3 boundsMax;
+	unsigned int count;		// Items in a leaf, 0 for inner nodes
+};
+
+struct BvhRayHit
+{
+	unsigned int item;
+	float distance;			// Along the ray to where it enters the item's box
+};
+
+struct BvhStats
+{
+	unsigned int nodeCount = 0;
+	unsigned int leafCount = 0;
+	unsigned int depth = 0;
+	unsigned int rotations = 0;		// Done by the last Refit()
+	float cost = 0.0f;				// Surface area heuristic cost, as of the last Build() or Refit()
+	float buildCost = 0.0f;			// The same, right after the last Build()
+	double buildMs = 0.0;
+	double refitMs = 0.0;
+};
+
+class Bvh
+{
+public:
+	Bvh();
+
+	void Build(
+		const DirectX::XMFLOAT3* boundsMins,
+		const DirectX::XMFLOAT3* boundsMaxs,
+		unsigned int count,
+		unsigned int maxLeafItems = 4);
+	void Refit(
+		const DirectX::XMFLOAT3* boundsMins,
+		const DirectX::XMFLOAT3* boundsMaxs,
+		bool rotate = true);
+	void Clear();
+
+	unsigned int GetItemCount() const;
+	const std::vector<BvhNode>& GetNodes() const;
+	const BvhStats& GetStats() const;
+
+	void QueryFrustum(const Frustum& frustum, std::vector<unsigned int>& items) const;
+	void QuerySphere(const DirectX::XMFLOAT3& center, float radius, std::vector<unsigned int>& items) const;
+	void QueryBox(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, std::vector<unsigned int>& items) const;
+	bool Raycast(
+		const DirectX::XMFLOAT3& origin,
+		const DirectX::XMFLOAT3& direction,
+		float maxDistance,
+		BvhRayHit& hit) const;
+
+private:
+	struct ItemBox
+	{
+		DirectX::XMFLOAT3 boundsMin;
+		DirectX::XMFLOAT3 boundsMax;
+	};
+
+	std::vector<BvhNode> nodes;			// Root first
+	std::vector<unsigned int> items;	// Leaves are ranges of this
+	std::vector<ItemBox> itemBoxes;		// In the same order as items
+	// Items being split up while building - moved around
+	// directly, rather than through indices, so each pass over
+	// a node's items reads memory in order
+	struct BuildItem
+	{
+		DirectX::XMFLOAT3 center;
+		unsigned int item;
+		DirectX::XMFLOAT3 boundsMin;
+		DirectX::XMFLOAT3 boundsMax;
+	};
+	std::vector<BuildItem> buildItems;
+	unsigned int maxLeafItems;
+	BvhStats stats;
+
+	float Subdivide(unsigned int node, unsigned int depth);
+	float RefitNode(
+		unsigned int node,
+		const DirectX::XMFLOAT3* boundsMins,
+		const DirectX::XMFLOAT3* boundsMaxs,
+		bool rotate);
+	float TryRotation(unsigned int node);
+	void AddSubtree(unsigned int node, std::vector<unsigned int>& items) const;
+};
@@ -0,0 +1,179 @@
+#include "CBufferLayout.h"
+
+#include <cstring>
+
+// Bytes in one constant register
+static const unsigned int RegisterSize = 16;
+
+static unsigned int AlignToRegister(unsigned int offset)
+{
+	return (offset + RegisterSize - 1) & ~(RegisterSize - 1);
+}
+
+// --------------------------------------------------------
+// Constructor - Starts empty
+// --------------------------------------------------------
+CBufferLayout::CBufferLayout()
+	:
+	end(0),
+	matchesSource(true)
+{
+}
+
+// --------------------------------------------------------
+// Bytes one element of a type takes up (both in the C++
+// struct and the constant buffer, not counting padding)
+// --------------------------------------------------------
+unsigned int CBufferLayout::GetTypeSize(CBufferType type)
+{
+	switch (type)
+	{
+	case CBufferFloat:
+	case CBufferInt:				return 4;
+	case CBufferFloat2:
+	case CBufferInt2:				return 8;
+	case CBufferFloat3:
+	case CBufferInt3:				return 12;
+	case CBufferFloat4:
+	case CBufferInt4:				return 16;
+	case CBufferFloat4x4:
+	case CBufferFloat4x4RowMajor:	return 64;
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Adds the next element of the cbuffer, and returns its
+// offset in the constant buffer
+//
+// name         - For Find() (should match the HLSL)
+// type         - What it is in HLSL
+// sourceOffset - Where it is in the C++ struct
+// arrayCount   - How many elements, if it's an array
+// sourceStride - Bytes between array elements in the C++
+//                struct (0 if they're packed tightly)
+// --------------------------------------------------------
+unsigned int CBufferLayout::Add(
+	const std::string& name,
+	CBufferType type,
+	size_t sourceOffset,
+	unsigned int arrayCount,
+	size_t sourceStride)
+{
+	unsigned int typeSize = GetTypeSize(type);
+	bool matrix = type == CBufferFloat4x4 || type == CBufferFloat4x4RowMajor;
+
+	CBufferElement element;
+	element.name = name;
+	element.type = type;
+	element.arrayCount = arrayCount;
+	element.sourceOffset = sourceOffset;
+	element.sourceStride = sourceStride > 0 ? sourceStride : typeSize;
+
+	// Arrays and matrices start a new register, and anything
+	// else does if it would straddle the next one
+	unsigned int offset = end;
+	if (arrayCount > 0 || matrix || (offset % RegisterSize) + typeSize > RegisterSize)
+		offset = AlignToRegister(offset);
+
+	// Every array element but the last fills whole registers
+	unsigned int count = arrayCount > 0 ? arrayCount : 1;
+	element.offset = offset;
+	element.size = (count - 1) * AlignToRegister(typeSize) + typeSize;
+	elements.push_back(element);
+	end = offset + element.size;
+
+	// Column-major matrices need transposing, so can't be copied
+	bool arrayMatches = count == 1 || element.sourceStride == AlignToRegister(typeSize);
+	if (offset != sourceOffset || !arrayMatches || type == CBufferFloat4x4)
+		matchesSource = false;
+
+	return offset;
+}
+
+// --------------------------------------------------------
+// Size of the whole cbuffer - always a whole number of
+// registers, as Direct3D requires
+// --------------------------------------------------------
+unsigned int CBufferLayout::GetSize() const
+{
+	return AlignToRegister(end);
+}
+
+unsigned int CBufferLayout::GetElementCount() const { return (unsigned int)elements.size(); }
+const CBufferElement& CBufferLayout::GetElement(unsigned int index) const { return elements[index]; }
+
+// --------------------------------------------------------
+// Index of the element with a name, or -1 if there isn't one
+// --------------------------------------------------------
+int CBufferLayout::Find(const std::string& name) const
+{
+	for (unsigned int i = 0; i < elements.size(); i++)
+	{
+		if (elements[i].name == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+// --------------------------------------------------------
+// Whether the C++ struct is already laid out like the
+// cbuffer, so packing is a single copy
+// --------------------------------------------------------
+bool CBufferLayout::MatchesSource() const
+{
+	return matchesSource;
+}
+
+// --------------------------------------------------------
+// Writes a C++ struct in the cbuffer's layout.  Padding is
+// left as it is - with mapped (write-combined) memory it's
+// cheaper not to touch it.
+//
+// source      - The struct the elements were added from
+// destination - At least GetSize() bytes
+// --------------------------------------------------------
+void CBufferLayout::Pack(const void* source, void* destination) const
+{
+	const unsigned char* src = (const unsigned char*)source;
+	unsigned char* dest = (unsigned char*)destination;
+
+	if (matchesSource)
+	{
+		memcpy(dest, src, end);
+		return;
+	}
+
+	for (unsigned int i = 0; i < elements.size(); i++)
+	{
+		const CBufferElement& e = elements[i];
+		unsigned int typeSize = GetTypeSize(e.type);
+		unsigned int destStride = AlignToRegister(typeSize);
+		unsigned int count = e.arrayCount > 0 ? e.arrayCount : 1;
+
+		for (unsigned int a = 0; a < count; a++)
+		{
+			const unsigned char* from = src + e.sourceOffset + a * e.sourceStride;
+			unsigned char* to = dest + e.offset + a * destStride;
+
+			if (e.type == CBufferFloat4x4)
+			{
+				// Transposed on the side, so the destination is
+				// written in order
+				float m[16];
+				float t[16];
+				memcpy(m, from, sizeof(m));
+				for (unsigned int r = 0; r < 4; r++)
+				{
+					for (unsigned int c = 0; c < 4; c++)
+						t[c * 4 + r] = m[r * 4 + c];
+				}
+				memcpy(to, t, sizeof(t));
+			}
+			else
+			{
+				memcpy(to, from, typeSize);
+			}
+		}
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// The types a constant buffer element can have.  Ints and
+// floats pack the same way, so the Int types are just for
+// readability (HLSL bools are 4 bytes too - use Int).
+//
+// Float4x4 is HLSL's default column_major matrix, so packing
+// transposes the row-major source (like an XMFLOAT4X4).
+// Float4x4RowMajor is for "row_major float4x4" and is copied
+// as is.
+// --------------------------------------------------------
+enum CBufferType
+{
+	CBufferFloat,
+	CBufferFloat2,
+	CBufferFloat3,
+	CBufferFloat4,
+	CBufferInt,
+	CBufferInt2,
+	CBufferInt3,
+	CBufferInt4,
+	CBufferFloat4x4,
+	CBufferFloat4x4RowMajor
+};
+
+struct CBufferElement
+{
+	std::string name;
+	CBufferType type;
+	unsigned int arrayCount;	// 0 if it isn't an array
+	size_t sourceOffset;		// In the C++ struct
+	size_t sourceStride;		// Between array elements in the C++ struct
+	unsigned int offset;		// In the constant buffer
+	unsigned int size;			// In the constant buffer, including padding between array elements
+};
+
+// --------------------------------------------------------
+// Where the members of a C++ struct end up in an HLSL
+// cbuffer, following HLSL's packing rules:
+//
+//  - Constants are 16-byte registers, and nothing but
+//    arrays and matrices may straddle two of them
+//  - Arrays and matrices start a new register, and each
+//    array element does too - so a float[4] takes up four
+//    registers, not one
+//  - Whatever follows an array can pack into the unused
+//    end of its last register
+//
+// Elements are added in the cbuffer's order, each with its
+// offset in the C++ struct (use offsetof()).  Pack() then
+// writes the struct in the cbuffer's layout - a straight
+// copy when the two already match.
+//
+//   CBufferLayout layout;
+//   layout.Add("viewProjection", CBufferFloat4x4, offsetof(DrawData, viewProjection));
+//   layout.Add("colorTint", CBufferFloat4, offsetof(DrawData, colorTint));
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+class CBufferLayout
+{
+public:
+	CBufferLayout();
+
+	static unsigned int GetTypeSize(CBufferType type);
+
+	unsigned int Add(
+		const std::string& name,
+		CBufferType type,
+		size_t sourceOffset,
+		unsigned int arrayCount = 0,
+		size_t sourceStride = 0);
+
+	unsigned int GetSize() const;
+	unsigned int GetElementCount() const;
+	const CBufferElement& GetElement(unsigned int index) const;
+	int Find(const std::string& name) const;
+	bool MatchesSource() const;
+
+	void Pack(const void* source, void* destination) const;
+
+private:
+	std::vector<CBufferElement> elements;
+	unsigned int end;			// Just past the last element
+	bool matchesSource;			// Every element is where the C++ struct has it
+};
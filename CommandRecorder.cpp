@@ -0,0 +1,201 @@
+#include "CommandRecorder.h"
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// Pre-allocates space for a known number of commands
+// --------------------------------------------------------
+void CommandList::Reserve(unsigned int commandCount)
+{
+	commands.reserve(commandCount);
+}
+
+// --------------------------------------------------------
+// Removes every command, keeping the memory for reuse
+// --------------------------------------------------------
+void CommandList::Clear()
+{
+	commands.clear();
+}
+
+// --------------------------------------------------------
+// Number of commands recorded since the last Clear()
+// --------------------------------------------------------
+unsigned int CommandList::GetCommandCount() const
+{
+	return (unsigned int)commands.size();
+}
+
+// --------------------------------------------------------
+// Issues every recorded command to another recorder, in
+// the order they were recorded
+// --------------------------------------------------------
+void CommandList::Replay(CommandRecorder& target) const
+{
+	for (unsigned int i = 0; i < commands.size(); i++)
+	{
+		const Command& c = commands[i];
+		switch (c.type)
+		{
+		case CommandSetInputLayout:		target.SetInputLayout(c.arg0); break;
+		case CommandSetVertexShader:	target.SetVertexShader(c.arg0); break;
+		case CommandSetPixelShader:		target.SetPixelShader(c.arg0); break;
+		case CommandSetInstanceBuffer:	target.SetInstanceBuffer(c.arg0); break;
+		case CommandSetMesh:			target.SetMesh(c.arg0); break;
+		case CommandSetDrawConstants:	target.SetDrawConstants(c.arg0); break;
+		case CommandDrawInstanced:		target.DrawInstanced(c.arg0, c.arg1, c.arg2); break;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Recording - each just appends a command
+// --------------------------------------------------------
+void CommandList::SetInputLayout(unsigned int id) { Add(CommandSetInputLayout, id); }
+void CommandList::SetVertexShader(unsigned int id) { Add(CommandSetVertexShader, id); }
+void CommandList::SetPixelShader(unsigned int id) { Add(CommandSetPixelShader, id); }
+void CommandList::SetInstanceBuffer(unsigned int id) { Add(CommandSetInstanceBuffer, id); }
+void CommandList::SetMesh(unsigned int id) { Add(CommandSetMesh, id); }
+void CommandList::SetDrawConstants(unsigned int offset) { Add(CommandSetDrawConstants, offset); }
+void CommandList::DrawInstanced(unsigned int instanceCount, unsigned int firstInstance, unsigned int lod) { Add(CommandDrawInstanced, instanceCount, firstInstance, lod); }
+
+void CommandList::Add(CommandType type, unsigned int arg0, unsigned int arg1, unsigned int arg2)
+{
+	Command c;
+	c.type = type;
+	c.arg0 = arg0;
+	c.arg1 = arg1;
+	c.arg2 = arg2;
+	commands.push_back(c);
+}
+
+
+// --------------------------------------------------------
+// Constructor - Starts with nothing counted
+// --------------------------------------------------------
+NullCommandRecorder::NullCommandRecorder()
+{
+	Reset();
+}
+
+// --------------------------------------------------------
+// Zeroes every count
+// --------------------------------------------------------
+void NullCommandRecorder::Reset()
+{
+	stateChangeCount = 0;
+	drawCount = 0;
+	instanceCount = 0;
+}
+
+// --------------------------------------------------------
+// Getters for the counts since the last Reset()
+// --------------------------------------------------------
+unsigned long long NullCommandRecorder::GetStateChangeCount() const { return stateChangeCount; }
+unsigned long long NullCommandRecorder::GetDrawCount() const { return drawCount; }
+unsigned long long NullCommandRecorder::GetInstanceCount() const { return instanceCount; }
+
+// --------------------------------------------------------
+// "Recording" - each just counts the command
+// --------------------------------------------------------
+void NullCommandRecorder::SetInputLayout(unsigned int /*id*/) { stateChangeCount++; }
+void NullCommandRecorder::SetVertexShader(unsigned int /*id*/) { stateChangeCount++; }
+void NullCommandRecorder::SetPixelShader(unsigned int /*id*/) { stateChangeCount++; }
+void NullCommandRecorder::SetInstanceBuffer(unsigned int /*id*/) { stateChangeCount++; }
+void NullCommandRecorder::SetMesh(unsigned int /*id*/) { stateChangeCount++; }
+void NullCommandRecorder::SetDrawConstants(unsigned int /*offset*/) { stateChangeCount++; }
+
+void NullCommandRecorder::DrawInstanced(unsigned int instanceCount, unsigned int /*firstInstance*/, unsigned int /*lod*/)
+{
+	drawCount++;
+	this->instanceCount += instanceCount;
+}
+
+
+// --------------------------------------------------------
+// Constructor
+//
+// target - Receives every chunk's commands in SubmitChunks()
+// --------------------------------------------------------
+CommandListBackend::CommandListBackend(CommandRecorder& target)
+	:
+	target(target),
+	activeChunks(0)
+{
+}
+
+// --------------------------------------------------------
+// Makes sure there's an empty list for every chunk
+// --------------------------------------------------------
+void CommandListBackend::BeginChunks(unsigned int chunkCount)
+{
+	if (chunkLists.size() < chunkCount)
+		chunkLists.resize(chunkCount);
+
+	for (unsigned int i = 0; i < chunkCount; i++)
+		chunkLists[i].Clear();
+
+	activeChunks = chunkCount;
+}
+
+CommandRecorder& CommandListBackend::GetChunkRecorder(unsigned int chunk)
+{
+	return chunkLists[chunk];
+}
+
+// --------------------------------------------------------
+// Nothing to do - the list is ready as soon as it's recorded
+// --------------------------------------------------------
+void CommandListBackend::FinishChunk(unsigned int /*chunk*/)
+{
+}
+
+// --------------------------------------------------------
+// Replays each chunk's list into the target, in order
+// --------------------------------------------------------
+void CommandListBackend::SubmitChunks()
+{
+	for (unsigned int i = 0; i < activeChunks; i++)
+		chunkLists[i].Replay(target);
+
+	activeChunks = 0;
+}
+
+
+// --------------------------------------------------------
+// Records [0, count) in chunks across threads, and submits
+// them in order once they're all recorded
+//
+// jobs      - Threads to record on
+// backend   - Where chunks are recorded and submitted
+// count     - Total number of items to record
+// chunkSize - Items per chunk
+// record    - Records a range of items into a recorder
+// --------------------------------------------------------
+void RecordParallel(
+	JobSystem& jobs,
+	RecordingBackend& backend,
+	unsigned int count,
+	unsigned int chunkSize,
+	const RecordFunction& record)
+{
+	if (count == 0)
+		return;
+
+	if (chunkSize == 0)
+		chunkSize = 1;
+
+	// Each chunk always covers the same items, so the
+	// submission order matches a single-threaded recording
+	unsigned int chunkCount = (count + chunkSize - 1) / chunkSize;
+	backend.BeginChunks(chunkCount);
+
+	jobs.ParallelFor(count, chunkSize,
+		[&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+		{
+			unsigned int chunk = begin / chunkSize;
+			record(backend.GetChunkRecorder(chunk), begin, end);
+			backend.FinishChunk(chunk);
+		});
+
+	backend.SubmitChunks();
+}
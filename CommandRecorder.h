@@ -0,0 +1,169 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class JobSystem;
+
+// --------------------------------------------------------
+// Everything draw submission needs, in API-neutral terms.
+// Resources are referred to by id, and each backend maps
+// those ids onto its own objects.
+// --------------------------------------------------------
+class CommandRecorder
+{
+public:
+	virtual ~CommandRecorder() {}
+
+	virtual void SetInputLayout(unsigned int id) = 0;
+	virtual void SetVertexShader(unsigned int id) = 0;
+	virtual void SetPixelShader(unsigned int id) = 0;
+	virtual void SetInstanceBuffer(unsigned int id) = 0;
+	virtual void SetMesh(unsigned int id) = 0;
+
+	// Binds the per-draw constants written at an offset into
+	// this frame's constants
+	virtual void SetDrawConstants(unsigned int offset) = 0;
+
+	// Draws instances of one of the current mesh's levels of detail,
+	// reading per-instance data starting at firstInstance in the
+	// current instance buffer
+	virtual void DrawInstanced(unsigned int instanceCount, unsigned int firstInstance, unsigned int lod) = 0;
+};
+
+// --------------------------------------------------------
+// Records commands into memory so they can be replayed
+// later, in order, into another recorder - usually one
+// that talks to the real API on the main thread
+// --------------------------------------------------------
+class CommandList : public CommandRecorder
+{
+public:
+	void Reserve(unsigned int commandCount);
+	void Clear();
+	unsigned int GetCommandCount() const;
+
+	void Replay(CommandRecorder& target) const;
+
+	void SetInputLayout(unsigned int id);
+	void SetVertexShader(unsigned int id);
+	void SetPixelShader(unsigned int id);
+	void SetInstanceBuffer(unsigned int id);
+	void SetMesh(unsigned int id);
+	void SetDrawConstants(unsigned int offset);
+	void DrawInstanced(unsigned int instanceCount, unsigned int firstInstance, unsigned int lod);
+
+private:
+	enum CommandType
+	{
+		CommandSetInputLayout,
+		CommandSetVertexShader,
+		CommandSetPixelShader,
+		CommandSetInstanceBuffer,
+		CommandSetMesh,
+		CommandSetDrawConstants,
+		CommandDrawInstanced
+	};
+
+	// Small and fixed-size, so recording is just a push_back
+	struct Command
+	{
+		CommandType type;
+		unsigned int arg0;
+		unsigned int arg1;
+		unsigned int arg2;
+	};
+
+	std::vector<Command> commands;
+
+	void Add(CommandType type, unsigned int arg0, unsigned int arg1 = 0, unsigned int arg2 = 0);
+};
+
+// --------------------------------------------------------
+// Throws commands away, just counting them - for running
+// and timing the recording side without a GPU
+// --------------------------------------------------------
+class NullCommandRecorder : public CommandRecorder
+{
+public:
+	NullCommandRecorder();
+
+	void Reset();
+	unsigned long long GetStateChangeCount() const;
+	unsigned long long GetDrawCount() const;
+	unsigned long long GetInstanceCount() const;
+
+	void SetInputLayout(unsigned int id);
+	void SetVertexShader(unsigned int id);
+	void SetPixelShader(unsigned int id);
+	void SetInstanceBuffer(unsigned int id);
+	void SetMesh(unsigned int id);
+	void SetDrawConstants(unsigned int offset);
+	void DrawInstanced(unsigned int instanceCount, unsigned int firstInstance, unsigned int lod);
+
+private:
+	unsigned long long stateChangeCount;
+	unsigned long long drawCount;
+	unsigned long long instanceCount;
+};
+
+// --------------------------------------------------------
+// Where chunks of a frame get recorded when recording on
+// several threads at once
+//
+//  - BeginChunks() runs on the submitting thread first
+//  - GetChunkRecorder() and FinishChunk() run on whichever
+//    thread records that chunk (one thread per chunk)
+//  - SubmitChunks() runs on the submitting thread last, and
+//    must submit every chunk in order
+// --------------------------------------------------------
+class RecordingBackend
+{
+public:
+	virtual ~RecordingBackend() {}
+
+	virtual void BeginChunks(unsigned int chunkCount) = 0;
+	virtual CommandRecorder& GetChunkRecorder(unsigned int chunk) = 0;
+	virtual void FinishChunk(unsigned int chunk) = 0;
+	virtual void SubmitChunks() = 0;
+};
+
+// --------------------------------------------------------
+// Records each chunk into its own CommandList, then replays
+// them all into a single target recorder.  Works with any
+// API, as long as its recorder is used by just one thread.
+// --------------------------------------------------------
+class CommandListBackend : public RecordingBackend
+{
+public:
+	CommandListBackend(CommandRecorder& target);
+
+	void BeginChunks(unsigned int chunkCount);
+	CommandRecorder& GetChunkRecorder(unsigned int chunk);
+	void FinishChunk(unsigned int chunk);
+	void SubmitChunks();
+
+private:
+	CommandRecorder& target;
+
+	// Kept between frames so recording doesn't allocate once warmed up
+	std::vector<CommandList> chunkLists;
+	unsigned int activeChunks;
+};
+
+// --------------------------------------------------------
+// Splits [0, count) into chunks, records each one through
+// the backend on the job system's threads, then submits
+// them all in order on the calling thread
+//
+// record - Records items [begin, end) into the recorder
+// --------------------------------------------------------
+typedef std::function<void(CommandRecorder& recorder, unsigned int begin, unsigned int end)> RecordFunction;
+
+void RecordParallel(
+	JobSystem& jobs,
+	RecordingBackend& backend,
+	unsigned int count,
+	unsigned int chunkSize,
+	const RecordFunction& record);
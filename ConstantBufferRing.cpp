@@ -0,0 +1,289 @@
+#include "ConstantBufferRing.h"
+
+#include <cstring>
+
+using namespace Microsoft::WRL;
+
+// Bytes in one shader constant
+static const unsigned int ConstantSize = 16;
+
+static unsigned int AlignUp(unsigned int value, unsigned int alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// --------------------------------------------------------
+// Constructor - Checks whether the device can bind by
+// offset, and creates the buffer
+//
+// device   - Creates the buffer and fence queries
+// context  - The immediate context, which maps the buffer
+//            and ends each frame
+// capacity - Starting size in bytes (grows as needed)
+// --------------------------------------------------------
+ConstantBufferRing::ConstantBufferRing(
+	ComPtr<ID3D11Device> device,
+	ComPtr<ID3D11DeviceContext> context,
+	unsigned int capacity)
+	:
+	device(device),
+	context(context),
+	bindByOffset(false),
+	mapped(0),
+	freshBuffer(true),
+	frameNumber(1),
+	waitCount(0)
+{
+	// Binding by offset and mapping constant buffers with
+	// NO_OVERWRITE are both optional, even on 11.1
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	ComPtr<ID3D11DeviceContext1> context1;
+	bindByOffset =
+		SUCCEEDED(context.As(&context1)) &&
+		SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+		options.ConstantBufferOffsetting &&
+		options.MapNoOverwriteOnDynamicConstantBuffer;
+
+	D3D11_QUERY_DESC queryDesc = {};
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	for (unsigned int i = 0; i < MaxConstantFramesInFlight; i++)
+		device->CreateQuery(&queryDesc, fences[i].GetAddressOf());
+
+	Resize(capacity);
+}
+
+bool ConstantBufferRing::IsBindingByOffset() const { return bindByOffset; }
+unsigned int ConstantBufferRing::GetCapacity() const { return (unsigned int)allocator.GetCapacity(); }
+unsigned int ConstantBufferRing::GetWaitCount() const { return waitCount; }
+const RingAllocatorStats& ConstantBufferRing::GetStats() const { return allocator.GetStats(); }
+
+// --------------------------------------------------------
+// Starts a frame's writes: frees whatever the GPU has
+// finished with, grows the buffer if the frame might not
+// fit, and maps it
+//
+// expectedBytes - Roughly what the frame will allocate (in
+//                 whole 256-byte blocks)
+// --------------------------------------------------------
+void ConstantBufferRing::BeginFrame(unsigned int expectedBytes)
+{
+	RetireFinishedFrames();
+
+	// Room for this frame with the GPU as far behind as it's
+	// allowed to get - growing starts over with a new buffer,
+	// and Direct3D keeps the old one alive for the GPU
+	unsigned int needed = expectedBytes * MaxConstantFramesInFlight;
+	if (needed > allocator.GetCapacity())
+	{
+		unsigned int doubled = (unsigned int)allocator.GetCapacity() * 2;
+		Resize(needed > doubled ? needed : doubled);
+	}
+
+	// Fence queries are reused, so the oldest frame has to be
+	// finished before its query is
+	while (allocator.GetFramesInFlight() >= MaxConstantFramesInFlight && WaitForOldestFrame())
+	{
+	}
+
+	if (!bindByOffset)
+	{
+		mapped = memory.data();
+		return;
+	}
+
+	// A new buffer has to be discarded the first time
+	D3D11_MAPPED_SUBRESOURCE map = {};
+	D3D11_MAP type = freshBuffer ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (SUCCEEDED(context->Map(buffer.Get(), 0, type, 0, &map)))
+	{
+		mapped = (unsigned char*)map.pData;
+		freshBuffer = false;
+	}
+}
+
+// --------------------------------------------------------
+// Reserves room for one draw's constants, returning where
+// to write them (0 if it can't).  Waits for the GPU if
+// every range is still in use.
+//
+// size   - Bytes of constants
+// offset - Set to the range's offset, for Bind()
+// --------------------------------------------------------
+void* ConstantBufferRing::Allocate(unsigned int size, unsigned int& offset)
+{
+	if (!mapped)
+		return 0;
+
+	// Binding by offset works in blocks of 16 constants
+	unsigned int alignment = bindByOffset ? ConstantBufferAlignment : ConstantSize;
+	unsigned int bytes = AlignUp(size, alignment);
+
+	size_t at = allocator.Allocate(bytes, alignment);
+	while (at == InvalidRingOffset && WaitForOldestFrame())
+		at = allocator.Allocate(bytes, alignment);
+
+	if (at == InvalidRingOffset)
+		return 0;
+
+	offset = (unsigned int)at;
+	return mapped + at;
+}
+
+// --------------------------------------------------------
+// Unmaps the buffer - call after the frame's last Allocate()
+// and before any draw using its constants
+// --------------------------------------------------------
+void ConstantBufferRing::EndWrites()
+{
+	if (bindByOffset && mapped)
+		context->Unmap(buffer.Get(), 0);
+
+	mapped = 0;
+}
+
+// --------------------------------------------------------
+// Ends the frame, after its last draw has been submitted
+// --------------------------------------------------------
+void ConstantBufferRing::EndFrame()
+{
+	EndWrites();
+
+	allocator.EndFrame(frameNumber);
+	if (bindByOffset)
+		context->End(fences[frameNumber % MaxConstantFramesInFlight].Get());
+	else
+		allocator.Retire(frameNumber);	// Bind() already copied everything out
+
+	frameNumber++;
+}
+
+// --------------------------------------------------------
+// Binds one draw's constants to a slot of both the vertex
+// and pixel shader
+//
+// context        - Immediate or deferred context to bind on
+// context1       - The same context's 11.1 interface (needed
+//                  when binding by offset)
+// slot           - Constant buffer register (b0 is 0)
+// offset         - From Allocate()
+// size           - Bytes of constants
+// fallbackBuffer - The caller's own buffer for when binding
+//                  by offset isn't supported (created here)
+// --------------------------------------------------------
+void ConstantBufferRing::Bind(
+	ID3D11DeviceContext* context,
+	ID3D11DeviceContext1* context1,
+	unsigned int slot,
+	unsigned int offset,
+	unsigned int size,
+	ComPtr<ID3D11Buffer>& fallbackBuffer) const
+{
+	if (bindByOffset)
+	{
+		if (!context1)
+			return;
+
+		// In constants, rounded up to the blocks binding works in
+		UINT firstConstant = offset / ConstantSize;
+		UINT constantCount = AlignUp(size, ConstantBufferAlignment) / ConstantSize;
+		ID3D11Buffer* buffers[] = { buffer.Get() };
+		context1->VSSetConstantBuffers1(slot, 1, buffers, &firstConstant, &constantCount);
+		context1->PSSetConstantBuffers1(slot, 1, buffers, &firstConstant, &constantCount);
+		return;
+	}
+
+	// Created (or grown) the first time it's too small
+	unsigned int bytes = AlignUp(size, ConstantSize);
+	D3D11_BUFFER_DESC desc = {};
+	if (fallbackBuffer)
+		fallbackBuffer->GetDesc(&desc);
+
+	if (desc.ByteWidth < bytes)
+	{
+		desc.Usage				= D3D11_USAGE_DYNAMIC;
+		desc.ByteWidth			= bytes;
+		desc.BindFlags			= D3D11_BIND_CONSTANT_BUFFER;
+		desc.CPUAccessFlags		= D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags			= 0;
+		desc.StructureByteStride = 0;
+
+		fallbackBuffer.Reset();
+		device->CreateBuffer(&desc, 0, fallbackBuffer.GetAddressOf());
+	}
+
+	D3D11_MAPPED_SUBRESOURCE map = {};
+	if (SUCCEEDED(context->Map(fallbackBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &map)))
+	{
+		memcpy(map.pData, &memory[offset], size);
+		context->Unmap(fallbackBuffer.Get(), 0);
+	}
+
+	context->VSSetConstantBuffers(slot, 1, fallbackBuffer.GetAddressOf());
+	context->PSSetConstantBuffers(slot, 1, fallbackBuffer.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Starts over with room for a given number of bytes,
+// forgetting every frame
+// --------------------------------------------------------
+void ConstantBufferRing::Resize(unsigned int capacity)
+{
+	capacity = AlignUp(capacity > 0 ? capacity : ConstantBufferAlignment, ConstantBufferAlignment);
+	allocator.Reset(capacity);
+
+	if (!bindByOffset)
+	{
+		memory.resize(capacity);
+		return;
+	}
+
+	D3D11_BUFFER_DESC desc	= {};
+	desc.Usage				= D3D11_USAGE_DYNAMIC;			// Written every frame
+	desc.ByteWidth			= capacity;
+	desc.BindFlags			= D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags		= D3D11_CPU_ACCESS_WRITE;		// So we can Map() it
+	desc.MiscFlags			= 0;
+	desc.StructureByteStride = 0;
+
+	buffer.Reset();
+	device->CreateBuffer(&desc, 0, buffer.GetAddressOf());
+	freshBuffer = true;
+}
+
+// --------------------------------------------------------
+// Frees frames the GPU has finished, oldest first, without
+// waiting on any
+// --------------------------------------------------------
+void ConstantBufferRing::RetireFinishedFrames()
+{
+	while (allocator.GetFramesInFlight() > 0)
+	{
+		unsigned long long oldest = allocator.GetOldestFence();
+		ID3D11Query* fence = fences[oldest % MaxConstantFramesInFlight].Get();
+		if (context->GetData(fence, 0, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+			break;
+
+		allocator.Retire(oldest);
+	}
+}
+
+// --------------------------------------------------------
+// Waits until the GPU finishes the oldest frame still in
+// flight, then frees it.  False if there wasn't one.
+// --------------------------------------------------------
+bool ConstantBufferRing::WaitForOldestFrame()
+{
+	if (allocator.GetFramesInFlight() == 0)
+		return false;
+
+	// Without DONOTFLUSH, so the GPU actually gets the work
+	// it's being waited on for
+	ID3D11Query* fence = fences[allocator.GetOldestFence() % MaxConstantFramesInFlight].Get();
+	while (context->GetData(fence, 0, 0, 0) == S_FALSE)
+	{
+	}
+
+	allocator.RetireOldest();
+	waitCount++;
+	return true;
+}
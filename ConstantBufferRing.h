@@ -0,0 +1,88 @@
+#pragma once
+
+#include <d3d11_1.h>
+#include <vector>
+#include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+
+#include "RingAllocator.h"
+
+// Ranges of a constant buffer bound by offset have to start
+// on a multiple of 16 constants (256 bytes), and cover a
+// multiple of 16 constants too
+static const unsigned int ConstantBufferAlignment = 256;
+
+// How many frames the GPU may be behind before BeginFrame()
+// waits for it
+static const unsigned int MaxConstantFramesInFlight = 3;
+
+// --------------------------------------------------------
+// Per-draw constants, written into one big dynamic constant
+// buffer rather than a buffer (or a Map()) per draw.
+//
+// Each frame's ranges are handed out front to back by a
+// RingAllocator, written into the buffer while it's mapped
+// once for the whole frame (with NO_OVERWRITE, so the GPU
+// can keep reading earlier frames), and bound with
+// *SSetConstantBuffers1() at their offsets.  An event query
+// ends each frame, and its ranges are only reused once the
+// GPU has passed it.
+//
+// Binding by offset needs Direct3D 11.1 and a driver that
+// supports it.  Without that, constants are written to
+// memory instead, and Bind() copies each draw's into a small
+// buffer of the recorder's own with a DISCARD map - slower,
+// but the same for the caller.
+//
+//   BeginFrame() -> Allocate()... -> EndWrites()
+//     -> draws, with Bind() -> EndFrame()
+//
+// All but Bind() are for the immediate context's thread
+// only.  Bind() just reads, so any number of recording
+// threads may call it between EndWrites() and EndFrame().
+// --------------------------------------------------------
+class ConstantBufferRing
+{
+public:
+	ConstantBufferRing(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		unsigned int capacity);
+
+	bool IsBindingByOffset() const;
+	unsigned int GetCapacity() const;
+	unsigned int GetWaitCount() const;
+	const RingAllocatorStats& GetStats() const;
+
+	void BeginFrame(unsigned int expectedBytes);
+	void* Allocate(unsigned int size, unsigned int& offset);
+	void EndWrites();
+	void EndFrame();
+
+	void Bind(
+		ID3D11DeviceContext* context,
+		ID3D11DeviceContext1* context1,
+		unsigned int slot,
+		unsigned int offset,
+		unsigned int size,
+		Microsoft::WRL::ComPtr<ID3D11Buffer>& fallbackBuffer) const;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	bool bindByOffset;
+
+	RingAllocator allocator;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;	// When binding by offset
+	std::vector<unsigned char> memory;				// When not
+	unsigned char* mapped;							// Where this frame's writes go
+	bool freshBuffer;								// Not mapped since it was created
+
+	// Frame fences - the query for frame N is N % MaxConstantFramesInFlight
+	Microsoft::WRL::ComPtr<ID3D11Query> fences[MaxConstantFramesInFlight];
+	unsigned long long frameNumber;
+	unsigned int waitCount;
+
+	void Resize(unsigned int capacity);
+	void RetireFinishedFrames();
+	bool WaitForOldestFrame();
+};
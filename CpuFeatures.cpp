@@ -0,0 +1,57 @@
+#include "CpuFeatures.h"
+
+#if CPU_X86 && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// --------------------------------------------------------
+// Asks the CPU (and OS) which instruction sets are usable
+//  - AVX also needs the OS to save the wider registers on
+//    context switches, which is what XGETBV reports
+// --------------------------------------------------------
+static CpuFeatures DetectCpuFeatures()
+{
+	CpuFeatures features;
+
+#if CPU_X86 && defined(_MSC_VER)
+	int info[4] = {};
+	__cpuid(info, 0);
+	int highestLeaf = info[0];
+
+	__cpuid(info, 1);
+	features.sse2 = (info[3] & (1 << 26)) != 0;
+	features.sse41 = (info[2] & (1 << 19)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool cpuAvx = (info[2] & (1 << 28)) != 0;
+	bool cpuFma = (info[2] & (1 << 12)) != 0;
+
+	bool osAvx = osxsave && (_xgetbv(0) & 0x6) == 0x6;
+	features.avx = cpuAvx && osAvx;
+	features.fma = cpuFma && osAvx;
+
+	if (highestLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		features.avx2 = features.avx && (info[1] & (1 << 5)) != 0;
+	}
+#elif CPU_X86 && (defined(__GNUC__) || defined(__clang__))
+	// These builtins already account for OS support
+	__builtin_cpu_init();
+	features.sse2 = __builtin_cpu_supports("sse2");
+	features.sse41 = __builtin_cpu_supports("sse4.1");
+	features.avx = __builtin_cpu_supports("avx");
+	features.avx2 = __builtin_cpu_supports("avx2");
+	features.fma = __builtin_cpu_supports("fma");
+#endif
+
+	return features;
+}
+
+// --------------------------------------------------------
+// Gets the supported instruction sets (detected on first call)
+// --------------------------------------------------------
+const CpuFeatures& GetCpuFeatures()
+{
+	static CpuFeatures features = DetectCpuFeatures();
+	return features;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// --------------------------------------------------------
+// Which instruction sets this compiler targets, and how to
+// compile a single function for a newer instruction set
+// than the rest of the project.
+//  - MSVC allows any intrinsic anywhere, so no attribute
+//    is needed; GCC and Clang need one per function
+// --------------------------------------------------------
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86 1
+#else
+#define CPU_X86 0
+#endif
+
+#if CPU_X86 && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
+
+// --------------------------------------------------------
+// Instruction sets supported by both the CPU and the OS,
+// detected once at runtime
+// --------------------------------------------------------
+struct CpuFeatures
+{
+	bool sse2 = false;
+	bool sse41 = false;
+	bool avx = false;
+	bool avx2 = false;
+	bool fma = false;
+};
+
+const CpuFeatures& GetCpuFeatures();
@@ -0,0 +1,197 @@
+#include "D3D11CommandRecorder.h"
+
+// --------------------------------------------------------
+// Constructor
+//
+// context   - Immediate or deferred context to issue to
+// resources - What each id refers to (must outlive this)
+// --------------------------------------------------------
+D3D11CommandRecorder::D3D11CommandRecorder(
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	const D3D11CommandResources& resources)
+	:
+	context(context),
+	resources(resources),
+	currentMesh(0)
+{
+	context.As(&context1);
+}
+
+// --------------------------------------------------------
+// State changes - each looks up the id and binds it
+// --------------------------------------------------------
+void D3D11CommandRecorder::SetInputLayout(unsigned int id)
+{
+	context->IASetInputLayout(resources.inputLayouts[id].Get());
+}
+
+void D3D11CommandRecorder::SetVertexShader(unsigned int id)
+{
+	context->VSSetShader(resources.vertexShaders[id].Get(), 0, 0);
+}
+
+void D3D11CommandRecorder::SetPixelShader(unsigned int id)
+{
+	context->PSSetShader(resources.pixelShaders[id].Get(), 0, 0);
+}
+
+void D3D11CommandRecorder::SetInstanceBuffer(unsigned int id)
+{
+	// Per-instance data always lives in input slot 1
+	UINT stride = resources.instanceStride;
+	UINT offset = 0;
+	context->IASetVertexBuffers(1, 1, resources.instanceBuffers[id].GetAddressOf(), &stride, &offset);
+}
+
+void D3D11CommandRecorder::SetMesh(unsigned int id)
+{
+	currentMesh = resources.meshes[id].get();
+	currentMesh->SetBuffers(context);
+}
+
+void D3D11CommandRecorder::SetDrawConstants(unsigned int offset)
+{
+	if (resources.drawConstants)
+	{
+		resources.drawConstants->Bind(context.Get(), context1.Get(), 0,
+			offset, resources.drawConstantSize, fallbackConstants);
+	}
+}
+
+// --------------------------------------------------------
+// Draws instances of whichever mesh was set last
+// --------------------------------------------------------
+void D3D11CommandRecorder::DrawInstanced(unsigned int instanceCount, unsigned int firstInstance, unsigned int lod)
+{
+	if (currentMesh)
+		currentMesh->DrawInstanced(context, instanceCount, firstInstance, lod);
+}
+
+
+// --------------------------------------------------------
+// Constructor - Deferred contexts are created as needed
+// in BeginChunks()
+// --------------------------------------------------------
+D3D11DeferredBackend::D3D11DeferredBackend(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext,
+	const D3D11CommandResources& resources)
+	:
+	device(device),
+	immediateContext(immediateContext),
+	resources(resources),
+	activeChunks(0)
+{
+}
+
+// --------------------------------------------------------
+// Makes sure there's a deferred context for every chunk,
+// and gives each one the immediate context's basic state
+// --------------------------------------------------------
+void D3D11DeferredBackend::BeginChunks(unsigned int chunkCount)
+{
+	while (chunks.size() < chunkCount)
+	{
+		Chunk chunk;
+		device->CreateDeferredContext(0, chunk.context.GetAddressOf());
+		chunk.recorder.reset(new D3D11CommandRecorder(chunk.context, resources));
+		chunks.push_back(std::move(chunk));
+	}
+
+	// Grab the state every chunk needs to start from
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv;
+	immediateContext->OMGetRenderTargets(1, rtv.GetAddressOf(), dsv.GetAddressOf());
+
+	D3D11_VIEWPORT viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE] = {};
+	UINT viewportCount = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	immediateContext->RSGetViewports(&viewportCount, viewports);
+
+	D3D11_PRIMITIVE_TOPOLOGY topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+	immediateContext->IAGetPrimitiveTopology(&topology);
+
+	for (unsigned int i = 0; i < chunkCount; i++)
+	{
+		ID3D11DeviceContext* deferred = chunks[i].context.Get();
+		deferred->OMSetRenderTargets(1, rtv.GetAddressOf(), dsv.Get());
+		deferred->RSSetViewports(viewportCount, viewports);
+		deferred->IASetPrimitiveTopology(topology);
+	}
+
+	activeChunks = chunkCount;
+}
+
+CommandRecorder& D3D11DeferredBackend::GetChunkRecorder(unsigned int chunk)
+{
+	return *chunks[chunk].recorder;
+}
+
+// --------------------------------------------------------
+// Turns the chunk's recorded calls into a command list.
+// Runs on the recording thread, which is the expensive part.
+// --------------------------------------------------------
+void D3D11DeferredBackend::FinishChunk(unsigned int chunk)
+{
+	chunks[chunk].context->FinishCommandList(FALSE, chunks[chunk].commandList.ReleaseAndGetAddressOf());
+}
+
+// --------------------------------------------------------
+// Executes every chunk's command list, in order
+// --------------------------------------------------------
+void D3D11DeferredBackend::SubmitChunks()
+{
+	for (unsigned int i = 0; i < activeChunks; i++)
+	{
+		// TRUE restores the immediate context's own state afterwards,
+		// so render targets and such are still bound for later draws
+		if (chunks[i].commandList)
+			immediateContext->ExecuteCommandList(chunks[i].commandList.Get(), TRUE);
+
+		chunks[i].commandList.Reset();
+	}
+
+	activeChunks = 0;
+}
+
+
+// --------------------------------------------------------
+// Constructor - Every chunk ends up replayed through a
+// recorder on the immediate context
+// --------------------------------------------------------
+D3D11CommandListBackend::D3D11CommandListBackend(
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext,
+	const D3D11CommandResources& resources)
+	:
+	CommandListBackend(immediateRecorder),	// Only stored by the base, not used until later
+	immediateRecorder(immediateContext, resources)
+{
+}
+
+
+// --------------------------------------------------------
+// Picks the best multithreaded recording backend for the
+// device.  Deferred contexts are only worth it when the
+// driver supports command lists natively - otherwise the
+// runtime emulates them, which is slower than replaying
+// our own lists.
+// --------------------------------------------------------
+std::unique_ptr<RecordingBackend> CreateD3D11RecordingBackend(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext,
+	const D3D11CommandResources& resources)
+{
+	D3D11_FEATURE_DATA_THREADING threading = {};
+	HRESULT hr = device->CheckFeatureSupport(D3D11_FEATURE_THREADING, &threading, sizeof(threading));
+
+	// Single-threaded devices can't create deferred contexts at all
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> test;
+	bool deferredAvailable =
+		SUCCEEDED(hr) &&
+		threading.DriverCommandLists &&
+		SUCCEEDED(device->CreateDeferredContext(0, test.GetAddressOf()));
+
+	if (deferredAvailable)
+		return std::unique_ptr<RecordingBackend>(new D3D11DeferredBackend(device, immediateContext, resources));
+
+	return std::unique_ptr<RecordingBackend>(new D3D11CommandListBackend(immediateContext, resources));
+}
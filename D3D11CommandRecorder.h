@@ -0,0 +1,118 @@
+#pragma once
+
+#include <d3d11.h>
+#include <memory>
+#include <vector>
+#include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+
+#include "CommandRecorder.h"
+#include "ConstantBufferRing.h"
+#include "Mesh.h"
+
+// --------------------------------------------------------
+// The Direct3D objects that command ids refer to - an id
+// is just an index into the matching list
+// --------------------------------------------------------
+struct D3D11CommandResources
+{
+	std::vector<Microsoft::WRL::ComPtr<ID3D11InputLayout>> inputLayouts;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11VertexShader>> vertexShaders;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11PixelShader>> pixelShaders;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11Buffer>> instanceBuffers;
+	std::vector<std::shared_ptr<Mesh>> meshes;
+	unsigned int instanceStride = 0;
+
+	// Per-draw constants, bound to b0 of both shaders - the
+	// ring must outlive this
+	const ConstantBufferRing* drawConstants = 0;
+	unsigned int drawConstantSize = 0;
+};
+
+// --------------------------------------------------------
+// Issues commands directly to a Direct3D context, which
+// may be the immediate context or a deferred one
+// --------------------------------------------------------
+class D3D11CommandRecorder : public CommandRecorder
+{
+public:
+	D3D11CommandRecorder(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		const D3D11CommandResources& resources);
+
+	void SetInputLayout(unsigned int id);
+	void SetVertexShader(unsigned int id);
+	void SetPixelShader(unsigned int id);
+	void SetInstanceBuffer(unsigned int id);
+	void SetMesh(unsigned int id);
+	void SetDrawConstants(unsigned int offset);
+	void DrawInstanced(unsigned int instanceCount, unsigned int firstInstance, unsigned int lod);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1;	// Null before Direct3D 11.1
+	const D3D11CommandResources& resources;
+	Mesh* currentMesh;
+
+	// Only used when the ring can't bind by offset
+	Microsoft::WRL::ComPtr<ID3D11Buffer> fallbackConstants;
+};
+
+// --------------------------------------------------------
+// Records each chunk into its own deferred context, then
+// executes the resulting command lists on the immediate
+// context, in order.
+//
+// Deferred contexts start out with default state, so each
+// one first copies the immediate context's render targets,
+// viewport and primitive topology.
+// --------------------------------------------------------
+class D3D11DeferredBackend : public RecordingBackend
+{
+public:
+	D3D11DeferredBackend(
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext,
+		const D3D11CommandResources& resources);
+
+	void BeginChunks(unsigned int chunkCount);
+	CommandRecorder& GetChunkRecorder(unsigned int chunk);
+	void FinishChunk(unsigned int chunk);
+	void SubmitChunks();
+
+private:
+	struct Chunk
+	{
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+		std::unique_ptr<D3D11CommandRecorder> recorder;
+		Microsoft::WRL::ComPtr<ID3D11CommandList> commandList;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext;
+	const D3D11CommandResources& resources;
+
+	// Kept between frames, since creating contexts isn't free
+	std::vector<Chunk> chunks;
+	unsigned int activeChunks;
+};
+
+// --------------------------------------------------------
+// Fallback for when deferred contexts aren't worthwhile:
+// chunks are recorded into API-neutral command lists and
+// replayed on the immediate context
+// --------------------------------------------------------
+class D3D11CommandListBackend : public CommandListBackend
+{
+public:
+	D3D11CommandListBackend(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext,
+		const D3D11CommandResources& resources);
+
+private:
+	D3D11CommandRecorder immediateRecorder;
+};
+
+std::unique_ptr<RecordingBackend> CreateD3D11RecordingBackend(
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> immediateContext,
+	const D3D11CommandResources& resources);
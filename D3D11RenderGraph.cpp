@@ -0,0 +1,189 @@
+#include "D3D11RenderGraph.h"
+
+using namespace Microsoft::WRL;
+
+// --------------------------------------------------------
+// Constructor
+//
+// context - The immediate context, which passes' targets
+//           are bound on
+// pool    - Where transient textures come from (must
+//           outlive this)
+// --------------------------------------------------------
+D3D11RenderGraph::D3D11RenderGraph(
+	ComPtr<ID3D11DeviceContext> context,
+	ResourcePool& pool)
+	:
+	context(context),
+	pool(pool)
+{
+}
+
+RenderGraph& D3D11RenderGraph::GetGraph() { return graph; }
+
+// --------------------------------------------------------
+// Forgets every pass and texture, ready to describe the
+// next frame
+// --------------------------------------------------------
+void D3D11RenderGraph::Clear()
+{
+	graph.Clear();
+	textures.clear();
+	transientIds.clear();
+	transientTextures.clear();
+}
+
+// --------------------------------------------------------
+// Adds a texture that only lives within the frame, which
+// gets default views for however it's bound (see
+// ResourcePool).  Returns its first version.
+//
+// name - For debugging, and must outlive the graph's use
+// desc - What it needs to be
+// --------------------------------------------------------
+RenderResourceId D3D11RenderGraph::CreateTexture(const char* name, const D3D11_TEXTURE2D_DESC& desc)
+{
+	Texture texture;
+	texture.desc = desc;
+	textures.push_back(texture);
+	return graph.CreateTransient(name);
+}
+
+// --------------------------------------------------------
+// Adds a texture owned outside the graph, by its views
+// (any of which can be null), returning its first version
+//
+// width, height - Its size, for the viewport of passes
+//                 targeting it
+// --------------------------------------------------------
+RenderResourceId D3D11RenderGraph::ImportTexture(
+	const char* name,
+	ComPtr<ID3D11RenderTargetView> rtv,
+	ComPtr<ID3D11DepthStencilView> dsv,
+	ComPtr<ID3D11ShaderResourceView> srv,
+	unsigned int width,
+	unsigned int height)
+{
+	Texture texture;
+	texture.desc = {};
+	texture.desc.Width = width;
+	texture.desc.Height = height;
+	texture.rtv = rtv;
+	texture.dsv = dsv;
+	texture.srv = srv;
+	textures.push_back(texture);
+	return graph.Import(name);
+}
+
+// --------------------------------------------------------
+// Compiles the graph, then gets a texture from the pool for
+// each transient that an executed pass uses - with the
+// executed passes' order as each transient's uses.  False
+// if the graph has a cycle.
+// --------------------------------------------------------
+bool D3D11RenderGraph::Compile()
+{
+	if (!graph.Compile())
+		return false;
+
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		if (graph.IsImported(i) || graph.GetFirstUse(i) == InvalidRenderGraphId)
+			continue;
+
+		transientIds.push_back(pool.DeclareTransientTexture(textures[i].desc, graph.GetFirstUse(i), graph.GetLastUse(i)));
+		transientTextures.push_back(i);
+	}
+
+	pool.AllocateTransients();
+	for (unsigned int i = 0; i < transientIds.size(); i++)
+	{
+		ResourceHandle handle = pool.GetTransient(transientIds[i]);
+		Texture& texture = textures[transientTextures[i]];
+		texture.rtv = pool.GetRenderTargetView(handle);
+		texture.dsv = pool.GetDepthStencilView(handle);
+		texture.srv = pool.GetShaderResourceView(handle);
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Runs the executed passes in order, binding each one's
+// targets first, then gives the transient textures back to
+// the pool
+// --------------------------------------------------------
+void D3D11RenderGraph::Execute()
+{
+	for (unsigned int i = 0; i < graph.GetExecutedPassCount(); i++)
+	{
+		RenderPassId pass = graph.GetExecutedPass(i);
+		BindTargets(pass);
+		graph.ExecutePass(pass);
+	}
+
+	pool.ReleaseTransients();
+}
+
+// --------------------------------------------------------
+// A version of a texture's views (null if it doesn't have
+// that kind, or is a transient that isn't used)
+// --------------------------------------------------------
+ID3D11RenderTargetView* D3D11RenderGraph::GetRenderTargetView(RenderResourceId resource) const
+{
+	return textures[graph.GetResource(resource)].rtv.Get();
+}
+
+ID3D11DepthStencilView* D3D11RenderGraph::GetDepthStencilView(RenderResourceId resource) const
+{
+	return textures[graph.GetResource(resource)].dsv.Get();
+}
+
+ID3D11ShaderResourceView* D3D11RenderGraph::GetShaderResourceView(RenderResourceId resource) const
+{
+	return textures[graph.GetResource(resource)].srv.Get();
+}
+
+// --------------------------------------------------------
+// Binds the color and depth targets a pass writes, in the
+// order it declared them, with a viewport covering the
+// first.  Passes that don't write any targets leave what's
+// bound alone.
+// --------------------------------------------------------
+void D3D11RenderGraph::BindTargets(RenderPassId pass)
+{
+	ID3D11RenderTargetView* rtvs[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
+	UINT rtvCount = 0;
+	ID3D11DepthStencilView* dsv = 0;
+	const Texture* sized = 0;
+
+	for (unsigned int i = 0; i < graph.GetPassAccessCount(pass); i++)
+	{
+		const RenderGraphAccess& access = graph.GetPassAccess(pass, i);
+		const Texture& texture = textures[access.resource];
+		if (!access.write)
+			continue;
+
+		if (access.target == RenderGraphColorTarget && rtvCount < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT)
+			rtvs[rtvCount++] = texture.rtv.Get();
+		else if (access.target == RenderGraphDepthTarget)
+			dsv = texture.dsv.Get();
+		else
+			continue;
+
+		if (!sized)
+			sized = &texture;
+	}
+
+	if (!sized)
+		return;
+
+	context->OMSetRenderTargets(rtvCount, rtvs, dsv);
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = (float)sized->desc.Width;
+	viewport.Height = (float)sized->desc.Height;
+	viewport.MinDepth = 0.0f;
+	viewport.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &viewport);
+}
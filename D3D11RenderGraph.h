@@ -0,0 +1,74 @@
+#pragma once
+
+#include <d3d11.h>
+#include <vector>
+#include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+
+#include "RenderGraph.h"
+#include "ResourcePool.h"
+
+// --------------------------------------------------------
+// Executes a RenderGraph whose resources are textures.
+//
+// Transient textures come from the resource pool each frame
+// (sharing a texture wherever their lifetimes allow) and go
+// back to it once the graph has executed.  Imported ones are
+// just views of textures owned elsewhere, like the back
+// buffer.
+//
+// Before each pass runs, its color and depth target writes
+// are bound, along with a viewport covering them - so passes
+// (and whatever follows presenting, which unbinds the back
+// buffer) never need to bind their own targets.
+//
+//   Clear() -> CreateTexture()/ImportTexture() and passes on
+//     GetGraph() -> Compile() -> Execute()
+// --------------------------------------------------------
+class D3D11RenderGraph
+{
+public:
+	D3D11RenderGraph(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		ResourcePool& pool);
+
+	RenderGraph& GetGraph();
+	void Clear();
+
+	RenderResourceId CreateTexture(const char* name, const D3D11_TEXTURE2D_DESC& desc);
+	RenderResourceId ImportTexture(
+		const char* name,
+		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv,
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv,
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv,
+		unsigned int width,
+		unsigned int height);
+
+	bool Compile();
+	void Execute();
+
+	ID3D11RenderTargetView* GetRenderTargetView(RenderResourceId resource) const;
+	ID3D11DepthStencilView* GetDepthStencilView(RenderResourceId resource) const;
+	ID3D11ShaderResourceView* GetShaderResourceView(RenderResourceId resource) const;
+
+private:
+	// Per graph resource
+	struct Texture
+	{
+		D3D11_TEXTURE2D_DESC desc;		// Only width and height, if imported
+		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv;
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	ResourcePool& pool;
+	RenderGraph graph;
+	std::vector<Texture> textures;
+
+	// Transients declared with the pool, and which texture
+	// each one is
+	std::vector<TransientId> transientIds;
+	std::vector<unsigned int> transientTextures;
+
+	void BindTargets(RenderPassId pass);
+};
@@ -1,10 +1,16 @@
 #include "DXCore.h"
 #include "Input.h"
+#include "PathHelpers.h"
+#include "Profiler.h"
 
 #include <dxgi1_5.h>
 #include <WindowsX.h>
 #include <sstream>
 
+// How many frames a released pooled resource is kept
+// around without being asked for again
+static const unsigned int MaxPooledIdleFrames = 300;
+
 // Define the static instance variable so our OS-level 
 // message handling function below can talk to our object
 DXCore* DXCore::DXCoreInstance = 0;
@@ -21,7 +27,7 @@ LRESULT DXCore::WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 }
 
 // --------------------------------------------------------
-// Constructor - Set up fields and timer
+// Constructor - Set up fields and clocks
 //
 // hInstance	- The application's OS-level handle (unique ID)
 // titleBarText - Text for the window's title bar
@@ -46,14 +52,17 @@ DXCore::DXCore(
 	deviceSupportsTearing(false),
 	titleBarStats(debugTitleBarStats),
 	dxFeatureLevel(D3D_FEATURE_LEVEL_11_0),
+	depthBuffer(InvalidResourceHandle),
 	fpsTimeElapsed(0),
 	fpsFrameCount(0),
-	previousTime(0),
-	currentTime(0),
 	hasFocus(true),
-	deltaTime(0),
-	startTime(0),
-	totalTime(0),
+	useFixedTimestep(false),
+	profilerDumpOnExit(false),
+	frameStatsDumpOnExit(false),
+	appClock(&systemTime),
+	gameplayClock(appClock),
+	uiClock(appClock),
+	debugClock(appClock),
 	hWnd(0)
 {
 	// Save a static reference to this object.
@@ -61,11 +70,6 @@ DXCore::DXCore(
 	//    it won't be able to directly interact with our DXCore object otherwise.
 	//  - (Yes, a singleton might be a safer choice here).
 	DXCoreInstance = this;
-
-	// Query performance counter for accurate timing information
-	__int64 perfFreq = 0;
-	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
-	perfCounterSeconds = 1.0 / (double)perfFreq;
 }
 
 // --------------------------------------------------------
@@ -78,8 +82,9 @@ DXCore::~DXCore()
 	// - If we weren't using smart pointers, we'd need to call
 	//   Release() on each Direct3D object created in DXCore
 
-	// Delete input manager singleton
+	// Delete input manager and profiler singletons
 	delete& Input::GetInstance();
+	delete& Profiler::GetInstance();
 }
 
 // --------------------------------------------------------
@@ -253,33 +258,12 @@ HRESULT DXCore::InitDirect3D()
 		}
 	}
 
+	// Textures and buffers that get reused, rather than
+	// created whenever they're needed
+	resourcePool.reset(new ResourcePool(device, MaxPooledIdleFrames));
+
 	// Create the Depth Buffer and associated Depth Stencil View
-	{
-		// Set up the description of the texture to use for the depth buffer
-		D3D11_TEXTURE2D_DESC depthStencilDesc	= {};
-		depthStencilDesc.Width					= windowWidth;
-		depthStencilDesc.Height					= windowHeight;
-		depthStencilDesc.MipLevels				= 1;
-		depthStencilDesc.ArraySize				= 1;
-		depthStencilDesc.Format					= DXGI_FORMAT_D24_UNORM_S8_UINT;
-		depthStencilDesc.Usage					= D3D11_USAGE_DEFAULT;
-		depthStencilDesc.BindFlags				= D3D11_BIND_DEPTH_STENCIL;
-		depthStencilDesc.CPUAccessFlags			= 0;
-		depthStencilDesc.MiscFlags				= 0;
-		depthStencilDesc.SampleDesc.Count		= 1;
-		depthStencilDesc.SampleDesc.Quality		= 0;
-
-		// Create the depth buffer texture resource
-		Microsoft::WRL::ComPtr<ID3D11Texture2D> depthBufferTexture;
-		device->CreateTexture2D(&depthStencilDesc, 0, depthBufferTexture.GetAddressOf());
-
-		// As long as the depth buffer texture was created successfully, 
-		// create the associated Depth Stencil View so we can use it for rendering
-		if (depthBufferTexture != 0)
-		{
-			device->CreateDepthStencilView(depthBufferTexture.Get(), 0,	depthBufferDSV.GetAddressOf());
-		}
-	}
+	CreateDepthBuffer();
 
 	// Bind the back buffer and depth buffer to the pipeline
 	// so these particular resources are used when rendering
@@ -321,6 +305,11 @@ void DXCore::OnResize()
 		backBufferRTV.Reset();
 		depthBufferDSV.Reset();
 
+		// Nothing sized for the old window is any use now
+		resourcePool->Release(depthBuffer);
+		depthBuffer = InvalidResourceHandle;
+		resourcePool->EvictUnused();
+
 		// Resize the underlying swap chain buffers,
 		// which essentially destroys and recreates them
 		swapChain->ResizeBuffers(
@@ -345,32 +334,7 @@ void DXCore::OnResize()
 	}
 
 	// Since the window size changed, we need a new depth buffer too!
-	{
-		// Set up the description of the texture to use for the depth buffer
-		D3D11_TEXTURE2D_DESC depthStencilDesc = {};
-		depthStencilDesc.Width = windowWidth;
-		depthStencilDesc.Height = windowHeight;
-		depthStencilDesc.MipLevels = 1;
-		depthStencilDesc.ArraySize = 1;
-		depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-		depthStencilDesc.Usage = D3D11_USAGE_DEFAULT;
-		depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-		depthStencilDesc.CPUAccessFlags = 0;
-		depthStencilDesc.MiscFlags = 0;
-		depthStencilDesc.SampleDesc.Count = 1;
-		depthStencilDesc.SampleDesc.Quality = 0;
-
-		// Create the depth buffer texture resource
-		Microsoft::WRL::ComPtr<ID3D11Texture2D> depthBufferTexture;
-		device->CreateTexture2D(&depthStencilDesc, 0, depthBufferTexture.GetAddressOf());
-
-		// As long as the depth buffer texture was created successfully, 
-		// create the associated Depth Stencil View so we can use it for rendering
-		if (depthBufferTexture != 0)
-		{
-			device->CreateDepthStencilView(depthBufferTexture.Get(), 0,	depthBufferDSV.GetAddressOf());
-		}
-	}
+	CreateDepthBuffer();
 
 	// Bind the back buffer and depth buffer to the pipeline
 	// so these particular resources are used when rendering
@@ -391,6 +355,31 @@ void DXCore::OnResize()
  	swapChain->GetFullscreenState(&isFullscreen, 0);
 }
 
+// --------------------------------------------------------
+// Gets a depth buffer (and its Depth Stencil View) the size
+// of the window from the resource pool
+// --------------------------------------------------------
+void DXCore::CreateDepthBuffer()
+{
+	// Set up the description of the texture to use for the depth buffer
+	D3D11_TEXTURE2D_DESC depthStencilDesc	= {};
+	depthStencilDesc.Width					= windowWidth;
+	depthStencilDesc.Height					= windowHeight;
+	depthStencilDesc.MipLevels				= 1;
+	depthStencilDesc.ArraySize				= 1;
+	depthStencilDesc.Format					= DXGI_FORMAT_D24_UNORM_S8_UINT;
+	depthStencilDesc.Usage					= D3D11_USAGE_DEFAULT;
+	depthStencilDesc.BindFlags				= D3D11_BIND_DEPTH_STENCIL;
+	depthStencilDesc.CPUAccessFlags			= 0;
+	depthStencilDesc.MiscFlags				= 0;
+	depthStencilDesc.SampleDesc.Count		= 1;
+	depthStencilDesc.SampleDesc.Quality		= 0;
+
+	// The pool makes the view to go with it
+	depthBuffer = resourcePool->AcquireTexture(depthStencilDesc);
+	depthBufferDSV = resourcePool->GetDepthStencilView(depthBuffer);
+}
+
 
 // --------------------------------------------------------
 // This is the main game loop, handling the following:
@@ -399,13 +388,9 @@ void DXCore::OnResize()
 // --------------------------------------------------------
 HRESULT DXCore::Run()
 {
-	// Grab the start time now that
-	// the game loop is running
-	__int64 now = 0;
-	QueryPerformanceCounter((LARGE_INTEGER*)&now);
-	startTime = now;
-	currentTime = now;
-	previousTime = now;
+	// Start all clocks from zero now
+	// that the game loop is running
+	appClock.Reset();
 
 	// Give subclass a chance to initialize
 	Init();
@@ -419,34 +404,121 @@ HRESULT DXCore::Run()
 		{
 			// Translate and dispatch the message
 			// to our custom WindowProc function
+			PROFILE_ZONE("Message Pump");
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 		}
 		else
 		{
-			// Update timer and title bar (if necessary)
-			UpdateTimer();
-			if(titleBarStats)
-				UpdateTitleBarStats();
-
-			// Update the input manager
-			Input::GetInstance().Update();
-
-			// The game loop
-			Update(deltaTime, totalTime);
-			Draw(deltaTime, totalTime);
-
-			// Frame is over, notify the input manager
-			Input::GetInstance().EndOfFrame();
+			// No messages, so run a single frame of the game
+			RunFrame();
 		}
 	}
 
 	// We'll end up here once we get a WM_QUIT message,
 	// which usually comes from the user closing the window
+	if (profilerDumpOnExit)
+	{
+		Profiler::GetInstance().ExportChromeTrace(FixPath("ProfileTrace.json"));
+		Profiler::GetInstance().ExportFrameSummary(FixPath("ProfileSummary.txt"));
+	}
+
+	if (frameStatsDumpOnExit)
+	{
+		frameStats.ExportJSON(FixPath("FrameStats.json"));
+		frameStats.ExportCSV(FixPath("FrameStats.csv"));
+	}
+
 	return (HRESULT)msg.wParam;
 }
 
 
+// --------------------------------------------------------
+// Runs exactly one frame of the game: timing, input,
+// update and draw.  This is everything Run() does between
+// OS messages, split out so the message pump stays separate
+// from the per-frame work.
+//  - See HeadlessLoop for a version of this that needs
+//    no window, device or Windows-specific timing at all
+// --------------------------------------------------------
+void DXCore::RunFrame()
+{
+	PROFILE_FRAME();
+
+	// Update timer, frame stats and title bar (if necessary)
+	UpdateTimer();
+	frameStats.AddFrame(appClock.GetDeltaSeconds() * 1000.0);
+	if (titleBarStats)
+		UpdateTitleBarStats();
+
+	// Update the input manager
+	{
+		PROFILE_ZONE("Input::Update");
+		Input::GetInstance().Update();
+	}
+
+	// The game loop
+	//  - Simulation follows the gameplay clock, so pausing
+	//    or scaling that clock pauses or scales Update()
+	float interpolationAlpha = 1.0f;
+	{
+		PROFILE_ZONE("Update");
+		if (useFixedTimestep)
+		{
+			// Simulate however many whole steps have built up, then
+			// draw with an alpha for blending between the last two
+			unsigned int steps = fixedTimestep.Advance(gameplayClock.GetDeltaSeconds());
+			for (unsigned int i = 0; i < steps; i++)
+			{
+				Update(fixedTimestep.GetStepSeconds(), fixedTimestep.GetStepTime(i));
+			}
+			interpolationAlpha = fixedTimestep.GetInterpolationAlpha();
+		}
+		else
+		{
+			Update((float)gameplayClock.GetDeltaSeconds(), gameplayClock.GetTotalSeconds());
+		}
+	}
+
+	// Drawing always uses real time
+	{
+		PROFILE_ZONE("Draw");
+		resourcePool->BeginFrame();
+		Draw((float)appClock.GetDeltaSeconds(), appClock.GetTotalSeconds(), interpolationAlpha);
+	}
+
+	// Frame is over, notify the input manager
+	Input::GetInstance().EndOfFrame();
+}
+
+
+// --------------------------------------------------------
+// Runs Update() at a fixed rate instead of once per frame.
+// Draw() still happens once per frame, and is handed an
+// interpolation alpha describing how far it is between
+// the last two simulation steps.
+//
+// ticksPerSecond  - How many Update() calls per second of real time
+// maxCatchUpSteps - Most Update() calls allowed in a single frame;
+//                   any time beyond that is dropped
+// --------------------------------------------------------
+void DXCore::EnableFixedTimestep(double ticksPerSecond, unsigned int maxCatchUpSteps)
+{
+	fixedTimestep.SetTickRate(ticksPerSecond);
+	fixedTimestep.SetMaxStepsPerFrame(maxCatchUpSteps);
+	fixedTimestep.Reset();
+	useFixedTimestep = true;
+}
+
+// --------------------------------------------------------
+// Goes back to calling Update() exactly once per frame
+// --------------------------------------------------------
+void DXCore::DisableFixedTimestep()
+{
+	useFixedTimestep = false;
+}
+
+
 // --------------------------------------------------------
 // Sends an OS-level window close message to our process, which
 // will be handled by our message processing function
@@ -458,26 +530,14 @@ void DXCore::Quit()
 
 
 // --------------------------------------------------------
-// Uses high resolution time stamps to get very accurate
-// timing information, and calculates useful time stats
+// Advances the app clock (and every clock that follows it)
+// using high resolution time stamps
+//  - See GameClock for the details; time is kept as 64-bit
+//    integer ticks so it doesn't lose precision over long runs
 // --------------------------------------------------------
 void DXCore::UpdateTimer()
 {
-	// Grab the current time
-	__int64 now = 0;
-	QueryPerformanceCounter((LARGE_INTEGER*)&now);
-	currentTime = now;
-
-	// Calculate delta time and clamp to zero
-	//  - Could go negative if CPU goes into power save mode 
-	//    or the process itself gets moved to another core
-	deltaTime = max((float)((currentTime - previousTime) * perfCounterSeconds), 0.0f);
-
-	// Calculate the total time from start to now
-	totalTime = (float)((currentTime - startTime) * perfCounterSeconds);
-
-	// Save current time for next frame
-	previousTime = currentTime;
+	appClock.Tick();
 }
 
 
@@ -486,6 +546,8 @@ void DXCore::UpdateTimer()
 // per second, including:
 //  - The window's width & height
 //  - The current FPS and ms/frame
+//  - The 99th percentile and worst frame times (the "1% lows"),
+//    and the number of hitches, over the frame stats window
 //  - The version of Direct3D actually being used (usually 11)
 // --------------------------------------------------------
 void DXCore::UpdateTitleBarStats()
@@ -493,13 +555,16 @@ void DXCore::UpdateTitleBarStats()
 	fpsFrameCount++;
 
 	// Only calc FPS and update title bar once per second
-	float timeDiff = totalTime - fpsTimeElapsed;
-	if (timeDiff < 1.0f)
+	double timeDiff = appClock.GetTotalSeconds() - fpsTimeElapsed;
+	if (timeDiff < 1.0)
 		return;
 
 	// How long did each frame take?  (Approx)
 	float mspf = 1000.0f / (float)fpsFrameCount;
 
+	// Percentiles show the spikes an average would hide
+	FrameStatsSummary stats = frameStats.GetSummary();
+
 	// Quick and dirty title bar text (mostly for debugging)
 	std::wostringstream output;
 	output.precision(6);
@@ -507,7 +572,10 @@ void DXCore::UpdateTitleBarStats()
 		"    Width: "		<< windowWidth <<
 		"    Height: "		<< windowHeight <<
 		"    FPS: "			<< fpsFrameCount <<
-		"    Frame Time: "	<< mspf << "ms";
+		"    Frame Time: "	<< mspf << "ms" <<
+		"    p99: "			<< stats.p99Ms << "ms" <<
+		"    Max: "			<< stats.maxMs << "ms" <<
+		"    Hitches: "		<< stats.windowHitches;
 	
 	// Append the version of Direct3D the app is using
 	switch (dxFeatureLevel)
@@ -525,7 +593,7 @@ void DXCore::UpdateTitleBarStats()
 	// Actually update the title bar and reset fps data
 	SetWindowText(hWnd, output.str().c_str());
 	fpsFrameCount = 0;
-	fpsTimeElapsed += 1.0f;
+	fpsTimeElapsed += 1.0;
 }
 
 // --------------------------------------------------------
@@ -2,9 +2,15 @@
 
 #include <Windows.h>
 #include <d3d11.h>
+#include <memory>
 #include <string>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 
+#include "FixedTimestep.h"
+#include "FrameStats.h"
+#include "GameClock.h"
+#include "ResourcePool.h"
+
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
 #pragma comment(lib, "d3d11.lib")
@@ -38,19 +44,22 @@ public:
 	HRESULT InitWindow();
 	HRESULT InitDirect3D();
 	HRESULT Run();
+	void RunFrame();
 	void Quit();
 	virtual void OnResize();
 
 	// Pure virtual methods for setup and game functionality
 	virtual void Init() = 0;
-	virtual void Update(float deltaTime, float totalTime) = 0;
-	virtual void Draw(float deltaTime, float totalTime) = 0;
+	virtual void Update(float deltaTime, double totalTime) = 0;
+	virtual void Draw(float deltaTime, double totalTime, float interpolationAlpha) = 0;
 
 protected:
 	HINSTANCE		hInstance;		// The handle to the application
 	HWND			hWnd;			// The handle to the window itself
 	std::wstring	titleBarText;	// Custom text in window's title bar
 	bool			titleBarStats;	// Show extra stats in title bar?
+	bool			profilerDumpOnExit; // Write profiler results next to the .exe when Run() ends?
+	bool			frameStatsDumpOnExit; // Write frame time stats next to the .exe when Run() ends?
 
 	// Size of the window's client area
 	unsigned int windowWidth;
@@ -75,23 +84,42 @@ protected:
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthBufferDSV;
 
+	// Textures and buffers kept across frames (like the depth
+	// buffer), and evicted on resize or once they sit unused
+	std::unique_ptr<ResourcePool> resourcePool;
+	ResourceHandle depthBuffer;
+
+	// Timing - the app clock always follows real time, and the
+	// others follow it but can be paused or scaled on their own
+	//  - Update() is driven by the gameplay clock
+	//  - Draw() is driven by the app clock
+	SystemTimeSource systemTime;
+	GameClock appClock;
+	GameClock gameplayClock;
+	GameClock uiClock;
+	GameClock debugClock;
+
+	// Rolling frame time stats (percentiles, hitches, histogram)
+	FrameStats frameStats;
+
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
 
+	// Switch Update() between once-per-frame and a fixed tick rate
+	void EnableFixedTimestep(double ticksPerSecond, unsigned int maxCatchUpSteps);
+	void DisableFixedTimestep();
+
 private:
-	// Timing related data
-	double perfCounterSeconds;
-	float totalTime;
-	float deltaTime;
-	__int64 startTime;
-	__int64 currentTime;
-	__int64 previousTime;
+	// Fixed-rate simulation (optional)
+	bool useFixedTimestep;
+	FixedTimestep fixedTimestep;
 
 	// FPS calculation
 	int fpsFrameCount;
-	float fpsTimeElapsed;
+	double fpsTimeElapsed;
 
 	void UpdateTimer();			// Updates the timer for this frame
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
+	void CreateDepthBuffer();	// Gets a window-sized depth buffer from the pool
 };
 
@@ -0,0 +1,17 @@
+#ifndef __DRAW_DATA_HLSLI__
+#define __DRAW_DATA_HLSLI__
+
+// --------------------------------------------------------
+// Per-draw constants, from this frame's part of the constant
+// buffer ring, bound to both the vertex and pixel shader
+//
+// This has to match DrawConstants in Game.h, as packed by
+// the CBufferLayout that Game::Init() describes it with.
+// --------------------------------------------------------
+cbuffer DrawData : register(b0)
+{
+	float4x4 viewProjection;		// The camera's, for shaders that aren't instanced
+	float4 colorTint;				// Multiplies the final color
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "FixedTimestep.h"
+
+// --------------------------------------------------------
+// Constructor
+//
+// ticksPerSecond   - How many simulation steps per second of real time
+// maxStepsPerFrame - Most steps we'll run to catch up in a single frame
+// --------------------------------------------------------
+FixedTimestep::FixedTimestep(double ticksPerSecond, unsigned int maxStepsPerFrame)
+	:
+	stepSeconds(1.0 / ticksPerSecond),
+	maxStepsPerFrame(maxStepsPerFrame),
+	accumulator(0),
+	previousRatesTime(0),
+	currentRateSteps(0),
+	totalSteps(0),
+	droppedSteps(0),
+	lastSteps(0)
+{
+}
+
+// --------------------------------------------------------
+// Changes the tick rate.  Any time already accumulated is
+// kept, and time already simulated stays what it was at the
+// old rate, so this can safely happen in the middle of a run.
+// GetStepTime() has no steps to give times for until the
+// next Advance().
+// --------------------------------------------------------
+void FixedTimestep::SetTickRate(double ticksPerSecond)
+{
+	previousRatesTime += currentRateSteps * stepSeconds;
+	currentRateSteps = 0;
+	lastSteps = 0;
+	stepSeconds = 1.0 / ticksPerSecond;
+}
+
+// --------------------------------------------------------
+// Changes the cap on catch-up steps per frame
+// --------------------------------------------------------
+void FixedTimestep::SetMaxStepsPerFrame(unsigned int maxSteps)
+{
+	maxStepsPerFrame = maxSteps;
+}
+
+// --------------------------------------------------------
+// Throws away any accumulated time and step counts
+// --------------------------------------------------------
+void FixedTimestep::Reset()
+{
+	accumulator = 0;
+	previousRatesTime = 0;
+	currentRateSteps = 0;
+	totalSteps = 0;
+	droppedSteps = 0;
+	lastSteps = 0;
+}
+
+// --------------------------------------------------------
+// Adds a frame's worth of real time to the accumulator and
+// returns how many fixed steps should be simulated now.
+//
+// - If more steps are owed than maxStepsPerFrame, the extra
+//   time is thrown away rather than carried over.  Otherwise
+//   one slow frame (a stall, a breakpoint, a window drag)
+//   would force the next frame to simulate even more, which
+//   makes it slower, and so on - the "spiral of death".
+// --------------------------------------------------------
+unsigned int FixedTimestep::Advance(double frameDeltaTime)
+{
+	if (frameDeltaTime > 0.0)
+		accumulator += frameDeltaTime;
+
+	unsigned int steps = (unsigned int)(accumulator / stepSeconds);
+	if (steps > maxStepsPerFrame)
+	{
+		droppedSteps += steps - maxStepsPerFrame;
+		steps = maxStepsPerFrame;
+
+		// Keep only the fractional part of a step so
+		// interpolation still lines up next frame
+		accumulator -= stepSeconds * (unsigned int)(accumulator / stepSeconds);
+	}
+	else
+	{
+		accumulator -= stepSeconds * steps;
+	}
+
+	totalSteps += steps;
+	currentRateSteps += steps;
+	lastSteps = steps;
+	return steps;
+}
+
+// --------------------------------------------------------
+// Length of a single simulation step, in seconds
+// --------------------------------------------------------
+float FixedTimestep::GetStepSeconds() const
+{
+	return (float)stepSeconds;
+}
+
+// --------------------------------------------------------
+// How far we are between the last simulated step and the
+// next one, from 0 to 1.  Drawing should blend previous and
+// current simulation state by this amount.
+// --------------------------------------------------------
+float FixedTimestep::GetInterpolationAlpha() const
+{
+	return (float)(accumulator / stepSeconds);
+}
+
+// --------------------------------------------------------
+// Total simulated time, which only advances in whole steps
+// --------------------------------------------------------
+double FixedTimestep::GetSimulationTime() const
+{
+	return previousRatesTime + currentRateSteps * stepSeconds;
+}
+
+// --------------------------------------------------------
+// Simulation time once one of the last Advance()'s steps
+// has run - what that step's Update() should be given, so
+// each catch-up step sees its own time rather than the
+// time after all of them
+//
+// step - Which step, from 0 to Advance()'s result - 1
+// --------------------------------------------------------
+double FixedTimestep::GetStepTime(unsigned int step) const
+{
+	return previousRatesTime + (currentRateSteps - lastSteps + step + 1) * stepSeconds;
+}
+
+// --------------------------------------------------------
+// Number of steps simulated since the last Reset()
+// --------------------------------------------------------
+unsigned long long FixedTimestep::GetTotalSteps() const
+{
+	return totalSteps;
+}
+
+// --------------------------------------------------------
+// Number of steps skipped because of the catch-up cap
+// --------------------------------------------------------
+unsigned long long FixedTimestep::GetDroppedSteps() const
+{
+	return droppedSteps;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// --------------------------------------------------------
+// Accumulator for running the simulation at a fixed tick
+// rate, independent of how fast frames are being drawn
+// --------------------------------------------------------
+class FixedTimestep
+{
+public:
+	FixedTimestep(double ticksPerSecond = 60.0, unsigned int maxStepsPerFrame = 8);
+
+	void SetTickRate(double ticksPerSecond);
+	void SetMaxStepsPerFrame(unsigned int maxSteps);
+	void Reset();
+
+	unsigned int Advance(double frameDeltaTime);
+
+	float GetStepSeconds() const;
+	float GetInterpolationAlpha() const;
+	double GetSimulationTime() const;
+	double GetStepTime(unsigned int step) const;
+	unsigned long long GetTotalSteps() const;
+	unsigned long long GetDroppedSteps() const;
+
+private:
+	double stepSeconds;
+	unsigned int maxStepsPerFrame;
+
+	// Time that has passed but hasn't been simulated yet
+	double accumulator;
+
+	// Simulated time from before the last tick rate change,
+	// and the steps taken at the current rate since
+	double previousRatesTime;
+	unsigned long long currentRateSteps;
+
+	unsigned long long totalSteps;
+	unsigned long long droppedSteps;
+	unsigned int lastSteps;		// Returned by the last Advance()
+};
@@ -0,0 +1,218 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+// --------------------------------------------------------
+// Constructor - Allocates everything the stats will ever need
+//
+// windowSize           - How many of the most recent frames to keep
+// budgetMs             - Frames longer than this count as hitches
+// histogramBucketMs    - Width of each histogram bucket
+// histogramBucketCount - Number of histogram buckets
+// --------------------------------------------------------
+FrameStats::FrameStats(
+	unsigned int windowSize,
+	double budgetMs,
+	double histogramBucketMs,
+	unsigned int histogramBucketCount)
+	:
+	window(std::max(windowSize, 1u)),
+	windowCount(0),
+	windowNext(0),
+	sorted(std::max(windowSize, 1u)),
+	sortedValid(false),
+	budgetMs(budgetMs),
+	totalFrames(0),
+	totalHitches(0),
+	histogramBucketMs(histogramBucketMs),
+	histogram(std::max(histogramBucketCount, 1u))
+{
+}
+
+// --------------------------------------------------------
+// Records a single frame's length, in milliseconds
+// --------------------------------------------------------
+void FrameStats::AddFrame(double frameMs)
+{
+	window[windowNext] = frameMs;
+	windowNext = (windowNext + 1) % (unsigned int)window.size();
+	windowCount = std::min(windowCount + 1, (unsigned int)window.size());
+	sortedValid = false;
+
+	totalFrames++;
+	if (frameMs > budgetMs)
+		totalHitches++;
+
+	size_t bucket = (size_t)(std::max(frameMs, 0.0) / histogramBucketMs);
+	histogram[std::min(bucket, histogram.size() - 1)]++;
+}
+
+// --------------------------------------------------------
+// Forgets every frame recorded so far
+// --------------------------------------------------------
+void FrameStats::Reset()
+{
+	windowCount = 0;
+	windowNext = 0;
+	sortedValid = false;
+	totalFrames = 0;
+	totalHitches = 0;
+	std::fill(histogram.begin(), histogram.end(), 0);
+}
+
+// --------------------------------------------------------
+// Changes the hitch budget.  Totals recorded so far keep
+// the old budget; the window is re-counted on the next query.
+// --------------------------------------------------------
+void FrameStats::SetBudget(double budgetMs)
+{
+	this->budgetMs = budgetMs;
+}
+
+// --------------------------------------------------------
+// Gets the current hitch budget, in milliseconds
+// --------------------------------------------------------
+double FrameStats::GetBudget() const
+{
+	return budgetMs;
+}
+
+// --------------------------------------------------------
+// Calculates stats for every frame still in the window
+// --------------------------------------------------------
+FrameStatsSummary FrameStats::GetSummary()
+{
+	FrameStatsSummary summary;
+	summary.budgetMs = budgetMs;
+	summary.totalFrames = totalFrames;
+	summary.totalHitches = totalHitches;
+	summary.sampleCount = windowCount;
+	if (windowCount == 0)
+		return summary;
+
+	SortWindow();
+
+	double sum = 0.0;
+	for (unsigned int i = 0; i < windowCount; i++)
+	{
+		sum += sorted[i];
+		if (sorted[i] > budgetMs)
+			summary.windowHitches++;
+	}
+
+	summary.averageMs = sum / windowCount;
+	summary.minMs = sorted[0];
+	summary.p50Ms = GetPercentile(50.0);
+	summary.p95Ms = GetPercentile(95.0);
+	summary.p99Ms = GetPercentile(99.0);
+	summary.maxMs = sorted[windowCount - 1];
+	return summary;
+}
+
+// --------------------------------------------------------
+// Nearest-rank percentile of the frames in the window.  The
+// 99th percentile frame time is the "1% low" frame rate.
+//
+// percent - Between 0 and 100
+// --------------------------------------------------------
+double FrameStats::GetPercentile(double percent)
+{
+	if (windowCount == 0)
+		return 0.0;
+
+	SortWindow();
+
+	size_t rank = (size_t)std::ceil(percent / 100.0 * windowCount);
+	rank = std::min<size_t>(std::max<size_t>(rank, 1), windowCount);
+	return sorted[rank - 1];
+}
+
+// --------------------------------------------------------
+// Width of each histogram bucket, in milliseconds
+// --------------------------------------------------------
+double FrameStats::GetHistogramBucketMs() const
+{
+	return histogramBucketMs;
+}
+
+// --------------------------------------------------------
+// Count of frames (since the last Reset()) per bucket
+// --------------------------------------------------------
+const std::vector<unsigned long long>& FrameStats::GetHistogram() const
+{
+	return histogram;
+}
+
+// --------------------------------------------------------
+// Copies the window into the preallocated scratch space and
+// sorts it, but only if a frame was added since last time
+// --------------------------------------------------------
+void FrameStats::SortWindow()
+{
+	if (sortedValid)
+		return;
+
+	std::copy(window.begin(), window.begin() + windowCount, sorted.begin());
+	std::sort(sorted.begin(), sorted.begin() + windowCount);
+	sortedValid = true;
+}
+
+// --------------------------------------------------------
+// Writes the frames in the window, oldest first, as CSV
+//
+// path - The file to write
+// --------------------------------------------------------
+bool FrameStats::ExportCSV(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	file << "frame,ms,hitch\n";
+
+	// The oldest frame is at windowNext once the ring has wrapped
+	unsigned int first = windowCount < window.size() ? 0 : windowNext;
+	for (unsigned int i = 0; i < windowCount; i++)
+	{
+		double ms = window[(first + i) % window.size()];
+		file << (totalFrames - windowCount + i) << "," << ms << "," << (ms > budgetMs ? 1 : 0) << "\n";
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes the summary and histogram as JSON
+//
+// path - The file to write
+// --------------------------------------------------------
+bool FrameStats::ExportJSON(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	FrameStatsSummary s = GetSummary();
+	file << "{\n" <<
+		"  \"sampleCount\": " << s.sampleCount << ",\n" <<
+		"  \"averageMs\": " << s.averageMs << ",\n" <<
+		"  \"minMs\": " << s.minMs << ",\n" <<
+		"  \"p50Ms\": " << s.p50Ms << ",\n" <<
+		"  \"p95Ms\": " << s.p95Ms << ",\n" <<
+		"  \"p99Ms\": " << s.p99Ms << ",\n" <<
+		"  \"maxMs\": " << s.maxMs << ",\n" <<
+		"  \"budgetMs\": " << s.budgetMs << ",\n" <<
+		"  \"windowHitches\": " << s.windowHitches << ",\n" <<
+		"  \"totalHitches\": " << s.totalHitches << ",\n" <<
+		"  \"totalFrames\": " << s.totalFrames << ",\n" <<
+		"  \"histogramBucketMs\": " << histogramBucketMs << ",\n" <<
+		"  \"histogram\": [";
+
+	for (size_t i = 0; i < histogram.size(); i++)
+		file << (i > 0 ? ", " : "") << histogram[i];
+
+	file << "]\n}\n";
+	return true;
+}
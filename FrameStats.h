@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// A snapshot of the frame times currently in the window
+// --------------------------------------------------------
+struct FrameStatsSummary
+{
+	unsigned int sampleCount = 0;
+	double averageMs = 0.0;
+	double minMs = 0.0;
+	double p50Ms = 0.0;
+	double p95Ms = 0.0;
+	double p99Ms = 0.0;
+	double maxMs = 0.0;
+
+	// Hitches are frames longer than the budget
+	double budgetMs = 0.0;
+	unsigned int windowHitches = 0;			// Hitches still in the window
+	unsigned long long totalHitches = 0;	// Hitches since the last Reset()
+	unsigned long long totalFrames = 0;		// Frames since the last Reset()
+};
+
+// --------------------------------------------------------
+// Rolling frame time statistics over a fixed-size window.
+// All memory is allocated up front, so recording a frame
+// (and querying the window) never touches the heap.
+// --------------------------------------------------------
+class FrameStats
+{
+public:
+	FrameStats(
+		unsigned int windowSize = 1024,
+		double budgetMs = 1000.0 / 60.0,
+		double histogramBucketMs = 1.0,
+		unsigned int histogramBucketCount = 64);
+
+	void AddFrame(double frameMs);
+	void Reset();
+
+	void SetBudget(double budgetMs);
+	double GetBudget() const;
+
+	FrameStatsSummary GetSummary();
+	double GetPercentile(double percent);
+
+	double GetHistogramBucketMs() const;
+	const std::vector<unsigned long long>& GetHistogram() const;
+
+	bool ExportCSV(const std::string& path) const;
+	bool ExportJSON(const std::string& path);
+
+private:
+	// Ring of the most recent frame times
+	std::vector<double> window;
+	unsigned int windowCount;
+	unsigned int windowNext;
+
+	// Scratch space for percentile queries (same size as the window)
+	std::vector<double> sorted;
+	bool sortedValid;
+
+	double budgetMs;
+	unsigned long long totalFrames;
+	unsigned long long totalHitches;
+
+	// Frames since the last Reset(), bucketed by length - the last
+	// bucket also holds everything longer than the histogram covers
+	double histogramBucketMs;
+	std::vector<unsigned long long> histogram;
+
+	void SortWindow();
+};
@@ -0,0 +1,74 @@
+#include "Frustum.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Pulls the planes out of a row-major (row vector) matrix
+//  - A point is inside when -w <= x <= w, -w <= y <= w and
+//    0 <= z <= w in clip space, and each of those is a
+//    combination of the matrix's columns
+// --------------------------------------------------------
+Frustum ExtractFrustum(const XMFLOAT4X4& m)
+{
+	XMFLOAT4 column[4];
+	for (unsigned int c = 0; c < 4; c++)
+		column[c] = XMFLOAT4(m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c]);
+
+	Frustum frustum;
+	XMFLOAT4* planes = frustum.planes;
+	planes[FrustumPlaneLeft] = XMFLOAT4(column[3].x + column[0].x, column[3].y + column[0].y, column[3].z + column[0].z, column[3].w + column[0].w);
+	planes[FrustumPlaneRight] = XMFLOAT4(column[3].x - column[0].x, column[3].y - column[0].y, column[3].z - column[0].z, column[3].w - column[0].w);
+	planes[FrustumPlaneBottom] = XMFLOAT4(column[3].x + column[1].x, column[3].y + column[1].y, column[3].z + column[1].z, column[3].w + column[1].w);
+	planes[FrustumPlaneTop] = XMFLOAT4(column[3].x - column[1].x, column[3].y - column[1].y, column[3].z - column[1].z, column[3].w - column[1].w);
+	planes[FrustumPlaneNear] = column[2];
+	planes[FrustumPlaneFar] = XMFLOAT4(column[3].x - column[2].x, column[3].y - column[2].y, column[3].z - column[2].z, column[3].w - column[2].w);
+
+	for (unsigned int i = 0; i < FrustumPlaneCount; i++)
+	{
+		float length = sqrtf(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z);
+		if (length > 0.0f)
+		{
+			planes[i].x /= length;
+			planes[i].y /= length;
+			planes[i].z /= length;
+			planes[i].w /= length;
+		}
+	}
+
+	return frustum;
+}
+
+// --------------------------------------------------------
+// Whether a sphere might be visible - false only when it's
+// completely outside at least one plane
+// --------------------------------------------------------
+bool SphereInFrustum(const Frustum& frustum, const XMFLOAT3& center, float radius)
+{
+	for (unsigned int i = 0; i < FrustumPlaneCount; i++)
+	{
+		const XMFLOAT4& p = frustum.planes[i];
+		if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Whether an axis-aligned box might be visible, testing the
+// corner furthest along each plane's normal
+// --------------------------------------------------------
+bool BoxInFrustum(const Frustum& frustum, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	for (unsigned int i = 0; i < FrustumPlaneCount; i++)
+	{
+		const XMFLOAT4& p = frustum.planes[i];
+		float x = p.x >= 0.0f ? boxMax.x : boxMin.x;
+		float y = p.y >= 0.0f ? boxMax.y : boxMin.y;
+		float z = p.z >= 0.0f ? boxMax.z : boxMin.z;
+		if (p.x * x + p.y * y + p.z * z + p.w < 0.0f)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// The six planes bounding what a view-projection matrix
+// can see, as (normal, distance) with normals pointing in
+// and normalized, so plane . (x, y, z, 1) is a signed
+// distance - positive inside.
+//
+// Planes come straight from the matrix (Gribb and Hartmann,
+// "Fast Extraction of Viewing Frustum Planes"), so passing
+// world * viewProjection gives planes in that object's own
+// space.  Depth is Direct3D's 0 to 1.
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+enum FrustumPlane
+{
+	FrustumPlaneLeft,
+	FrustumPlaneRight,
+	FrustumPlaneBottom,
+	FrustumPlaneTop,
+	FrustumPlaneNear,
+	FrustumPlaneFar,
+	FrustumPlaneCount
+};
+
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[FrustumPlaneCount];
+};
+
+Frustum ExtractFrustum(const DirectX::XMFLOAT4X4& viewProjection);
+
+bool SphereInFrustum(const Frustum& frustum, const DirectX::XMFLOAT3& center, float radius);
+bool BoxInFrustum(const Frustum& frustum, const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax);
@@ -0,0 +1,441 @@
+#include "FrustumCuller.h"
+#include "CpuFeatures.h"
+#include "JobSystem.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+typedef std::chrono::steady_clock CullClock;
+
+// Objects per job system chunk
+static const unsigned int BoundsChunkSize = 4096;
+static const unsigned int CullChunkSize = 16384;
+
+// --------------------------------------------------------
+// The fastest path this CPU can run
+// --------------------------------------------------------
+static FrustumCullPath GetBestFrustumCullPath()
+{
+#if CPU_X86
+	const CpuFeatures& cpu = GetCpuFeatures();
+	if (cpu.avx2 && cpu.fma)
+		return FrustumCullAVX2;
+
+	// SSE2 is part of every x64 CPU (and on by default for Win32 builds)
+	return FrustumCullSSE2;
+#else
+	return FrustumCullScalar;
+#endif
+}
+
+static FrustumCullPath activePath = GetBestFrustumCullPath();
+
+// --------------------------------------------------------
+// Which path Cull() is using
+// --------------------------------------------------------
+FrustumCullPath GetFrustumCullPath()
+{
+	return activePath;
+}
+
+// --------------------------------------------------------
+// Forces a particular path, as long as this CPU supports
+// it, and returns the path actually being used afterwards
+// --------------------------------------------------------
+FrustumCullPath SetFrustumCullPath(FrustumCullPath path)
+{
+	FrustumCullPath best = GetBestFrustumCullPath();
+	activePath = path > best ? best : path;
+	return activePath;
+}
+
+
+// ----------------------------------------------------------------
+// The arrays a cull kernel reads.  For each plane, the box corner
+// furthest along its normal (the one that's inside if any of the
+// box is) is picked ahead of time by pointing at the min or max
+// array for each axis, so the kernels never select per object.
+// ----------------------------------------------------------------
+struct CullInputs
+{
+	const float* centerX;
+	const float* centerY;
+	const float* centerZ;
+	const float* radius;
+	const float* cornerX[FrustumPlaneCount];
+	const float* cornerY[FrustumPlaneCount];
+	const float* cornerZ[FrustumPlaneCount];
+};
+
+// ----------------------------------------------------------------
+// Scalar reference path - one object at a time
+// ----------------------------------------------------------------
+static unsigned int CullScalar(
+	const Frustum& frustum,
+	const CullInputs& in,
+	unsigned int first,
+	unsigned int count,
+	unsigned int* visible)
+{
+	unsigned int visibleCount = 0;
+	for (unsigned int i = first; i < count; i++)
+	{
+		bool inside = true;
+		for (unsigned int p = 0; p < FrustumPlaneCount && inside; p++)
+		{
+			const XMFLOAT4& plane = frustum.planes[p];
+			float sphere = plane.x * in.centerX[i] + plane.y * in.centerY[i] + plane.z * in.centerZ[i] + plane.w + in.radius[i];
+			float box = plane.x * in.cornerX[p][i] + plane.y * in.cornerY[p][i] + plane.z * in.cornerZ[p][i] + plane.w;
+			inside = sphere >= 0.0f && box >= 0.0f;
+		}
+
+		// Always written, only kept when visible - no branch
+		visible[visibleCount] = i;
+		visibleCount += inside ? 1 : 0;
+	}
+	return visibleCount;
+}
+
+
+#if CPU_X86
+// ----------------------------------------------------------------
+// SSE2 path - four objects at a time.  Each register holds one
+// component (say, center x) of four objects, and each plane is
+// broadcast, so the math reads exactly like the scalar version.
+// ----------------------------------------------------------------
+static unsigned int CullSSE2(
+	const Frustum& frustum,
+	const CullInputs& in,
+	unsigned int first,
+	unsigned int count,
+	unsigned int* visible)
+{
+	unsigned int visibleCount = 0;
+	unsigned int i = first;
+	__m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(in.centerX + i);
+		__m128 cy = _mm_loadu_ps(in.centerY + i);
+		__m128 cz = _mm_loadu_ps(in.centerZ + i);
+		__m128 r = _mm_loadu_ps(in.radius + i);
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (unsigned int p = 0; p < FrustumPlaneCount; p++)
+		{
+			const XMFLOAT4& plane = frustum.planes[p];
+			__m128 px = _mm_set1_ps(plane.x);
+			__m128 py = _mm_set1_ps(plane.y);
+			__m128 pz = _mm_set1_ps(plane.z);
+			__m128 pw = _mm_set1_ps(plane.w);
+
+			__m128 sphere = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)), _mm_add_ps(_mm_mul_ps(pz, cz), _mm_add_ps(pw, r)));
+			__m128 box = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(px, _mm_loadu_ps(in.cornerX[p] + i)), _mm_mul_ps(py, _mm_loadu_ps(in.cornerY[p] + i))),
+				_mm_add_ps(_mm_mul_ps(pz, _mm_loadu_ps(in.cornerZ[p] + i)), pw));
+
+			inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmpge_ps(sphere, zero), _mm_cmpge_ps(box, zero)));
+		}
+
+		// One bit per object, appended without branching
+		int bits = _mm_movemask_ps(inside);
+		for (unsigned int lane = 0; lane < 4; lane++)
+		{
+			visible[visibleCount] = i + lane;
+			visibleCount += (bits >> lane) & 1;
+		}
+	}
+
+	return visibleCount + CullScalar(frustum, in, i, count, visible + visibleCount);
+}
+
+// ----------------------------------------------------------------
+// AVX2 path - the SSE2 path eight objects wide, with fused
+// multiply-adds
+// ----------------------------------------------------------------
+TARGET_AVX2 static unsigned int CullAVX2(
+	const Frustum& frustum,
+	const CullInputs& in,
+	unsigned int first,
+	unsigned int count,
+	unsigned int* visible)
+{
+	unsigned int visibleCount = 0;
+	unsigned int i = first;
+	__m256 zero = _mm256_setzero_ps();
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(in.centerX + i);
+		__m256 cy = _mm256_loadu_ps(in.centerY + i);
+		__m256 cz = _mm256_loadu_ps(in.centerZ + i);
+		__m256 r = _mm256_loadu_ps(in.radius + i);
+
+		__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+		for (unsigned int p = 0; p < FrustumPlaneCount; p++)
+		{
+			const XMFLOAT4& plane = frustum.planes[p];
+			__m256 px = _mm256_set1_ps(plane.x);
+			__m256 py = _mm256_set1_ps(plane.y);
+			__m256 pz = _mm256_set1_ps(plane.z);
+			__m256 pw = _mm256_set1_ps(plane.w);
+
+			__m256 sphere = _mm256_fmadd_ps(px, cx, _mm256_fmadd_ps(py, cy, _mm256_fmadd_ps(pz, cz, _mm256_add_ps(pw, r))));
+			__m256 box = _mm256_fmadd_ps(px, _mm256_loadu_ps(in.cornerX[p] + i),
+				_mm256_fmadd_ps(py, _mm256_loadu_ps(in.cornerY[p] + i),
+				_mm256_fmadd_ps(pz, _mm256_loadu_ps(in.cornerZ[p] + i), pw)));
+
+			inside = _mm256_and_ps(inside, _mm256_and_ps(
+				_mm256_cmp_ps(sphere, zero, _CMP_GE_OQ),
+				_mm256_cmp_ps(box, zero, _CMP_GE_OQ)));
+		}
+
+		int bits = _mm256_movemask_ps(inside);
+		for (unsigned int lane = 0; lane < 8; lane++)
+		{
+			visible[visibleCount] = i + lane;
+			visibleCount += (bits >> lane) & 1;
+		}
+	}
+
+	return visibleCount + CullScalar(frustum, in, i, count, visible + visibleCount);
+}
+#endif
+
+
+// --------------------------------------------------------
+// Constructor - Starts with no objects
+// --------------------------------------------------------
+FrustumCuller::FrustumCuller()
+	:
+	count(0)
+{
+}
+
+// --------------------------------------------------------
+// Sets the number of objects - new ones need bounds set
+// before the next Cull()
+// --------------------------------------------------------
+void FrustumCuller::Resize(unsigned int count)
+{
+	std::vector<float>* arrays[] = { &centerX, &centerY, &centerZ, &radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ };
+	for (unsigned int i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++)
+		arrays[i]->resize(count, 0.0f);
+
+	this->count = count;
+}
+
+unsigned int FrustumCuller::GetCount() const { return count; }
+const FrustumCullStats& FrustumCuller::GetStats() const { return stats; }
+
+// --------------------------------------------------------
+// Sets one object's world space bounds directly
+// --------------------------------------------------------
+void FrustumCuller::SetBounds(
+	unsigned int object,
+	const XMFLOAT3& center,
+	float radius,
+	const XMFLOAT3& boxMin,
+	const XMFLOAT3& boxMax)
+{
+	centerX[object] = center.x;
+	centerY[object] = center.y;
+	centerZ[object] = center.z;
+	this->radius[object] = radius;
+	minX[object] = boxMin.x;
+	minY[object] = boxMin.y;
+	minZ[object] = boxMin.z;
+	maxX[object] = boxMax.x;
+	maxY[object] = boxMax.y;
+	maxZ[object] = boxMax.z;
+}
+
+// --------------------------------------------------------
+// One object's world space box, as of the last update
+// --------------------------------------------------------
+void FrustumCuller::GetBox(unsigned int object, XMFLOAT3& boxMin, XMFLOAT3& boxMax) const
+{
+	boxMin = XMFLOAT3(minX[object], minY[object], minZ[object]);
+	boxMax = XMFLOAT3(maxX[object], maxY[object], maxZ[object]);
+}
+
+// --------------------------------------------------------
+// Recomputes every object's world space bounds from its
+// world matrix and the local box of its shape (usually its
+// mesh), resizing to count objects
+//
+// worldMatrices - Each object's world matrix
+// shapes        - Each object's shape, indexing the next two
+// shapeMins     - Each shape's local box minimum
+// shapeMaxs     - Each shape's local box maximum
+// count         - Number of objects
+// jobs          - Optional, to split the work across threads
+// --------------------------------------------------------
+void FrustumCuller::UpdateBounds(
+	const XMFLOAT4X4* worldMatrices,
+	const unsigned int* shapes,
+	const XMFLOAT3* shapeMins,
+	const XMFLOAT3* shapeMaxs,
+	unsigned int count,
+	JobSystem* jobs)
+{
+	CullClock::time_point start = CullClock::now();
+
+	if (count != this->count)
+		Resize(count);
+
+	if (jobs && count > BoundsChunkSize)
+	{
+		jobs->ParallelFor(count, BoundsChunkSize,
+			[&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+			{
+				TransformBounds(worldMatrices, shapes, shapeMins, shapeMaxs, begin, end);
+			});
+	}
+	else
+	{
+		TransformBounds(worldMatrices, shapes, shapeMins, shapeMaxs, 0, count);
+	}
+
+	stats.boundsMs = std::chrono::duration<double, std::milli>(CullClock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Moves local boxes into world space.  The box is the box
+// around the transformed box (Arvo, "Transforming Axis-
+// Aligned Bounding Boxes"): its center is transformed, and
+// each world axis' half size is the local half sizes
+// weighted by how much of each lands on that axis.  The
+// sphere shares the center, with the local half diagonal
+// scaled by the largest axis scale.
+// --------------------------------------------------------
+void FrustumCuller::TransformBounds(
+	const XMFLOAT4X4* worldMatrices,
+	const unsigned int* shapes,
+	const XMFLOAT3* shapeMins,
+	const XMFLOAT3* shapeMaxs,
+	unsigned int begin,
+	unsigned int end)
+{
+	for (unsigned int i = begin; i < end; i++)
+	{
+		const XMFLOAT4X4& w = worldMatrices[i];
+		const XMFLOAT3& localMin = shapeMins[shapes[i]];
+		const XMFLOAT3& localMax = shapeMaxs[shapes[i]];
+
+		float lx = (localMin.x + localMax.x) * 0.5f;
+		float ly = (localMin.y + localMax.y) * 0.5f;
+		float lz = (localMin.z + localMax.z) * 0.5f;
+		float ex = (localMax.x - localMin.x) * 0.5f;
+		float ey = (localMax.y - localMin.y) * 0.5f;
+		float ez = (localMax.z - localMin.z) * 0.5f;
+
+		// Row vectors, so the center is (lx, ly, lz, 1) * w
+		float cx = lx * w._11 + ly * w._21 + lz * w._31 + w._41;
+		float cy = lx * w._12 + ly * w._22 + lz * w._32 + w._42;
+		float cz = lx * w._13 + ly * w._23 + lz * w._33 + w._43;
+
+		float hx = ex * fabsf(w._11) + ey * fabsf(w._21) + ez * fabsf(w._31);
+		float hy = ex * fabsf(w._12) + ey * fabsf(w._22) + ez * fabsf(w._32);
+		float hz = ex * fabsf(w._13) + ey * fabsf(w._23) + ez * fabsf(w._33);
+
+		float scaleX = w._11 * w._11 + w._12 * w._12 + w._13 * w._13;
+		float scaleY = w._21 * w._21 + w._22 * w._22 + w._23 * w._23;
+		float scaleZ = w._31 * w._31 + w._32 * w._32 + w._33 * w._33;
+		float scaleSq = scaleX > scaleY ? scaleX : scaleY;
+		scaleSq = scaleSq > scaleZ ? scaleSq : scaleZ;
+
+		centerX[i] = cx;
+		centerY[i] = cy;
+		centerZ[i] = cz;
+		radius[i] = sqrtf((ex * ex + ey * ey + ez * ez) * scaleSq);
+		minX[i] = cx - hx;
+		minY[i] = cy - hy;
+		minZ[i] = cz - hz;
+		maxX[i] = cx + hx;
+		maxY[i] = cy + hy;
+		maxZ[i] = cz + hz;
+	}
+}
+
+// --------------------------------------------------------
+// Tests every object against a frustum, filling visible
+// with the indices of those at least partly inside, in
+// increasing order.  Returns how many there are.
+//
+// frustum - Planes in the same (world) space as the bounds
+// visible - Resized to the visible count
+// jobs    - Optional, to split the work across threads
+// --------------------------------------------------------
+unsigned int FrustumCuller::Cull(const Frustum& frustum, std::vector<unsigned int>& visible, JobSystem* jobs)
+{
+	CullClock::time_point start = CullClock::now();
+
+	// Room for everything to be visible
+	visible.resize(count);
+
+	unsigned int visibleCount = 0;
+	if (jobs && count > CullChunkSize)
+	{
+		// Each chunk writes at its own start, so chunks never
+		// overlap, then they're slid down into one list
+		unsigned int chunkCount = (count + CullChunkSize - 1) / CullChunkSize;
+		chunkCounts.resize(chunkCount);
+
+		jobs->ParallelFor(count, CullChunkSize,
+			[&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+			{
+				chunkCounts[begin / CullChunkSize] = CullRange(frustum, begin, end, visible.data() + begin);
+			});
+
+		for (unsigned int c = 0; c < chunkCount; c++)
+		{
+			unsigned int* source = visible.data() + c * CullChunkSize;
+			if (source != visible.data() + visibleCount)
+				memmove(visible.data() + visibleCount, source, chunkCounts[c] * sizeof(unsigned int));
+			visibleCount += chunkCounts[c];
+		}
+	}
+	else if (count > 0)
+	{
+		visibleCount = CullRange(frustum, 0, count, visible.data());
+	}
+
+	visible.resize(visibleCount);
+
+	stats.objectCount = count;
+	stats.visibleCount = visibleCount;
+	stats.cullMs = std::chrono::duration<double, std::milli>(CullClock::now() - start).count();
+	return visibleCount;
+}
+
+unsigned int FrustumCuller::CullRange(const Frustum& frustum, unsigned int begin, unsigned int end, unsigned int* visible) const
+{
+	CullInputs in;
+	in.centerX = centerX.data();
+	in.centerY = centerY.data();
+	in.centerZ = centerZ.data();
+	in.radius = radius.data();
+	for (unsigned int p = 0; p < FrustumPlaneCount; p++)
+	{
+		const XMFLOAT4& plane = frustum.planes[p];
+		in.cornerX[p] = plane.x >= 0.0f ? maxX.data() : minX.data();
+		in.cornerY[p] = plane.y >= 0.0f ? maxY.data() : minY.data();
+		in.cornerZ[p] = plane.z >= 0.0f ? maxZ.data() : minZ.data();
+	}
+
+	switch (activePath)
+	{
+#if CPU_X86
+	case FrustumCullAVX2: return CullAVX2(frustum, in, begin, end, visible);
+	case FrustumCullSSE2: return CullSSE2(frustum, in, begin, end, visible);
+#endif
+	default: return CullScalar(frustum, in, begin, end, visible);
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Frustum.h"
+
+class JobSystem;
+
+// --------------------------------------------------------
+// Visibility for many objects at once, against the camera's
+// frustum.
+//
+// Each object has a world space bounding sphere and box,
+// kept in separate arrays per component (all centers' x,
+// then all y, and so on), so the tests run on four (SSE2)
+// or eight (AVX2) objects at a time with no shuffling.  The
+// sphere test is cheaper but looser, and the box test is
+// tighter for long, thin objects - an object is visible
+// only when both pass.
+//
+// Cull() writes the indices of the visible objects, in
+// order, which is what the draw path iterates instead of
+// every object.
+//
+// Like TransformKernels, the fastest path this CPU supports
+// is picked automatically, and SetFrustumCullPath() can
+// force a slower one for comparisons.
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+enum FrustumCullPath
+{
+	FrustumCullScalar,
+	FrustumCullSSE2,
+	FrustumCullAVX2
+};
+
+FrustumCullPath GetFrustumCullPath();
+FrustumCullPath SetFrustumCullPath(FrustumCullPath path);
+
+struct FrustumCullStats
+{
+	unsigned int objectCount = 0;
+	unsigned int visibleCount = 0;
+	double boundsMs = 0.0;		// UpdateBounds()
+	double cullMs = 0.0;		// Cull()
+};
+
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	void Resize(unsigned int count);
+	unsigned int GetCount() const;
+
+	void SetBounds(
+		unsigned int object,
+		const DirectX::XMFLOAT3& center,
+		float radius,
+		const DirectX::XMFLOAT3& boxMin,
+		const DirectX::XMFLOAT3& boxMax);
+
+	void UpdateBounds(
+		const DirectX::XMFLOAT4X4* worldMatrices,
+		const unsigned int* shapes,
+		const DirectX::XMFLOAT3* shapeMins,
+		const DirectX::XMFLOAT3* shapeMaxs,
+		unsigned int count,
+		JobSystem* jobs = 0);
+
+	void GetBox(unsigned int object, DirectX::XMFLOAT3& boxMin, DirectX::XMFLOAT3& boxMax) const;
+
+	unsigned int Cull(const Frustum& frustum, std::vector<unsigned int>& visible, JobSystem* jobs = 0);
+
+	const FrustumCullStats& GetStats() const;
+
+private:
+	// World space bounds, one entry per object in each array
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+	unsigned int count;
+
+	// Parallel culling writes each chunk's visible objects
+	// at that chunk's start, then they're packed together
+	std::vector<unsigned int> chunkVisible;
+	std::vector<unsigned int> chunkCounts;
+
+	FrustumCullStats stats;
+
+	void TransformBounds(
+		const DirectX::XMFLOAT4X4* worldMatrices,
+		const unsigned int* shapes,
+		const DirectX::XMFLOAT3* shapeMins,
+		const DirectX::XMFLOAT3* shapeMaxs,
+		unsigned int begin,
+		unsigned int end);
+	unsigned int CullRange(const Frustum& frustum, unsigned int begin, unsigned int end, unsigned int* visible) const;
+};
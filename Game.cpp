@@ -1,15 +1,84 @@
 #include "Game.h"
 #include "Vertex.h"
 #include "Input.h"
+#include "BakedMesh.h"
+#include "VertexFormatD3D11.h"
 #include "PathHelpers.h"
+#include "Profiler.h"
 
-// Needed for a helper function to load pre-compiled shader files
-#pragma comment(lib, "d3dcompiler.lib")
-#include <d3dcompiler.h>
+#include <climits>
 
 // For the DirectX Math library
 using namespace DirectX;
 
+// How many sorted draws each thread records at once when
+// multithreaded submission is on
+static const unsigned int DrawsPerRecordingChunk = 64;
+
+// Meshes (or levels of detail) with at most this many triangles
+// are simple enough to be occluders
+static const unsigned int MaxOccluderTriangles = 1024;
+
+// How far picking looks for an entity's neighbors, which is
+// also the entity grid's cell size
+static const float EntityNeighborRadius = 2.0f;
+
+// Starting size of the per-draw constant ring, which grows
+// if a frame needs more
+static const unsigned int DrawConstantRingSize = 256 * 1024;
+
+// Draw tints for each level of detail, when tinting by level
+// (levels past the last one use the last tint)
+static const XMFLOAT4 LodTints[] =
+{
+	XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f),
+	XMFLOAT4(0.5f, 1.0f, 0.5f, 1.0f),
+	XMFLOAT4(1.0f, 1.0f, 0.4f, 1.0f),
+	XMFLOAT4(1.0f, 0.6f, 0.3f, 1.0f),
+	XMFLOAT4(1.0f, 0.3f, 0.3f, 1.0f)
+};
+static const unsigned int LodTintCount = sizeof(LodTints) / sizeof(LodTints[0]);
+
+// --------------------------------------------------------
+// Copies the positions and indices of one level of a mesh,
+// keeping only the vertices it uses
+//
+// vertices   - The mesh's vertices
+// indices    - The mesh's 16 or 32-bit indices
+// indexSize  - 2 or 4
+// firstIndex - Where the level starts in indices
+// indexCount - How many indices the level has
+// positions  - Filled with the used positions
+// outIndices - Filled with indices into positions
+// --------------------------------------------------------
+static void CopyOccluderGeometry(
+	const Vertex* vertices,
+	const void* indices,
+	unsigned int indexSize,
+	unsigned int firstIndex,
+	unsigned int indexCount,
+	std::vector<XMFLOAT3>& positions,
+	std::vector<unsigned int>& outIndices)
+{
+	std::vector<unsigned int> remap;
+	outIndices.resize(indexCount);
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int index = indexSize == sizeof(unsigned short)
+			? ((const unsigned short*)indices)[firstIndex + i]
+			: ((const unsigned int*)indices)[firstIndex + i];
+
+		if (index >= remap.size())
+			remap.resize(index + 1, UINT_MAX);
+		if (remap[index] == UINT_MAX)
+		{
+			remap[index] = (unsigned int)positions.size();
+			positions.push_back(vertices[index].Position);
+		}
+		outIndices[i] = remap[index];
+	}
+}
+
 // --------------------------------------------------------
 // Constructor
 //
@@ -25,12 +94,29 @@ Game::Game(HINSTANCE hInstance)
 		1280,				// Width of the window's client area
 		720,				// Height of the window's client area
 		false,				// Sync the framerate to the monitor refresh? (lock framerate)
-		true)				// Show extra stats (fps) in title bar?
+		true),				// Show extra stats (fps) in title bar?
+	frustumCulling(true),
+	bvhCulling(false),
+	entityGrid(EntityNeighborRadius),
+	occlusionCulling(true),
+	meshletCulling(true),
+	instanceBufferCapacity(0),
+	lodTinting(false),
+	multithreadedSubmission(false),
+	vertexShaderPermutations("VertexShader", "vs_5_0", AllShaderFeatures),
+	pixelShaderPermutations("PixelShader", "ps_5_0", 0),
+	pixelShaderId(InvalidShaderId)
 {
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
 	CreateConsoleWindow(500, 120, 32, 120);
 	printf("Console window created successfully.  Feel free to printf() here.\n");
+
+	// Save the profiler's results (ProfileTrace.json for chrome://tracing
+	// and ProfileSummary.txt) and frame time stats (FrameStats.json/.csv)
+	// next to the .exe when the game closes
+	profilerDumpOnExit = true;
+	frameStatsDumpOnExit = true;
 #endif
 }
 
@@ -47,6 +133,14 @@ Game::~Game()
 
 	// Call Release() on any Direct3D objects made within this class
 	// - Note: this is unnecessary for D3D objects stored in ComPtrs
+
+#if defined(DEBUG) || defined(_DEBUG)
+	// Which shader permutations this run needed, and a script
+	// that compiles just those
+	const ShaderPermutationSet* permutations[] = { &vertexShaderPermutations, &pixelShaderPermutations };
+	ExportShaderPermutationReport(FixPath("ShaderPermutations.txt"), permutations, 2);
+	ExportShaderPermutationBuildScript(FixPath("BuildShaderPermutations.cmd"), permutations, 2);
+#endif
 }
 
 // --------------------------------------------------------
@@ -60,6 +154,31 @@ void Game::Init()
 	//  - You'll be expanding and/or replacing these later
 	LoadShaders();
 	CreateGeometry();
+	CreateEntities();
+
+	// Everything draws are allowed to refer to, by id (index)
+	BindShaderResources();
+	commandResources.instanceBuffers.push_back(instanceBuffer);	// Created once there are instances
+	commandResources.instanceStride = sizeof(InstanceData);
+	commandResources.meshes = meshes;
+
+	// Per-draw constants, laid out the way DrawData.hlsli
+	// declares them
+	drawConstantRing.reset(new ConstantBufferRing(device, context, DrawConstantRingSize));
+	drawConstantLayout.Add("viewProjection", CBufferFloat4x4, offsetof(DrawConstants, viewProjection));
+	drawConstantLayout.Add("colorTint", CBufferFloat4, offsetof(DrawConstants, colorTint));
+	commandResources.drawConstants = drawConstantRing.get();
+	commandResources.drawConstantSize = drawConstantLayout.GetSize();
+	parallelBackend = CreateD3D11RecordingBackend(device, context, commandResources);
+
+	// Each frame is described as passes, rebuilt by Draw()
+	renderGraph.reset(new D3D11RenderGraph(context, *resourcePool));
+
+	occlusionCuller.SetResolution(windowWidth / 4, windowHeight / 4);
+
+	// No camera yet, so the view and projection don't change anything
+	XMStoreFloat4x4(&viewMatrix, XMMatrixIdentity());
+	XMStoreFloat4x4(&projectionMatrix, XMMatrixIdentity());
 	
 	// Set initial graphics API state
 	//  - These settings persist until we change them
@@ -71,93 +190,68 @@ void Game::Init()
 		// Essentially: "What kind of shape should the GPU draw with our vertices?"
 		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-		// Ensure the pipeline knows how to interpret all the numbers stored in
-		// the vertex buffer. For this course, all of your vertices will probably
-		// have the same layout, so we can just set this once at startup.
-		context->IASetInputLayout(inputLayout.Get());
-
-		// Set the active vertex and pixel shaders
-		//  - Once you start applying different shaders to different objects,
-		//    these calls will need to happen multiple times per frame
-		context->VSSetShader(vertexShader.Get(), 0, 0);
-		context->PSSetShader(pixelShader.Get(), 0, 0);
+		// The input layout and shaders are set per draw in DrawScene(),
+		// which skips them whenever they're already bound
 	}
 }
 
 // --------------------------------------------------------
 // Loads shaders from compiled shader object (.cso) files
-// and also created the Input Layout that describes our 
-// vertex data to the rendering pipeline. 
-// - Input Layout creation is done here because it must 
-//    be verified against vertex shader byte code
-// - We'll have that byte code already loaded below
+// through the shader library, which also makes the input
+// layouts that describe our vertex data to the pipeline
+// - Visual Studio compiles our shaders at build time, and
+//    saves them as .cso files next to the .exe
+// - Vertex shaders are permutations of VertexShader.hlsl,
+//    picked by the features each vertex format needs
+// - In debug builds the files are watched, so rebuilding a
+//    shader while the game runs swaps it in
 // --------------------------------------------------------
 void Game::LoadShaders()
 {
-	// BLOBs (or Binary Large OBjects) for reading raw data from external files
-	// - This is a simplified way of handling big chunks of external data
-	// - Literally just a big array of bytes read from a file
-	ID3DBlob* pixelShaderBlob;
-	ID3DBlob* vertexShaderBlob;
-
-	// Loading shaders
-	//  - Visual Studio will compile our shaders at build time
-	//  - They are saved as .cso (Compiled Shader Object) files
-	//  - We need to load them when the application starts
-	{
-		// Read our compiled shader code files into blobs
-		// - Essentially just "open the file and plop its contents here"
-		// - Uses the custom FixPath() helper from Helpers.h to ensure relative paths
-		// - Note the "L" before the string - this tells the compiler the string uses wide characters
-		D3DReadFileToBlob(FixPath(L"PixelShader.cso").c_str(), &pixelShaderBlob);
-		D3DReadFileToBlob(FixPath(L"VertexShader.cso").c_str(), &vertexShaderBlob);
-
-		// Create the actual Direct3D shaders on the GPU
-		device->CreatePixelShader(
-			pixelShaderBlob->GetBufferPointer(),	// Pointer to blob's contents
-			pixelShaderBlob->GetBufferSize(),		// How big is that data?
-			0,										// No classes in this shader
-			pixelShader.GetAddressOf());			// Address of the ID3D11PixelShader pointer
-
-		device->CreateVertexShader(
-			vertexShaderBlob->GetBufferPointer(),	// Get a pointer to the blob's contents
-			vertexShaderBlob->GetBufferSize(),		// How big is that data?
-			0,										// No classes in this shader
-			vertexShader.GetAddressOf());			// The address of the ID3D11VertexShader pointer
-	}
-
-	// Create an input layout 
-	//  - This describes the layout of data sent to a vertex shader
-	//  - In other words, it describes how to interpret data (numbers) in a vertex buffer
-	//  - Doing this NOW because it requires a vertex shader's byte code to verify against!
-	//  - Luckily, we already have that loaded (the vertex shader blob above)
-	{
-		D3D11_INPUT_ELEMENT_DESC inputElements[2] = {};
-
-		// Set up the first element - a position, which is 3 float values
-		inputElements[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;				// Most formats are described as color channels; really it just means "Three 32-bit floats"
-		inputElements[0].SemanticName = "POSITION";							// This is "POSITION" - needs to match the semantics in our vertex shader input!
-		inputElements[0].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// How far into the vertex is this?  Assume it's after the previous element
-
-		// Set up the second element - a color, which is 4 more float values
-		inputElements[1].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;			// 4x 32-bit floats
-		inputElements[1].SemanticName = "COLOR";							// Match our vertex shader input!
-		inputElements[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;	// After the previous element
-
-		// Create the input layout, verifying our description against actual shader code
-		device->CreateInputLayout(
-			inputElements,							// An array of descriptions
-			2,										// How many elements in that array?
-			vertexShaderBlob->GetBufferPointer(),	// Pointer to the code of a shader that uses this layout
-			vertexShaderBlob->GetBufferSize(),		// Size of the shader code that uses this layout
-			inputLayout.GetAddressOf());			// Address of the resulting ID3D11InputLayout pointer
+	shaderLibrary.reset(new ShaderLibrary(device));
+	shaderLibrary->GetCache().SetDirectory(GetExePath());
+#if defined(DEBUG) || defined(_DEBUG)
+	shaderLibrary->GetCache().StartWatching();
+#endif
+
+	// Every draw is instanced, and each vertex format picks
+	// the rest of its vertex shader's features
+	for (unsigned int i = 0; i < VertexFormatCount; i++)
+	{
+		unsigned int key = ShaderKey<ShaderFeatureInstanced>::value | GetVertexFormatShaderFeatures(GetVertexFormat((VertexFormatId)i));
+		vertexShaderIds[i] = shaderLibrary->LoadPermutation(vertexShaderPermutations, key, ShaderStageVertex);
+	}
+	pixelShaderId = shaderLibrary->LoadPermutation(pixelShaderPermutations, 0, ShaderStagePixel);
+}
+
+// --------------------------------------------------------
+// Points draws' shader and input layout ids at the shader
+// library's current objects - at startup, and again after
+// any shaders are reloaded
+//  - Vertex shader and input layout ids are VertexFormatIds
+//  - An input layout that can't be created for a reloaded
+//    shader leaves the old one in place
+// --------------------------------------------------------
+void Game::BindShaderResources()
+{
+	commandResources.inputLayouts.resize(VertexFormatCount);
+	commandResources.vertexShaders.resize(VertexFormatCount);
+	commandResources.pixelShaders.resize(1);
+
+	for (unsigned int i = 0; i < VertexFormatCount; i++)
+	{
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> layout = shaderLibrary->GetInputLayout(vertexShaderIds[i], (VertexFormatId)i);
+		if (layout)
+			commandResources.inputLayouts[i] = layout;
+		commandResources.vertexShaders[i] = shaderLibrary->GetVertexShader(vertexShaderIds[i]);
 	}
+	commandResources.pixelShaders[0] = shaderLibrary->GetPixelShader(pixelShaderId);
 }
 
 
 
 // --------------------------------------------------------
-// Creates the geometry we're going to draw - a single triangle for now
+// Creates the geometry we're going to draw
 // --------------------------------------------------------
 void Game::CreateGeometry()
 {
@@ -167,6 +261,9 @@ void Game::CreateGeometry()
 	XMFLOAT4 green	= XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f);
 	XMFLOAT4 blue	= XMFLOAT4(0.0f, 0.0f, 1.0f, 1.0f);
 
+	// Everything below is flat and faces the screen
+	XMFLOAT3 facing	= XMFLOAT3(0.0f, 0.0f, -1.0f);
+
 	// Set up the vertices of the triangle we would like to draw
 	// - We're going to copy this array, exactly as it exists in CPU memory
 	//    over to a Direct3D-controlled data structure on the GPU (the vertex buffer)
@@ -179,72 +276,567 @@ void Game::CreateGeometry()
 	//    knowing the exact size (in pixels) of the image/window/etc.  
 	// - Long story short: Resizing the window also resizes the triangle,
 	//    since we're describing the triangle in terms of the window itself
-	Vertex vertices[] =
+	Vertex triangleVertices[] =
 	{
-		{ XMFLOAT3(+0.0f, +0.5f, +0.0f), red },
-		{ XMFLOAT3(+0.5f, -0.5f, +0.0f), blue },
-		{ XMFLOAT3(-0.5f, -0.5f, +0.0f), green },
+		{ XMFLOAT3(+0.0f, +0.5f, +0.0f), facing, XMFLOAT2(0, 0), red },
+		{ XMFLOAT3(+0.5f, -0.5f, +0.0f), facing, XMFLOAT2(0, 0), blue },
+		{ XMFLOAT3(-0.5f, -0.5f, +0.0f), facing, XMFLOAT2(0, 0), green },
 	};
 
 	// Set up indices, which tell us which vertices to use and in which order
-	// - This is redundant for just 3 vertices, but will be more useful later
-	// - Indices are technically not required if the vertices are in the buffer 
-	//    in the correct order and each one will be used exactly once
-	// - But just to see how it's done...
-	unsigned int indices[] = { 0, 1, 2 };
-
-
-	// Create a VERTEX BUFFER
-	// - This holds the vertex data of triangles for a single object
-	// - This buffer is created on the GPU, which is where the data needs to
-	//    be if we want the GPU to act on it (as in: draw it to the screen)
-	{
-		// First, we need to describe the buffer we want Direct3D to make on the GPU
-		//  - Note that this variable is created on the stack since we only need it once
-		//  - After the buffer is created, this description variable is unnecessary
-		D3D11_BUFFER_DESC vbd	= {};
-		vbd.Usage				= D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		vbd.ByteWidth			= sizeof(Vertex) * 3;       // 3 = number of vertices in the buffer
-		vbd.BindFlags			= D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
-		vbd.CPUAccessFlags		= 0;	// Note: We cannot access the data from C++ (this is good)
-		vbd.MiscFlags			= 0;
-		vbd.StructureByteStride = 0;
-
-		// Create the proper struct to hold the initial vertex data
-		// - This is how we initially fill the buffer with data
-		// - Essentially, we're specifying a pointer to the data to copy
-		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer on the GPU with the initial data
-		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
-		device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
-	}
-
-	// Create an INDEX BUFFER
-	// - This holds indices to elements in the vertex buffer
-	// - This is most useful when vertices are shared among neighboring triangles
-	// - This buffer is created on the GPU, which is where the data needs to
-	//    be if we want the GPU to act on it (as in: draw it to the screen)
-	{
-		// Describe the buffer, as we did above, with two major differences
-		//  - Byte Width (3 unsigned integers vs. 3 whole vertices)
-		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
-		D3D11_BUFFER_DESC ibd	= {};
-		ibd.Usage				= D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth			= sizeof(unsigned int) * 3;	// 3 = number of indices in the buffer
-		ibd.BindFlags			= D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
-		ibd.CPUAccessFlags		= 0;	// Note: We cannot access the data from C++ (this is good)
-		ibd.MiscFlags			= 0;
-		ibd.StructureByteStride = 0;
-
-		// Specify the initial data for this buffer, similar to above
-		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
-
-		// Actually create the buffer with the initial data
-		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-		device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+	unsigned int triangleIndices[] = { 0, 1, 2 };
+
+	// A square in the upper left, which shares two of its
+	// four vertices between its two triangles
+	Vertex squareVertices[] =
+	{
+		{ XMFLOAT3(-0.9f, +0.9f, +0.0f), facing, XMFLOAT2(0, 0), red },
+		{ XMFLOAT3(-0.7f, +0.9f, +0.0f), facing, XMFLOAT2(0, 0), green },
+		{ XMFLOAT3(-0.7f, +0.7f, +0.0f), facing, XMFLOAT2(0, 0), blue },
+		{ XMFLOAT3(-0.9f, +0.7f, +0.0f), facing, XMFLOAT2(0, 0), green },
+	};
+	unsigned int squareIndices[] = { 0, 1, 2, 0, 2, 3 };
+
+	// Each mesh copies its data into its own GPU buffers
+	meshes.push_back(std::make_shared<Mesh>(triangleVertices, 3, triangleIndices, 3, device));
+	meshes.push_back(std::make_shared<Mesh>(squareVertices, 4, squareIndices, 6, device));
+
+	// Both are simple enough to hide things behind them
+	meshOccluders.resize(meshes.size());
+	CopyOccluderGeometry(triangleVertices, triangleIndices, sizeof(unsigned int), 0, 3, meshOccluders[0].positions, meshOccluders[0].indices);
+	CopyOccluderGeometry(squareVertices, squareIndices, sizeof(unsigned int), 0, 6, meshOccluders[1].positions, meshOccluders[1].indices);
+
+	// Models from files - optional, so this is skipped if the file isn't there
+	//  - Quantized, since big models are where vertex bandwidth adds up
+	//    (with colors only if the model has any)
+	OccluderGeometry modelOccluder;
+	std::shared_ptr<Mesh> model = LoadObjMesh(FixPath("Models/Model.obj"), VertexFormatQuantized, &modelOccluder);
+	if (model)
+	{
+		meshes.push_back(model);
+		meshOccluders.push_back(modelOccluder);
+	}
+
+	// Meshes with quantized positions need them decoded
+	// before their world matrix is applied
+	for (unsigned int i = 0; i < meshes.size(); i++)
+		meshDecodeMatrices.push_back(GetPositionDecodeMatrix(meshes[i]->GetQuantization()));
+
+	// Local bounds, which entity bounds are worked out from
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		meshBoundsMins.push_back(meshes[i]->GetBoundsMin());
+		meshBoundsMaxs.push_back(meshes[i]->GetBoundsMax());
+	}
+
+	// Meshes without levels of detail just have the one
+	for (unsigned int i = 0; i < meshes.size(); i++)
+		lodSelector.SetMeshLods(i, meshes[i]->GetLods(), meshes[i]->GetLodCount());
+}
+
+
+// --------------------------------------------------------
+// Loads an OBJ file as a mesh, or returns null on failure
+//  - The first load bakes it to a .bmesh file next to it,
+//    and later loads map that file instead of parsing text
+//  - The bake is redone whenever the OBJ file changes
+//
+// path         - The OBJ file
+// vertexFormat - Format for the mesh's vertex buffer (Quantized
+//                adds colors if the model has any)
+// occluder     - Optional, filled with the finest level that's
+//                simple enough to be an occluder, if any is
+// --------------------------------------------------------
+std::shared_ptr<Mesh> Game::LoadObjMesh(const std::string& path, VertexFormatId vertexFormat, OccluderGeometry* occluder)
+{
+	PROFILE_ZONE("LoadObjMesh");
+
+	std::string bakedPath = path.substr(0, path.find_last_of('.')) + ".bmesh";
+
+	BakedMesh baked;
+	if (!baked.Open(bakedPath) || !baked.MatchesSource(path))
+	{
+		baked.Close();
+		std::string error;
+		if (!BakeObj(path, bakedPath, &jobs, &error) || !baked.Open(bakedPath))
+		{
+			if (!error.empty())
+				printf("Couldn't bake %s: %s\n", path.c_str(), error.c_str());
+			return 0;
+		}
+
+		printf("Baked %s\n", bakedPath.c_str());
+	}
+
+	printf("Loaded %s: %u triangles, %u vertices\n",
+		bakedPath.c_str(),
+		baked.GetIndexCount() / 3,
+		baked.GetVertexCount());
+
+	// Other formats are encoded from the baked vertices first
+	std::shared_ptr<Mesh> mesh;
+	if (vertexFormat == VertexFormatQuantized)
+		vertexFormat = ChooseQuantizedVertexFormat(baked.GetVertices(), baked.GetVertexCount());
+	if (vertexFormat != VertexFormatFull)
+	{
+		const VertexFormat& format = GetVertexFormat(vertexFormat);
+		VertexQuantization quantization = ComputeVertexQuantization(format, baked.GetVertices(), baked.GetVertexCount());
+
+		std::vector<unsigned char> encoded((size_t)format.stride * baked.GetVertexCount());
+		EncodeVertices(format, quantization, baked.GetVertices(), baked.GetVertexCount(), encoded.data());
+
+		mesh = std::make_shared<Mesh>(
+			encoded.data(), vertexFormat, quantization, baked.GetVertexCount(),
+			baked.GetIndices(), baked.Uses16BitIndices() ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, baked.GetIndexCount(),
+			device);
+	}
+	// Straight from the mapped file into the buffers - no copies
+	else if (baked.Uses16BitIndices())
+	{
+		mesh = std::make_shared<Mesh>(
+			baked.GetVertices(), baked.GetVertexCount(),
+			(const unsigned short*)baked.GetIndices(), baked.GetIndexCount(),
+			device);
+	}
+	else
+	{
+		mesh = std::make_shared<Mesh>(
+			baked.GetVertices(), baked.GetVertexCount(),
+			(const unsigned int*)baked.GetIndices(), baked.GetIndexCount(),
+			device);
+	}
+
+	// Levels of detail, if the bake made any
+	std::vector<MeshLod> lods(baked.GetLodCount());
+	for (unsigned int i = 0; i < lods.size(); i++)
+	{
+		lods[i].firstIndex = baked.GetLods()[i].firstIndex;
+		lods[i].indexCount = baked.GetLods()[i].indexCount;
+		lods[i].error = baked.GetLods()[i].error;
+	}
+	if (!lods.empty())
+		mesh->SetLods(lods.data(), (unsigned int)lods.size());
+
+	// Meshlets, for culling clusters of the finest level
+	if (baked.GetMeshletCount() > 0)
+		mesh->SetMeshlets(baked.GetMeshlets(), baked.GetMeshletCount(), baked.GetIndices(), device);
+
+	// Levels are finest first, so the first one that fits is the
+	// closest to the real shape (coarser levels can bulge out past
+	// it, which would hide things that should show)
+	if (occluder)
+	{
+		if (lods.empty())
+		{
+			MeshLod whole = { 0, baked.GetIndexCount(), 0.0f };
+			lods.push_back(whole);
+		}
+
+		for (unsigned int i = 0; i < lods.size(); i++)
+		{
+			if (lods[i].indexCount / 3 > MaxOccluderTriangles)
+				continue;
+
+			CopyOccluderGeometry(
+				baked.GetVertices(),
+				baked.GetIndices(),
+				baked.Uses16BitIndices() ? sizeof(unsigned short) : sizeof(unsigned int),
+				lods[i].firstIndex,
+				lods[i].indexCount,
+				occluder->positions,
+				occluder->indices);
+			break;
+		}
+	}
+
+	return mesh;
+}
+
+
+// --------------------------------------------------------
+// Creates the entities in our scene, each of which has a
+// transform and draws one of our meshes
+// --------------------------------------------------------
+void Game::CreateEntities()
+{
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		// Entity indices line up with the entityMeshes list
+		transforms.Create();
+		entityMeshes.push_back(i);
+		entityMaterials.push_back(0);
+	}
+	entityLods.resize(transforms.GetCount(), 0);
+
+	instanceBatcher.Reserve(transforms.GetCount());
+}
+
+
+// --------------------------------------------------------
+// Groups this frame's entities into instance batches and
+// copies their per-instance data into the instance buffer,
+// growing it first if there's not enough room
+// --------------------------------------------------------
+void Game::FillInstanceBuffer()
+{
+	PROFILE_ZONE("Instancing");
+
+	// Each entity's level of detail, from how big its mesh's
+	// simplification error would be on screen
+	XMMATRIX view = XMLoadFloat4x4(&viewMatrix);
+	XMFLOAT3 cameraPosition;
+	XMStoreFloat3(&cameraPosition, XMMatrixInverse(0, view).r[3]);
+
+	lodSelector.SetProjection(projectionMatrix, (float)windowHeight);
+	lodSelector.Select(
+		transforms.GetWorldMatrices(),
+		entityMeshes.data(),
+		transforms.GetCount(),
+		cameraPosition,
+		entityLods.data(),
+		&jobs);
+
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(
+		view,
+		XMLoadFloat4x4(&projectionMatrix)));
+
+	// Only entities the camera could see are batched
+	{
+		PROFILE_ZONE("Frustum Culling");
+		frustumCuller.UpdateBounds(
+			transforms.GetWorldMatrices(),
+			entityMeshes.data(),
+			meshBoundsMins.data(),
+			meshBoundsMaxs.data(),
+			transforms.GetCount(),
+			&jobs);
+
+		UpdateSceneBvh();
+
+		if (frustumCulling && bvhCulling)
+		{
+			visibleEntities.clear();
+			sceneBvh.QueryFrustum(ExtractFrustum(viewProjection), visibleEntities);
+		}
+		else if (frustumCulling)
+		{
+			frustumCuller.Cull(ExtractFrustum(viewProjection), visibleEntities, &jobs);
+		}
+		else
+		{
+			visibleEntities.resize(transforms.GetCount());
+			for (unsigned int i = 0; i < visibleEntities.size(); i++)
+				visibleEntities[i] = i;
+		}
+	}
+
+	if (occlusionCulling)
+		CullOccluded(viewProjection);
+
+	instanceBatcher.Clear();
+	for (unsigned int v = 0; v < visibleEntities.size(); v++)
+	{
+		unsigned int i = visibleEntities[v];
+		instanceBatcher.Add(i, entityMeshes[i], entityMaterials[i], entityLods[i]);
+	}
+
+	instanceBatcher.Build(transforms.GetWorldMatrices(), viewProjection, meshDecodeMatrices.data());
+	CullMeshlets(viewProjection, cameraPosition);
+
+	unsigned int instanceCount = instanceBatcher.GetInstanceCount();
+	if (instanceCount == 0)
+		return;
+
+	// Grow (to double the size) so this rarely happens
+	if (instanceCount > instanceBufferCapacity)
+	{
+		instanceBufferCapacity = instanceCount * 2;
+
+		D3D11_BUFFER_DESC desc	= {};
+		desc.Usage				= D3D11_USAGE_DYNAMIC;		// Rewritten every frame
+		desc.ByteWidth			= sizeof(InstanceData) * instanceBufferCapacity;
+		desc.BindFlags			= D3D11_BIND_VERTEX_BUFFER;	// Bound as a second vertex buffer
+		desc.CPUAccessFlags		= D3D11_CPU_ACCESS_WRITE;	// So we can Map() it
+		desc.MiscFlags			= 0;
+		desc.StructureByteStride = 0;
+
+		instanceBuffer.Reset();
+		device->CreateBuffer(&desc, 0, instanceBuffer.GetAddressOf());
+		commandResources.instanceBuffers[0] = instanceBuffer;
+	}
+
+	// Discarding lets the GPU keep using last frame's copy
+	// while we write this frame's
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (SUCCEEDED(context->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		memcpy(mapped.pData, instanceBatcher.GetInstanceData(), sizeof(InstanceData) * instanceCount);
+		context->Unmap(instanceBuffer.Get(), 0);
+	}
+}
+
+// --------------------------------------------------------
+// Writes every batch's constants into this frame's part of
+// the constant ring, remembering where each one went
+// --------------------------------------------------------
+void Game::FillDrawConstants()
+{
+	const std::vector<InstanceBatch>& batches = instanceBatcher.GetBatches();
+	unsigned int drawSize = drawConstantLayout.GetSize();
+	unsigned int blockSize = (drawSize + ConstantBufferAlignment - 1) & ~(ConstantBufferAlignment - 1);
+
+	// Instanced draws take their whole transform per instance,
+	// so only shaders that aren't instanced (drawing geometry
+	// that's already in world space) look at this
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(
+		XMLoadFloat4x4(&viewMatrix),
+		XMLoadFloat4x4(&projectionMatrix)));
+
+	drawConstantRing->BeginFrame((unsigned int)batches.size() * blockSize);
+	batchConstantOffsets.resize(batches.size());
+	for (unsigned int i = 0; i < batches.size(); i++)
+	{
+		const InstanceBatch& batch = batches[i];
+
+		DrawConstants constants;
+		constants.viewProjection = viewProjection;
+		constants.colorTint = lodTinting ?
+			LodTints[batch.lod < LodTintCount ? batch.lod : LodTintCount - 1] :
+			LodTints[0];
+
+		// Only fails if the GPU is lost, in which case it
+		// doesn't matter what gets bound
+		batchConstantOffsets[i] = 0;
+		void* destination = drawConstantRing->Allocate(drawSize, batchConstantOffsets[i]);
+		if (destination)
+			drawConstantLayout.Pack(&constants, destination);
+	}
+	drawConstantRing->EndWrites();
+}
+
+
+// --------------------------------------------------------
+// Fits the scene's hierarchy to where entities are now,
+// from the boxes the frustum culler just worked out.  It's
+// rebuilt when entities come or go, or once refitting has
+// made it half again as costly to search as a fresh build.
+// --------------------------------------------------------
+void Game::UpdateSceneBvh()
+{
+	unsigned int count = frustumCuller.GetCount();
+	entityBoundsMins.resize(count);
+	entityBoundsMaxs.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		frustumCuller.GetBox(i, entityBoundsMins[i], entityBoundsMaxs[i]);
+
+	if (sceneBvh.GetItemCount() != count)
+	{
+		sceneBvh.Build(entityBoundsMins.data(), entityBoundsMaxs.data(), count);
+		return;
+	}
+
+	sceneBvh.Refit(entityBoundsMins.data(), entityBoundsMaxs.data());
+	if (sceneBvh.GetStats().cost > sceneBvh.GetStats().buildCost * 1.5f)
+		sceneBvh.Build(entityBoundsMins.data(), entityBoundsMaxs.data(), count);
+}
+
+// --------------------------------------------------------
+// Hashes where entities are now into the grid.  Moving
+// entities are updated in place (the grid rebuilds itself
+// once too many have changed cells), and it's rebuilt when
+// entities come or go.
+// --------------------------------------------------------
+void Game::UpdateEntityGrid()
+{
+	unsigned int count = transforms.GetCount();
+	const XMFLOAT4X4* worlds = transforms.GetWorldMatrices();
+	entityPositions.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		entityPositions[i] = XMFLOAT3(worlds[i]._41, worlds[i]._42, worlds[i]._43);
+
+	if (entityGrid.GetCount() != count)
+		entityGrid.Build(entityPositions.data(), count, &jobs);
+	else
+		entityGrid.Update(entityPositions.data(), &jobs);
+}
+
+// --------------------------------------------------------
+// Finds the entity whose box is under the mouse (nearest
+// the camera, if there are several).  Returns false if
+// there's nothing there.
+//
+// mouseX/mouseY - Position in the window's client area, in pixels
+// entity        - The entity that was hit, on success
+// --------------------------------------------------------
+bool Game::PickEntity(int mouseX, int mouseY, unsigned int& entity)
+{
+	// Pixels to normalized device coordinates (y points up)
+	float x = 2.0f * (mouseX + 0.5f) / windowWidth - 1.0f;
+	float y = 1.0f - 2.0f * (mouseY + 0.5f) / windowHeight;
+
+	// Back through the camera to the near and far planes
+	XMMATRIX inverseViewProjection = XMMatrixInverse(0, XMMatrixMultiply(
+		XMLoadFloat4x4(&viewMatrix),
+		XMLoadFloat4x4(&projectionMatrix)));
+	XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(x, y, 0.0f, 1.0f), inverseViewProjection);
+	XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(x, y, 1.0f, 1.0f), inverseViewProjection);
+
+	// The ray's length is the whole depth range, so hits are 0 to 1
+	XMFLOAT3 origin, direction;
+	XMStoreFloat3(&origin, nearPoint);
+	XMStoreFloat3(&direction, XMVectorSubtract(farPoint, nearPoint));
+
+	BvhRayHit hit;
+	if (!sceneBvh.Raycast(origin, direction, 1.0f, hit))
+		return false;
+
+	entity = hit.item;
+	return true;
+}
+
+
+// --------------------------------------------------------
+// Draws the visible occluders into the occlusion culler's
+// depth buffer, then drops the visible entities hidden
+// behind them.  Occluders themselves are always kept, since
+// they'd be hidden by their own depth.
+//
+// viewProjection - The camera's view * projection
+// --------------------------------------------------------
+void Game::CullOccluded(const XMFLOAT4X4& viewProjection)
+{
+	PROFILE_ZONE("Occlusion Culling");
+
+	occlusionCuller.BeginFrame(viewProjection);
+	occlusionCandidates.clear();
+
+	unsigned int kept = 0;
+	for (unsigned int v = 0; v < visibleEntities.size(); v++)
+	{
+		unsigned int entity = visibleEntities[v];
+		const OccluderGeometry& occluder = meshOccluders[entityMeshes[entity]];
+		if (occluder.indices.empty())
+		{
+			occlusionCandidates.push_back(entity);
+			continue;
+		}
+
+		occlusionCuller.AddOccluder(
+			occluder.positions.data(),
+			(unsigned int)occluder.positions.size(),
+			occluder.indices.data(),
+			(unsigned int)occluder.indices.size(),
+			transforms.GetWorldMatrix(entity));
+		visibleEntities[kept++] = entity;
+	}
+	visibleEntities.resize(kept);
+
+	occlusionCuller.Render(&jobs);
+	occlusionCuller.Cull(entityBoundsMins.data(), entityBoundsMaxs.data(), occlusionCandidates, &jobs);
+	visibleEntities.insert(visibleEntities.end(), occlusionCandidates.begin(), occlusionCandidates.end());
+}
+
+// --------------------------------------------------------
+// Culls the meshlets of each mesh that's drawn just once
+// this frame, at its finest level, so it only draws the
+// clusters that could be seen.  Meshes drawn more than once
+// use their whole index buffer, since culling results only
+// hold for one instance.
+//
+// viewProjection - The camera's view * projection
+// cameraPosition - The camera's world space position
+// --------------------------------------------------------
+void Game::CullMeshlets(const XMFLOAT4X4& viewProjection, const XMFLOAT3& cameraPosition)
+{
+	PROFILE_ZONE("Meshlet Culling");
+
+	meshletStats = MeshletCullStats();
+	for (unsigned int i = 0; i < meshes.size(); i++)
+		meshes[i]->ClearMeshletCulling();
+
+	if (!meshletCulling)
+		return;
+
+	const std::vector<InstanceBatch>& batches = instanceBatcher.GetBatches();
+	std::vector<unsigned int> meshBatchCounts(meshes.size(), 0);
+	for (unsigned int i = 0; i < batches.size(); i++)
+		meshBatchCounts[batches[i].mesh]++;
+
+	// Back-face culling needs a perspective projection (which,
+	// unlike an orthographic one, copies z into w)
+	const XMFLOAT3* camera = projectionMatrix._34 != 0.0f ? &cameraPosition : 0;
+
+	for (unsigned int i = 0; i < batches.size(); i++)
+	{
+		const InstanceBatch& batch = batches[i];
+		std::shared_ptr<Mesh> mesh = meshes[batch.mesh];
+		if (mesh->GetMeshletCount() == 0 ||
+			meshBatchCounts[batch.mesh] != 1 ||
+			batch.instanceCount != 1 ||
+			batch.lod != 0)
+			continue;
+
+		unsigned int entity = instanceBatcher.GetInstanceEntity(batch.firstInstance);
+
+		MeshletCullStats stats;
+		mesh->CullMeshlets(context, transforms.GetWorldMatrices()[entity], viewProjection, camera, &stats);
+
+		meshletStats.meshletCount += stats.meshletCount;
+		meshletStats.frustumCulled += stats.frustumCulled;
+		meshletStats.backfaceCulled += stats.backfaceCulled;
+		meshletStats.triangleCount += stats.triangleCount;
+		meshletStats.trianglesCulled += stats.trianglesCulled;
+		meshletStats.cullMs += stats.cullMs;
+	}
+
+	if (meshletStats.triangleCount > 0)
+		meshletStats.culledTriangleRatio = (float)meshletStats.trianglesCulled / meshletStats.triangleCount;
+}
+
+
+// --------------------------------------------------------
+// Records a range of this frame's sorted draws.  Can run on
+// any thread, as long as each range has its own recorder.
+//
+// recorder - Where to record the draws
+// begin    - First draw (in sorted order) to record
+// end      - One past the last draw to record
+// --------------------------------------------------------
+void Game::RecordDraws(CommandRecorder& recorder, unsigned int begin, unsigned int end)
+{
+	PROFILE_ZONE("Record Draws");
+
+	// Each range might start on a fresh context, so
+	// nothing can be assumed to be bound already
+	StateCache stateCache;
+	recorder.SetInstanceBuffer(0);
+
+	const std::vector<InstanceBatch>& batches = instanceBatcher.GetBatches();
+	const std::vector<DrawItem>& items = renderQueue.GetItems();
+	for (unsigned int i = begin; i < end; i++)
+	{
+		const InstanceBatch& batch = batches[items[i].payload];
+		SortKey key = items[i].key;
+
+		if (stateCache.SetInputLayout(GetSortKeyLayout(key)))
+			recorder.SetInputLayout(GetSortKeyLayout(key));
+
+		if (stateCache.SetVertexShader(GetSortKeyShader(key)))
+			recorder.SetVertexShader(GetSortKeyShader(key));
+
+		// Every vertex shader shares the one pixel shader so far
+		if (stateCache.SetPixelShader(0))
+			recorder.SetPixelShader(0);
+
+		if (stateCache.SetMesh(batch.mesh))
+			recorder.SetMesh(batch.mesh);
+
+		// Every batch has its own constants
+		recorder.SetDrawConstants(batchConstantOffsets[items[i].payload]);
+
+		recorder.DrawInstanced(batch.instanceCount, batch.firstInstance, batch.lod);
 	}
 }
 
@@ -258,74 +850,265 @@ void Game::OnResize()
 {
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
+
+	// Occlusion is tested at a quarter of the window's size
+	occlusionCuller.SetResolution(windowWidth / 4, windowHeight / 4);
 }
 
 // --------------------------------------------------------
 // Update your game here - user input, move objects, AI, etc.
 // --------------------------------------------------------
-void Game::Update(float deltaTime, float totalTime)
+void Game::Update(float deltaTime, double totalTime)
 {
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::GetInstance().KeyDown(VK_ESCAPE))
 		Quit();
+
+	// Swap in any shaders that were rebuilt since last frame
+	std::vector<ShaderId> reloadedShaders;
+	std::vector<ShaderId> failedShaders;
+	if (shaderLibrary->ProcessReloads(reloadedShaders, &failedShaders) > 0)
+	{
+		for (unsigned int i = 0; i < reloadedShaders.size(); i++)
+			printf("Reloaded shader %s\n", shaderLibrary->GetCache().GetName(reloadedShaders[i]).c_str());
+		for (unsigned int i = 0; i < failedShaders.size(); i++)
+			printf("Couldn't create reloaded shader %s - keeping the old one\n", shaderLibrary->GetCache().GetName(failedShaders[i]).c_str());
+		BindShaderResources();
+	}
+
+	// Toggle multithreaded draw submission
+	if (Input::GetInstance().KeyPress('M'))
+		multithreadedSubmission = !multithreadedSubmission;
+
+	// Toggle tinting draws by level of detail, reporting how
+	// the per-draw constants are getting on
+	if (Input::GetInstance().KeyPress('L'))
+	{
+		const RingAllocatorStats& stats = drawConstantRing->GetStats();
+		printf("Draw constants: %llu allocations, %llu KB peak frame, %u KB ring, %u waits, %s\n",
+			stats.allocationCount,
+			(unsigned long long)stats.peakFrameBytes / 1024,
+			drawConstantRing->GetCapacity() / 1024,
+			drawConstantRing->GetWaitCount(),
+			drawConstantRing->IsBindingByOffset() ? "bound by offset" : "copied per draw");
+
+		lodTinting = !lodTinting;
+	}
+
+	// Toggle frustum culling, reporting how much the last frame drew
+	if (Input::GetInstance().KeyPress('F'))
+	{
+		const FrustumCullStats& stats = frustumCuller.GetStats();
+		printf("Frustum culling: %u of %u entities visible, %.3f ms bounds, %.3f ms culling\n",
+			stats.visibleCount,
+			stats.objectCount,
+			stats.boundsMs,
+			stats.cullMs);
+
+		frustumCulling = !frustumCulling;
+	}
+
+	// Toggle culling through the scene hierarchy instead
+	if (Input::GetInstance().KeyPress('B'))
+	{
+		const BvhStats& stats = sceneBvh.GetStats();
+		printf("Scene BVH: %u nodes, depth %u, cost %.2f (%.2f built), %u rotations, %.3f ms build, %.3f ms refit\n",
+			stats.nodeCount,
+			stats.depth,
+			stats.cost,
+			stats.buildCost,
+			stats.rotations,
+			stats.buildMs,
+			stats.refitMs);
+
+		bvhCulling = !bvhCulling;
+	}
+
+	// Toggle occlusion culling, reporting how much the last frame hid
+	if (Input::GetInstance().KeyPress('O'))
+	{
+		const OcclusionStats& stats = occlusionCuller.GetStats();
+		printf("Occlusion culling: %u of %u entities hidden by %u occluders (%u triangles), %.3f ms setup, %.3f ms raster, %.3f ms testing\n",
+			stats.occludedCount,
+			stats.testedCount,
+			stats.occluderCount,
+			stats.triangleCount,
+			stats.setupMs,
+			stats.rasterMs,
+			stats.testMs);
+
+		occlusionCulling = !occlusionCulling;
+	}
+
+	// Report what's under the mouse
+	if (Input::GetInstance().MouseLeftPress())
+	{
+		unsigned int entity;
+		if (PickEntity(Input::GetInstance().GetMouseX(), Input::GetInstance().GetMouseY(), entity))
+		{
+			// Anything close by (the entity finds itself, too)
+			std::vector<unsigned int> neighbors;
+			entityGrid.QueryRadius(entityPositions[entity], EntityNeighborRadius, neighbors);
+
+			unsigned int nearest[2];
+			unsigned int nearestCount = entityGrid.QueryNearest(entityPositions[entity], 2, nearest);
+
+			printf("Picked entity %u (mesh %u), %u other entities within %.1f units",
+				entity,
+				entityMeshes[entity],
+				(unsigned int)neighbors.size() - 1,
+				EntityNeighborRadius);
+			for (unsigned int i = 0; i < nearestCount; i++)
+			{
+				if (nearest[i] != entity)
+				{
+					printf(", nearest is %u", nearest[i]);
+					break;
+				}
+			}
+			printf("\n");
+		}
+	}
+
+	// Toggle meshlet culling, reporting how much the last frame culled
+	if (Input::GetInstance().KeyPress('C'))
+	{
+		printf("Meshlet culling: %u of %u meshlets (%u off screen, %u facing away), %.1f%% of triangles, %.3f ms\n",
+			meshletStats.frustumCulled + meshletStats.backfaceCulled,
+			meshletStats.meshletCount,
+			meshletStats.frustumCulled,
+			meshletStats.backfaceCulled,
+			meshletStats.culledTriangleRatio * 100.0f,
+			meshletStats.cullMs);
+
+		meshletCulling = !meshletCulling;
+	}
+
+	// Rebuild world matrices for anything that moved this frame
+	{
+		PROFILE_ZONE("Transforms");
+		transforms.UpdateWorldMatrices();
+	}
+
+	{
+		PROFILE_ZONE("Spatial Grid");
+		UpdateEntityGrid();
+	}
 }
 
 // --------------------------------------------------------
 // Clear the screen, redraw everything, present to the user
+//
+// interpolationAlpha - When using a fixed timestep, how far (0-1)
+//                      we are between the last two Update() calls
 // --------------------------------------------------------
-void Game::Draw(float deltaTime, float totalTime)
+void Game::Draw(float deltaTime, double totalTime, float interpolationAlpha)
 {
-	// Frame START
-	// - These things should happen ONCE PER FRAME
-	// - At the beginning of Game::Draw() before drawing *anything*
-	{
-		// Clear the back buffer (erases what's on the screen)
-		const float bgColor[4] = { 0.4f, 0.6f, 0.75f, 1.0f }; // Cornflower Blue
-		context->ClearRenderTargetView(backBufferRTV.Get(), bgColor);
+	// The frame as a render graph
+	// - Passes declare what they read and write, and the graph
+	//    orders them, skips any whose results go unused and binds
+	//    each one's targets before it runs
+	// - Rebuilt every frame, so it always has this frame's views
+	//    (which change when the window resizes)
+	renderGraph->Clear();
+	RenderGraph& graph = renderGraph->GetGraph();
+	RenderResourceId backBuffer = renderGraph->ImportTexture("Back buffer", backBufferRTV, 0, 0, windowWidth, windowHeight);
+	RenderResourceId depthBuffer = renderGraph->ImportTexture("Depth buffer", 0, depthBufferDSV, 0, windowWidth, windowHeight);
 
-		// Clear the depth buffer (resets per-pixel occlusion information)
-		context->ClearDepthStencilView(depthBufferDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
-	}
+	// Everything the scene pass needs is worked out and uploaded
+	// up front, so the pass itself only records and submits
+	PrepareScene();
+
+	// Frame START
+	// - Clear the back buffer (erases what's on the screen) and
+	//    the depth buffer (resets per-pixel occlusion information)
+	RenderPassId clear = graph.AddPass("Clear", [this, backBuffer, depthBuffer]()
+		{
+			const float bgColor[4] = { 0.4f, 0.6f, 0.75f, 1.0f }; // Cornflower Blue
+			context->ClearRenderTargetView(renderGraph->GetRenderTargetView(backBuffer), bgColor);
+			context->ClearDepthStencilView(renderGraph->GetDepthStencilView(depthBuffer), D3D11_CLEAR_DEPTH, 1.0f, 0);
+		});
+	backBuffer = graph.Write(clear, backBuffer);
+	depthBuffer = graph.Write(clear, depthBuffer);
 
 	// DRAW geometry
-	// - These steps are generally repeated for EACH object you draw
-	// - Other Direct3D calls will also be necessary to do more complex things
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	{
-		// Set buffers in the input assembler (IA) stage
-		//  - Do this ONCE PER OBJECT, since each object may have different geometry
-		//  - For this demo, this step *could* simply be done once during Init()
-		//  - However, this needs to be done between EACH DrawIndexed() call
-		//     when drawing different geometry, so it's here as an example
-		context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-		context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-
-		// Tell Direct3D to draw
-		//  - Begins the rendering pipeline on the GPU
-		//  - Do this ONCE PER OBJECT you intend to draw
-		//  - This will use all currently set Direct3D resources (shaders, buffers, etc)
-		//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
-		//     vertices in the currently set VERTEX BUFFER
-		context->DrawIndexed(
-			3,     // The number of indices to use (we could draw a subset if we wanted)
-			0,     // Offset to the first index we want to use
-			0);    // Offset to add to each index when looking up vertices
-	}
+	RenderPassId scene = graph.AddPass("Scene", [this]() { DrawScene(); });
+	backBuffer = graph.Write(scene, backBuffer, RenderGraphColorTarget);
+	depthBuffer = graph.Write(scene, depthBuffer, RenderGraphDepthTarget);
 
 	// Frame END
-	// - These should happen exactly ONCE PER FRAME
-	// - At the very end of the frame (after drawing *everything*)
+	// - Present the back buffer to the user
+	//  - Puts the results of what we've drawn onto the window
+	//  - Without this, the user never sees anything
+	// - Presenting unbinds the back buffer, but the graph binds
+	//    next frame's targets again before they're drawn to
+	RenderPassId present = graph.AddPass("Present", [this]()
+		{
+			PROFILE_ZONE("Present");
+			bool vsyncNecessary = vsync || !deviceSupportsTearing || isFullscreen;
+			swapChain->Present(
+				vsyncNecessary ? 1 : 0,
+				vsyncNecessary ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+		},
+		true);
+	graph.Read(present, backBuffer);
+
+	if (renderGraph->Compile())
+		renderGraph->Execute();
+
+	// Once the GPU gets this far, the frame's constants can be
+	// reused - ended whether or not anything was drawn, so every
+	// BeginFrame() in FillDrawConstants() has its EndFrame()
+	drawConstantRing->EndFrame();
+}
+
+// --------------------------------------------------------
+// The CPU side of the scene pass - culls and batches this
+// frame's entities, sorts their draws and uploads their
+// instance data and constants
+// --------------------------------------------------------
+void Game::PrepareScene()
+{
+	// - Entities sharing a mesh and material are drawn together,
+	//    with one draw call per group rather than per entity
+	// - Groups are sorted so draws sharing state end up next to each
+	//    other, and state that's already bound isn't set again
+	FillInstanceBuffer();
+
+	// Each mesh's vertex format picks its vertex shader and layout
+	// (nothing visible leaves this empty, with nothing to draw)
+	const std::vector<InstanceBatch>& batches = instanceBatcher.GetBatches();
+	renderQueue.Clear();
+	for (unsigned int i = 0; i < batches.size(); i++)
 	{
-		// Present the back buffer to the user
-		//  - Puts the results of what we've drawn onto the window
-		//  - Without this, the user never sees anything
-		bool vsyncNecessary = vsync || !deviceSupportsTearing || isFullscreen;
-		swapChain->Present(
-			vsyncNecessary ? 1 : 0,
-			vsyncNecessary ? 0 : DXGI_PRESENT_ALLOW_TEARING);
+		unsigned int format = meshes[batches[i].mesh]->GetVertexFormatId();
+		renderQueue.Add(MakeSortKey(0, format, format, batches[i].material, batches[i].mesh, 0.0f), i);
+	}
+	renderQueue.Sort();
+	FillDrawConstants();
+}
 
-		// Must re-bind buffers after presenting, as they become unbound
-		context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
+// --------------------------------------------------------
+// The scene pass - records and submits the draws that
+// PrepareScene() set up
+// --------------------------------------------------------
+void Game::DrawScene()
+{
+	if (renderQueue.GetCount() == 0)
+		return;
+
+	PROFILE_ZONE("Submit");
+	if (multithreadedSubmission)
+	{
+		RecordParallel(jobs, *parallelBackend, renderQueue.GetCount(), DrawsPerRecordingChunk,
+			[this](CommandRecorder& recorder, unsigned int begin, unsigned int end)
+			{
+				RecordDraws(recorder, begin, end);
+			});
+	}
+	else
+	{
+		D3D11CommandRecorder recorder(context, commandResources);
+		RecordDraws(recorder, 0, renderQueue.GetCount());
 	}
-}
\ No newline at end of file
+}
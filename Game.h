@@ -1,7 +1,27 @@
 #pragma once
 
+#include "Bvh.h"
+#include "CBufferLayout.h"
+#include "ConstantBufferRing.h"
+#include "D3D11CommandRecorder.h"
+#include "D3D11RenderGraph.h"
 #include "DXCore.h"
+#include "FrustumCuller.h"
+#include "InstanceBatcher.h"
+#include "JobSystem.h"
+#include "LodSelector.h"
+#include "Mesh.h"
+#include "MeshletBuilder.h"
+#include "OcclusionCuller.h"
+#include "RenderQueue.h"
+#include "ShaderLibrary.h"
+#include "SpatialGrid.h"
+#include "TransformSystem.h"
+#include "VertexFormat.h"
+
 #include <DirectXMath.h>
+#include <memory>
+#include <vector>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 
 class Game 
@@ -16,28 +36,136 @@ public:
 	// will be called automatically
 	void Init();
 	void OnResize();
-	void Update(float deltaTime, float totalTime);
-	void Draw(float deltaTime, float totalTime);
+	void Update(float deltaTime, double totalTime);
+	void Draw(float deltaTime, double totalTime, float interpolationAlpha);
 
 private:
 
+	// A CPU copy of a mesh simple enough to occlude others
+	// (empty for meshes that aren't occluders)
+	struct OccluderGeometry
+	{
+		std::vector<DirectX::XMFLOAT3> positions;
+		std::vector<unsigned int> indices;
+	};
+
+	// Each draw's constants on the C++ side - packed into
+	// DrawData (DrawData.hlsli) by drawConstantLayout
+	struct DrawConstants
+	{
+		DirectX::XMFLOAT4X4 viewProjection;	// The camera's, for shaders that aren't instanced
+		DirectX::XMFLOAT4 colorTint;
+	};
+
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
 	void LoadShaders(); 
+	void BindShaderResources();
 	void CreateGeometry();
+	std::shared_ptr<Mesh> LoadObjMesh(const std::string& path, VertexFormatId vertexFormat, OccluderGeometry* occluder = 0);
+	void CreateEntities();
+	void FillInstanceBuffer();
+	void FillDrawConstants();
+	void PrepareScene();
+	void DrawScene();
+	void UpdateSceneBvh();
+	void UpdateEntityGrid();
+	bool PickEntity(int mouseX, int mouseY, unsigned int& entity);
+	void CullOccluded(const DirectX::XMFLOAT4X4& viewProjection);
+	void CullMeshlets(const DirectX::XMFLOAT4X4& viewProjection, const DirectX::XMFLOAT3& cameraPosition);
+	void RecordDraws(CommandRecorder& recorder, unsigned int begin, unsigned int end);
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
 	//     Component Object Model, which DirectX objects do
 	//  - More info here: https://github.com/Microsoft/DirectXTK/wiki/ComPtr
 
-	// Buffers to hold actual geometry data
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	// Geometry that entities can draw
+	std::vector<std::shared_ptr<Mesh>> meshes;
+	std::vector<DirectX::XMFLOAT4X4> meshDecodeMatrices;	// Per mesh, for quantized positions
+	std::vector<DirectX::XMFLOAT3> meshBoundsMins;			// Per mesh, for culling
+	std::vector<DirectX::XMFLOAT3> meshBoundsMaxs;
+
+	// The scene - every entity has a transform and draws one mesh
+	TransformSystem transforms;
+	std::vector<unsigned int> entityMeshes;		// Index into meshes, per entity
+	std::vector<unsigned int> entityMaterials;	// Material index, per entity (all 0 for now)
+	std::vector<unsigned char> entityLods;		// Level of detail, per entity (kept between frames)
+
+	// Only entities at least partly inside the camera's frustum
+	// are drawn - visibleEntities lists them each frame
+	bool frustumCulling;
+	FrustumCuller frustumCuller;
+	std::vector<unsigned int> visibleEntities;
+
+	// A hierarchy over the entities' world space boxes, refit
+	// each frame - for picking, and optionally for culling
+	// (which only beats the linear culler for big scenes)
+	bool bvhCulling;
+	Bvh sceneBvh;
+	std::vector<DirectX::XMFLOAT3> entityBoundsMins;
+	std::vector<DirectX::XMFLOAT3> entityBoundsMaxs;
+
+	// Entity positions hashed into a grid, for finding what's
+	// near something (cheaper than the hierarchy when all
+	// that matters is where entities are, not their extents)
+	SpatialGrid entityGrid;
+	std::vector<DirectX::XMFLOAT3> entityPositions;
+
+	// Occlusion culling - visible entities drawing occluder
+	// meshes hide whatever's behind them
+	bool occlusionCulling;
+	OcclusionCuller occlusionCuller;
+	std::vector<OccluderGeometry> meshOccluders;	// Per mesh
+	std::vector<unsigned int> occlusionCandidates;	// Visible entities that aren't occluders
+
+	// Levels of detail are picked by projected error each frame
+	LodSelector lodSelector;
+
+	// Per-meshlet culling, for meshes drawn once at full detail
+	bool meshletCulling;
+	MeshletCullStats meshletStats;	// Totals for the last frame
+
+	// Camera matrices - identity until there's an actual camera,
+	// so positions are still in screen space
+	DirectX::XMFLOAT4X4 viewMatrix;
+	DirectX::XMFLOAT4X4 projectionMatrix;
+
+	// Instancing - entities are grouped by mesh and material, and
+	// each group is drawn with a single DrawIndexedInstanced()
+	InstanceBatcher instanceBatcher;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+	unsigned int instanceBufferCapacity;	// In instances
+
+	// Draws are sorted by key before submission, and state
+	// that's already bound is skipped
+	RenderQueue renderQueue;
+
+	// Per-draw constants - every batch gets its own range of
+	// one big constant buffer each frame
+	std::unique_ptr<ConstantBufferRing> drawConstantRing;
+	CBufferLayout drawConstantLayout;
+	std::vector<unsigned int> batchConstantOffsets;	// Per batch, into the ring
+	bool lodTinting;								// Tint each draw by its level of detail
+
+	// Submission - draws are recorded by id through a CommandRecorder,
+	// either directly on the immediate context or (when multithreaded
+	// submission is on) in chunks across the job system's threads
+	JobSystem jobs;
+	D3D11CommandResources commandResources;
+	std::unique_ptr<RecordingBackend> parallelBackend;
+	bool multithreadedSubmission;
+
+	// The frame's passes, and the textures they draw to
+	std::unique_ptr<D3D11RenderGraph> renderGraph;
 	
 	// Shaders and shader-related constructs
-	Microsoft::WRL::ComPtr<ID3D11PixelShader> pixelShader;
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> vertexShader;
-	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+	//  - One vertex shader permutation per vertex format, indexed
+	//    by VertexFormatId
+	std::unique_ptr<ShaderLibrary> shaderLibrary;
+	ShaderPermutationSet vertexShaderPermutations;
+	ShaderPermutationSet pixelShaderPermutations;
+	ShaderId pixelShaderId;
+	ShaderId vertexShaderIds[VertexFormatCount];
 
 };
 
@@ -0,0 +1,243 @@
+#include "GameClock.h"
+
+#include <algorithm>
+#include <chrono>
+
+// --------------------------------------------------------
+// Current system time, in ticks
+//  - steady_clock never jumps backwards (unlike wall time)
+//    and is backed by QueryPerformanceCounter on Windows
+// --------------------------------------------------------
+int64_t SystemTimeSource::GetTicks()
+{
+	return (int64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+// --------------------------------------------------------
+// How many system ticks make up a second
+// --------------------------------------------------------
+int64_t SystemTimeSource::GetFrequency()
+{
+	typedef std::chrono::steady_clock::period Period;
+	return (int64_t)(Period::den / Period::num);
+}
+
+
+// --------------------------------------------------------
+// Constructor - Manual time starts at zero
+//
+// frequency - Ticks per second (defaults to nanoseconds)
+// --------------------------------------------------------
+ManualTimeSource::ManualTimeSource(int64_t frequency)
+	:
+	ticks(0),
+	frequency(frequency)
+{
+}
+
+// --------------------------------------------------------
+// Current manual time and its ticks per second
+// --------------------------------------------------------
+int64_t ManualTimeSource::GetTicks() { return ticks; }
+int64_t ManualTimeSource::GetFrequency() { return frequency; }
+
+// --------------------------------------------------------
+// Moves time forward by an exact number of ticks
+// --------------------------------------------------------
+void ManualTimeSource::Advance(int64_t ticks)
+{
+	this->ticks += ticks;
+}
+
+// --------------------------------------------------------
+// Moves time forward by (approximately) the given seconds,
+// rounded to the nearest tick
+// --------------------------------------------------------
+void ManualTimeSource::AdvanceSeconds(double seconds)
+{
+	ticks += (int64_t)(seconds * frequency + 0.5);
+}
+
+
+// --------------------------------------------------------
+// Constructor for a root clock, which reads from a time source
+//
+// source - Where to get ticks from (must outlive this clock)
+// --------------------------------------------------------
+GameClock::GameClock(TimeSource* source)
+	:
+	source(source),
+	parent(0),
+	frequency(source->GetFrequency()),
+	lastSourceTicks(source->GetTicks()),
+	totalTicks(0),
+	deltaTicks(0),
+	paused(false),
+	scale(1.0),
+	scaleRemainder(0.0)
+{
+}
+
+// --------------------------------------------------------
+// Constructor for a child clock, which advances whenever
+// its parent does (after the parent's own pause and scale)
+//
+// parent - The clock to follow (must outlive this clock)
+// --------------------------------------------------------
+GameClock::GameClock(GameClock& parent)
+	:
+	source(0),
+	parent(&parent),
+	frequency(parent.frequency),
+	lastSourceTicks(0),
+	totalTicks(0),
+	deltaTicks(0),
+	paused(false),
+	scale(1.0),
+	scaleRemainder(0.0)
+{
+	parent.children.push_back(this);
+}
+
+// --------------------------------------------------------
+// Destructor - Unhook from our parent, if we have one
+// --------------------------------------------------------
+GameClock::~GameClock()
+{
+	if (parent)
+	{
+		std::vector<GameClock*>& siblings = parent->children;
+		siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+	}
+
+	// Any remaining children simply stop advancing
+	for (GameClock* child : children)
+		child->parent = 0;
+}
+
+// --------------------------------------------------------
+// Starts this clock (and its children) over from zero
+// --------------------------------------------------------
+void GameClock::Reset()
+{
+	if (source)
+		lastSourceTicks = source->GetTicks();
+
+	totalTicks = 0;
+	deltaTicks = 0;
+	scaleRemainder = 0.0;
+
+	for (GameClock* child : children)
+		child->Reset();
+}
+
+// --------------------------------------------------------
+// Reads the time source and advances this clock and all of
+// its children.  Call once per frame on a root clock only;
+// children are ticked automatically.
+// --------------------------------------------------------
+void GameClock::Tick()
+{
+	if (!source)
+		return;
+
+	// Clamp to zero, as the counter could appear to go backwards
+	// if the process moves between cores or the source is replaced
+	int64_t now = source->GetTicks();
+	int64_t elapsed = std::max<int64_t>(now - lastSourceTicks, 0);
+	lastSourceTicks = now;
+
+	Advance(elapsed);
+}
+
+// --------------------------------------------------------
+// Applies pause and scale to the incoming ticks, then
+// passes the result down to any children
+// --------------------------------------------------------
+void GameClock::Advance(int64_t parentDeltaTicks)
+{
+	if (paused)
+	{
+		deltaTicks = 0;
+	}
+	else if (scale == 1.0)
+	{
+		deltaTicks = parentDeltaTicks;
+	}
+	else
+	{
+		// Keep the fractional part of each scaled delta so
+		// slow motion doesn't lose (or gain) time over many frames
+		double scaled = parentDeltaTicks * scale + scaleRemainder;
+		deltaTicks = (int64_t)scaled;
+		scaleRemainder = scaled - (double)deltaTicks;
+	}
+
+	totalTicks += deltaTicks;
+
+	for (GameClock* child : children)
+		child->Advance(deltaTicks);
+}
+
+// --------------------------------------------------------
+// Pausing stops this clock and everything below it
+// --------------------------------------------------------
+void GameClock::SetPaused(bool paused)
+{
+	this->paused = paused;
+}
+
+bool GameClock::IsPaused() const
+{
+	return paused;
+}
+
+// --------------------------------------------------------
+// Scales how fast this clock (and its children) run
+// compared to the parent - 0.5 for half speed, 2 for double
+// --------------------------------------------------------
+void GameClock::SetScale(double scale)
+{
+	this->scale = std::max(scale, 0.0);
+}
+
+double GameClock::GetScale() const
+{
+	return scale;
+}
+
+// --------------------------------------------------------
+// Raw tick values - divide by the frequency for seconds
+// --------------------------------------------------------
+int64_t GameClock::GetFrequency() const { return frequency; }
+int64_t GameClock::GetTotalTicks() const { return totalTicks; }
+int64_t GameClock::GetDeltaTicks() const { return deltaTicks; }
+
+// --------------------------------------------------------
+// Total time this clock has run, in seconds
+// --------------------------------------------------------
+double GameClock::GetTotalSeconds() const
+{
+	return TicksToSeconds(totalTicks);
+}
+
+// --------------------------------------------------------
+// Time this clock advanced during the last Tick(), in seconds
+// --------------------------------------------------------
+double GameClock::GetDeltaSeconds() const
+{
+	return TicksToSeconds(deltaTicks);
+}
+
+// --------------------------------------------------------
+// Converts ticks to seconds without losing precision on very
+// large tick counts - whole seconds and the leftover ticks
+// are converted separately, so the fractional part stays
+// exact no matter how long the clock has been running
+// --------------------------------------------------------
+double GameClock::TicksToSeconds(int64_t ticks) const
+{
+	int64_t wholeSeconds = ticks / frequency;
+	int64_t remainder = ticks % frequency;
+	return (double)wholeSeconds + (double)remainder / (double)frequency;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// --------------------------------------------------------
+// Where a root clock gets its raw ticks from
+// --------------------------------------------------------
+class TimeSource
+{
+public:
+	virtual ~TimeSource() {}
+	virtual int64_t GetTicks() = 0;
+	virtual int64_t GetFrequency() = 0; // Ticks per second
+};
+
+// --------------------------------------------------------
+// The real, high resolution system time
+// --------------------------------------------------------
+class SystemTimeSource : public TimeSource
+{
+public:
+	int64_t GetTicks();
+	int64_t GetFrequency();
+};
+
+// --------------------------------------------------------
+// Time that only moves when told to, so long runs can be
+// simulated (in tests or benchmarks) faster than real time
+// --------------------------------------------------------
+class ManualTimeSource : public TimeSource
+{
+public:
+	ManualTimeSource(int64_t frequency = 1000000000);
+
+	int64_t GetTicks();
+	int64_t GetFrequency();
+
+	void Advance(int64_t ticks);
+	void AdvanceSeconds(double seconds);
+
+private:
+	int64_t ticks;
+	int64_t frequency;
+};
+
+// --------------------------------------------------------
+// A clock that counts 64-bit integer ticks internally and
+// reports double-precision seconds.  A root clock reads a
+// TimeSource; child clocks follow their parent and can be
+// paused or scaled independently (gameplay, UI, debug...)
+// --------------------------------------------------------
+class GameClock
+{
+public:
+	GameClock(TimeSource* source);
+	GameClock(GameClock& parent);
+	~GameClock();
+
+	// Clocks are linked to each other by pointer
+	GameClock(GameClock const&) = delete;
+	void operator=(GameClock const&) = delete;
+
+	void Reset();
+	void Tick();
+
+	void SetPaused(bool paused);
+	bool IsPaused() const;
+	void SetScale(double scale);
+	double GetScale() const;
+
+	int64_t GetFrequency() const;
+	int64_t GetTotalTicks() const;
+	int64_t GetDeltaTicks() const;
+	double GetTotalSeconds() const;
+	double GetDeltaSeconds() const;
+
+private:
+	TimeSource* source;
+	GameClock* parent;
+	std::vector<GameClock*> children;
+
+	int64_t frequency;
+	int64_t lastSourceTicks;
+	int64_t totalTicks;
+	int64_t deltaTicks;
+
+	bool paused;
+	double scale;
+	double scaleRemainder; // Fractional ticks carried between scaled frames
+
+	void Advance(int64_t parentDeltaTicks);
+	double TicksToSeconds(int64_t ticks) const;
+};
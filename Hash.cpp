@@ -0,0 +1,31 @@
+#include "Hash.h"
+
+// --------------------------------------------------------
+// 32-bit FNV-1a
+// --------------------------------------------------------
+unsigned int Fnv1a32(const void* data, size_t size, unsigned int seed)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned int hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// 64-bit FNV-1a
+// --------------------------------------------------------
+unsigned long long Fnv1a64(const void* data, size_t size, unsigned long long seed)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned long long hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
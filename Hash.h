@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+// --------------------------------------------------------
+// FNV-1a hashes of raw bytes - fast, simple and good enough
+// for checksums and hash table keys (not for security).
+//
+// seed - Pass a previous result to continue hashing more
+//        data as if it had been appended
+// --------------------------------------------------------
+static const unsigned int Fnv1a32Seed = 2166136261u;
+static const unsigned long long Fnv1a64Seed = 14695981039346656037ull;
+
+unsigned int Fnv1a32(const void* data, size_t size, unsigned int seed = Fnv1a32Seed);
+unsigned long long Fnv1a64(const void* data, size_t size, unsigned long long seed = Fnv1a64Seed);
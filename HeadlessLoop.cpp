@@ -0,0 +1,128 @@
+#include "HeadlessLoop.h"
+
+#include <chrono>
+
+// --------------------------------------------------------
+// Constructor
+//
+// update - The function to call each frame (or each fixed step),
+//          just like DXCore calls Update(deltaTime, totalTime)
+// draw   - Optional function to call once per frame, after
+//          updating, just like DXCore calls Draw()
+// --------------------------------------------------------
+HeadlessLoop::HeadlessLoop(
+	std::function<void(float deltaTime, double totalTime)> update,
+	std::function<void(float deltaTime, double totalTime, float interpolationAlpha)> draw)
+	:
+	update(update),
+	draw(draw),
+	quitRequested(false)
+{
+}
+
+// --------------------------------------------------------
+// Runs the update (and draw) functions over and over, timing
+// each frame with std::chrono, until either the requested
+// number of frames has passed or Quit() has been called.
+//
+// settings - How many frames to run, where frame time comes
+//            from (a fixed length, a custom time source or
+//            real time) and whether Update() runs at a
+//            fixed tick rate
+//
+// - A fixed frame length advances a ManualTimeSource, so a
+//   run can cover hours of game time in a few seconds
+// --------------------------------------------------------
+HeadlessLoopReport HeadlessLoop::Run(const HeadlessLoopSettings& settings)
+{
+	typedef std::chrono::steady_clock WallClock;
+
+	quitRequested = false;
+
+	bool useFixedTimestep = settings.fixedTickRate > 0.0;
+	if (useFixedTimestep)
+	{
+		fixedTimestep.SetTickRate(settings.fixedTickRate);
+		fixedTimestep.SetMaxStepsPerFrame(settings.maxCatchUpSteps);
+		fixedTimestep.Reset();
+	}
+
+	HeadlessLoopReport report;
+
+	// All stats memory is allocated here, before the first frame
+	unsigned int windowSize = settings.statsWindowSize;
+	if (windowSize == 0)
+		windowSize = settings.frameCount > 0 ? settings.frameCount : 64 * 1024;
+	FrameStats frameStats(windowSize, settings.budgetMs);
+
+	// Pick where game time comes from
+	SystemTimeSource systemTime;
+	ManualTimeSource manualTime;
+	TimeSource* source = settings.timeSource ? settings.timeSource : &systemTime;
+	if (settings.fixedDeltaTime > 0.0f)
+		source = &manualTime;
+
+	GameClock clock(source);
+
+	WallClock::time_point startTime = WallClock::now();
+	unsigned int frame = 0;
+
+	while (!quitRequested && (settings.frameCount == 0 || frame < settings.frameCount))
+	{
+		WallClock::time_point frameStart = WallClock::now();
+
+		// Advance game time for this frame
+		if (settings.fixedDeltaTime > 0.0f)
+			manualTime.AdvanceSeconds(settings.fixedDeltaTime);
+		clock.Tick();
+
+		float deltaTime = (float)clock.GetDeltaSeconds();
+		double totalTime = clock.GetTotalSeconds();
+
+		// Same update/draw pattern as DXCore::RunFrame(), with
+		// the simulation steps timed on their own
+		float interpolationAlpha = 1.0f;
+		if (useFixedTimestep)
+		{
+			unsigned int steps = fixedTimestep.Advance(deltaTime);
+			for (unsigned int i = 0; i < steps; i++)
+			{
+				update(fixedTimestep.GetStepSeconds(), fixedTimestep.GetStepTime(i));
+			}
+			report.tickCount += steps;
+			interpolationAlpha = fixedTimestep.GetInterpolationAlpha();
+		}
+		else
+		{
+			update(deltaTime, totalTime);
+			report.tickCount++;
+		}
+
+		WallClock::time_point tickEnd = WallClock::now();
+		report.tickSeconds += std::chrono::duration<double>(tickEnd - frameStart).count();
+
+		if (draw)
+			draw(deltaTime, totalTime, interpolationAlpha);
+
+		// Record how long this frame actually took on the CPU
+		WallClock::time_point frameEnd = WallClock::now();
+		frameStats.AddFrame(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+		frame++;
+	}
+
+	report.frameCount = frame;
+	report.totalSeconds = std::chrono::duration<double>(WallClock::now() - startTime).count();
+	if (report.tickSeconds > 0.0)
+		report.ticksPerSecond = report.tickCount / report.tickSeconds;
+	report.frameStats = frameStats.GetSummary();
+	return report;
+}
+
+// --------------------------------------------------------
+// Stops the current run after the frame in progress, which
+// is how an update function ends an unlimited run
+// --------------------------------------------------------
+void HeadlessLoop::Quit()
+{
+	quitRequested = true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+
+#include "FixedTimestep.h"
+#include "FrameStats.h"
+#include "GameClock.h"
+
+// --------------------------------------------------------
+// Options for a single headless run of the game loop
+// --------------------------------------------------------
+struct HeadlessLoopSettings
+{
+	unsigned int frameCount = 0;	// How many frames to run (0 = until Quit() is called)
+	float fixedDeltaTime = 0.0f;	// Length of each frame (0 = use the time source)
+	TimeSource* timeSource = 0;		// Where frame time comes from (0 = real system time)
+
+	// Optional fixed-rate simulation, matching DXCore::EnableFixedTimestep()
+	double fixedTickRate = 0.0;			// Update() calls per second (0 = once per frame)
+	unsigned int maxCatchUpSteps = 8;	// Most Update() calls in a single frame
+
+	// Frame time stats
+	double budgetMs = 1000.0 / 60.0;	// Frames longer than this are hitches
+	unsigned int statsWindowSize = 0;	// Frames kept for percentiles (0 = frameCount, or 64k if unlimited)
+};
+
+// --------------------------------------------------------
+// Results of a headless run - all frame times are the
+// CPU time spent on a single frame, in milliseconds
+// --------------------------------------------------------
+struct HeadlessLoopReport
+{
+	unsigned int frameCount = 0;
+	double totalSeconds = 0.0;	// Wall clock time for the entire run
+	FrameStatsSummary frameStats;
+
+	// Simulation-only numbers, which exclude time spent drawing
+	unsigned long long tickCount = 0;
+	double tickSeconds = 0.0;		// CPU time spent inside Update()
+	double ticksPerSecond = 0.0;	// Simulation throughput
+};
+
+// --------------------------------------------------------
+// A frame loop with no window, no Direct3D device and no
+// OS-specific timing, so simulation cost can be measured
+// on any platform (including build machines with no GPU)
+// --------------------------------------------------------
+class HeadlessLoop
+{
+public:
+	HeadlessLoop(
+		std::function<void(float deltaTime, double totalTime)> update,
+		std::function<void(float deltaTime, double totalTime, float interpolationAlpha)> draw = nullptr);
+
+	HeadlessLoopReport Run(const HeadlessLoopSettings& settings);
+	void Quit();
+
+private:
+	std::function<void(float, double)> update;
+	std::function<void(float, double, float)> draw;
+	bool quitRequested;
+	FixedTimestep fixedTimestep;
+};
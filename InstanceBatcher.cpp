@@ -0,0 +1,136 @@
+#include "InstanceBatcher.h"
+#include "TransformKernels.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+// The matrix is the whole struct, so a batch of them can
+// be written directly by ComputeWorldViewProjection()
+static_assert(sizeof(InstanceData) == sizeof(XMFLOAT4X4), "InstanceData must be exactly one matrix");
+
+// --------------------------------------------------------
+// Constructor - Starts with nothing to draw
+// --------------------------------------------------------
+InstanceBatcher::InstanceBatcher()
+{
+}
+
+// --------------------------------------------------------
+// Pre-allocates space for a known number of entities so
+// batching doesn't allocate once it's warmed up
+// --------------------------------------------------------
+void InstanceBatcher::Reserve(unsigned int entityCount)
+{
+	items.reserve(entityCount);
+	gatheredWorlds.reserve(entityCount);
+	instances.reserve(entityCount);
+}
+
+// --------------------------------------------------------
+// Removes everything added so far - call once per frame
+// before adding that frame's entities
+// --------------------------------------------------------
+void InstanceBatcher::Clear()
+{
+	items.clear();
+	batches.clear();
+	gatheredWorlds.clear();
+	instances.clear();
+}
+
+// --------------------------------------------------------
+// Queues an entity to be drawn
+//
+// entity   - Index of the entity's world matrix
+// mesh     - Which mesh it draws
+// material - Which material it draws with (24 bits)
+// lod      - Which of the mesh's levels of detail (8 bits)
+// --------------------------------------------------------
+void InstanceBatcher::Add(unsigned int entity, unsigned int mesh, unsigned int material, unsigned int lod)
+{
+	Item item;
+	item.key = ((unsigned long long)mesh << 32) | ((lod & 0xFF) << 24) | (material & 0xFFFFFF);
+	item.entity = entity;
+	items.push_back(item);
+}
+
+// --------------------------------------------------------
+// Sorts everything added since Clear() into batches and
+// packs each instance's world-view-projection matrix
+//
+// worldMatrices  - World matrices, indexed by entity
+// viewProjection - The camera's combined view and projection
+// meshMatrices   - Optional matrices, indexed by mesh, applied
+//                  before each instance's world matrix (such
+//                  as one that decodes quantized positions)
+// --------------------------------------------------------
+void InstanceBatcher::Build(
+	const XMFLOAT4X4* worldMatrices,
+	const XMFLOAT4X4& viewProjection,
+	const XMFLOAT4X4* meshMatrices)
+{
+	batches.clear();
+
+	// Sorting by entity within each group keeps the
+	// output stable from frame to frame
+	std::sort(items.begin(), items.end(),
+		[](const Item& a, const Item& b)
+		{
+			return a.key != b.key ? a.key < b.key : a.entity < b.entity;
+		});
+
+	// Gather world matrices into group order, starting a
+	// new batch each time the key changes
+	unsigned int count = (unsigned int)items.size();
+	gatheredWorlds.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (i == 0 || items[i].key != items[i - 1].key)
+		{
+			InstanceBatch batch;
+			batch.mesh = (unsigned int)(items[i].key >> 32);
+			batch.lod = (unsigned int)(items[i].key >> 24) & 0xFF;
+			batch.material = (unsigned int)(items[i].key & 0xFFFFFF);
+			batch.firstInstance = i;
+			batch.instanceCount = 0;
+			batches.push_back(batch);
+		}
+
+		batches.back().instanceCount++;
+		gatheredWorlds[i] = worldMatrices[items[i].entity];
+	}
+
+	// Most meshes won't need their matrix, so those are skipped
+	if (meshMatrices)
+	{
+		for (size_t b = 0; b < batches.size(); b++)
+		{
+			XMMATRIX meshMatrix = XMLoadFloat4x4(&meshMatrices[batches[b].mesh]);
+			if (XMMatrixIsIdentity(meshMatrix))
+				continue;
+
+			for (unsigned int i = batches[b].firstInstance; i < batches[b].firstInstance + batches[b].instanceCount; i++)
+				XMStoreFloat4x4(&gatheredWorlds[i], XMMatrixMultiply(meshMatrix, XMLoadFloat4x4(&gatheredWorlds[i])));
+		}
+	}
+
+	// One batched multiply for every instance
+	instances.resize(count);
+	if (count > 0)
+	{
+		ComputeWorldViewProjection(
+			gatheredWorlds.data(),
+			viewProjection,
+			&instances[0].WorldViewProjection,
+			count);
+	}
+}
+
+// --------------------------------------------------------
+// Getters for the results of the last Build()
+// --------------------------------------------------------
+const std::vector<InstanceBatch>& InstanceBatcher::GetBatches() const { return batches; }
+const InstanceData* InstanceBatcher::GetInstanceData() const { return instances.data(); }
+unsigned int InstanceBatcher::GetInstanceCount() const { return (unsigned int)instances.size(); }
+unsigned int InstanceBatcher::GetInstanceEntity(unsigned int instance) const { return items[instance].entity; }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// --------------------------------------------------------
+// Per-instance data for the vertex shader's second input
+// slot - must match the INSTANCE_WVP elements in the input
+// layout and VertexShaderInput
+// --------------------------------------------------------
+struct InstanceData
+{
+	DirectX::XMFLOAT4X4 WorldViewProjection;	// Row-major, one row per float4
+};
+
+// --------------------------------------------------------
+// One instanced draw: every instance of a single mesh (at
+// a single level of detail) with a single material, stored
+// contiguously in the instance data starting at
+// firstInstance
+// --------------------------------------------------------
+struct InstanceBatch
+{
+	unsigned int mesh;
+	unsigned int lod;
+	unsigned int material;
+	unsigned int firstInstance;
+	unsigned int instanceCount;
+};
+
+// --------------------------------------------------------
+// Groups entities that share a mesh and material so each
+// group can be drawn with a single DrawIndexedInstanced(),
+// and packs their per-instance data in group order.
+//
+// Meshes and materials are just indices here, so this has
+// no Direct3D dependencies and can run headless.
+// --------------------------------------------------------
+class InstanceBatcher
+{
+public:
+	InstanceBatcher();
+
+	void Reserve(unsigned int entityCount);
+	void Clear();
+	void Add(unsigned int entity, unsigned int mesh, unsigned int material, unsigned int lod = 0);
+
+	void Build(
+		const DirectX::XMFLOAT4X4* worldMatrices,
+		const DirectX::XMFLOAT4X4& viewProjection,
+		const DirectX::XMFLOAT4X4* meshMatrices = 0);
+
+	const std::vector<InstanceBatch>& GetBatches() const;
+	const InstanceData* GetInstanceData() const;
+	unsigned int GetInstanceCount() const;
+	unsigned int GetInstanceEntity(unsigned int instance) const;
+
+private:
+	// One entry per Add(), sorted by (mesh, lod, material, entity) during Build()
+	struct Item
+	{
+		unsigned long long key;	// Mesh in the upper half, then 8 bits of lod and 24 of material
+		unsigned int entity;
+	};
+	std::vector<Item> items;
+
+	// Build() results, reused from frame to frame
+	std::vector<InstanceBatch> batches;
+	std::vector<DirectX::XMFLOAT4X4> gatheredWorlds;
+	std::vector<InstanceData> instances;
+};
@@ -0,0 +1,154 @@
+#include "JobSystem.h"
+
+// --------------------------------------------------------
+// One worker per core, minus one for the thread that
+// calls ParallelFor() (which does its share of the work)
+// --------------------------------------------------------
+unsigned int JobSystem::GetDefaultWorkerCount()
+{
+	unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 0;
+}
+
+// --------------------------------------------------------
+// Constructor - Starts the worker threads, which sleep
+// until there's work to do
+//
+// workerCount - Threads to create.  0 is allowed, in which
+//               case everything runs on the calling thread.
+// --------------------------------------------------------
+JobSystem::JobSystem(unsigned int workerCount)
+	:
+	jobGeneration(0),
+	busyWorkers(0),
+	quitting(false),
+	job(0),
+	jobCount(0),
+	jobChunkSize(1),
+	jobChunkCount(0),
+	nextChunk(0)
+{
+	workers.reserve(workerCount);
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+}
+
+// --------------------------------------------------------
+// Destructor - Wakes every worker up to quit, and waits
+// for them to do so
+// --------------------------------------------------------
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quitting = true;
+	}
+	jobReady.notify_all();
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+// --------------------------------------------------------
+// Number of threads that run jobs, including the caller
+// --------------------------------------------------------
+unsigned int JobSystem::GetThreadCount() const
+{
+	return (unsigned int)workers.size() + 1;
+}
+
+// --------------------------------------------------------
+// Runs job over [0, count) in chunks, spread across every
+// thread, and waits for all of them to finish
+//
+// count     - Size of the whole range
+// chunkSize - Items per chunk (the last may be smaller).
+//             Bigger chunks mean less overhead; smaller
+//             chunks balance uneven work better.
+// job       - Called once per chunk
+// --------------------------------------------------------
+void JobSystem::ParallelFor(unsigned int count, unsigned int chunkSize, const RangeJob& job)
+{
+	if (count == 0)
+		return;
+
+	if (chunkSize == 0)
+		chunkSize = 1;
+
+	unsigned int chunkCount = (count + chunkSize - 1) / chunkSize;
+
+	// Not worth waking anyone up for
+	if (workers.empty() || chunkCount == 1)
+	{
+		for (unsigned int begin = 0; begin < count; begin += chunkSize)
+			job(begin, count - begin < chunkSize ? count : begin + chunkSize, 0);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submitLock(submitMutex);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->job = &job;
+		jobCount = count;
+		jobChunkSize = chunkSize;
+		jobChunkCount = chunkCount;
+		nextChunk.store(0);
+		busyWorkers = (unsigned int)workers.size();
+		jobGeneration++;
+	}
+	jobReady.notify_all();
+
+	// Help out rather than just waiting
+	RunChunks(0);
+
+	// Every chunk has been taken, but some may still be running
+	std::unique_lock<std::mutex> lock(mutex);
+	jobFinished.wait(lock, [this]() { return busyWorkers == 0; });
+	this->job = 0;
+}
+
+// --------------------------------------------------------
+// Each worker sleeps until a new job shows up, helps with
+// it, and goes back to sleep
+// --------------------------------------------------------
+void JobSystem::WorkerLoop(unsigned int thread)
+{
+	unsigned long long lastGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobReady.wait(lock, [&]() { return quitting || jobGeneration != lastGeneration; });
+			if (quitting)
+				return;
+			lastGeneration = jobGeneration;
+		}
+
+		RunChunks(thread);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busyWorkers--;
+			if (busyWorkers == 0)
+				jobFinished.notify_one();
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Takes chunks of the current job until there are none left
+// --------------------------------------------------------
+void JobSystem::RunChunks(unsigned int thread)
+{
+	while (true)
+	{
+		unsigned int chunk = nextChunk.fetch_add(1);
+		if (chunk >= jobChunkCount)
+			return;
+
+		unsigned int begin = chunk * jobChunkSize;
+		unsigned int end = jobCount - begin < jobChunkSize ? jobCount : begin + jobChunkSize;
+		(*job)(begin, end, thread);
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A fixed pool of worker threads, created once and kept
+// around for the life of the program, for splitting large
+// loops across cores.
+//
+// ParallelFor() cuts a range into chunks, which the workers
+// (and the calling thread, so it isn't left idle) grab one
+// at a time until none are left.  It returns once every
+// chunk has finished.
+//
+// Only one ParallelFor() runs at a time, and jobs must not
+// call ParallelFor() themselves.
+// --------------------------------------------------------
+class JobSystem
+{
+public:
+	// begin/end - The chunk's range, [begin, end)
+	// thread    - 0 for the calling thread, 1+ for workers, so
+	//             jobs can index per-thread scratch data
+	typedef std::function<void(unsigned int begin, unsigned int end, unsigned int thread)> RangeJob;
+
+	static unsigned int GetDefaultWorkerCount();
+
+	JobSystem(unsigned int workerCount = GetDefaultWorkerCount());
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	unsigned int GetThreadCount() const;
+
+	void ParallelFor(unsigned int count, unsigned int chunkSize, const RangeJob& job);
+
+private:
+	std::vector<std::thread> workers;
+
+	// Wakes workers up when there's a new job (or it's time to quit)
+	std::mutex mutex;
+	std::condition_variable jobReady;
+	std::condition_variable jobFinished;
+	unsigned long long jobGeneration;
+	unsigned int busyWorkers;
+	bool quitting;
+
+	// The current job - chunks are handed out through nextChunk
+	const RangeJob* job;
+	unsigned int jobCount;
+	unsigned int jobChunkSize;
+	unsigned int jobChunkCount;
+	std::atomic<unsigned int> nextChunk;
+
+	// Keeps separate callers from overlapping
+	std::mutex submitMutex;
+
+	void WorkerLoop(unsigned int thread);
+	void RunChunks(unsigned int thread);
+};
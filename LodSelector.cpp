@@ -0,0 +1,162 @@
+#include "LodSelector.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+// Objects closer than this are treated as this close, so
+// the camera being inside one doesn't divide by zero
+static const float MinSelectDistance = 0.001f;
+
+// Objects per job system chunk
+static const unsigned int SelectChunkSize = 4096;
+
+// --------------------------------------------------------
+// Constructor - Defaults to a 1 pixel threshold with 25%
+// hysteresis, for a 720 pixel tall view with a 90 degree
+// field of view
+// --------------------------------------------------------
+LodSelector::LodSelector()
+	:
+	pixelsPerUnit(360.0f),
+	threshold(1.0f),
+	hysteresis(0.25f)
+{
+}
+
+// --------------------------------------------------------
+// Takes the scale from a perspective projection matrix
+//  - _22 is 1 / tan(fovY / 2), so half the viewport height
+//    times that is how many pixels one unit covers at a
+//    distance of one unit
+// --------------------------------------------------------
+void LodSelector::SetProjection(const XMFLOAT4X4& projection, float viewportHeight)
+{
+	pixelsPerUnit = projection._22 * viewportHeight * 0.5f;
+}
+
+void LodSelector::SetThreshold(float pixels, float hysteresis)
+{
+	threshold = pixels;
+	this->hysteresis = hysteresis;
+}
+
+// --------------------------------------------------------
+// Sets the levels a mesh has to choose from (only the
+// first MaxSelectableLods are used)
+// --------------------------------------------------------
+void LodSelector::SetMeshLods(unsigned int mesh, const MeshLod* lods, unsigned int lodCount)
+{
+	if (mesh >= meshErrors.size())
+	{
+		MeshErrors single = {};
+		single.lodCount = 1;
+		meshErrors.resize(mesh + 1, single);
+	}
+
+	MeshErrors& entry = meshErrors[mesh];
+	entry.lodCount = std::max(std::min(lodCount, MaxSelectableLods), 1u);
+	for (unsigned int i = 0; i < entry.lodCount; i++)
+		entry.errors[i] = i < lodCount ? lods[i].error : 0.0f;
+}
+
+// --------------------------------------------------------
+// Chooses a level for every object
+//
+// worldMatrices  - Each object's world matrix
+// meshes         - Each object's mesh
+// count          - Number of objects
+// cameraPosition - Where the camera is, in world space
+// lods           - Each object's level from last time on
+//                  the way in, and this time on the way out
+// jobs           - Optional, to split the work across threads
+// --------------------------------------------------------
+void LodSelector::Select(
+	const XMFLOAT4X4* worldMatrices,
+	const unsigned int* meshes,
+	unsigned int count,
+	const XMFLOAT3& cameraPosition,
+	unsigned char* lods,
+	JobSystem* jobs) const
+{
+	if (jobs && count > SelectChunkSize)
+	{
+		jobs->ParallelFor(count, SelectChunkSize,
+			[&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+			{
+				SelectRange(worldMatrices, meshes, begin, end, cameraPosition, lods);
+			});
+	}
+	else
+	{
+		SelectRange(worldMatrices, meshes, 0, count, cameraPosition, lods);
+	}
+}
+
+void LodSelector::SelectRange(
+	const XMFLOAT4X4* worldMatrices,
+	const unsigned int* meshes,
+	unsigned int begin,
+	unsigned int end,
+	const XMFLOAT3& cameraPosition,
+	unsigned char* lods) const
+{
+	float coarserThreshold = threshold * (1.0f - hysteresis);
+
+	for (unsigned int i = begin; i < end; i++)
+	{
+		unsigned int mesh = meshes[i];
+		if (mesh >= meshErrors.size() || meshErrors[mesh].lodCount <= 1)
+		{
+			lods[i] = 0;
+			continue;
+		}
+		const MeshErrors& entry = meshErrors[mesh];
+
+		// Largest scale along any axis, and distance from the camera
+		const XMFLOAT4X4& w = worldMatrices[i];
+		float scaleSq = std::max(
+			w._11 * w._11 + w._12 * w._12 + w._13 * w._13, std::max(
+			w._21 * w._21 + w._22 * w._22 + w._23 * w._23,
+			w._31 * w._31 + w._32 * w._32 + w._33 * w._33));
+
+		float dx = w._41 - cameraPosition.x;
+		float dy = w._42 - cameraPosition.y;
+		float dz = w._43 - cameraPosition.z;
+		float distance = std::max(sqrtf(dx * dx + dy * dy + dz * dz), MinSelectDistance);
+
+		// Mesh units to pixels, for this object
+		float projection = sqrtf(scaleSq) * pixelsPerUnit / distance;
+
+		// Coarsest level that's fine as it is...
+		unsigned int current = std::min((unsigned int)lods[i], entry.lodCount - 1);
+		unsigned int desired = 0;
+		for (unsigned int l = entry.lodCount - 1; l > 0; l--)
+		{
+			if (entry.errors[l] * projection <= threshold)
+			{
+				desired = l;
+				break;
+			}
+		}
+
+		// ...but only go coarser once it's comfortably fine
+		if (desired > current)
+		{
+			unsigned int coarser = current;
+			for (unsigned int l = desired; l > current; l--)
+			{
+				if (entry.errors[l] * projection <= coarserThreshold)
+				{
+					coarser = l;
+					break;
+				}
+			}
+			desired = coarser;
+		}
+
+		lods[i] = (unsigned char)desired;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "MeshSimplifier.h"
+
+class JobSystem;
+
+// --------------------------------------------------------
+// Picks each object's level of detail from how big its
+// error would look on screen: the level's error (in mesh
+// units) times the object's largest scale, projected from
+// its origin's distance to the camera.  The coarsest level
+// whose error is under the threshold (in pixels) wins.
+//
+// That's an estimate rather than a bound - parts of an
+// object nearer the camera than its origin can show a
+// little more error, so the threshold wants to leave room
+// for that with big objects up close.
+//
+// To stop objects near a switching distance from popping
+// back and forth, moving to a coarser level needs the error
+// to be under the threshold by the hysteresis fraction as
+// well, while moving to a finer level happens right away.
+// Each object's previous level is passed back in for this.
+//
+// Meshes are just indices here, so this has no Direct3D
+// dependencies and can run headless.
+// --------------------------------------------------------
+static const unsigned int MaxSelectableLods = 8;
+
+class LodSelector
+{
+public:
+	LodSelector();
+
+	void SetProjection(const DirectX::XMFLOAT4X4& projection, float viewportHeight);
+	void SetThreshold(float pixels, float hysteresis);
+	void SetMeshLods(unsigned int mesh, const MeshLod* lods, unsigned int lodCount);
+
+	void Select(
+		const DirectX::XMFLOAT4X4* worldMatrices,
+		const unsigned int* meshes,
+		unsigned int count,
+		const DirectX::XMFLOAT3& cameraPosition,
+		unsigned char* lods,
+		JobSystem* jobs = 0) const;
+
+private:
+	struct MeshErrors
+	{
+		float errors[MaxSelectableLods];	// Finest first
+		unsigned int lodCount;
+	};
+	std::vector<MeshErrors> meshErrors;
+
+	float pixelsPerUnit;	// Pixels covered by one unit, one unit from the camera
+	float threshold;		// In pixels
+	float hysteresis;		// Fraction of the threshold
+
+	void SelectRange(
+		const DirectX::XMFLOAT4X4* worldMatrices,
+		const unsigned int* meshes,
+		unsigned int begin,
+		unsigned int end,
+		const DirectX::XMFLOAT3& cameraPosition,
+		unsigned char* lods) const;
+};
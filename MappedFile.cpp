@@ -0,0 +1,137 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// --------------------------------------------------------
+// Constructor - Starts with nothing mapped
+// --------------------------------------------------------
+MappedFile::MappedFile()
+	:
+	data(0),
+	size(0),
+	fileHandle(0),
+	mappingHandle(0),
+	fileDescriptor(-1)
+{
+}
+
+// --------------------------------------------------------
+// Destructor - Unmaps the file, if there is one
+// --------------------------------------------------------
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+// --------------------------------------------------------
+// Maps an entire file, closing whatever was open before.
+// Returns false if the file doesn't exist, is empty or
+// can't be mapped.
+// --------------------------------------------------------
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		0,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	data = view;
+	size = (size_t)fileSize.QuadPart;
+#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* view = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	fileDescriptor = fd;
+	data = view;
+	size = (size_t)info.st_size;
+#endif
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Unmaps the file - any pointers into it become invalid
+// --------------------------------------------------------
+void MappedFile::Close()
+{
+	if (!data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE)mappingHandle);
+	CloseHandle((HANDLE)fileHandle);
+#else
+	munmap((void*)data, size);
+	close(fileDescriptor);
+#endif
+
+	data = 0;
+	size = 0;
+	fileHandle = 0;
+	mappingHandle = 0;
+	fileDescriptor = -1;
+}
+
+// --------------------------------------------------------
+// Getters for the mapped data
+// --------------------------------------------------------
+bool MappedFile::IsOpen() const { return data != 0; }
+const void* MappedFile::GetData() const { return data; }
+size_t MappedFile::GetSize() const { return size; }
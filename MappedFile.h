@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// --------------------------------------------------------
+// A read-only view of a whole file, mapped into memory by
+// the OS rather than read into a buffer.  Pages are loaded
+// on first touch and shared with the OS file cache, so
+// opening is nearly free regardless of the file's size.
+//
+// The data stays valid until Close() or destruction.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const;
+	const void* GetData() const;
+	size_t GetSize() const;
+
+private:
+	const void* data;
+	size_t size;
+
+	// OS handles - void* so this header needs no OS includes
+	void* fileHandle;
+	void* mappingHandle;
+	int fileDescriptor;
+};
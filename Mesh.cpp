@@ -0,0 +1,399 @@
+#include "Mesh.h"
+
+// --------------------------------------------------------
+// The box around a set of positions, either on its own or
+// grown to also hold what's already in it (empty sets get
+// an empty box at the origin)
+// --------------------------------------------------------
+static void ComputeBounds(
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	DirectX::XMFLOAT3& boundsMin,
+	DirectX::XMFLOAT3& boundsMax,
+	bool grow)
+{
+	if (!grow)
+	{
+		boundsMin = vertexCount > 0 ? vertices[0].Position : DirectX::XMFLOAT3(0, 0, 0);
+		boundsMax = boundsMin;
+	}
+
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const DirectX::XMFLOAT3& p = vertices[i].Position;
+		if (p.x < boundsMin.x) boundsMin.x = p.x;
+		if (p.y < boundsMin.y) boundsMin.y = p.y;
+		if (p.z < boundsMin.z) boundsMin.z = p.z;
+		if (p.x > boundsMax.x) boundsMax.x = p.x;
+		if (p.y > boundsMax.y) boundsMax.y = p.y;
+		if (p.z > boundsMax.z) boundsMax.z = p.z;
+	}
+}
+
+// --------------------------------------------------------
+// Constructor - Copies the given vertices and indices into
+// new (immutable) GPU buffers
+//
+// vertices    - Array of vertex data
+// vertexCount - Number of vertices in that array
+// indices     - Array of indices into the vertex array
+// indexCount  - Number of indices in that array
+// device      - Used to create the buffers
+// --------------------------------------------------------
+Mesh::Mesh(
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	Microsoft::WRL::ComPtr<ID3D11Device> device)
+	:
+	vertexCount(vertexCount),
+	indexCount(indexCount),
+	indexFormat(DXGI_FORMAT_R32_UINT),
+	vertexFormat(VertexFormatFull),
+	culledIndexCount(0),
+	drawCulled(false)
+{
+	ComputeBounds(vertices, vertexCount, boundsMin, boundsMax, false);
+	CreateBuffers(vertices, indices, sizeof(unsigned int), device);
+}
+
+// --------------------------------------------------------
+// Constructor - Same as above, but with 16-bit indices,
+// which halve the index buffer's size for meshes with no
+// more than 65536 vertices
+// --------------------------------------------------------
+Mesh::Mesh(
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const unsigned short* indices,
+	unsigned int indexCount,
+	Microsoft::WRL::ComPtr<ID3D11Device> device)
+	:
+	vertexCount(vertexCount),
+	indexCount(indexCount),
+	indexFormat(DXGI_FORMAT_R16_UINT),
+	vertexFormat(VertexFormatFull),
+	culledIndexCount(0),
+	drawCulled(false)
+{
+	ComputeBounds(vertices, vertexCount, boundsMin, boundsMax, false);
+	CreateBuffers(vertices, indices, sizeof(unsigned short), device);
+}
+
+// --------------------------------------------------------
+// Constructor - Takes vertices already encoded in one of
+// the vertex formats (see VertexFormat.h)
+//
+// vertices     - Encoded vertex data
+// vertexFormat - The format the vertices are in
+// quantization - How to decode their positions
+// vertexCount  - Number of vertices
+// indices      - Array of 16 or 32-bit indices
+// indexFormat  - DXGI_FORMAT_R16_UINT or DXGI_FORMAT_R32_UINT
+// indexCount   - Number of indices
+// device       - Used to create the buffers
+// --------------------------------------------------------
+Mesh::Mesh(
+	const void* vertices,
+	VertexFormatId vertexFormat,
+	const VertexQuantization& quantization,
+	unsigned int vertexCount,
+	const void* indices,
+	DXGI_FORMAT indexFormat,
+	unsigned int indexCount,
+	Microsoft::WRL::ComPtr<ID3D11Device> device)
+	:
+	vertexCount(vertexCount),
+	indexCount(indexCount),
+	indexFormat(indexFormat),
+	vertexFormat(vertexFormat),
+	quantization(quantization),
+	culledIndexCount(0),
+	drawCulled(false)
+{
+	// Bounds come from the decoded positions, a block at a time
+	const VertexFormat& format = GetVertexFormat(vertexFormat);
+	std::vector<Vertex> decoded(vertexCount < 1024 ? vertexCount : 1024);
+	ComputeBounds(0, 0, boundsMin, boundsMax, false);
+	for (unsigned int first = 0; first < vertexCount; first += (unsigned int)decoded.size())
+	{
+		unsigned int blockCount = vertexCount - first < decoded.size() ? vertexCount - first : (unsigned int)decoded.size();
+		DecodeVertices(format, quantization, (const unsigned char*)vertices + (size_t)first * format.stride, blockCount, decoded.data());
+		ComputeBounds(decoded.data(), blockCount, boundsMin, boundsMax, first > 0);
+	}
+
+	CreateBuffers(vertices, indices, indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(unsigned int), device);
+}
+
+// --------------------------------------------------------
+// Destructor - Nothing to do, as the buffers are ComPtrs
+// --------------------------------------------------------
+Mesh::~Mesh()
+{
+}
+
+// --------------------------------------------------------
+// Getters for the buffers and their sizes
+// --------------------------------------------------------
+Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer() { return vertexBuffer; }
+Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer() { return indexBuffer; }
+unsigned int Mesh::GetVertexCount() { return vertexCount; }
+unsigned int Mesh::GetIndexCount() { return indexCount; }
+DXGI_FORMAT Mesh::GetIndexFormat() { return indexFormat; }
+VertexFormatId Mesh::GetVertexFormatId() { return vertexFormat; }
+const VertexQuantization& Mesh::GetQuantization() { return quantization; }
+const DirectX::XMFLOAT3& Mesh::GetBoundsMin() { return boundsMin; }
+const DirectX::XMFLOAT3& Mesh::GetBoundsMax() { return boundsMax; }
+const MeshLod* Mesh::GetLods() { return lods.data(); }
+unsigned int Mesh::GetLodCount() { return (unsigned int)lods.size(); }
+unsigned int Mesh::GetMeshletCount() { return (unsigned int)meshlets.size(); }
+
+// --------------------------------------------------------
+// Replaces the bounds worked out from the vertices, say
+// with ones saved alongside them
+// --------------------------------------------------------
+void Mesh::SetBounds(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax)
+{
+	this->boundsMin = boundsMin;
+	this->boundsMax = boundsMax;
+}
+
+// --------------------------------------------------------
+// Replaces the levels of detail, which must all be inside
+// the index buffer (ranges that aren't are left out)
+// --------------------------------------------------------
+void Mesh::SetLods(const MeshLod* lods, unsigned int lodCount)
+{
+	this->lods.clear();
+	for (unsigned int i = 0; i < lodCount; i++)
+	{
+		if (lods[i].firstIndex <= indexCount && lods[i].indexCount <= indexCount - lods[i].firstIndex)
+			this->lods.push_back(lods[i]);
+	}
+
+	// Always at least the whole mesh
+	if (this->lods.empty())
+	{
+		MeshLod whole = { 0, indexCount, 0.0f };
+		this->lods.push_back(whole);
+	}
+}
+
+// --------------------------------------------------------
+// Gives this mesh meshlets, so it can be culled per cluster
+// (see CullMeshlets()).  Keeps a copy of the indices they
+// cover, and makes a dynamic index buffer for the culled
+// results.  Meshlets outside the index buffer are dropped.
+//
+// meshlets     - The meshlets, from BuildMeshlets()
+// meshletCount - Number of meshlets
+// indices      - The same index data the mesh was made from
+// device       - Used to create the culled index buffer
+// --------------------------------------------------------
+void Mesh::SetMeshlets(
+	const Meshlet* meshlets,
+	unsigned int meshletCount,
+	const void* indices,
+	Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	this->meshlets.clear();
+	meshletIndices.clear();
+	culledIndexBuffer.Reset();
+	culledIndexCount = 0;
+	drawCulled = false;
+
+	unsigned int coveredCount = 0;
+	for (unsigned int i = 0; i < meshletCount; i++)
+	{
+		if (meshlets[i].firstIndex > indexCount || meshlets[i].triangleCount > (indexCount - meshlets[i].firstIndex) / 3)
+			continue;
+
+		this->meshlets.push_back(meshlets[i]);
+
+		unsigned int end = meshlets[i].firstIndex + meshlets[i].triangleCount * 3;
+		if (end > coveredCount)
+			coveredCount = end;
+	}
+
+	if (this->meshlets.empty())
+		return;
+
+	unsigned int indexSize = indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(unsigned int);
+	const unsigned char* first = (const unsigned char*)indices;
+	meshletIndices.assign(first, first + (size_t)coveredCount * indexSize);
+
+	// Big enough for every meshlet at once
+	D3D11_BUFFER_DESC ibd	= {};
+	ibd.Usage				= D3D11_USAGE_DYNAMIC;		// Rewritten whenever culled
+	ibd.ByteWidth			= indexSize * coveredCount;
+	ibd.BindFlags			= D3D11_BIND_INDEX_BUFFER;
+	ibd.CPUAccessFlags		= D3D11_CPU_ACCESS_WRITE;	// So we can Map() it
+	ibd.MiscFlags			= 0;
+	ibd.StructureByteStride = 0;
+	device->CreateBuffer(&ibd, 0, culledIndexBuffer.GetAddressOf());
+}
+
+// --------------------------------------------------------
+// Culls this mesh's meshlets for one instance of it, and
+// switches its draws over to the indices that are left
+//  - Only makes sense when a single instance is drawn, at
+//    the finest level of detail
+//
+// context        - Used to fill the culled index buffer
+// world          - The instance's world matrix
+// viewProjection - The camera's view * projection
+// cameraPosition - World space, or null for no back-face culling
+// stats          - Optional, for what was culled
+// --------------------------------------------------------
+void Mesh::CullMeshlets(
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	const DirectX::XMFLOAT4X4& world,
+	const DirectX::XMFLOAT4X4& viewProjection,
+	const DirectX::XMFLOAT3* cameraPosition,
+	MeshletCullStats* stats)
+{
+	if (meshlets.empty())
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	if (FAILED(context->Map(culledIndexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+
+	culledIndexCount = ::CullMeshlets(
+		meshlets.data(), (unsigned int)meshlets.size(),
+		meshletIndices.data(), indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(unsigned int),
+		world, viewProjection, cameraPosition,
+		mapped.pData, stats);
+
+	context->Unmap(culledIndexBuffer.Get(), 0);
+	drawCulled = true;
+}
+
+// --------------------------------------------------------
+// Goes back to drawing from the full index buffer
+// --------------------------------------------------------
+void Mesh::ClearMeshletCulling()
+{
+	drawCulled = false;
+}
+
+// --------------------------------------------------------
+// Binds this mesh's vertex buffer (slot 0) and index buffer
+//  - The culled index buffer instead, after CullMeshlets()
+// --------------------------------------------------------
+void Mesh::SetBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	// Set buffers in the input assembler (IA) stage
+	//  - This needs to happen between EACH DrawIndexed() call
+	//     when drawing different geometry
+	UINT stride = GetVertexFormat(vertexFormat).stride;
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+	context->IASetIndexBuffer(drawCulled ? culledIndexBuffer.Get() : indexBuffer.Get(), indexFormat, 0);
+}
+
+// --------------------------------------------------------
+// Sets this mesh's buffers and draws it, using whatever
+// shaders and other state are currently bound
+// --------------------------------------------------------
+void Mesh::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	SetBuffers(context);
+
+	// Tell Direct3D to draw
+	//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
+	//     vertices in the currently set VERTEX BUFFER
+	//  - Only the finest level of detail (or what's left of it after culling)
+	context->DrawIndexed(
+		drawCulled ? culledIndexCount : lods[0].indexCount,	// The number of indices to use
+		drawCulled ? 0 : lods[0].firstIndex,				// Offset to the first index we want to use
+		0);													// Offset to add to each index when looking up vertices
+}
+
+// --------------------------------------------------------
+// Draws several instances of this mesh in one call.  This
+// mesh's buffers must already be bound (see SetBuffers()),
+// and per-instance data comes from whatever buffer is bound
+// to input slot 1.
+//
+// instanceCount - How many instances to draw
+// firstInstance - Offset of the first instance's data in
+//                 the instance buffer (in instances)
+// lod           - Which level of detail to draw (clamped
+//                 to the coarsest one, and ignored while
+//                 drawing culled meshlets)
+// --------------------------------------------------------
+void Mesh::DrawInstanced(
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	unsigned int instanceCount,
+	unsigned int firstInstance,
+	unsigned int lod)
+{
+	MeshLod range = lods[lod < lods.size() ? lod : lods.size() - 1];
+	if (drawCulled)
+	{
+		range.firstIndex = 0;
+		range.indexCount = culledIndexCount;
+	}
+
+	context->DrawIndexedInstanced(
+		range.indexCount,	// The number of indices per instance
+		instanceCount,		// The number of instances
+		range.firstIndex,	// Offset to the first index we want to use
+		0,					// Offset to add to each index when looking up vertices
+		firstInstance);		// Offset to add when looking up per-instance data
+}
+
+// --------------------------------------------------------
+// Copies vertices and indices into new (immutable) buffers
+//
+// indexSize - Bytes per index (2 or 4)
+// --------------------------------------------------------
+void Mesh::CreateBuffers(
+	const void* vertices,
+	const void* indices,
+	unsigned int indexSize,
+	Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	// Create a VERTEX BUFFER
+	// - This holds the vertex data of triangles for a single object
+	// - This buffer is created on the GPU, which is where the data needs to
+	//    be if we want the GPU to act on it (as in: draw it to the screen)
+	{
+		D3D11_BUFFER_DESC vbd	= {};
+		vbd.Usage				= D3D11_USAGE_IMMUTABLE;	// Will NEVER change
+		vbd.ByteWidth			= GetVertexFormat(vertexFormat).stride * vertexCount;
+		vbd.BindFlags			= D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
+		vbd.CPUAccessFlags		= 0;	// Note: We cannot access the data from C++ (this is good)
+		vbd.MiscFlags			= 0;
+		vbd.StructureByteStride = 0;
+
+		// The initial data is copied to the GPU when the buffer is created
+		D3D11_SUBRESOURCE_DATA initialVertexData = {};
+		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
+
+		device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
+	}
+
+	// Create an INDEX BUFFER
+	// - This holds indices to elements in the vertex buffer
+	// - This is most useful when vertices are shared among neighboring triangles
+	{
+		D3D11_BUFFER_DESC ibd	= {};
+		ibd.Usage				= D3D11_USAGE_IMMUTABLE;	// Will NEVER change
+		ibd.ByteWidth			= indexSize * indexCount;
+		ibd.BindFlags			= D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
+		ibd.CPUAccessFlags		= 0;	// Note: We cannot access the data from C++ (this is good)
+		ibd.MiscFlags			= 0;
+		ibd.StructureByteStride = 0;
+
+		D3D11_SUBRESOURCE_DATA initialIndexData = {};
+		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
+
+		device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+	}
+
+	// Just the one level of detail to start with
+	SetLods(0, 0);
+}
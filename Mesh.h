@@ -0,0 +1,115 @@
+#pragma once
+
+#include <d3d11.h>
+#include <vector>
+#include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "Vertex.h"
+#include "VertexFormat.h"
+
+// --------------------------------------------------------
+// A single piece of geometry: a vertex buffer, an index
+// buffer and the number of indices to draw
+//
+// The index buffer may hold several levels of detail, each
+// a range of it, all using the same vertices.  Until told
+// otherwise (SetLods()), there's one level using the whole
+// index buffer.
+//
+// Meshes with meshlets (SetMeshlets()) can also be culled
+// cluster by cluster on the CPU, after which they draw from
+// a compacted copy of the surviving indices.
+//
+// Every mesh also keeps the box around its positions (in
+// mesh space, before any quantization), for culling.
+// --------------------------------------------------------
+class Mesh
+{
+public:
+	Mesh(
+		const Vertex* vertices,
+		unsigned int vertexCount,
+		const unsigned int* indices,
+		unsigned int indexCount,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
+	Mesh(
+		const Vertex* vertices,
+		unsigned int vertexCount,
+		const unsigned short* indices,
+		unsigned int indexCount,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
+	Mesh(
+		const void* vertices,
+		VertexFormatId vertexFormat,
+		const VertexQuantization& quantization,
+		unsigned int vertexCount,
+		const void* indices,
+		DXGI_FORMAT indexFormat,
+		unsigned int indexCount,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
+	~Mesh();
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
+	unsigned int GetVertexCount();
+	unsigned int GetIndexCount();
+	DXGI_FORMAT GetIndexFormat();
+	VertexFormatId GetVertexFormatId();
+	const VertexQuantization& GetQuantization();
+	const DirectX::XMFLOAT3& GetBoundsMin();
+	const DirectX::XMFLOAT3& GetBoundsMax();
+	void SetBounds(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+
+	void SetLods(const MeshLod* lods, unsigned int lodCount);
+	const MeshLod* GetLods();
+	unsigned int GetLodCount();
+
+	void SetMeshlets(
+		const Meshlet* meshlets,
+		unsigned int meshletCount,
+		const void* indices,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
+	unsigned int GetMeshletCount();
+	void CullMeshlets(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		const DirectX::XMFLOAT4X4& world,
+		const DirectX::XMFLOAT4X4& viewProjection,
+		const DirectX::XMFLOAT3* cameraPosition,
+		MeshletCullStats* stats = 0);
+	void ClearMeshletCulling();
+
+	void SetBuffers(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+	void DrawInstanced(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		unsigned int instanceCount,
+		unsigned int firstInstance,
+		unsigned int lod = 0);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	DXGI_FORMAT indexFormat;	// 16 or 32-bit indices
+	VertexFormatId vertexFormat;
+	VertexQuantization quantization;	// How to decode positions, for quantized formats
+	std::vector<MeshLod> lods;			// Finest first
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+
+	// Per-meshlet culling
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned char> meshletIndices;	// CPU copy of the indices meshlets use
+	Microsoft::WRL::ComPtr<ID3D11Buffer> culledIndexBuffer;
+	unsigned int culledIndexCount;
+	bool drawCulled;
+
+	void CreateBuffers(
+		const void* vertices,
+		const void* indices,
+		unsigned int indexSize,
+		Microsoft::WRL::ComPtr<ID3D11Device> device);
+};
@@ -0,0 +1,530 @@
+#include "MeshOptimizer.h"
+#include "ObjImporter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+// Forsyth's scoring model - a cache this big is assumed
+// while ordering, which suits any real cache up to this size
+static const unsigned int ScoringCacheSize = 32;
+static const unsigned int MaxScoredValence = 32;
+
+static const float CacheDecayPower = 1.5f;
+static const float LastTriangleScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+
+typedef std::chrono::steady_clock OptimizeClock;
+
+// --------------------------------------------------------
+// Precomputed vertex scores, by cache position and by the
+// number of triangles still left to draw using the vertex
+// --------------------------------------------------------
+struct VertexScoreTable
+{
+	float cache[ScoringCacheSize];
+	float valence[MaxScoredValence];
+
+	VertexScoreTable()
+	{
+		for (unsigned int i = 0; i < ScoringCacheSize; i++)
+		{
+			// The last triangle's vertices score the same, no matter
+			// their order, so the next triangle needn't share an edge
+			if (i < 3)
+				cache[i] = LastTriangleScore;
+			else
+				cache[i] = powf(1.0f - (i - 3) / (float)(ScoringCacheSize - 3), CacheDecayPower);
+		}
+
+		// Vertices with few triangles left get a boost, so they're
+		// finished off instead of being left as lone stragglers
+		valence[0] = 0.0f;
+		for (unsigned int i = 1; i < MaxScoredValence; i++)
+			valence[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+	}
+
+	float Score(int cachePosition, unsigned int remaining) const
+	{
+		if (remaining == 0)
+			return -1.0f;
+
+		float score = cachePosition < 0 ? 0.0f : cache[cachePosition];
+		return score + valence[std::min(remaining, MaxScoredValence - 1)];
+	}
+};
+
+// --------------------------------------------------------
+// Simulates a FIFO cache of the given size
+//  - Returns the number of cache misses (transformed
+//    vertices) from one triangle's indices
+//  - Timestamps start at zero, and "time" must start at
+//    more than cacheSize, so every vertex starts uncached
+// --------------------------------------------------------
+static unsigned int SimulateTriangle(
+	const unsigned int* triangle,
+	std::vector<unsigned int>& timestamps,
+	unsigned int& time,
+	unsigned int cacheSize)
+{
+	unsigned int misses = 0;
+	for (unsigned int c = 0; c < 3; c++)
+	{
+		unsigned int v = triangle[c];
+		if (time - timestamps[v] > cacheSize)
+		{
+			timestamps[v] = time++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+// --------------------------------------------------------
+// Measures ACMR and ATVR for a given cache size
+// --------------------------------------------------------
+VertexCacheStats AnalyzeVertexCache(
+	const unsigned int* indices,
+	unsigned int indexCount,
+	unsigned int vertexCount,
+	unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return stats;
+
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+	for (unsigned int t = 0; t < triangleCount; t++)
+		stats.transformedCount += SimulateTriangle(&indices[t * 3], timestamps, time, cacheSize);
+
+	unsigned int referencedCount = 0;
+	for (unsigned int v = 0; v < vertexCount; v++)
+		referencedCount += timestamps[v] != 0;
+
+	stats.acmr = stats.transformedCount / (float)triangleCount;
+	stats.atvr = stats.transformedCount / (float)referencedCount;
+	return stats;
+}
+
+// --------------------------------------------------------
+// Reorders triangles for the post-transform vertex cache
+//
+// Greedy: each step draws the best scoring triangle, where
+// a triangle's score is the sum of its vertices' scores.
+// Only triangles using vertices in the (simulated) cache
+// are rescored each step, so this runs in linear time.
+// --------------------------------------------------------
+void OptimizeVertexCache(
+	unsigned int* destination,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	unsigned int vertexCount)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	static const VertexScoreTable scores;
+
+	// Triangles using each vertex, as ranges of one big list
+	//  - remaining[v] shrinks as triangles are drawn, which
+	//    keeps only undrawn triangles at the front of a range
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		remaining[indices[i]]++;
+
+	std::vector<unsigned int> firstTriangle(vertexCount, 0);
+	unsigned int total = 0;
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		firstTriangle[v] = total;
+		total += remaining[v];
+	}
+
+	std::vector<unsigned int> vertexTriangles(triangleCount * 3);
+	std::vector<unsigned int> fill(firstTriangle);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		vertexTriangles[fill[indices[i]]++] = i / 3;
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		vertexScore[v] = scores.Score(-1, remaining[v]);
+
+	std::vector<float> triangleScore(triangleCount);
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		const unsigned int* tri = &indices[t * 3];
+		triangleScore[t] = vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+	}
+
+	// The input may be the output, so work from a copy
+	std::vector<unsigned int> source;
+	if (destination == indices)
+	{
+		source.assign(indices, indices + triangleCount * 3);
+		indices = source.data();
+	}
+
+	std::vector<unsigned char> drawn(triangleCount, 0);
+
+	// Room for the whole cache plus the three newest vertices
+	unsigned int cache[ScoringCacheSize + 3];
+	unsigned int newCache[ScoringCacheSize + 3];
+	unsigned int cacheCount = 0;
+
+	// Start with the best triangle overall
+	int best = (int)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+	unsigned int scanCursor = 0;
+
+	for (unsigned int output = 0; output < triangleCount; output++)
+	{
+		// Nothing left touching the cache - take the next
+		// undrawn triangle in the original order
+		if (best < 0)
+		{
+			while (drawn[scanCursor])
+				scanCursor++;
+			best = (int)scanCursor;
+		}
+
+		const unsigned int* tri = &indices[best * 3];
+		destination[output * 3 + 0] = tri[0];
+		destination[output * 3 + 1] = tri[1];
+		destination[output * 3 + 2] = tri[2];
+		drawn[best] = 1;
+
+		// Remove it from each of its vertices' ranges
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			unsigned int v = tri[c];
+			unsigned int* list = &vertexTriangles[firstTriangle[v]];
+			for (unsigned int i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == (unsigned int)best)
+				{
+					list[i] = list[remaining[v] - 1];
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// The new triangle's vertices go to the front of the cache
+		unsigned int newCount = 0;
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			unsigned int v = tri[c];
+			if (std::find(newCache, newCache + newCount, v) == newCache + newCount)
+				newCache[newCount++] = v;
+		}
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore everything that moved, including whatever fell out
+		for (unsigned int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			cachePosition[v] = i < ScoringCacheSize ? (int)i : -1;
+			vertexScore[v] = scores.Score(cachePosition[v], remaining[v]);
+		}
+
+		// Rescore their triangles, and find the best one for next time
+		best = -1;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			const unsigned int* list = &vertexTriangles[firstTriangle[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				unsigned int t = list[j];
+				const unsigned int* other = &indices[t * 3];
+				float score = vertexScore[other[0]] + vertexScore[other[1]] + vertexScore[other[2]];
+				triangleScore[t] = score;
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					best = (int)t;
+				}
+			}
+		}
+
+		cacheCount = std::min(newCount, ScoringCacheSize);
+		std::copy(newCache, newCache + cacheCount, cache);
+	}
+}
+
+// --------------------------------------------------------
+// A run of triangles that can be moved as one piece
+// --------------------------------------------------------
+struct TriangleCluster
+{
+	unsigned int firstTriangle;
+	unsigned int triangleCount;
+	float sortKey;
+};
+
+// --------------------------------------------------------
+// Reorders clusters of triangles to reduce overdraw
+// (Sander, Nehab and Barczak, "Fast Triangle Reordering
+// for Vertex Locality and Reduced Overdraw")
+//
+// The cache-optimized order is cut wherever the cache
+// starts over anyway, then cut further where a piece's ACMR
+// is within "threshold" of what it was uncut.  Clusters
+// facing away from the mesh's center are likely to cover
+// the rest, so they're drawn first.
+// --------------------------------------------------------
+void OptimizeOverdraw(
+	unsigned int* destination,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	float threshold,
+	unsigned int cacheSize)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	std::vector<unsigned int> source(indices, indices + triangleCount * 3);
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+
+	// Hard boundaries - where every vertex of a triangle misses,
+	// so nothing is lost by starting a cluster there
+	std::vector<unsigned int> hardStarts;
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		if (SimulateTriangle(&source[t * 3], timestamps, time, cacheSize) == 3)
+			hardStarts.push_back(t);
+	}
+	hardStarts.push_back(triangleCount);
+
+	// Soft boundaries - split each hard cluster into pieces
+	// that, starting from an empty cache, stay under the
+	// cluster's ACMR times the threshold
+	std::vector<TriangleCluster> clusters;
+	for (size_t h = 0; h + 1 < hardStarts.size(); h++)
+	{
+		unsigned int start = hardStarts[h];
+		unsigned int end = hardStarts[h + 1];
+
+		time += cacheSize + 1;
+		unsigned int clusterMisses = 0;
+		for (unsigned int t = start; t < end; t++)
+			clusterMisses += SimulateTriangle(&source[t * 3], timestamps, time, cacheSize);
+
+		float clusterThreshold = threshold * clusterMisses / (float)(end - start);
+
+		time += cacheSize + 1;
+		unsigned int pieceStart = start;
+		unsigned int pieceMisses = 0;
+		for (unsigned int t = start; t < end; t++)
+		{
+			pieceMisses += SimulateTriangle(&source[t * 3], timestamps, time, cacheSize);
+
+			unsigned int pieceCount = t + 1 - pieceStart;
+			if (t + 1 < end && pieceMisses <= clusterThreshold * pieceCount)
+			{
+				TriangleCluster cluster = { pieceStart, pieceCount, 0.0f };
+				clusters.push_back(cluster);
+
+				pieceStart = t + 1;
+				pieceMisses = 0;
+				time += cacheSize + 1;
+			}
+		}
+
+		TriangleCluster cluster = { pieceStart, end - pieceStart, 0.0f };
+		clusters.push_back(cluster);
+	}
+
+	// Area weighted centroid of the whole mesh, then of each
+	// cluster along with its average normal
+	float meshCenter[3] = { 0, 0, 0 };
+	float meshArea = 0.0f;
+	std::vector<float> clusterData(clusters.size() * 6, 0.0f);
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		float* center = &clusterData[c * 6];
+		float* normal = &clusterData[c * 6 + 3];
+		float clusterArea = 0.0f;
+
+		for (unsigned int t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; t++)
+		{
+			const XMFLOAT3& p0 = vertices[source[t * 3 + 0]].Position;
+			const XMFLOAT3& p1 = vertices[source[t * 3 + 1]].Position;
+			const XMFLOAT3& p2 = vertices[source[t * 3 + 2]].Position;
+
+			float e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			float e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			float n[3] =
+			{
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0]
+			};
+			float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+			center[0] += (p0.x + p1.x + p2.x) / 3.0f * area;
+			center[1] += (p0.y + p1.y + p2.y) / 3.0f * area;
+			center[2] += (p0.z + p1.z + p2.z) / 3.0f * area;
+			normal[0] += n[0];
+			normal[1] += n[1];
+			normal[2] += n[2];
+			clusterArea += area;
+		}
+
+		for (unsigned int i = 0; i < 3; i++)
+			meshCenter[i] += center[i];
+		meshArea += clusterArea;
+
+		if (clusterArea > 0.0f)
+		{
+			for (unsigned int i = 0; i < 3; i++)
+				center[i] /= clusterArea;
+		}
+	}
+
+	if (meshArea > 0.0f)
+	{
+		for (unsigned int i = 0; i < 3; i++)
+			meshCenter[i] /= meshArea;
+	}
+
+	// How far each cluster faces away from the center
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const float* center = &clusterData[c * 6];
+		const float* normal = &clusterData[c * 6 + 3];
+		float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length <= 0.0f)
+			continue;
+
+		clusters[c].sortKey =
+			((center[0] - meshCenter[0]) * normal[0] +
+			 (center[1] - meshCenter[1]) * normal[1] +
+			 (center[2] - meshCenter[2]) * normal[2]) / length;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const TriangleCluster& a, const TriangleCluster& b) { return a.sortKey > b.sortKey; });
+
+	unsigned int output = 0;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const unsigned int* first = &source[clusters[c].firstTriangle * 3];
+		std::copy(first, first + clusters[c].triangleCount * 3, destination + output);
+		output += clusters[c].triangleCount * 3;
+	}
+}
+
+// --------------------------------------------------------
+// Reorders vertices in the order the indices first use them
+// --------------------------------------------------------
+unsigned int OptimizeVertexFetch(
+	Vertex* destination,
+	unsigned int* indices,
+	unsigned int indexCount,
+	const Vertex* vertices,
+	unsigned int vertexCount)
+{
+	static const unsigned int Unused = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertexCount, Unused);
+
+	unsigned int nextVertex = 0;
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int& newIndex = remap[indices[i]];
+		if (newIndex == Unused)
+		{
+			newIndex = nextVertex++;
+			destination[newIndex] = vertices[indices[i]];
+		}
+		indices[i] = newIndex;
+	}
+
+	return nextVertex;
+}
+
+// --------------------------------------------------------
+// Optimizes an imported mesh in place, keeping whichever
+// index size it already uses
+// --------------------------------------------------------
+void OptimizeMesh(ImportedMesh& mesh, const MeshOptimizeOptions& options, MeshOptimizeStats* stats)
+{
+	OptimizeClock::time_point start = OptimizeClock::now();
+
+	std::vector<unsigned int> indices;
+	if (mesh.uses16BitIndices)
+		indices.assign(mesh.indices16.begin(), mesh.indices16.end());
+	else
+		indices.swap(mesh.indices32);
+
+	unsigned int indexCount = (unsigned int)indices.size();
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+
+	// Measured on the full resolution level
+	unsigned int measuredCount = mesh.lods.empty() ? indexCount : mesh.lods[0].indexCount;
+	if (stats)
+		stats->before = AnalyzeVertexCache(indices.data(), measuredCount, vertexCount, options.cacheSize);
+
+	// Each level of detail is drawn on its own, so each is
+	// ordered on its own
+	std::vector<MeshLod> ranges(mesh.lods);
+	if (ranges.empty())
+	{
+		MeshLod whole = { 0, indexCount, 0.0f };
+		ranges.push_back(whole);
+	}
+
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		unsigned int* range = indices.data() + ranges[i].firstIndex;
+
+		if (options.vertexCache)
+			OptimizeVertexCache(range, range, ranges[i].indexCount, vertexCount);
+
+		if (options.overdraw)
+		{
+			OptimizeOverdraw(
+				range, range, ranges[i].indexCount,
+				mesh.vertices.data(), vertexCount,
+				options.overdrawThreshold, options.cacheSize);
+		}
+	}
+
+	if (options.vertexFetch)
+	{
+		std::vector<Vertex> reordered(vertexCount);
+		vertexCount = OptimizeVertexFetch(reordered.data(), indices.data(), indexCount, mesh.vertices.data(), vertexCount);
+		reordered.resize(vertexCount);
+		mesh.vertices.swap(reordered);
+	}
+
+	if (stats)
+	{
+		stats->after = AnalyzeVertexCache(indices.data(), measuredCount, vertexCount, options.cacheSize);
+		stats->optimizeMs = std::chrono::duration<double, std::milli>(OptimizeClock::now() - start).count();
+	}
+
+	if (mesh.uses16BitIndices)
+		mesh.indices16.assign(indices.begin(), indices.end());
+	else
+		mesh.indices32.swap(indices);
+}
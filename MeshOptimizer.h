@@ -0,0 +1,97 @@
+#pragma once
+
+#include "Vertex.h"
+
+struct ImportedMesh;
+
+// --------------------------------------------------------
+// Index and vertex buffer reordering, so the GPU does less
+// work drawing the same triangles.
+//
+//  - Vertex cache: orders triangles so vertices that were
+//    just transformed get reused (Tom Forsyth's "Linear-
+//    Speed Vertex Cache Optimisation")
+//  - Overdraw: splits that order into clusters and draws the
+//    outward-facing ones first, so more pixels fail the
+//    depth test, while keeping most of the cache benefit
+//  - Vertex fetch: orders vertices by first use, so reads
+//    from the vertex buffer are close together
+//
+// All of these work on triangle lists with 32-bit indices
+// and have no Direct3D dependencies.  Results are the same
+// triangles, just in a different order.
+// --------------------------------------------------------
+
+// --------------------------------------------------------
+// How well an index buffer uses the post-transform cache,
+// measured by simulating a FIFO cache
+//  - ACMR: vertices transformed per triangle (0.5 - 3.0)
+//  - ATVR: vertices transformed per unique vertex (1.0 is
+//    perfect - each vertex transformed exactly once)
+// --------------------------------------------------------
+struct VertexCacheStats
+{
+	unsigned int transformedCount = 0;
+	float acmr = 0.0f;
+	float atvr = 0.0f;
+};
+
+VertexCacheStats AnalyzeVertexCache(
+	const unsigned int* indices,
+	unsigned int indexCount,
+	unsigned int vertexCount,
+	unsigned int cacheSize = 16);
+
+// destination may be the same array as indices
+void OptimizeVertexCache(
+	unsigned int* destination,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	unsigned int vertexCount);
+
+// Expects indices already optimized for the vertex cache,
+// and gives up at most "threshold" times its ACMR
+// (destination may be the same array as indices)
+void OptimizeOverdraw(
+	unsigned int* destination,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	float threshold = 1.05f,
+	unsigned int cacheSize = 16);
+
+// Rewrites indices in place and returns the new vertex
+// count - unreferenced vertices are dropped
+// (destination must not overlap vertices)
+unsigned int OptimizeVertexFetch(
+	Vertex* destination,
+	unsigned int* indices,
+	unsigned int indexCount,
+	const Vertex* vertices,
+	unsigned int vertexCount);
+
+// --------------------------------------------------------
+// Running all of the above on an imported mesh, for the
+// bake step or at load time
+// --------------------------------------------------------
+struct MeshOptimizeOptions
+{
+	bool vertexCache = true;
+	bool overdraw = false;
+	bool vertexFetch = true;
+	float overdrawThreshold = 1.05f;
+	unsigned int cacheSize = 16;	// Only used for measuring and overdraw clusters
+};
+
+struct MeshOptimizeStats
+{
+	VertexCacheStats before;
+	VertexCacheStats after;
+	double optimizeMs = 0.0;
+};
+
+void OptimizeMesh(
+	ImportedMesh& mesh,
+	const MeshOptimizeOptions& options = MeshOptimizeOptions(),
+	MeshOptimizeStats* stats = 0);
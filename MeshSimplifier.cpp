@@ -0,0 +1,751 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "ObjImporter.h"
+#include "SpatialGrid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+// How much more a border edge's quadric counts than the
+// surface around it - high, so borders barely move
+static const double BorderWeight = 10.0;
+
+// Only the cheapest part of each pass's candidates are
+// collapsed, so costs can be recomputed before going further
+static const unsigned int PassCandidateFraction = 3;
+
+typedef std::chrono::steady_clock SimplifyClock;
+
+enum SimplifyVertexKind
+{
+	SimplifyVertexManifold,	// Free to move onto any neighbor
+	SimplifyVertexBorder,	// Only moves along its border
+	SimplifyVertexLocked	// Never moves
+};
+
+// --------------------------------------------------------
+// A quadric - the sum of squared distances to a set of
+// planes, as a symmetric 3x3 matrix, a vector and a
+// constant, along with the total weight of those planes
+// --------------------------------------------------------
+struct Quadric
+{
+	double a00, a01, a02, a11, a12, a22;
+	double b0, b1, b2;
+	double c;
+	double weight;
+};
+
+static void AddPlane(Quadric& q, double nx, double ny, double nz, double d, double weight)
+{
+	q.a00 += weight * nx * nx;
+	q.a01 += weight * nx * ny;
+	q.a02 += weight * nx * nz;
+	q.a11 += weight * ny * ny;
+	q.a12 += weight * ny * nz;
+	q.a22 += weight * nz * nz;
+	q.b0 += weight * nx * d;
+	q.b1 += weight * ny * d;
+	q.b2 += weight * nz * d;
+	q.c += weight * d * d;
+	q.weight += weight;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& other)
+{
+	q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02;
+	q.a11 += other.a11; q.a12 += other.a12; q.a22 += other.a22;
+	q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+	q.c += other.c;
+	q.weight += other.weight;
+}
+
+// Sum of squared distances from p to the quadric's planes
+static double EvaluateQuadricSum(const Quadric& q, const XMFLOAT3& p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	return
+		q.a00 * x * x + q.a11 * y * y + q.a22 * z * z +
+		2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+		2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) +
+		q.c;
+}
+
+// Mean squared distance from p to the planes of two quadrics
+// together - the same as adding them first, without the copy
+static double EvaluateQuadrics(const Quadric& q0, const Quadric& q1, const XMFLOAT3& p)
+{
+	double weight = q0.weight + q1.weight;
+	double result = EvaluateQuadricSum(q0, p) + EvaluateQuadricSum(q1, p);
+	return weight > 0.0 ? std::max(result / weight, 0.0) : 0.0;
+}
+
+static void TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2, double* n)
+{
+	double e1[3] = { (double)p1.x - p0.x, (double)p1.y - p0.y, (double)p1.z - p0.z };
+	double e2[3] = { (double)p2.x - p0.x, (double)p2.y - p0.y, (double)p2.z - p0.z };
+	n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+// Squared distance from p to the nearest point on a
+// triangle (Ericson, "Real-Time Collision Detection", 5.1.5)
+static double PointTriangleDistanceSq(const XMFLOAT3& p, const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+{
+	double ab[3] = { (double)b.x - a.x, (double)b.y - a.y, (double)b.z - a.z };
+	double ac[3] = { (double)c.x - a.x, (double)c.y - a.y, (double)c.z - a.z };
+	double ap[3] = { (double)p.x - a.x, (double)p.y - a.y, (double)p.z - a.z };
+	double bp[3] = { (double)p.x - b.x, (double)p.y - b.y, (double)p.z - b.z };
+	double cp[3] = { (double)p.x - c.x, (double)p.y - c.y, (double)p.z - c.z };
+
+	double d1 = ab[0] * ap[0] + ab[1] * ap[1] + ab[2] * ap[2];
+	double d2 = ac[0] * ap[0] + ac[1] * ap[1] + ac[2] * ap[2];
+	double d3 = ab[0] * bp[0] + ab[1] * bp[1] + ab[2] * bp[2];
+	double d4 = ac[0] * bp[0] + ac[1] * bp[1] + ac[2] * bp[2];
+	double d5 = ab[0] * cp[0] + ab[1] * cp[1] + ab[2] * cp[2];
+	double d6 = ac[0] * cp[0] + ac[1] * cp[1] + ac[2] * cp[2];
+
+	// Where on the triangle is nearest, as weights of b and c
+	double v, w;
+	double va = d3 * d6 - d5 * d4;
+	double vb = d5 * d2 - d1 * d6;
+	double vc = d1 * d4 - d3 * d2;
+	if (d1 <= 0.0 && d2 <= 0.0)
+		v = 0.0, w = 0.0;
+	else if (d3 >= 0.0 && d4 <= d3)
+		v = 1.0, w = 0.0;
+	else if (d6 >= 0.0 && d5 <= d6)
+		v = 0.0, w = 1.0;
+	else if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+		v = d1 / (d1 - d3), w = 0.0;
+	else if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+		v = 0.0, w = d2 / (d2 - d6);
+	else if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0)
+		w = (d4 - d3) / ((d4 - d3) + (d5 - d6)), v = 1.0 - w;
+	else
+	{
+		double denominator = 1.0 / (va + vb + vc);
+		v = vb * denominator;
+		w = vc * denominator;
+	}
+
+	double dx = ap[0] - ab[0] * v - ac[0] * w;
+	double dy = ap[1] - ab[1] * v - ac[1] * w;
+	double dz = ap[2] - ab[2] * v - ac[2] * w;
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// --------------------------------------------------------
+// The triangles around each vertex, in one array - the
+// ones around v are triangles[adjacency.firstTriangle[v]] up to
+// triangles[adjacency.firstTriangle[v + 1]]
+// --------------------------------------------------------
+struct VertexAdjacency
+{
+	std::vector<unsigned int> firstTriangle;
+	std::vector<unsigned int> triangles;
+	std::vector<unsigned int> fill;
+};
+
+static void BuildAdjacency(
+	const std::vector<unsigned int>& indices,
+	unsigned int vertexCount,
+	VertexAdjacency& adjacency)
+{
+	adjacency.firstTriangle.assign(vertexCount + 1, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency.firstTriangle[indices[i] + 1]++;
+	for (unsigned int v = 0; v < vertexCount; v++)
+		adjacency.firstTriangle[v + 1] += adjacency.firstTriangle[v];
+
+	adjacency.triangles.resize(indices.size());
+	adjacency.fill.assign(adjacency.firstTriangle.begin(), adjacency.firstTriangle.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++)
+		adjacency.triangles[adjacency.fill[indices[i]]++] = (unsigned int)(i / 3);
+}
+
+// --------------------------------------------------------
+// How many triangles use the edge between "from" and "to"
+//  - One means it's on a border, more than two means it's
+//    non-manifold
+// --------------------------------------------------------
+static unsigned int CountEdgeTriangles(
+	const std::vector<unsigned int>& indices,
+	const VertexAdjacency& adjacency,
+	unsigned int from,
+	unsigned int to)
+{
+	unsigned int count = 0;
+	for (unsigned int j = adjacency.firstTriangle[from]; j < adjacency.firstTriangle[from + 1]; j++)
+	{
+		const unsigned int* tri = &indices[adjacency.triangles[j] * 3];
+		if (tri[0] == to || tri[1] == to || tri[2] == to)
+			count++;
+	}
+	return count;
+}
+
+// Orders positions by their bits, so identical ones end up
+// next to each other
+static bool PositionBitsLess(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	unsigned int bitsA[3];
+	unsigned int bitsB[3];
+	memcpy(bitsA, &a, sizeof(bitsA));
+	memcpy(bitsB, &b, sizeof(bitsB));
+
+	if (bitsA[0] != bitsB[0]) return bitsA[0] < bitsB[0];
+	if (bitsA[1] != bitsB[1]) return bitsA[1] < bitsB[1];
+	return bitsA[2] < bitsB[2];
+}
+
+// --------------------------------------------------------
+// Works out which vertices may move, and how
+// --------------------------------------------------------
+static void ClassifyVertices(
+	const std::vector<unsigned int>& indices,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	const VertexAdjacency& adjacency,
+	std::vector<unsigned char>& kinds)
+{
+	kinds.assign(vertexCount, SimplifyVertexManifold);
+
+	// Seams - sort by position and lock any that are shared
+	std::vector<unsigned int> order(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		order[v] = v;
+
+	std::sort(order.begin(), order.end(),
+		[vertices](unsigned int a, unsigned int b)
+		{
+			return PositionBitsLess(vertices[a].Position, vertices[b].Position);
+		});
+
+	for (unsigned int i = 1; i < vertexCount; i++)
+	{
+		if (!PositionBitsLess(vertices[order[i - 1]].Position, vertices[order[i]].Position))
+		{
+			kinds[order[i]] = SimplifyVertexLocked;
+			kinds[order[i - 1]] = SimplifyVertexLocked;
+		}
+	}
+
+	// Borders and non-manifold edges, going over each edge
+	// from the triangle that has it as (v, next)
+	std::vector<unsigned char> borderCounts(vertexCount, 0);
+	for (size_t t = 0; t < indices.size(); t += 3)
+	{
+		for (unsigned int e = 0; e < 3; e++)
+		{
+			unsigned int a = indices[t + e];
+			unsigned int b = indices[t + (e + 1) % 3];
+
+			unsigned int count = CountEdgeTriangles(indices, adjacency, a, b);
+			if (count == 1)
+			{
+				borderCounts[a] = (unsigned char)std::min(borderCounts[a] + 1, 255);
+				borderCounts[b] = (unsigned char)std::min(borderCounts[b] + 1, 255);
+			}
+			else if (count > 2)
+			{
+				kinds[a] = SimplifyVertexLocked;
+				kinds[b] = SimplifyVertexLocked;
+			}
+		}
+	}
+
+	// A simple border passes through a vertex once (two
+	// border edges), anything else is too complicated
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		if (kinds[v] == SimplifyVertexLocked || borderCounts[v] == 0)
+			continue;
+
+		kinds[v] = borderCounts[v] == 2 ? SimplifyVertexBorder : SimplifyVertexLocked;
+	}
+}
+
+// --------------------------------------------------------
+// Each vertex's quadric - the planes of its triangles,
+// weighted by area, plus planes that hold borders in place
+// --------------------------------------------------------
+static void ComputeQuadrics(
+	const std::vector<unsigned int>& indices,
+	const Vertex* vertices,
+	const VertexAdjacency& adjacency,
+	std::vector<Quadric>& quadrics)
+{
+	for (size_t t = 0; t < indices.size(); t += 3)
+	{
+		const XMFLOAT3& p0 = vertices[indices[t + 0]].Position;
+		const XMFLOAT3& p1 = vertices[indices[t + 1]].Position;
+		const XMFLOAT3& p2 = vertices[indices[t + 2]].Position;
+
+		double n[3];
+		TriangleNormal(p0, p1, p2, n);
+		double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0.0)
+			continue;
+
+		double area = length * 0.5;
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+		double d = -(n[0] * p0.x + n[1] * p0.y + n[2] * p0.z);
+
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t + c];
+			AddPlane(quadrics[v], n[0], n[1], n[2], d, area);
+
+			// A plane through this border edge, at right angles
+			// to the triangle, keeps the edge from moving sideways
+			unsigned int next = indices[t + (c + 1) % 3];
+			if (CountEdgeTriangles(indices, adjacency, v, next) != 1)
+				continue;
+
+			const XMFLOAT3& a = vertices[v].Position;
+			const XMFLOAT3& b = vertices[next].Position;
+			double edge[3] = { (double)b.x - a.x, (double)b.y - a.y, (double)b.z - a.z };
+			double m[3] =
+			{
+				edge[1] * n[2] - edge[2] * n[1],
+				edge[2] * n[0] - edge[0] * n[2],
+				edge[0] * n[1] - edge[1] * n[0]
+			};
+			double mLength = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+			if (mLength <= 0.0)
+				continue;
+
+			m[0] /= mLength;
+			m[1] /= mLength;
+			m[2] /= mLength;
+			double md = -(m[0] * a.x + m[1] * a.y + m[2] * a.z);
+			double weight = (edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2]) * BorderWeight;
+
+			AddPlane(quadrics[v], m[0], m[1], m[2], md, weight);
+			AddPlane(quadrics[next], m[0], m[1], m[2], md, weight);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// How far simplifying moved the surface - the farthest any
+// collapsed vertex is from the simplified triangles.
+//
+// The triangles around the vertex a collapsed one went to
+// are usually the nearest, which gives each vertex an upper
+// bound.  Going through them largest bound first, each is
+// checked against every triangle near enough to beat its
+// bound (found through a grid of triangle centers), until
+// no bound left could beat the farthest found.
+//
+// indices       - The simplified triangles
+// vertices      - The vertices (shared by both meshes)
+// collapsedInto - Each vertex's vertex in the simplified
+//                 mesh (itself, unless it was collapsed)
+// --------------------------------------------------------
+static float MeasureCollapseError(
+	const std::vector<unsigned int>& indices,
+	const Vertex* vertices,
+	const std::vector<unsigned int>& collapsedInto)
+{
+	unsigned int triangleCount = (unsigned int)indices.size() / 3;
+	unsigned int vertexCount = (unsigned int)collapsedInto.size();
+	if (triangleCount == 0)
+		return 0.0f;
+
+	VertexAdjacency adjacency;
+	BuildAdjacency(indices, vertexCount, adjacency);
+
+	// Squared bound and vertex, for each collapsed vertex
+	std::vector<std::pair<double, unsigned int>> bounds;
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		unsigned int into = collapsedInto[v];
+		if (into == v)
+			continue;
+
+		// If the surface around it vanished altogether, the
+		// vertex it went to is all that's left to measure to
+		const XMFLOAT3& p = vertices[v].Position;
+		const XMFLOAT3& q = vertices[into].Position;
+		double dx = (double)p.x - q.x, dy = (double)p.y - q.y, dz = (double)p.z - q.z;
+		double nearest = dx * dx + dy * dy + dz * dz;
+
+		for (unsigned int j = adjacency.firstTriangle[into]; j < adjacency.firstTriangle[into + 1]; j++)
+		{
+			const unsigned int* tri = &indices[adjacency.triangles[j] * 3];
+			nearest = std::min(nearest, PointTriangleDistanceSq(
+				p, vertices[tri[0]].Position, vertices[tri[1]].Position, vertices[tri[2]].Position));
+		}
+
+		bounds.push_back(std::make_pair(nearest, v));
+	}
+
+	if (bounds.empty())
+		return 0.0f;
+
+	// Only the first few largest are ever looked at
+	std::make_heap(bounds.begin(), bounds.end());
+
+	// Any triangle nearer than a bound has its center within
+	// its own size of that distance
+	std::vector<XMFLOAT3> centers(triangleCount);
+	float largestExtent = 0.0f;
+	float totalExtent = 0.0f;
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3 + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+		XMVECTOR center = XMVectorScale(XMVectorAdd(p0, XMVectorAdd(p1, p2)), 1.0f / 3.0f);
+		XMStoreFloat3(&centers[t], center);
+
+		float extent = sqrtf(XMVectorGetX(XMVectorMax(
+			XMVector3LengthSq(XMVectorSubtract(p0, center)), XMVectorMax(
+			XMVector3LengthSq(XMVectorSubtract(p1, center)),
+			XMVector3LengthSq(XMVectorSubtract(p2, center))))));
+		largestExtent = std::max(largestExtent, extent);
+		totalExtent += extent;
+	}
+
+	SpatialGrid grid(std::max(totalExtent / triangleCount * 2.0f, 1e-6f));
+	grid.Build(centers.data(), triangleCount);
+
+	double largest = 0.0;
+	std::vector<unsigned int> nearby;
+	while (!bounds.empty() && bounds.front().first > largest)
+	{
+		std::pop_heap(bounds.begin(), bounds.end());
+		const XMFLOAT3& p = vertices[bounds.back().second].Position;
+		double nearest = bounds.back().first;
+		bounds.pop_back();
+
+		nearby.clear();
+		grid.QueryRadius(p, (float)sqrt(nearest) + largestExtent, nearby);
+		for (unsigned int j = 0; j < nearby.size(); j++)
+		{
+			const unsigned int* tri = &indices[nearby[j] * 3];
+			nearest = std::min(nearest, PointTriangleDistanceSq(
+				p, vertices[tri[0]].Position, vertices[tri[1]].Position, vertices[tri[2]].Position));
+		}
+
+		largest = std::max(largest, nearest);
+	}
+
+	return (float)sqrt(largest);
+}
+
+// --------------------------------------------------------
+// Moving one vertex onto another
+// --------------------------------------------------------
+struct Collapse
+{
+	unsigned int from;
+	unsigned int to;
+	double cost;
+};
+
+// --------------------------------------------------------
+// Simplifies a triangle list with edge collapses
+//
+// destination      - Where the new indices go (may be indices)
+// indices          - The triangle list to simplify
+// indexCount       - Number of indices
+// vertices         - The vertices they refer to
+// vertexCount      - Number of vertices
+// targetIndexCount - Stop once there are this many indices
+// maxError         - Largest collapse cost to allow (the
+//                    quadric error), in mesh units
+// resultError      - Optional - set to the farthest any
+//                    removed vertex is from the result
+// collapsedInto    - Optional, vertexCount entries - filled
+//                    with each vertex's vertex in the result
+//                    (itself, unless it was collapsed)
+// --------------------------------------------------------
+unsigned int SimplifyMesh(
+	unsigned int* destination,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	unsigned int targetIndexCount,
+	float maxError,
+	float* resultError,
+	unsigned int* collapsedInto)
+{
+	std::vector<unsigned int> current(indices, indices + indexCount / 3 * 3);
+
+	VertexAdjacency adjacency;
+	BuildAdjacency(current, vertexCount, adjacency);
+
+	std::vector<unsigned char> kinds;
+	ClassifyVertices(current, vertices, vertexCount, adjacency, kinds);
+
+	Quadric zero = {};
+	std::vector<Quadric> quadrics(vertexCount, zero);
+	ComputeQuadrics(current, vertices, adjacency, quadrics);
+
+	double maxCost = (double)maxError * maxError;
+
+	std::vector<Collapse> candidates;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<unsigned char> locked(vertexCount);
+
+	std::vector<unsigned int> into(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		into[v] = v;
+
+	while (current.size() > targetIndexCount)
+	{
+		unsigned int triangleCount = (unsigned int)current.size() / 3;
+
+		// Each vertex's cheapest collapse onto a neighbor
+		candidates.clear();
+		for (unsigned int from = 0; from < vertexCount; from++)
+		{
+			if (kinds[from] == SimplifyVertexLocked)
+				continue;
+
+			Collapse best;
+			best.cost = maxCost;
+			best.from = from;
+			best.to = from;
+
+			for (unsigned int j = adjacency.firstTriangle[from]; j < adjacency.firstTriangle[from + 1]; j++)
+			{
+				const unsigned int* tri = &current[adjacency.triangles[j] * 3];
+				for (unsigned int c = 0; c < 3; c++)
+				{
+					if (tri[c] != from)
+						continue;
+
+					// Each neighbor of an interior vertex comes next
+					// after it in exactly one triangle, but a border
+					// vertex's neighbor along the border only comes
+					// before it, so those check both
+					for (unsigned int side = 1; side < 3; side++)
+					{
+						unsigned int to = tri[(c + side) % 3];
+						if (kinds[from] == SimplifyVertexManifold && side == 2)
+							continue;
+
+						// Borders move along border edges - the edges with
+						// just one triangle on them
+						if (kinds[from] == SimplifyVertexBorder &&
+							CountEdgeTriangles(current, adjacency, from, to) != 1)
+							continue;
+
+						double cost = EvaluateQuadrics(quadrics[from], quadrics[to], vertices[to].Position);
+						if (cost <= best.cost)
+						{
+							best.cost = cost;
+							best.to = to;
+						}
+					}
+				}
+			}
+
+			if (best.to != from)
+				candidates.push_back(best);
+		}
+
+		if (candidates.empty())
+			break;
+
+		// Only the cheapest part needs to be in order
+		size_t passCount = candidates.size() / PassCandidateFraction + 1;
+		std::nth_element(candidates.begin(), candidates.begin() + (passCount - 1), candidates.end(),
+			[](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+		std::sort(candidates.begin(), candidates.begin() + passCount,
+			[](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+		candidates.resize(passCount);
+
+		unsigned int trianglesToRemove = triangleCount - targetIndexCount / 3;
+		unsigned int trianglesRemoved = 0;
+
+		for (unsigned int v = 0; v < vertexCount; v++)
+			remap[v] = v;
+		std::fill(locked.begin(), locked.end(), 0);
+
+		for (size_t i = 0; i < candidates.size() && trianglesRemoved < trianglesToRemove; i++)
+		{
+			const Collapse& collapse = candidates[i];
+			if (locked[collapse.from] || locked[collapse.to])
+				continue;
+
+			// Make sure no triangle around "from" would flip over
+			const XMFLOAT3& target = vertices[collapse.to].Position;
+			unsigned int removed = 0;
+			bool flips = false;
+			for (unsigned int j = adjacency.firstTriangle[collapse.from]; j < adjacency.firstTriangle[collapse.from + 1] && !flips; j++)
+			{
+				const unsigned int* tri = &current[adjacency.triangles[j] * 3];
+				if (tri[0] == collapse.to || tri[1] == collapse.to || tri[2] == collapse.to)
+				{
+					removed++;
+					continue;
+				}
+
+				XMFLOAT3 moved[3];
+				for (unsigned int c = 0; c < 3; c++)
+					moved[c] = tri[c] == collapse.from ? target : vertices[tri[c]].Position;
+
+				double before[3];
+				double after[3];
+				TriangleNormal(vertices[tri[0]].Position, vertices[tri[1]].Position, vertices[tri[2]].Position, before);
+				TriangleNormal(moved[0], moved[1], moved[2], after);
+				flips = before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0;
+			}
+
+			if (flips)
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			AddQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			trianglesRemoved += removed;
+
+			// Nothing touching the moved triangles can change
+			// again this pass, since their costs are now stale
+			for (unsigned int j = adjacency.firstTriangle[collapse.from]; j < adjacency.firstTriangle[collapse.from + 1]; j++)
+			{
+				const unsigned int* tri = &current[adjacency.triangles[j] * 3];
+				locked[tri[0]] = locked[tri[1]] = locked[tri[2]] = 1;
+			}
+		}
+
+		if (trianglesRemoved == 0)
+			break;
+
+		// Apply the collapses and drop the triangles that disappeared
+		size_t write = 0;
+		for (size_t t = 0; t < current.size(); t += 3)
+		{
+			unsigned int a = remap[current[t + 0]];
+			unsigned int b = remap[current[t + 1]];
+			unsigned int c = remap[current[t + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+
+			current[write++] = a;
+			current[write++] = b;
+			current[write++] = c;
+		}
+		current.resize(write);
+
+		// A vertex collapsed onto can't move in the same pass,
+		// so one step follows each vertex to where it is now
+		for (unsigned int v = 0; v < vertexCount; v++)
+			into[v] = remap[into[v]];
+
+		BuildAdjacency(current, vertexCount, adjacency);
+	}
+
+	if (resultError)
+		*resultError = MeasureCollapseError(current, vertices, into);
+	if (collapsedInto)
+		std::copy(into.begin(), into.end(), collapsedInto);
+
+	std::copy(current.begin(), current.end(), destination);
+	return (unsigned int)current.size();
+}
+
+// --------------------------------------------------------
+// Builds successively simpler levels, each from the one
+// before, until they stop getting much simpler
+// --------------------------------------------------------
+void BuildLodChain(ImportedMesh& mesh, const LodChainOptions& options, LodChainStats* stats)
+{
+	SimplifyClock::time_point start = SimplifyClock::now();
+
+	std::vector<unsigned int> indices;
+	if (mesh.uses16BitIndices)
+		indices.assign(mesh.indices16.begin(), mesh.indices16.end());
+	else
+		indices = mesh.indices32;
+
+	// Any existing chain is replaced
+	if (!mesh.lods.empty())
+		indices.resize(mesh.lods[0].indexCount);
+
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	unsigned long long trianglesProcessed = 0;
+
+	// Errors are relative to the mesh's size
+	float extent = 0.0f;
+	if (vertexCount > 0)
+	{
+		XMVECTOR minimum = XMLoadFloat3(&mesh.vertices[0].Position);
+		XMVECTOR maximum = minimum;
+		for (unsigned int i = 1; i < vertexCount; i++)
+		{
+			XMVECTOR p = XMLoadFloat3(&mesh.vertices[i].Position);
+			minimum = XMVectorMin(minimum, p);
+			maximum = XMVectorMax(maximum, p);
+		}
+		extent = XMVectorGetX(XMVector3Length(XMVectorSubtract(maximum, minimum)));
+	}
+
+	mesh.lods.clear();
+	MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+	mesh.lods.push_back(full);
+
+	// Where each full resolution vertex is in the latest level,
+	// so every level is measured against the original
+	std::vector<unsigned int> collapsedInto(vertexCount);
+	std::vector<unsigned int> levelCollapsedInto(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		collapsedInto[v] = v;
+
+	std::vector<unsigned int> level(indices);
+	while (mesh.lods.size() < options.maxLods && level.size() / 3 > options.minTriangles)
+	{
+		unsigned int previousCount = (unsigned int)level.size();
+		unsigned int target = (unsigned int)(previousCount / 3 * options.reduction) * 3;
+
+		trianglesProcessed += previousCount / 3;
+		unsigned int count = SimplifyMesh(
+			level.data(), level.data(), previousCount,
+			mesh.vertices.data(), vertexCount,
+			target, options.maxError * extent, 0, levelCollapsedInto.data());
+		level.resize(count);
+
+		// Not worth another level unless it's a real reduction
+		if (count == 0 || count > previousCount - previousCount / 10)
+			break;
+
+		OptimizeVertexCache(level.data(), level.data(), count, vertexCount);
+
+		for (unsigned int v = 0; v < vertexCount; v++)
+			collapsedInto[v] = levelCollapsedInto[collapsedInto[v]];
+
+		// Never less than a finer level's, so coarser levels
+		// are always at least as far off
+		MeshLod lod;
+		lod.firstIndex = (unsigned int)indices.size();
+		lod.indexCount = count;
+		lod.error = std::max(mesh.lods.back().error,
+			MeasureCollapseError(level, mesh.vertices.data(), collapsedInto));
+		mesh.lods.push_back(lod);
+
+		indices.insert(indices.end(), level.begin(), level.end());
+	}
+
+	if (mesh.uses16BitIndices)
+		mesh.indices16.assign(indices.begin(), indices.end());
+	else
+		mesh.indices32.swap(indices);
+
+	if (stats)
+	{
+		stats->simplifyMs = std::chrono::duration<double, std::milli>(SimplifyClock::now() - start).count();
+		stats->trianglesProcessed = trianglesProcessed;
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+#include "Vertex.h"
+
+struct ImportedMesh;
+
+// --------------------------------------------------------
+// One level of detail - a range of a mesh's index buffer,
+// and how far (in the mesh's units) its surface strays from
+// the full resolution one: the farthest any full resolution
+// vertex it dropped is from its triangles.  Coarser levels
+// never have less error than finer ones.
+// --------------------------------------------------------
+struct MeshLod
+{
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	float error;
+};
+
+// --------------------------------------------------------
+// Mesh simplification with quadric error metrics (Garland
+// and Heckbert, "Surface Simplification Using Quadric Error
+// Metrics").
+//
+// Edges are collapsed cheapest first, each one moving a
+// vertex onto one of its neighbors, so simplified meshes
+// only ever use the original vertices.  That lets every
+// level of detail share a single vertex buffer.
+//
+// To keep the mesh's outline and attributes intact:
+//  - Vertices on an open border only slide along it
+//  - Vertices on a seam (the same position used by more
+//    than one vertex, with different normals or uvs) and on
+//    non-manifold edges never move
+//  - Collapses that would flip a triangle are skipped
+//
+// No Direct3D dependencies - this runs at bake time.
+// --------------------------------------------------------
+
+// Returns the new index count, stopping at targetIndexCount
+// or when every remaining collapse's quadric error would
+// exceed maxError (in the mesh's units).  destination may
+// be indices.
+unsigned int SimplifyMesh(
+	unsigned int* destination,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	unsigned int targetIndexCount,
+	float maxError,
+	float* resultError = 0,
+	unsigned int* collapsedInto = 0);
+
+// --------------------------------------------------------
+// Building a whole chain of levels for an imported mesh
+// --------------------------------------------------------
+struct LodChainOptions
+{
+	unsigned int maxLods = 6;			// Including the full resolution one
+	float reduction = 0.5f;				// Triangles kept from one level to the next
+	float maxError = 0.05f;				// Relative to the size of the mesh's bounds
+	unsigned int minTriangles = 32;		// Stop once a level is this small
+};
+
+struct LodChainStats
+{
+	double simplifyMs = 0.0;
+	unsigned long long trianglesProcessed = 0;	// Input triangles, summed over every level built
+};
+
+// Appends each simplified level's indices after the full
+// resolution ones, and fills in mesh.lods
+void BuildLodChain(
+	ImportedMesh& mesh,
+	const LodChainOptions& options = LodChainOptions(),
+	LodChainStats* stats = 0);
@@ -0,0 +1,438 @@
+#include "MeshletBuilder.h"
+#include "Frustum.h"
+#include "MeshOptimizer.h"
+#include "ObjImporter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+// Clusters whose normals spread further than this (the
+// cosine of the widest angle from the cone's axis) are
+// never back-face culled - the cone would be too wide
+static const float MinConeSpread = 0.1f;
+
+typedef std::chrono::steady_clock MeshletClock;
+
+// --------------------------------------------------------
+// A sphere around every point, with Ritter's method - start
+// from two far apart points, then grow to fit any outside
+// --------------------------------------------------------
+static void ComputeBoundingSphere(const std::vector<XMFLOAT3>& points, XMFLOAT3& center, float& radius)
+{
+	XMVECTOR first = XMLoadFloat3(&points[0]);
+	XMVECTOR a = first;
+	XMVECTOR b = first;
+	float furthest = -1.0f;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		float distance = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&points[i]), first)));
+		if (distance > furthest)
+		{
+			furthest = distance;
+			a = XMLoadFloat3(&points[i]);
+		}
+	}
+
+	furthest = -1.0f;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		float distance = XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&points[i]), a)));
+		if (distance > furthest)
+		{
+			furthest = distance;
+			b = XMLoadFloat3(&points[i]);
+		}
+	}
+
+	XMVECTOR c = XMVectorScale(XMVectorAdd(a, b), 0.5f);
+	float r = sqrtf(furthest) * 0.5f;
+
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&points[i]);
+		float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(p, c)));
+		if (distance > r)
+		{
+			// Move just far enough towards p to take it in
+			float grownRadius = (r + distance) * 0.5f;
+			c = XMVectorAdd(c, XMVectorScale(XMVectorSubtract(p, c), (grownRadius - r) / distance));
+			r = grownRadius;
+		}
+	}
+
+	XMStoreFloat3(&center, c);
+	radius = r;
+}
+
+// --------------------------------------------------------
+// Fills in a meshlet's sphere and normal cone from its
+// triangles (indices) and unique vertex positions (points)
+// --------------------------------------------------------
+static void ComputeMeshletBounds(
+	Meshlet& meshlet,
+	const unsigned int* indices,
+	const Vertex* vertices,
+	const std::vector<XMFLOAT3>& points)
+{
+	ComputeBoundingSphere(points, meshlet.center, meshlet.radius);
+
+	// No cone unless proven otherwise
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = XMFLOAT3(0, 0, 0);
+	meshlet.coneCutoff = 1.0f;
+
+	// The cone's axis is the average of the triangles' normals
+	std::vector<XMFLOAT3> normals(meshlet.triangleCount);
+	XMVECTOR sum = XMVectorZero();
+	for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3 + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+		XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+
+		// Degenerate triangles can't be seen from any side
+		float length = XMVectorGetX(XMVector3Length(n));
+		n = length > 0.0f ? XMVectorScale(n, 1.0f / length) : XMVectorZero();
+
+		XMStoreFloat3(&normals[t], n);
+		sum = XMVectorAdd(sum, n);
+	}
+
+	float sumLength = XMVectorGetX(XMVector3Length(sum));
+	if (sumLength <= 0.0f)
+		return;
+
+	XMVECTOR axis = XMVectorScale(sum, 1.0f / sumLength);
+	float minDot = 1.0f;
+	for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+	{
+		XMVECTOR n = XMLoadFloat3(&normals[t]);
+		if (XMVectorGetX(XMVector3LengthSq(n)) > 0.0f)
+			minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(n, axis)));
+	}
+
+	if (minDot <= MinConeSpread)
+		return;
+
+	// Move the apex back along the axis until it's behind
+	// every triangle's plane, so being inside the cone past
+	// the apex means being behind all of them
+	XMVECTOR center = XMLoadFloat3(&meshlet.center);
+	float maxT = 0.0f;
+	for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+	{
+		XMVECTOR n = XMLoadFloat3(&normals[t]);
+		float dn = XMVectorGetX(XMVector3Dot(n, axis));
+		if (dn <= 0.0f)
+			continue;
+
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+		float dc = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, p0), n));
+		maxT = std::max(maxT, dc / dn);
+	}
+
+	XMStoreFloat3(&meshlet.coneApex, XMVectorSubtract(center, XMVectorScale(axis, maxT)));
+	XMStoreFloat3(&meshlet.coneAxis, axis);
+	meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+// --------------------------------------------------------
+// Splits a triangle list into meshlets, growing each one
+// from a seed triangle by repeatedly adding the neighboring
+// triangle that brings in the fewest new vertices (earliest
+// in the original order on a tie, so the existing vertex
+// cache order mostly survives)
+//
+// indices     - Triangle list, reordered in place
+// indexCount  - Number of indices
+// vertices    - The vertices they refer to
+// vertexCount - Number of vertices
+// meshlets    - Where to add the meshlets
+// baseIndex   - Added to each meshlet's firstIndex, for
+//               lists that are part of a bigger buffer
+// maxVertices - Unique vertices allowed per meshlet
+// maxTriangles - Triangles allowed per meshlet
+// --------------------------------------------------------
+void BuildMeshlets(
+	unsigned int* indices,
+	unsigned int indexCount,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	std::vector<Meshlet>& meshlets,
+	unsigned int baseIndex,
+	unsigned int maxVertices,
+	unsigned int maxTriangles)
+{
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0 || maxVertices < 3 || maxTriangles == 0)
+		return;
+
+	// Triangles around each vertex
+	std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		firstTriangle[indices[i] + 1]++;
+	for (unsigned int v = 0; v < vertexCount; v++)
+		firstTriangle[v + 1] += firstTriangle[v];
+
+	std::vector<unsigned int> vertexTriangles(triangleCount * 3);
+	std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+		vertexTriangles[fill[indices[i]]++] = i / 3;
+
+	std::vector<unsigned char> emitted(triangleCount, 0);
+	std::vector<unsigned int> vertexMeshlet(vertexCount, ~0u);	// Last meshlet to use each vertex
+	std::vector<unsigned int> ordered;
+	ordered.reserve(triangleCount * 3);
+
+	std::vector<unsigned int> candidates;
+	std::vector<XMFLOAT3> points;
+	unsigned int seed = 0;
+
+	for (unsigned int id = 0; ; id++)
+	{
+		while (seed < triangleCount && emitted[seed])
+			seed++;
+		if (seed == triangleCount)
+			break;
+
+		Meshlet meshlet = {};
+		meshlet.firstIndex = (unsigned int)ordered.size();
+		points.clear();
+		candidates.clear();
+		candidates.push_back(seed);
+
+		while (meshlet.triangleCount < maxTriangles)
+		{
+			// Cheapest candidate that still fits, dropping any
+			// that were added to the meshlet since
+			size_t best = ~(size_t)0;
+			unsigned int bestNew = 4;
+			size_t live = 0;
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				unsigned int t = candidates[i];
+				if (emitted[t])
+					continue;
+
+				candidates[live] = t;
+				unsigned int newVertices =
+					(vertexMeshlet[indices[t * 3 + 0]] != id) +
+					(vertexMeshlet[indices[t * 3 + 1]] != id) +
+					(vertexMeshlet[indices[t * 3 + 2]] != id);
+
+				if (meshlet.vertexCount + newVertices <= maxVertices &&
+					(newVertices < bestNew || (newVertices == bestNew && t < candidates[best])))
+				{
+					best = live;
+					bestNew = newVertices;
+				}
+				live++;
+			}
+			candidates.resize(live);
+
+			if (best == ~(size_t)0)
+				break;
+
+			unsigned int t = candidates[best];
+			candidates[best] = candidates.back();
+			candidates.pop_back();
+
+			emitted[t] = 1;
+			meshlet.triangleCount++;
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[t * 3 + c];
+				ordered.push_back(v);
+
+				if (vertexMeshlet[v] == id)
+					continue;
+
+				// A new vertex - its other triangles are now neighbors
+				vertexMeshlet[v] = id;
+				meshlet.vertexCount++;
+				points.push_back(vertices[v].Position);
+
+				for (unsigned int j = firstTriangle[v]; j < firstTriangle[v + 1]; j++)
+				{
+					if (!emitted[vertexTriangles[j]])
+						candidates.push_back(vertexTriangles[j]);
+				}
+			}
+		}
+
+		ComputeMeshletBounds(meshlet, &ordered[meshlet.firstIndex], vertices, points);
+		meshlet.firstIndex += baseIndex;
+		meshlets.push_back(meshlet);
+	}
+
+	std::copy(ordered.begin(), ordered.end(), indices);
+}
+
+// --------------------------------------------------------
+// Clusters the finest level of detail, then puts each
+// cluster's triangles back in vertex cache order
+//  - Run this after OptimizeMesh(), which would otherwise
+//    shuffle triangles between clusters
+// --------------------------------------------------------
+void BuildMeshlets(ImportedMesh& mesh)
+{
+	std::vector<unsigned int> indices;
+	if (mesh.uses16BitIndices)
+		indices.assign(mesh.indices16.begin(), mesh.indices16.end());
+	else
+		indices.swap(mesh.indices32);
+
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	unsigned int firstIndex = mesh.lods.empty() ? 0 : mesh.lods[0].firstIndex;
+	unsigned int indexCount = mesh.lods.empty() ? (unsigned int)indices.size() : mesh.lods[0].indexCount;
+
+	mesh.meshlets.clear();
+	BuildMeshlets(
+		indices.data() + firstIndex, indexCount,
+		mesh.vertices.data(), vertexCount,
+		mesh.meshlets, firstIndex);
+
+	// Each meshlet is reordered with its own (small) vertex
+	// numbering, so the optimizer's per-vertex tables don't
+	// cover the whole mesh every time
+	std::vector<unsigned int> localIndex(vertexCount, ~0u);
+	std::vector<unsigned int> localToMesh;
+	std::vector<unsigned int> local;
+	for (size_t i = 0; i < mesh.meshlets.size(); i++)
+	{
+		unsigned int* range = indices.data() + mesh.meshlets[i].firstIndex;
+		unsigned int count = mesh.meshlets[i].triangleCount * 3;
+
+		localToMesh.clear();
+		local.resize(count);
+		for (unsigned int j = 0; j < count; j++)
+		{
+			if (localIndex[range[j]] == ~0u)
+			{
+				localIndex[range[j]] = (unsigned int)localToMesh.size();
+				localToMesh.push_back(range[j]);
+			}
+			local[j] = localIndex[range[j]];
+		}
+
+		OptimizeVertexCache(local.data(), local.data(), count, (unsigned int)localToMesh.size());
+
+		for (unsigned int j = 0; j < count; j++)
+			range[j] = localToMesh[local[j]];
+		for (size_t j = 0; j < localToMesh.size(); j++)
+			localIndex[localToMesh[j]] = ~0u;
+	}
+
+	if (mesh.uses16BitIndices)
+		mesh.indices16.assign(indices.begin(), indices.end());
+	else
+		mesh.indices32.swap(indices);
+}
+
+// --------------------------------------------------------
+// Culls meshlets against the view, then packs the indices
+// of those left into output
+//  - Tests happen in the object's own space: the frustum
+//    comes from world * viewProjection, and the camera is
+//    moved into object space, so the meshlets' bounds are
+//    used as they are
+//  - That holds for back faces under any world matrix, non-
+//    uniform scale and shear included: a triangle's normal
+//    and its direction to the camera both change, but their
+//    dot product only picks up the matrix's determinant.  A
+//    mirroring matrix flips that sign (and which side gets
+//    drawn), so cones aren't used for those.
+//
+// meshlets       - The mesh's meshlets
+// meshletCount   - Number of meshlets
+// indices        - The mesh's index data
+// indexSize      - Bytes per index (2 or 4)
+// world          - The object's world matrix
+// viewProjection - The camera's view * projection
+// cameraPosition - World space, or null for no back-face culling
+// output         - Where the surviving indices go
+// stats          - Optional, for what was culled
+// --------------------------------------------------------
+unsigned int CullMeshlets(
+	const Meshlet* meshlets,
+	unsigned int meshletCount,
+	const void* indices,
+	unsigned int indexSize,
+	const XMFLOAT4X4& world,
+	const XMFLOAT4X4& viewProjection,
+	const XMFLOAT3* cameraPosition,
+	void* output,
+	MeshletCullStats* stats)
+{
+	MeshletClock::time_point start = MeshletClock::now();
+
+	XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+	XMFLOAT4X4 objectToClip;
+	XMStoreFloat4x4(&objectToClip, XMMatrixMultiply(worldMatrix, XMLoadFloat4x4(&viewProjection)));
+	Frustum frustum = ExtractFrustum(objectToClip);
+
+	XMVECTOR determinant = XMVector3Dot(worldMatrix.r[0], XMVector3Cross(worldMatrix.r[1], worldMatrix.r[2]));
+	bool cullBackfaces = cameraPosition && XMVectorGetX(determinant) > 0.0f;
+
+	XMFLOAT3 camera(0, 0, 0);
+	if (cullBackfaces)
+	{
+		XMVECTOR worldCamera = XMLoadFloat3(cameraPosition);
+		XMStoreFloat3(&camera, XMVector3TransformCoord(worldCamera, XMMatrixInverse(0, worldMatrix)));
+	}
+
+	const unsigned char* source = (const unsigned char*)indices;
+	unsigned char* destination = (unsigned char*)output;
+	unsigned int written = 0;
+	unsigned int frustumCulled = 0;
+	unsigned int backfaceCulled = 0;
+	unsigned int triangleCount = 0;
+
+	for (unsigned int i = 0; i < meshletCount; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		triangleCount += meshlet.triangleCount;
+
+		if (!SphereInFrustum(frustum, meshlet.center, meshlet.radius))
+		{
+			frustumCulled++;
+			continue;
+		}
+
+		if (cullBackfaces && meshlet.coneCutoff < 1.0f)
+		{
+			float dx = meshlet.coneApex.x - camera.x;
+			float dy = meshlet.coneApex.y - camera.y;
+			float dz = meshlet.coneApex.z - camera.z;
+			float length = sqrtf(dx * dx + dy * dy + dz * dz);
+			float d = dx * meshlet.coneAxis.x + dy * meshlet.coneAxis.y + dz * meshlet.coneAxis.z;
+			if (d > meshlet.coneCutoff * length)
+			{
+				backfaceCulled++;
+				continue;
+			}
+		}
+
+		size_t bytes = (size_t)meshlet.triangleCount * 3 * indexSize;
+		memcpy(destination + (size_t)written * indexSize, source + (size_t)meshlet.firstIndex * indexSize, bytes);
+		written += meshlet.triangleCount * 3;
+	}
+
+	if (stats)
+	{
+		stats->meshletCount = meshletCount;
+		stats->frustumCulled = frustumCulled;
+		stats->backfaceCulled = backfaceCulled;
+		stats->triangleCount = triangleCount;
+		stats->trianglesCulled = triangleCount - written / 3;
+		stats->culledTriangleRatio = triangleCount > 0 ? (float)stats->trianglesCulled / triangleCount : 0.0f;
+		stats->cullMs = std::chrono::duration<double, std::milli>(MeshletClock::now() - start).count();
+	}
+
+	return written;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+#include "Vertex.h"
+
+struct ImportedMesh;
+
+// --------------------------------------------------------
+// Meshlets - small clusters of neighboring triangles, each
+// a contiguous range of the index buffer, with bounds that
+// let whole clusters be culled at once:
+//
+//  - A bounding sphere, for frustum culling
+//  - A normal cone (axis, cutoff and apex) that holds every
+//    triangle's normal, for back-face culling - when the
+//    camera is inside the cone behind the apex, every
+//    triangle in the cluster faces away
+//
+// The size limits match common mesh shader limits, so the
+// same clusters would work for GPU culling later.
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+static const unsigned int MeshletMaxVertices = 64;
+static const unsigned int MeshletMaxTriangles = 124;
+
+struct Meshlet
+{
+	unsigned int firstIndex;
+	unsigned int triangleCount;
+	DirectX::XMFLOAT3 center;
+	float radius;
+	DirectX::XMFLOAT3 coneApex;
+	float coneCutoff;			// Sine of the cone's half angle - 1 when it can't be culled
+	DirectX::XMFLOAT3 coneAxis;
+	unsigned int vertexCount;	// Unique vertices used
+};
+
+// Reorders a triangle list so each meshlet is contiguous,
+// appending one Meshlet per cluster.  Meshlet firstIndex
+// values are offset by baseIndex.
+void BuildMeshlets(
+	unsigned int* indices,
+	unsigned int indexCount,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	std::vector<Meshlet>& meshlets,
+	unsigned int baseIndex = 0,
+	unsigned int maxVertices = MeshletMaxVertices,
+	unsigned int maxTriangles = MeshletMaxTriangles);
+
+// Clusters the full resolution level of an imported mesh,
+// filling mesh.meshlets
+void BuildMeshlets(ImportedMesh& mesh);
+
+// --------------------------------------------------------
+// CPU culling - drops clusters that are off screen or face
+// away from the camera, and copies what's left into one
+// compacted index buffer for a single DrawIndexed()
+// --------------------------------------------------------
+struct MeshletCullStats
+{
+	unsigned int meshletCount = 0;
+	unsigned int frustumCulled = 0;		// Meshlets entirely off screen
+	unsigned int backfaceCulled = 0;	// Meshlets entirely facing away
+	unsigned int triangleCount = 0;
+	unsigned int trianglesCulled = 0;
+	float culledTriangleRatio = 0.0f;	// trianglesCulled / triangleCount
+	double cullMs = 0.0;
+};
+
+// Returns the number of indices written to output, which
+// must have room for every meshlet's indices
+//
+// cameraPosition - World space, or null to skip back-face
+//                  culling (which needs a perspective view,
+//                  and is skipped for a mirroring world)
+unsigned int CullMeshlets(
+	const Meshlet* meshlets,
+	unsigned int meshletCount,
+	const void* indices,
+	unsigned int indexSize,
+	const DirectX::XMFLOAT4X4& world,
+	const DirectX::XMFLOAT4X4& viewProjection,
+	const DirectX::XMFLOAT3* cameraPosition,
+	void* output,
+	MeshletCullStats* stats = 0);
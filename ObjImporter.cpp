@@ -0,0 +1,823 @@
+#include "ObjImporter.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+using namespace DirectX;
+
+// Chunks are at least this big, so tiny files aren't split
+// into pieces too small to be worth a thread
+static const size_t MinChunkBytes = 1024 * 1024;
+
+// Marks a face corner with no uv or normal
+static const int MissingIndex = 0x7FFFFFFF;
+
+// What each of a corner's indices refers to, for errors
+static const char* const CornerIndexNames[3] = { "position", "uv", "normal" };
+
+typedef std::chrono::steady_clock ImportClock;
+
+static double MillisecondsSince(ImportClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(ImportClock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// One corner of a triangle, as indices into the position,
+// uv and normal lists.  Negative (relative) OBJ indices are
+// stored relative to the start of their chunk until every
+// chunk's counts are known - relativeMask says which.
+// --------------------------------------------------------
+struct ObjCorner
+{
+	int index[3];	// Position, uv, normal
+	unsigned char relativeMask;
+};
+
+// --------------------------------------------------------
+// Everything parsed from one chunk of the file
+// --------------------------------------------------------
+struct ObjChunk
+{
+	const char* begin;
+	const char* end;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT4> colors;	// Empty unless some "v" line in this chunk had a color
+	std::vector<XMFLOAT2> uvs;
+	std::vector<XMFLOAT3> normals;
+	std::vector<ObjCorner> corners;	// Three per triangle
+
+	// Where this chunk's lists start in the combined lists
+	unsigned int firstPosition;
+	unsigned int firstUV;
+	unsigned int firstNormal;
+	unsigned int firstCorner;
+};
+
+// --------------------------------------------------------
+// A corner after every chunk's lists have been combined:
+// absolute position, uv and normal indices
+// --------------------------------------------------------
+static const unsigned int MissingKey = 0xFFFFFFFF;
+
+struct ObjCornerKey
+{
+	unsigned int index[3];	// Position, uv, normal
+};
+
+// --------------------------------------------------------
+// Every chunk's lists, combined in file order
+// --------------------------------------------------------
+struct ObjAttributes
+{
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT4> colors;	// Empty if the file has no colors
+	std::vector<XMFLOAT2> uvs;
+	std::vector<XMFLOAT3> normals;
+
+	// Missing uvs and normals are zero, missing colors are white
+	Vertex BuildVertex(const ObjCornerKey& key) const
+	{
+		Vertex v = {};
+		v.Position = positions[key.index[0]];
+		v.Color = colors.empty() ? XMFLOAT4(1, 1, 1, 1) : colors[key.index[0]];
+		if (key.index[1] != MissingKey) v.UV = uvs[key.index[1]];
+		if (key.index[2] != MissingKey) v.Normal = normals[key.index[2]];
+		return v;
+	}
+};
+
+// --------------------------------------------------------
+// Runs work for each of count items, spread across the
+// job system's threads when there is one
+// --------------------------------------------------------
+static void ForEach(JobSystem* jobs, unsigned int count, const std::function<void(unsigned int)>& work)
+{
+	if (!jobs)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			work(i);
+		return;
+	}
+
+	jobs->ParallelFor(count, 1,
+		[&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+		{
+			for (unsigned int i = begin; i < end; i++)
+				work(i);
+		});
+}
+
+// --------------------------------------------------------
+// Bytes of memory held by a vector (its capacity, not size)
+// --------------------------------------------------------
+template<typename T>
+static unsigned long long Bytes(const std::vector<T>& v)
+{
+	return (unsigned long long)v.capacity() * sizeof(T);
+}
+
+
+// ----------------------------------------------------------------
+// Text parsing helpers - each advances the cursor past what it
+// read, and never reads past the end
+// ----------------------------------------------------------------
+static inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+static inline const char* SkipSpaces(const char* p, const char* end)
+{
+	while (p < end && IsSpace(*p))
+		p++;
+	return p;
+}
+
+static inline const char* SkipLine(const char* p, const char* end)
+{
+	while (p < end && *p != '\n')
+		p++;
+	return p < end ? p + 1 : end;
+}
+
+// Multiplies by 10^exponent, in steps small enough to stay exact
+static double ScaleByPowerOf10(double value, int exponent)
+{
+	static const double powers[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	while (exponent > 22) { value *= 1e22; exponent -= 22; }
+	while (exponent < -22) { value /= 1e22; exponent += 22; }
+	return exponent >= 0 ? value * powers[exponent] : value / powers[-exponent];
+}
+
+// --------------------------------------------------------
+// Reads a decimal float ("-1.5", "2", ".5e-3", etc.)
+//  - Much faster than strtof(), which handles locales,
+//    hex floats and other things OBJ files never contain
+//  - Digits past the 18th only affect the exponent, which
+//    is far beyond float precision anyway
+// Returns false (and leaves the cursor) if there's no number
+// --------------------------------------------------------
+static bool ParseFloat(const char*& cursor, const char* end, float& out)
+{
+	const char* p = SkipSpaces(cursor, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	bool anyDigits = false;
+
+	while (p < end && IsDigit(*p))
+	{
+		if (mantissa < 100000000000000000ull)
+			mantissa = mantissa * 10 + (*p - '0');
+		else
+			exponent++;
+		anyDigits = true;
+		p++;
+	}
+
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && IsDigit(*p))
+		{
+			if (mantissa < 100000000000000000ull)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+			}
+			anyDigits = true;
+			p++;
+		}
+	}
+
+	if (!anyDigits)
+		return false;
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+'))
+		{
+			negativeExponent = *e == '-';
+			e++;
+		}
+
+		// Only an exponent if there are digits after the 'e'
+		if (e < end && IsDigit(*e))
+		{
+			int value = 0;
+			while (e < end && IsDigit(*e))
+			{
+				if (value < 10000)
+					value = value * 10 + (*e - '0');
+				e++;
+			}
+			exponent += negativeExponent ? -value : value;
+			p = e;
+		}
+	}
+
+	double value = ScaleByPowerOf10((double)mantissa, exponent);
+	out = (float)(negative ? -value : value);
+	cursor = p;
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads a (possibly negative) integer
+// --------------------------------------------------------
+static bool ParseInt(const char*& cursor, const char* end, int& out)
+{
+	const char* p = cursor;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	if (p >= end || !IsDigit(*p))
+		return false;
+
+	long long value = 0;
+	while (p < end && IsDigit(*p))
+	{
+		if (value < 0x7FFFFFFF)
+			value = value * 10 + (*p - '0');
+		p++;
+	}
+
+	if (value > 0x7FFFFFFE)
+		value = 0x7FFFFFFE;
+
+	out = (int)(negative ? -value : value);
+	cursor = p;
+	return true;
+}
+
+// --------------------------------------------------------
+// Converts an OBJ index (1-based, or negative to count back
+// from the most recent element) into a 0-based index, and
+// returns whether it's chunk-relative
+// --------------------------------------------------------
+static inline bool ResolveIndex(int objIndex, unsigned int countSoFar, int& out)
+{
+	if (objIndex < 0)
+	{
+		// May end up negative here if it refers to an earlier
+		// chunk - it's fixed up once chunk offsets are known
+		out = (int)countSoFar + objIndex;
+		return true;
+	}
+
+	// 0 isn't a valid OBJ index, and comes out as -1, which
+	// is caught along with everything else out of range
+	out = objIndex - 1;
+	return false;
+}
+
+// --------------------------------------------------------
+// Reads one face corner ("v", "v/t", "v//n" or "v/t/n")
+// --------------------------------------------------------
+static bool ParseCorner(const char*& cursor, const char* end, const ObjChunk& chunk, ObjCorner& corner)
+{
+	const char* p = SkipSpaces(cursor, end);
+	int values[3] = { 0, 0, 0 };
+	bool present[3] = { true, false, false };
+
+	if (!ParseInt(p, end, values[0]))
+		return false;
+
+	if (p < end && *p == '/')
+	{
+		p++;
+		present[1] = ParseInt(p, end, values[1]);	// Empty for "v//n"
+		if (p < end && *p == '/')
+		{
+			p++;
+			present[2] = ParseInt(p, end, values[2]);
+		}
+	}
+
+	unsigned int countsSoFar[3] =
+	{
+		(unsigned int)chunk.positions.size(),
+		(unsigned int)chunk.uvs.size(),
+		(unsigned int)chunk.normals.size()
+	};
+
+	corner.relativeMask = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		if (!present[i])
+			corner.index[i] = MissingIndex;
+		else if (ResolveIndex(values[i], countsSoFar[i], corner.index[i]))
+			corner.relativeMask |= 1 << i;
+	}
+
+	// Skip anything unexpected up to the next corner
+	while (p < end && !IsSpace(*p) && *p != '\n')
+		p++;
+
+	cursor = p;
+	return true;
+}
+
+// --------------------------------------------------------
+// Parses every line in a chunk
+// --------------------------------------------------------
+static void ParseChunk(ObjChunk& chunk)
+{
+	const char* p = chunk.begin;
+	const char* end = chunk.end;
+
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		if (p >= end)
+			break;
+
+		const char* lineEnd = p;
+		while (lineEnd < end && *lineEnd != '\n')
+			lineEnd++;
+
+		if (p[0] == 'v' && p + 1 < lineEnd && IsSpace(p[1]))
+		{
+			// Position, optionally followed by a color
+			const char* c = p + 1;
+			XMFLOAT3 position(0, 0, 0);
+			ParseFloat(c, lineEnd, position.x);
+			ParseFloat(c, lineEnd, position.y);
+			ParseFloat(c, lineEnd, position.z);
+			chunk.positions.push_back(position);
+
+			XMFLOAT4 color(1, 1, 1, 1);
+			if (ParseFloat(c, lineEnd, color.x) &&
+				ParseFloat(c, lineEnd, color.y) &&
+				ParseFloat(c, lineEnd, color.z))
+			{
+				// First color in this chunk - earlier positions are white
+				if (chunk.colors.empty())
+					chunk.colors.resize(chunk.positions.size() - 1, XMFLOAT4(1, 1, 1, 1));
+				chunk.colors.push_back(color);
+			}
+			else if (!chunk.colors.empty())
+			{
+				chunk.colors.push_back(XMFLOAT4(1, 1, 1, 1));
+			}
+		}
+		else if (p[0] == 'v' && p + 2 < lineEnd && p[1] == 'n' && IsSpace(p[2]))
+		{
+			const char* c = p + 2;
+			XMFLOAT3 normal(0, 0, 0);
+			ParseFloat(c, lineEnd, normal.x);
+			ParseFloat(c, lineEnd, normal.y);
+			ParseFloat(c, lineEnd, normal.z);
+			chunk.normals.push_back(normal);
+		}
+		else if (p[0] == 'v' && p + 2 < lineEnd && p[1] == 't' && IsSpace(p[2]))
+		{
+			const char* c = p + 2;
+			XMFLOAT2 uv(0, 0);
+			ParseFloat(c, lineEnd, uv.x);
+			ParseFloat(c, lineEnd, uv.y);
+			chunk.uvs.push_back(uv);
+		}
+		else if (p[0] == 'f' && p + 1 < lineEnd && IsSpace(p[1]))
+		{
+			// Split polygons into a fan of triangles around the first corner
+			const char* c = p + 1;
+			ObjCorner first, previous, current;
+			unsigned int cornerCount = 0;
+			while (ParseCorner(c, lineEnd, chunk, current))
+			{
+				if (cornerCount == 0)
+					first = current;
+				else if (cornerCount >= 2)
+				{
+					chunk.corners.push_back(first);
+					chunk.corners.push_back(previous);
+					chunk.corners.push_back(current);
+				}
+
+				previous = current;
+				cornerCount++;
+			}
+		}
+
+		p = lineEnd < end ? lineEnd + 1 : end;
+	}
+}
+
+// --------------------------------------------------------
+// Describes a face that refers to something that isn't
+// there, by its line - only for errors, so it finds the
+// line by parsing the chunk's faces again, counting corners
+// the same way ParseChunk() does
+//
+// text      - The whole file, for counting lines before
+//             the chunk
+// chunk     - The chunk the face is in
+// corner    - Which of the chunk's corners is bad
+// attribute - 0, 1 or 2: its position, uv or normal
+// --------------------------------------------------------
+static std::string DescribeBadCorner(const char* text, const ObjChunk& chunk, unsigned int corner, int attribute)
+{
+	unsigned int line = 1 + (unsigned int)std::count(text, chunk.begin, '\n');
+	const char* p = chunk.begin;
+	const char* end = chunk.end;
+	unsigned int cornersSoFar = 0;
+
+	while (p < end)
+	{
+		const char* lineStart = p;
+		const char* lineEnd = p;
+		while (lineEnd < end && *lineEnd != '\n')
+			lineEnd++;
+
+		p = SkipSpaces(p, lineEnd);
+		if (p < lineEnd && p[0] == 'f' && p + 1 < lineEnd && IsSpace(p[1]))
+		{
+			const char* c = p + 1;
+			ObjCorner unused;
+			unsigned int faceCorners = 0;
+			while (ParseCorner(c, lineEnd, chunk, unused))
+				faceCorners++;
+
+			if (faceCorners >= 3)
+				cornersSoFar += (faceCorners - 2) * 3;
+			if (corner < cornersSoFar)
+			{
+				// Quoted without its line ending
+				const char* quoteEnd = lineEnd > lineStart && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+				char message[96];
+				snprintf(message, sizeof(message), "line %u: face refers to a %s that doesn't exist: ", line, CornerIndexNames[attribute]);
+				return message + std::string(lineStart, quoteEnd);
+			}
+		}
+
+		p = lineEnd < end ? lineEnd + 1 : end;
+		line++;
+	}
+
+	return "face refers to a vertex that doesn't exist";
+}
+
+// --------------------------------------------------------
+// Hash of a vertex's exact bits (FNV-1a over 32-bit words)
+// --------------------------------------------------------
+static inline unsigned int HashVertex(const Vertex& v)
+{
+	// Copied out rather than cast, which would break aliasing rules
+	unsigned int words[sizeof(Vertex) / 4];
+	memcpy(words, &v, sizeof(Vertex));
+
+	unsigned int hash = 2166136261u;
+	for (unsigned int i = 0; i < sizeof(Vertex) / 4; i++)
+	{
+		hash ^= words[i];
+		hash *= 16777619u;
+	}
+
+	// Mix the upper bits down, since the table uses the lower ones
+	return hash ^ (hash >> 15);
+}
+
+
+// --------------------------------------------------------
+// Reads a whole OBJ file and imports it
+//
+// path  - The .obj file
+// mesh  - Receives the geometry (replacing what's there)
+// jobs  - Threads to parse on, or null to do it all here
+// stats - Optional - receives timings and counts
+// --------------------------------------------------------
+bool ImportObj(
+	const std::string& path,
+	ImportedMesh& mesh,
+	JobSystem* jobs,
+	ObjImportStats* stats)
+{
+	ImportClock::time_point start = ImportClock::now();
+
+	FILE* file = 0;
+#ifdef _MSC_VER
+	if (fopen_s(&file, path.c_str(), "rb") != 0)
+		file = 0;
+#else
+	file = fopen(path.c_str(), "rb");
+#endif
+	if (!file)
+	{
+		if (stats)
+			stats->error = "couldn't open " + path;
+		return false;
+	}
+
+	// Read the whole thing at once
+	std::vector<char> text;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size > 0)
+	{
+		text.resize((size_t)size);
+		text.resize(fread(text.data(), 1, (size_t)size, file));
+	}
+	fclose(file);
+
+	double readMs = MillisecondsSince(start);
+	bool result = ImportObjFromMemory(text.data(), text.size(), mesh, jobs, stats);
+
+	if (stats)
+	{
+		// The file's contents were alive for the whole import
+		stats->readMs = readMs;
+		stats->peakMemoryBytes += Bytes(text);
+		stats->totalMs = MillisecondsSince(start);
+	}
+
+	return result;
+}
+
+// --------------------------------------------------------
+// Imports OBJ text that's already in memory
+//
+// text  - The file's contents (need not be null terminated)
+// size  - Bytes of text
+// mesh  - Receives the geometry (replacing what's there)
+// jobs  - Threads to parse on, or null to do it all here
+// stats - Optional - receives timings and counts
+// --------------------------------------------------------
+bool ImportObjFromMemory(
+	const char* text,
+	size_t size,
+	ImportedMesh& mesh,
+	JobSystem* jobs,
+	ObjImportStats* stats)
+{
+	ImportClock::time_point start = ImportClock::now();
+	unsigned long long peakBytes = 0;
+	if (stats)
+		stats->error.clear();
+
+	mesh.vertices.clear();
+	mesh.indices16.clear();
+	mesh.indices32.clear();
+	mesh.uses16BitIndices = false;
+
+	// Split into chunks at line boundaries - a few per thread,
+	// so threads that finish early can pick up more
+	unsigned int threadCount = jobs ? jobs->GetThreadCount() : 1;
+	size_t chunkBytes = size / (threadCount * 4) + 1;
+	if (chunkBytes < MinChunkBytes)
+		chunkBytes = MinChunkBytes;
+
+	std::vector<ObjChunk> chunks;
+	const char* end = text + size;
+	for (const char* p = text; p < end; )
+	{
+		ObjChunk chunk = {};
+		chunk.begin = p;
+		chunk.end = (size_t)(end - p) <= chunkBytes ? end : SkipLine(p + chunkBytes, end);
+		chunks.push_back(chunk);
+		p = chunk.end;
+	}
+
+	unsigned int chunkCount = (unsigned int)chunks.size();
+	ForEach(jobs, chunkCount, [&](unsigned int i) { ParseChunk(chunks[i]); });
+
+	// Now that every chunk's counts are known, work out
+	// where each one's data goes in the combined lists
+	unsigned int positionCount = 0, uvCount = 0, normalCount = 0, cornerCount = 0;
+	bool anyColors = false;
+	for (unsigned int i = 0; i < chunkCount; i++)
+	{
+		ObjChunk& chunk = chunks[i];
+		chunk.firstPosition = positionCount;
+		chunk.firstUV = uvCount;
+		chunk.firstNormal = normalCount;
+		chunk.firstCorner = cornerCount;
+
+		positionCount += (unsigned int)chunk.positions.size();
+		uvCount += (unsigned int)chunk.uvs.size();
+		normalCount += (unsigned int)chunk.normals.size();
+		cornerCount += (unsigned int)chunk.corners.size();
+		anyColors = anyColors || !chunk.colors.empty();
+
+		peakBytes += Bytes(chunk.positions) + Bytes(chunk.colors) + Bytes(chunk.uvs) + Bytes(chunk.normals) + Bytes(chunk.corners);
+	}
+
+	double parseMs = MillisecondsSince(start);
+	ImportClock::time_point weldStart = ImportClock::now();
+
+	// Combine every chunk's lists, and turn each corner into
+	// absolute indices (plus a hash of the vertex it makes),
+	// all in parallel - leaving only the welding itself to be
+	// done in order
+	ObjAttributes attributes;
+	attributes.positions.resize(positionCount);
+	attributes.uvs.resize(uvCount);
+	attributes.normals.resize(normalCount);
+	if (anyColors)
+		attributes.colors.resize(positionCount, XMFLOAT4(1, 1, 1, 1));
+
+	std::vector<ObjCornerKey> cornerKeys(cornerCount);
+	std::vector<unsigned int> cornerHashes(cornerCount);
+
+	// The first corner in each chunk that refers to something
+	// that isn't there, and which of its indices it was
+	std::vector<unsigned int> badCorners(chunkCount, MissingKey);
+	std::vector<int> badAttributes(chunkCount, 0);
+
+	ForEach(jobs, chunkCount, [&](unsigned int c)
+		{
+			const ObjChunk& chunk = chunks[c];
+			std::copy(chunk.positions.begin(), chunk.positions.end(), attributes.positions.begin() + chunk.firstPosition);
+			if (!chunk.colors.empty())
+				std::copy(chunk.colors.begin(), chunk.colors.end(), attributes.colors.begin() + chunk.firstPosition);
+			std::copy(chunk.uvs.begin(), chunk.uvs.end(), attributes.uvs.begin() + chunk.firstUV);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), attributes.normals.begin() + chunk.firstNormal);
+		});
+
+	ForEach(jobs, chunkCount, [&](unsigned int c)
+		{
+			const ObjChunk& chunk = chunks[c];
+			unsigned int firsts[3] = { chunk.firstPosition, chunk.firstUV, chunk.firstNormal };
+			unsigned int counts[3] = { positionCount, uvCount, normalCount };
+
+			for (unsigned int i = 0; i < chunk.corners.size(); i++)
+			{
+				const ObjCorner& corner = chunk.corners[i];
+				ObjCornerKey key;
+				bool bad = false;
+				for (int k = 0; k < 3; k++)
+				{
+					int index = corner.index[k];
+					if (index == MissingIndex)
+					{
+						key.index[k] = MissingKey;
+						continue;
+					}
+
+					if (corner.relativeMask & (1 << k))
+						index += (int)firsts[k];
+
+					if (index >= 0 && (unsigned int)index < counts[k])
+						key.index[k] = (unsigned int)index;
+					else if (!bad)
+					{
+						bad = true;
+						if (badCorners[c] == MissingKey)
+						{
+							badCorners[c] = i;
+							badAttributes[c] = k;
+						}
+					}
+				}
+
+				// The import fails, so this is never used
+				if (bad)
+					continue;
+
+				unsigned int out = chunk.firstCorner + i;
+				cornerKeys[out] = key;
+				cornerHashes[out] = HashVertex(attributes.BuildVertex(key));
+			}
+		});
+
+	// Only the first bad face is reported
+	for (unsigned int c = 0; c < chunkCount; c++)
+	{
+		if (badCorners[c] != MissingKey)
+		{
+			if (stats)
+				stats->error = DescribeBadCorner(text, chunks[c], badCorners[c], badAttributes[c]);
+			return false;
+		}
+	}
+
+	// Parsed lists aren't needed anymore
+	peakBytes += Bytes(attributes.positions) + Bytes(attributes.colors) + Bytes(attributes.uvs) + Bytes(attributes.normals);
+	peakBytes += Bytes(cornerKeys) + Bytes(cornerHashes);
+	std::vector<ObjChunk>().swap(chunks);
+
+	// Weld with an open-addressed hash table of vertex indices,
+	// sized for (and grown to keep) at most half full
+	static const unsigned int EmptySlot = 0xFFFFFFFF;
+	unsigned int tableSize = 1024;
+	while (tableSize < positionCount * 2)
+		tableSize *= 2;
+
+	std::vector<unsigned int> table(tableSize, EmptySlot);
+	std::vector<unsigned int> vertexHashes;
+	std::vector<unsigned int> indices(cornerCount);
+	mesh.vertices.reserve(positionCount);
+	vertexHashes.reserve(positionCount);
+
+	for (unsigned int i = 0; i < cornerCount; i++)
+	{
+		Vertex v = attributes.BuildVertex(cornerKeys[i]);
+		unsigned int hash = cornerHashes[i];
+		unsigned int mask = tableSize - 1;
+		unsigned int slot = hash & mask;
+
+		while (table[slot] != EmptySlot)
+		{
+			unsigned int existing = table[slot];
+			if (vertexHashes[existing] == hash && memcmp(&mesh.vertices[existing], &v, sizeof(Vertex)) == 0)
+				break;
+			slot = (slot + 1) & mask;
+		}
+
+		if (table[slot] == EmptySlot)
+		{
+			table[slot] = (unsigned int)mesh.vertices.size();
+			mesh.vertices.push_back(v);
+			vertexHashes.push_back(hash);
+
+			// Getting full - double the table and re-insert everything
+			if (mesh.vertices.size() * 2 > tableSize)
+			{
+				tableSize *= 2;
+				mask = tableSize - 1;
+				table.assign(tableSize, EmptySlot);
+				for (unsigned int k = 0; k < vertexHashes.size(); k++)
+				{
+					unsigned int s = vertexHashes[k] & mask;
+					while (table[s] != EmptySlot)
+						s = (s + 1) & mask;
+					table[s] = k;
+				}
+			}
+
+			indices[i] = (unsigned int)mesh.vertices.size() - 1;
+		}
+		else
+		{
+			indices[i] = table[slot];
+		}
+	}
+
+	unsigned long long weldBytes =
+		Bytes(attributes.positions) + Bytes(attributes.colors) + Bytes(attributes.uvs) + Bytes(attributes.normals) +
+		Bytes(cornerKeys) + Bytes(cornerHashes) +
+		Bytes(table) + Bytes(vertexHashes) + Bytes(indices) + Bytes(mesh.vertices);
+	if (weldBytes > peakBytes)
+		peakBytes = weldBytes;
+
+	attributes = ObjAttributes();
+	std::vector<ObjCornerKey>().swap(cornerKeys);
+	std::vector<unsigned int>().swap(cornerHashes);
+	std::vector<unsigned int>().swap(table);
+	std::vector<unsigned int>().swap(vertexHashes);
+
+	// 16-bit indices when every vertex is reachable with one
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+	if (vertexCount <= 0x10000)
+	{
+		mesh.uses16BitIndices = true;
+		mesh.indices16.resize(cornerCount);
+		for (unsigned int i = 0; i < cornerCount; i++)
+			mesh.indices16[i] = (unsigned short)indices[i];
+	}
+	else
+	{
+		mesh.indices32.swap(indices);
+	}
+
+	if (stats)
+	{
+		stats->readMs = 0.0;
+		stats->parseMs = parseMs;
+		stats->weldMs = MillisecondsSince(weldStart);
+		stats->totalMs = MillisecondsSince(start);
+		stats->fileBytes = size;
+		stats->peakMemoryBytes = peakBytes;
+		stats->chunkCount = chunkCount;
+		stats->positionCount = positionCount;
+		stats->normalCount = normalCount;
+		stats->uvCount = uvCount;
+		stats->triangleCount = cornerCount / 3;
+		stats->vertexCount = vertexCount;
+	}
+
+	return true;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+#include "Vertex.h"
+
+class JobSystem;
+
+// --------------------------------------------------------
+// Geometry produced by the importer - unique vertices and
+// triangle list indices.  Only one of the index lists is
+// filled: 16-bit when every vertex fits, otherwise 32-bit.
+//
+// Once simplified (see BuildLodChain()), the indices hold
+// every level of detail one after another, and lods says
+// where each one is.  Otherwise lods is empty.
+//
+// Once clustered (see BuildMeshlets()), meshlets split up
+// the finest level for culling.
+// --------------------------------------------------------
+struct ImportedMesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned short> indices16;
+	std::vector<unsigned int> indices32;
+	bool uses16BitIndices = false;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+};
+
+// --------------------------------------------------------
+// What an import found, and what it cost
+// --------------------------------------------------------
+struct ObjImportStats
+{
+	// Timing of each stage, in milliseconds
+	double readMs = 0.0;	// Reading the file into memory
+	double parseMs = 0.0;	// Parsing text into positions, normals, etc.
+	double weldMs = 0.0;	// Combining those into unique vertices and indices
+	double totalMs = 0.0;
+
+	// Memory held by the importer's buffers (including the
+	// output while it's being built) at their largest
+	unsigned long long fileBytes = 0;
+	unsigned long long peakMemoryBytes = 0;
+
+	unsigned int chunkCount = 0;	// Pieces the text was split into for parsing
+	unsigned int positionCount = 0;
+	unsigned int normalCount = 0;
+	unsigned int uvCount = 0;
+	unsigned int triangleCount = 0;	// After splitting polygons into triangles
+	unsigned int vertexCount = 0;	// After welding
+
+	// Why the import failed, if it did - bad faces name
+	// their line, like "line 12: ..."
+	std::string error;
+};
+
+// --------------------------------------------------------
+// Wavefront OBJ import.
+//
+// The text is split into chunks at line boundaries, and
+// chunks are parsed in parallel (when given a job system).
+// Polygons are split into triangle fans, and identical
+// position/normal/uv/color combinations are welded into
+// a single vertex.  Supports "v x y z [r g b]", "vn", "vt"
+// and "f" with any of the v, v/t, v//n or v/t/n forms
+// (including negative, relative indices); everything else
+// (materials, groups, etc.) is skipped.  A face index of 0,
+// or one past what the file defines, fails the import.
+//
+// This has no Direct3D dependencies at all.
+// --------------------------------------------------------
+bool ImportObj(
+	const std::string& path,
+	ImportedMesh& mesh,
+	JobSystem* jobs = 0,
+	ObjImportStats* stats = 0);
+
+bool ImportObjFromMemory(
+	const char* text,
+	size_t size,
+	ImportedMesh& mesh,
+	JobSystem* jobs = 0,
+	ObjImportStats* stats = 0);
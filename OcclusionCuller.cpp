@@ -0,0 +1,642 @@
+#include "OcclusionCuller.h"
+#include "CpuFeatures.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+
+#if CPU_X86
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+
+typedef std::chrono::steady_clock OcclusionClock;
+
+// Depth blocks are square, and tiles are whole blocks wide
+// and tall (which also keeps four-pixel groups in a tile)
+static const unsigned int BlockSize = 8;
+static const unsigned int TileWidth = 64;
+static const unsigned int TileHeight = 32;
+
+// Objects per job system chunk when testing
+static const unsigned int TestChunkSize = 1024;
+
+// Triangles are clipped to this many pixels past the edges,
+// so huge triangles near the camera can't overflow
+static const float GuardBand = 8192.0f;
+
+// Clipping a triangle against the near plane and the four
+// guard band edges adds at most one corner per plane, and
+// the result is drawn as a fan
+static const unsigned int MaxClippedCorners = 8;
+static const unsigned int MaxClippedTriangles = MaxClippedCorners - 2;
+
+// --------------------------------------------------------
+// Clips a convex clip space polygon to one plane, keeping
+// the side where a * x + b * y + c * z + d * w >= 0.
+// Returns the number of corners left.
+//
+// in      - The polygon's corners, in order
+// inCount - How many there are
+// plane   - The plane's a, b, c, d
+// out     - Room for inCount + 1 corners
+// --------------------------------------------------------
+static unsigned int ClipPolygon(const XMFLOAT4* in, unsigned int inCount, const XMFLOAT4& plane, XMFLOAT4* out)
+{
+	unsigned int outCount = 0;
+	for (unsigned int i = 0; i < inCount; i++)
+	{
+		const XMFLOAT4& a = in[i];
+		const XMFLOAT4& b = in[(i + 1) % inCount];
+		float da = plane.x * a.x + plane.y * a.y + plane.z * a.z + plane.w * a.w;
+		float db = plane.x * b.x + plane.y * b.y + plane.z * b.z + plane.w * b.w;
+		if (da >= 0.0f)
+			out[outCount++] = a;
+
+		if ((da >= 0.0f) != (db >= 0.0f))
+		{
+			float s = da / (da - db);
+			out[outCount++] = XMFLOAT4(
+				a.x + (b.x - a.x) * s,
+				a.y + (b.y - a.y) * s,
+				a.z + (b.z - a.z) * s,
+				a.w + (b.w - a.w) * s);
+		}
+	}
+
+	return outCount;
+}
+
+// --------------------------------------------------------
+// The fastest path this CPU can run
+// --------------------------------------------------------
+static OcclusionRasterPath GetBestOcclusionRasterPath()
+{
+#if CPU_X86
+	// SSE2 is part of every x64 CPU (and on by default for Win32 builds)
+	return OcclusionRasterSSE2;
+#else
+	return OcclusionRasterScalar;
+#endif
+}
+
+static OcclusionRasterPath activePath = GetBestOcclusionRasterPath();
+
+// --------------------------------------------------------
+// Which path Render() is using
+// --------------------------------------------------------
+OcclusionRasterPath GetOcclusionRasterPath()
+{
+	return activePath;
+}
+
+// --------------------------------------------------------
+// Forces a particular path, as long as this CPU supports
+// it, and returns the path actually being used afterwards
+// --------------------------------------------------------
+OcclusionRasterPath SetOcclusionRasterPath(OcclusionRasterPath path)
+{
+	OcclusionRasterPath best = GetBestOcclusionRasterPath();
+	activePath = path > best ? best : path;
+	return activePath;
+}
+
+
+// --------------------------------------------------------
+// Constructor - A quarter of 1920x1080 to start with
+// --------------------------------------------------------
+OcclusionCuller::OcclusionCuller()
+	:
+	width(0),
+	height(0),
+	tilesX(0),
+	tilesY(0),
+	blocksX(0),
+	blocksY(0)
+{
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+	SetResolution(480, 270);
+}
+
+unsigned int OcclusionCuller::GetWidth() const { return width; }
+unsigned int OcclusionCuller::GetHeight() const { return height; }
+const float* OcclusionCuller::GetDepth() const { return depth.data(); }
+const OcclusionStats& OcclusionCuller::GetStats() const { return stats; }
+
+// --------------------------------------------------------
+// Sizes the depth buffer - both sizes are rounded up to a
+// whole number of depth blocks
+// --------------------------------------------------------
+void OcclusionCuller::SetResolution(unsigned int width, unsigned int height)
+{
+	this->width = std::max((width + BlockSize - 1) / BlockSize, 1u) * BlockSize;
+	this->height = std::max((height + BlockSize - 1) / BlockSize, 1u) * BlockSize;
+	tilesX = (this->width + TileWidth - 1) / TileWidth;
+	tilesY = (this->height + TileHeight - 1) / TileHeight;
+	blocksX = this->width / BlockSize;
+	blocksY = this->height / BlockSize;
+
+	// Nothing drawn yet, so everything's as far as can be
+	depth.assign((size_t)this->width * this->height, 1.0f);
+	blockDepth.assign((size_t)blocksX * blocksY, 1.0f);
+	tileBins.resize((size_t)tilesX * tilesY);
+}
+
+// --------------------------------------------------------
+// Starts a new frame's occluders, seen through this camera
+// --------------------------------------------------------
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	occluders.clear();
+	stats = OcclusionStats();
+}
+
+// --------------------------------------------------------
+// Adds a mesh to draw into the depth buffer.  The data
+// isn't copied, so it must stay valid until Render().
+//
+// positions   - Vertex positions, in the mesh's space
+// vertexCount - Number of positions
+// indices     - Triangle list indices into positions
+// indexCount  - Number of indices
+// world       - The mesh's world matrix
+// --------------------------------------------------------
+void OcclusionCuller::AddOccluder(
+	const XMFLOAT3* positions,
+	unsigned int vertexCount,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	const XMFLOAT4X4& world)
+{
+	Occluder occluder;
+	occluder.positions = positions;
+	occluder.vertexCount = vertexCount;
+	occluder.indices = indices;
+	occluder.indexCount = indexCount - indexCount % 3;
+	occluder.world = world;
+	occluder.firstVertex = occluders.empty() ? 0 : occluders.back().firstVertex + occluders.back().vertexCount;
+	occluder.firstTriangle = occluders.empty() ? 0 : occluders.back().firstTriangle + occluders.back().indexCount / 3 * MaxClippedTriangles;
+	occluders.push_back(occluder);
+
+	stats.occluderCount++;
+	stats.triangleCount += occluder.indexCount / 3;
+}
+
+// --------------------------------------------------------
+// Draws every occluder added since BeginFrame()
+//
+// jobs - Optional, to set up occluders and draw tiles
+//        across threads
+// --------------------------------------------------------
+void OcclusionCuller::Render(JobSystem* jobs)
+{
+	OcclusionClock::time_point start = OcclusionClock::now();
+
+	// Each occluder has its own range of vertices and triangles,
+	// so they can be set up in any order
+	unsigned int vertexCount = 0;
+	unsigned int triangleSlots = 0;
+	if (!occluders.empty())
+	{
+		vertexCount = occluders.back().firstVertex + occluders.back().vertexCount;
+		triangleSlots = occluders.back().firstTriangle + occluders.back().indexCount / 3 * MaxClippedTriangles;
+	}
+	clipVertices.resize(vertexCount);
+	triangles.resize(triangleSlots);
+
+	if (jobs && occluders.size() > 1)
+	{
+		jobs->ParallelFor((unsigned int)occluders.size(), 1,
+			[&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+			{
+				for (unsigned int i = begin; i < end; i++)
+					SetupOccluder(i);
+			});
+	}
+	else
+	{
+		for (unsigned int i = 0; i < occluders.size(); i++)
+			SetupOccluder(i);
+	}
+
+	// Each triangle goes in the bin of every tile its box touches
+	for (unsigned int i = 0; i < tileBins.size(); i++)
+		tileBins[i].clear();
+
+	for (unsigned int i = 0; i < triangles.size(); i++)
+	{
+		const ScreenTriangle& t = triangles[i];
+		if (t.minX > t.maxX || t.minY > t.maxY)
+			continue;
+
+		stats.binnedTriangles++;
+		for (unsigned int ty = t.minY / TileHeight; ty <= t.maxY / TileHeight; ty++)
+			for (unsigned int tx = t.minX / TileWidth; tx <= t.maxX / TileWidth; tx++)
+				tileBins[ty * tilesX + tx].push_back(i);
+	}
+
+	OcclusionClock::time_point setupEnd = OcclusionClock::now();
+	stats.setupMs = std::chrono::duration<double, std::milli>(setupEnd - start).count();
+
+	unsigned int tileCount = tilesX * tilesY;
+	if (jobs)
+	{
+		jobs->ParallelFor(tileCount, 1,
+			[&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+			{
+				for (unsigned int i = begin; i < end; i++)
+					RasterizeTile(i);
+			});
+	}
+	else
+	{
+		for (unsigned int i = 0; i < tileCount; i++)
+			RasterizeTile(i);
+	}
+
+	stats.rasterMs = std::chrono::duration<double, std::milli>(OcclusionClock::now() - setupEnd).count();
+}
+
+// --------------------------------------------------------
+// Moves one occluder's vertices to clip space, then clips
+// its triangles against the near plane and the guard band
+// and sets them up
+// --------------------------------------------------------
+void OcclusionCuller::SetupOccluder(unsigned int occluder)
+{
+	const Occluder& o = occluders[occluder];
+
+	XMMATRIX worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&o.world), XMLoadFloat4x4(&viewProjection));
+	XMFLOAT4* clip = clipVertices.data() + o.firstVertex;
+	for (unsigned int i = 0; i < o.vertexCount; i++)
+		XMStoreFloat4(&clip[i], XMVector3Transform(XMLoadFloat3(&o.positions[i]), worldViewProjection));
+
+	// z >= 0, then -gx * w <= x <= gx * w and the same for y,
+	// with gx and gy where the guard band ends in NDC
+	float guardX = 1.0f + 2.0f * GuardBand / width;
+	float guardY = 1.0f + 2.0f * GuardBand / height;
+	const XMFLOAT4 planes[5] = {
+		XMFLOAT4(0.0f, 0.0f, 1.0f, 0.0f),
+		XMFLOAT4(1.0f, 0.0f, 0.0f, guardX),
+		XMFLOAT4(-1.0f, 0.0f, 0.0f, guardX),
+		XMFLOAT4(0.0f, 1.0f, 0.0f, guardY),
+		XMFLOAT4(0.0f, -1.0f, 0.0f, guardY) };
+
+	ScreenTriangle* slots = triangles.data() + o.firstTriangle;
+	for (unsigned int t = 0; t < o.indexCount / 3; t++)
+	{
+		ScreenTriangle* fan = slots + t * MaxClippedTriangles;
+		for (unsigned int i = 0; i < MaxClippedTriangles; i++)
+		{
+			fan[i].minX = 1;
+			fan[i].maxX = 0;
+		}
+
+		// Sutherland-Hodgman, one plane at a time - most triangles
+		// are inside every plane and skip straight to setup
+		XMFLOAT4 polygons[2][MaxClippedCorners];
+		polygons[0][0] = clip[o.indices[t * 3 + 0]];
+		polygons[0][1] = clip[o.indices[t * 3 + 1]];
+		polygons[0][2] = clip[o.indices[t * 3 + 2]];
+		unsigned int polygonCount = 3;
+		unsigned int current = 0;
+		for (unsigned int p = 0; p < 5 && polygonCount >= 3; p++)
+		{
+			const XMFLOAT4& plane = planes[p];
+			bool inside = true;
+			for (unsigned int i = 0; i < polygonCount && inside; i++)
+			{
+				const XMFLOAT4& c = polygons[current][i];
+				inside = plane.x * c.x + plane.y * c.y + plane.z * c.z + plane.w * c.w >= 0.0f;
+			}
+
+			if (inside)
+				continue;
+
+			polygonCount = ClipPolygon(polygons[current], polygonCount, plane, polygons[1 - current]);
+			current = 1 - current;
+		}
+
+		for (unsigned int i = 2; i < polygonCount; i++)
+		{
+			const XMFLOAT4 corners[3] = { polygons[current][0], polygons[current][i - 1], polygons[current][i] };
+			AddTriangle(corners, fan[i - 2]);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Turns three clip space corners into edge functions, a
+// depth plane and a pixel box, or leaves the triangle empty
+// if it's degenerate or off screen
+// --------------------------------------------------------
+void OcclusionCuller::AddTriangle(const XMFLOAT4* clip, ScreenTriangle& triangle) const
+{
+	float x[3], y[3], z[3];
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		if (clip[i].w <= 0.0f)
+			return;
+
+		float inverseW = 1.0f / clip[i].w;
+		x[i] = (clip[i].x * inverseW * 0.5f + 0.5f) * width;
+		y[i] = (0.5f - clip[i].y * inverseW * 0.5f) * height;
+		z[i] = clip[i].z * inverseW;
+	}
+
+	float minX = std::min(std::min(x[0], x[1]), x[2]);
+	float maxX = std::max(std::max(x[0], x[1]), x[2]);
+	float minY = std::min(std::min(y[0], y[1]), y[2]);
+	float maxY = std::max(std::max(y[0], y[1]), y[2]);
+
+	// Only pixels whose centers could be inside
+	triangle.minX = std::max((int)floorf(minX), 0);
+	triangle.maxX = std::min((int)floorf(maxX), (int)width - 1);
+	triangle.minY = std::max((int)floorf(minY), 0);
+	triangle.maxY = std::min((int)floorf(maxY), (int)height - 1);
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	// Edge i runs from corner i to the next, and is zero there
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		unsigned int j = (i + 1) % 3;
+		triangle.edgeA[i] = y[i] - y[j];
+		triangle.edgeB[i] = x[j] - x[i];
+		triangle.edgeC[i] = x[i] * y[j] - y[i] * x[j];
+	}
+
+	// Twice the area - flipped triangles get flipped edges, so
+	// inside is always positive (occluders have no back faces)
+	float area = triangle.edgeA[0] * x[2] + triangle.edgeB[0] * y[2] + triangle.edgeC[0];
+	if (fabsf(area) < 1e-6f)
+	{
+		triangle.minX = 1;
+		triangle.maxX = 0;
+		return;
+	}
+
+	float sign = area < 0.0f ? -1.0f : 1.0f;
+	float inverseArea = 1.0f / fabsf(area);
+
+	// Each edge's value is the weight of the corner across from it
+	triangle.depthA = 0.0f;
+	triangle.depthB = 0.0f;
+	triangle.depthC = 0.0f;
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		triangle.edgeA[i] *= sign;
+		triangle.edgeB[i] *= sign;
+		triangle.edgeC[i] *= sign;
+
+		float opposite = z[(i + 2) % 3] * inverseArea;
+		triangle.depthA += triangle.edgeA[i] * opposite;
+		triangle.depthB += triangle.edgeB[i] * opposite;
+		triangle.depthC += triangle.edgeC[i] * opposite;
+	}
+
+	// Evaluate at pixel centers from whole pixel coordinates
+	for (unsigned int i = 0; i < 3; i++)
+		triangle.edgeC[i] += (triangle.edgeA[i] + triangle.edgeB[i]) * 0.5f;
+	triangle.depthC += (triangle.depthA + triangle.depthB) * 0.5f;
+}
+
+// --------------------------------------------------------
+// Clears one tile, draws every triangle in its bin, then
+// works out its blocks' farthest depths
+// --------------------------------------------------------
+void OcclusionCuller::RasterizeTile(unsigned int tile)
+{
+	int tileX0 = (int)((tile % tilesX) * TileWidth);
+	int tileY0 = (int)((tile / tilesX) * TileHeight);
+	int tileX1 = std::min(tileX0 + (int)TileWidth, (int)width);
+	int tileY1 = std::min(tileY0 + (int)TileHeight, (int)height);
+
+	for (int y = tileY0; y < tileY1; y++)
+		std::fill(depth.begin() + (size_t)y * width + tileX0, depth.begin() + (size_t)y * width + tileX1, 1.0f);
+
+	const std::vector<unsigned int>& bin = tileBins[tile];
+	for (unsigned int b = 0; b < bin.size(); b++)
+	{
+		const ScreenTriangle& t = triangles[bin[b]];
+		int x0 = std::max(t.minX, tileX0);
+		int x1 = std::min(t.maxX, tileX1 - 1);
+		int y0 = std::max(t.minY, tileY0);
+		int y1 = std::min(t.maxY, tileY1 - 1);
+
+#if CPU_X86
+		if (activePath == OcclusionRasterSSE2)
+		{
+			// Four pixels at a time, starting on a multiple of four
+			// (tiles are whole blocks, so this stays in the tile)
+			x0 &= ~3;
+			__m128 xs = _mm_add_ps(_mm_set1_ps((float)x0), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+			__m128 zero = _mm_setzero_ps();
+
+			__m128 a0 = _mm_set1_ps(t.edgeA[0]);
+			__m128 a1 = _mm_set1_ps(t.edgeA[1]);
+			__m128 a2 = _mm_set1_ps(t.edgeA[2]);
+			__m128 depthA = _mm_set1_ps(t.depthA);
+			__m128 four = _mm_set1_ps(4.0f);
+
+			// Edges and depth are evaluated afresh for each group
+			// (rather than stepped) so long spans don't drift, and
+			// so the results match the scalar path exactly
+			for (int y = y0; y <= y1; y++)
+			{
+				float fy = (float)y;
+				__m128 c0 = _mm_set1_ps(t.edgeB[0] * fy + t.edgeC[0]);
+				__m128 c1 = _mm_set1_ps(t.edgeB[1] * fy + t.edgeC[1]);
+				__m128 c2 = _mm_set1_ps(t.edgeB[2] * fy + t.edgeC[2]);
+				__m128 depthC = _mm_set1_ps(t.depthB * fy + t.depthC);
+
+				float* row = depth.data() + (size_t)y * width;
+				__m128 px = xs;
+				for (int x = x0; x <= x1; x += 4, px = _mm_add_ps(px, four))
+				{
+					__m128 inside = _mm_and_ps(_mm_and_ps(
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), c0), zero),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), c1), zero)),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), c2), zero));
+
+					if (_mm_movemask_ps(inside))
+					{
+						__m128 z = _mm_add_ps(_mm_mul_ps(depthA, px), depthC);
+						__m128 old = _mm_loadu_ps(row + x);
+						__m128 nearer = _mm_min_ps(old, z);
+						_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+					}
+				}
+			}
+			continue;
+		}
+#endif
+
+		// Scalar reference path - one pixel at a time
+		for (int y = y0; y <= y1; y++)
+		{
+			float fy = (float)y;
+			float c0 = t.edgeB[0] * fy + t.edgeC[0];
+			float c1 = t.edgeB[1] * fy + t.edgeC[1];
+			float c2 = t.edgeB[2] * fy + t.edgeC[2];
+			float depthC = t.depthB * fy + t.depthC;
+
+			float* row = depth.data() + (size_t)y * width;
+			for (int x = x0; x <= x1; x++)
+			{
+				float fx = (float)x;
+				if (t.edgeA[0] * fx + c0 >= 0.0f &&
+					t.edgeA[1] * fx + c1 >= 0.0f &&
+					t.edgeA[2] * fx + c2 >= 0.0f)
+				{
+					row[x] = std::min(row[x], t.depthA * fx + depthC);
+				}
+			}
+		}
+	}
+
+	// Farthest depth in each of the tile's blocks
+	for (int by = tileY0 / BlockSize; by < tileY1 / (int)BlockSize; by++)
+	{
+		for (int bx = tileX0 / BlockSize; bx < tileX1 / (int)BlockSize; bx++)
+		{
+			float farthest = 0.0f;
+			for (unsigned int y = 0; y < BlockSize; y++)
+			{
+				const float* row = depth.data() + (size_t)(by * BlockSize + y) * width + bx * BlockSize;
+				for (unsigned int x = 0; x < BlockSize; x++)
+					farthest = std::max(farthest, row[x]);
+			}
+			blockDepth[by * blocksX + bx] = farthest;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Whether any of a world space box could be seen past the
+// occluders drawn by the last Render()
+// --------------------------------------------------------
+bool OcclusionCuller::IsBoxVisible(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax) const
+{
+	XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+
+	// Screen rectangle and nearest depth of the box's corners
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearest = FLT_MAX;
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		XMVECTOR corner = XMVectorSet(
+			(i & 1) ? boxMax.x : boxMin.x,
+			(i & 2) ? boxMax.y : boxMin.y,
+			(i & 4) ? boxMax.z : boxMin.z,
+			1.0f);
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(corner, matrix));
+
+		// Crossing the near plane - can't tell, so it's visible
+		if (clip.w <= 0.0f || clip.z < 0.0f)
+			return true;
+
+		float inverseW = 1.0f / clip.w;
+		float x = (clip.x * inverseW * 0.5f + 0.5f) * width;
+		float y = (0.5f - clip.y * inverseW * 0.5f) * height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z * inverseW);
+	}
+
+	// Off screen entirely is the frustum culler's call
+	if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+		return true;
+
+	// Every pixel the rectangle touches, even partly
+	int x0 = std::max((int)floorf(minX), 0);
+	int x1 = std::min((int)floorf(maxX), (int)width - 1);
+	int y0 = std::max((int)floorf(minY), 0);
+	int y1 = std::min((int)floorf(maxY), (int)height - 1);
+
+	// Blocks that are all nearer than the box hide their part
+	// of it outright, and only the rest need a closer look
+	for (int by = y0 / (int)BlockSize; by <= y1 / (int)BlockSize; by++)
+	{
+		for (int bx = x0 / (int)BlockSize; bx <= x1 / (int)BlockSize; bx++)
+		{
+			if (blockDepth[by * blocksX + bx] < nearest)
+				continue;
+
+			int py1 = std::min(y1, by * (int)BlockSize + (int)BlockSize - 1);
+			int px1 = std::min(x1, bx * (int)BlockSize + (int)BlockSize - 1);
+			for (int y = std::max(y0, by * (int)BlockSize); y <= py1; y++)
+			{
+				const float* row = depth.data() + (size_t)y * width;
+				for (int x = std::max(x0, bx * (int)BlockSize); x <= px1; x++)
+				{
+					if (row[x] >= nearest)
+						return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+// --------------------------------------------------------
+// Removes the hidden objects from a list, keeping the rest
+// in order.  Returns how many are left.
+//
+// boxMins  - Each object's world space box minimum
+// boxMaxs  - Each object's world space box maximum
+// objects  - Indices into the boxes, of the objects to test
+// jobs     - Optional, to split the work across threads
+// --------------------------------------------------------
+unsigned int OcclusionCuller::Cull(
+	const XMFLOAT3* boxMins,
+	const XMFLOAT3* boxMaxs,
+	std::vector<unsigned int>& objects,
+	JobSystem* jobs)
+{
+	OcclusionClock::time_point start = OcclusionClock::now();
+
+	unsigned int count = (unsigned int)objects.size();
+	stats.testedCount = count;
+	stats.occludedCount = 0;
+
+	// Nothing drawn, so nothing's hidden
+	if (stats.binnedTriangles == 0)
+	{
+		stats.testMs = 0.0;
+		return count;
+	}
+
+	objectVisible.resize(count);
+	auto testRange = [&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+	{
+		for (unsigned int i = begin; i < end; i++)
+			objectVisible[i] = IsBoxVisible(boxMins[objects[i]], boxMaxs[objects[i]]) ? 1 : 0;
+	};
+
+	if (jobs && count > TestChunkSize)
+		jobs->ParallelFor(count, TestChunkSize, testRange);
+	else
+		testRange(0, count, 0);
+
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		objects[kept] = objects[i];
+		kept += objectVisible[i];
+	}
+	objects.resize(kept);
+
+	stats.occludedCount = count - kept;
+	stats.testMs = std::chrono::duration<double, std::milli>(OcclusionClock::now() - start).count();
+	return kept;
+}
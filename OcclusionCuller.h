@@ -0,0 +1,131 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+class JobSystem;
+
+// --------------------------------------------------------
+// Occlusion culling on the CPU, against a small depth buffer.
+//
+// A few big, simple occluders (walls, buildings, terrain)
+// are rasterized into a low resolution depth buffer, keeping
+// the nearest depth per pixel.  Objects are then tested by
+// projecting their boxes to a screen rectangle and their
+// nearest depth - if every pixel under the rectangle already
+// has something nearer, the object is hidden.
+//
+// The depth buffer is split into tiles, which are rasterized
+// in parallel: triangles are set up once, sorted into bins
+// for the tiles they touch, and each tile only draws its own
+// bin.  Pixels are filled four at a time (SSE2), and each
+// 8x8 block also keeps its farthest depth, so most objects
+// are decided by a handful of block tests.
+//
+// Occluders have to be inside what they stand for, or they
+// will hide things that should show.  Object tests are
+// conservative otherwise - anything crossing the near plane
+// or off screen counts as visible.
+//
+// Depth is Direct3D's 0 (near) to 1 (far).
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+enum OcclusionRasterPath
+{
+	OcclusionRasterScalar,
+	OcclusionRasterSSE2
+};
+
+OcclusionRasterPath GetOcclusionRasterPath();
+OcclusionRasterPath SetOcclusionRasterPath(OcclusionRasterPath path);
+
+struct OcclusionStats
+{
+	unsigned int occluderCount = 0;
+	unsigned int triangleCount = 0;		// Occluder triangles submitted
+	unsigned int binnedTriangles = 0;	// On screen after clipping
+	unsigned int testedCount = 0;
+	unsigned int occludedCount = 0;
+	double setupMs = 0.0;				// Transform, clip, set up and bin
+	double rasterMs = 0.0;				// Tiles and their depth blocks
+	double testMs = 0.0;
+};
+
+class OcclusionCuller
+{
+public:
+	OcclusionCuller();
+
+	void SetResolution(unsigned int width, unsigned int height);
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProjection);
+	void AddOccluder(
+		const DirectX::XMFLOAT3* positions,
+		unsigned int vertexCount,
+		const unsigned int* indices,
+		unsigned int indexCount,
+		const DirectX::XMFLOAT4X4& world);
+	void Render(JobSystem* jobs = 0);
+
+	bool IsBoxVisible(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax) const;
+	unsigned int Cull(
+		const DirectX::XMFLOAT3* boxMins,
+		const DirectX::XMFLOAT3* boxMaxs,
+		std::vector<unsigned int>& objects,
+		JobSystem* jobs = 0);
+
+	const float* GetDepth() const;
+	const OcclusionStats& GetStats() const;
+
+private:
+	struct Occluder
+	{
+		const DirectX::XMFLOAT3* positions;
+		unsigned int vertexCount;
+		const unsigned int* indices;
+		unsigned int indexCount;
+		DirectX::XMFLOAT4X4 world;
+		unsigned int firstVertex;	// Into clipVertices
+		unsigned int firstTriangle;	// Into triangles, a fan of slots per triangle
+	};
+
+	// A triangle ready to rasterize: three edge functions and
+	// a depth plane, each as a * x + b * y + c at pixel centers
+	// (positive inside), plus the pixels it could touch
+	struct ScreenTriangle
+	{
+		float edgeA[3];
+		float edgeB[3];
+		float edgeC[3];
+		float depthA;
+		float depthB;
+		float depthC;
+		int minX, minY, maxX, maxY;	// Inclusive - empty when minX > maxX
+	};
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+	unsigned int blocksX;
+	unsigned int blocksY;
+	DirectX::XMFLOAT4X4 viewProjection;
+
+	std::vector<Occluder> occluders;
+	std::vector<DirectX::XMFLOAT4> clipVertices;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<unsigned int>> tileBins;	// Triangles touching each tile
+
+	std::vector<float> depth;			// Nearest depth per pixel, row by row
+	std::vector<float> blockDepth;		// Farthest depth in each 8x8 block
+	std::vector<unsigned char> objectVisible;	// Per object being culled
+
+	OcclusionStats stats;
+
+	void SetupOccluder(unsigned int occluder);
+	void AddTriangle(const DirectX::XMFLOAT4* clip, ScreenTriangle& triangle) const;
+	void RasterizeTile(unsigned int tile);
+};
@@ -1,4 +1,6 @@
 
+#include "DrawData.hlsli"
+
 // Struct representing the data we expect to receive from earlier pipeline stages
 // - Should match the output of our corresponding vertex shader
 // - The name of the struct itself is unimportant
@@ -13,6 +15,7 @@ struct VertexToPixel
 	//  v    v                v
 	float4 screenPosition	: SV_POSITION;
 	float4 color			: COLOR;
+	float3 normal			: NORMAL;
 };
 
 // --------------------------------------------------------
@@ -26,9 +29,9 @@ struct VertexToPixel
 // --------------------------------------------------------
 float4 main(VertexToPixel input) : SV_TARGET
 {
-	// Just return the input color
+	// Return the input color, tinted by the draw
 	// - This color (like most values passing through the rasterizer) is 
 	//   interpolated for each pixel between the corresponding vertices 
 	//   of the triangle we're rendering
-	return input.color;
+	return input.color * colorTint;
 }
\ No newline at end of file
@@ -0,0 +1,306 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+// Singleton requirement
+Profiler* Profiler::instance;
+
+// The buffer this thread records into (created on first use)
+static thread_local ProfileThreadBuffer* threadBuffer = 0;
+
+// --------------- Basic usage -----------------
+//
+// Put PROFILE_ZONE("Some Name") at the top of any scope you'd
+// like timed.  Zones can be nested, and can be used from any
+// thread.  DXCore already marks each frame and wraps the major
+// phases of the game loop, so anything zoned inside Update()
+// or Draw() shows up as a child of those.
+//
+// Recording a zone never allocates memory: each thread gets a
+// fixed-size ring buffer the first time it records a zone, and
+// the oldest zones are overwritten once that buffer is full.
+// Buffers live until the profiler is deleted, so zones are
+// meant for long-lived threads (the main thread, worker pools)
+// rather than threads created and destroyed every frame.
+//
+// Call ExportChromeTrace() to get a file that can be opened
+// in chrome://tracing (or https://ui.perfetto.dev), and/or
+// ExportFrameSummary() for a plain-text, per-frame tree that
+// lists the slowest frames first.  Exporting while other
+// threads are still recording is not safe; do it at shutdown
+// or while those threads are idle.
+//
+// ----------------------------------------------
+
+// --------------------------------------------------------
+// Constructor - Preallocates the frame marker ring
+// --------------------------------------------------------
+Profiler::Profiler()
+	:
+	frameStarts(MaxFrames),
+	frameCount(0)
+{
+}
+
+// --------------------------------------------------------
+// Destructor - Clean up every thread's ring buffer
+//  - No zones may be recorded after this point
+// --------------------------------------------------------
+Profiler::~Profiler()
+{
+	for (ProfileThreadBuffer* buffer : threads)
+		delete buffer;
+}
+
+// --------------------------------------------------------
+// Current time in nanoseconds, from the same steady clock
+// that SystemTimeSource uses
+// --------------------------------------------------------
+int64_t Profiler::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// --------------------------------------------------------
+// Records the start of a new frame.  Call this from one
+// thread only (DXCore does so at the top of each frame).
+// --------------------------------------------------------
+void Profiler::MarkFrame()
+{
+	frameStarts[frameCount % MaxFrames] = Now();
+	frameCount++;
+}
+
+// --------------------------------------------------------
+// Throws away all recorded zones and frames
+// --------------------------------------------------------
+void Profiler::Clear()
+{
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	for (ProfileThreadBuffer* buffer : threads)
+		buffer->writeCount.store(0);
+
+	frameCount = 0;
+}
+
+// --------------------------------------------------------
+// Called when a zone opens - returns its nesting depth
+// --------------------------------------------------------
+unsigned int Profiler::BeginZone()
+{
+	ProfileThreadBuffer* buffer = GetThreadBuffer();
+	return buffer->depth++;
+}
+
+// --------------------------------------------------------
+// Called when a zone closes - writes it to this thread's ring
+//  - Zones are written when they END, so children appear
+//    before their parents; exporting sorts by start time
+// --------------------------------------------------------
+void Profiler::EndZone(const char* name, int64_t start, unsigned int depth)
+{
+	int64_t end = Now();
+
+	ProfileThreadBuffer* buffer = GetThreadBuffer();
+	buffer->depth = depth;
+
+	uint64_t index = buffer->writeCount.load(std::memory_order_relaxed);
+	ProfileEvent& e = buffer->events[index % EventsPerThread];
+	e.name = name;
+	e.start = start;
+	e.end = end;
+	e.depth = depth;
+	buffer->writeCount.store(index + 1, std::memory_order_release);
+}
+
+// --------------------------------------------------------
+// Gets this thread's ring buffer, creating and registering
+// it the first time this thread records anything.  This is
+// the only place the profiler allocates.
+// --------------------------------------------------------
+ProfileThreadBuffer* Profiler::GetThreadBuffer()
+{
+	if (threadBuffer)
+		return threadBuffer;
+
+	ProfileThreadBuffer* buffer = new ProfileThreadBuffer();
+	buffer->events.resize(EventsPerThread);
+	buffer->writeCount.store(0);
+	buffer->depth = 0;
+
+	std::lock_guard<std::mutex> lock(threadsMutex);
+	buffer->threadIndex = (unsigned int)threads.size();
+	threads.push_back(buffer);
+
+	threadBuffer = buffer;
+	return buffer;
+}
+
+// --------------------------------------------------------
+// Copies whatever is still in a thread's ring, oldest first,
+// sorted by start time so parents come before children
+// --------------------------------------------------------
+std::vector<ProfileEvent> Profiler::GatherEvents(unsigned int threadIndex)
+{
+	ProfileThreadBuffer* buffer = threads[threadIndex];
+	uint64_t written = buffer->writeCount.load(std::memory_order_acquire);
+	uint64_t count = std::min<uint64_t>(written, EventsPerThread);
+
+	std::vector<ProfileEvent> events;
+	events.reserve((size_t)count);
+	for (uint64_t i = written - count; i < written; i++)
+		events.push_back(buffer->events[i % EventsPerThread]);
+
+	std::sort(events.begin(), events.end(),
+		[](const ProfileEvent& a, const ProfileEvent& b)
+		{
+			return a.start < b.start || (a.start == b.start && a.depth < b.depth);
+		});
+
+	return events;
+}
+
+// --------------------------------------------------------
+// Writes all recorded zones in the Chrome trace event format
+// (JSON), which chrome://tracing and Perfetto can open
+//
+// path - The file to write
+// --------------------------------------------------------
+bool Profiler::ExportChromeTrace(const std::string& path)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	std::lock_guard<std::mutex> lock(threadsMutex);
+
+	// Gather everything first so times can be made relative
+	// to the earliest thing recorded (keeps the numbers small)
+	std::vector<std::vector<ProfileEvent>> threadEvents;
+	int64_t baseTime = INT64_MAX;
+	for (unsigned int t = 0; t < threads.size(); t++)
+	{
+		threadEvents.push_back(GatherEvents(t));
+		if (!threadEvents[t].empty())
+			baseTime = std::min(baseTime, threadEvents[t].front().start);
+	}
+
+	uint64_t firstFrame = frameCount > MaxFrames ? frameCount - MaxFrames : 0;
+	for (uint64_t f = firstFrame; f < frameCount; f++)
+		baseTime = std::min(baseTime, frameStarts[f % MaxFrames]);
+
+	// Fixed notation keeps sub-microsecond detail on long runs
+	file.setf(std::ios::fixed);
+	file.precision(3);
+	file << "{\"traceEvents\":[\n";
+	bool first = true;
+
+	// Complete ("X") events for every zone - timestamps are microseconds
+	for (unsigned int t = 0; t < threadEvents.size(); t++)
+	{
+		for (const ProfileEvent& e : threadEvents[t])
+		{
+			if (!first) file << ",\n";
+			first = false;
+
+			file << "{\"name\":\"";
+			for (const char* c = e.name; *c; c++)
+			{
+				if (*c == '"' || *c == '\\') file << '\\';
+				file << *c;
+			}
+			file << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << t <<
+				",\"ts\":" << (e.start - baseTime) / 1000.0 <<
+				",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+		}
+	}
+
+	// Global instant ("i") events marking the start of each frame
+	for (uint64_t f = firstFrame; f < frameCount; f++)
+	{
+		if (!first) file << ",\n";
+		first = false;
+
+		file << "{\"name\":\"Frame " << f << "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":0,\"ts\":" <<
+			(frameStarts[f % MaxFrames] - baseTime) / 1000.0 << "}";
+	}
+
+	file << "\n]}\n";
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes a plain-text, per-frame breakdown of all recorded
+// zones, indented by nesting, with the slowest frames first
+//
+// path              - The file to write
+// slowestFrameCount - How many of the slowest frames to list
+//                     at the top of the file
+// --------------------------------------------------------
+bool Profiler::ExportFrameSummary(const std::string& path, unsigned int slowestFrameCount)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	std::lock_guard<std::mutex> lock(threadsMutex);
+
+	std::vector<std::vector<ProfileEvent>> threadEvents;
+	for (unsigned int t = 0; t < threads.size(); t++)
+		threadEvents.push_back(GatherEvents(t));
+
+	// Only frames that have both a start and an end are
+	// complete (the current frame is still in progress)
+	uint64_t firstFrame = frameCount > MaxFrames ? frameCount - MaxFrames : 0;
+	std::vector<uint64_t> frames;
+	for (uint64_t f = firstFrame; f + 1 < frameCount; f++)
+		frames.push_back(f);
+
+	auto frameStart = [&](uint64_t f) { return frameStarts[f % MaxFrames]; };
+	auto frameMs = [&](uint64_t f) { return (frameStart(f + 1) - frameStart(f)) / 1000000.0; };
+
+	// Sort a copy by duration to find the spikes
+	std::vector<uint64_t> slowest = frames;
+	std::sort(slowest.begin(), slowest.end(),
+		[&](uint64_t a, uint64_t b) { return frameMs(a) > frameMs(b); });
+	if (slowest.size() > slowestFrameCount)
+		slowest.resize(slowestFrameCount);
+
+	file.setf(std::ios::fixed);
+	file.precision(3);
+	file << "Profiler frame summary: " << frames.size() << " frames, " << threads.size() << " threads\n\n";
+	file << "Slowest frames:\n";
+	for (uint64_t f : slowest)
+		file << "  Frame " << f << "    " << frameMs(f) << " ms\n";
+
+	// Every frame in order, with each thread's zones as a tree
+	for (uint64_t f : frames)
+	{
+		int64_t start = frameStart(f);
+		int64_t end = frameStart(f + 1);
+		file << "\nFrame " << f << "    " << frameMs(f) << " ms\n";
+
+		for (unsigned int t = 0; t < threadEvents.size(); t++)
+		{
+			const std::vector<ProfileEvent>& events = threadEvents[t];
+
+			// Events are sorted by start, so jump straight to this frame
+			auto it = std::lower_bound(events.begin(), events.end(), start,
+				[](const ProfileEvent& e, int64_t time) { return e.start < time; });
+			if (it == events.end() || it->start >= end)
+				continue;
+
+			file << "  [Thread " << t << "]\n";
+			for (; it != events.end() && it->start < end; ++it)
+			{
+				file << std::string(4 + it->depth * 2, ' ') << it->name <<
+					"    " << (it->end - it->start) / 1000000.0 << " ms\n";
+			}
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// --------------------------------------------------------
+// Macros for instrumenting code - define DISABLE_PROFILER
+// in the project settings to compile all of them out
+//
+//  PROFILE_ZONE("Name") - Times everything from here to the
+//                         end of the enclosing scope
+//  PROFILE_FRAME()      - Marks the start of a new frame
+// --------------------------------------------------------
+#ifndef DISABLE_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::GetInstance().MarkFrame()
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FRAME()
+#endif
+
+// A single completed zone
+struct ProfileEvent
+{
+	const char* name;	// Must be a string literal (or otherwise outlive the profiler)
+	int64_t start;		// Nanoseconds
+	int64_t end;		// Nanoseconds
+	unsigned int depth;	// How many zones this one is nested inside of
+};
+
+// Fixed-size ring of events recorded by exactly one thread
+struct ProfileThreadBuffer
+{
+	std::vector<ProfileEvent> events;
+	std::atomic<uint64_t> writeCount;
+	unsigned int threadIndex;
+	unsigned int depth;
+};
+
+class Profiler
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static Profiler& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new Profiler();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	Profiler(Profiler const&) = delete;
+	void operator=(Profiler const&) = delete;
+
+private:
+	static Profiler* instance;
+	Profiler();
+#pragma endregion
+
+public:
+	~Profiler();
+
+	static int64_t Now();
+
+	void MarkFrame();
+	void Clear();
+
+	bool ExportChromeTrace(const std::string& path);
+	bool ExportFrameSummary(const std::string& path, unsigned int slowestFrameCount = 10);
+
+	// Used by ProfileZone - prefer the PROFILE_ZONE macro
+	unsigned int BeginZone();
+	void EndZone(const char* name, int64_t start, unsigned int depth);
+
+private:
+	static const unsigned int EventsPerThread = 64 * 1024;
+	static const unsigned int MaxFrames = 1024;
+
+	// Every thread that has ever recorded a zone
+	std::mutex threadsMutex;
+	std::vector<ProfileThreadBuffer*> threads;
+
+	// Ring of frame start times (from the thread calling MarkFrame)
+	std::vector<int64_t> frameStarts;
+	uint64_t frameCount;
+
+	ProfileThreadBuffer* GetThreadBuffer();
+	std::vector<ProfileEvent> GatherEvents(unsigned int threadIndex);
+};
+
+// --------------------------------------------------------
+// Times the lifetime of the object - use PROFILE_ZONE()
+// --------------------------------------------------------
+class ProfileZone
+{
+public:
+	ProfileZone(const char* name)
+		: name(name)
+	{
+		depth = Profiler::GetInstance().BeginZone();
+		start = Profiler::Now();
+	}
+
+	~ProfileZone()
+	{
+		Profiler::GetInstance().EndZone(name, start, depth);
+	}
+
+private:
+	const char* name;
+	int64_t start;
+	unsigned int depth;
+};
@@ -0,0 +1,444 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <functional>
+
+// --------------------------------------------------------
+// Constructor - Starts with no passes or resources
+// --------------------------------------------------------
+RenderGraph::RenderGraph()
+{
+}
+
+// --------------------------------------------------------
+// Forgets every pass and resource, ready to describe the
+// next frame (the stats stay until the next Compile())
+// --------------------------------------------------------
+void RenderGraph::Clear()
+{
+	passes.clear();
+	resources.clear();
+	versions.clear();
+	accesses.clear();
+	sortedAccesses.clear();
+	executionOrder.clear();
+}
+
+// --------------------------------------------------------
+// Adds a resource that only lives within the frame,
+// returning its first version (which has nothing in it yet)
+//
+// name - For debugging, and must outlive the graph's use
+// --------------------------------------------------------
+RenderResourceId RenderGraph::CreateTransient(const char* name)
+{
+	Resource resource;
+	resource.name = name;
+	resource.imported = false;
+	resource.output = false;
+	resource.firstUse = InvalidRenderGraphId;
+	resource.lastUse = InvalidRenderGraphId;
+	resources.push_back(resource);
+
+	RenderResourceId version = AddVersion((unsigned int)(resources.size() - 1), InvalidRenderGraphId, InvalidRenderGraphId);
+	resources.back().latest = version;
+	return version;
+}
+
+// --------------------------------------------------------
+// Adds a resource owned outside the graph (with whatever it
+// already holds), returning its first version
+// --------------------------------------------------------
+RenderResourceId RenderGraph::Import(const char* name)
+{
+	RenderResourceId version = CreateTransient(name);
+	resources.back().imported = true;
+	return version;
+}
+
+// --------------------------------------------------------
+// Marks a resource as needed after the graph executes, so
+// the passes writing its last version aren't culled
+// --------------------------------------------------------
+void RenderGraph::MarkOutput(RenderResourceId resource)
+{
+	resources[versions[resource].resource].output = true;
+}
+
+// --------------------------------------------------------
+// Adds a pass, returning its id for declaring what it reads
+// and writes
+//
+// name        - For debugging, and must outlive the graph's use
+// execute     - Does the pass's work, when the graph executes
+// sideEffects - Whether it does something that matters
+//               beyond the resources it writes (presenting,
+//               reading back...), so it's never culled
+// --------------------------------------------------------
+RenderPassId RenderGraph::AddPass(const char* name, ExecuteFunction execute, bool sideEffects)
+{
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.sideEffects = sideEffects;
+	pass.culled = false;
+	pass.firstAccess = 0;
+	pass.accessCount = 0;
+	passes.push_back(pass);
+	return (RenderPassId)(passes.size() - 1);
+}
+
+// --------------------------------------------------------
+// Declares that a pass reads one version of a resource (any
+// version, not just the newest).  Returns false, declaring
+// nothing, for a version that doesn't exist - like a failed
+// Write()'s InvalidRenderGraphId.
+// --------------------------------------------------------
+bool RenderGraph::Read(RenderPassId pass, RenderResourceId resource)
+{
+	if (resource >= versions.size())
+		return false;
+
+	RenderGraphAccess access;
+	access.pass = pass;
+	access.version = resource;
+	access.resource = versions[resource].resource;
+	access.write = false;
+	access.target = RenderGraphNoTarget;
+	accesses.push_back(access);
+	return true;
+}
+
+// --------------------------------------------------------
+// Declares that a pass writes a resource, returning the new
+// version for later passes to use.  Only a resource's
+// newest version can be written - returns invalid otherwise.
+//
+// pass     - The pass writing it
+// resource - The version it overwrites (or adds to)
+// target   - How it's bound while the pass runs
+// --------------------------------------------------------
+RenderResourceId RenderGraph::Write(RenderPassId pass, RenderResourceId resource, RenderGraphTarget target)
+{
+	if (resource >= versions.size() || resources[versions[resource].resource].latest != resource)
+		return InvalidRenderGraphId;
+
+	unsigned int index = versions[resource].resource;
+	RenderResourceId version = AddVersion(index, pass, resource);
+	resources[index].latest = version;
+
+	RenderGraphAccess access;
+	access.pass = pass;
+	access.version = version;
+	access.resource = index;
+	access.write = true;
+	access.target = target;
+	accesses.push_back(access);
+	return version;
+}
+
+// --------------------------------------------------------
+// Culls passes that aren't needed, orders the rest and
+// works out each resource's lifetime.  Returns false if the
+// passes depend on each other in a cycle, in which case
+// nothing executes.
+// --------------------------------------------------------
+bool RenderGraph::Compile()
+{
+	GroupAccesses();
+	CullPasses();
+
+	// Dependencies as lists of the passes waiting on each
+	// pass - counted, then filled in
+	edgeStarts.assign(passes.size() + 1, 0);
+	waitingOn.assign(passes.size(), 0);
+	for (RenderPassId p = 0; p < passes.size(); p++)
+		AddDependencies(p, true);
+
+	for (unsigned int i = 0; i < passes.size(); i++)
+		edgeStarts[i + 1] += edgeStarts[i];
+
+	edges.resize(edgeStarts[passes.size()]);
+	for (RenderPassId p = 0; p < passes.size(); p++)
+		AddDependencies(p, false);
+
+	// Filling moved each start to the next one's
+	for (unsigned int i = (unsigned int)passes.size(); i > 0; i--)
+		edgeStarts[i] = edgeStarts[i - 1];
+	edgeStarts[0] = 0;
+
+	bool sorted = SortPasses();
+	if (!sorted)
+		executionOrder.clear();
+
+	ComputeLifetimes();
+
+	stats.passCount = (unsigned int)passes.size();
+	stats.executedPassCount = (unsigned int)executionOrder.size();
+	stats.culledPassCount = 0;
+	for (unsigned int i = 0; i < passes.size(); i++)
+		stats.culledPassCount += passes[i].culled ? 1 : 0;
+	stats.resourceCount = (unsigned int)resources.size();
+	stats.dependencyCount = (unsigned int)edges.size();
+	return sorted;
+}
+
+// --------------------------------------------------------
+// Runs every pass that wasn't culled, in order
+// --------------------------------------------------------
+void RenderGraph::Execute()
+{
+	for (unsigned int i = 0; i < executionOrder.size(); i++)
+		ExecutePass(executionOrder[i]);
+}
+
+// --------------------------------------------------------
+// Runs one pass - for whatever executes the graph itself,
+// going through GetExecutedPass()
+// --------------------------------------------------------
+void RenderGraph::ExecutePass(RenderPassId pass)
+{
+	if (passes[pass].execute)
+		passes[pass].execute();
+}
+
+unsigned int RenderGraph::GetPassCount() const { return (unsigned int)passes.size(); }
+const char* RenderGraph::GetPassName(RenderPassId pass) const { return passes[pass].name; }
+bool RenderGraph::IsPassCulled(RenderPassId pass) const { return passes[pass].culled; }
+unsigned int RenderGraph::GetPassAccessCount(RenderPassId pass) const { return passes[pass].accessCount; }
+unsigned int RenderGraph::GetExecutedPassCount() const { return (unsigned int)executionOrder.size(); }
+RenderPassId RenderGraph::GetExecutedPass(unsigned int index) const { return executionOrder[index]; }
+unsigned int RenderGraph::GetResourceCount() const { return (unsigned int)resources.size(); }
+unsigned int RenderGraph::GetResource(RenderResourceId version) const { return versions[version].resource; }
+const char* RenderGraph::GetResourceName(unsigned int resource) const { return resources[resource].name; }
+bool RenderGraph::IsImported(unsigned int resource) const { return resources[resource].imported; }
+unsigned int RenderGraph::GetFirstUse(unsigned int resource) const { return resources[resource].firstUse; }
+unsigned int RenderGraph::GetLastUse(unsigned int resource) const { return resources[resource].lastUse; }
+const RenderGraphStats& RenderGraph::GetStats() const { return stats; }
+
+// --------------------------------------------------------
+// One of a pass's reads and writes, in the order they were
+// declared (after Compile())
+// --------------------------------------------------------
+const RenderGraphAccess& RenderGraph::GetPassAccess(RenderPassId pass, unsigned int index) const
+{
+	return sortedAccesses[passes[pass].firstAccess + index];
+}
+
+// --------------------------------------------------------
+// Adds a version of a resource, returning its id
+// --------------------------------------------------------
+RenderResourceId RenderGraph::AddVersion(unsigned int resource, RenderPassId writer, RenderResourceId previous)
+{
+	Version version;
+	version.resource = resource;
+	version.writer = writer;
+	version.previous = previous;
+	versions.push_back(version);
+	return (RenderResourceId)(versions.size() - 1);
+}
+
+// --------------------------------------------------------
+// Groups accesses by pass, and the passes reading each
+// version by version
+// --------------------------------------------------------
+void RenderGraph::GroupAccesses()
+{
+	for (unsigned int i = 0; i < passes.size(); i++)
+		passes[i].accessCount = 0;
+
+	versionReaderStarts.assign(versions.size() + 1, 0);
+	for (unsigned int i = 0; i < accesses.size(); i++)
+	{
+		passes[accesses[i].pass].accessCount++;
+		if (!accesses[i].write)
+			versionReaderStarts[accesses[i].version + 1]++;
+	}
+
+	unsigned int start = 0;
+	for (unsigned int i = 0; i < passes.size(); i++)
+	{
+		passes[i].firstAccess = start;
+		start += passes[i].accessCount;
+		passes[i].accessCount = 0;
+	}
+
+	for (unsigned int i = 0; i < versions.size(); i++)
+		versionReaderStarts[i + 1] += versionReaderStarts[i];
+
+	// Counts go back up as each is placed, keeping the order
+	// they were declared in
+	sortedAccesses.resize(accesses.size());
+	versionReaders.resize(versionReaderStarts[versions.size()]);
+	for (unsigned int i = 0; i < accesses.size(); i++)
+	{
+		Pass& pass = passes[accesses[i].pass];
+		sortedAccesses[pass.firstAccess + pass.accessCount++] = accesses[i];
+		if (!accesses[i].write)
+			versionReaders[versionReaderStarts[accesses[i].version]++] = accesses[i].pass;
+	}
+
+	for (unsigned int i = (unsigned int)versions.size(); i > 0; i--)
+		versionReaderStarts[i] = versionReaderStarts[i - 1];
+	versionReaderStarts[0] = 0;
+}
+
+// --------------------------------------------------------
+// Culls every pass, then brings back the ones with side
+// effects or writing an output, and everything they need
+// --------------------------------------------------------
+void RenderGraph::CullPasses()
+{
+	work.clear();
+	for (RenderPassId p = 0; p < passes.size(); p++)
+	{
+		passes[p].culled = !passes[p].sideEffects;
+		if (passes[p].sideEffects)
+			work.push_back(p);
+	}
+
+	for (unsigned int i = 0; i < resources.size(); i++)
+	{
+		RenderPassId writer = versions[resources[i].latest].writer;
+		if (resources[i].output && writer != InvalidRenderGraphId && passes[writer].culled)
+		{
+			passes[writer].culled = false;
+			work.push_back(writer);
+		}
+	}
+
+	// A write adds to what was there, so needs the pass that
+	// wrote the version before just like a read would
+	while (!work.empty())
+	{
+		const Pass& pass = passes[work.back()];
+		work.pop_back();
+
+		for (unsigned int i = 0; i < pass.accessCount; i++)
+		{
+			const RenderGraphAccess& access = sortedAccesses[pass.firstAccess + i];
+			RenderResourceId needed = access.write ? versions[access.version].previous : access.version;
+			RenderPassId writer = versions[needed].writer;
+			if (writer != InvalidRenderGraphId && passes[writer].culled)
+			{
+				passes[writer].culled = false;
+				work.push_back(writer);
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Goes through what a pass that wasn't culled has to wait
+// for: whatever wrote the versions it uses, and any reads
+// of versions it overwrites
+//
+// pass  - The waiting pass
+// count - Whether to count dependencies, or fill them in
+// --------------------------------------------------------
+void RenderGraph::AddDependencies(RenderPassId pass, bool count)
+{
+	const Pass& p = passes[pass];
+	if (p.culled)
+		return;
+
+	auto add = [this, pass, count](RenderPassId before)
+	{
+		if (before == InvalidRenderGraphId || before == pass || passes[before].culled)
+			return;
+
+		if (count)
+		{
+			edgeStarts[before + 1]++;
+			waitingOn[pass]++;
+		}
+		else
+		{
+			edges[edgeStarts[before]++] = pass;
+		}
+	};
+
+	for (unsigned int i = 0; i < p.accessCount; i++)
+	{
+		const RenderGraphAccess& access = sortedAccesses[p.firstAccess + i];
+		if (!access.write)
+		{
+			add(versions[access.version].writer);
+			continue;
+		}
+
+		RenderResourceId previous = versions[access.version].previous;
+		add(versions[previous].writer);
+		for (unsigned int r = versionReaderStarts[previous]; r < versionReaderStarts[previous + 1]; r++)
+			add(versionReaders[r]);
+	}
+}
+
+// --------------------------------------------------------
+// Orders the passes that weren't culled so each comes after
+// everything it depends on, picking the earliest added pass
+// whenever there's a choice.  False if there's a cycle.
+// --------------------------------------------------------
+bool RenderGraph::SortPasses()
+{
+	executionOrder.clear();
+
+	// Passes that are ready, as a heap with the lowest id first
+	work.clear();
+	unsigned int expected = 0;
+	for (RenderPassId p = 0; p < passes.size(); p++)
+	{
+		if (passes[p].culled)
+			continue;
+
+		expected++;
+		if (waitingOn[p] == 0)
+			work.push_back(p);
+	}
+
+	std::greater<unsigned int> later;
+	std::make_heap(work.begin(), work.end(), later);
+	while (!work.empty())
+	{
+		std::pop_heap(work.begin(), work.end(), later);
+		RenderPassId pass = work.back();
+		work.pop_back();
+		executionOrder.push_back(pass);
+
+		for (unsigned int i = edgeStarts[pass]; i < edgeStarts[pass + 1]; i++)
+		{
+			if (--waitingOn[edges[i]] == 0)
+			{
+				work.push_back(edges[i]);
+				std::push_heap(work.begin(), work.end(), later);
+			}
+		}
+	}
+
+	return executionOrder.size() == expected;
+}
+
+// --------------------------------------------------------
+// Sets each resource's first and last use, as indices into
+// the executed passes (invalid if nothing executed uses it)
+// --------------------------------------------------------
+void RenderGraph::ComputeLifetimes()
+{
+	for (unsigned int i = 0; i < resources.size(); i++)
+	{
+		resources[i].firstUse = InvalidRenderGraphId;
+		resources[i].lastUse = InvalidRenderGraphId;
+	}
+
+	for (unsigned int i = 0; i < executionOrder.size(); i++)
+	{
+		const Pass& pass = passes[executionOrder[i]];
+		for (unsigned int a = 0; a < pass.accessCount; a++)
+		{
+			Resource& resource = resources[sortedAccesses[pass.firstAccess + a].resource];
+			if (resource.firstUse == InvalidRenderGraphId)
+				resource.firstUse = i;
+			resource.lastUse = i;
+		}
+	}
+}
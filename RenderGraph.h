@@ -0,0 +1,167 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+// Which pass - an index in the order passes were added
+typedef unsigned int RenderPassId;
+
+// One version of a resource - each write makes a new one, so
+// a pass reading it is ordered after whichever pass wrote it
+typedef unsigned int RenderResourceId;
+
+static const unsigned int InvalidRenderGraphId = 0xFFFFFFFF;
+
+// --------------------------------------------------------
+// How a pass writes a resource, so whatever executes the
+// graph knows what to bind before the pass runs
+// --------------------------------------------------------
+enum RenderGraphTarget
+{
+	RenderGraphNoTarget,		// Written some other way (clears, copies...)
+	RenderGraphColorTarget,		// Bound as a render target
+	RenderGraphDepthTarget		// Bound as the depth buffer
+};
+
+// --------------------------------------------------------
+// One pass's read or write of a resource
+// --------------------------------------------------------
+struct RenderGraphAccess
+{
+	RenderPassId pass;
+	RenderResourceId version;	// Read, or made by the write
+	unsigned int resource;		// Which resource that's a version of
+	bool write;
+	RenderGraphTarget target;
+};
+
+// --------------------------------------------------------
+// Totals for the last Compile()
+// --------------------------------------------------------
+struct RenderGraphStats
+{
+	unsigned int passCount = 0;
+	unsigned int executedPassCount = 0;
+	unsigned int culledPassCount = 0;
+	unsigned int resourceCount = 0;
+	unsigned int dependencyCount = 0;
+};
+
+// --------------------------------------------------------
+// A frame's work as passes that declare the resources they
+// read and write, rather than a fixed sequence of calls.
+//
+// Compile() works out the rest:
+//  - Order: each pass runs after the passes that wrote what
+//    it reads (and a write waits for earlier reads of what
+//    it overwrites), otherwise in the order passes were added
+//  - Culling: only passes with side effects (like presenting),
+//    passes writing an output resource, and the passes they
+//    depend on are executed
+//  - Lifetimes: the first and last executed pass using each
+//    resource, so transient resources whose lifetimes don't
+//    overlap can share memory (see TransientAllocator)
+//
+// Resources are either transient (only needed within the
+// frame) or imported (owned elsewhere, like the back buffer).
+// Writing returns the resource's next version, and it's
+// versions that passes read and write - which is what lets
+// passes be added in any order.
+//
+// Nothing is executed until Execute() (or ExecutePass(), for
+// whatever wraps the graph and binds each pass's targets).
+// No Direct3D dependencies - D3D11RenderGraph executes one.
+// --------------------------------------------------------
+class RenderGraph
+{
+public:
+	typedef std::function<void()> ExecuteFunction;
+
+	RenderGraph();
+
+	void Clear();
+
+	RenderResourceId CreateTransient(const char* name);
+	RenderResourceId Import(const char* name);
+	void MarkOutput(RenderResourceId resource);
+
+	RenderPassId AddPass(const char* name, ExecuteFunction execute, bool sideEffects = false);
+	bool Read(RenderPassId pass, RenderResourceId resource);
+	RenderResourceId Write(RenderPassId pass, RenderResourceId resource, RenderGraphTarget target = RenderGraphNoTarget);
+
+	bool Compile();
+	void Execute();
+	void ExecutePass(RenderPassId pass);
+
+	unsigned int GetPassCount() const;
+	const char* GetPassName(RenderPassId pass) const;
+	bool IsPassCulled(RenderPassId pass) const;
+	unsigned int GetPassAccessCount(RenderPassId pass) const;
+	const RenderGraphAccess& GetPassAccess(RenderPassId pass, unsigned int index) const;
+
+	unsigned int GetExecutedPassCount() const;
+	RenderPassId GetExecutedPass(unsigned int index) const;
+
+	unsigned int GetResourceCount() const;
+	unsigned int GetResource(RenderResourceId version) const;
+	const char* GetResourceName(unsigned int resource) const;
+	bool IsImported(unsigned int resource) const;
+	unsigned int GetFirstUse(unsigned int resource) const;
+	unsigned int GetLastUse(unsigned int resource) const;
+
+	const RenderGraphStats& GetStats() const;
+
+private:
+	struct Pass
+	{
+		const char* name;
+		ExecuteFunction execute;
+		bool sideEffects;
+		bool culled;
+		unsigned int firstAccess;	// Into sortedAccesses, after Compile()
+		unsigned int accessCount;
+	};
+
+	struct Resource
+	{
+		const char* name;
+		bool imported;
+		bool output;
+		RenderResourceId latest;	// Its newest version
+		unsigned int firstUse;		// Executed pass indices, after Compile()
+		unsigned int lastUse;
+	};
+
+	struct Version
+	{
+		unsigned int resource;
+		RenderPassId writer;		// Invalid for the first version
+		RenderResourceId previous;	// What the write overwrote
+	};
+
+	std::vector<Pass> passes;
+	std::vector<Resource> resources;
+	std::vector<Version> versions;
+	std::vector<RenderGraphAccess> accesses;	// In the order they were declared
+
+	// Filled by Compile()
+	std::vector<RenderGraphAccess> sortedAccesses;	// Grouped by pass
+	std::vector<RenderPassId> executionOrder;
+
+	// Scratch for Compile(), kept so it doesn't allocate
+	std::vector<unsigned int> versionReaders;		// Grouped by version
+	std::vector<unsigned int> versionReaderStarts;
+	std::vector<unsigned int> edges;				// Dependent passes, grouped by pass
+	std::vector<unsigned int> edgeStarts;
+	std::vector<unsigned int> waitingOn;			// Per pass, dependencies not yet ordered
+	std::vector<unsigned int> work;
+
+	RenderGraphStats stats;
+
+	RenderResourceId AddVersion(unsigned int resource, RenderPassId writer, RenderResourceId previous);
+	void GroupAccesses();
+	void CullPasses();
+	void AddDependencies(RenderPassId pass, bool count);
+	bool SortPasses();
+	void ComputeLifetimes();
+};
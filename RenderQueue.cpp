@@ -0,0 +1,220 @@
+#include "RenderQueue.h"
+
+// Field positions and widths within a sort key
+static const unsigned int DepthShift = 0;		static const unsigned int DepthBits = 20;
+static const unsigned int MeshShift = 20;		static const unsigned int MeshBits = 12;
+static const unsigned int MaterialShift = 32;	static const unsigned int MaterialBits = 12;
+static const unsigned int LayoutShift = 44;		static const unsigned int LayoutBits = 6;
+static const unsigned int ShaderShift = 50;		static const unsigned int ShaderBits = 10;
+static const unsigned int LayerShift = 60;		static const unsigned int LayerBits = 4;
+
+static inline SortKey PackField(unsigned int value, unsigned int shift, unsigned int bits)
+{
+	return ((SortKey)value & ((1ull << bits) - 1)) << shift;
+}
+
+static inline unsigned int UnpackField(SortKey key, unsigned int shift, unsigned int bits)
+{
+	return (unsigned int)((key >> shift) & ((1ull << bits) - 1));
+}
+
+// --------------------------------------------------------
+// Builds a sort key from its fields
+//
+// depth - Normalized 0 (near) to 1 (far); values outside
+//         that range are clamped.  For back-to-front
+//         layers (transparency), pass 1 - depth instead.
+// --------------------------------------------------------
+SortKey MakeSortKey(
+	unsigned int layer,
+	unsigned int shader,
+	unsigned int layout,
+	unsigned int material,
+	unsigned int mesh,
+	float depth)
+{
+	// Written so NaN ends up as 0 as well
+	if (!(depth > 0.0f)) depth = 0.0f;
+	if (depth > 1.0f) depth = 1.0f;
+	unsigned int quantizedDepth = (unsigned int)(depth * (float)((1u << DepthBits) - 1) + 0.5f);
+
+	return
+		PackField(layer, LayerShift, LayerBits) |
+		PackField(shader, ShaderShift, ShaderBits) |
+		PackField(layout, LayoutShift, LayoutBits) |
+		PackField(material, MaterialShift, MaterialBits) |
+		PackField(mesh, MeshShift, MeshBits) |
+		PackField(quantizedDepth, DepthShift, DepthBits);
+}
+
+// --------------------------------------------------------
+// Getters for each field of a sort key
+// --------------------------------------------------------
+unsigned int GetSortKeyLayer(SortKey key) { return UnpackField(key, LayerShift, LayerBits); }
+unsigned int GetSortKeyShader(SortKey key) { return UnpackField(key, ShaderShift, ShaderBits); }
+unsigned int GetSortKeyLayout(SortKey key) { return UnpackField(key, LayoutShift, LayoutBits); }
+unsigned int GetSortKeyMaterial(SortKey key) { return UnpackField(key, MaterialShift, MaterialBits); }
+unsigned int GetSortKeyMesh(SortKey key) { return UnpackField(key, MeshShift, MeshBits); }
+unsigned int GetSortKeyDepth(SortKey key) { return UnpackField(key, DepthShift, DepthBits); }
+
+
+// --------------------------------------------------------
+// Constructor - Starts with an empty queue
+// --------------------------------------------------------
+RenderQueue::RenderQueue()
+	:
+	lastSortPasses(0)
+{
+}
+
+// --------------------------------------------------------
+// Pre-allocates space for a known number of draws so
+// queuing and sorting don't allocate once warmed up
+// --------------------------------------------------------
+void RenderQueue::Reserve(unsigned int drawCount)
+{
+	items.reserve(drawCount);
+	scratch.reserve(drawCount);
+}
+
+// --------------------------------------------------------
+// Removes every queued draw - call once per frame
+// --------------------------------------------------------
+void RenderQueue::Clear()
+{
+	items.clear();
+}
+
+// --------------------------------------------------------
+// Queues a draw
+//
+// key     - From MakeSortKey()
+// payload - Identifies the draw to the caller
+// --------------------------------------------------------
+void RenderQueue::Add(SortKey key, unsigned int payload)
+{
+	DrawItem item;
+	item.key = key;
+	item.payload = payload;
+	items.push_back(item);
+}
+
+// --------------------------------------------------------
+// Sorts the queued draws by key (stable)
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	lastSortPasses = 0;
+	unsigned int count = (unsigned int)items.size();
+	if (count < 2)
+		return;
+
+	// Count every digit's values in a single read of the keys
+	static const unsigned int DigitCount = sizeof(SortKey);
+	unsigned int histograms[DigitCount][256] = {};
+	for (unsigned int i = 0; i < count; i++)
+	{
+		SortKey key = items[i].key;
+		for (unsigned int d = 0; d < DigitCount; d++)
+			histograms[d][(key >> (d * 8)) & 0xFF]++;
+	}
+
+	scratch.resize(count);
+	for (unsigned int d = 0; d < DigitCount; d++)
+	{
+		unsigned int shift = d * 8;
+		unsigned int* histogram = histograms[d];
+
+		// Every key has the same value for this digit,
+		// so this pass wouldn't move anything
+		if (histogram[(items[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		// Turn counts into starting offsets
+		unsigned int offset = 0;
+		for (unsigned int b = 0; b < 256; b++)
+		{
+			unsigned int bucketCount = histogram[b];
+			histogram[b] = offset;
+			offset += bucketCount;
+		}
+
+		// Scatter in order, which keeps equal digits stable
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const DrawItem& item = items[i];
+			scratch[histogram[(item.key >> shift) & 0xFF]++] = item;
+		}
+
+		items.swap(scratch);
+		lastSortPasses++;
+	}
+}
+
+// --------------------------------------------------------
+// Getters for the queued draws (sorted after Sort())
+// --------------------------------------------------------
+unsigned int RenderQueue::GetCount() const { return (unsigned int)items.size(); }
+const std::vector<DrawItem>& RenderQueue::GetItems() const { return items; }
+
+// --------------------------------------------------------
+// How many of the eight radix passes the last Sort()
+// needed - the rest were skipped
+// --------------------------------------------------------
+unsigned int RenderQueue::GetLastSortPasses() const { return lastSortPasses; }
+
+
+// --------------------------------------------------------
+// Constructor - Assumes nothing is bound yet
+// --------------------------------------------------------
+StateCache::StateCache()
+{
+	Reset();
+}
+
+// --------------------------------------------------------
+// Forgets what's bound, so the next set of each kind of
+// state is always applied.  Call whenever something else
+// might have changed the pipeline (or once per frame).
+// --------------------------------------------------------
+void StateCache::Reset()
+{
+	for (unsigned int i = 0; i < SlotCount; i++)
+		bound[i] = Unbound;
+
+	appliedCount = 0;
+	skippedCount = 0;
+}
+
+// --------------------------------------------------------
+// Per-state setters - each returns true if the caller
+// needs to actually bind the new state
+// --------------------------------------------------------
+bool StateCache::SetVertexShader(unsigned int id) { return Set(SlotVertexShader, id); }
+bool StateCache::SetPixelShader(unsigned int id) { return Set(SlotPixelShader, id); }
+bool StateCache::SetInputLayout(unsigned int id) { return Set(SlotInputLayout, id); }
+bool StateCache::SetMaterial(unsigned int id) { return Set(SlotMaterial, id); }
+bool StateCache::SetMesh(unsigned int id) { return Set(SlotMesh, id); }
+
+// --------------------------------------------------------
+// How many state changes were needed and how many were
+// redundant since the last Reset()
+// --------------------------------------------------------
+unsigned long long StateCache::GetAppliedCount() const { return appliedCount; }
+unsigned long long StateCache::GetSkippedCount() const { return skippedCount; }
+
+// --------------------------------------------------------
+// Records a new id for a slot, if it's different
+// --------------------------------------------------------
+bool StateCache::Set(Slot slot, unsigned int id)
+{
+	if (bound[slot] == id)
+	{
+		skippedCount++;
+		return false;
+	}
+
+	bound[slot] = id;
+	appliedCount++;
+	return true;
+}
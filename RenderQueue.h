@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+
+// --------------------------------------------------------
+// 64-bit draw sort keys.  Higher fields take priority, so
+// sorting by key groups draws by layer first, then shader,
+// and so on, with depth breaking ties inside a mesh:
+//
+//   bits 63-60  layer     (16)   - opaque, transparent, UI...
+//   bits 59-50  shader    (1024)
+//   bits 49-44  layout    (64)   - input layout
+//   bits 43-32  material  (4096)
+//   bits 31-20  mesh      (4096)
+//   bits 19-0   depth     (~1M)  - quantized, 0 = nearest
+//
+// Values too large for their field are masked to fit.
+// --------------------------------------------------------
+typedef unsigned long long SortKey;
+
+SortKey MakeSortKey(
+	unsigned int layer,
+	unsigned int shader,
+	unsigned int layout,
+	unsigned int material,
+	unsigned int mesh,
+	float depth);
+
+unsigned int GetSortKeyLayer(SortKey key);
+unsigned int GetSortKeyShader(SortKey key);
+unsigned int GetSortKeyLayout(SortKey key);
+unsigned int GetSortKeyMaterial(SortKey key);
+unsigned int GetSortKeyMesh(SortKey key);
+unsigned int GetSortKeyDepth(SortKey key);
+
+// --------------------------------------------------------
+// A single queued draw: its sort key and an index back into
+// whatever list describes the draw (the payload)
+// --------------------------------------------------------
+struct DrawItem
+{
+	SortKey key;
+	unsigned int payload;
+};
+
+// --------------------------------------------------------
+// Draws queued up for a frame, sorted by key before being
+// submitted.  Sorting is an LSD radix sort on 8-bit digits,
+// which is stable (equal keys keep the order they were
+// added in) and skips any digit that's the same for every
+// key - common, since the upper fields rarely vary much.
+//
+// This has no Direct3D dependencies at all.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	void Reserve(unsigned int drawCount);
+	void Clear();
+	void Add(SortKey key, unsigned int payload);
+	void Sort();
+
+	unsigned int GetCount() const;
+	const std::vector<DrawItem>& GetItems() const;
+	unsigned int GetLastSortPasses() const;
+
+private:
+	std::vector<DrawItem> items;
+	std::vector<DrawItem> scratch;	// Destination of each radix pass
+	unsigned int lastSortPasses;	// Digits the last Sort() actually moved
+};
+
+// --------------------------------------------------------
+// Remembers which resources are currently bound (by id) so
+// redundant state changes can be skipped.  Each setter
+// returns true only when the id differs from what's bound,
+// meaning the caller actually needs to make the API call.
+// --------------------------------------------------------
+class StateCache
+{
+public:
+	StateCache();
+
+	void Reset();
+
+	bool SetVertexShader(unsigned int id);
+	bool SetPixelShader(unsigned int id);
+	bool SetInputLayout(unsigned int id);
+	bool SetMaterial(unsigned int id);
+	bool SetMesh(unsigned int id);
+
+	unsigned long long GetAppliedCount() const;
+	unsigned long long GetSkippedCount() const;
+
+private:
+	enum Slot
+	{
+		SlotVertexShader,
+		SlotPixelShader,
+		SlotInputLayout,
+		SlotMaterial,
+		SlotMesh,
+		SlotCount
+	};
+
+	static const unsigned int Unbound = 0xFFFFFFFF;
+	unsigned int bound[SlotCount];
+
+	// Since the last Reset()
+	unsigned long long appliedCount;
+	unsigned long long skippedCount;
+
+	bool Set(Slot slot, unsigned int id);
+};
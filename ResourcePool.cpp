@@ -0,0 +1,335 @@
+#include "ResourcePool.h"
+#include "Hash.h"
+
+using namespace Microsoft::WRL;
+
+// --------------------------------------------------------
+// Bits per pixel of the formats likely to be pooled (block
+// compressed ones averaged over their blocks) - anything
+// else is guessed at 32
+// --------------------------------------------------------
+static unsigned int GetFormatBits(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_UINT:
+		return 128;
+
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R32G32_TYPELESS:
+	case DXGI_FORMAT_R32G32_FLOAT:
+	case DXGI_FORMAT_R32G8X24_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+		return 64;
+
+	case DXGI_FORMAT_R16G16_TYPELESS:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R16G16_UNORM:
+	case DXGI_FORMAT_R32_TYPELESS:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_R32_UINT:
+	case DXGI_FORMAT_D32_FLOAT:
+	case DXGI_FORMAT_R24G8_TYPELESS:
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+		return 32;
+
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R16_TYPELESS:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_D16_UNORM:
+		return 16;
+
+	case DXGI_FORMAT_R8_TYPELESS:
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC7_UNORM:
+		return 8;
+
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC4_UNORM:
+		return 4;
+
+	default:
+		return 32;
+	}
+}
+
+// --------------------------------------------------------
+// Typeless formats can't have default views
+// --------------------------------------------------------
+static bool IsTypeless(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32_TYPELESS:
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+	case DXGI_FORMAT_R32G32_TYPELESS:
+	case DXGI_FORMAT_R32G8X24_TYPELESS:
+	case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+	case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+	case DXGI_FORMAT_R16G16_TYPELESS:
+	case DXGI_FORMAT_R32_TYPELESS:
+	case DXGI_FORMAT_R24G8_TYPELESS:
+	case DXGI_FORMAT_R8G8_TYPELESS:
+	case DXGI_FORMAT_R16_TYPELESS:
+	case DXGI_FORMAT_R8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+// --------------------------------------------------------
+// Constructor
+//
+// device        - Creates the resources
+// maxIdleFrames - How many frames a released resource is
+//                 kept without being asked for again
+// --------------------------------------------------------
+ResourcePool::ResourcePool(ComPtr<ID3D11Device> device, unsigned int maxIdleFrames)
+	:
+	device(device),
+	recycler(maxIdleFrames)
+{
+}
+
+// --------------------------------------------------------
+// Roughly how much memory a texture takes, mips, array
+// slices and samples included (drivers add their own
+// padding and alignment on top)
+// --------------------------------------------------------
+size_t ResourcePool::EstimateTextureBytes(const D3D11_TEXTURE2D_DESC& desc)
+{
+	// Zero mip levels means the whole chain
+	unsigned int mipLevels = desc.MipLevels;
+	if (mipLevels == 0)
+	{
+		unsigned int largest = desc.Width > desc.Height ? desc.Width : desc.Height;
+		mipLevels = 1;
+		while (largest > 1)
+		{
+			largest >>= 1;
+			mipLevels++;
+		}
+	}
+
+	size_t pixels = 0;
+	for (unsigned int mip = 0; mip < mipLevels; mip++)
+	{
+		size_t width = desc.Width >> mip;
+		size_t height = desc.Height >> mip;
+		pixels += (width > 0 ? width : 1) * (height > 0 ? height : 1);
+	}
+
+	size_t samples = desc.SampleDesc.Count > 0 ? desc.SampleDesc.Count : 1;
+	return pixels * GetFormatBits(desc.Format) / 8 * desc.ArraySize * samples;
+}
+
+// --------------------------------------------------------
+// Hands out a texture matching a description - a released
+// one if there is one, or a new one.  Returns
+// InvalidResourceHandle if it can't be created.
+// --------------------------------------------------------
+ResourceHandle ResourcePool::AcquireTexture(const D3D11_TEXTURE2D_DESC& desc)
+{
+	unsigned long long key = Fnv1a64(&desc, sizeof(desc));
+	ResourceHandle handle = recycler.Reuse(key, &desc, sizeof(desc));
+	if (handle != InvalidResourceHandle)
+		return handle;
+
+	Resources added;
+	device->CreateTexture2D(&desc, 0, added.texture.GetAddressOf());
+	if (!added.texture)
+		return InvalidResourceHandle;
+
+	// Default views for however it's bound
+	if (!IsTypeless(desc.Format))
+	{
+		if (desc.BindFlags & D3D11_BIND_RENDER_TARGET)
+			device->CreateRenderTargetView(added.texture.Get(), 0, added.rtv.GetAddressOf());
+		if (desc.BindFlags & D3D11_BIND_DEPTH_STENCIL)
+			device->CreateDepthStencilView(added.texture.Get(), 0, added.dsv.GetAddressOf());
+		if (desc.BindFlags & D3D11_BIND_SHADER_RESOURCE)
+			device->CreateShaderResourceView(added.texture.Get(), 0, added.srv.GetAddressOf());
+	}
+
+	return AddResources(key, &desc, sizeof(desc), EstimateTextureBytes(desc), added);
+}
+
+// --------------------------------------------------------
+// Hands out a buffer matching a description, the same way
+// as AcquireTexture()
+// --------------------------------------------------------
+ResourceHandle ResourcePool::AcquireBuffer(const D3D11_BUFFER_DESC& desc)
+{
+	unsigned long long key = Fnv1a64(&desc, sizeof(desc));
+	ResourceHandle handle = recycler.Reuse(key, &desc, sizeof(desc));
+	if (handle != InvalidResourceHandle)
+		return handle;
+
+	Resources added;
+	device->CreateBuffer(&desc, 0, added.buffer.GetAddressOf());
+	if (!added.buffer)
+		return InvalidResourceHandle;
+
+	if (desc.BindFlags & D3D11_BIND_SHADER_RESOURCE)
+		device->CreateShaderResourceView(added.buffer.Get(), 0, added.srv.GetAddressOf());
+
+	return AddResources(key, &desc, sizeof(desc), desc.ByteWidth, added);
+}
+
+// --------------------------------------------------------
+// Gives a resource back to the pool, for whoever asks for
+// the same description next.  The handle can't be used
+// after this.
+// --------------------------------------------------------
+void ResourcePool::Release(ResourceHandle handle)
+{
+	recycler.Release(handle);
+}
+
+// --------------------------------------------------------
+// An acquired resource and its views (null for an invalid
+// handle, or views it wasn't bound for)
+// --------------------------------------------------------
+ComPtr<ID3D11Texture2D> ResourcePool::GetTexture(ResourceHandle handle) const
+{
+	return handle < resources.size() ? resources[handle].texture : 0;
+}
+
+ComPtr<ID3D11Buffer> ResourcePool::GetBuffer(ResourceHandle handle) const
+{
+	return handle < resources.size() ? resources[handle].buffer : 0;
+}
+
+ComPtr<ID3D11RenderTargetView> ResourcePool::GetRenderTargetView(ResourceHandle handle) const
+{
+	return handle < resources.size() ? resources[handle].rtv : 0;
+}
+
+ComPtr<ID3D11DepthStencilView> ResourcePool::GetDepthStencilView(ResourceHandle handle) const
+{
+	return handle < resources.size() ? resources[handle].dsv : 0;
+}
+
+ComPtr<ID3D11ShaderResourceView> ResourcePool::GetShaderResourceView(ResourceHandle handle) const
+{
+	return handle < resources.size() ? resources[handle].srv : 0;
+}
+
+// --------------------------------------------------------
+// Counts a frame, evicting whatever's been released and
+// not asked for again in too long
+// --------------------------------------------------------
+void ResourcePool::BeginFrame()
+{
+	recycler.BeginFrame(evicted);
+	FreeEvicted();
+}
+
+// --------------------------------------------------------
+// Evicts every resource that isn't in use, returning how
+// many there were
+// --------------------------------------------------------
+unsigned int ResourcePool::EvictUnused()
+{
+	unsigned int count = recycler.EvictUnused(evicted);
+	FreeEvicted();
+	return count;
+}
+
+// --------------------------------------------------------
+// Adds a texture that's only needed for some of a frame's
+// uses, returning its id for GetTransient()
+//
+// desc     - What it needs to be
+// firstUse - First use (pass) that needs it
+// lastUse  - Last use that needs it (inclusive)
+// --------------------------------------------------------
+TransientId ResourcePool::DeclareTransientTexture(const D3D11_TEXTURE2D_DESC& desc, unsigned int firstUse, unsigned int lastUse)
+{
+	transientDescs.push_back(desc);
+	return transients.Declare(Fnv1a64(&desc, sizeof(desc)), EstimateTextureBytes(desc), firstUse, lastUse);
+}
+
+// --------------------------------------------------------
+// Works out which transients can share a texture, and
+// acquires one for each group.  Returns how many textures
+// that took.
+// --------------------------------------------------------
+unsigned int ResourcePool::AllocateTransients()
+{
+	unsigned int slotCount = transients.Allocate();
+	slotResources.assign(slotCount, InvalidResourceHandle);
+
+	for (TransientId t = 0; t < transients.GetTransientCount(); t++)
+	{
+		unsigned int slot = transients.GetSlot(t);
+		if (slotResources[slot] == InvalidResourceHandle)
+			slotResources[slot] = AcquireTexture(transientDescs[t]);
+	}
+
+	return slotCount;
+}
+
+// --------------------------------------------------------
+// The texture a transient got from AllocateTransients() -
+// which others may share, outside of its uses
+// --------------------------------------------------------
+ResourceHandle ResourcePool::GetTransient(TransientId transient) const
+{
+	return slotResources[transients.GetSlot(transient)];
+}
+
+// --------------------------------------------------------
+// Releases every transient's texture back to the pool,
+// where next frame's transients will most likely find them
+// --------------------------------------------------------
+void ResourcePool::ReleaseTransients()
+{
+	for (unsigned int i = 0; i < slotResources.size(); i++)
+		Release(slotResources[i]);
+
+	slotResources.clear();
+	transientDescs.clear();
+	transients.Clear();
+}
+
+const TransientAllocator& ResourcePool::GetTransientAllocator() const { return transients; }
+const ResourcePoolStats& ResourcePool::GetStats() const { return recycler.GetStats(); }
+
+// --------------------------------------------------------
+// Records newly created resources with the recycler, and
+// keeps them under the handle it gives them
+// --------------------------------------------------------
+ResourceHandle ResourcePool::AddResources(unsigned long long key, const void* desc, size_t descSize, size_t bytes, Resources& added)
+{
+	ResourceHandle handle = recycler.Add(key, desc, descSize, bytes);
+	if (handle >= resources.size())
+		resources.resize(handle + 1);
+
+	resources[handle] = added;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Frees the resources the recycler just evicted
+// --------------------------------------------------------
+void ResourcePool::FreeEvicted()
+{
+	for (unsigned int i = 0; i < evicted.size(); i++)
+		resources[evicted[i]] = Resources();
+
+	evicted.clear();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <d3d11.h>
+#include <vector>
+#include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+
+#include "ResourceRecycler.h"
+#include "TransientAllocator.h"
+
+// --------------------------------------------------------
+// Textures and buffers, handed out by description and kept
+// after they're released so the next request for the same
+// description doesn't have to create anything.
+//
+// Resources are looked up by a hash of their description
+// (then compared in full), and come with default views for
+// whatever they're bound as - render target, depth stencil
+// and shader resource (except for typeless formats, which
+// need views of their own).
+//
+// Released resources are evicted once they've gone unused
+// for a number of frames (counted by BeginFrame()), or all
+// at once by EvictUnused() - after a resize, say, when
+// whatever was sized for the old window won't be asked for
+// again.  Which ones to reuse and evict is worked out by a
+// ResourceRecycler, leaving this to create and free them.
+//
+// Transient textures only live for part of a frame, like a
+// render graph's intermediate targets.  Each is declared with
+// the range of uses (passes) that need it, and ones whose
+// ranges don't overlap share a texture where their
+// descriptions match (see TransientAllocator) - Direct3D 11
+// can't place different resources in the same memory, so
+// sharing means the same resource.
+//
+//   DeclareTransientTexture()... -> AllocateTransients()
+//     -> GetTransient() while drawing -> ReleaseTransients()
+// --------------------------------------------------------
+class ResourcePool
+{
+public:
+	ResourcePool(Microsoft::WRL::ComPtr<ID3D11Device> device, unsigned int maxIdleFrames);
+
+	static size_t EstimateTextureBytes(const D3D11_TEXTURE2D_DESC& desc);
+
+	ResourceHandle AcquireTexture(const D3D11_TEXTURE2D_DESC& desc);
+	ResourceHandle AcquireBuffer(const D3D11_BUFFER_DESC& desc);
+	void Release(ResourceHandle handle);
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> GetTexture(ResourceHandle handle) const;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetBuffer(ResourceHandle handle) const;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> GetRenderTargetView(ResourceHandle handle) const;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> GetDepthStencilView(ResourceHandle handle) const;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetShaderResourceView(ResourceHandle handle) const;
+
+	void BeginFrame();
+	unsigned int EvictUnused();
+
+	TransientId DeclareTransientTexture(const D3D11_TEXTURE2D_DESC& desc, unsigned int firstUse, unsigned int lastUse);
+	unsigned int AllocateTransients();
+	ResourceHandle GetTransient(TransientId transient) const;
+	void ReleaseTransients();
+	const TransientAllocator& GetTransientAllocator() const;
+
+	const ResourcePoolStats& GetStats() const;
+
+private:
+	// What the recycler's handles refer to
+	struct Resources
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv;
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+
+	// Indexed by handle
+	ResourceRecycler recycler;
+	std::vector<Resources> resources;
+	std::vector<ResourceHandle> evicted;
+
+	// This frame's transients - their descriptions, and the
+	// resource each slot got
+	TransientAllocator transients;
+	std::vector<D3D11_TEXTURE2D_DESC> transientDescs;
+	std::vector<ResourceHandle> slotResources;
+
+	ResourceHandle AddResources(unsigned long long key, const void* desc, size_t descSize, size_t bytes, Resources& added);
+	void FreeEvicted();
+};
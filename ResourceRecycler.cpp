@@ -0,0 +1,173 @@
+#include "ResourceRecycler.h"
+
+#include <cstring>
+
+// --------------------------------------------------------
+// Constructor
+//
+// maxIdleFrames - How many frames a released resource is
+//                 kept without being asked for again
+// --------------------------------------------------------
+ResourceRecycler::ResourceRecycler(unsigned int maxIdleFrames)
+	:
+	maxIdleFrames(maxIdleFrames),
+	frameNumber(0)
+{
+}
+
+// --------------------------------------------------------
+// Takes a released resource with a matching description out
+// of the available ones, marking it in use.  Returns
+// InvalidResourceHandle if there isn't one, for the caller
+// to create a resource and Add() it.
+//
+// key      - Hash of the description
+// desc     - The description, compared in full
+// descSize - Its size in bytes
+// --------------------------------------------------------
+ResourceHandle ResourceRecycler::Reuse(unsigned long long key, const void* desc, size_t descSize)
+{
+	auto range = available.equal_range(key);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		Entry& entry = entries[it->second];
+		if (entry.desc.size() == descSize && memcmp(entry.desc.data(), desc, descSize) == 0)
+		{
+			ResourceHandle handle = it->second;
+			available.erase(it);
+
+			entry.inUse = true;
+			stats.inUseCount++;
+			stats.reusedCount++;
+			return handle;
+		}
+	}
+
+	return InvalidResourceHandle;
+}
+
+// --------------------------------------------------------
+// Records a newly created resource, in use, in an evicted
+// one's handle if there is one
+//
+// key      - Hash of the description
+// desc     - The description, copied for Reuse()
+// descSize - Its size in bytes
+// bytes    - The resource's size, for the stats
+// --------------------------------------------------------
+ResourceHandle ResourceRecycler::Add(unsigned long long key, const void* desc, size_t descSize, size_t bytes)
+{
+	ResourceHandle handle;
+	if (!evictedHandles.empty())
+	{
+		handle = evictedHandles.back();
+		evictedHandles.pop_back();
+	}
+	else
+	{
+		handle = (ResourceHandle)entries.size();
+		entries.push_back(Entry());
+	}
+
+	Entry& entry = entries[handle];
+	entry.key = key;
+	entry.desc.assign((const unsigned char*)desc, (const unsigned char*)desc + descSize);
+	entry.bytes = bytes;
+	entry.inUse = true;
+	entry.lastUsedFrame = frameNumber;
+
+	stats.resourceCount++;
+	stats.inUseCount++;
+	stats.pooledBytes += bytes;
+	stats.createdCount++;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Makes a resource available to whoever asks for the same
+// description next.  Returns false for a handle that isn't
+// in use.
+// --------------------------------------------------------
+bool ResourceRecycler::Release(ResourceHandle handle)
+{
+	if (handle >= entries.size() || !entries[handle].inUse)
+		return false;
+
+	Entry& entry = entries[handle];
+	entry.inUse = false;
+	entry.lastUsedFrame = frameNumber;
+	available.insert(std::make_pair(entry.key, handle));
+	stats.inUseCount--;
+	return true;
+}
+
+bool ResourceRecycler::IsInUse(ResourceHandle handle) const
+{
+	return handle < entries.size() && entries[handle].inUse;
+}
+
+// --------------------------------------------------------
+// Counts a frame, evicting whatever's been released and
+// not asked for again in too long
+//
+// evicted - Has each evicted handle appended, for the
+//           caller to free its resource
+// --------------------------------------------------------
+void ResourceRecycler::BeginFrame(std::vector<ResourceHandle>& evicted)
+{
+	frameNumber++;
+
+	for (auto it = available.begin(); it != available.end();)
+	{
+		if (frameNumber - entries[it->second].lastUsedFrame > maxIdleFrames)
+		{
+			evicted.push_back(it->second);
+			Evict(it->second);
+			it = available.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Evicts every resource that isn't in use, appending their
+// handles to evicted and returning how many there were
+// --------------------------------------------------------
+unsigned int ResourceRecycler::EvictUnused(std::vector<ResourceHandle>& evicted)
+{
+	unsigned int count = (unsigned int)available.size();
+	for (auto it = available.begin(); it != available.end(); ++it)
+	{
+		evicted.push_back(it->second);
+		Evict(it->second);
+	}
+
+	available.clear();
+	return count;
+}
+
+// --------------------------------------------------------
+// One more than the highest handle handed out so far, for
+// sizing whatever the caller keeps per handle
+// --------------------------------------------------------
+unsigned int ResourceRecycler::GetHandleCount() const { return (unsigned int)entries.size(); }
+unsigned long long ResourceRecycler::GetFrameNumber() const { return frameNumber; }
+const ResourcePoolStats& ResourceRecycler::GetStats() const { return stats; }
+
+// --------------------------------------------------------
+// Forgets a released resource (the caller takes it out of
+// the available ones)
+// --------------------------------------------------------
+void ResourceRecycler::Evict(ResourceHandle handle)
+{
+	Entry& entry = entries[handle];
+	stats.resourceCount--;
+	stats.pooledBytes -= entry.bytes;
+	stats.evictedCount++;
+
+	entry = Entry();
+	evictedHandles.push_back(handle);
+}
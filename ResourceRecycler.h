@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+// Which pooled resource - an index, reused once evicted
+typedef unsigned int ResourceHandle;
+static const ResourceHandle InvalidResourceHandle = 0xFFFFFFFF;
+
+// --------------------------------------------------------
+// Totals since the pool was created (counts) and right now
+// (resources and bytes)
+// --------------------------------------------------------
+struct ResourcePoolStats
+{
+	unsigned int resourceCount = 0;
+	unsigned int inUseCount = 0;
+	size_t pooledBytes = 0;					// Estimated, for every resource the pool holds
+	unsigned long long createdCount = 0;
+	unsigned long long reusedCount = 0;		// Acquires that didn't need to create anything
+	unsigned long long evictedCount = 0;
+};
+
+// --------------------------------------------------------
+// The bookkeeping behind a resource pool - which resources
+// exist, which are in use, which released ones match a
+// request, and which have gone unused for long enough to
+// evict - without the resources themselves.
+//
+// Each resource is added with its description (any plain
+// struct, copied and compared byte for byte) and a hash of
+// it to look it up by.  Reuse() hands back a released one
+// whose description matches, and whoever holds the actual
+// resources frees the ones BeginFrame() and EvictUnused()
+// report as evicted.  Their handles are then given to the
+// next resources added.
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+class ResourceRecycler
+{
+public:
+	ResourceRecycler(unsigned int maxIdleFrames);
+
+	ResourceHandle Reuse(unsigned long long key, const void* desc, size_t descSize);
+	ResourceHandle Add(unsigned long long key, const void* desc, size_t descSize, size_t bytes);
+	bool Release(ResourceHandle handle);
+	bool IsInUse(ResourceHandle handle) const;
+
+	void BeginFrame(std::vector<ResourceHandle>& evicted);
+	unsigned int EvictUnused(std::vector<ResourceHandle>& evicted);
+
+	unsigned int GetHandleCount() const;
+	unsigned long long GetFrameNumber() const;
+	const ResourcePoolStats& GetStats() const;
+
+private:
+	struct Entry
+	{
+		unsigned long long key;			// Hash of the description
+		std::vector<unsigned char> desc;
+		size_t bytes;
+		bool inUse;
+		unsigned long long lastUsedFrame;
+	};
+
+	unsigned int maxIdleFrames;
+	unsigned long long frameNumber;
+
+	// Indexed by handle, with evicted slots reused
+	std::vector<Entry> entries;
+	std::vector<ResourceHandle> evictedHandles;
+
+	// Released resources, by key
+	std::unordered_multimap<unsigned long long, ResourceHandle> available;
+
+	ResourcePoolStats stats;
+
+	void Evict(ResourceHandle handle);
+};
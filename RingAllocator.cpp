@@ -0,0 +1,158 @@
+#include "RingAllocator.h"
+
+// --------------------------------------------------------
+// Constructor
+//
+// capacity - Bytes in the buffer being allocated from
+// --------------------------------------------------------
+RingAllocator::RingAllocator(size_t capacity)
+{
+	Reset(capacity);
+}
+
+// --------------------------------------------------------
+// Frees everything and forgets every frame, like it had
+// just been created
+// --------------------------------------------------------
+void RingAllocator::Reset(size_t capacity)
+{
+	this->capacity = capacity;
+	head = 0;
+	tail = 0;
+	used = 0;
+	frameBytes = 0;
+	frames.clear();
+	stats = RingAllocatorStats();
+}
+
+// --------------------------------------------------------
+// Reserves a range for the current frame, and returns its
+// offset (or InvalidRingOffset if there isn't room until
+// more frames retire)
+//
+// size      - Bytes needed
+// alignment - What the offset must be a multiple of (a
+//             power of two)
+// --------------------------------------------------------
+size_t RingAllocator::Allocate(size_t size, size_t alignment)
+{
+	if (alignment == 0)
+		alignment = 1;
+
+	// Nothing in use, so start over at the front, where
+	// there's the most room (any frames still in flight are
+	// empty, and RetireFront() skips those)
+	if (used == 0)
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	size_t offset = (head + alignment - 1) & ~(alignment - 1);
+	size_t newHead = 0;
+
+	if (head < tail || (head == tail && used > 0))
+	{
+		// Wrapped already - the only free space is up to the tail
+		if (offset + size > tail)
+			offset = InvalidRingOffset;
+		else
+			newHead = offset + size;
+	}
+	else if (offset + size > capacity)
+	{
+		// Doesn't fit before the end, so skip to the start
+		// (which is always aligned)
+		offset = 0;
+		if (size > tail)
+			offset = InvalidRingOffset;
+		else
+			newHead = size;
+	}
+	else
+	{
+		newHead = offset + size;
+	}
+
+	if (offset == InvalidRingOffset || size > capacity)
+	{
+		stats.failedCount++;
+		return InvalidRingOffset;
+	}
+
+	// Whatever gets skipped over stays in use until this frame
+	// retires, wrapping included
+	size_t consumed = newHead >= head ? newHead - head : (capacity - head) + newHead;
+	used += consumed;
+	frameBytes += consumed;
+	head = newHead;
+
+	stats.allocationCount++;
+	stats.allocatedBytes += size;
+	stats.paddingBytes += consumed - size;
+	return offset;
+}
+
+// --------------------------------------------------------
+// Ends the current frame.  Its ranges stay in use until a
+// Retire() with a fence at least this one.
+//
+// fence - Signaled once the frame's ranges can be reused
+// --------------------------------------------------------
+void RingAllocator::EndFrame(unsigned long long fence)
+{
+	Frame frame;
+	frame.fence = fence;
+	frame.end = head;
+	frame.bytes = frameBytes;
+	frames.push_back(frame);
+
+	if (frameBytes > stats.peakFrameBytes)
+		stats.peakFrameBytes = frameBytes;
+	frameBytes = 0;
+}
+
+// --------------------------------------------------------
+// Frees every ended frame whose fence has been reached
+// --------------------------------------------------------
+void RingAllocator::Retire(unsigned long long completedFence)
+{
+	while (!frames.empty() && frames.front().fence <= completedFence)
+		RetireFront();
+}
+
+// --------------------------------------------------------
+// Frees the oldest ended frame, whatever its fence - for
+// once the caller has waited on it.  False if there were
+// no ended frames.
+// --------------------------------------------------------
+bool RingAllocator::RetireOldest()
+{
+	if (frames.empty())
+		return false;
+
+	RetireFront();
+	return true;
+}
+
+// --------------------------------------------------------
+// Frees the oldest ended frame.  One that allocated nothing
+// has nothing to free, and leaves the tail alone - its end
+// may be from before Allocate() last started over at the
+// front.
+// --------------------------------------------------------
+void RingAllocator::RetireFront()
+{
+	const Frame& frame = frames.front();
+	if (frame.bytes > 0)
+		tail = frame.end;
+	used -= frame.bytes;
+	frames.pop_front();
+}
+
+size_t RingAllocator::GetCapacity() const { return capacity; }
+size_t RingAllocator::GetUsedBytes() const { return used; }
+size_t RingAllocator::GetFrameBytes() const { return frameBytes; }
+unsigned int RingAllocator::GetFramesInFlight() const { return (unsigned int)frames.size(); }
+unsigned long long RingAllocator::GetOldestFence() const { return frames.empty() ? 0 : frames.front().fence; }
+const RingAllocatorStats& RingAllocator::GetStats() const { return stats; }
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+
+// What Allocate() returns when there's no room
+static const size_t InvalidRingOffset = (size_t)-1;
+
+// --------------------------------------------------------
+// Totals since the allocator was last reset
+// --------------------------------------------------------
+struct RingAllocatorStats
+{
+	unsigned long long allocationCount = 0;
+	unsigned long long allocatedBytes = 0;	// Requested sizes
+	unsigned long long paddingBytes = 0;	// Lost to alignment and wrapping around
+	unsigned long long failedCount = 0;		// Allocations that didn't fit
+	size_t peakFrameBytes = 0;				// Most any one frame used, padding included
+};
+
+// --------------------------------------------------------
+// Hands out ranges of a fixed-size buffer, front to back,
+// wrapping around to the start when it reaches the end.
+// Only offsets are managed here - the memory itself is
+// whoever's using it.
+//
+// Ranges are freed a frame at a time: EndFrame() tags every
+// allocation since the last one with a fence value (which
+// should increase every frame), and Retire() frees frames
+// up to a fence once whatever was reading them - like the
+// GPU - has finished with them.  Until then, their ranges
+// are never handed out again.
+//
+// Allocations are never split across the end of the
+// buffer, so one may skip its unused tail.
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+class RingAllocator
+{
+public:
+	RingAllocator(size_t capacity = 0);
+
+	void Reset(size_t capacity);
+	size_t Allocate(size_t size, size_t alignment);
+
+	void EndFrame(unsigned long long fence);
+	void Retire(unsigned long long completedFence);
+	bool RetireOldest();
+
+	size_t GetCapacity() const;
+	size_t GetUsedBytes() const;
+	size_t GetFrameBytes() const;
+	unsigned int GetFramesInFlight() const;
+	unsigned long long GetOldestFence() const;
+	const RingAllocatorStats& GetStats() const;
+
+private:
+	// A frame that's ended but not yet retired
+	struct Frame
+	{
+		unsigned long long fence;
+		size_t end;		// Where the ring's head was when it ended
+		size_t bytes;	// Used by the frame, padding included
+	};
+
+	size_t capacity;
+	size_t head;		// Where the next allocation goes
+	size_t tail;		// Start of the oldest range still in use
+	size_t used;		// Bytes between tail and head, padding included
+	size_t frameBytes;	// Used since the last EndFrame()
+	std::deque<Frame> frames;
+
+	RingAllocatorStats stats;
+
+	void RetireFront();
+};
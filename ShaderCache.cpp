@@ -0,0 +1,479 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+typedef std::chrono::steady_clock ShaderClock;
+
+// --------------------------------------------------------
+// A stamp that changes whenever a file is written - its
+// last write time and size, hashed together.  Returns false
+// if the file doesn't exist.
+// --------------------------------------------------------
+static bool GetFileVersion(const std::string& path, unsigned long long& version)
+{
+	unsigned long long stamp[2];
+
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info))
+		return false;
+
+	stamp[0] = ((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+	stamp[1] = ((unsigned long long)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+
+	stamp[0] = (unsigned long long)info.st_mtim.tv_sec * 1000000000ull + (unsigned long long)info.st_mtim.tv_nsec;
+	stamp[1] = (unsigned long long)info.st_size;
+#endif
+
+	version = Fnv1a64(stamp, sizeof(stamp));
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads a whole file into memory.  Returns false if it
+// doesn't exist or is empty.
+// --------------------------------------------------------
+static bool ReadWholeFile(const std::string& path, std::vector<unsigned char>& bytes)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	std::streamoff size = file.tellg();
+	if (size <= 0)
+		return false;
+
+	bytes.resize((size_t)size);
+	file.seekg(0);
+	return (bool)file.read((char*)bytes.data(), size);
+}
+
+static unsigned int ReadUint32(const unsigned char* bytes)
+{
+	unsigned int value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+// --------------------------------------------------------
+// Finds a chunk in a compiled shader.  Shaders (from fxc and
+// dxc alike) are DXBC containers: "DXBC", a 16 byte checksum,
+// a version, the total size, the chunk count and an offset
+// for each chunk.  Chunks start with a four character code
+// and their size.  Returns false if there's no such chunk,
+// or the data isn't a container.
+// --------------------------------------------------------
+static bool FindDxbcChunk(
+	const void* data,
+	size_t size,
+	const char* fourCC,
+	const unsigned char*& chunk,
+	unsigned int& chunkSize)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	if (size < 32 || memcmp(bytes, "DXBC", 4) != 0)
+		return false;
+
+	unsigned int chunkCount = ReadUint32(bytes + 28);
+	if (chunkCount > (size - 32) / 4)
+		return false;
+
+	for (unsigned int i = 0; i < chunkCount; i++)
+	{
+		unsigned int offset = ReadUint32(bytes + 32 + i * 4);
+		if (offset > size - 8 || memcmp(bytes + offset, fourCC, 4) != 0)
+			continue;
+
+		chunkSize = ReadUint32(bytes + offset + 4);
+		if (chunkSize > size - offset - 8)
+			return false;
+
+		chunk = bytes + offset + 8;
+		return true;
+	}
+
+	return false;
+}
+
+// --------------------------------------------------------
+// Whether a file looks completely written - a container's
+// size has to match the one in its header (anything else
+// is taken as is)
+// --------------------------------------------------------
+static bool IsCompleteBytecode(const std::vector<unsigned char>& bytes)
+{
+	if (bytes.size() < 32 || memcmp(bytes.data(), "DXBC", 4) != 0)
+		return !bytes.empty();
+
+	return ReadUint32(&bytes[24]) == bytes.size();
+}
+
+// --------------------------------------------------------
+// Constructor - Loads from the current directory until
+// told otherwise
+// --------------------------------------------------------
+ShaderCache::ShaderCache()
+	:
+	watching(false),
+	stopWatching(false),
+	watchIntervalMs(250)
+{
+}
+
+// --------------------------------------------------------
+// Destructor - Stops the watcher, if it's running
+// --------------------------------------------------------
+ShaderCache::~ShaderCache()
+{
+	StopWatching();
+}
+
+// --------------------------------------------------------
+// The file a shader permutation is compiled to
+// --------------------------------------------------------
+std::string ShaderCache::GetFileName(const std::string& name, unsigned int permutation)
+{
+	if (permutation == 0)
+		return name + ".cso";
+
+	char suffix[16];
+	snprintf(suffix, sizeof(suffix), "_%x.cso", permutation);
+	return name + suffix;
+}
+
+// --------------------------------------------------------
+// Where later Load() calls look for files
+// --------------------------------------------------------
+void ShaderCache::SetDirectory(const std::string& directory)
+{
+	this->directory = directory;
+	if (!directory.empty() && directory.back() != '/' && directory.back() != '\\')
+		this->directory += '/';
+}
+
+const std::string& ShaderCache::GetDirectory() const { return directory; }
+
+// --------------------------------------------------------
+// Loads a shader, or finds it if it's already loaded.
+// Returns InvalidShaderId if its file can't be read.
+//
+// name        - The shader's file name, without ".cso"
+// permutation - Which permutation of it (see GetFileName())
+// --------------------------------------------------------
+ShaderId ShaderCache::Load(const std::string& name, unsigned int permutation)
+{
+	std::string fileName = GetFileName(name, permutation);
+	auto existing = shaderIds.find(fileName);
+	if (existing != shaderIds.end())
+		return existing->second;
+
+	ShaderClock::time_point start = ShaderClock::now();
+
+	std::string path = directory + fileName;
+	unsigned long long fileVersion;
+	if (!GetFileVersion(path, fileVersion))
+		return InvalidShaderId;
+
+	std::unique_ptr<Bytecode> bytecode(new Bytecode());
+	if (!watching && bytecode->file.Open(path))
+	{
+		bytecode->data = bytecode->file.GetData();
+		bytecode->size = bytecode->file.GetSize();
+		stats.mappedBytes += bytecode->size;
+	}
+	else if (ReadWholeFile(path, bytecode->copy))
+	{
+		bytecode->data = bytecode->copy.data();
+		bytecode->size = bytecode->copy.size();
+		stats.readBytes += bytecode->size;
+	}
+	else
+		return InvalidShaderId;
+
+	Shader shader;
+	shader.name = name;
+	shader.permutation = permutation;
+	shader.path = path;
+	shader.bytecode = AddBytecode(std::move(bytecode));
+	shader.fileVersion = fileVersion;
+
+	ShaderId id = (ShaderId)shaders.size();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		shaders.push_back(shader);
+	}
+	shaderIds[fileName] = id;
+
+	stats.shaderCount++;
+	stats.loadMs += std::chrono::duration<double, std::milli>(ShaderClock::now() - start).count();
+	return id;
+}
+
+// --------------------------------------------------------
+// Finds an already loaded shader, or InvalidShaderId
+// --------------------------------------------------------
+ShaderId ShaderCache::Find(const std::string& name, unsigned int permutation) const
+{
+	auto existing = shaderIds.find(GetFileName(name, permutation));
+	return existing != shaderIds.end() ? existing->second : InvalidShaderId;
+}
+
+// --------------------------------------------------------
+// Getters for a loaded shader
+// --------------------------------------------------------
+unsigned int ShaderCache::GetShaderCount() const { return (unsigned int)shaders.size(); }
+const std::string& ShaderCache::GetName(ShaderId shader) const { return shaders[shader].name; }
+unsigned int ShaderCache::GetPermutation(ShaderId shader) const { return shaders[shader].permutation; }
+const void* ShaderCache::GetBytecode(ShaderId shader) const { return bytecodes[shaders[shader].bytecode]->data; }
+size_t ShaderCache::GetBytecodeSize(ShaderId shader) const { return bytecodes[shaders[shader].bytecode]->size; }
+unsigned long long ShaderCache::GetBytecodeHash(ShaderId shader) const { return bytecodes[shaders[shader].bytecode]->hash; }
+unsigned long long ShaderCache::GetInputSignatureHash(ShaderId shader) const { return bytecodes[shaders[shader].bytecode]->signatureHash; }
+unsigned int ShaderCache::GetBytecodeIndex(ShaderId shader) const { return shaders[shader].bytecode; }
+unsigned int ShaderCache::GetBytecodeIndexCount() const { return (unsigned int)bytecodes.size(); }
+bool ShaderCache::IsBytecodeLoaded(unsigned int index) const { return bytecodes[index] != 0; }
+bool ShaderCache::IsWatching() const { return watching; }
+const ShaderCacheStats& ShaderCache::GetStats() const { return stats; }
+
+// --------------------------------------------------------
+// Takes new bytecode, unless identical bytecode is already
+// loaded, and returns the index of whichever is kept
+// --------------------------------------------------------
+unsigned int ShaderCache::AddBytecode(std::unique_ptr<Bytecode> bytecode)
+{
+	// Compilers already checksum the rest of a container into
+	// its header, which saves hashing the whole thing again
+	const unsigned char* bytes = (const unsigned char*)bytecode->data;
+	if (bytecode->size >= 32 && memcmp(bytes, "DXBC", 4) == 0)
+		bytecode->hash = Fnv1a64(bytes + 4, 16, Fnv1a64(&bytecode->size, sizeof(bytecode->size)));
+	else
+		bytecode->hash = Fnv1a64(bytecode->data, bytecode->size);
+
+	auto range = bytecodesByHash.equal_range(bytecode->hash);
+	for (auto i = range.first; i != range.second; ++i)
+	{
+		Bytecode& existing = *bytecodes[i->second];
+		if (existing.size == bytecode->size && memcmp(existing.data, bytecode->data, bytecode->size) == 0)
+		{
+			existing.references++;
+			stats.duplicateCount++;
+			return i->second;
+		}
+	}
+
+	// Input layouts are checked against the input signature
+	// (SM 5.1 shaders call it ISG1), so that's all they depend on
+	const unsigned char* signature;
+	unsigned int signatureSize;
+	if (FindDxbcChunk(bytecode->data, bytecode->size, "ISGN", signature, signatureSize) ||
+		FindDxbcChunk(bytecode->data, bytecode->size, "ISG1", signature, signatureSize))
+		bytecode->signatureHash = Fnv1a64(signature, signatureSize);
+	else
+		bytecode->signatureHash = bytecode->hash;
+
+	bytecode->references = 1;
+	unsigned int index = (unsigned int)bytecodes.size();
+	bytecodesByHash.insert(std::make_pair(bytecode->hash, index));
+	bytecodes.push_back(std::move(bytecode));
+	stats.bytecodeCount++;
+	return index;
+}
+
+// --------------------------------------------------------
+// Drops one shader's use of some bytecode, freeing it once
+// no shader uses it
+// --------------------------------------------------------
+void ShaderCache::ReleaseBytecode(unsigned int index)
+{
+	Bytecode& bytecode = *bytecodes[index];
+	if (--bytecode.references > 0)
+		return;
+
+	auto range = bytecodesByHash.equal_range(bytecode.hash);
+	for (auto i = range.first; i != range.second; ++i)
+	{
+		if (i->second == index)
+		{
+			bytecodesByHash.erase(i);
+			break;
+		}
+	}
+
+	bytecodes[index].reset();
+	stats.bytecodeCount--;
+}
+
+// --------------------------------------------------------
+// Starts a thread that checks every so often for shader
+// files that have changed.  Mapped files are copied and
+// unmapped first, so they can be written again.
+//
+// intervalMs - How long to wait between checks
+// --------------------------------------------------------
+void ShaderCache::StartWatching(unsigned int intervalMs)
+{
+	StopWatching();
+
+	for (unsigned int i = 0; i < bytecodes.size(); i++)
+	{
+		Bytecode* bytecode = bytecodes[i].get();
+		if (!bytecode || !bytecode->file.IsOpen())
+			continue;
+
+		const unsigned char* data = (const unsigned char*)bytecode->data;
+		bytecode->copy.assign(data, data + bytecode->size);
+		bytecode->data = bytecode->copy.data();
+		bytecode->file.Close();
+	}
+
+	watchIntervalMs = intervalMs;
+	watching = true;
+	stopWatching = false;
+	watcher = std::thread(&ShaderCache::WatchLoop, this);
+}
+
+// --------------------------------------------------------
+// Stops the watcher thread, waiting for it to finish.  Any
+// changes it already read are still there for
+// ProcessReloads().
+// --------------------------------------------------------
+void ShaderCache::StopWatching()
+{
+	if (!watching)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopWatching = true;
+	}
+	watcherWake.notify_one();
+	watcher.join();
+	watching = false;
+}
+
+// --------------------------------------------------------
+// The watcher thread - checks for changes until stopped
+// --------------------------------------------------------
+void ShaderCache::WatchLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!stopWatching)
+	{
+		watcherWake.wait_for(lock, std::chrono::milliseconds(watchIntervalMs));
+		if (stopWatching)
+			break;
+
+		lock.unlock();
+		CheckForChanges();
+		lock.lock();
+	}
+}
+
+// --------------------------------------------------------
+// Reads any shader files that have changed since they were
+// last seen, queueing them for ProcessReloads().  Files
+// that are only partly written are skipped until the next
+// check.  Safe to call from any thread - the watcher calls
+// it, but it can also be called directly instead of
+// watching.  Returns how many changes were queued.
+// --------------------------------------------------------
+unsigned int ShaderCache::CheckForChanges()
+{
+	// Timestamps are read without holding the lock, so the
+	// main thread isn't held up by the file system
+	std::vector<std::pair<std::string, unsigned long long>> files;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		files.reserve(shaders.size());
+		for (unsigned int i = 0; i < shaders.size(); i++)
+			files.push_back(std::make_pair(shaders[i].path, shaders[i].fileVersion));
+	}
+
+	unsigned int queued = 0;
+	for (ShaderId i = 0; i < files.size(); i++)
+	{
+		unsigned long long fileVersion;
+		if (!GetFileVersion(files[i].first, fileVersion) || fileVersion == files[i].second)
+			continue;
+
+		PendingReload reload;
+		reload.shader = i;
+		if (!ReadWholeFile(files[i].first, reload.bytes) || !IsCompleteBytecode(reload.bytes))
+			continue;
+
+		// A newer version of something still waiting replaces it
+		std::lock_guard<std::mutex> lock(mutex);
+		shaders[i].fileVersion = fileVersion;
+
+		bool replaced = false;
+		for (unsigned int p = 0; p < pendingReloads.size() && !replaced; p++)
+		{
+			if (pendingReloads[p].shader == i)
+			{
+				pendingReloads[p].bytes.swap(reload.bytes);
+				replaced = true;
+			}
+		}
+		if (!replaced)
+			pendingReloads.push_back(std::move(reload));
+		queued++;
+	}
+
+	return queued;
+}
+
+// --------------------------------------------------------
+// Swaps in bytecode for any shader files that have changed,
+// freeing the old bytecode unless another shader shares it.
+// Returns how many shaders actually changed (a rewritten
+// file with the same bytecode doesn't count).
+//
+// changed - Appended with each changed shader's id
+// --------------------------------------------------------
+unsigned int ShaderCache::ProcessReloads(std::vector<ShaderId>& changed)
+{
+	std::vector<PendingReload> reloads;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		reloads.swap(pendingReloads);
+	}
+
+	unsigned int changedCount = 0;
+	for (unsigned int i = 0; i < reloads.size(); i++)
+	{
+		Shader& shader = shaders[reloads[i].shader];
+		const std::vector<unsigned char>& bytes = reloads[i].bytes;
+		const Bytecode& current = *bytecodes[shader.bytecode];
+		if (current.size == bytes.size() && memcmp(current.data, bytes.data(), bytes.size()) == 0)
+			continue;
+
+		std::unique_ptr<Bytecode> bytecode(new Bytecode());
+		bytecode->copy.swap(reloads[i].bytes);
+		bytecode->data = bytecode->copy.data();
+		bytecode->size = bytecode->copy.size();
+		stats.readBytes += bytecode->size;
+
+		unsigned int index = AddBytecode(std::move(bytecode));
+		ReleaseBytecode(shader.bytecode);
+		shader.bytecode = index;
+		changed.push_back(reloads[i].shader);
+		changedCount++;
+		stats.reloadCount++;
+	}
+
+	return changedCount;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Which shader - an index in load order
+typedef unsigned int ShaderId;
+static const ShaderId InvalidShaderId = 0xFFFFFFFF;
+
+// --------------------------------------------------------
+// Compiled shader bytecode (.cso files), loaded once and
+// looked up by name and permutation.
+//
+// Permutation 0 of "VertexShader" is VertexShader.cso, and
+// any other permutation adds its bits in hex, so permutation
+// 0x5 is VertexShader_5.cso.
+//
+// Files are memory mapped rather than read where they can be.
+// Shaders whose bytecode is identical (by content hash, then
+// byte for byte) share one copy, so whatever creates device
+// objects from them only needs one each.  The hash is of the
+// checksum compilers put in the container's header, so most
+// of a file is never touched unless it's actually used.
+//
+// Each shader's input signature is hashed too, since input
+// layouts only depend on the signature, not the whole shader.
+//
+// Watching for changes: a background thread checks the files'
+// timestamps, and reads any that changed.  Nothing is swapped
+// in until ProcessReloads(), which reports which shaders got
+// new bytecode.  Files are read rather than mapped while
+// watching, since a mapped file can't be overwritten on
+// Windows.
+//
+// Everything but the watcher is for one thread only.  No
+// Direct3D dependencies.
+// --------------------------------------------------------
+struct ShaderCacheStats
+{
+	unsigned int shaderCount = 0;
+	unsigned int bytecodeCount = 0;		// Distinct bytecode loaded
+	unsigned int duplicateCount = 0;	// Shaders that matched already loaded bytecode
+	unsigned int reloadCount = 0;		// Shaders given new bytecode by ProcessReloads()
+	size_t mappedBytes = 0;
+	size_t readBytes = 0;
+	double loadMs = 0.0;				// Total time spent in Load()
+};
+
+class ShaderCache
+{
+public:
+	ShaderCache();
+	~ShaderCache();
+
+	ShaderCache(const ShaderCache&) = delete;
+	ShaderCache& operator=(const ShaderCache&) = delete;
+
+	static std::string GetFileName(const std::string& name, unsigned int permutation);
+
+	void SetDirectory(const std::string& directory);
+	const std::string& GetDirectory() const;
+
+	ShaderId Load(const std::string& name, unsigned int permutation = 0);
+	ShaderId Find(const std::string& name, unsigned int permutation = 0) const;
+
+	unsigned int GetShaderCount() const;
+	const std::string& GetName(ShaderId shader) const;
+	unsigned int GetPermutation(ShaderId shader) const;
+	const void* GetBytecode(ShaderId shader) const;
+	size_t GetBytecodeSize(ShaderId shader) const;
+	unsigned long long GetBytecodeHash(ShaderId shader) const;
+	unsigned long long GetInputSignatureHash(ShaderId shader) const;
+
+	// Shaders with the same index share bytecode.  Indices
+	// aren't reused, so they can index per-bytecode objects.
+	unsigned int GetBytecodeIndex(ShaderId shader) const;
+	unsigned int GetBytecodeIndexCount() const;
+	bool IsBytecodeLoaded(unsigned int index) const;
+
+	void StartWatching(unsigned int intervalMs = 250);
+	void StopWatching();
+	bool IsWatching() const;
+	unsigned int CheckForChanges();
+	unsigned int ProcessReloads(std::vector<ShaderId>& changed);
+
+	const ShaderCacheStats& GetStats() const;
+
+private:
+	struct Bytecode
+	{
+		MappedFile file;					// If mapped
+		std::vector<unsigned char> copy;	// If read instead
+		const void* data;
+		size_t size;
+		unsigned long long hash;
+		unsigned long long signatureHash;
+		unsigned int references;			// Shaders using it
+	};
+
+	struct Shader
+	{
+		std::string name;
+		unsigned int permutation;
+		std::string path;
+		unsigned int bytecode;				// Index into bytecodes
+		unsigned long long fileVersion;		// Timestamp and size, as last seen by the watcher
+	};
+
+	// New bytecode read by the watcher, waiting for ProcessReloads()
+	struct PendingReload
+	{
+		ShaderId shader;
+		std::vector<unsigned char> bytes;
+	};
+
+	std::string directory;
+
+	std::vector<Shader> shaders;
+	std::unordered_map<std::string, ShaderId> shaderIds;	// By file name
+
+	// Distinct bytecode, with freed slots left empty
+	std::vector<std::unique_ptr<Bytecode>> bytecodes;
+	std::unordered_multimap<unsigned long long, unsigned int> bytecodesByHash;
+
+	// The watcher - the mutex guards shaders (against Load()
+	// adding more), fileVersion and pendingReloads
+	std::thread watcher;
+	mutable std::mutex mutex;
+	std::condition_variable watcherWake;
+	bool watching;
+	bool stopWatching;
+	unsigned int watchIntervalMs;
+	std::vector<PendingReload> pendingReloads;
+
+	ShaderCacheStats stats;
+
+	unsigned int AddBytecode(std::unique_ptr<Bytecode> bytecode);
+	void ReleaseBytecode(unsigned int index);
+	void WatchLoop();
+};
@@ -0,0 +1,215 @@
+#include "ShaderLibrary.h"
+#include "Hash.h"
+#include "VertexFormatD3D11.h"
+
+using namespace Microsoft::WRL;
+
+// --------------------------------------------------------
+// Constructor - Shaders load from the cache's directory
+// (set it through GetCache() first)
+//
+// device - Creates the shaders and input layouts
+// --------------------------------------------------------
+ShaderLibrary::ShaderLibrary(ComPtr<ID3D11Device> device)
+	:
+	device(device)
+{
+}
+
+ShaderCache& ShaderLibrary::GetCache() { return cache; }
+unsigned int ShaderLibrary::GetInputLayoutCount() const { return (unsigned int)inputLayouts.size(); }
+
+// --------------------------------------------------------
+// Loads a shader (if it isn't already) and creates its
+// object.  Returns InvalidShaderId if the file can't be read.
+// --------------------------------------------------------
+ShaderId ShaderLibrary::LoadVertexShader(const std::string& name, unsigned int permutation)
+{
+	return Load(name, permutation, ShaderStageVertex);
+}
+
+ShaderId ShaderLibrary::LoadPixelShader(const std::string& name, unsigned int permutation)
+{
+	return Load(name, permutation, ShaderStagePixel);
+}
+
+// --------------------------------------------------------
+// Finds (loading it the first time) the variant of a shader
+// that serves a feature key, and marks the key as used.
+// Returns InvalidShaderId if that variant wasn't compiled.
+//
+// permutations - The shader's permutations
+// key          - ShaderFeature bits wanted
+// stage        - Which kind of shader it is
+// --------------------------------------------------------
+ShaderId ShaderLibrary::LoadPermutation(ShaderPermutationSet& permutations, unsigned int key, ShaderStage stage)
+{
+	permutations.MarkUsed(key);
+
+	ShaderId shader = permutations.GetVariant(key);
+	if (shader == InvalidShaderId)
+	{
+		shader = Load(permutations.GetName(), permutations.Resolve(key), stage);
+		permutations.SetVariant(key, shader);
+	}
+	return shader;
+}
+
+ShaderId ShaderLibrary::Load(const std::string& name, unsigned int permutation, ShaderStage stage)
+{
+	ShaderId shader = cache.Load(name, permutation);
+	if (shader == InvalidShaderId)
+		return InvalidShaderId;
+
+	if (shader >= stages.size())
+		stages.resize(shader + 1, stage);
+	stages[shader] = stage;
+
+	CreateShader(shader);
+	return shader;
+}
+
+// --------------------------------------------------------
+// Creates a shader's object from its bytecode, unless
+// another shader with the same bytecode already has.
+// Returns false (leaving no object) if Direct3D won't
+// create one.
+// --------------------------------------------------------
+bool ShaderLibrary::CreateShader(ShaderId shader)
+{
+	unsigned int index = cache.GetBytecodeIndex(shader);
+	if (index >= vertexShaders.size())
+	{
+		vertexShaders.resize(cache.GetBytecodeIndexCount());
+		pixelShaders.resize(cache.GetBytecodeIndexCount());
+	}
+
+	HRESULT result = S_OK;
+	if (stages[shader] == ShaderStageVertex && !vertexShaders[index])
+	{
+		ComPtr<ID3D11VertexShader> created;
+		result = device->CreateVertexShader(
+			cache.GetBytecode(shader),
+			cache.GetBytecodeSize(shader),
+			0,
+			created.GetAddressOf());
+		if (SUCCEEDED(result))
+			vertexShaders[index] = created;
+	}
+	else if (stages[shader] == ShaderStagePixel && !pixelShaders[index])
+	{
+		ComPtr<ID3D11PixelShader> created;
+		result = device->CreatePixelShader(
+			cache.GetBytecode(shader),
+			cache.GetBytecodeSize(shader),
+			0,
+			created.GetAddressOf());
+		if (SUCCEEDED(result))
+			pixelShaders[index] = created;
+	}
+
+	return SUCCEEDED(result);
+}
+
+// --------------------------------------------------------
+// A loaded shader's object (null for InvalidShaderId, or a
+// shader loaded as another stage)
+// --------------------------------------------------------
+ComPtr<ID3D11VertexShader> ShaderLibrary::GetVertexShader(ShaderId shader) const
+{
+	if (shader == InvalidShaderId)
+		return 0;
+	return vertexShaders[cache.GetBytecodeIndex(shader)];
+}
+
+ComPtr<ID3D11PixelShader> ShaderLibrary::GetPixelShader(ShaderId shader) const
+{
+	if (shader == InvalidShaderId)
+		return 0;
+	return pixelShaders[cache.GetBytecodeIndex(shader)];
+}
+
+// --------------------------------------------------------
+// The input layout for drawing a vertex format, instanced,
+// with a vertex shader - created the first time any shader
+// with the same input signature asks for that format.
+// Null if Direct3D won't create it (the format and the
+// shader's inputs don't match), which isn't remembered, so
+// a fixed shader can try again.
+// --------------------------------------------------------
+ComPtr<ID3D11InputLayout> ShaderLibrary::GetInputLayout(ShaderId vertexShader, VertexFormatId format)
+{
+	if (vertexShader == InvalidShaderId)
+		return 0;
+
+	unsigned long long signature = cache.GetInputSignatureHash(vertexShader);
+	unsigned long long key = Fnv1a64(&format, sizeof(format), signature);
+	std::unordered_map<unsigned long long, ComPtr<ID3D11InputLayout>>::const_iterator existing = inputLayouts.find(key);
+	if (existing != inputLayouts.end())
+		return existing->second;
+
+	// Created against the actual shader code, which Direct3D
+	// checks the description against
+	D3D11_INPUT_ELEMENT_DESC elements[InstancedInputElementCount] = {};
+	unsigned int elementCount = GetInstancedInputElements(GetVertexFormat(format), elements);
+	ComPtr<ID3D11InputLayout> layout;
+	HRESULT result = device->CreateInputLayout(
+		elements,
+		elementCount,
+		cache.GetBytecode(vertexShader),
+		cache.GetBytecodeSize(vertexShader),
+		layout.GetAddressOf());
+	if (FAILED(result))
+		return 0;
+
+	inputLayouts[key] = layout;
+	return layout;
+}
+
+// --------------------------------------------------------
+// Swaps in any shaders whose files have changed, creating
+// their new objects and releasing ones no longer used.
+// Returns how many changed.
+//
+// changed - Appended with each changed shader's id
+// failed  - Optional - appended with each changed shader
+//           whose new object couldn't be created, which
+//           keeps using its old one
+// --------------------------------------------------------
+unsigned int ShaderLibrary::ProcessReloads(std::vector<ShaderId>& changed, std::vector<ShaderId>* failed)
+{
+	previousIndices.resize(cache.GetShaderCount());
+	for (ShaderId i = 0; i < previousIndices.size(); i++)
+		previousIndices[i] = cache.GetBytecodeIndex(i);
+
+	unsigned int first = (unsigned int)changed.size();
+	unsigned int changedCount = cache.ProcessReloads(changed);
+	if (changedCount == 0)
+		return 0;
+
+	for (unsigned int i = first; i < changed.size(); i++)
+	{
+		ShaderId shader = changed[i];
+		if (CreateShader(shader))
+			continue;
+
+		// The old object stands in for the new bytecode (and
+		// isn't released below, since it's still referenced)
+		unsigned int index = cache.GetBytecodeIndex(shader);
+		vertexShaders[index] = vertexShaders[previousIndices[shader]];
+		pixelShaders[index] = pixelShaders[previousIndices[shader]];
+		if (failed)
+			failed->push_back(shader);
+	}
+
+	for (unsigned int i = 0; i < vertexShaders.size(); i++)
+	{
+		if (!cache.IsBytecodeLoaded(i))
+		{
+			vertexShaders[i].Reset();
+			pixelShaders[i].Reset();
+		}
+	}
+
+	return changedCount;
+}
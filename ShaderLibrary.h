@@ -0,0 +1,71 @@
+#pragma once
+
+#include <d3d11.h>
+#include <unordered_map>
+#include <vector>
+#include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
+
+#include "ShaderCache.h"
+#include "ShaderPermutations.h"
+#include "VertexFormat.h"
+
+// --------------------------------------------------------
+// Direct3D side of ShaderCache - the shader objects made from
+// its bytecode, and input layouts to go with vertex shaders.
+//
+// Shaders sharing bytecode share one shader object.  Input
+// layouts are shared by every vertex shader with the same
+// input signature, per vertex format, and are laid out for
+// instanced drawing (see GetInstancedInputElements()).
+//
+// ProcessReloads() swaps in shaders whose files changed (if
+// the cache is watching them) - anything holding onto the
+// old objects needs to get them again.  A reloaded shader
+// Direct3D won't create an object from keeps its old one.
+// --------------------------------------------------------
+enum ShaderStage
+{
+	ShaderStageVertex,
+	ShaderStagePixel
+};
+
+class ShaderLibrary
+{
+public:
+	ShaderLibrary(Microsoft::WRL::ComPtr<ID3D11Device> device);
+
+	ShaderCache& GetCache();
+
+	ShaderId LoadVertexShader(const std::string& name, unsigned int permutation = 0);
+	ShaderId LoadPixelShader(const std::string& name, unsigned int permutation = 0);
+	ShaderId LoadPermutation(ShaderPermutationSet& permutations, unsigned int key, ShaderStage stage);
+
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> GetVertexShader(ShaderId shader) const;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> GetPixelShader(ShaderId shader) const;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> GetInputLayout(ShaderId vertexShader, VertexFormatId format);
+	unsigned int GetInputLayoutCount() const;
+
+	unsigned int ProcessReloads(std::vector<ShaderId>& changed, std::vector<ShaderId>* failed = 0);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	ShaderCache cache;
+
+	// Per shader (by ShaderId)
+	std::vector<ShaderStage> stages;
+
+	// Per bytecode index - only the stage the bytecode was
+	// loaded as has an object
+	std::vector<Microsoft::WRL::ComPtr<ID3D11VertexShader>> vertexShaders;
+	std::vector<Microsoft::WRL::ComPtr<ID3D11PixelShader>> pixelShaders;
+
+	// By input signature hash and vertex format
+	std::unordered_map<unsigned long long, Microsoft::WRL::ComPtr<ID3D11InputLayout>> inputLayouts;
+
+	// Scratch for ProcessReloads() - each shader's bytecode
+	// index from before the reload
+	std::vector<unsigned int> previousIndices;
+
+	ShaderId Load(const std::string& name, unsigned int permutation, ShaderStage stage);
+	bool CreateShader(ShaderId shader);
+};
@@ -0,0 +1,213 @@
+#include "ShaderPermutations.h"
+
+#include <fstream>
+
+// The define each feature bit turns on, in bit order - these
+// need to match the #if checks in the shaders
+static const char* const FeatureDefines[ShaderFeatureCount] =
+{
+	"INSTANCED",
+	"QUANTIZED_POSITIONS",
+	"VERTEX_COLOR"
+};
+
+// --------------------------------------------------------
+// The HLSL define for one feature bit
+// --------------------------------------------------------
+const char* GetShaderFeatureDefine(ShaderFeature feature)
+{
+	for (unsigned int i = 0; i < ShaderFeatureCount; i++)
+	{
+		if (feature == (1u << i))
+			return FeatureDefines[i];
+	}
+	return 0;
+}
+
+// --------------------------------------------------------
+// Every feature's define for a key, as fxc arguments - all
+// of them, set to 0 or 1, so shaders never see an undefined
+// feature
+// --------------------------------------------------------
+std::string GetShaderPermutationDefines(unsigned int key)
+{
+	std::string defines;
+	for (unsigned int i = 0; i < ShaderFeatureCount; i++)
+	{
+		if (i > 0)
+			defines += " ";
+		defines += std::string("/D ") + FeatureDefines[i] + ((key & (1u << i)) ? "=1" : "=0");
+	}
+	return defines;
+}
+
+// --------------------------------------------------------
+// Which vertex shader features match a vertex format's
+// elements - quantized formats store positions as UNORMs
+// relative to the mesh's bounds (with octahedral normals)
+// --------------------------------------------------------
+unsigned int GetVertexFormatShaderFeatures(const VertexFormat& format)
+{
+	unsigned int features = 0;
+	if (format.types[VertexAttributePosition] == VertexElementUnorm16x3)
+		features |= ShaderFeatureQuantizedPositions;
+	if (format.types[VertexAttributeColor] != VertexElementNone)
+		features |= ShaderFeatureVertexColor;
+	return features;
+}
+
+// --------------------------------------------------------
+// Constructor - Starts with no variants loaded or used
+//
+// name     - The shader's source (without ".hlsl"), which its
+//            compiled permutations are named after
+// profile  - The fxc target to compile it for
+// features - Which ShaderFeature bits the source checks
+// --------------------------------------------------------
+ShaderPermutationSet::ShaderPermutationSet(const std::string& name, const std::string& profile, unsigned int features)
+	:
+	name(name),
+	profile(profile),
+	features(features & AllShaderFeatures)
+{
+	for (unsigned int i = 0; i < ShaderPermutationCount; i++)
+	{
+		variants[i] = InvalidShaderId;
+		used[i] = false;
+	}
+}
+
+const std::string& ShaderPermutationSet::GetName() const { return name; }
+const std::string& ShaderPermutationSet::GetProfile() const { return profile; }
+unsigned int ShaderPermutationSet::GetFeatures() const { return features; }
+
+// --------------------------------------------------------
+// The key of the variant that serves a request - features
+// the shader doesn't have are dropped
+// --------------------------------------------------------
+unsigned int ShaderPermutationSet::Resolve(unsigned int key) const
+{
+	return key & features;
+}
+
+ShaderId ShaderPermutationSet::GetVariant(unsigned int key) const
+{
+	return variants[Resolve(key)];
+}
+
+void ShaderPermutationSet::SetVariant(unsigned int key, ShaderId shader)
+{
+	variants[Resolve(key)] = shader;
+}
+
+// --------------------------------------------------------
+// Records that a key is needed, so it ends up in exports
+// --------------------------------------------------------
+void ShaderPermutationSet::MarkUsed(unsigned int key)
+{
+	used[Resolve(key)] = true;
+}
+
+bool ShaderPermutationSet::IsUsed(unsigned int key) const
+{
+	return used[Resolve(key)];
+}
+
+// --------------------------------------------------------
+// Appends each used (resolved) key, lowest first, and
+// returns how many there were
+// --------------------------------------------------------
+unsigned int ShaderPermutationSet::GetUsedKeys(std::vector<unsigned int>& keys) const
+{
+	unsigned int count = 0;
+	for (unsigned int key = 0; key < ShaderPermutationCount; key++)
+	{
+		if (used[key])
+		{
+			keys.push_back(key);
+			count++;
+		}
+	}
+	return count;
+}
+
+// --------------------------------------------------------
+// Writes which permutations were used, their defines and
+// whether their compiled file was found
+//
+// path     - The file to write
+// sets     - The permutation sets to report on
+// setCount - How many sets there are
+// --------------------------------------------------------
+bool ExportShaderPermutationReport(
+	const std::string& path,
+	const ShaderPermutationSet* const* sets,
+	unsigned int setCount)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	for (unsigned int s = 0; s < setCount; s++)
+	{
+		const ShaderPermutationSet& set = *sets[s];
+		std::vector<unsigned int> keys;
+		set.GetUsedKeys(keys);
+
+		file << set.GetName() << " (" << set.GetProfile() << "): " << keys.size() << " used\n";
+		for (unsigned int i = 0; i < keys.size(); i++)
+		{
+			file << "  " << ShaderCache::GetFileName(set.GetName(), keys[i]) << "  ";
+			for (unsigned int f = 0; f < ShaderFeatureCount; f++)
+			{
+				if (keys[i] & (1u << f))
+					file << FeatureDefines[f] << " ";
+			}
+			file << (set.GetVariant(keys[i]) == InvalidShaderId ? "(missing)" : "(loaded)") << "\n";
+		}
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes a batch file that compiles just the used
+// permutations with fxc (from the Windows SDK).  Run it from
+// the shader sources' folder, with the output folder as its
+// first argument.
+//
+// path     - The file to write
+// sets     - The permutation sets to build
+// setCount - How many sets there are
+// --------------------------------------------------------
+bool ExportShaderPermutationBuildScript(
+	const std::string& path,
+	const ShaderPermutationSet* const* sets,
+	unsigned int setCount)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	file << "@echo off\n";
+	file << "rem Compiles the shader permutations the game used - run from the shader source folder\n";
+	file << "set OUT=%~1\n";
+	file << "if \"%OUT%\"==\"\" set OUT=.\n";
+
+	for (unsigned int s = 0; s < setCount; s++)
+	{
+		const ShaderPermutationSet& set = *sets[s];
+		std::vector<unsigned int> keys;
+		set.GetUsedKeys(keys);
+
+		for (unsigned int i = 0; i < keys.size(); i++)
+		{
+			file << "fxc /nologo /T " << set.GetProfile() << " /E main "
+				<< GetShaderPermutationDefines(keys[i])
+				<< " /Fo \"%OUT%\\" << ShaderCache::GetFileName(set.GetName(), keys[i]) << "\" "
+				<< set.GetName() << ".hlsl || exit /b 1\n";
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ShaderCache.h"
+#include "VertexFormat.h"
+
+// --------------------------------------------------------
+// Shader permutations - one shader source compiled several
+// ways, with features switched on and off by #defines.
+//
+// A permutation's key is its feature bits, which is also the
+// permutation number ShaderCache uses for its file name.  The
+// HLSL sees each feature as a define set to 0 or 1 (INSTANCED,
+// QUANTIZED_POSITIONS and VERTEX_COLOR).
+//
+// Keys known at compile time can be built with ShaderKey<>,
+// which rejects unknown bits:
+//
+//   ShaderKey<ShaderFeatureInstanced | ShaderFeatureVertexColor>::value
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+enum ShaderFeature
+{
+	ShaderFeatureInstanced = 1 << 0,			// World-view-projection per instance, from input slot 1
+	ShaderFeatureQuantizedPositions = 1 << 1,	// Quantized vertex format (see VertexFormatQuantized)
+	ShaderFeatureVertexColor = 1 << 2			// Color from the vertex, rather than white
+};
+
+static const unsigned int ShaderFeatureCount = 3;
+static const unsigned int ShaderPermutationCount = 1 << ShaderFeatureCount;
+static const unsigned int AllShaderFeatures = ShaderPermutationCount - 1;
+
+template<unsigned int Features>
+struct ShaderKey
+{
+	static_assert((Features & ~AllShaderFeatures) == 0, "Unknown shader feature bits");
+	static const unsigned int value = Features;
+};
+
+const char* GetShaderFeatureDefine(ShaderFeature feature);
+std::string GetShaderPermutationDefines(unsigned int key);
+
+// The features a vertex shader needs to read a vertex format
+// (QuantizedPositions and VertexColor - instancing is up to
+// the draw)
+unsigned int GetVertexFormatShaderFeatures(const VertexFormat& format);
+
+// --------------------------------------------------------
+// The permutations of one shader source - which features it
+// actually has, the loaded variant for each key (found with
+// a single table lookup) and which keys have been asked for.
+//
+// Features a shader doesn't have are dropped from keys, so
+// asking for them still finds the variant without them.
+//
+// Used keys can be exported as a report, and as a script
+// that compiles exactly those variants (and nothing else)
+// with fxc, for building shaders offline.
+// --------------------------------------------------------
+class ShaderPermutationSet
+{
+public:
+	ShaderPermutationSet(const std::string& name, const std::string& profile, unsigned int features);
+
+	const std::string& GetName() const;
+	const std::string& GetProfile() const;
+	unsigned int GetFeatures() const;
+
+	unsigned int Resolve(unsigned int key) const;
+	ShaderId GetVariant(unsigned int key) const;
+	void SetVariant(unsigned int key, ShaderId shader);
+
+	void MarkUsed(unsigned int key);
+	bool IsUsed(unsigned int key) const;
+	unsigned int GetUsedKeys(std::vector<unsigned int>& keys) const;
+
+private:
+	std::string name;		// Source file and compiled file prefix
+	std::string profile;	// fxc target, like "vs_5_0"
+	unsigned int features;
+
+	// By resolved key
+	ShaderId variants[ShaderPermutationCount];
+	bool used[ShaderPermutationCount];
+};
+
+bool ExportShaderPermutationReport(
+	const std::string& path,
+	const ShaderPermutationSet* const* sets,
+	unsigned int setCount);
+bool ExportShaderPermutationBuildScript(
+	const std::string& path,
+	const ShaderPermutationSet* const* sets,
+	unsigned int setCount);
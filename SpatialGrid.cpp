@@ -0,0 +1,535 @@
+#include "SpatialGrid.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+typedef std::chrono::steady_clock GridClock;
+
+// Points per job system chunk
+static const unsigned int GridChunkSize = 16384;
+
+// Never fewer buckets than this, so tiny grids still spread out
+static const unsigned int MinBucketCount = 64;
+
+// Most bucket groups in the first pass of a build
+static const unsigned int MaxGroupCount = 256;
+
+// --------------------------------------------------------
+// Runs a job over [0, count) in GridChunkSize chunks, across
+// threads if there are enough points to be worth it.  Jobs
+// can rely on each chunk starting at a multiple of
+// GridChunkSize either way.
+// --------------------------------------------------------
+template<typename Job>
+static void RunChunks(unsigned int count, JobSystem* jobs, const Job& job)
+{
+	if (jobs && count > GridChunkSize)
+		jobs->ParallelFor(count, GridChunkSize, job);
+	else
+	{
+		for (unsigned int begin = 0; begin < count; begin += GridChunkSize)
+			job(begin, std::min(begin + GridChunkSize, count), 0);
+	}
+}
+
+// --------------------------------------------------------
+// Constructor - Starts empty, allowing 5% of points out of
+// their buckets before Update() rebuilds
+// --------------------------------------------------------
+SpatialGrid::SpatialGrid(float cellSize)
+	:
+	maxOverflow(0.05f),
+	count(0),
+	bucketMask(0),
+	boundsMin(0, 0, 0),
+	boundsMax(0, 0, 0)
+{
+	SetCellSize(cellSize);
+}
+
+float SpatialGrid::GetCellSize() const { return cellSize; }
+unsigned int SpatialGrid::GetCount() const { return count; }
+const SpatialGridStats& SpatialGrid::GetStats() const { return stats; }
+
+// --------------------------------------------------------
+// Cells work best at about the size of a typical query -
+// takes effect at the next Build()
+// --------------------------------------------------------
+void SpatialGrid::SetCellSize(float cellSize)
+{
+	this->cellSize = cellSize;
+	inverseCellSize = 1.0f / cellSize;
+}
+
+void SpatialGrid::SetMaxOverflow(float fraction)
+{
+	maxOverflow = fraction;
+}
+
+// --------------------------------------------------------
+// Which cell a position is in
+// --------------------------------------------------------
+void SpatialGrid::GetCell(const XMFLOAT3& position, int& x, int& y, int& z) const
+{
+	x = (int)floorf(position.x * inverseCellSize);
+	y = (int)floorf(position.y * inverseCellSize);
+	z = (int)floorf(position.z * inverseCellSize);
+}
+
+// --------------------------------------------------------
+// Which bucket a cell's points go in - large primes from
+// Teschner et al., "Optimized Spatial Hashing for Collision
+// Detection of Deformable Objects"
+// --------------------------------------------------------
+unsigned int SpatialGrid::HashCell(int x, int y, int z) const
+{
+	return (((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u)) & bucketMask;
+}
+
+// --------------------------------------------------------
+// Calls visit(entry) for every current point in a cell,
+// including any on the overflow list.  Other cells can share
+// its bucket, so points are checked against the cell itself
+// too.
+// --------------------------------------------------------
+template<typename Visitor>
+void SpatialGrid::VisitCell(int x, int y, int z, Visitor& visit) const
+{
+	unsigned int bucket = HashCell(x, y, z);
+	for (unsigned int i = bucketStarts[bucket]; i < bucketStarts[bucket + 1]; i++)
+	{
+		if (entryStale[i])
+			continue;
+
+		int ex, ey, ez;
+		GetCell(entries[i].position, ex, ey, ez);
+		if (ex == x && ey == y && ez == z)
+			visit(entries[i]);
+	}
+
+	if (overflow.empty())
+		return;
+
+	auto bucketLess = [](const OverflowEntry& entry, unsigned int bucket) { return entry.bucket < bucket; };
+	for (auto i = std::lower_bound(overflow.begin(), overflow.end(), bucket, bucketLess);
+		i != overflow.end() && i->bucket == bucket; ++i)
+	{
+		int ex, ey, ez;
+		GetCell(i->entry.position, ex, ey, ez);
+		if (ex == x && ey == y && ez == z)
+			visit(i->entry);
+	}
+}
+
+// --------------------------------------------------------
+// Calls visit(entry) for every current point, in memory order
+// --------------------------------------------------------
+template<typename Visitor>
+void SpatialGrid::VisitAll(Visitor& visit) const
+{
+	for (unsigned int i = 0; i < entries.size(); i++)
+	{
+		if (!entryStale[i])
+			visit(entries[i]);
+	}
+
+	for (unsigned int i = 0; i < overflow.size(); i++)
+		visit(overflow[i].entry);
+}
+
+// --------------------------------------------------------
+// Sorts every point into the grid from scratch
+//
+// The sort is two counting sorts: first into at most 256
+// groups of neighboring buckets (by the bucket's top bits),
+// each chunk of points counting and writing its own share
+// of each group, then each group into its own buckets.  No
+// two threads ever write the same counter, and the second
+// pass only touches one group's buckets at a time, so it
+// stays in cache.
+//
+// positions - Each point's position
+// count     - Number of points
+// jobs      - Optional, to split the work across threads
+// --------------------------------------------------------
+void SpatialGrid::Build(const XMFLOAT3* positions, unsigned int count, JobSystem* jobs)
+{
+	GridClock::time_point start = GridClock::now();
+
+	this->count = count;
+	overflow.clear();
+
+	// Twice as many buckets as points keeps most buckets to one cell
+	unsigned int bucketCount = MinBucketCount;
+	while (bucketCount < count * 2)
+		bucketCount *= 2;
+	bucketMask = bucketCount - 1;
+
+	unsigned int groupShift = 0;
+	while ((bucketCount >> groupShift) > MaxGroupCount)
+		groupShift++;
+	unsigned int groupCount = bucketCount >> groupShift;
+
+	bucketStarts.resize(bucketCount + 1);
+	entries.resize(count);
+	sortedEntries.resize(count);
+	entryStale.assign(count, 0);
+	objectBuckets.resize(count);
+	objectEntries.resize(count);
+
+	unsigned int chunkCount = (count + GridChunkSize - 1) / GridChunkSize;
+	chunkGroupStarts.assign(chunkCount * groupCount, 0);
+	std::vector<XMFLOAT3> chunkBounds(chunkCount * 2);
+
+	// Which bucket each point goes in, and how many each chunk
+	// has for each group
+	RunChunks(count, jobs,
+		[&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+		{
+			unsigned int* groupCounts = &chunkGroupStarts[begin / GridChunkSize * groupCount];
+			XMFLOAT3 low = positions[begin];
+			XMFLOAT3 high = positions[begin];
+			for (unsigned int i = begin; i < end; i++)
+			{
+				const XMFLOAT3& p = positions[i];
+				int x, y, z;
+				GetCell(p, x, y, z);
+				unsigned int bucket = HashCell(x, y, z);
+				objectBuckets[i] = bucket;
+				groupCounts[bucket >> groupShift]++;
+
+				low = XMFLOAT3(std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z));
+				high = XMFLOAT3(std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z));
+			}
+			chunkBounds[begin / GridChunkSize * 2] = low;
+			chunkBounds[begin / GridChunkSize * 2 + 1] = high;
+		});
+
+	// Counts to starts - groups in order, and within each
+	// group, chunks in order
+	std::vector<unsigned int> groupStarts(groupCount + 1);
+	unsigned int total = 0;
+	for (unsigned int g = 0; g < groupCount; g++)
+	{
+		groupStarts[g] = total;
+		for (unsigned int c = 0; c < chunkCount; c++)
+		{
+			unsigned int groupSize = chunkGroupStarts[c * groupCount + g];
+			chunkGroupStarts[c * groupCount + g] = total;
+			total += groupSize;
+		}
+	}
+	groupStarts[groupCount] = total;
+
+	RunChunks(count, jobs,
+		[&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+		{
+			unsigned int* cursors = &chunkGroupStarts[begin / GridChunkSize * groupCount];
+			for (unsigned int i = begin; i < end; i++)
+			{
+				Entry& entry = sortedEntries[cursors[objectBuckets[i] >> groupShift]++];
+				entry.position = positions[i];
+				entry.object = i;
+			}
+		});
+
+	// Each group into its buckets.  Scattering moves each
+	// bucket's start along to the next one's, so afterwards
+	// they're shifted back into place.
+	auto sortGroups = [&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+	{
+		for (unsigned int g = begin; g < end; g++)
+		{
+			unsigned int firstBucket = g << groupShift;
+			unsigned int lastBucket = firstBucket + (1 << groupShift) - 1;
+
+			for (unsigned int b = firstBucket; b <= lastBucket; b++)
+				bucketStarts[b] = 0;
+			for (unsigned int i = groupStarts[g]; i < groupStarts[g + 1]; i++)
+				bucketStarts[objectBuckets[sortedEntries[i].object]]++;
+
+			unsigned int bucketStart = groupStarts[g];
+			for (unsigned int b = firstBucket; b <= lastBucket; b++)
+			{
+				unsigned int bucketSize = bucketStarts[b];
+				bucketStarts[b] = bucketStart;
+				bucketStart += bucketSize;
+			}
+
+			for (unsigned int i = groupStarts[g]; i < groupStarts[g + 1]; i++)
+			{
+				const Entry& entry = sortedEntries[i];
+				unsigned int slot = bucketStarts[objectBuckets[entry.object]]++;
+				entries[slot] = entry;
+				objectEntries[entry.object] = slot;
+			}
+
+			for (unsigned int b = lastBucket; b > firstBucket; b--)
+				bucketStarts[b] = bucketStarts[b - 1];
+			bucketStarts[firstBucket] = groupStarts[g];
+		}
+	};
+	if (jobs && count > GridChunkSize)
+		jobs->ParallelFor(groupCount, 1, sortGroups);
+	else
+		sortGroups(0, groupCount, 0);
+	bucketStarts[bucketCount] = count;
+
+	boundsMin = boundsMax = XMFLOAT3(0, 0, 0);
+	for (unsigned int c = 0; c < chunkCount; c++)
+	{
+		const XMFLOAT3& low = chunkBounds[c * 2];
+		const XMFLOAT3& high = chunkBounds[c * 2 + 1];
+		boundsMin = c == 0 ? low : XMFLOAT3(std::min(boundsMin.x, low.x), std::min(boundsMin.y, low.y), std::min(boundsMin.z, low.z));
+		boundsMax = c == 0 ? high : XMFLOAT3(std::max(boundsMax.x, high.x), std::max(boundsMax.y, high.y), std::max(boundsMax.z, high.z));
+	}
+
+	stats.bucketCount = bucketCount;
+	stats.overflowCount = 0;
+	stats.rebuilt = true;
+	stats.buildMs = std::chrono::duration<double, std::milli>(GridClock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Moves the points to new positions without re-sorting, as
+// long as few enough have left their buckets.  Returns true
+// if it had to do a full Build() instead.
+//
+// positions - Each point's new position (same points, same
+//             count as the last Build())
+// jobs      - Optional, to split the work across threads
+// --------------------------------------------------------
+bool SpatialGrid::Update(const XMFLOAT3* positions, JobSystem* jobs)
+{
+	GridClock::time_point start = GridClock::now();
+
+	unsigned int chunkCount = (count + GridChunkSize - 1) / GridChunkSize;
+	chunkOverflow.resize(chunkCount);
+	std::vector<XMFLOAT3> chunkBounds(chunkCount * 2);
+
+	auto updateRange = [&](unsigned int begin, unsigned int end, unsigned int /*thread*/)
+	{
+		std::vector<OverflowEntry>& moved = chunkOverflow[begin / GridChunkSize];
+		moved.clear();
+
+		XMFLOAT3 low = positions[begin];
+		XMFLOAT3 high = positions[begin];
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const XMFLOAT3& p = positions[i];
+			int x, y, z;
+			GetCell(p, x, y, z);
+
+			unsigned int slot = objectEntries[i];
+			unsigned int bucket = HashCell(x, y, z);
+			if (bucket == objectBuckets[i])
+			{
+				entries[slot].position = p;
+				entryStale[slot] = 0;
+			}
+			else
+			{
+				entryStale[slot] = 1;
+				OverflowEntry entry = { bucket, { p, i } };
+				moved.push_back(entry);
+			}
+
+			low = XMFLOAT3(std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z));
+			high = XMFLOAT3(std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z));
+		}
+		chunkBounds[begin / GridChunkSize * 2] = low;
+		chunkBounds[begin / GridChunkSize * 2 + 1] = high;
+	};
+
+	RunChunks(count, jobs, updateRange);
+
+	overflow.clear();
+	for (unsigned int c = 0; c < chunkCount; c++)
+		overflow.insert(overflow.end(), chunkOverflow[c].begin(), chunkOverflow[c].end());
+
+	// Too many stragglers and the list gets slow to sort and
+	// search - start over
+	if (overflow.size() > count * maxOverflow)
+	{
+		Build(positions, count, jobs);
+		stats.buildMs = std::chrono::duration<double, std::milli>(GridClock::now() - start).count();
+		return true;
+	}
+
+	std::sort(overflow.begin(), overflow.end(),
+		[](const OverflowEntry& a, const OverflowEntry& b) { return a.bucket < b.bucket; });
+
+	for (unsigned int c = 0; c < chunkCount; c++)
+	{
+		const XMFLOAT3& low = chunkBounds[c * 2];
+		const XMFLOAT3& high = chunkBounds[c * 2 + 1];
+		boundsMin = c == 0 ? low : XMFLOAT3(std::min(boundsMin.x, low.x), std::min(boundsMin.y, low.y), std::min(boundsMin.z, low.z));
+		boundsMax = c == 0 ? high : XMFLOAT3(std::max(boundsMax.x, high.x), std::max(boundsMax.y, high.y), std::max(boundsMax.z, high.z));
+	}
+
+	stats.overflowCount = (unsigned int)overflow.size();
+	stats.rebuilt = false;
+	stats.buildMs = std::chrono::duration<double, std::milli>(GridClock::now() - start).count();
+	return false;
+}
+
+// --------------------------------------------------------
+// Appends every point within radius of center
+// --------------------------------------------------------
+void SpatialGrid::QueryRadius(const XMFLOAT3& center, float radius, std::vector<unsigned int>& objects) const
+{
+	float radiusSq = radius * radius;
+	auto check = [&](const Entry& entry)
+	{
+		float dx = entry.position.x - center.x;
+		float dy = entry.position.y - center.y;
+		float dz = entry.position.z - center.z;
+		if (dx * dx + dy * dy + dz * dz <= radiusSq)
+			objects.push_back(entry.object);
+	};
+
+	XMFLOAT3 low(center.x - radius, center.y - radius, center.z - radius);
+	XMFLOAT3 high(center.x + radius, center.y + radius, center.z + radius);
+	int x0, y0, z0, x1, y1, z1;
+	GetCell(low, x0, y0, z0);
+	GetCell(high, x1, y1, z1);
+
+	// Covering more cells than there are buckets - every
+	// bucket would be read anyway, so just read them in order
+	double cells = (double)(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+	if (cells > bucketMask + 1)
+	{
+		VisitAll(check);
+	}
+	else
+	{
+		for (int z = z0; z <= z1; z++)
+			for (int y = y0; y <= y1; y++)
+				for (int x = x0; x <= x1; x++)
+					VisitCell(x, y, z, check);
+	}
+}
+
+// --------------------------------------------------------
+// Appends every point inside a box
+// --------------------------------------------------------
+void SpatialGrid::QueryBox(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, std::vector<unsigned int>& objects) const
+{
+	auto check = [&](const Entry& entry)
+	{
+		const XMFLOAT3& p = entry.position;
+		if (p.x >= boxMin.x && p.y >= boxMin.y && p.z >= boxMin.z &&
+			p.x <= boxMax.x && p.y <= boxMax.y && p.z <= boxMax.z)
+			objects.push_back(entry.object);
+	};
+
+	int x0, y0, z0, x1, y1, z1;
+	GetCell(boxMin, x0, y0, z0);
+	GetCell(boxMax, x1, y1, z1);
+
+	double cells = (double)(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+	if (cells > bucketMask + 1)
+	{
+		VisitAll(check);
+	}
+	else
+	{
+		for (int z = z0; z <= z1; z++)
+			for (int y = y0; y <= y1; y++)
+				for (int x = x0; x <= x1; x++)
+					VisitCell(x, y, z, check);
+	}
+}
+
+// --------------------------------------------------------
+// Finds the k points nearest to another, searching shells
+// of cells outward from the point's own.  Once k points
+// are found, and the kth is nearer than anything in the
+// next shell could be, the search stops.  Returns how
+// many were found (fewer than k if there aren't that many
+// within maxDistance).
+//
+// point       - Where to search from
+// k           - How many points to find
+// objects     - Room for k results, nearest first
+// maxDistance - Ignore anything farther than this
+// --------------------------------------------------------
+unsigned int SpatialGrid::QueryNearest(const XMFLOAT3& point, unsigned int k, unsigned int* objects, float maxDistance) const
+{
+	if (k == 0 || count == 0)
+		return 0;
+
+	// Largest (distance squared, object) at the front, so it's
+	// the one replaced when something nearer turns up
+	std::vector<std::pair<float, unsigned int>> nearest;
+	nearest.reserve(k + 1);
+	float maxDistanceSq = maxDistance < sqrtf(FLT_MAX) ? maxDistance * maxDistance : FLT_MAX;
+	auto check = [&](const Entry& entry)
+	{
+		float dx = entry.position.x - point.x;
+		float dy = entry.position.y - point.y;
+		float dz = entry.position.z - point.z;
+		float distanceSq = dx * dx + dy * dy + dz * dz;
+		if (distanceSq > maxDistanceSq || (nearest.size() == k && distanceSq >= nearest.front().first))
+			return;
+
+		nearest.push_back(std::make_pair(distanceSq, entry.object));
+		std::push_heap(nearest.begin(), nearest.end());
+		if (nearest.size() > k)
+		{
+			std::pop_heap(nearest.begin(), nearest.end());
+			nearest.pop_back();
+		}
+	};
+
+	// No shell past the farthest point (or maxDistance) can hold anything
+	int cx, cy, cz, lowX, lowY, lowZ, highX, highY, highZ;
+	GetCell(point, cx, cy, cz);
+	GetCell(boundsMin, lowX, lowY, lowZ);
+	GetCell(boundsMax, highX, highY, highZ);
+	int lastShell = std::max(std::max(
+		std::max(cx - lowX, highX - cx),
+		std::max(cy - lowY, highY - cy)),
+		std::max(cz - lowZ, highZ - cz));
+	if (maxDistance * inverseCellSize < lastShell)
+		lastShell = (int)ceilf(maxDistance * inverseCellSize);
+
+	for (int shell = 0; shell <= lastShell; shell++)
+	{
+		// Searching this far out reads more cells than there are
+		// buckets - cheaper to start over reading every point in order
+		double cells = 2.0 * shell + 1.0;
+		if (cells * cells * cells > bucketMask + 1)
+		{
+			nearest.clear();
+			VisitAll(check);
+			break;
+		}
+
+		// Only the cells on the shell's surface
+		for (int z = cz - shell; z <= cz + shell; z++)
+		{
+			for (int y = cy - shell; y <= cy + shell; y++)
+			{
+				bool surface = z == cz - shell || z == cz + shell || y == cy - shell || y == cy + shell;
+				int step = surface || shell == 0 ? 1 : shell * 2;
+				for (int x = cx - shell; x <= cx + shell; x += step)
+					VisitCell(x, y, z, check);
+			}
+		}
+
+		// Everything past this shell is at least this far away
+		float reach = shell * cellSize;
+		if (nearest.size() == k && nearest.front().first <= reach * reach)
+			break;
+	}
+
+	std::sort_heap(nearest.begin(), nearest.end());
+	for (unsigned int i = 0; i < nearest.size(); i++)
+		objects[i] = nearest[i].second;
+	return (unsigned int)nearest.size();
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cfloat>
+#include <DirectXMath.h>
+#include <vector>
+
+class JobSystem;
+
+// --------------------------------------------------------
+// A uniform grid over points (usually entity positions),
+// for "what's near here?" queries - within a radius, inside
+// a box, or the k nearest.
+//
+// Cells are hashed into a fixed number of buckets, so the
+// world can be any size, and everything lives in flat
+// arrays: Build() counting-sorts the points by bucket, so
+// each bucket's points sit next to each other, with their
+// positions copied alongside so queries read memory in
+// order.  Every step is linear in the number of points, and
+// the counting and scattering can be split across threads.
+//
+// Update() is the incremental alternative for points that
+// mostly stay put: points still in their bucket are updated
+// in place, and the few that left it go on a short overflow
+// list, sorted by bucket, that queries search as well.  Once
+// too many have left, it falls back to a full Build().
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+struct SpatialGridStats
+{
+	unsigned int bucketCount = 0;
+	unsigned int overflowCount = 0;		// Points out of their bucket since the last Build()
+	bool rebuilt = false;				// Whether the last Build() or Update() did a full build
+	double buildMs = 0.0;				// The last Build() or Update()
+};
+
+class SpatialGrid
+{
+public:
+	SpatialGrid(float cellSize = 1.0f);
+
+	void SetCellSize(float cellSize);
+	float GetCellSize() const;
+	void SetMaxOverflow(float fraction);
+	unsigned int GetCount() const;
+	const SpatialGridStats& GetStats() const;
+
+	void Build(const DirectX::XMFLOAT3* positions, unsigned int count, JobSystem* jobs = 0);
+	bool Update(const DirectX::XMFLOAT3* positions, JobSystem* jobs = 0);
+
+	void QueryRadius(const DirectX::XMFLOAT3& center, float radius, std::vector<unsigned int>& objects) const;
+	void QueryBox(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, std::vector<unsigned int>& objects) const;
+	unsigned int QueryNearest(
+		const DirectX::XMFLOAT3& point,
+		unsigned int k,
+		unsigned int* objects,
+		float maxDistance = FLT_MAX) const;
+
+private:
+	struct Entry
+	{
+		DirectX::XMFLOAT3 position;
+		unsigned int object;
+	};
+
+	struct OverflowEntry
+	{
+		unsigned int bucket;
+		Entry entry;
+	};
+
+	float cellSize;
+	float inverseCellSize;
+	float maxOverflow;		// Fraction of points allowed out of their bucket
+	unsigned int count;
+	unsigned int bucketMask;	// Bucket count - 1 (always a power of two)
+
+	// Entries sorted by bucket - bucket b is [bucketStarts[b], bucketStarts[b + 1])
+	std::vector<unsigned int> bucketStarts;
+	std::vector<Entry> entries;
+	std::vector<unsigned char> entryStale;	// Left its bucket since the build
+
+	// Per object, as of the last build
+	std::vector<unsigned int> objectBuckets;
+	std::vector<unsigned int> objectEntries;
+
+	// Points that left their bucket since the build, sorted by
+	// their new bucket
+	std::vector<OverflowEntry> overflow;
+	std::vector<std::vector<OverflowEntry>> chunkOverflow;
+
+	// Build() scratch - points sorted by group, and each
+	// chunk's count (then write cursor) for each group
+	std::vector<Entry> sortedEntries;
+	std::vector<unsigned int> chunkGroupStarts;
+
+	// Where the points are, for capping nearest neighbor searches
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+
+	SpatialGridStats stats;
+
+	void GetCell(const DirectX::XMFLOAT3& position, int& x, int& y, int& z) const;
+	unsigned int HashCell(int x, int y, int z) const;
+	template<typename Visitor> void VisitCell(int x, int y, int z, Visitor& visit) const;
+	template<typename Visitor> void VisitAll(Visitor& visit) const;
+};
@@ -0,0 +1,216 @@
+#include "TestFramework.h"
+#include "BakedMesh.h"
+#include "JobSystem.h"
+#include "ObjImporter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// A grid of quads as OBJ text, with positions and normals
+static std::string MakeGridObj(unsigned int size)
+{
+	std::string text;
+	char line[96];
+	for (unsigned int y = 0; y <= size; y++)
+	{
+		for (unsigned int x = 0; x <= size; x++)
+		{
+			snprintf(line, sizeof(line), "v %u.0 %u.0 %.3f\n", x, y, ((x * 7 + y * 13) % 5) * 0.1f);
+			text += line;
+		}
+	}
+	text += "vn 0 0 1\n";
+
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int a = y * (size + 1) + x + 1;
+			unsigned int b = a + size + 1;
+			snprintf(line, sizeof(line), "f %u//1 %u//1 %u//1 %u//1\n", a, a + 1, b + 1, b);
+			text += line;
+		}
+	}
+	return text;
+}
+
+static bool WriteTextFile(const std::string& path, const std::string& text)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+	return fclose(file) == 0 && written;
+}
+
+// A small file with a couple of known sections and one this
+// loader doesn't know about
+static bool WriteSmallMesh(std::vector<unsigned char>& file)
+{
+	static const Vertex vertices[3] = {};
+	static const unsigned short indices[3] = { 0, 1, 2 };
+	static const unsigned char unknown[5] = { 1, 2, 3, 4, 5 };
+
+	BakedMeshWriter writer;
+	writer.SetBounds(DirectX::XMFLOAT3(-1, -2, -3), DirectX::XMFLOAT3(1, 2, 3));
+	writer.SetSource(1234, 5678);
+	writer.AddSection(BakedSectionVertices, sizeof(Vertex), 3, vertices);
+	writer.AddSection(99, 1, 5, unknown);
+	writer.AddSection(BakedSectionIndices, sizeof(unsigned short), 3, indices);
+	return writer.WriteToMemory(file);
+}
+
+TEST(BakedMeshWriterRoundTrip)
+{
+	std::vector<unsigned char> file;
+	CHECK(WriteSmallMesh(file));
+
+	BakedMesh mesh;
+	CHECK(mesh.OpenFromMemory(file.data(), file.size()));
+	CHECK(mesh.GetHeader().fileSize == file.size());
+	CHECK(mesh.GetHeader().sourceSize == 1234 && mesh.GetHeader().sourceTime == 5678);
+	CHECK(mesh.GetHeader().boundsMax.z == 3.0f);
+
+	CHECK(mesh.GetVertexCount() == 3);
+	CHECK(mesh.GetIndexCount() == 3);
+	CHECK(mesh.Uses16BitIndices());
+	CHECK(((const unsigned short*)mesh.GetIndices())[2] == 2);
+	CHECK(mesh.GetLodCount() == 0 && mesh.GetLods() == 0);
+
+	// Every section is aligned, including after odd sizes
+	unsigned int count = 0;
+	const unsigned char* unknown = (const unsigned char*)mesh.FindSection(99, &count);
+	CHECK(unknown && count == 5 && unknown[4] == 5);
+	CHECK((size_t)((const unsigned char*)mesh.GetIndices() - file.data()) % BakedSectionAlignment == 0);
+}
+
+TEST(BakedMeshRejectsDamagedFiles)
+{
+	std::vector<unsigned char> file;
+	CHECK(WriteSmallMesh(file));
+	BakedMesh mesh;
+
+	// A flipped byte in the data fails the checksum, unless
+	// it isn't being checked
+	std::vector<unsigned char> damaged(file);
+	damaged[damaged.size() - 1] ^= 0x55;
+	CHECK(!mesh.OpenFromMemory(damaged.data(), damaged.size()));
+	CHECK(mesh.OpenFromMemory(damaged.data(), damaged.size(), false));
+
+	// Cut short
+	CHECK(!mesh.OpenFromMemory(file.data(), file.size() - 1));
+	CHECK(!mesh.OpenFromMemory(file.data(), sizeof(BakedMeshHeader) - 1));
+
+	// Another version
+	std::vector<unsigned char> other(file);
+	((BakedMeshHeader*)other.data())->version = BakedMeshVersion + 1;
+	CHECK(!mesh.OpenFromMemory(other.data(), other.size(), false));
+
+	// A section running off the end of the file
+	std::vector<unsigned char> overrun(file);
+	BakedSection* sections = (BakedSection*)(overrun.data() + sizeof(BakedMeshHeader));
+	sections[0].elementCount = 1000;
+	sections[0].size = sections[0].elementCount * (unsigned long long)sections[0].elementSize;
+	CHECK(!mesh.OpenFromMemory(overrun.data(), overrun.size(), false));
+}
+
+TEST(BakedMeshBakeObjMatchesImport)
+{
+	std::string objPath = GetTestFilePath("BakedMeshBake.obj");
+	std::string bakedPath = GetTestFilePath("BakedMeshBake.bmesh");
+	CHECK(WriteTextFile(objPath, MakeGridObj(40)));
+
+	std::string error;
+	bool baked = BakeObj(objPath, bakedPath, 0, &error);
+
+	ImportedMesh imported;
+	bool importedOk = ImportObj(objPath, imported);
+
+	BakedMesh mesh;
+	bool opened = mesh.Open(bakedPath);
+	bool matches = opened && mesh.MatchesSource(objPath);
+	unsigned int vertexCount = opened ? mesh.GetVertexCount() : 0;
+	unsigned int lodCount = opened ? mesh.GetLodCount() : 0;
+	unsigned int meshletCount = opened ? mesh.GetMeshletCount() : 0;
+	bool lodsInOrder = lodCount > 1;
+	for (unsigned int i = 1; i < lodCount; i++)
+	{
+		const BakedLod& lod = mesh.GetLods()[i];
+		lodsInOrder = lodsInOrder &&
+			lod.indexCount < mesh.GetLods()[i - 1].indexCount &&
+			lod.error >= mesh.GetLods()[i - 1].error;
+	}
+	mesh.Close();
+
+	remove(objPath.c_str());
+	remove(bakedPath.c_str());
+
+	CHECK(baked && error.empty());
+	CHECK(importedOk);
+	CHECK(opened && matches);
+	CHECK(vertexCount == imported.vertices.size());
+	CHECK(mesh.GetLods() == 0);
+	CHECK(lodsInOrder);
+	CHECK(meshletCount > 0);
+}
+
+TEST(BakedMeshBakeReportsBadObj)
+{
+	std::string objPath = GetTestFilePath("BakedMeshBad.obj");
+	std::string bakedPath = GetTestFilePath("BakedMeshBad.bmesh");
+	CHECK(WriteTextFile(objPath, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 7\n"));
+
+	std::string error;
+	bool baked = BakeObj(objPath, bakedPath, 0, &error);
+	remove(objPath.c_str());
+	remove(bakedPath.c_str());
+
+	CHECK(!baked);
+	CHECK(error.find("line 4") != std::string::npos);
+
+	// A missing OBJ isn't an error worth reporting
+	error.clear();
+	CHECK(!BakeObj(GetTestFilePath("BakedMeshMissing.obj"), bakedPath, 0, &error));
+	CHECK(error.empty());
+}
+
+BENCHMARK(BakedMeshLoadVersusImport)
+{
+	std::string objPath = GetTestFilePath("BakedMeshBench.obj");
+	std::string bakedPath = GetTestFilePath("BakedMeshBench.bmesh");
+	if (!WriteTextFile(objPath, MakeGridObj(250)))
+		return;
+
+	JobSystem jobs;
+	double bakeMs = TimeBestMs(1, [&]() { BakeObj(objPath, bakedPath, &jobs); });
+
+	ImportedMesh imported;
+	double importMs = TimeBestMs(3, [&]() { ImportObj(objPath, imported, &jobs); });
+
+	// Opening and reading every page, as uploading would
+	volatile unsigned int sink = 0;
+	auto load = [&](bool verify)
+		{
+			BakedMesh mesh;
+			if (!mesh.Open(bakedPath, verify))
+				return;
+			const unsigned char* bytes = (const unsigned char*)mesh.GetVertices();
+			size_t size = mesh.GetVertexCount() * sizeof(Vertex);
+			for (size_t i = 0; i < size; i += 4096)
+				sink = sink + bytes[i];
+		};
+	double verifiedMs = TimeBestMs(5, [&]() { load(true); });
+	double unverifiedMs = TimeBestMs(5, [&]() { load(false); });
+
+	remove(objPath.c_str());
+	remove(bakedPath.c_str());
+
+	ReportBenchmark("Triangles", imported.indices32.size() / 3.0 + imported.indices16.size() / 3.0, "triangles");
+	ReportBenchmark("Bake (import, levels, optimize, meshlets)", bakeMs, "ms");
+	ReportBenchmark("Import OBJ text", importMs, "ms");
+	ReportBenchmark("Open baked, checksum verified", verifiedMs, "ms");
+	ReportBenchmark("Open baked, unverified", unverifiedMs, "ms");
+	ReportBenchmark("Speedup over import (verified)", importMs / verifiedMs, "x");
+}
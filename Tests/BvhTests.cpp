@@ -0,0 +1,338 @@
+#include "TestFramework.h"
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// Boxes scattered over a wide, flat area, like a level's entities
+static void MakeBoxes(unsigned int count, unsigned int seed, std::vector<XMFLOAT3>& mins, std::vector<XMFLOAT3>& maxs)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> size(0.5f, 4.0f);
+
+	mins.resize(count);
+	maxs.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT3 center(position(random), position(random) * 0.05f, position(random));
+		float half = size(random);
+		mins[i] = XMFLOAT3(center.x - half, center.y - half, center.z - half);
+		maxs[i] = XMFLOAT3(center.x + half, center.y + half, center.z + half);
+	}
+}
+
+// Moves every box a little, as a frame of movement would
+static void MoveBoxes(unsigned int seed, float distance, std::vector<XMFLOAT3>& mins, std::vector<XMFLOAT3>& maxs)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (size_t i = 0; i < mins.size(); i++)
+	{
+		float dx = unit(random) * distance;
+		float dz = unit(random) * distance;
+		mins[i].x += dx;
+		maxs[i].x += dx;
+		mins[i].z += dz;
+		maxs[i].z += dz;
+	}
+}
+
+static Frustum MakeCameraFrustum()
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(
+		XMMatrixLookAtLH(XMVectorSet(0, 50, -900, 1), XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 1, 0, 0)),
+		XMMatrixPerspectiveFovLH(0.8f, 16.0f / 9.0f, 0.1f, 600.0f)));
+	return ExtractFrustum(viewProjection);
+}
+
+// Every child inside its parent, every node reached once
+// from the root, and every item in exactly one leaf (counted,
+// since which ones isn't visible)
+static bool TreeIsValid(const Bvh& bvh)
+{
+	const std::vector<BvhNode>& nodes = bvh.GetNodes();
+	if (nodes.empty())
+		return bvh.GetItemCount() == 0;
+
+	std::vector<bool> reached(nodes.size(), false);
+	std::vector<unsigned int> stack(1, 0);
+	unsigned int itemCount = 0;
+	while (!stack.empty())
+	{
+		unsigned int node = stack.back();
+		stack.pop_back();
+		if (reached[node])
+			return false;
+		reached[node] = true;
+
+		const BvhNode& n = nodes[node];
+		if (n.count > 0)
+		{
+			itemCount += n.count;
+			continue;
+		}
+
+		for (unsigned int c = n.first; c < n.first + 2; c++)
+		{
+			if (c >= nodes.size())
+				return false;
+			const BvhNode& child = nodes[c];
+			if (child.boundsMin.x < n.boundsMin.x || child.boundsMin.y < n.boundsMin.y || child.boundsMin.z < n.boundsMin.z ||
+				child.boundsMax.x > n.boundsMax.x || child.boundsMax.y > n.boundsMax.y || child.boundsMax.z > n.boundsMax.z)
+				return false;
+			stack.push_back(c);
+		}
+	}
+	return itemCount == bvh.GetItemCount() &&
+		std::find(reached.begin(), reached.end(), false) == reached.end();
+}
+
+static float BoxDistanceSq(const XMFLOAT3& point, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	float dx = std::max(std::max(boxMin.x - point.x, point.x - boxMax.x), 0.0f);
+	float dy = std::max(std::max(boxMin.y - point.y, point.y - boxMax.y), 0.0f);
+	float dz = std::max(std::max(boxMin.z - point.z, point.z - boxMax.z), 0.0f);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+static float RayBoxDistance(const XMFLOAT3& origin, const XMFLOAT3& direction, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	float enter = 0.0f;
+	float exit = FLT_MAX;
+	for (unsigned int axis = 0; axis < 3; axis++)
+	{
+		float o = (&origin.x)[axis];
+		float d = (&direction.x)[axis];
+		float a = ((&boxMin.x)[axis] - o) / d;
+		float b = ((&boxMax.x)[axis] - o) / d;
+		enter = std::max(enter, std::min(a, b));
+		exit = std::min(exit, std::max(a, b));
+	}
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+// Checks every kind of query against testing each box
+static bool QueriesMatchBruteForce(const Bvh& bvh, const std::vector<XMFLOAT3>& mins, const std::vector<XMFLOAT3>& maxs)
+{
+	unsigned int count = (unsigned int)mins.size();
+	std::vector<unsigned int> found;
+	std::vector<unsigned int> expected;
+
+	Frustum frustum = MakeCameraFrustum();
+	bvh.QueryFrustum(frustum, found);
+	for (unsigned int i = 0; i < count; i++)
+		if (BoxInFrustum(frustum, mins[i], maxs[i]))
+			expected.push_back(i);
+	std::sort(found.begin(), found.end());
+	if (expected.empty() || found != expected)
+		return false;
+
+	std::mt19937 random(count);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (unsigned int q = 0; q < 20; q++)
+	{
+		XMFLOAT3 center(position(random), 0.0f, position(random));
+		found.clear();
+		expected.clear();
+		bvh.QuerySphere(center, 40.0f, found);
+		for (unsigned int i = 0; i < count; i++)
+			if (BoxDistanceSq(center, mins[i], maxs[i]) <= 40.0f * 40.0f)
+				expected.push_back(i);
+		std::sort(found.begin(), found.end());
+		if (found != expected)
+			return false;
+
+		XMFLOAT3 boxMin(center.x - 30.0f, -5.0f, center.z - 50.0f);
+		XMFLOAT3 boxMax(center.x + 30.0f, 5.0f, center.z + 50.0f);
+		found.clear();
+		expected.clear();
+		bvh.QueryBox(boxMin, boxMax, found);
+		for (unsigned int i = 0; i < count; i++)
+			if (mins[i].x <= boxMax.x && maxs[i].x >= boxMin.x &&
+				mins[i].y <= boxMax.y && maxs[i].y >= boxMin.y &&
+				mins[i].z <= boxMax.z && maxs[i].z >= boxMin.z)
+				expected.push_back(i);
+		std::sort(found.begin(), found.end());
+		if (found != expected)
+			return false;
+
+		// Rays from above, slanting down through the boxes
+		XMFLOAT3 origin(center.x, 100.0f, center.z);
+		XMFLOAT3 direction;
+		XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(unit(random), -1.0f, unit(random), 0.0f)));
+		float closest = FLT_MAX;
+		for (unsigned int i = 0; i < count; i++)
+			closest = std::min(closest, RayBoxDistance(origin, direction, mins[i], maxs[i]));
+
+		BvhRayHit hit;
+		bool hitAnything = bvh.Raycast(origin, direction, 1e6f, hit);
+		if (hitAnything != (closest != FLT_MAX))
+			return false;
+		if (hitAnything &&
+			(fabsf(hit.distance - closest) > 1e-3f * std::max(closest, 1.0f) ||
+			fabsf(RayBoxDistance(origin, direction, mins[hit.item], maxs[hit.item]) - hit.distance) > 1e-3f * std::max(closest, 1.0f)))
+			return false;
+	}
+	return true;
+}
+
+TEST(BvhQueriesMatchBruteForce)
+{
+	std::vector<XMFLOAT3> mins, maxs;
+	MakeBoxes(20000, 1, mins, maxs);
+
+	Bvh bvh;
+	bvh.Build(mins.data(), maxs.data(), (unsigned int)mins.size());
+	CHECK(bvh.GetItemCount() == mins.size());
+	CHECK(bvh.GetStats().nodeCount == bvh.GetNodes().size());
+	CHECK(TreeIsValid(bvh));
+	CHECK(QueriesMatchBruteForce(bvh, mins, maxs));
+
+	// Leaves stay small
+	for (size_t i = 0; i < bvh.GetNodes().size(); i++)
+		CHECK(bvh.GetNodes()[i].count <= 4);
+}
+
+TEST(BvhRefitKeepsQueriesRight)
+{
+	std::vector<XMFLOAT3> mins, maxs;
+	MakeBoxes(20000, 2, mins, maxs);
+	unsigned int count = (unsigned int)mins.size();
+
+	Bvh plain;
+	Bvh rotated;
+	plain.Build(mins.data(), maxs.data(), count);
+	rotated.Build(mins.data(), maxs.data(), count);
+
+	unsigned int rotations = 0;
+	for (unsigned int frame = 0; frame < 5; frame++)
+	{
+		MoveBoxes(frame, 20.0f, mins, maxs);
+		plain.Refit(mins.data(), maxs.data(), false);
+		rotated.Refit(mins.data(), maxs.data(), true);
+		rotations += rotated.GetStats().rotations;
+
+		CHECK(plain.GetStats().rotations == 0);
+		CHECK(TreeIsValid(plain));
+		CHECK(TreeIsValid(rotated));
+	}
+	CHECK(QueriesMatchBruteForce(plain, mins, maxs));
+	CHECK(QueriesMatchBruteForce(rotated, mins, maxs));
+
+	// Moving makes the tree worse, and rotations claw some back
+	CHECK(plain.GetStats().cost > plain.GetStats().buildCost);
+	CHECK(rotations > 0);
+	CHECK(rotated.GetStats().cost < plain.GetStats().cost);
+}
+
+TEST(BvhEdgeCases)
+{
+	Bvh bvh;
+	std::vector<unsigned int> found;
+	BvhRayHit hit;
+
+	// Empty
+	bvh.Build(0, 0, 0);
+	bvh.QuerySphere(XMFLOAT3(0, 0, 0), 100.0f, found);
+	CHECK(found.empty());
+	CHECK(!bvh.Raycast(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 0, 0), 100.0f, hit));
+
+	// A single box, and a ray along an axis (so its other
+	// two directions divide by zero)
+	XMFLOAT3 boxMin(-1, -1, -1), boxMax(1, 1, 1);
+	bvh.Build(&boxMin, &boxMax, 1);
+	CHECK(bvh.Raycast(XMFLOAT3(-5, 0, 0), XMFLOAT3(1, 0, 0), 100.0f, hit));
+	CHECK(hit.item == 0);
+	CHECK_NEAR(hit.distance, 4.0, 1e-5);
+	CHECK(!bvh.Raycast(XMFLOAT3(-5, 0, 0), XMFLOAT3(1, 0, 0), 3.0f, hit));
+	CHECK(!bvh.Raycast(XMFLOAT3(-5, 2, 0), XMFLOAT3(1, 0, 0), 100.0f, hit));
+
+	// Starting inside is a hit right away
+	CHECK(bvh.Raycast(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 1), 100.0f, hit));
+	CHECK(hit.distance == 0.0f);
+
+	// Identical boxes can't be split, but still all get found
+	std::vector<XMFLOAT3> mins(100, boxMin), maxs(100, boxMax);
+	bvh.Build(mins.data(), maxs.data(), 100);
+	CHECK(TreeIsValid(bvh));
+	found.clear();
+	bvh.QueryBox(XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0), found);
+	CHECK(found.size() == 100);
+}
+
+BENCHMARK(BvhMillionBoxes)
+{
+	const unsigned int count = 1000000;
+	std::vector<XMFLOAT3> mins, maxs;
+	MakeBoxes(count, 3, mins, maxs);
+
+	Bvh bvh;
+	bvh.Build(mins.data(), maxs.data(), count);
+	ReportBenchmark("Build", bvh.GetStats().buildMs, "ms");
+	ReportBenchmark("Cost after build", bvh.GetStats().buildCost, "");
+
+	MoveBoxes(1, 5.0f, mins, maxs);
+	Bvh moved(bvh);
+	moved.Refit(mins.data(), maxs.data(), false);
+	ReportBenchmark("Refit", moved.GetStats().refitMs, "ms");
+	ReportBenchmark("Cost after refit", moved.GetStats().cost, "");
+	bvh.Refit(mins.data(), maxs.data(), true);
+	ReportBenchmark("Refit with rotations", bvh.GetStats().refitMs, "ms");
+	ReportBenchmark("Cost after refit with rotations", bvh.GetStats().cost, "");
+
+	Frustum frustum = MakeCameraFrustum();
+	std::vector<unsigned int> found;
+	double frustumMs = TimeBestMs(5, [&]()
+		{
+			found.clear();
+			bvh.QueryFrustum(frustum, found);
+		});
+	double linearMs = TimeBestMs(5, [&]()
+		{
+			found.clear();
+			for (unsigned int i = 0; i < count; i++)
+				if (BoxInFrustum(frustum, mins[i], maxs[i]))
+					found.push_back(i);
+		});
+	ReportBenchmark("Frustum query", frustumMs, "ms");
+	ReportBenchmark("Frustum, testing every box", linearMs, "ms");
+	ReportBenchmark("Visible", (double)found.size(), "boxes");
+
+	const unsigned int queries = 10000;
+	std::mt19937 random(4);
+	std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<XMFLOAT3> centers(queries), directions(queries);
+	for (unsigned int q = 0; q < queries; q++)
+	{
+		centers[q] = XMFLOAT3(position(random), 0.0f, position(random));
+		XMStoreFloat3(&directions[q], XMVector3Normalize(XMVectorSet(unit(random), -1.0f, unit(random), 0.0f)));
+	}
+
+	double sphereMs = TimeBestMs(3, [&]()
+		{
+			for (unsigned int q = 0; q < queries; q++)
+			{
+				found.clear();
+				bvh.QuerySphere(centers[q], 20.0f, found);
+			}
+		});
+	double rayMs = TimeBestMs(3, [&]()
+		{
+			BvhRayHit hit;
+			for (unsigned int q = 0; q < queries; q++)
+			{
+				XMFLOAT3 origin(centers[q].x, 100.0f, centers[q].z);
+				bvh.Raycast(origin, directions[q], 1e6f, hit);
+			}
+		});
+	ReportBenchmark("Sphere query, radius 20", sphereMs * 1000.0 / queries, "us");
+	ReportBenchmark("Raycast", rayMs * 1000.0 / queries, "us");
+}
@@ -0,0 +1,125 @@
+#include "TestFramework.h"
+#include "CBufferLayout.h"
+
+#include <cstddef>
+#include <vector>
+
+struct ArrayThenFloat
+{
+	float values[3];
+	float after;
+};
+
+struct MatrixThenColor
+{
+	float matrix[16];	// Row-major, like an XMFLOAT4X4
+	float color[4];
+};
+
+TEST(CBufferLayoutPacksWithinRegisters)
+{
+	CBufferLayout fits;
+	CHECK(fits.Add("a", CBufferFloat3, 0) == 0);
+	CHECK(fits.Add("b", CBufferFloat, 12) == 12);
+	CHECK(fits.GetSize() == 16);
+	CHECK(fits.MatchesSource());
+
+	CBufferLayout after;
+	after.Add("a", CBufferFloat, 0);
+	CHECK(after.Add("b", CBufferFloat3, 4) == 4);
+	CHECK(after.GetSize() == 16);
+
+	// A float3 after a float2 would straddle two registers
+	CBufferLayout straddles;
+	straddles.Add("a", CBufferFloat2, 0);
+	CHECK(straddles.Add("b", CBufferFloat3, 8) == 16);
+	CHECK(straddles.GetSize() == 32);
+	CHECK(!straddles.MatchesSource());
+}
+
+TEST(CBufferLayoutArraysTakeARegisterEach)
+{
+	CBufferLayout layout;
+	CHECK(layout.Add("values", CBufferFloat, offsetof(ArrayThenFloat, values), 3) == 0);
+	CHECK(layout.Add("after", CBufferFloat, offsetof(ArrayThenFloat, after)) == 36);
+	CHECK(layout.GetSize() == 48);
+	CHECK(!layout.MatchesSource());
+
+	ArrayThenFloat source = { { 1.0f, 2.0f, 3.0f }, 4.0f };
+	float packed[12] = {};
+	layout.Pack(&source, packed);
+	CHECK(packed[0] == 1.0f);
+	CHECK(packed[4] == 2.0f);
+	CHECK(packed[8] == 3.0f);
+	CHECK(packed[9] == 4.0f);
+
+	CBufferLayout pairs;
+	pairs.Add("a", CBufferFloat2, 0, 2);
+	CHECK(pairs.Add("b", CBufferFloat2, 16) == 24);
+	CHECK(pairs.GetSize() == 32);
+}
+
+TEST(CBufferLayoutTransposesColumnMajorMatrices)
+{
+	CBufferLayout layout;
+	layout.Add("matrix", CBufferFloat4x4, offsetof(MatrixThenColor, matrix));
+	CHECK(layout.Add("color", CBufferFloat4, offsetof(MatrixThenColor, color)) == 64);
+	CHECK(layout.GetSize() == 80);
+	CHECK(!layout.MatchesSource());
+
+	MatrixThenColor source;
+	for (int i = 0; i < 16; i++)
+		source.matrix[i] = (float)i;
+	for (int i = 0; i < 4; i++)
+		source.color[i] = 100.0f + i;
+
+	float packed[20];
+	layout.Pack(&source, packed);
+	for (int row = 0; row < 4; row++)
+		for (int column = 0; column < 4; column++)
+			CHECK(packed[column * 4 + row] == source.matrix[row * 4 + column]);
+	CHECK(packed[16] == 100.0f);
+	CHECK(packed[19] == 103.0f);
+
+	// row_major matrices are copied as they are
+	CBufferLayout rowMajor;
+	rowMajor.Add("matrix", CBufferFloat4x4RowMajor, offsetof(MatrixThenColor, matrix));
+	rowMajor.Add("color", CBufferFloat4, offsetof(MatrixThenColor, color));
+	CHECK(rowMajor.MatchesSource());
+	CHECK(rowMajor.Find("color") == 1);
+	CHECK(rowMajor.Find("missing") == -1);
+}
+
+BENCHMARK(CBufferLayoutPackThroughput)
+{
+	const unsigned int draws = 1000000;
+	std::vector<unsigned char> destination(1000 * 256);
+
+	MatrixThenColor source;
+	for (int i = 0; i < 16; i++)
+		source.matrix[i] = (float)i;
+	for (int i = 0; i < 4; i++)
+		source.color[i] = 1.0f;
+
+	CBufferLayout transposed;
+	transposed.Add("matrix", CBufferFloat4x4, offsetof(MatrixThenColor, matrix));
+	transposed.Add("color", CBufferFloat4, offsetof(MatrixThenColor, color));
+
+	CBufferLayout copied;
+	copied.Add("matrix", CBufferFloat4x4RowMajor, offsetof(MatrixThenColor, matrix));
+	copied.Add("color", CBufferFloat4, offsetof(MatrixThenColor, color));
+
+	double transposedMs = TimeBestMs(3, [&]()
+		{
+			for (unsigned int i = 0; i < draws; i++)
+				transposed.Pack(&source, &destination[(i % 1000) * 256]);
+		});
+	double copiedMs = TimeBestMs(3, [&]()
+		{
+			for (unsigned int i = 0; i < draws; i++)
+				copied.Pack(&source, &destination[(i % 1000) * 256]);
+		});
+
+	ReportBenchmark("Pack float4x4 + float4 (transposed)", transposedMs * 1e6 / draws, "ns");
+	ReportBenchmark("Pack float4x4 + float4 (matches source, copied)", copiedMs * 1e6 / draws, "ns");
+}
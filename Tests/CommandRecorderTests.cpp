@@ -0,0 +1,224 @@
+#include "TestFramework.h"
+#include "CommandRecorder.h"
+#include "JobSystem.h"
+#include "RenderQueue.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+// What a batch of instances needs to be drawn, like the
+// instance batcher gives the scene pass
+struct TestBatch
+{
+	unsigned int mesh;
+	unsigned int instanceCount;
+	unsigned int firstInstance;
+	unsigned int lod;
+};
+
+// A frame's draws, sorted by key
+struct TestDrawList
+{
+	std::vector<TestBatch> batches;
+	RenderQueue queue;
+};
+
+static void MakeDrawList(unsigned int count, unsigned int seed, TestDrawList& draws)
+{
+	std::mt19937 random(seed);
+	draws.batches.resize(count);
+	draws.queue.Clear();
+	draws.queue.Reserve(count);
+
+	unsigned int firstInstance = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		TestBatch& batch = draws.batches[i];
+		batch.mesh = random() % 200;
+		batch.instanceCount = 1 + random() % 50;
+		batch.firstInstance = firstInstance;
+		batch.lod = random() % 4;
+		firstInstance += batch.instanceCount;
+
+		unsigned int format = random() % 3;
+		draws.queue.Add(MakeSortKey(0, format, format, random() % 16, batch.mesh, 0.0f), i);
+	}
+	draws.queue.Sort();
+}
+
+// Records draws [begin, end) the way the scene pass does,
+// assuming nothing is bound at the start of the range
+static void RecordDraws(const TestDrawList& draws, CommandRecorder& recorder, unsigned int begin, unsigned int end)
+{
+	StateCache stateCache;
+	recorder.SetInstanceBuffer(0);
+
+	const std::vector<DrawItem>& items = draws.queue.GetItems();
+	for (unsigned int i = begin; i < end; i++)
+	{
+		const TestBatch& batch = draws.batches[items[i].payload];
+		SortKey key = items[i].key;
+
+		if (stateCache.SetInputLayout(GetSortKeyLayout(key)))
+			recorder.SetInputLayout(GetSortKeyLayout(key));
+		if (stateCache.SetVertexShader(GetSortKeyShader(key)))
+			recorder.SetVertexShader(GetSortKeyShader(key));
+		if (stateCache.SetPixelShader(0))
+			recorder.SetPixelShader(0);
+		if (stateCache.SetMesh(batch.mesh))
+			recorder.SetMesh(batch.mesh);
+
+		recorder.SetDrawConstants(items[i].payload * 256);
+		recorder.DrawInstanced(batch.instanceCount, batch.firstInstance, batch.lod);
+	}
+}
+
+// Writes down every command it's given, so two recordings
+// can be compared command by command
+class CommandLog : public CommandRecorder
+{
+public:
+	std::vector<unsigned int> entries;
+
+	void SetInputLayout(unsigned int id) { Add(0, id); }
+	void SetVertexShader(unsigned int id) { Add(1, id); }
+	void SetPixelShader(unsigned int id) { Add(2, id); }
+	void SetInstanceBuffer(unsigned int id) { Add(3, id); }
+	void SetMesh(unsigned int id) { Add(4, id); }
+	void SetDrawConstants(unsigned int offset) { Add(5, offset); }
+	void DrawInstanced(unsigned int instanceCount, unsigned int firstInstance, unsigned int lod) { Add(6, instanceCount, firstInstance, lod); }
+
+private:
+	void Add(unsigned int type, unsigned int arg0, unsigned int arg1 = 0, unsigned int arg2 = 0)
+	{
+		entries.push_back(type);
+		entries.push_back(arg0);
+		entries.push_back(arg1);
+		entries.push_back(arg2);
+	}
+};
+
+TEST(CommandRecorderListReplaysInOrder)
+{
+	CommandList list;
+	list.SetInputLayout(1);
+	list.SetVertexShader(2);
+	list.SetPixelShader(3);
+	list.SetInstanceBuffer(4);
+	list.SetMesh(5);
+	list.SetDrawConstants(256);
+	list.DrawInstanced(10, 20, 1);
+	CHECK(list.GetCommandCount() == 7);
+
+	CommandLog log;
+	list.Replay(log);
+	const unsigned int expected[] = { 0, 1, 0, 0, 1, 2, 0, 0, 2, 3, 0, 0, 3, 4, 0, 0, 4, 5, 0, 0, 5, 256, 0, 0, 6, 10, 20, 1 };
+	CHECK(log.entries == std::vector<unsigned int>(expected, expected + sizeof(expected) / sizeof(expected[0])));
+
+	NullCommandRecorder counts;
+	list.Replay(counts);
+	list.Replay(counts);
+	CHECK(counts.GetStateChangeCount() == 12 && counts.GetDrawCount() == 2 && counts.GetInstanceCount() == 20);
+	counts.Reset();
+	CHECK(counts.GetStateChangeCount() == 0 && counts.GetDrawCount() == 0 && counts.GetInstanceCount() == 0);
+
+	list.Clear();
+	CHECK(list.GetCommandCount() == 0);
+}
+
+TEST(CommandRecorderParallelMatchesSerial)
+{
+	JobSystem jobs(4);
+	TestDrawList draws;
+	MakeDrawList(1000, 1, draws);
+
+	// Recorded as one range, on this thread
+	NullCommandRecorder whole;
+	RecordDraws(draws, whole, 0, 1000);
+	CHECK(whole.GetDrawCount() == 1000);
+
+	// Chunk sizes that divide the draws, that don't, bigger than
+	// the whole list, and 0 (taken as 1)
+	const unsigned int chunkSizes[] = { 1, 7, 64, 100, 999, 1000, 5000, 0 };
+	for (unsigned int c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); c++)
+	{
+		unsigned int chunkSize = chunkSizes[c] == 0 ? 1 : chunkSizes[c];
+		CommandList serial;
+		for (unsigned int begin = 0; begin < 1000; begin += chunkSize)
+			RecordDraws(draws, serial, begin, begin + chunkSize < 1000 ? begin + chunkSize : 1000);
+
+		// Across threads, into a second list
+		CommandList submitted;
+		CommandListBackend listBackend(submitted);
+		RecordParallel(jobs, listBackend, 1000, chunkSizes[c],
+			[&](CommandRecorder& recorder, unsigned int begin, unsigned int end)
+			{
+				RecordDraws(draws, recorder, begin, end);
+			});
+
+		CommandLog serialLog;
+		CommandLog submittedLog;
+		serial.Replay(serialLog);
+		submitted.Replay(submittedLog);
+		CHECK(submittedLog.entries == serialLog.entries);
+
+		// Straight into the null backend
+		NullCommandRecorder counts;
+		CommandListBackend nullBackend(counts);
+		RecordParallel(jobs, nullBackend, 1000, chunkSizes[c],
+			[&](CommandRecorder& recorder, unsigned int begin, unsigned int end)
+			{
+				RecordDraws(draws, recorder, begin, end);
+			});
+
+		NullCommandRecorder serialCounts;
+		serial.Replay(serialCounts);
+		CHECK(counts.GetStateChangeCount() == serialCounts.GetStateChangeCount());
+		CHECK(counts.GetDrawCount() == whole.GetDrawCount());
+		CHECK(counts.GetInstanceCount() == whole.GetInstanceCount());
+
+		// Each chunk starts with nothing bound, so never has fewer
+		// state changes than one long range
+		CHECK(counts.GetStateChangeCount() >= whole.GetStateChangeCount());
+	}
+
+	// Nothing to record records nothing
+	NullCommandRecorder empty;
+	CommandListBackend emptyBackend(empty);
+	RecordParallel(jobs, emptyBackend, 0, 16,
+		[&](CommandRecorder& recorder, unsigned int begin, unsigned int end)
+		{
+			RecordDraws(draws, recorder, begin, end);
+		});
+	CHECK(empty.GetStateChangeCount() == 0 && empty.GetDrawCount() == 0);
+}
+
+BENCHMARK(CommandRecorderNullBackend)
+{
+	const unsigned int count = 100000;
+	TestDrawList draws;
+	MakeDrawList(count, 2, draws);
+	RecordFunction record = [&](CommandRecorder& recorder, unsigned int begin, unsigned int end)
+	{
+		RecordDraws(draws, recorder, begin, end);
+	};
+
+	NullCommandRecorder counts;
+	double serialMs = TimeBestMs(5, [&]() { counts.Reset(); record(counts, 0, count); });
+	ReportBenchmark("Draws", count, "draws");
+	ReportBenchmark("Record directly", serialMs, "ms");
+	ReportBenchmark("Record directly, throughput", count / serialMs / 1000.0, "M draws/s");
+
+	// Through command lists, which are then replayed in order
+	JobSystem jobs;
+	CommandListBackend backend(counts);
+	const unsigned int chunkSizes[] = { 64, 256, 1024, 4096 };
+	for (unsigned int c = 0; c < sizeof(chunkSizes) / sizeof(chunkSizes[0]); c++)
+	{
+		double ms = TimeBestMs(5, [&]() { counts.Reset(); RecordParallel(jobs, backend, count, chunkSizes[c], record); });
+		std::string name = "Record in chunks of " + std::to_string(chunkSizes[c]);
+		ReportBenchmark(name.c_str(), ms, "ms");
+		ReportBenchmark((name + ", throughput").c_str(), count / ms / 1000.0, "M draws/s");
+	}
+}
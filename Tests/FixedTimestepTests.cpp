@@ -0,0 +1,126 @@
+#include "TestFramework.h"
+#include "FixedTimestep.h"
+#include "HeadlessLoop.h"
+
+#include <vector>
+
+TEST(FixedTimestepStepsSeeTheirOwnTime)
+{
+	FixedTimestep timestep(60.0, 8);
+	timestep.Advance(1.0);	// More than the cap, to start partway in
+
+	double before = timestep.GetSimulationTime();
+	unsigned int steps = timestep.Advance(5.5 / 60.0);
+	CHECK(steps == 5);
+
+	for (unsigned int i = 0; i < steps; i++)
+		CHECK_NEAR(timestep.GetStepTime(i), before + (i + 1) / 60.0, 1e-9);
+	CHECK_NEAR(timestep.GetStepTime(steps - 1), timestep.GetSimulationTime(), 1e-9);
+}
+
+TEST(FixedTimestepCatchUpStepsIncreaseInLoop)
+{
+	// 0.1 s frames at 60 ticks per second - six steps a frame,
+	// each of which should see a later time than the last
+	std::vector<double> frameTimes;
+	std::vector<double> allTimes;
+	unsigned int frame = 0;
+	bool frameOk = true;
+	HeadlessLoop loop(
+		[&](float deltaTime, double totalTime)
+		{
+			frameTimes.push_back(totalTime);
+			allTimes.push_back(totalTime);
+			frameOk = frameOk && deltaTime > 0.0f;
+		},
+		[&](float, double, float)
+		{
+			// Every step this frame saw a different, increasing time
+			for (size_t i = 1; i < frameTimes.size(); i++)
+				frameOk = frameOk && frameTimes[i] > frameTimes[i - 1];
+			frameTimes.clear();
+			frame++;
+		});
+
+	HeadlessLoopSettings settings;
+	settings.frameCount = 20;
+	settings.fixedDeltaTime = 0.1f;
+	settings.fixedTickRate = 60.0;
+	HeadlessLoopReport report = loop.Run(settings);
+
+	CHECK(frameOk);
+	CHECK(report.tickCount == allTimes.size());
+	CHECK(report.tickCount >= 20 * 5);
+	for (size_t i = 0; i < allTimes.size(); i++)
+		CHECK_NEAR(allTimes[i], (i + 1) / 60.0, 1e-9);
+}
+
+TEST(FixedTimestepCapDropsExtraTime)
+{
+	FixedTimestep timestep(100.0, 4);
+	unsigned int steps = timestep.Advance(1.005);
+	CHECK(steps == 4);
+	CHECK(timestep.GetDroppedSteps() == 96);
+	CHECK_NEAR(timestep.GetInterpolationAlpha(), 0.5, 1e-3);
+
+	// The next frame doesn't have to pay for the stall
+	CHECK(timestep.Advance(0.01) == 1);
+}
+
+TEST(FixedTimestepRateChangeKeepsElapsedTime)
+{
+	// A second at 60 Hz, then half a second at 20 Hz
+	FixedTimestep timestep(60.0, 8);
+	for (unsigned int i = 0; i < 30; i++)
+		timestep.Advance(2.0 / 60.0);
+	CHECK(timestep.GetTotalSteps() == 60);
+	CHECK_NEAR(timestep.GetSimulationTime(), 1.0, 1e-9);
+
+	// Switching doesn't rescale the time already simulated
+	timestep.SetTickRate(20.0);
+	CHECK_NEAR(timestep.GetSimulationTime(), 1.0, 1e-9);
+
+	double before = timestep.GetSimulationTime();
+	unsigned int steps = timestep.Advance(0.1);
+	CHECK(steps == 2);
+	for (unsigned int i = 0; i < steps; i++)
+		CHECK_NEAR(timestep.GetStepTime(i), before + (i + 1) / 20.0, 1e-9);
+
+	for (unsigned int i = 0; i < 4; i++)
+		timestep.Advance(0.1);
+	CHECK(timestep.GetTotalSteps() == 70);
+	CHECK_NEAR(timestep.GetSimulationTime(), 1.5, 1e-9);
+
+	// And back again, which adds to the total rather than
+	// starting it over
+	timestep.SetTickRate(60.0);
+	timestep.Advance(0.5);
+	CHECK_NEAR(timestep.GetSimulationTime(), 1.5 + 8 / 60.0, 1e-9);
+	CHECK_NEAR(timestep.GetStepTime(7), timestep.GetSimulationTime(), 1e-9);
+
+	timestep.Reset();
+	CHECK(timestep.GetSimulationTime() == 0.0 && timestep.GetTotalSteps() == 0);
+}
+
+BENCHMARK(FixedTimestepTickThroughput)
+{
+	// A little work per tick, with drawing left out entirely,
+	// as a stand-in for simulation throughput
+	volatile double sink = 0.0;
+	HeadlessLoop loop([&](float deltaTime, double totalTime)
+		{
+			double x = totalTime;
+			for (int i = 0; i < 100; i++)
+				x = x * 0.999 + deltaTime;
+			sink = x;
+		});
+
+	HeadlessLoopSettings settings;
+	settings.frameCount = 20000;
+	settings.fixedDeltaTime = 1.0f / 30.0f;
+	settings.fixedTickRate = 120.0;
+	HeadlessLoopReport report = loop.Run(settings);
+
+	ReportBenchmark("Ticks simulated", (double)report.tickCount, "ticks");
+	ReportBenchmark("Tick throughput", report.ticksPerSecond / 1e6, "M ticks/s");
+}
@@ -0,0 +1,158 @@
+#include "TestFramework.h"
+#include "FrameStats.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string ReadFile(const std::string& path)
+{
+	std::ifstream file(path);
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+TEST(FrameStatsNearestRankPercentiles)
+{
+	// 1 to 100 ms, added out of order
+	FrameStats stats(100, 1000.0);
+	for (unsigned int i = 0; i < 100; i++)
+		stats.AddFrame((double)((i * 37) % 100 + 1));
+
+	FrameStatsSummary summary = stats.GetSummary();
+	CHECK(summary.sampleCount == 100);
+	CHECK(summary.minMs == 1.0 && summary.maxMs == 100.0);
+	CHECK_NEAR(summary.averageMs, 50.5, 1e-9);
+	CHECK(summary.p50Ms == 50.0 && summary.p95Ms == 95.0 && summary.p99Ms == 99.0);
+
+	// Nearest rank rounds up, and stays inside the window
+	CHECK(stats.GetPercentile(0.0) == 1.0);
+	CHECK(stats.GetPercentile(50.5) == 51.0);
+	CHECK(stats.GetPercentile(100.0) == 100.0);
+	CHECK(stats.GetPercentile(250.0) == 100.0);
+
+	// A small window picks whole frames, never averages them
+	FrameStats few(10, 1000.0);
+	few.AddFrame(4.0);
+	few.AddFrame(2.0);
+	few.AddFrame(8.0);
+	CHECK(few.GetPercentile(50.0) == 4.0);
+	CHECK(few.GetPercentile(67.0) == 8.0);
+	CHECK(few.GetPercentile(66.0) == 4.0);
+
+	FrameStats empty;
+	CHECK(empty.GetSummary().sampleCount == 0 && empty.GetPercentile(50.0) == 0.0);
+}
+
+TEST(FrameStatsWindowWrapsAround)
+{
+	// 150 frames through a 100 frame window leaves 51 to 150
+	FrameStats stats(100, 1000.0);
+	for (unsigned int i = 1; i <= 150; i++)
+		stats.AddFrame((double)i);
+
+	FrameStatsSummary summary = stats.GetSummary();
+	CHECK(summary.sampleCount == 100 && summary.totalFrames == 150);
+	CHECK(summary.minMs == 51.0 && summary.maxMs == 150.0);
+	CHECK(summary.p50Ms == 100.0 && summary.p99Ms == 149.0);
+	CHECK_NEAR(summary.averageMs, 100.5, 1e-9);
+
+	// Adding a frame after a query is seen by the next one
+	stats.AddFrame(1.0);
+	CHECK(stats.GetSummary().minMs == 1.0 && stats.GetSummary().maxMs == 150.0);
+
+	stats.Reset();
+	summary = stats.GetSummary();
+	CHECK(summary.sampleCount == 0 && summary.totalFrames == 0 && summary.totalHitches == 0);
+}
+
+TEST(FrameStatsCountsHitches)
+{
+	// Every tenth frame is over a 16 ms budget (equal to it isn't)
+	FrameStats stats(50, 16.0);
+	for (unsigned int i = 0; i < 200; i++)
+		stats.AddFrame(i % 10 == 0 ? 40.0 : i % 10 == 1 ? 16.0 : 10.0);
+
+	FrameStatsSummary summary = stats.GetSummary();
+	CHECK(summary.windowHitches == 5);
+	CHECK(summary.totalHitches == 20);
+	CHECK(summary.totalFrames == 200);
+	CHECK(summary.budgetMs == 16.0);
+
+	// A new budget re-counts the window, but not the totals
+	stats.SetBudget(12.0);
+	CHECK(stats.GetBudget() == 12.0);
+	summary = stats.GetSummary();
+	CHECK(summary.windowHitches == 10);
+	CHECK(summary.totalHitches == 20);
+
+	stats.AddFrame(13.0);
+	CHECK(stats.GetSummary().totalHitches == 21);
+}
+
+TEST(FrameStatsHistogramOverflow)
+{
+	// 2 ms buckets covering 0 to 20 ms, with the last one also
+	// holding anything longer
+	FrameStats stats(16, 16.0, 2.0, 10);
+	CHECK(stats.GetHistogramBucketMs() == 2.0);
+	const double frames[] = { 0.5, 1.99, 2.0, 5.0, 17.9, 18.0, 19.9, 20.0, 500.0, -3.0 };
+	for (unsigned int i = 0; i < sizeof(frames) / sizeof(frames[0]); i++)
+		stats.AddFrame(frames[i]);
+
+	const std::vector<unsigned long long>& histogram = stats.GetHistogram();
+	const unsigned long long expected[] = { 3, 1, 1, 0, 0, 0, 0, 0, 1, 4 };
+	CHECK(histogram.size() == 10);
+	for (unsigned int i = 0; i < 10; i++)
+		CHECK(histogram[i] == expected[i]);
+
+	// The histogram covers every frame, not just the window
+	for (unsigned int i = 0; i < 100; i++)
+		stats.AddFrame(3.0);
+	CHECK(stats.GetHistogram()[1] == 101);
+
+	stats.Reset();
+	for (unsigned int i = 0; i < 10; i++)
+		CHECK(stats.GetHistogram()[i] == 0);
+}
+
+TEST(FrameStatsExports)
+{
+	// Wrapped, so the oldest frame isn't first in the ring
+	FrameStats stats(4, 16.0, 10.0, 3);
+	const double frames[] = { 5.0, 6.0, 20.0, 7.0, 8.0, 30.0 };
+	for (unsigned int i = 0; i < 6; i++)
+		stats.AddFrame(frames[i]);
+
+	// Oldest first, numbered from the first frame ever recorded
+	std::string csvPath = GetTestFilePath("FrameStats.csv");
+	CHECK(stats.ExportCSV(csvPath));
+	std::string csv = ReadFile(csvPath);
+	remove(csvPath.c_str());
+	CHECK(csv == "frame,ms,hitch\n2,20,1\n3,7,0\n4,8,0\n5,30,1\n");
+
+	std::string jsonPath = GetTestFilePath("FrameStats.json");
+	CHECK(stats.ExportJSON(jsonPath));
+	std::string json = ReadFile(jsonPath);
+	remove(jsonPath.c_str());
+	CHECK(json.find("{\n") == 0 && json.rfind("}\n") == json.size() - 2);
+	CHECK(json.find("\"sampleCount\": 4,") != std::string::npos);
+	CHECK(json.find("\"averageMs\": 16.25,") != std::string::npos);
+	CHECK(json.find("\"minMs\": 7,") != std::string::npos);
+	CHECK(json.find("\"p50Ms\": 8,") != std::string::npos);
+	CHECK(json.find("\"p99Ms\": 30,") != std::string::npos);
+	CHECK(json.find("\"maxMs\": 30,") != std::string::npos);
+	CHECK(json.find("\"budgetMs\": 16,") != std::string::npos);
+	CHECK(json.find("\"windowHitches\": 2,") != std::string::npos);
+	CHECK(json.find("\"totalHitches\": 2,") != std::string::npos);
+	CHECK(json.find("\"totalFrames\": 6,") != std::string::npos);
+	CHECK(json.find("\"histogramBucketMs\": 10,") != std::string::npos);
+	CHECK(json.find("\"histogram\": [4, 0, 2]\n") != std::string::npos);
+
+	// Nowhere to write to
+	CHECK(!stats.ExportCSV(GetTestFilePath("Missing/FrameStats.csv")));
+	CHECK(!stats.ExportJSON(GetTestFilePath("Missing/FrameStats.json")));
+}
@@ -0,0 +1,178 @@
+#include "TestFramework.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+static Frustum MakeCameraFrustum()
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(
+		XMMatrixLookAtLH(XMVectorSet(0, 0, -120, 1), XMVectorSet(10, 0, 0, 1), XMVectorSet(0, 1, 0, 0)),
+		XMMatrixPerspectiveFovLH(1.2f, 16.0f / 9.0f, 0.1f, 200.0f)));
+	return ExtractFrustum(viewProjection);
+}
+
+// Random objects spread around (and beyond) the frustum,
+// with their sphere around their box. Also lists the ones
+// whose sphere and box are both in the frustum, if asked
+static void SetRandomBounds(FrustumCuller& culler, unsigned int count, unsigned int seed,
+	const Frustum* frustum = 0, std::vector<unsigned int>* expected = 0)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+	std::uniform_real_distribution<float> size(0.1f, 5.0f);
+
+	culler.Resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT3 center(position(random), position(random), position(random));
+		XMFLOAT3 half(size(random), size(random) * 0.2f, size(random));
+		float radius = sqrtf(half.x * half.x + half.y * half.y + half.z * half.z);
+		XMFLOAT3 boxMin(center.x - half.x, center.y - half.y, center.z - half.z);
+		XMFLOAT3 boxMax(center.x + half.x, center.y + half.y, center.z + half.z);
+		culler.SetBounds(i, center, radius, boxMin, boxMax);
+
+		if (expected && SphereInFrustum(*frustum, center, radius) && BoxInFrustum(*frustum, boxMin, boxMax))
+			expected->push_back(i);
+	}
+}
+
+TEST(FrustumPlanesFromPerspective)
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 1.0f, 100.0f));
+	Frustum frustum = ExtractFrustum(viewProjection);
+
+	// Looking down +z with a 90 degree field of view
+	CHECK(SphereInFrustum(frustum, XMFLOAT3(0, 0, 50), 0.1f));
+	CHECK(!SphereInFrustum(frustum, XMFLOAT3(0, 0, 0.5f), 0.1f));
+	CHECK(!SphereInFrustum(frustum, XMFLOAT3(0, 0, 101), 0.5f));
+	CHECK(!SphereInFrustum(frustum, XMFLOAT3(-20, 0, 10), 1.0f));
+	CHECK(SphereInFrustum(frustum, XMFLOAT3(-11, 0, 10), 1.0f));
+
+	// Normalized, so plane distances are real distances
+	CHECK_NEAR(frustum.planes[FrustumPlaneNear].z * 2.0f + frustum.planes[FrustumPlaneNear].w, 1.0, 1e-4);
+
+	CHECK(BoxInFrustum(frustum, XMFLOAT3(-100, -1, 40), XMFLOAT3(100, 1, 41)));
+	CHECK(!BoxInFrustum(frustum, XMFLOAT3(-1, -1, -10), XMFLOAT3(1, 1, -5)));
+}
+
+TEST(FrustumCullerEveryPathMatchesReference)
+{
+	const unsigned int count = 100003;	// Not a multiple of any vector width
+	Frustum frustum = MakeCameraFrustum();
+	FrustumCuller culler;
+	std::vector<unsigned int> expected;
+	SetRandomBounds(culler, count, 1, &frustum, &expected);
+	CHECK(expected.size() > 1000 && expected.size() < count / 2);
+
+	JobSystem jobs(4);
+	FrustumCullPath original = GetFrustumCullPath();
+	for (int path = FrustumCullScalar; path <= FrustumCullAVX2; path++)
+	{
+		SetFrustumCullPath((FrustumCullPath)path);
+		for (int threaded = 0; threaded < 2; threaded++)
+		{
+			std::vector<unsigned int> visible;
+			unsigned int visibleCount = culler.Cull(frustum, visible, threaded ? &jobs : 0);
+			CHECK(visibleCount == visible.size());
+			CHECK(visible == expected);
+			CHECK(culler.GetStats().visibleCount == visibleCount);
+		}
+	}
+	SetFrustumCullPath(original);
+}
+
+TEST(FrustumCullerWorldBoundsContainTransformedBox)
+{
+	const unsigned int count = 1001;
+	XMFLOAT3 shapeMins[2] = { XMFLOAT3(-1, -1, -1), XMFLOAT3(-0.5f, 0, -5) };
+	XMFLOAT3 shapeMaxs[2] = { XMFLOAT3(1, 1, 1), XMFLOAT3(0.5f, 2, 5) };
+
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<XMFLOAT4X4> worlds(count);
+	std::vector<unsigned int> shapes(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMMATRIX world = XMMatrixMultiply(XMMatrixMultiply(
+			XMMatrixScaling(2.0f + unit(random), 1.0f, 1.5f),
+			XMMatrixRotationRollPitchYaw(unit(random) * 3.0f, unit(random) * 3.0f, unit(random) * 3.0f)),
+			XMMatrixTranslation(unit(random) * 50.0f, unit(random) * 50.0f, unit(random) * 50.0f));
+		XMStoreFloat4x4(&worlds[i], world);
+		shapes[i] = i & 1;
+	}
+
+	FrustumCuller culler;
+	JobSystem jobs(4);
+	culler.UpdateBounds(worlds.data(), shapes.data(), shapeMins, shapeMaxs, count, &jobs);
+	CHECK(culler.GetCount() == count);
+
+	// The world box is exactly the transformed corners' bounds
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const XMFLOAT3& low = shapeMins[shapes[i]];
+		const XMFLOAT3& high = shapeMaxs[shapes[i]];
+		XMVECTOR expectedMin = XMVectorReplicate(1e30f);
+		XMVECTOR expectedMax = XMVectorReplicate(-1e30f);
+		for (unsigned int c = 0; c < 8; c++)
+		{
+			XMVECTOR corner = XMVectorSet(c & 1 ? high.x : low.x, c & 2 ? high.y : low.y, c & 4 ? high.z : low.z, 1.0f);
+			corner = XMVector3TransformCoord(corner, XMLoadFloat4x4(&worlds[i]));
+			expectedMin = XMVectorMin(expectedMin, corner);
+			expectedMax = XMVectorMax(expectedMax, corner);
+		}
+
+		XMFLOAT3 boxMin, boxMax, wantMin, wantMax;
+		culler.GetBox(i, boxMin, boxMax);
+		XMStoreFloat3(&wantMin, expectedMin);
+		XMStoreFloat3(&wantMax, expectedMax);
+		CHECK_NEAR(boxMin.x, wantMin.x, 1e-3);
+		CHECK_NEAR(boxMin.y, wantMin.y, 1e-3);
+		CHECK_NEAR(boxMin.z, wantMin.z, 1e-3);
+		CHECK_NEAR(boxMax.x, wantMax.x, 1e-3);
+		CHECK_NEAR(boxMax.y, wantMax.y, 1e-3);
+		CHECK_NEAR(boxMax.z, wantMax.z, 1e-3);
+	}
+}
+
+BENCHMARK(FrustumCullerMillionObjects)
+{
+	const unsigned int count = 1000000;
+	FrustumCuller culler;
+	SetRandomBounds(culler, count, 3);
+	Frustum frustum = MakeCameraFrustum();
+	JobSystem jobs;
+
+	static const char* const pathNames[] = { "scalar", "SSE2", "AVX2" };
+	FrustumCullPath original = GetFrustumCullPath();
+	std::vector<unsigned int> visible;
+	double scalarMs = 0.0;
+
+	for (int path = FrustumCullScalar; path <= FrustumCullAVX2; path++)
+	{
+		if (SetFrustumCullPath((FrustumCullPath)path) != path)
+			continue;
+
+		double serialMs = TimeBestMs(10, [&]() { culler.Cull(frustum, visible); });
+		double jobsMs = TimeBestMs(10, [&]() { culler.Cull(frustum, visible, &jobs); });
+		if (path == FrustumCullScalar)
+			scalarMs = serialMs;
+
+		char what[96];
+		snprintf(what, sizeof(what), "Cull 1M objects, %s", pathNames[path]);
+		ReportBenchmark(what, serialMs, "ms");
+		snprintf(what, sizeof(what), "Cull 1M objects, %s, job system", pathNames[path]);
+		ReportBenchmark(what, jobsMs, "ms");
+		snprintf(what, sizeof(what), "Speedup over scalar, %s", pathNames[path]);
+		ReportBenchmark(what, scalarMs / serialMs, "x");
+	}
+
+	ReportBenchmark("Visible", (double)visible.size(), "objects");
+	SetFrustumCullPath(original);
+}
@@ -0,0 +1,141 @@
+#include "TestFramework.h"
+#include "GameClock.h"
+
+#include <cstdint>
+
+TEST(GameClockManualTimeRunsForDays)
+{
+	// Three days of 60 Hz frames at nanosecond resolution, which
+	// float seconds couldn't count to the nanosecond
+	ManualTimeSource time;
+	GameClock clock(&time);
+	const int64_t frameTicks = 16666667;
+	const int64_t frames = 3 * 24 * 60 * 60 * 60;
+	for (int64_t i = 0; i < frames; i++)
+	{
+		time.Advance(frameTicks);
+		clock.Tick();
+		if (clock.GetDeltaTicks() != frameTicks)
+			break;
+	}
+
+	CHECK(clock.GetDeltaTicks() == frameTicks);
+	CHECK(clock.GetTotalTicks() == frames * frameTicks);
+	CHECK(clock.GetFrequency() == 1000000000);
+	CHECK(clock.GetTotalSeconds() == (double)(frames * frameTicks / 1000000000) + (frames * frameTicks % 1000000000) / 1e9);
+	CHECK_NEAR(clock.GetDeltaSeconds(), 0.016666667, 1e-12);
+
+	// Seconds are rounded to the nearest tick
+	ManualTimeSource millis(1000);
+	GameClock coarse(&millis);
+	millis.AdvanceSeconds(0.0016);
+	coarse.Tick();
+	CHECK(coarse.GetDeltaTicks() == 2);
+	millis.AdvanceSeconds(0.0014);
+	coarse.Tick();
+	CHECK(coarse.GetTotalTicks() == 3);
+}
+
+TEST(GameClockChildrenPauseAndScaleWithoutDrift)
+{
+	ManualTimeSource time(1000);
+	GameClock root(&time);
+	GameClock gameplay(root);
+	GameClock slow(gameplay);
+	GameClock ui(root);
+
+	// A third of a tick is left over every frame, and is carried
+	// instead of lost
+	slow.SetScale(1.0 / 3.0);
+	const int64_t frames = 300000;
+	for (int64_t i = 0; i < frames; i++)
+	{
+		time.Advance(7);
+		root.Tick();
+	}
+	CHECK(root.GetTotalTicks() == frames * 7);
+	CHECK(gameplay.GetTotalTicks() == frames * 7);
+	CHECK(ui.GetTotalTicks() == frames * 7);
+	CHECK(slow.GetTotalTicks() >= frames * 7 / 3 - 1 && slow.GetTotalTicks() <= frames * 7 / 3);
+
+	// Pausing gameplay stops it and everything below it, but
+	// not its siblings
+	gameplay.SetPaused(true);
+	CHECK(gameplay.IsPaused());
+	int64_t slowBefore = slow.GetTotalTicks();
+	for (int i = 0; i < 100; i++)
+	{
+		time.Advance(10);
+		root.Tick();
+	}
+	CHECK(gameplay.GetDeltaTicks() == 0 && gameplay.GetTotalTicks() == frames * 7);
+	CHECK(slow.GetDeltaTicks() == 0 && slow.GetTotalTicks() == slowBefore);
+	CHECK(ui.GetTotalTicks() == frames * 7 + 1000);
+
+	// Scales multiply down the tree, and can't go negative
+	gameplay.SetPaused(false);
+	gameplay.SetScale(2.0);
+	slow.SetScale(0.25);
+	time.Advance(100);
+	root.Tick();
+	CHECK(gameplay.GetDeltaTicks() == 200);
+	CHECK(slow.GetDeltaTicks() == 50);
+	slow.SetScale(-1.0);
+	CHECK(slow.GetScale() == 0.0);
+	time.Advance(100);
+	root.Tick();
+	CHECK(slow.GetDeltaTicks() == 0);
+
+	// Child clocks only move when their root is ticked
+	slow.Tick();
+	CHECK(slow.GetDeltaTicks() == 0);
+}
+
+TEST(GameClockResetReachesChildren)
+{
+	ManualTimeSource time(1000);
+	GameClock root(&time);
+	GameClock child(root);
+	GameClock grandchild(child);
+	grandchild.SetScale(0.5);
+
+	time.Advance(25);
+	root.Tick();
+	CHECK(grandchild.GetTotalTicks() == 12);
+
+	// Everything starts over, with no leftover fraction of a tick
+	time.Advance(1000);
+	root.Reset();
+	CHECK(root.GetTotalTicks() == 0 && child.GetTotalTicks() == 0 && grandchild.GetTotalTicks() == 0);
+	CHECK(root.GetDeltaTicks() == 0 && child.GetDeltaTicks() == 0 && grandchild.GetDeltaTicks() == 0);
+
+	// Time before the reset isn't counted
+	time.Advance(4);
+	root.Tick();
+	CHECK(root.GetTotalTicks() == 4 && child.GetTotalTicks() == 4);
+	CHECK(grandchild.GetTotalTicks() == 2);
+
+	// Resetting a child leaves its parent alone
+	child.Reset();
+	CHECK(root.GetTotalTicks() == 4 && child.GetTotalTicks() == 0 && grandchild.GetTotalTicks() == 0);
+}
+
+TEST(GameClockClampsTimeGoingBackwards)
+{
+	ManualTimeSource time(1000);
+	GameClock root(&time);
+	GameClock child(root);
+
+	time.Advance(50);
+	root.Tick();
+	time.Advance(-30);
+	root.Tick();
+	CHECK(root.GetDeltaTicks() == 0 && child.GetDeltaTicks() == 0);
+	CHECK(root.GetTotalTicks() == 50);
+
+	// Time picks up from wherever the source went back to
+	time.Advance(10);
+	root.Tick();
+	CHECK(root.GetDeltaTicks() == 10 && root.GetTotalTicks() == 60);
+	CHECK(child.GetTotalTicks() == 60);
+}
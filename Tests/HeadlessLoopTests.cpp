@@ -0,0 +1,73 @@
+#include "TestFramework.h"
+#include "HeadlessLoop.h"
+
+TEST(HeadlessLoopRunsRequestedFrames)
+{
+	unsigned int updates = 0;
+	unsigned int draws = 0;
+	HeadlessLoop loop(
+		[&](float, double) { updates++; },
+		[&](float, double, float) { draws++; });
+
+	HeadlessLoopSettings settings;
+	settings.frameCount = 250;
+	settings.fixedDeltaTime = 1.0f / 60.0f;
+	HeadlessLoopReport report = loop.Run(settings);
+
+	CHECK(report.frameCount == 250);
+	CHECK(updates == 250);
+	CHECK(draws == 250);
+	CHECK(report.tickCount == 250);
+	CHECK(report.frameStats.sampleCount == 250);
+	CHECK(report.frameStats.minMs <= report.frameStats.p50Ms);
+	CHECK(report.frameStats.p50Ms <= report.frameStats.p99Ms);
+	CHECK(report.frameStats.p99Ms <= report.frameStats.maxMs);
+}
+
+TEST(HeadlessLoopFixedDeltaDrivesGameTime)
+{
+	// Each frame should see exactly one frame's worth of time,
+	// however fast the loop actually runs
+	float lastDelta = 0.0f;
+	double lastTotal = 0.0;
+	HeadlessLoop loop([&](float deltaTime, double totalTime) { lastDelta = deltaTime; lastTotal = totalTime; });
+
+	HeadlessLoopSettings settings;
+	settings.frameCount = 3600;
+	settings.fixedDeltaTime = 0.5f;
+	loop.Run(settings);
+
+	CHECK_NEAR(lastDelta, 0.5, 1e-6);
+	CHECK_NEAR(lastTotal, 1800.0, 1e-6);
+}
+
+TEST(HeadlessLoopQuitStopsUnlimitedRun)
+{
+	unsigned int updates = 0;
+	HeadlessLoop* running = 0;
+	HeadlessLoop loop([&](float, double)
+		{
+			if (++updates == 500)
+				running->Quit();
+		});
+	running = &loop;
+
+	HeadlessLoopSettings settings;
+	HeadlessLoopReport report = loop.Run(settings);
+	CHECK(report.frameCount == 500);
+	CHECK(updates == 500);
+}
+
+BENCHMARK(HeadlessLoopOverhead)
+{
+	// An empty update, so this is just the loop's own cost
+	HeadlessLoop loop([](float, double) {});
+
+	HeadlessLoopSettings settings;
+	settings.frameCount = 100000;
+	settings.fixedDeltaTime = 1.0f / 60.0f;
+	HeadlessLoopReport report = loop.Run(settings);
+
+	ReportBenchmark("Loop overhead per frame (empty update)", report.totalSeconds * 1e9 / report.frameCount, "ns");
+	ReportBenchmark("Frame time p99", report.frameStats.p99Ms * 1e6, "ns");
+}
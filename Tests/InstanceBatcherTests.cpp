@@ -0,0 +1,195 @@
+#include "TestFramework.h"
+#include "InstanceBatcher.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// What each entity draws, added in a shuffled order
+struct TestEntities
+{
+	std::vector<unsigned int> meshes;
+	std::vector<unsigned int> materials;
+	std::vector<unsigned int> lods;
+	std::vector<unsigned int> addOrder;
+	std::vector<XMFLOAT4X4> worlds;
+};
+
+static void MakeEntities(unsigned int count, unsigned int seed, TestEntities& entities)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	entities.meshes.resize(count);
+	entities.materials.resize(count);
+	entities.lods.resize(count);
+	entities.addOrder.resize(count);
+	entities.worlds.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		entities.meshes[i] = random() % 10;
+		entities.materials[i] = random() % 5;
+		entities.lods[i] = random() % 3;
+		entities.addOrder[i] = i;
+
+		XMMATRIX world = XMMatrixMultiply(
+			XMMatrixMultiply(
+				XMMatrixScaling(unit(random) + 2.0f, unit(random) + 2.0f, unit(random) + 2.0f),
+				XMMatrixRotationRollPitchYaw(unit(random) * 3.0f, unit(random) * 3.0f, unit(random) * 3.0f)),
+			XMMatrixTranslation(unit(random) * 50.0f, unit(random) * 50.0f, unit(random) * 50.0f));
+		XMStoreFloat4x4(&entities.worlds[i], world);
+	}
+	std::shuffle(entities.addOrder.begin(), entities.addOrder.end(), random);
+}
+
+static bool MatricesNear(const XMFLOAT4X4& a, const XMFLOAT4X4& b, float tolerance)
+{
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			if (std::fabs(a.m[r][c] - b.m[r][c]) > tolerance * (1.0f + std::fabs(b.m[r][c])))
+				return false;
+	return true;
+}
+
+// Checks the batches and packed matrices against the entities,
+// with meshMatrices (if given) applied before each world matrix
+static bool BatchesMatchEntities(
+	const InstanceBatcher& batcher,
+	const TestEntities& entities,
+	const XMFLOAT4X4& viewProjection,
+	const XMFLOAT4X4* meshMatrices)
+{
+	const std::vector<InstanceBatch>& batches = batcher.GetBatches();
+	unsigned int count = (unsigned int)entities.addOrder.size();
+	if (batcher.GetInstanceCount() != count)
+		return false;
+
+	std::vector<bool> seen(count, false);
+	unsigned int nextInstance = 0;
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		const InstanceBatch& batch = batches[b];
+
+		// Ranges follow on from each other with no gaps or overlap
+		if (batch.instanceCount == 0 || batch.firstInstance != nextInstance)
+			return false;
+		nextInstance += batch.instanceCount;
+
+		// Each (mesh, lod, material) is one batch, in that order
+		if (b > 0)
+		{
+			const InstanceBatch& previous = batches[b - 1];
+			if (previous.mesh != batch.mesh ? previous.mesh > batch.mesh :
+				previous.lod != batch.lod ? previous.lod > batch.lod :
+				previous.material >= batch.material)
+				return false;
+		}
+
+		for (unsigned int i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; i++)
+		{
+			unsigned int entity = batcher.GetInstanceEntity(i);
+			if (entity >= count || seen[entity])
+				return false;
+			seen[entity] = true;
+
+			if (entities.meshes[entity] != batch.mesh ||
+				entities.lods[entity] != batch.lod ||
+				entities.materials[entity] != batch.material)
+				return false;
+
+			// Entities stay in order inside a batch, whatever order
+			// they were added in
+			if (i > batch.firstInstance && batcher.GetInstanceEntity(i - 1) >= entity)
+				return false;
+
+			XMMATRIX world = XMLoadFloat4x4(&entities.worlds[entity]);
+			if (meshMatrices)
+				world = XMMatrixMultiply(XMLoadFloat4x4(&meshMatrices[batch.mesh]), world);
+			XMFLOAT4X4 expected;
+			XMStoreFloat4x4(&expected, XMMatrixMultiply(world, XMLoadFloat4x4(&viewProjection)));
+			if (!MatricesNear(batcher.GetInstanceData()[i].WorldViewProjection, expected, 1e-4f))
+				return false;
+		}
+	}
+
+	return nextInstance == count;
+}
+
+TEST(InstanceBatcherGroupsAndPacks)
+{
+	const unsigned int count = 2000;
+	TestEntities entities;
+	MakeEntities(count, 1, entities);
+
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(
+		XMMatrixLookAtLH(XMVectorSet(0, 20, -100, 0), XMVectorZero(), XMVectorSet(0, 1, 0, 0)),
+		XMMatrixPerspectiveFovLH(0.8f, 16.0f / 9.0f, 0.1f, 500.0f)));
+
+	InstanceBatcher batcher;
+	batcher.Reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int e = entities.addOrder[i];
+		batcher.Add(e, entities.meshes[e], entities.materials[e], entities.lods[e]);
+	}
+	batcher.Build(entities.worlds.data(), viewProjection);
+	CHECK(batcher.GetBatches().size() == 10 * 5 * 3);
+	CHECK(BatchesMatchEntities(batcher, entities, viewProjection, 0));
+
+	// Decode matrices (identity for some meshes) are applied
+	// before the world matrix, and only to their own mesh
+	std::vector<XMFLOAT4X4> meshMatrices(10);
+	for (unsigned int m = 0; m < 10; m++)
+	{
+		XMMATRIX decode = m % 3 == 0 ? XMMatrixIdentity() : XMMatrixMultiply(
+			XMMatrixScaling(1.0f / 65535.0f * (m + 1), 2.0f / 65535.0f, 0.5f / 65535.0f),
+			XMMatrixTranslation(-(float)m, 0.25f, 1.0f));
+		XMStoreFloat4x4(&meshMatrices[m], decode);
+	}
+	batcher.Build(entities.worlds.data(), viewProjection, meshMatrices.data());
+	CHECK(BatchesMatchEntities(batcher, entities, viewProjection, meshMatrices.data()));
+
+	// Cleared, it builds nothing
+	batcher.Clear();
+	batcher.Build(entities.worlds.data(), viewProjection);
+	CHECK(batcher.GetBatches().empty() && batcher.GetInstanceCount() == 0);
+}
+
+TEST(InstanceBatcherOrderIsStable)
+{
+	// The same entities added in two different orders give
+	// exactly the same batches and instances
+	const unsigned int count = 500;
+	TestEntities entities;
+	MakeEntities(count, 2, entities);
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+
+	InstanceBatcher first;
+	InstanceBatcher second;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int e = entities.addOrder[i];
+		unsigned int r = entities.addOrder[count - 1 - i];
+		first.Add(e, entities.meshes[e], entities.materials[e], entities.lods[e]);
+		second.Add(r, entities.meshes[r], entities.materials[r], entities.lods[r]);
+	}
+	first.Build(entities.worlds.data(), viewProjection);
+	second.Build(entities.worlds.data(), viewProjection);
+
+	CHECK(first.GetBatches().size() == second.GetBatches().size());
+	for (unsigned int i = 0; i < count; i++)
+		CHECK(first.GetInstanceEntity(i) == second.GetInstanceEntity(i));
+
+	// One entity is one batch of one
+	InstanceBatcher single;
+	single.Add(7, 3, 2, 1);
+	single.Build(entities.worlds.data(), viewProjection);
+	CHECK(single.GetBatches().size() == 1);
+	const InstanceBatch& batch = single.GetBatches()[0];
+	CHECK(batch.mesh == 3 && batch.material == 2 && batch.lod == 1);
+	CHECK(batch.firstInstance == 0 && batch.instanceCount == 1);
+	CHECK(MatricesNear(single.GetInstanceData()[0].WorldViewProjection, entities.worlds[7], 1e-6f));
+}
@@ -0,0 +1,201 @@
+#include "TestFramework.h"
+#include "MeshOptimizer.h"
+#include "ObjImporter.h"
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// A sphere's worth of triangles, optionally in random order
+static void MakeSphere(unsigned int rings, unsigned int segments, bool shuffle, ImportedMesh& mesh)
+{
+	for (unsigned int i = 0; i <= rings; i++)
+	{
+		for (unsigned int j = 0; j <= segments; j++)
+		{
+			float theta = 3.14159265f * i / rings;
+			float phi = 6.2831853f * j / segments;
+			Vertex v = {};
+			v.Position = XMFLOAT3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			v.Normal = v.Position;
+			mesh.vertices.push_back(v);
+		}
+	}
+
+	std::vector<std::array<unsigned int, 3>> triangles;
+	for (unsigned int i = 0; i < rings; i++)
+	{
+		for (unsigned int j = 0; j < segments; j++)
+		{
+			unsigned int a = i * (segments + 1) + j;
+			unsigned int c = a + segments + 1;
+			triangles.push_back({ { a, c, a + 1 } });
+			triangles.push_back({ { a + 1, c, c + 1 } });
+		}
+	}
+	if (shuffle)
+		std::shuffle(triangles.begin(), triangles.end(), std::mt19937(1));
+
+	for (size_t t = 0; t < triangles.size(); t++)
+		mesh.indices32.insert(mesh.indices32.end(), triangles[t].begin(), triangles[t].end());
+}
+
+// Each triangle by its corners' positions, starting from the
+// smallest corner so winding is kept, then sorted - equal
+// for any two meshes with the same triangles in any order
+typedef std::array<float, 9> TriangleKey;
+
+static std::vector<TriangleKey> GetTriangleKeys(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount)
+{
+	std::vector<TriangleKey> keys;
+	for (unsigned int t = 0; t < indexCount; t += 3)
+	{
+		std::array<XMFLOAT3, 3> corners = { { vertices[indices[t]].Position, vertices[indices[t + 1]].Position, vertices[indices[t + 2]].Position } };
+		auto less = [](const XMFLOAT3& a, const XMFLOAT3& b)
+			{
+				return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+			};
+		unsigned int first = less(corners[1], corners[0]) ? 1 : 0;
+		if (less(corners[2], corners[first]))
+			first = 2;
+
+		TriangleKey key;
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			const XMFLOAT3& p = corners[(first + c) % 3];
+			key[c * 3 + 0] = p.x;
+			key[c * 3 + 1] = p.y;
+			key[c * 3 + 2] = p.z;
+		}
+		keys.push_back(key);
+	}
+
+	std::sort(keys.begin(), keys.end());
+	return keys;
+}
+
+TEST(MeshOptimizerVertexCacheKeepsTrianglesAndHelps)
+{
+	ImportedMesh mesh;
+	MakeSphere(40, 80, true, mesh);
+	unsigned int indexCount = (unsigned int)mesh.indices32.size();
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+
+	std::vector<unsigned int> optimized(indexCount);
+	OptimizeVertexCache(optimized.data(), mesh.indices32.data(), indexCount, vertexCount);
+	CHECK(GetTriangleKeys(mesh.vertices.data(), optimized.data(), indexCount) ==
+		GetTriangleKeys(mesh.vertices.data(), mesh.indices32.data(), indexCount));
+
+	VertexCacheStats before = AnalyzeVertexCache(mesh.indices32.data(), indexCount, vertexCount);
+	VertexCacheStats after = AnalyzeVertexCache(optimized.data(), indexCount, vertexCount);
+	CHECK(before.acmr > 2.0f);
+	CHECK(after.acmr < 0.75f);
+	CHECK(after.atvr < 1.5f);
+
+	// In place gives the same answer
+	std::vector<unsigned int> inPlace(mesh.indices32);
+	OptimizeVertexCache(inPlace.data(), inPlace.data(), indexCount, vertexCount);
+	CHECK(inPlace == optimized);
+}
+
+TEST(MeshOptimizerOverdrawStaysUnderThreshold)
+{
+	ImportedMesh mesh;
+	MakeSphere(40, 80, true, mesh);
+	unsigned int indexCount = (unsigned int)mesh.indices32.size();
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+
+	OptimizeVertexCache(mesh.indices32.data(), mesh.indices32.data(), indexCount, vertexCount);
+	float cacheAcmr = AnalyzeVertexCache(mesh.indices32.data(), indexCount, vertexCount).acmr;
+
+	std::vector<unsigned int> optimized(indexCount);
+	OptimizeOverdraw(optimized.data(), mesh.indices32.data(), indexCount, mesh.vertices.data(), vertexCount, 1.05f);
+	CHECK(GetTriangleKeys(mesh.vertices.data(), optimized.data(), indexCount) ==
+		GetTriangleKeys(mesh.vertices.data(), mesh.indices32.data(), indexCount));
+	CHECK(AnalyzeVertexCache(optimized.data(), indexCount, vertexCount).acmr <= cacheAcmr * 1.05f + 1e-4f);
+}
+
+TEST(MeshOptimizerVertexFetchOrdersByFirstUse)
+{
+	// Five vertices, one unused, used in the order 3 1 4 / 3 4 0
+	Vertex vertices[5] = {};
+	for (unsigned int i = 0; i < 5; i++)
+		vertices[i].Position = XMFLOAT3((float)i, 0.0f, 0.0f);
+	unsigned int indices[6] = { 3, 1, 4, 3, 4, 0 };
+
+	Vertex reordered[5] = {};
+	unsigned int count = OptimizeVertexFetch(reordered, indices, 6, vertices, 5);
+	CHECK(count == 4);
+	CHECK(indices[0] == 0 && indices[1] == 1 && indices[2] == 2);
+	CHECK(indices[3] == 0 && indices[4] == 2 && indices[5] == 3);
+	CHECK(reordered[0].Position.x == 3.0f);
+	CHECK(reordered[1].Position.x == 1.0f);
+	CHECK(reordered[2].Position.x == 4.0f);
+	CHECK(reordered[3].Position.x == 0.0f);
+}
+
+TEST(MeshOptimizerMeshKeepsLevelsApart)
+{
+	// Two levels of 16-bit indices - each has to stay in its
+	// own range, with its own triangles
+	ImportedMesh mesh;
+	MakeSphere(20, 40, true, mesh);
+	unsigned int fullCount = (unsigned int)mesh.indices32.size();
+	std::vector<unsigned int> coarse(mesh.indices32.begin(), mesh.indices32.begin() + fullCount / 2);
+	mesh.indices32.insert(mesh.indices32.end(), coarse.begin(), coarse.end());
+
+	MeshLod lods[2] = { { 0, fullCount, 0.0f }, { fullCount, fullCount / 2, 0.1f } };
+	mesh.lods.assign(lods, lods + 2);
+	mesh.indices16.assign(mesh.indices32.begin(), mesh.indices32.end());
+	mesh.indices32.clear();
+	mesh.uses16BitIndices = true;
+
+	std::vector<unsigned int> original(mesh.indices16.begin(), mesh.indices16.end());
+	std::vector<Vertex> originalVertices(mesh.vertices);
+	std::vector<TriangleKey> fullBefore = GetTriangleKeys(originalVertices.data(), original.data(), fullCount);
+	std::vector<TriangleKey> coarseBefore = GetTriangleKeys(originalVertices.data(), original.data() + fullCount, fullCount / 2);
+
+	MeshOptimizeOptions options;
+	options.overdraw = true;
+	MeshOptimizeStats stats;
+	OptimizeMesh(mesh, options, &stats);
+
+	CHECK(mesh.uses16BitIndices && mesh.indices32.empty());
+	std::vector<unsigned int> indices(mesh.indices16.begin(), mesh.indices16.end());
+	CHECK(GetTriangleKeys(mesh.vertices.data(), indices.data(), fullCount) == fullBefore);
+	CHECK(GetTriangleKeys(mesh.vertices.data(), indices.data() + fullCount, fullCount / 2) == coarseBefore);
+	CHECK(stats.after.acmr < stats.before.acmr);
+}
+
+BENCHMARK(MeshOptimizerShuffledSphere)
+{
+	ImportedMesh shuffled;
+	MakeSphere(200, 400, true, shuffled);
+	unsigned int triangles = (unsigned int)shuffled.indices32.size() / 3;
+
+	MeshOptimizeStats cacheStats;
+	MeshOptimizeStats overdrawStats;
+	double cacheMs = TimeBestMs(3, [&]()
+		{
+			ImportedMesh mesh(shuffled);
+			OptimizeMesh(mesh, MeshOptimizeOptions(), &cacheStats);
+		});
+	double overdrawMs = TimeBestMs(3, [&]()
+		{
+			ImportedMesh mesh(shuffled);
+			MeshOptimizeOptions options;
+			options.overdraw = true;
+			OptimizeMesh(mesh, options, &overdrawStats);
+		});
+
+	ReportBenchmark("Triangles", triangles, "triangles");
+	ReportBenchmark("ACMR before", cacheStats.before.acmr, "");
+	ReportBenchmark("ACMR after vertex cache", cacheStats.after.acmr, "");
+	ReportBenchmark("ACMR after vertex cache and overdraw", overdrawStats.after.acmr, "");
+	ReportBenchmark("Optimize, vertex cache and fetch", cacheMs, "ms");
+	ReportBenchmark("Optimize, with overdraw", overdrawMs, "ms");
+	ReportBenchmark("Throughput, vertex cache and fetch", triangles / (cacheMs * 1000.0), "M triangles/s");
+}
@@ -0,0 +1,301 @@
+#include "TestFramework.h"
+#include "MeshSimplifier.h"
+#include "LodSelector.h"
+#include "ObjImporter.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// A unit sphere, rings by segments, with its seam welded
+// shut so nothing is locked except the poles
+static void MakeSphere(unsigned int rings, unsigned int segments, ImportedMesh& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices32.clear();
+	mesh.uses16BitIndices = false;
+
+	for (unsigned int i = 0; i <= rings; i++)
+	{
+		for (unsigned int j = 0; j < segments; j++)
+		{
+			float theta = 3.14159265f * i / rings;
+			float phi = 6.2831853f * j / segments;
+			Vertex v = {};
+			v.Position = XMFLOAT3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			v.Normal = v.Position;
+			v.Color = XMFLOAT4(1, 1, 1, 1);
+			mesh.vertices.push_back(v);
+		}
+	}
+
+	for (unsigned int i = 0; i < rings; i++)
+	{
+		for (unsigned int j = 0; j < segments; j++)
+		{
+			unsigned int a = i * segments + j;
+			unsigned int b = i * segments + (j + 1) % segments;
+			unsigned int c = a + segments;
+			unsigned int d = b + segments;
+			if (i > 0)
+				mesh.indices32.insert(mesh.indices32.end(), { a, c, b });
+			if (i < rings - 1)
+				mesh.indices32.insert(mesh.indices32.end(), { b, c, d });
+		}
+	}
+}
+
+// A flat square grid, size by size quads
+static void MakeGrid(unsigned int size, ImportedMesh& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices32.clear();
+	mesh.uses16BitIndices = false;
+
+	for (unsigned int y = 0; y <= size; y++)
+	{
+		for (unsigned int x = 0; x <= size; x++)
+		{
+			Vertex v = {};
+			v.Position = XMFLOAT3((float)x, 0.0f, (float)y);
+			v.Normal = XMFLOAT3(0, 1, 0);
+			v.Color = XMFLOAT4(1, 1, 1, 1);
+			mesh.vertices.push_back(v);
+		}
+	}
+
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int a = y * (size + 1) + x;
+			unsigned int c = a + size + 1;
+			mesh.indices32.insert(mesh.indices32.end(), { a, c, a + 1, a + 1, c, c + 1 });
+		}
+	}
+}
+
+// Distance from p to the segment ab
+static float SegmentDistance(FXMVECTOR p, FXMVECTOR a, FXMVECTOR b)
+{
+	XMVECTOR ab = XMVectorSubtract(b, a);
+	float t = XMVectorGetX(XMVector3Dot(XMVectorSubtract(p, a), ab)) / std::max(XMVectorGetX(XMVector3LengthSq(ab)), 1e-20f);
+	t = std::min(std::max(t, 0.0f), 1.0f);
+	return XMVectorGetX(XMVector3Length(XMVectorSubtract(p, XMVectorAdd(a, XMVectorScale(ab, t)))));
+}
+
+// Distance from p to the nearest of a level's triangles,
+// checking every one - straight to the plane if p is over
+// the triangle, otherwise to its nearest edge
+static float DistanceToLevel(const XMFLOAT3& position, const ImportedMesh& mesh, const MeshLod& lod)
+{
+	XMVECTOR p = XMLoadFloat3(&position);
+	float nearest = 1e30f;
+	for (unsigned int i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; i += 3)
+	{
+		XMVECTOR a = XMLoadFloat3(&mesh.vertices[mesh.indices32[i + 0]].Position);
+		XMVECTOR b = XMLoadFloat3(&mesh.vertices[mesh.indices32[i + 1]].Position);
+		XMVECTOR c = XMLoadFloat3(&mesh.vertices[mesh.indices32[i + 2]].Position);
+
+		XMVECTOR normal = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+		bool inside =
+			XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f &&
+			XMVectorGetX(XMVector3Dot(XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(p, a)), normal)) >= 0.0f &&
+			XMVectorGetX(XMVector3Dot(XMVector3Cross(XMVectorSubtract(c, b), XMVectorSubtract(p, b)), normal)) >= 0.0f &&
+			XMVectorGetX(XMVector3Dot(XMVector3Cross(XMVectorSubtract(a, c), XMVectorSubtract(p, c)), normal)) >= 0.0f;
+
+		float distance;
+		if (inside)
+			distance = fabsf(XMVectorGetX(XMVector3Dot(XMVectorSubtract(p, a), XMVector3Normalize(normal))));
+		else
+			distance = std::min(SegmentDistance(p, a, b), std::min(SegmentDistance(p, b, c), SegmentDistance(p, c, a)));
+		nearest = std::min(nearest, distance);
+	}
+	return nearest;
+}
+
+// Every level's error should be the farthest any full
+// resolution vertex is from its surface, and never less
+// than a finer level's
+static void CheckLodErrors(const ImportedMesh& mesh, bool& ok)
+{
+	ok = mesh.lods.size() >= 3 && mesh.lods[0].error == 0.0f;
+	for (size_t l = 1; ok && l < mesh.lods.size(); l++)
+	{
+		const MeshLod& lod = mesh.lods[l];
+		float farthest = 0.0f;
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+			farthest = std::max(farthest, DistanceToLevel(mesh.vertices[v].Position, mesh, lod));
+
+		// Allowing for float rounding, relative to the mesh's
+		// size of about one unit
+		float finer = mesh.lods[l - 1].error;
+		ok = lod.error >= finer &&
+			farthest <= lod.error + 1e-5f &&
+			(lod.error <= farthest + 1e-5f || lod.error == finer);
+	}
+}
+
+TEST(LodErrorIsFarthestDroppedVertexOnSphere)
+{
+	ImportedMesh mesh;
+	MakeSphere(16, 32, mesh);
+
+	LodChainOptions options;
+	options.maxError = 0.25f;
+	options.minTriangles = 16;
+	BuildLodChain(mesh, options);
+
+	bool ok = false;
+	CheckLodErrors(mesh, ok);
+	CHECK(ok);
+	CHECK(mesh.lods.back().error > 0.0f && mesh.lods.back().error < 1.0f);
+}
+
+TEST(LodErrorIsFarthestDroppedVertexOnGrid)
+{
+	// The inside of a flat grid collapses without moving the
+	// surface at all, so any error is from its outline
+	ImportedMesh mesh;
+	MakeGrid(24, mesh);
+	BuildLodChain(mesh);
+
+	bool ok = false;
+	CheckLodErrors(mesh, ok);
+	CHECK(ok);
+	CHECK(mesh.lods[1].error < 1.0f);
+}
+
+TEST(SimplifyMeshCollapsedVerticesAreInResult)
+{
+	ImportedMesh mesh;
+	MakeSphere(24, 48, mesh);
+	unsigned int vertexCount = (unsigned int)mesh.vertices.size();
+
+	std::vector<unsigned int> result(mesh.indices32.size());
+	std::vector<unsigned int> collapsedInto(vertexCount);
+	float error = -1.0f;
+	unsigned int count = SimplifyMesh(
+		result.data(), mesh.indices32.data(), (unsigned int)mesh.indices32.size(),
+		mesh.vertices.data(), vertexCount,
+		(unsigned int)mesh.indices32.size() / 4, 1.0f, &error, collapsedInto.data());
+	CHECK(count < mesh.indices32.size() / 2);
+	CHECK(error > 0.0f && error < 0.5f);
+
+	std::vector<unsigned char> used(vertexCount, 0);
+	for (unsigned int i = 0; i < count; i++)
+		used[result[i]] = 1;
+
+	unsigned int collapsed = 0;
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		if (collapsedInto[v] == v)
+			continue;
+
+		CHECK(!used[v]);
+		CHECK(used[collapsedInto[v]]);
+		collapsed++;
+	}
+	CHECK(collapsed > 0);
+}
+
+TEST(LodSelectorCoarserWithDistanceAndHysteresis)
+{
+	LodSelector selector;
+	MeshLod lods[4] = { { 0, 0, 0.0f }, { 0, 0, 0.001f }, { 0, 0, 0.004f }, { 0, 0, 0.016f } };
+	selector.SetMeshLods(0, lods, 4);
+
+	XMFLOAT4X4 projection = {};
+	projection._22 = 1.0f;
+	selector.SetProjection(projection, 1000.0f);	// 500 pixels per unit, one unit away
+	selector.SetThreshold(1.0f, 0.25f);
+
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixIdentity());
+	unsigned int mesh = 0;
+	unsigned char lod = 0;
+
+	// Moving away only ever gets coarser, and ends up coarsest
+	unsigned char last = 0;
+	for (float distance = 0.1f; distance < 100.0f; distance *= 1.1f)
+	{
+		world._43 = distance;
+		selector.Select(&world, &mesh, 1, XMFLOAT3(0, 0, 0), &lod);
+		CHECK(lod >= last);
+		last = lod;
+	}
+	CHECK(lod == 3);
+
+	// Level 2's error is a pixel at 2 units - wobbling just
+	// past that shouldn't switch back and forth
+	lod = 1;
+	unsigned int switches = 0;
+	for (int i = 0; i < 100; i++)
+	{
+		unsigned char before = lod;
+		world._43 = 2.0f * ((i & 1) ? 1.05f : 0.95f);
+		selector.Select(&world, &mesh, 1, XMFLOAT3(0, 0, 0), &lod);
+		if (lod != before)
+			switches++;
+	}
+	CHECK(switches <= 1);
+
+	// Scaling the object up makes its error bigger on screen
+	world._43 = 10.0f;
+	lod = 0;
+	selector.Select(&world, &mesh, 1, XMFLOAT3(0, 0, 0), &lod);
+	unsigned char unscaled = lod;
+	world._11 = world._22 = world._33 = 8.0f;
+	lod = 0;
+	selector.Select(&world, &mesh, 1, XMFLOAT3(0, 0, 0), &lod);
+	CHECK(lod < unscaled);
+}
+
+BENCHMARK(LodChainBuild)
+{
+	ImportedMesh sphere;
+	MakeSphere(200, 400, sphere);
+	unsigned int triangles = (unsigned int)sphere.indices32.size() / 3;
+
+	ImportedMesh mesh;
+	LodChainStats stats;
+	double ms = TimeBestMs(3, [&]()
+		{
+			mesh = sphere;
+			BuildLodChain(mesh, LodChainOptions(), &stats);
+		});
+
+	ReportBenchmark("Full resolution triangles", triangles, "triangles");
+	ReportBenchmark("Levels built", (double)mesh.lods.size(), "levels");
+	ReportBenchmark("Coarsest level's error (unit sphere)", mesh.lods.back().error, "units");
+	ReportBenchmark("Build time", ms, "ms");
+	ReportBenchmark("Throughput", stats.trianglesProcessed / (stats.simplifyMs * 1000.0), "M triangles/s");
+}
+
+BENCHMARK(LodSelectorMillionObjects)
+{
+	LodSelector selector;
+	MeshLod lods[4] = { { 0, 0, 0.0f }, { 0, 0, 0.001f }, { 0, 0, 0.004f }, { 0, 0, 0.016f } };
+	selector.SetMeshLods(0, lods, 4);
+
+	const unsigned int count = 1000000;
+	std::vector<XMFLOAT4X4> worlds(count);
+	std::vector<unsigned int> meshes(count, 0);
+	std::vector<unsigned char> selected(count, 0);
+	std::mt19937 random(1);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMStoreFloat4x4(&worlds[i], XMMatrixTranslation(
+			(random() % 1000) * 0.3f, (random() % 1000) * 0.3f, (random() % 1000) * 0.3f));
+	}
+
+	JobSystem jobs;
+	double serialMs = TimeBestMs(3, [&]() { selector.Select(worlds.data(), meshes.data(), count, XMFLOAT3(0, 0, 0), selected.data()); });
+	double jobsMs = TimeBestMs(3, [&]() { selector.Select(worlds.data(), meshes.data(), count, XMFLOAT3(0, 0, 0), selected.data(), &jobs); });
+
+	ReportBenchmark("Select, 1M objects", serialMs, "ms");
+	ReportBenchmark("Select, 1M objects, job system", jobsMs, "ms");
+}
@@ -0,0 +1,269 @@
+#include "TestFramework.h"
+#include "MeshletBuilder.h"
+
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// A lumpy sphere, so clusters face every way and their cones
+// have some spread
+static void MakeLumpySphere(unsigned int rings, unsigned int segments, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	std::mt19937 random(rings);
+	std::uniform_real_distribution<float> lump(0.998f, 1.002f);
+	vertices.clear();
+	indices.clear();
+	for (unsigned int i = 0; i <= rings; i++)
+	{
+		for (unsigned int j = 0; j <= segments; j++)
+		{
+			float theta = 3.14159265f * i / rings;
+			float phi = 6.2831853f * j / segments;
+			float radius = lump(random);
+			Vertex v = {};
+			v.Position = XMFLOAT3(sinf(theta) * cosf(phi) * radius, cosf(theta) * radius, sinf(theta) * sinf(phi) * radius);
+			v.Normal = v.Position;
+			vertices.push_back(v);
+		}
+	}
+
+	for (unsigned int i = 0; i < rings; i++)
+	{
+		for (unsigned int j = 0; j < segments; j++)
+		{
+			unsigned int a = i * (segments + 1) + j;
+			unsigned int c = a + segments + 1;
+			unsigned int triangles[6] = { a, c, a + 1, a + 1, c, c + 1 };
+			indices.insert(indices.end(), triangles, triangles + 6);
+		}
+	}
+}
+
+static XMFLOAT4X4 MakeViewProjection(const XMFLOAT3& camera, const XMFLOAT3& target)
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(
+		XMMatrixLookAtLH(XMLoadFloat3(&camera), XMLoadFloat3(&target), XMVectorSet(0, 1, 0, 0)),
+		XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 100.0f)));
+	return viewProjection;
+}
+
+// Whether a world space point is inside the view
+static bool InView(FXMVECTOR point, const XMFLOAT4X4& viewProjection)
+{
+	XMFLOAT4 clip;
+	XMStoreFloat4(&clip, XMVector4Transform(XMVectorSetW(point, 1.0f), XMLoadFloat4x4(&viewProjection)));
+	return clip.w > 0.0f &&
+		clip.x >= -clip.w && clip.x <= clip.w &&
+		clip.y >= -clip.w && clip.y <= clip.w &&
+		clip.z >= 0.0f && clip.z <= clip.w;
+}
+
+// Culls the meshlets, then checks:
+//  - The output is exactly the surviving meshlets' indices, in order
+//  - No culled meshlet has a triangle that faces the camera (by its
+//    winding in world space) with a corner or its middle in view
+//  - The stats add up
+template<typename Index>
+static bool CullIsConservative(
+	const std::vector<Meshlet>& meshlets,
+	const std::vector<Index>& indices,
+	const std::vector<Vertex>& vertices,
+	const XMFLOAT4X4& world,
+	const XMFLOAT3& camera,
+	const XMFLOAT3& target,
+	MeshletCullStats& stats)
+{
+	XMFLOAT4X4 viewProjection = MakeViewProjection(camera, target);
+	std::vector<Index> output(indices.size());
+	unsigned int written = CullMeshlets(meshlets.data(), (unsigned int)meshlets.size(),
+		indices.data(), sizeof(Index), world, viewProjection, &camera, output.data(), &stats);
+
+	XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+	XMVECTOR cameraPosition = XMLoadFloat3(&camera);
+	unsigned int position = 0;
+	unsigned int culled = 0;
+	unsigned int triangleCount = 0;
+	for (size_t m = 0; m < meshlets.size(); m++)
+	{
+		const Meshlet& meshlet = meshlets[m];
+		unsigned int count = meshlet.triangleCount * 3;
+		triangleCount += meshlet.triangleCount;
+
+		// Survivors are copied in order, so each one is next
+		bool survived = position + count <= written;
+		for (unsigned int i = 0; survived && i < count; i++)
+			survived = output[position + i] == indices[meshlet.firstIndex + i];
+		if (survived)
+		{
+			position += count;
+			continue;
+		}
+
+		culled++;
+		for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+		{
+			XMVECTOR p[3];
+			for (unsigned int c = 0; c < 3; c++)
+				p[c] = XMVector3TransformCoord(XMLoadFloat3(&vertices[indices[meshlet.firstIndex + t * 3 + c]].Position), worldMatrix);
+
+			XMVECTOR normal = XMVector3Cross(XMVectorSubtract(p[1], p[0]), XMVectorSubtract(p[2], p[0]));
+			XMVECTOR toCamera = XMVectorSubtract(cameraPosition, p[0]);
+			float facing = XMVectorGetX(XMVector3Dot(normal, toCamera));
+			float scale = XMVectorGetX(XMVector3Length(normal)) * XMVectorGetX(XMVector3Length(toCamera));
+			if (facing <= 1e-4f * scale)
+				continue;
+
+			XMVECTOR middle = XMVectorScale(XMVectorAdd(XMVectorAdd(p[0], p[1]), p[2]), 1.0f / 3.0f);
+			if (InView(p[0], viewProjection) || InView(p[1], viewProjection) ||
+				InView(p[2], viewProjection) || InView(middle, viewProjection))
+				return false;
+		}
+	}
+
+	return position == written &&
+		stats.meshletCount == meshlets.size() &&
+		stats.frustumCulled + stats.backfaceCulled == culled &&
+		stats.triangleCount == triangleCount &&
+		stats.trianglesCulled == triangleCount - written / 3 &&
+		stats.culledTriangleRatio == (float)stats.trianglesCulled / triangleCount;
+}
+
+TEST(MeshletCullNeverDropsVisibleTriangles)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeLumpySphere(48, 256, vertices, indices);
+	std::vector<Meshlet> meshlets;
+	BuildMeshlets(indices.data(), (unsigned int)indices.size(), vertices.data(), (unsigned int)vertices.size(), meshlets);
+	CHECK(meshlets.size() > 40);
+
+	// Rotated and moved, and then scaled evenly, unevenly, sheared
+	// and mirrored
+	XMMATRIX placement = XMMatrixMultiply(XMMatrixRotationRollPitchYaw(0.3f, 1.1f, -0.4f), XMMatrixTranslation(0.5f, -0.25f, 1.0f));
+	XMMATRIX shear = XMMatrixIdentity();
+	shear.r[1] = XMVectorSet(0.8f, 1.0f, 0.0f, 0.0f);
+	const XMMATRIX shapes[5] =
+	{
+		XMMatrixIdentity(),
+		XMMatrixScaling(1.5f, 1.5f, 1.5f),
+		XMMatrixScaling(3.0f, 0.25f, 1.0f),
+		shear,
+		XMMatrixScaling(-1.0f, 1.0f, 1.0f),
+	};
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (unsigned int s = 0; s < 5; s++)
+	{
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixMultiply(shapes[s], placement));
+
+		unsigned int backfaceCulled = 0;
+		unsigned int frustumCulled = 0;
+		for (unsigned int view = 0; view < 100; view++)
+		{
+			// From close by to far away, often looking off to one side
+			XMVECTOR direction = XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0.0f));
+			XMFLOAT3 camera;
+			XMFLOAT3 target(0.5f + unit(random) * 2.0f, -0.25f + unit(random) * 2.0f, 1.0f + unit(random) * 2.0f);
+			XMStoreFloat3(&camera, XMVectorAdd(XMLoadFloat3(&target), XMVectorScale(direction, 2.5f + view * 0.1f)));
+
+			MeshletCullStats stats;
+			CHECK(CullIsConservative(meshlets, indices, vertices, world, camera, target, stats));
+			backfaceCulled += stats.backfaceCulled;
+			frustumCulled += stats.frustumCulled;
+		}
+
+		// The cones still cull, except under a mirroring matrix
+		CHECK(frustumCulled > 0);
+		CHECK(s == 4 ? backfaceCulled == 0 : backfaceCulled > 100);
+	}
+}
+
+TEST(MeshletCullOffscreenAndCompacted)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeLumpySphere(64, 256, vertices, indices);
+	std::vector<Meshlet> meshlets;
+	BuildMeshlets(indices.data(), (unsigned int)indices.size(), vertices.data(), (unsigned int)vertices.size(), meshlets);
+	unsigned int meshletCount = (unsigned int)meshlets.size();
+	unsigned int triangleCount = (unsigned int)indices.size() / 3;
+
+	XMFLOAT3 camera(0, 0, -5);
+	XMFLOAT3 target(0, 0, 0);
+	XMFLOAT4X4 viewProjection = MakeViewProjection(camera, target);
+	std::vector<unsigned int> output(indices.size());
+
+	// Entirely behind the camera, so every cluster is off screen
+	XMFLOAT4X4 behind;
+	XMStoreFloat4x4(&behind, XMMatrixTranslation(0, 0, -20));
+	MeshletCullStats stats;
+	CHECK(CullMeshlets(meshlets.data(), meshletCount, indices.data(), 4, behind, viewProjection, &camera, output.data(), &stats) == 0);
+	CHECK(stats.frustumCulled == meshletCount && stats.backfaceCulled == 0);
+	CHECK(stats.trianglesCulled == triangleCount && stats.culledTriangleRatio == 1.0f);
+
+	// In view with no camera position, nothing is culled and the
+	// output is the whole index buffer
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	CHECK(CullMeshlets(meshlets.data(), meshletCount, indices.data(), 4, identity, viewProjection, 0, output.data(), &stats) == indices.size());
+	CHECK(output == indices);
+	CHECK(stats.frustumCulled == 0 && stats.backfaceCulled == 0);
+	CHECK(stats.trianglesCulled == 0 && stats.culledTriangleRatio == 0.0f);
+
+	// From outside, a little over half the sphere faces away, and
+	// the cones catch a good part of that
+	CHECK(CullIsConservative(meshlets, indices, vertices, identity, camera, target, stats));
+	CHECK(stats.frustumCulled == 0 && stats.backfaceCulled > 0);
+	CHECK(stats.culledTriangleRatio > 0.1f && stats.culledTriangleRatio < 0.6f);
+
+	// 16-bit indices compact the same way
+	std::vector<unsigned short> indices16(indices.begin(), indices.end());
+	MeshletCullStats stats16;
+	CHECK(CullIsConservative(meshlets, indices16, vertices, identity, camera, target, stats16));
+	CHECK(stats16.trianglesCulled == stats.trianglesCulled);
+
+	// Nothing to cull
+	CHECK(CullMeshlets(meshlets.data(), 0, indices.data(), 4, identity, viewProjection, &camera, output.data(), &stats) == 0);
+	CHECK(stats.meshletCount == 0 && stats.culledTriangleRatio == 0.0f);
+}
+
+BENCHMARK(MeshletBuildAndCull)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> source;
+	MakeLumpySphere(256, 512, vertices, source);
+
+	std::vector<unsigned int> indices;
+	std::vector<Meshlet> meshlets;
+	double buildMs = TimeBestMs(3, [&]()
+		{
+			indices = source;
+			meshlets.clear();
+			BuildMeshlets(indices.data(), (unsigned int)indices.size(), vertices.data(), (unsigned int)vertices.size(), meshlets);
+		});
+	ReportBenchmark("Triangles", indices.size() / 3.0, "triangles");
+	ReportBenchmark("Build meshlets", buildMs, "ms");
+	ReportBenchmark("Meshlets", (double)meshlets.size(), "meshlets");
+
+	// Close enough that some of the sphere is off screen
+	XMFLOAT3 camera(0.0f, 0.5f, -1.6f);
+	XMFLOAT3 target(0.3f, 0.0f, 0.0f);
+	XMFLOAT4X4 viewProjection = MakeViewProjection(camera, target);
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixIdentity());
+	std::vector<unsigned int> output(indices.size());
+	MeshletCullStats stats;
+	double cullMs = TimeBestMs(20, [&]()
+		{
+			CullMeshlets(meshlets.data(), (unsigned int)meshlets.size(), indices.data(), 4,
+				world, viewProjection, &camera, output.data(), &stats);
+		});
+	ReportBenchmark("Cull and compact", cullMs, "ms");
+	ReportBenchmark("Meshlets off screen", stats.frustumCulled, "meshlets");
+	ReportBenchmark("Meshlets facing away", stats.backfaceCulled, "meshlets");
+	ReportBenchmark("Triangles culled", stats.culledTriangleRatio * 100.0, "%");
+}
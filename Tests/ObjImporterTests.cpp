@@ -0,0 +1,137 @@
+#include "TestFramework.h"
+#include "JobSystem.h"
+#include "ObjImporter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static bool Import(const std::string& text, ImportedMesh& mesh, ObjImportStats& stats, JobSystem* jobs = 0)
+{
+	return ImportObjFromMemory(text.data(), text.size(), mesh, jobs, &stats);
+}
+
+// A grid of quads, big enough to be split into chunks
+static std::string MakeGrid(unsigned int size)
+{
+	std::string text;
+	char line[96];
+	for (unsigned int y = 0; y <= size; y++)
+	{
+		for (unsigned int x = 0; x <= size; x++)
+		{
+			snprintf(line, sizeof(line), "v %u.0 %u.0 0.0\n", x, y);
+			text += line;
+		}
+	}
+	text += "vn 0 0 1\n";
+
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int a = y * (size + 1) + x + 1;
+			unsigned int b = a + size + 1;
+			snprintf(line, sizeof(line), "f %u//1 %u//1 %u//1 %u//1\n", a, a + 1, b + 1, b);
+			text += line;
+		}
+	}
+	return text;
+}
+
+static unsigned int CountLines(const std::string& text)
+{
+	unsigned int lines = 0;
+	for (size_t i = 0; i < text.size(); i++)
+		lines += text[i] == '\n';
+	return lines;
+}
+
+TEST(ObjImporterWeldsQuad)
+{
+	ImportedMesh mesh;
+	ObjImportStats stats;
+	CHECK(Import(
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\n"
+		"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+		"vn 0 0 1\n"
+		"f 1/1/1 2/2/1 3/3/1 4/4/1\n"
+		"f -4/-4/-1 -2/-2/-1 -1/-1/-1\n",
+		mesh, stats));
+
+	CHECK(stats.error.empty());
+	CHECK(stats.triangleCount == 3);
+	CHECK(mesh.vertices.size() == 4);
+	CHECK(mesh.uses16BitIndices);
+	CHECK(mesh.indices16.size() == 9);
+	CHECK(mesh.vertices[mesh.indices16[1]].UV.x == 1.0f);
+}
+
+TEST(ObjImporterRejectsZeroIndex)
+{
+	ImportedMesh mesh;
+	ObjImportStats stats;
+	CHECK(!Import("v 0 0 0\nv 1 0 0\nv 1 1 0\n\nf 1 2 3\nf 0 2 3\n", mesh, stats));
+	CHECK(stats.error.find("line 6:") == 0);
+	CHECK(stats.error.find("position") != std::string::npos);
+	CHECK(stats.error.find("f 0 2 3") != std::string::npos);
+}
+
+TEST(ObjImporterRejectsOutOfRangeIndices)
+{
+	ImportedMesh mesh;
+	ObjImportStats stats;
+
+	// Past the end, and before the start
+	CHECK(!Import("v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4\n", mesh, stats));
+	CHECK(stats.error.find("line 4:") == 0);
+	CHECK(!Import("v 0 0 0\nv 1 0 0\nv 1 1 0\nf -4 2 3\n", mesh, stats));
+	CHECK(stats.error.find("line 4:") == 0);
+
+	// Normals and uvs have to exist too, if they're given
+	CHECK(!Import("v 0 0 0\nv 1 0 0\nv 1 1 0\nvn 0 0 1\r\nf 1//1 2//1 3//2\r\n", mesh, stats));
+	CHECK(stats.error.find("line 5:") == 0);
+	CHECK(stats.error.find("normal") != std::string::npos);
+	CHECK(stats.error.find('\r') == std::string::npos);
+
+	// No positions at all
+	CHECK(!Import("f 1 2 3\n", mesh, stats));
+	CHECK(stats.error.find("line 1:") == 0);
+
+	// Left out entirely is fine
+	CHECK(Import("v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1// 2// 3//\n", mesh, stats));
+	CHECK(stats.error.empty());
+}
+
+TEST(ObjImporterNamesLineAcrossChunks)
+{
+	// Several megabytes, so the bad face is in a later chunk
+	std::string text = MakeGrid(400);
+	unsigned int badLine = CountLines(text) + 1;
+	text += "f 1 2 999999\n";
+	text += MakeGrid(10);
+
+	JobSystem jobs(4);
+	ImportedMesh mesh;
+	ObjImportStats stats;
+	CHECK(!Import(text, mesh, stats, &jobs));
+
+	char expected[32];
+	snprintf(expected, sizeof(expected), "line %u:", badLine);
+	CHECK(stats.error.find(expected) == 0);
+}
+
+BENCHMARK(ObjImporterParseThroughput)
+{
+	std::string text = MakeGrid(700);
+	JobSystem jobs;
+	ImportedMesh mesh;
+	ObjImportStats stats;
+
+	double singleMs = TimeBestMs(3, [&]() { Import(text, mesh, stats); });
+	double parallelMs = TimeBestMs(3, [&]() { Import(text, mesh, stats, &jobs); });
+
+	ReportBenchmark("Triangles", stats.triangleCount, "triangles");
+	ReportBenchmark("Import, one thread", text.size() / 1e6 / (singleMs / 1000.0), "MB/s");
+	ReportBenchmark("Import, job system", text.size() / 1e6 / (parallelMs / 1000.0), "MB/s");
+}
@@ -0,0 +1,388 @@
+#include "TestFramework.h"
+#include "OcclusionCuller.h"
+#include "Frustum.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// The camera sits at the origin looking down +z, so view
+// space is world space and pixels map straight to rays
+static const float TestFov = 1.0f;
+static const float TestNear = 0.1f;
+static const float TestFar = 100.0f;
+
+static XMFLOAT4X4 MakeProjection(const OcclusionCuller& culler)
+{
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, XMMatrixPerspectiveFovLH(
+		TestFov, (float)culler.GetWidth() / culler.GetHeight(), TestNear, TestFar));
+	return projection;
+}
+
+// Where the ray through a pixel's center hits a triangle,
+// as a depth buffer value, or 1 if it misses (or only hits
+// in front of the near plane)
+static float RayTraceDepth(const OcclusionCuller& culler, const XMFLOAT4X4& projection, int x, int y, const XMFLOAT3* corners)
+{
+	float ndcX = ((x + 0.5f) / culler.GetWidth()) * 2.0f - 1.0f;
+	float ndcY = 1.0f - ((y + 0.5f) / culler.GetHeight()) * 2.0f;
+	XMVECTOR direction = XMVectorSet(ndcX / projection._11, ndcY / projection._22, 1.0f, 0.0f);
+
+	// Moller-Trumbore, from the origin
+	XMVECTOR a = XMLoadFloat3(&corners[0]);
+	XMVECTOR edge1 = XMVectorSubtract(XMLoadFloat3(&corners[1]), a);
+	XMVECTOR edge2 = XMVectorSubtract(XMLoadFloat3(&corners[2]), a);
+	XMVECTOR p = XMVector3Cross(direction, edge2);
+	float determinant = XMVectorGetX(XMVector3Dot(edge1, p));
+	if (fabsf(determinant) < 1e-12f)
+		return 1.0f;
+
+	float inverse = 1.0f / determinant;
+	XMVECTOR s = XMVectorScale(a, -1.0f);
+	float u = XMVectorGetX(XMVector3Dot(s, p)) * inverse;
+	XMVECTOR q = XMVector3Cross(s, edge1);
+	float v = XMVectorGetX(XMVector3Dot(direction, q)) * inverse;
+	float t = XMVectorGetX(XMVector3Dot(edge2, q)) * inverse;
+	if (u < 0.0f || v < 0.0f || u + v > 1.0f || t < TestNear)
+		return 1.0f;
+
+	// Direction has z = 1, so t is the view space depth
+	return TestFar / (TestFar - TestNear) * (1.0f - TestNear / t);
+}
+
+struct DepthComparison
+{
+	unsigned int written = 0;		// Pixels the culler drew
+	unsigned int expected = 0;		// Pixels the triangle really covers
+	unsigned int outside = 0;		// Drawn, but not covered
+	unsigned int missed = 0;		// Covered, but not drawn
+	float largestDepthError = 0.0f;
+};
+
+static DepthComparison CompareToRayTrace(const OcclusionCuller& culler, const XMFLOAT4X4& projection, const XMFLOAT3* corners)
+{
+	DepthComparison result;
+	const float* depth = culler.GetDepth();
+	for (int y = 0; y < (int)culler.GetHeight(); y++)
+	{
+		for (int x = 0; x < (int)culler.GetWidth(); x++)
+		{
+			float drawn = depth[y * culler.GetWidth() + x];
+			float traced = RayTraceDepth(culler, projection, x, y, corners);
+			result.written += drawn < 1.0f;
+			result.expected += traced < 1.0f;
+			result.outside += drawn < 1.0f && traced == 1.0f;
+			result.missed += drawn == 1.0f && traced < 1.0f;
+			if (drawn < 1.0f && traced < 1.0f)
+				result.largestDepthError = std::max(result.largestDepthError, fabsf(drawn - traced));
+		}
+	}
+	return result;
+}
+
+TEST(OcclusionCullerClippedTrianglesMatchRayTrace)
+{
+	// Crossing the side of the frustum, with one corner just
+	// past the near plane so it projects tens of thousands of
+	// pixels off screen; crossing the near plane itself; and
+	// the same again reaching behind the camera
+	const XMFLOAT3 cases[][3] = {
+		{ XMFLOAT3(-2, -1, 5), XMFLOAT3(2, -1, 5), XMFLOAT3(5, 1, 0.11f) },
+		{ XMFLOAT3(-3, -1, 0.05f), XMFLOAT3(3, -1, 0.05f), XMFLOAT3(0, 1, 8) },
+		{ XMFLOAT3(-4, -2, -5), XMFLOAT3(4, -2, -5), XMFLOAT3(0, -2, 30) },
+		{ XMFLOAT3(-40, -1, 3), XMFLOAT3(0, 2, 3), XMFLOAT3(1, -1, 20) } };
+	const unsigned int indices[3] = { 0, 1, 2 };
+
+	OcclusionCuller culler;
+	culler.SetResolution(480, 272);
+	XMFLOAT4X4 projection = MakeProjection(culler);
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	OcclusionRasterPath original = GetOcclusionRasterPath();
+	for (unsigned int c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+	{
+		std::vector<float> scalarDepth;
+		for (int path = OcclusionRasterScalar; path <= OcclusionRasterSSE2; path++)
+		{
+			SetOcclusionRasterPath((OcclusionRasterPath)path);
+			culler.BeginFrame(projection);
+			culler.AddOccluder(cases[c], 3, indices, 3, identity);
+			culler.Render();
+
+			// Only pixel centers right on an edge can disagree
+			DepthComparison result = CompareToRayTrace(culler, projection, cases[c]);
+			CHECK(result.expected > 1000);
+			CHECK(result.outside <= result.expected / 200);
+			CHECK(result.missed <= result.expected / 200);
+			CHECK(result.largestDepthError < 1e-3f);
+
+			// Both paths draw exactly the same depths
+			const float* depth = culler.GetDepth();
+			if (path == OcclusionRasterScalar)
+				scalarDepth.assign(depth, depth + culler.GetWidth() * culler.GetHeight());
+			else
+				CHECK(std::equal(scalarDepth.begin(), scalarDepth.end(), depth));
+		}
+	}
+	SetOcclusionRasterPath(original);
+}
+
+TEST(OcclusionCullerBoxTests)
+{
+	OcclusionCuller culler;
+	XMFLOAT4X4 projection = MakeProjection(culler);
+
+	// Nothing drawn hides nothing
+	culler.BeginFrame(projection);
+	culler.Render();
+	std::vector<unsigned int> objects(1, 0);
+	XMFLOAT3 farMin(-1, -1, 50), farMax(1, 1, 52);
+	CHECK(culler.Cull(&farMin, &farMax, objects) == 1);
+
+	// A wall across the whole view at z = 10
+	const XMFLOAT3 wall[4] = { XMFLOAT3(-100, -100, 10), XMFLOAT3(100, -100, 10), XMFLOAT3(100, 100, 10), XMFLOAT3(-100, 100, 10) };
+	const unsigned int indices[6] = { 0, 1, 2, 0, 2, 3 };
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	culler.BeginFrame(projection);
+	culler.AddOccluder(wall, 4, indices, 6, identity);
+	culler.Render();
+
+	CHECK(!culler.IsBoxVisible(farMin, farMax));
+	CHECK(culler.IsBoxVisible(XMFLOAT3(-1, -1, 5), XMFLOAT3(1, 1, 6)));
+	CHECK(culler.IsBoxVisible(XMFLOAT3(-1, -1, 8), XMFLOAT3(1, 1, 12)));
+
+	// Crossing the near plane, or off screen, can't be judged
+	CHECK(culler.IsBoxVisible(XMFLOAT3(-1, -1, -1), XMFLOAT3(1, 1, 50)));
+	CHECK(culler.IsBoxVisible(XMFLOAT3(-1, -1, -20), XMFLOAT3(1, 1, -10)));
+	CHECK(culler.IsBoxVisible(XMFLOAT3(200, -1, 50), XMFLOAT3(202, 1, 52)));
+
+	// Cull keeps the visible ones in order
+	XMFLOAT3 mins[3] = { XMFLOAT3(-1, -1, 5), farMin, XMFLOAT3(2, 2, 5) };
+	XMFLOAT3 maxs[3] = { XMFLOAT3(1, 1, 6), farMax, XMFLOAT3(3, 3, 6) };
+	unsigned int order[3] = { 2, 1, 0 };
+	objects.assign(order, order + 3);
+	CHECK(culler.Cull(mins, maxs, objects) == 2);
+	CHECK(objects[0] == 2 && objects[1] == 0);
+	CHECK(culler.GetStats().occludedCount == 1);
+}
+
+// --------------------------------------------------------
+// A city block of box buildings, and small objects among
+// them - the same scene for the test and the benchmark
+// --------------------------------------------------------
+struct CityBox
+{
+	XMFLOAT3 boundsMin;
+	XMFLOAT3 boundsMax;
+};
+
+struct City
+{
+	std::vector<CityBox> buildings;
+	std::vector<XMFLOAT4X4> worlds;		// Unit cube to each building
+	std::vector<XMFLOAT3> objectMins;
+	std::vector<XMFLOAT3> objectMaxs;
+	XMFLOAT3 eye;
+	XMFLOAT4X4 viewProjection;
+};
+
+static const XMFLOAT3 CubePositions[8] = {
+	XMFLOAT3(-1, -1, -1), XMFLOAT3(1, -1, -1), XMFLOAT3(-1, 1, -1), XMFLOAT3(1, 1, -1),
+	XMFLOAT3(-1, -1, 1), XMFLOAT3(1, -1, 1), XMFLOAT3(-1, 1, 1), XMFLOAT3(1, 1, 1) };
+static const unsigned int CubeIndices[36] = {
+	0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+	2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+
+static void MakeCity(unsigned int blocks, unsigned int objectCount, City& city)
+{
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float extent = blocks * 20.0f;
+
+	for (unsigned int i = 0; i < blocks; i++)
+	{
+		for (unsigned int j = 0; j < blocks; j++)
+		{
+			float x = ((float)i - blocks * 0.5f) * 20.0f;
+			float z = ((float)j - blocks * 0.125f) * 20.0f;
+			float height = 10.0f + unit(random) * 40.0f;
+			CityBox building = { XMFLOAT3(x - 6, 0, z - 6), XMFLOAT3(x + 6, height, z + 6) };
+			city.buildings.push_back(building);
+
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixMultiply(
+				XMMatrixScaling(6.0f, height * 0.5f, 6.0f),
+				XMMatrixTranslation(x, height * 0.5f, z)));
+			city.worlds.push_back(world);
+		}
+	}
+
+	for (unsigned int i = 0; i < objectCount; i++)
+	{
+		float x = (unit(random) - 0.5f) * extent;
+		float z = unit(random) * extent - extent * 0.125f;
+		float y = unit(random) * 8.0f;
+		float size = 0.3f + unit(random);
+		city.objectMins.push_back(XMFLOAT3(x, y, z));
+		city.objectMaxs.push_back(XMFLOAT3(x + size, y + size, z + size));
+	}
+
+	city.eye = XMFLOAT3(3, 2, -extent * 0.15f);
+	XMStoreFloat4x4(&city.viewProjection, XMMatrixMultiply(
+		XMMatrixLookAtLH(XMLoadFloat3(&city.eye), XMVectorSet(3, 2, 0, 1), XMVectorSet(0, 1, 0, 0)),
+		XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f)));
+}
+
+static void RenderCity(const City& city, OcclusionCuller& culler, JobSystem* jobs)
+{
+	culler.BeginFrame(city.viewProjection);
+	for (size_t b = 0; b < city.buildings.size(); b++)
+		culler.AddOccluder(CubePositions, 8, CubeIndices, 36, city.worlds[b]);
+	culler.Render(jobs);
+}
+
+// Whether the segment from a to (nearly) b passes through a box
+static bool SegmentHitsBox(const XMFLOAT3& a, const XMFLOAT3& b, const CityBox& box)
+{
+	float enter = 0.0f;
+	float exit = 0.999f;
+	for (unsigned int axis = 0; axis < 3; axis++)
+	{
+		float start = (&a.x)[axis];
+		float delta = (&b.x)[axis] - start;
+		float low = (&box.boundsMin.x)[axis];
+		float high = (&box.boundsMax.x)[axis];
+		if (fabsf(delta) < 1e-9f)
+		{
+			if (start < low || start > high)
+				return false;
+			continue;
+		}
+
+		float t0 = (low - start) / delta;
+		float t1 = (high - start) / delta;
+		enter = std::max(enter, std::min(t0, t1));
+		exit = std::min(exit, std::max(t0, t1));
+		if (enter > exit)
+			return false;
+	}
+	return true;
+}
+
+TEST(OcclusionCullerOnlyHidesHiddenObjects)
+{
+	City city;
+	MakeCity(12, 20000, city);
+
+	std::vector<unsigned int> inFrustum;
+	Frustum frustum = ExtractFrustum(city.viewProjection);
+	for (unsigned int i = 0; i < city.objectMins.size(); i++)
+		if (BoxInFrustum(frustum, city.objectMins[i], city.objectMaxs[i]))
+			inFrustum.push_back(i);
+
+	OcclusionCuller culler;
+	JobSystem jobs(4);
+	RenderCity(city, culler, &jobs);
+
+	std::vector<unsigned int> serial(inFrustum);
+	std::vector<unsigned int> threaded(inFrustum);
+	culler.Cull(city.objectMins.data(), city.objectMaxs.data(), serial);
+	culler.Cull(city.objectMins.data(), city.objectMaxs.data(), threaded, &jobs);
+	CHECK(serial == threaded);
+	CHECK(serial.size() < inFrustum.size() / 2);
+
+	// Every hidden object really is behind a building - no
+	// corner, edge middle or center can be seen from the eye
+	std::vector<bool> visible(city.objectMins.size(), false);
+	for (size_t i = 0; i < serial.size(); i++)
+		visible[serial[i]] = true;
+
+	for (size_t i = 0; i < inFrustum.size(); i++)
+	{
+		unsigned int object = inFrustum[i];
+		if (visible[object])
+			continue;
+
+		const XMFLOAT3& low = city.objectMins[object];
+		const XMFLOAT3& high = city.objectMaxs[object];
+		for (unsigned int s = 0; s < 27; s++)
+		{
+			XMFLOAT3 point(
+				s % 3 == 0 ? low.x : s % 3 == 1 ? (low.x + high.x) * 0.5f : high.x,
+				s / 3 % 3 == 0 ? low.y : s / 3 % 3 == 1 ? (low.y + high.y) * 0.5f : high.y,
+				s / 9 == 0 ? low.z : s / 9 == 1 ? (low.z + high.z) * 0.5f : high.z);
+
+			bool blocked = false;
+			for (size_t b = 0; b < city.buildings.size() && !blocked; b++)
+				blocked = SegmentHitsBox(city.eye, point, city.buildings[b]);
+			CHECK(blocked);
+		}
+	}
+}
+
+BENCHMARK(OcclusionCullerCity)
+{
+	City city;
+	MakeCity(40, 200000, city);
+
+	std::vector<unsigned int> inFrustum;
+	Frustum frustum = ExtractFrustum(city.viewProjection);
+	for (unsigned int i = 0; i < city.objectMins.size(); i++)
+		if (BoxInFrustum(frustum, city.objectMins[i], city.objectMaxs[i]))
+			inFrustum.push_back(i);
+
+	static const char* const pathNames[] = { "scalar", "SSE2" };
+	OcclusionRasterPath original = GetOcclusionRasterPath();
+	OcclusionCuller culler;
+	JobSystem jobs;
+	std::vector<unsigned int> objects;
+
+	for (int path = OcclusionRasterScalar; path <= OcclusionRasterSSE2; path++)
+	{
+		if (SetOcclusionRasterPath((OcclusionRasterPath)path) != path)
+			continue;
+
+		for (int threaded = 0; threaded < 2; threaded++)
+		{
+			JobSystem* system = threaded ? &jobs : 0;
+			OcclusionStats best;
+			double bestMs = 0.0;
+			for (int run = 0; run < 10; run++)
+			{
+				double ms = TimeBestMs(1, [&]()
+					{
+						RenderCity(city, culler, system);
+						objects = inFrustum;
+						culler.Cull(city.objectMins.data(), city.objectMaxs.data(), objects, system);
+					});
+				if (run == 0 || ms < bestMs)
+				{
+					bestMs = ms;
+					best = culler.GetStats();
+				}
+			}
+
+			char what[96];
+			snprintf(what, sizeof(what), "%s%s, total", pathNames[path], threaded ? ", job system" : "");
+			ReportBenchmark(what, bestMs, "ms");
+			snprintf(what, sizeof(what), "%s%s, setup", pathNames[path], threaded ? ", job system" : "");
+			ReportBenchmark(what, best.setupMs, "ms");
+			snprintf(what, sizeof(what), "%s%s, raster", pathNames[path], threaded ? ", job system" : "");
+			ReportBenchmark(what, best.rasterMs, "ms");
+			snprintf(what, sizeof(what), "%s%s, test", pathNames[path], threaded ? ", job system" : "");
+			ReportBenchmark(what, best.testMs, "ms");
+		}
+	}
+
+	ReportBenchmark("Occluder triangles", culler.GetStats().triangleCount, "triangles");
+	ReportBenchmark("Objects in frustum", (double)inFrustum.size(), "objects");
+	ReportBenchmark("Objects occluded", culler.GetStats().occludedCount, "objects");
+	SetOcclusionRasterPath(original);
+}
@@ -0,0 +1,233 @@
+#include "TestFramework.h"
+#include "Profiler.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Keeps a zone open long enough that no two zones start at
+// the same time, even on a coarse clock
+static void Spin()
+{
+	int64_t start = Profiler::Now();
+	while (Profiler::Now() - start < 2000);
+}
+
+static std::vector<std::string> ReadLines(const std::string& path)
+{
+	std::ifstream file(path);
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(file, line))
+		lines.push_back(line);
+	return lines;
+}
+
+// Lines of the frame summary for one frame, without the times
+static std::vector<std::string> GetSummaryFrame(const std::vector<std::string>& lines, const std::string& frame)
+{
+	std::vector<std::string> zones;
+	size_t i = 0;
+	while (i < lines.size() && lines[i].find(frame + "    ") != 0)
+		i++;
+	for (i++; i < lines.size() && !lines[i].empty(); i++)
+		zones.push_back(lines[i].substr(0, lines[i].find("    ", lines[i].find_first_not_of(' '))));
+	return zones;
+}
+
+// Every event, one per line, between the trace's opening and closing
+static bool IsWellFormedTrace(const std::vector<std::string>& lines)
+{
+	if (lines.size() < 2 || lines.front() != "{\"traceEvents\":[" || lines.back() != "]}")
+		return false;
+
+	for (size_t i = 1; i + 1 < lines.size(); i++)
+	{
+		const std::string& e = lines[i];
+		bool last = i + 2 == lines.size();
+		if (e.empty() || e.front() != '{' || e.substr(e.size() - (last ? 1 : 2)) != (last ? "}" : "},"))
+			return false;
+		if (e.find("\"ph\":\"X\"") == std::string::npos && e.find("\"ph\":\"i\"") == std::string::npos)
+			return false;
+		if (e.find("\"ts\":") == std::string::npos || e.find("\"ts\":-") != std::string::npos)
+			return false;
+		if (e.find("\"dur\":-") != std::string::npos)
+			return false;
+	}
+	return true;
+}
+
+static unsigned int CountEvents(const std::vector<std::string>& lines, const std::string& text)
+{
+	unsigned int count = 0;
+	for (size_t i = 0; i < lines.size(); i++)
+		count += lines[i].find(text) != std::string::npos ? 1 : 0;
+	return count;
+}
+
+TEST(ProfilerNestedZones)
+{
+	Profiler& profiler = Profiler::GetInstance();
+	{
+		// Makes sure this thread has its buffer before the worker's
+		PROFILE_ZONE("Warm up");
+	}
+	profiler.Clear();
+
+	PROFILE_FRAME();
+	{
+		PROFILE_ZONE("Outer");
+		Spin();
+		{
+			PROFILE_ZONE("Inner");
+			Spin();
+			{
+				PROFILE_ZONE("Innermost");
+				Spin();
+			}
+		}
+		{
+			PROFILE_ZONE("Second \"quoted\"");
+			Spin();
+		}
+	}
+
+	// Another thread, during the same frame
+	std::thread worker([]()
+		{
+			PROFILE_ZONE("Worker");
+			Spin();
+			{
+				PROFILE_ZONE("Worker child");
+				Spin();
+			}
+		});
+	worker.join();
+
+	PROFILE_FRAME();
+	{
+		PROFILE_ZONE("Next frame");
+		Spin();
+	}
+	PROFILE_FRAME();
+
+	std::string summaryPath = GetTestFilePath("ProfilerSummary.txt");
+	CHECK(profiler.ExportFrameSummary(summaryPath));
+	std::vector<std::string> summary = ReadLines(summaryPath);
+	remove(summaryPath.c_str());
+
+	// Parents first, indented by depth, with each thread on its own
+	std::vector<std::string> frame = GetSummaryFrame(summary, "Frame 0");
+	CHECK(frame.size() == 8);
+	CHECK(frame[0].find("  [Thread ") == 0);
+	CHECK(frame[1] == "    Outer");
+	CHECK(frame[2] == "      Inner");
+	CHECK(frame[3] == "        Innermost");
+	CHECK(frame[4] == "      Second \"quoted\"");
+	CHECK(frame[5].find("  [Thread ") == 0 && frame[5] != frame[0]);
+	CHECK(frame[6] == "    Worker");
+	CHECK(frame[7] == "      Worker child");
+
+	frame = GetSummaryFrame(summary, "Frame 1");
+	CHECK(frame.size() == 2 && frame[1] == "    Next frame");
+
+	// The last frame hasn't ended, so isn't listed
+	CHECK(summary[0].find("2 frames") != std::string::npos);
+	CHECK(GetSummaryFrame(summary, "Frame 2").empty());
+
+	std::string tracePath = GetTestFilePath("ProfilerTrace.json");
+	CHECK(profiler.ExportChromeTrace(tracePath));
+	std::vector<std::string> trace = ReadLines(tracePath);
+	remove(tracePath.c_str());
+
+	CHECK(IsWellFormedTrace(trace));
+	CHECK(CountEvents(trace, "\"ph\":\"X\"") == 7);
+	CHECK(CountEvents(trace, "\"ph\":\"i\"") == 3);
+	CHECK(CountEvents(trace, "{\"name\":\"Second \\\"quoted\\\"\"") == 1);
+}
+
+TEST(ProfilerRingOverwritesOldestZones)
+{
+	// A fresh thread fills its ring (64K zones) and then some, so
+	// only the newest zones are left
+	Profiler& profiler = Profiler::GetInstance();
+	profiler.Clear();
+
+	const unsigned int ringSize = 64 * 1024;
+	std::thread worker([=]()
+		{
+			for (unsigned int i = 0; i < 1000; i++)
+			{
+				PROFILE_ZONE("Old");
+			}
+			for (unsigned int i = 0; i < ringSize; i++)
+			{
+				PROFILE_ZONE("New");
+			}
+		});
+	worker.join();
+
+	std::string tracePath = GetTestFilePath("ProfilerRing.json");
+	CHECK(profiler.ExportChromeTrace(tracePath));
+	std::vector<std::string> trace = ReadLines(tracePath);
+	remove(tracePath.c_str());
+
+	CHECK(IsWellFormedTrace(trace));
+	CHECK(CountEvents(trace, "{\"name\":\"Old\"") == 0);
+	CHECK(CountEvents(trace, "{\"name\":\"New\"") == ringSize);
+
+	// Clearing throws everything away, leaving an empty list
+	profiler.Clear();
+	CHECK(profiler.ExportChromeTrace(tracePath));
+	trace = ReadLines(tracePath);
+	remove(tracePath.c_str());
+	CHECK(trace.size() == 3 && trace[0] == "{\"traceEvents\":[" && trace[1].empty() && trace[2] == "]}");
+}
+
+BENCHMARK(ProfilerZoneOverhead)
+{
+	Profiler& profiler = Profiler::GetInstance();
+	const unsigned int zones = 1000000;
+
+	// Reading the clock on its own, as each zone does twice
+	volatile int64_t sink = 0;
+	double clockMs = TimeBestMs(5, [&]()
+		{
+			for (unsigned int i = 0; i < zones; i++)
+				sink = Profiler::Now();
+		});
+
+	double zoneMs = TimeBestMs(5, [&]()
+		{
+			profiler.Clear();
+			for (unsigned int i = 0; i < zones; i++)
+			{
+				PROFILE_ZONE("Empty");
+			}
+		});
+
+	double nestedMs = TimeBestMs(5, [&]()
+		{
+			profiler.Clear();
+			for (unsigned int i = 0; i < zones / 4; i++)
+			{
+				PROFILE_ZONE("Depth 0");
+				{
+					PROFILE_ZONE("Depth 1");
+					{
+						PROFILE_ZONE("Depth 2");
+						{
+							PROFILE_ZONE("Depth 3");
+						}
+					}
+				}
+			}
+		});
+	profiler.Clear();
+
+	ReportBenchmark("Read the clock", clockMs * 1000000.0 / zones, "ns");
+	ReportBenchmark("Empty zone", zoneMs * 1000000.0 / zones, "ns");
+	ReportBenchmark("Zone nested four deep", nestedMs * 1000000.0 / zones, "ns");
+}
@@ -0,0 +1,215 @@
+#include "TestFramework.h"
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+TEST(RenderGraphOrdersAndCullsOutOfOrderPasses)
+{
+	// Passes are added before the ones writing what they read
+	RenderGraph graph;
+	std::string order;
+	RenderResourceId hdr = graph.CreateTransient("HDR");
+	RenderResourceId back = graph.Import("Back buffer");
+	RenderResourceId debugTarget = graph.CreateTransient("Debug");
+
+	RenderPassId present = graph.AddPass("Present", [&]() { order += "P"; }, true);
+	RenderPassId tonemap = graph.AddPass("Tonemap", [&]() { order += "T"; });
+	RenderPassId scene = graph.AddPass("Scene", [&]() { order += "S"; });
+	RenderPassId debug = graph.AddPass("Debug", [&]() { order += "D"; });
+
+	RenderResourceId lit = graph.Write(scene, hdr, RenderGraphColorTarget);
+	graph.Read(tonemap, lit);
+	RenderResourceId toned = graph.Write(tonemap, back, RenderGraphColorTarget);
+	graph.Read(present, toned);
+
+	// Nothing reads what this writes, so it's culled
+	graph.Read(debug, lit);
+	graph.Write(debug, debugTarget);
+
+	// Only the newest version of a resource can be written
+	CHECK(graph.Write(debug, hdr, RenderGraphColorTarget) == InvalidRenderGraphId);
+
+	CHECK(graph.Compile());
+	graph.Execute();
+	CHECK(order == "STP");
+	CHECK(graph.IsPassCulled(debug));
+	CHECK(!graph.IsPassCulled(scene));
+	CHECK(graph.GetStats().culledPassCount == 1);
+
+	unsigned int hdrResource = graph.GetResource(lit);
+	CHECK(graph.GetFirstUse(hdrResource) == 0);
+	CHECK(graph.GetLastUse(hdrResource) == 1);
+	CHECK(graph.GetFirstUse(graph.GetResource(debugTarget)) == InvalidRenderGraphId);
+}
+
+TEST(RenderGraphWriteWaitsForEarlierReads)
+{
+	RenderGraph graph;
+	std::string order;
+	RenderResourceId a = graph.CreateTransient("A");
+	RenderResourceId out = graph.Import("Out");
+
+	RenderPassId first = graph.AddPass("First", [&]() { order += "1"; });
+	RenderResourceId a1 = graph.Write(first, a);
+	RenderPassId second = graph.AddPass("Second", [&]() { order += "2"; });
+	RenderResourceId a2 = graph.Write(second, a1);
+	RenderPassId reader = graph.AddPass("Reader", [&]() { order += "R"; });
+	graph.Read(reader, a1);
+	RenderResourceId out1 = graph.Write(reader, out);
+	RenderPassId last = graph.AddPass("Last", [&]() { order += "L"; });
+	graph.Read(last, a2);
+	graph.MarkOutput(graph.Write(last, out1));
+
+	CHECK(graph.Compile());
+	graph.Execute();
+	CHECK(order == "1R2L");
+}
+
+TEST(RenderGraphRejectsInvalidVersions)
+{
+	RenderGraph graph;
+	std::string order;
+	RenderResourceId a = graph.CreateTransient("A");
+	RenderResourceId out = graph.Import("Out");
+
+	RenderPassId first = graph.AddPass("First", [&]() { order += "1"; });
+	RenderResourceId a1 = graph.Write(first, a);
+	RenderPassId second = graph.AddPass("Second", [&]() { order += "2"; });
+	RenderResourceId a2 = graph.Write(second, a1);
+
+	// a1 is stale now, so writing it again fails - and reading
+	// what that returned, or anything made up, declares nothing
+	RenderPassId stale = graph.AddPass("Stale", [&]() { order += "S"; });
+	RenderResourceId failed = graph.Write(stale, a1);
+	CHECK(failed == InvalidRenderGraphId);
+	CHECK(!graph.Read(stale, failed));
+	CHECK(!graph.Read(stale, a2 + 100));
+	CHECK(graph.GetPassAccessCount(stale) == 0);
+
+	// The graph is still usable, without the stale pass
+	RenderPassId last = graph.AddPass("Last", [&]() { order += "L"; });
+	CHECK(graph.Read(last, a2));
+	graph.MarkOutput(graph.Write(last, out));
+
+	CHECK(graph.Compile());
+	graph.Execute();
+	CHECK(order == "12L");
+	CHECK(graph.IsPassCulled(stale));
+}
+
+TEST(RenderGraphRejectsCycles)
+{
+	RenderGraph graph;
+	RenderResourceId x = graph.CreateTransient("X");
+	RenderResourceId y = graph.CreateTransient("Y");
+	RenderPassId a = graph.AddPass("A", 0, true);
+	RenderPassId b = graph.AddPass("B", 0, true);
+	RenderResourceId x1 = graph.Write(a, x);
+	RenderResourceId y1 = graph.Write(b, y);
+	graph.Read(a, y1);
+	graph.Read(b, x1);
+
+	CHECK(!graph.Compile());
+	CHECK(graph.GetExecutedPassCount() == 0);
+}
+
+TEST(RenderGraphRandomChainsRespectDependencies)
+{
+	// Each pass reads some earlier passes' results and writes
+	// its own, but passes are added in a shuffled order
+	std::mt19937 random(9);
+	RenderGraph graph;
+	for (int trial = 0; trial < 200; trial++)
+	{
+		graph.Clear();
+		unsigned int count = 1 + random() % 60;
+		std::vector<unsigned int> addOrder(count);
+		for (unsigned int i = 0; i < count; i++)
+			addOrder[i] = i;
+		std::shuffle(addOrder.begin(), addOrder.end(), random);
+
+		std::vector<RenderPassId> passes(count);
+		std::vector<RenderResourceId> results(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int logical = addOrder[i];
+			passes[logical] = graph.AddPass("Pass", 0, logical == count - 1);
+		}
+
+		std::vector<std::vector<unsigned int>> reads(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			for (unsigned int r = 0; i > 0 && r < 2; r++)
+			{
+				unsigned int source = random() % i;
+				graph.Read(passes[i], results[source]);
+				reads[i].push_back(source);
+			}
+			results[i] = graph.Write(passes[i], graph.CreateTransient("Result"));
+		}
+
+		CHECK(graph.Compile());
+
+		// Kept passes run after what they read, which is kept too
+		std::vector<unsigned int> position(graph.GetPassCount(), InvalidRenderGraphId);
+		for (unsigned int i = 0; i < graph.GetExecutedPassCount(); i++)
+			position[graph.GetExecutedPass(i)] = i;
+		CHECK(position[passes[count - 1]] != InvalidRenderGraphId);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (position[passes[i]] == InvalidRenderGraphId)
+				continue;
+			for (size_t r = 0; r < reads[i].size(); r++)
+			{
+				unsigned int source = position[passes[reads[i][r]]];
+				CHECK(source != InvalidRenderGraphId);
+				CHECK(source < position[passes[i]]);
+			}
+		}
+	}
+}
+
+BENCHMARK(RenderGraphBuildAndCompile)
+{
+	// A 200-pass frame with branches, built and compiled from
+	// scratch every frame, the way Game::Draw() does
+	const unsigned int frames = 2000;
+	std::mt19937 random(1);
+	RenderGraph graph;
+	std::vector<RenderResourceId> live;
+
+	double buildMs = 0.0;
+	double compileMs = 0.0;
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		buildMs += TimeBestMs(1, [&]()
+			{
+				graph.Clear();
+				live.clear();
+				RenderResourceId back = graph.Import("Back buffer");
+				for (unsigned int p = 0; p < 200; p++)
+				{
+					RenderPassId pass = graph.AddPass("Pass", 0);
+					for (int r = 0; r < 2 && !live.empty(); r++)
+						graph.Read(pass, live[random() % live.size()]);
+					live.push_back(graph.Write(pass, graph.CreateTransient("Target"), RenderGraphColorTarget));
+					if (live.size() > 8)
+						live.erase(live.begin());
+				}
+
+				RenderPassId present = graph.AddPass("Present", 0, true);
+				for (size_t i = 0; i < live.size(); i++)
+					graph.Read(present, live[i]);
+				graph.Read(present, graph.Write(present, back));
+			});
+		compileMs += TimeBestMs(1, [&]() { graph.Compile(); });
+	}
+
+	ReportBenchmark("Build 200 passes", buildMs * 1000.0 / frames, "us");
+	ReportBenchmark("Compile 200 passes", compileMs * 1000.0 / frames, "us");
+	ReportBenchmark("Passes executed", graph.GetStats().executedPassCount, "passes");
+	ReportBenchmark("Dependencies", graph.GetStats().dependencyCount, "edges");
+}
@@ -0,0 +1,150 @@
+#include "TestFramework.h"
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// Fills a queue with keys that vary in the low fields much
+// more than the high ones, like a real frame's draws
+static void FillQueue(unsigned int count, unsigned int seed, RenderQueue& queue, std::vector<DrawItem>& expected)
+{
+	std::mt19937_64 random(seed);
+	queue.Clear();
+	queue.Reserve(count);
+	expected.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		SortKey key = MakeSortKey(
+			(unsigned int)(random() % 2),
+			(unsigned int)(random() % 4),
+			0,
+			(unsigned int)(random() % 64),
+			(unsigned int)(random() % 300),
+			(random() % 1000) / 1000.0f);
+		queue.Add(key, i);
+
+		DrawItem item = { key, i };
+		expected.push_back(item);
+	}
+
+	std::stable_sort(expected.begin(), expected.end(),
+		[](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+}
+
+TEST(RenderQueueSortKeyFieldsRoundTrip)
+{
+	SortKey key = MakeSortKey(3, 700, 12, 4000, 17, 0.5f);
+	CHECK(GetSortKeyLayer(key) == 3);
+	CHECK(GetSortKeyShader(key) == 700);
+	CHECK(GetSortKeyLayout(key) == 12);
+	CHECK(GetSortKeyMaterial(key) == 4000);
+	CHECK(GetSortKeyMesh(key) == 17);
+	CHECK_NEAR(GetSortKeyDepth(key), 0.5 * ((1 << 20) - 1), 1.0);
+
+	// Too large for their fields, and depth outside 0 to 1
+	key = MakeSortKey(16 + 2, 1024 + 5, 64, 4096 + 1, 4096, 2.0f);
+	CHECK(GetSortKeyLayer(key) == 2);
+	CHECK(GetSortKeyShader(key) == 5);
+	CHECK(GetSortKeyLayout(key) == 0);
+	CHECK(GetSortKeyMaterial(key) == 1);
+	CHECK(GetSortKeyMesh(key) == 0);
+	CHECK(GetSortKeyDepth(key) == (1 << 20) - 1);
+	CHECK(GetSortKeyDepth(MakeSortKey(0, 0, 0, 0, 0, -1.0f)) == 0);
+}
+
+TEST(RenderQueueSortKeyFieldPriority)
+{
+	// A higher field wins whatever the lower ones are
+	CHECK(MakeSortKey(1, 0, 0, 0, 0, 0.0f) > MakeSortKey(0, 1023, 63, 4095, 4095, 1.0f));
+	CHECK(MakeSortKey(0, 1, 0, 0, 0, 0.0f) > MakeSortKey(0, 0, 63, 4095, 4095, 1.0f));
+	CHECK(MakeSortKey(0, 0, 0, 0, 1, 0.0f) > MakeSortKey(0, 0, 0, 0, 0, 1.0f));
+	CHECK(MakeSortKey(0, 0, 0, 0, 0, 0.25f) > MakeSortKey(0, 0, 0, 0, 0, 0.125f));
+}
+
+TEST(RenderQueueSortMatchesStableSort)
+{
+	const unsigned int counts[] = { 0, 1, 2, 100, 100000 };
+	for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+	{
+		RenderQueue queue;
+		std::vector<DrawItem> expected;
+		FillQueue(counts[c], c + 1, queue, expected);
+		queue.Sort();
+
+		CHECK(queue.GetCount() == counts[c]);
+		const std::vector<DrawItem>& items = queue.GetItems();
+		for (unsigned int i = 0; i < counts[c]; i++)
+			CHECK(items[i].key == expected[i].key && items[i].payload == expected[i].payload);
+	}
+}
+
+TEST(RenderQueueSkipsUniformDigits)
+{
+	// Only the mesh field varies, so only its two digits
+	// need a pass (the rest are the same for every key)
+	RenderQueue queue;
+	for (unsigned int i = 0; i < 1000; i++)
+		queue.Add(MakeSortKey(1, 2, 3, 4, (i * 37) % 4096, 0.0f), i);
+	queue.Sort();
+	CHECK(queue.GetLastSortPasses() <= 2);
+
+	const std::vector<DrawItem>& items = queue.GetItems();
+	for (unsigned int i = 1; i < items.size(); i++)
+		CHECK(items[i - 1].key <= items[i].key);
+
+	// Already equal keys need no passes at all
+	queue.Clear();
+	for (unsigned int i = 0; i < 100; i++)
+		queue.Add(MakeSortKey(1, 1, 1, 1, 1, 0.5f), i);
+	queue.Sort();
+	CHECK(queue.GetLastSortPasses() == 0);
+	CHECK(queue.GetItems()[99].payload == 99);
+}
+
+TEST(RenderQueueStateCacheSkipsRepeats)
+{
+	StateCache cache;
+	CHECK(cache.SetMesh(1));
+	CHECK(!cache.SetMesh(1));
+	CHECK(cache.SetMesh(2));
+	CHECK(cache.SetMaterial(1));
+	CHECK(cache.GetAppliedCount() == 3);
+	CHECK(cache.GetSkippedCount() == 1);
+
+	// Reset forgets what's bound, so everything applies again
+	cache.Reset();
+	CHECK(cache.SetMesh(2));
+	CHECK(cache.GetAppliedCount() == 1);
+	CHECK(cache.GetSkippedCount() == 0);
+}
+
+BENCHMARK(RenderQueueSortMillionDraws)
+{
+	const unsigned int count = 1000000;
+	RenderQueue queue;
+	std::vector<DrawItem> expected;
+
+	// The queue has to be refilled (unsorted) before each run
+	double sortMs = 0.0;
+	for (int run = 0; run < 5; run++)
+	{
+		FillQueue(count, 7, queue, expected);
+		double ms = TimeBestMs(1, [&]() { queue.Sort(); });
+		if (run == 0 || ms < sortMs)
+			sortMs = ms;
+	}
+
+	std::vector<DrawItem> items(expected);
+	std::shuffle(items.begin(), items.end(), std::mt19937(3));
+	double stdMs = TimeBestMs(1, [&]()
+		{
+			std::stable_sort(items.begin(), items.end(),
+				[](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+		});
+
+	ReportBenchmark("Radix sort 1M draws", sortMs, "ms");
+	ReportBenchmark("Radix sort passes", queue.GetLastSortPasses(), "passes");
+	ReportBenchmark("std::stable_sort 1M draws", stdMs, "ms");
+	ReportBenchmark("Speedup", stdMs / sortMs, "x");
+}
@@ -0,0 +1,156 @@
+#include "TestFramework.h"
+#include "ResourceRecycler.h"
+#include "Hash.h"
+
+#include <vector>
+
+// Stands in for a texture description
+struct TestDesc
+{
+	unsigned int width;
+	unsigned int height;
+	unsigned int format;
+};
+
+static TestDesc MakeDesc(unsigned int width, unsigned int height, unsigned int format)
+{
+	TestDesc desc = {};
+	desc.width = width;
+	desc.height = height;
+	desc.format = format;
+	return desc;
+}
+
+// What a pool does - reuses a match, or "creates" one
+static ResourceHandle Acquire(ResourceRecycler& recycler, const TestDesc& desc, bool* created = 0)
+{
+	unsigned long long key = Fnv1a64(&desc, sizeof(desc));
+	ResourceHandle handle = recycler.Reuse(key, &desc, sizeof(desc));
+	if (created)
+		*created = handle == InvalidResourceHandle;
+	if (handle == InvalidResourceHandle)
+		handle = recycler.Add(key, &desc, sizeof(desc), desc.width * desc.height * 4);
+	return handle;
+}
+
+TEST(ResourceRecyclerReusesMatchingDescriptions)
+{
+	ResourceRecycler recycler(10);
+	TestDesc depth = MakeDesc(800, 600, 45);
+	bool created = false;
+
+	ResourceHandle a = Acquire(recycler, depth, &created);
+	CHECK(a == 0 && created && recycler.IsInUse(a));
+
+	// Nothing is reused while it's in use
+	ResourceHandle b = Acquire(recycler, depth, &created);
+	CHECK(b != a && created);
+
+	// A released one is handed back for the same description...
+	CHECK(recycler.Release(a));
+	CHECK(!recycler.IsInUse(a));
+	CHECK(Acquire(recycler, depth, &created) == a && !created);
+
+	// ...but not for a different one, or one that only shares
+	// its key
+	CHECK(recycler.Release(a));
+	ResourceHandle c = Acquire(recycler, MakeDesc(1024, 768, 45), &created);
+	CHECK(c != a && c != b && created);
+	TestDesc other = MakeDesc(640, 480, 28);
+	unsigned long long depthKey = Fnv1a64(&depth, sizeof(depth));
+	CHECK(recycler.Reuse(depthKey, &other, sizeof(other)) == InvalidResourceHandle);
+	CHECK(recycler.Reuse(depthKey, &depth, sizeof(depth) - 1) == InvalidResourceHandle);
+	CHECK(recycler.Reuse(depthKey, &depth, sizeof(depth)) == a);
+
+	// Releasing twice, or something never handed out, does nothing
+	CHECK(recycler.Release(b));
+	CHECK(!recycler.Release(b));
+	CHECK(!recycler.Release(InvalidResourceHandle));
+	CHECK(!recycler.Release(100));
+
+	const ResourcePoolStats& stats = recycler.GetStats();
+	CHECK(stats.resourceCount == 3 && stats.inUseCount == 2);
+	CHECK(stats.createdCount == 3 && stats.reusedCount == 2 && stats.evictedCount == 0);
+	CHECK(stats.pooledBytes == (800 * 600 * 2 + 1024 * 768) * 4);
+}
+
+TEST(ResourceRecyclerEvictsAfterIdleFrames)
+{
+	const unsigned int maxIdleFrames = 3;
+	ResourceRecycler recycler(maxIdleFrames);
+	std::vector<ResourceHandle> evicted;
+
+	ResourceHandle idle = Acquire(recycler, MakeDesc(256, 256, 10));
+	ResourceHandle busy = Acquire(recycler, MakeDesc(512, 512, 10));
+	ResourceHandle reused = Acquire(recycler, MakeDesc(128, 128, 10));
+	recycler.Release(idle);
+	recycler.Release(reused);
+
+	// Kept for maxIdleFrames frames, and asking for one again
+	// starts its count over
+	for (unsigned int i = 0; i < maxIdleFrames; i++)
+	{
+		recycler.BeginFrame(evicted);
+		CHECK(evicted.empty());
+	}
+	CHECK(Acquire(recycler, MakeDesc(128, 128, 10)) == reused);
+	recycler.Release(reused);
+
+	recycler.BeginFrame(evicted);
+	CHECK(evicted.size() == 1 && evicted[0] == idle);
+	CHECK(recycler.GetFrameNumber() == maxIdleFrames + 1);
+
+	// Gone, so the same description makes a new one, which gets
+	// the evicted handle
+	bool created = false;
+	evicted.clear();
+	CHECK(Acquire(recycler, MakeDesc(256, 256, 10), &created) == idle && created);
+	CHECK(recycler.GetHandleCount() == 3);
+
+	// Resources in use are never evicted
+	for (unsigned int i = 0; i < maxIdleFrames * 4; i++)
+		recycler.BeginFrame(evicted);
+	CHECK(evicted.size() == 1 && evicted[0] == reused);
+	CHECK(recycler.IsInUse(busy) && recycler.IsInUse(idle));
+
+	const ResourcePoolStats& stats = recycler.GetStats();
+	CHECK(stats.resourceCount == 2 && stats.inUseCount == 2);
+	CHECK(stats.createdCount == 4 && stats.evictedCount == 2);
+	CHECK(stats.pooledBytes == (256 * 256 + 512 * 512) * 4);
+}
+
+TEST(ResourceRecyclerEvictUnusedFreesEverythingReleased)
+{
+	ResourceRecycler recycler(100);
+	std::vector<ResourceHandle> evicted;
+	CHECK(recycler.EvictUnused(evicted) == 0 && evicted.empty());
+
+	// A resize - the window-sized ones won't be asked for again
+	std::vector<ResourceHandle> handles;
+	for (unsigned int i = 0; i < 8; i++)
+		handles.push_back(Acquire(recycler, MakeDesc(800, 600, i)));
+	for (unsigned int i = 0; i < 8; i += 2)
+		recycler.Release(handles[i]);
+
+	CHECK(recycler.EvictUnused(evicted) == 4);
+	CHECK(evicted.size() == 4);
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		bool wasEvicted = false;
+		for (unsigned int e = 0; e < evicted.size(); e++)
+			wasEvicted = wasEvicted || evicted[e] == handles[i];
+		CHECK(wasEvicted == (i % 2 == 0));
+		CHECK(recycler.IsInUse(handles[i]) == (i % 2 == 1));
+	}
+
+	const ResourcePoolStats& stats = recycler.GetStats();
+	CHECK(stats.resourceCount == 4 && stats.inUseCount == 4 && stats.evictedCount == 4);
+	CHECK(stats.pooledBytes == 4 * 800 * 600 * 4);
+
+	// Nothing's left to reuse, and nothing's left to evict
+	bool created = false;
+	CHECK(Acquire(recycler, MakeDesc(800, 600, 0), &created) != InvalidResourceHandle && created);
+	evicted.clear();
+	CHECK(recycler.EvictUnused(evicted) == 0 && evicted.empty());
+	CHECK(recycler.GetHandleCount() == 8);
+}
@@ -0,0 +1,149 @@
+#include "TestFramework.h"
+#include "RingAllocator.h"
+
+#include <random>
+#include <vector>
+
+// A range handed out by the ring, and the frame it's from
+struct LiveRange
+{
+	size_t offset;
+	size_t size;
+	unsigned long long fence;
+};
+
+static bool Overlaps(size_t offset, size_t size, const std::vector<LiveRange>& live)
+{
+	for (size_t i = 0; i < live.size(); i++)
+		if (offset < live[i].offset + live[i].size && live[i].offset < offset + size)
+			return true;
+	return false;
+}
+
+static void DropRetired(std::vector<LiveRange>& live, unsigned long long completedFence)
+{
+	std::vector<LiveRange> kept;
+	for (size_t i = 0; i < live.size(); i++)
+		if (live[i].fence > completedFence)
+			kept.push_back(live[i]);
+	live.swap(kept);
+}
+
+TEST(RingAllocatorEmptyFrameKeepsTail)
+{
+	RingAllocator ring(1024);
+	CHECK(ring.Allocate(100, 16) == 0);
+	ring.EndFrame(1);
+	ring.EndFrame(2);	// Nothing allocated
+
+	// Frame 1 retiring empties the ring, so this starts over
+	// at the front - past where frame 2 (still queued) ended
+	ring.Retire(1);
+	size_t live = ring.Allocate(300, 16);
+	CHECK(live == 0);
+	ring.EndFrame(3);
+
+	// Retiring the empty frame mustn't free any of frame 3
+	ring.Retire(2);
+	CHECK(ring.GetUsedBytes() == 300);
+	for (;;)
+	{
+		size_t offset = ring.Allocate(64, 16);
+		if (offset == InvalidRingOffset)
+			break;
+		CHECK(offset >= live + 300 || offset + 64 <= live);
+	}
+}
+
+TEST(RingAllocatorWrapsAndAligns)
+{
+	RingAllocator ring(1000);
+	CHECK(ring.Allocate(600, 256) == 0);
+	ring.EndFrame(1);
+
+	// Doesn't fit before the end, and frame 1 is in the way
+	CHECK(ring.Allocate(500, 256) == InvalidRingOffset);
+	CHECK(ring.GetStats().failedCount == 1);
+
+	ring.Retire(1);
+	CHECK(ring.Allocate(100, 256) == 0);	// Empty again, so back to the front
+	CHECK(ring.Allocate(100, 256) == 256);
+	ring.EndFrame(2);
+	CHECK(ring.GetUsedBytes() == 356);
+
+	// 512 + 600 is past the end, so it wraps around to 0 -
+	// which is still frame 2's
+	CHECK(ring.Allocate(600, 256) == InvalidRingOffset);
+	CHECK(ring.RetireOldest());
+	CHECK(!ring.RetireOldest());
+	CHECK(ring.GetFramesInFlight() == 0);
+}
+
+TEST(RingAllocatorLiveRangesNeverOverlap)
+{
+	// The GPU lags a couple of frames behind, some frames
+	// allocate nothing, and running out waits on the oldest
+	std::mt19937 random(1);
+	RingAllocator ring(64 * 1024);
+	std::vector<LiveRange> live;
+	unsigned long long completed = 0;
+
+	for (unsigned long long frame = 1; frame < 20000; frame++)
+	{
+		if (frame > 3)
+		{
+			completed = frame - 3;
+			ring.Retire(completed);
+			DropRetired(live, completed);
+		}
+
+		unsigned int count = random() % 4 == 0 ? 0 : random() % 40;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			size_t size = 16 * (1 + random() % 40);
+			size_t alignment = random() % 2 ? 256 : 16;
+			size_t offset = ring.Allocate(size, alignment);
+			while (offset == InvalidRingOffset)
+			{
+				CHECK(ring.RetireOldest());
+				completed = ring.GetFramesInFlight() > 0 ? ring.GetOldestFence() - 1 : frame - 1;
+				DropRetired(live, completed);
+				offset = ring.Allocate(size, alignment);
+			}
+
+			CHECK(offset % alignment == 0);
+			CHECK(offset + size <= ring.GetCapacity());
+			CHECK(!Overlaps(offset, size, live));
+
+			LiveRange range = { offset, size, frame };
+			live.push_back(range);
+		}
+		ring.EndFrame(frame);
+	}
+}
+
+BENCHMARK(RingAllocatorAllocateThroughput)
+{
+	// 10k draws' constants a frame, three frames in flight
+	const unsigned int draws = 10000;
+	const unsigned int frames = 500;
+	RingAllocator ring(4 * 1024 * 1024);
+
+	volatile size_t sink = 0;
+	double ms = TimeBestMs(3, [&]()
+		{
+			ring.Reset(ring.GetCapacity());
+			for (unsigned int f = 1; f <= frames; f++)
+			{
+				if (f > 3)
+					ring.Retire(f - 3);
+				for (unsigned int d = 0; d < draws; d++)
+					sink = ring.Allocate(80, 256);
+				ring.EndFrame(f);
+			}
+		});
+
+	ReportBenchmark("Allocate (80 bytes, 256-byte aligned)", ms * 1e6 / ((double)draws * frames), "ns");
+	ReportBenchmark("Padding lost to alignment",
+		100.0 * ring.GetStats().paddingBytes / (ring.GetStats().allocatedBytes + ring.GetStats().paddingBytes), "%");
+}
@@ -0,0 +1,230 @@
+#include "TestFramework.h"
+#include "ShaderCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A DXBC container like the compiler writes - a header with
+// a checksum, then an input signature and a code chunk
+static std::vector<unsigned char> MakeBytecode(unsigned int checksum, const std::string& signature, const std::string& code)
+{
+	std::vector<unsigned char> bytes(40);
+	memcpy(bytes.data(), "DXBC", 4);
+	for (unsigned int i = 0; i < 4; i++)
+		memcpy(&bytes[4 + i * 4], &checksum, 4);
+
+	const std::string* chunks[2] = { &signature, &code };
+	const char* fourCCs[2] = { "ISGN", "SHEX" };
+	unsigned int chunkCount = 2;
+	unsigned int version = 1;
+	memcpy(&bytes[20], &version, 4);
+	memcpy(&bytes[28], &chunkCount, 4);
+	for (unsigned int c = 0; c < 2; c++)
+	{
+		unsigned int offset = (unsigned int)bytes.size();
+		unsigned int size = (unsigned int)chunks[c]->size();
+		memcpy(&bytes[32 + c * 4], &offset, 4);
+		bytes.insert(bytes.end(), fourCCs[c], fourCCs[c] + 4);
+		bytes.insert(bytes.end(), (const unsigned char*)&size, (const unsigned char*)&size + 4);
+		bytes.insert(bytes.end(), chunks[c]->begin(), chunks[c]->end());
+	}
+
+	unsigned int total = (unsigned int)bytes.size();
+	memcpy(&bytes[24], &total, 4);
+	return bytes;
+}
+
+static bool WriteFile(const std::string& path, const std::vector<unsigned char>& bytes)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	return (bool)file.write((const char*)bytes.data(), bytes.size());
+}
+
+// Removes a test's shader files however it ends
+struct ScratchShaders
+{
+	std::vector<std::string> paths;
+
+	std::string Write(const char* name, unsigned int permutation, const std::vector<unsigned char>& bytes)
+	{
+		std::string path = ShaderCache::GetFileName(GetTestFilePath(name), permutation);
+		WriteFile(path, bytes);
+		paths.push_back(path);
+		return path;
+	}
+
+	~ScratchShaders()
+	{
+		for (size_t i = 0; i < paths.size(); i++)
+			remove(paths[i].c_str());
+	}
+};
+
+TEST(ShaderCacheFileNames)
+{
+	CHECK(ShaderCache::GetFileName("VertexShader", 0) == "VertexShader.cso");
+	CHECK(ShaderCache::GetFileName("VertexShader", 5) == "VertexShader_5.cso");
+	CHECK(ShaderCache::GetFileName("VertexShader", 0x1a) == "VertexShader_1a.cso");
+}
+
+TEST(ShaderCacheLoadsAndSharesBytecode)
+{
+	ScratchShaders files;
+	std::vector<unsigned char> a = MakeBytecode(1, "position", "code a");
+	std::vector<unsigned char> b = MakeBytecode(2, "position", "code b, longer");
+	files.Write("ShaderA", 0, a);
+	files.Write("ShaderA", 3, a);
+	files.Write("ShaderB", 0, b);
+
+	ShaderCache cache;
+	ShaderId first = cache.Load(GetTestFilePath("ShaderA"));
+	ShaderId copy = cache.Load(GetTestFilePath("ShaderA"), 3);
+	ShaderId other = cache.Load(GetTestFilePath("ShaderB"));
+	CHECK(first != InvalidShaderId && copy != InvalidShaderId && other != InvalidShaderId);
+	CHECK(cache.Load(GetTestFilePath("ShaderMissing")) == InvalidShaderId);
+
+	// Loading again, or finding, gives the same shader
+	CHECK(cache.Load(GetTestFilePath("ShaderA")) == first);
+	CHECK(cache.Find(GetTestFilePath("ShaderA"), 3) == copy);
+	CHECK(cache.Find(GetTestFilePath("ShaderB"), 3) == InvalidShaderId);
+	CHECK(cache.GetShaderCount() == 3);
+	CHECK(cache.GetPermutation(copy) == 3);
+
+	CHECK(cache.GetBytecodeSize(first) == a.size());
+	CHECK(memcmp(cache.GetBytecode(first), a.data(), a.size()) == 0);
+	CHECK(memcmp(cache.GetBytecode(other), b.data(), b.size()) == 0);
+
+	// Identical files share bytecode, and signatures are hashed
+	// on their own
+	CHECK(cache.GetBytecodeIndex(first) == cache.GetBytecodeIndex(copy));
+	CHECK(cache.GetBytecodeIndex(first) != cache.GetBytecodeIndex(other));
+	CHECK(cache.GetBytecodeHash(first) != cache.GetBytecodeHash(other));
+	CHECK(cache.GetInputSignatureHash(first) == cache.GetInputSignatureHash(other));
+
+	const ShaderCacheStats& stats = cache.GetStats();
+	CHECK(stats.shaderCount == 3 && stats.bytecodeCount == 2 && stats.duplicateCount == 1);
+	CHECK(stats.mappedBytes + stats.readBytes == a.size() * 2 + b.size());
+}
+
+TEST(ShaderCacheComparesMatchingChecksums)
+{
+	// The same checksum and size, but different bytes, is
+	// still different bytecode
+	ScratchShaders files;
+	files.Write("ShaderSameChecksumA", 0, MakeBytecode(7, "position", "code 1"));
+	files.Write("ShaderSameChecksumB", 0, MakeBytecode(7, "position", "code 2"));
+
+	ShaderCache cache;
+	ShaderId a = cache.Load(GetTestFilePath("ShaderSameChecksumA"));
+	ShaderId b = cache.Load(GetTestFilePath("ShaderSameChecksumB"));
+	CHECK(a != InvalidShaderId && b != InvalidShaderId);
+	CHECK(cache.GetBytecodeHash(a) == cache.GetBytecodeHash(b));
+	CHECK(cache.GetBytecodeIndex(a) != cache.GetBytecodeIndex(b));
+	CHECK(cache.GetStats().duplicateCount == 0);
+}
+
+TEST(ShaderCacheReloadsChangedFiles)
+{
+	ScratchShaders files;
+	std::vector<unsigned char> original = MakeBytecode(1, "position", "original");
+	std::string pathA = files.Write("ShaderReloadA", 0, original);
+	std::string pathB = files.Write("ShaderReloadB", 0, MakeBytecode(2, "position normal", "other"));
+
+	ShaderCache cache;
+	ShaderId a = cache.Load(GetTestFilePath("ShaderReloadA"));
+	ShaderId b = cache.Load(GetTestFilePath("ShaderReloadB"));
+	CHECK(a != InvalidShaderId && b != InvalidShaderId);
+	unsigned int oldIndex = cache.GetBytecodeIndex(a);
+
+	// Watching (with checks far apart, so only the direct calls
+	// below find anything) stops files being mapped
+	cache.StartWatching(60000);
+	CHECK(cache.IsWatching());
+
+	// A file cut short isn't picked up until it's complete
+	std::vector<unsigned char> changed = MakeBytecode(3, "position", "changed, and longer");
+	CHECK(WriteFile(pathA, std::vector<unsigned char>(changed.begin(), changed.end() - 4)));
+	CHECK(cache.CheckForChanges() == 0);
+	CHECK(WriteFile(pathA, changed));
+	CHECK(cache.CheckForChanges() == 1);
+	CHECK(cache.CheckForChanges() == 0);
+
+	std::vector<ShaderId> reloaded;
+	CHECK(cache.ProcessReloads(reloaded) == 1);
+	CHECK(reloaded.size() == 1 && reloaded[0] == a);
+	CHECK(cache.GetBytecodeSize(a) == changed.size());
+	CHECK(memcmp(cache.GetBytecode(a), changed.data(), changed.size()) == 0);
+
+	// New bytecode gets a new index, and the old one is freed
+	CHECK(cache.GetBytecodeIndex(a) != oldIndex);
+	CHECK(!cache.IsBytecodeLoaded(oldIndex));
+	CHECK(cache.GetStats().reloadCount == 1);
+
+	// Written again with the same bytes isn't a change
+	std::vector<unsigned char> same(changed);
+	same.push_back(0);
+	CHECK(WriteFile(pathA, same));
+	CHECK(WriteFile(pathA, changed));
+	cache.CheckForChanges();
+	reloaded.clear();
+	CHECK(cache.ProcessReloads(reloaded) == 0 && reloaded.empty());
+
+	// The watcher thread finds changes by itself
+	cache.StartWatching(10);
+	std::vector<unsigned char> watched = MakeBytecode(4, "position normal", "watched");
+	CHECK(WriteFile(pathB, watched));
+	for (unsigned int wait = 0; wait < 200 && reloaded.empty(); wait++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		cache.ProcessReloads(reloaded);
+	}
+	cache.StopWatching();
+	CHECK(!cache.IsWatching());
+	CHECK(reloaded.size() == 1 && reloaded[0] == b);
+	CHECK(cache.GetBytecodeSize(b) == watched.size());
+}
+
+BENCHMARK(ShaderCacheLoad)
+{
+	// A few hundred permutations, half of them duplicates of
+	// another, each with a few kilobytes of code
+	const unsigned int count = 256;
+	ScratchShaders files;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int variant = i / 2;
+		files.Write("ShaderBench", i, MakeBytecode(variant + 1, "position normal uv", std::string(4096 + variant * 16, (char)variant)));
+	}
+
+	unsigned int bytecodeCount = 0;
+	double cacheMs = TimeBestMs(5, [&]()
+		{
+			ShaderCache cache;
+			for (unsigned int i = 0; i < count; i++)
+				cache.Load(GetTestFilePath("ShaderBench"), i);
+			bytecodeCount = cache.GetStats().bytecodeCount;
+		});
+
+	// Reading every file whole, as loading them one at a time did
+	double readMs = TimeBestMs(5, [&]()
+		{
+			std::vector<std::vector<char>> contents(count);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				std::ifstream file(files.paths[i], std::ios::binary | std::ios::ate);
+				contents[i].resize((size_t)file.tellg());
+				file.seekg(0);
+				file.read(contents[i].data(), contents[i].size());
+			}
+		});
+
+	ReportBenchmark("Shader files", count, "files");
+	ReportBenchmark("Distinct bytecode", bytecodeCount, "");
+	ReportBenchmark("Load through the cache", cacheMs, "ms");
+	ReportBenchmark("Read every file", readMs, "ms");
+}
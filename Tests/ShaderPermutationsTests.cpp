@@ -0,0 +1,135 @@
+#include "TestFramework.h"
+#include "ShaderPermutations.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> ReadLines(const std::string& path)
+{
+	std::ifstream file(path);
+	std::vector<std::string> lines;
+	std::string line;
+	while (std::getline(file, line))
+		lines.push_back(line);
+	return lines;
+}
+
+TEST(ShaderPermutationsResolveMasksKeys)
+{
+	// Only the features a set has survive in its keys
+	ShaderPermutationSet vertex("VertexShader", "vs_5_0", AllShaderFeatures);
+	ShaderPermutationSet colored("ColoredShader", "vs_5_0", ShaderFeatureVertexColor | ShaderFeatureInstanced);
+	ShaderPermutationSet pixel("PixelShader", "ps_5_0", 0);
+	ShaderPermutationSet unknown("UnknownShader", "vs_5_0", 0xF0 | ShaderFeatureInstanced);
+	CHECK(unknown.GetFeatures() == ShaderFeatureInstanced);
+	CHECK(pixel.GetName() == "PixelShader" && pixel.GetProfile() == "ps_5_0");
+
+	for (unsigned int key = 0; key < ShaderPermutationCount * 4; key++)
+	{
+		CHECK(vertex.Resolve(key) == (key & AllShaderFeatures));
+		CHECK(colored.Resolve(key) == (key & (ShaderFeatureVertexColor | ShaderFeatureInstanced)));
+		CHECK(pixel.Resolve(key) == 0);
+		CHECK(unknown.Resolve(key) == (key & ShaderFeatureInstanced));
+	}
+
+	CHECK((ShaderKey<ShaderFeatureInstanced | ShaderFeatureVertexColor>::value == 5));
+}
+
+TEST(ShaderPermutationsVariantsRoundTrip)
+{
+	ShaderPermutationSet set("VertexShader", "vs_5_0", ShaderFeatureInstanced | ShaderFeatureQuantizedPositions);
+	for (unsigned int key = 0; key < ShaderPermutationCount; key++)
+		CHECK(set.GetVariant(key) == InvalidShaderId);
+
+	set.SetVariant(ShaderFeatureInstanced, 10);
+	set.SetVariant(ShaderFeatureInstanced | ShaderFeatureQuantizedPositions, 11);
+	CHECK(set.GetVariant(ShaderFeatureInstanced) == 10);
+	CHECK(set.GetVariant(ShaderFeatureInstanced | ShaderFeatureQuantizedPositions) == 11);
+	CHECK(set.GetVariant(0) == InvalidShaderId);
+
+	// Asking with a feature the set doesn't have finds the
+	// variant without it, and setting with one replaces it
+	CHECK(set.GetVariant(ShaderFeatureInstanced | ShaderFeatureVertexColor) == 10);
+	set.SetVariant(ShaderFeatureInstanced | ShaderFeatureVertexColor, 12);
+	CHECK(set.GetVariant(ShaderFeatureInstanced) == 12);
+
+	// Every key of a set with no features shares one variant
+	ShaderPermutationSet pixel("PixelShader", "ps_5_0", 0);
+	pixel.SetVariant(AllShaderFeatures, 3);
+	for (unsigned int key = 0; key < ShaderPermutationCount; key++)
+		CHECK(pixel.GetVariant(key) == 3);
+}
+
+TEST(ShaderPermutationsUsedKeys)
+{
+	ShaderPermutationSet set("VertexShader", "vs_5_0", ShaderFeatureInstanced | ShaderFeatureVertexColor);
+	std::vector<unsigned int> keys;
+	CHECK(set.GetUsedKeys(keys) == 0 && keys.empty());
+
+	// Marked in any order, some more than once, and some only
+	// through features the set doesn't have
+	set.MarkUsed(ShaderFeatureVertexColor | ShaderFeatureInstanced);
+	set.MarkUsed(ShaderFeatureQuantizedPositions);
+	set.MarkUsed(ShaderFeatureInstanced);
+	set.MarkUsed(ShaderFeatureInstanced | ShaderFeatureQuantizedPositions);
+	set.MarkUsed(ShaderFeatureVertexColor | ShaderFeatureInstanced);
+	CHECK(set.IsUsed(0) && set.IsUsed(ShaderFeatureQuantizedPositions));
+	CHECK(!set.IsUsed(ShaderFeatureVertexColor));
+
+	// Appended, once each, lowest first
+	keys.push_back(99);
+	CHECK(set.GetUsedKeys(keys) == 3);
+	CHECK(keys.size() == 4 && keys[0] == 99);
+	CHECK(keys[1] == 0 && keys[2] == ShaderFeatureInstanced && keys[3] == (ShaderFeatureInstanced | ShaderFeatureVertexColor));
+}
+
+TEST(ShaderPermutationsExports)
+{
+	ShaderPermutationSet vertex("VertexShader", "vs_5_0", AllShaderFeatures);
+	ShaderPermutationSet pixel("PixelShader", "ps_5_0", 0);
+	vertex.MarkUsed(ShaderFeatureInstanced | ShaderFeatureQuantizedPositions);
+	vertex.MarkUsed(ShaderFeatureInstanced);
+	vertex.MarkUsed(ShaderFeatureInstanced);
+	vertex.SetVariant(ShaderFeatureInstanced, 4);
+	pixel.MarkUsed(ShaderFeatureInstanced);
+	pixel.MarkUsed(ShaderFeatureVertexColor);
+	const ShaderPermutationSet* sets[2] = { &vertex, &pixel };
+
+	// One fxc line per used key, each with every feature's define
+	std::string scriptPath = GetTestFilePath("ShaderPermutations.bat");
+	CHECK(ExportShaderPermutationBuildScript(scriptPath, sets, 2));
+	std::vector<std::string> script = ReadLines(scriptPath);
+	remove(scriptPath.c_str());
+
+	std::vector<std::string> fxc;
+	for (size_t i = 0; i < script.size(); i++)
+	{
+		if (script[i].find("fxc ") == 0)
+			fxc.push_back(script[i]);
+	}
+	CHECK(script.size() > 0 && script[0] == "@echo off");
+	CHECK(fxc.size() == 3);
+	CHECK(fxc[0] == "fxc /nologo /T vs_5_0 /E main /D INSTANCED=1 /D QUANTIZED_POSITIONS=0 /D VERTEX_COLOR=0 "
+		"/Fo \"%OUT%\\VertexShader_1.cso\" VertexShader.hlsl || exit /b 1");
+	CHECK(fxc[1] == "fxc /nologo /T vs_5_0 /E main /D INSTANCED=1 /D QUANTIZED_POSITIONS=1 /D VERTEX_COLOR=0 "
+		"/Fo \"%OUT%\\VertexShader_3.cso\" VertexShader.hlsl || exit /b 1");
+	CHECK(fxc[2] == "fxc /nologo /T ps_5_0 /E main /D INSTANCED=0 /D QUANTIZED_POSITIONS=0 /D VERTEX_COLOR=0 "
+		"/Fo \"%OUT%\\PixelShader.cso\" PixelShader.hlsl || exit /b 1");
+
+	std::string reportPath = GetTestFilePath("ShaderPermutations.txt");
+	CHECK(ExportShaderPermutationReport(reportPath, sets, 2));
+	std::vector<std::string> report = ReadLines(reportPath);
+	remove(reportPath.c_str());
+	CHECK(report.size() == 5);
+	CHECK(report[0] == "VertexShader (vs_5_0): 2 used");
+	CHECK(report[1] == "  VertexShader_1.cso  INSTANCED (loaded)");
+	CHECK(report[2] == "  VertexShader_3.cso  INSTANCED QUANTIZED_POSITIONS (missing)");
+	CHECK(report[3] == "PixelShader (ps_5_0): 1 used");
+	CHECK(report[4] == "  PixelShader.cso  (missing)");
+
+	// Nowhere to write to
+	CHECK(!ExportShaderPermutationBuildScript(GetTestFilePath("Missing/Shaders.bat"), sets, 2));
+	CHECK(!ExportShaderPermutationReport(GetTestFilePath("Missing/Shaders.txt"), sets, 2));
+}
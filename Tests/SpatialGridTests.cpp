@@ -0,0 +1,243 @@
+#include "TestFramework.h"
+#include "SpatialGrid.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace DirectX;
+
+// Points spread evenly through a cube centered on the origin,
+// about one per 8 cubic units
+static void MakePoints(unsigned int count, unsigned int seed, std::vector<XMFLOAT3>& points)
+{
+	float extent = cbrtf((float)count) * 2.0f;
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-extent, extent);
+	points.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+		points[i] = XMFLOAT3(position(random), position(random), position(random));
+}
+
+static void MovePoints(unsigned int seed, float distance, std::vector<XMFLOAT3>& points)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		points[i].x += unit(random) * distance;
+		points[i].y += unit(random) * distance;
+		points[i].z += unit(random) * distance;
+	}
+}
+
+static float DistanceSq(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	float dx = a.x - b.x;
+	float dy = a.y - b.y;
+	float dz = a.z - b.z;
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// Checks each kind of query against testing every point
+static bool QueriesMatchBruteForce(const SpatialGrid& grid, const std::vector<XMFLOAT3>& points, unsigned int seed)
+{
+	unsigned int count = (unsigned int)points.size();
+	float extent = cbrtf((float)count) * 2.0f;
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> position(-extent, extent);
+	std::vector<unsigned int> found;
+	std::vector<unsigned int> expected;
+
+	for (unsigned int q = 0; q < 50; q++)
+	{
+		XMFLOAT3 center(position(random), position(random), position(random));
+		float radius = 1.0f + q % 5;
+
+		found.clear();
+		expected.clear();
+		grid.QueryRadius(center, radius, found);
+		for (unsigned int i = 0; i < count; i++)
+			if (DistanceSq(points[i], center) <= radius * radius)
+				expected.push_back(i);
+		std::sort(found.begin(), found.end());
+		if (found != expected)
+			return false;
+
+		XMFLOAT3 boxMin(center.x - radius, center.y - radius * 2.0f, center.z - radius);
+		XMFLOAT3 boxMax(center.x + radius, center.y + radius, center.z + radius * 3.0f);
+		found.clear();
+		expected.clear();
+		grid.QueryBox(boxMin, boxMax, found);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const XMFLOAT3& p = points[i];
+			if (p.x >= boxMin.x && p.y >= boxMin.y && p.z >= boxMin.z &&
+				p.x <= boxMax.x && p.y <= boxMax.y && p.z <= boxMax.z)
+				expected.push_back(i);
+		}
+		std::sort(found.begin(), found.end());
+		if (found != expected)
+			return false;
+
+		// Nearest, from inside the points and from far outside
+		// them, where the search has to reach a long way
+		const XMFLOAT3 from[2] = { center, XMFLOAT3(center.x + extent * 5.0f, center.y, center.z) };
+		for (unsigned int f = 0; f < 2; f++)
+		{
+			const unsigned int k = 8;
+			std::vector<std::pair<float, unsigned int>> sorted(count);
+			for (unsigned int i = 0; i < count; i++)
+				sorted[i] = std::make_pair(DistanceSq(points[i], from[f]), i);
+			std::partial_sort(sorted.begin(), sorted.begin() + k, sorted.end());
+
+			unsigned int nearest[k];
+			if (grid.QueryNearest(from[f], k, nearest) != k)
+				return false;
+			for (unsigned int i = 0; i < k; i++)
+				if (nearest[i] != sorted[i].second)
+					return false;
+		}
+	}
+	return true;
+}
+
+TEST(SpatialGridQueriesMatchBruteForce)
+{
+	std::vector<XMFLOAT3> points;
+	MakePoints(20000, 1, points);
+
+	SpatialGrid serial(2.0f);
+	serial.Build(points.data(), (unsigned int)points.size());
+	CHECK(serial.GetCount() == points.size());
+	CHECK(serial.GetStats().rebuilt && serial.GetStats().overflowCount == 0);
+	CHECK(QueriesMatchBruteForce(serial, points, 2));
+
+	// Sorting across threads gives the same answers
+	JobSystem jobs(4);
+	SpatialGrid threaded(2.0f);
+	threaded.Build(points.data(), (unsigned int)points.size(), &jobs);
+	CHECK(QueriesMatchBruteForce(threaded, points, 2));
+
+	// A cell size far too small or too large for the points
+	// only changes how fast queries are
+	SpatialGrid fine(0.05f);
+	fine.Build(points.data(), (unsigned int)points.size());
+	CHECK(QueriesMatchBruteForce(fine, points, 3));
+	SpatialGrid coarse(500.0f);
+	coarse.Build(points.data(), (unsigned int)points.size());
+	CHECK(QueriesMatchBruteForce(coarse, points, 3));
+}
+
+TEST(SpatialGridUpdateMatchesBuild)
+{
+	std::vector<XMFLOAT3> points;
+	MakePoints(20000, 4, points);
+	JobSystem jobs(4);
+
+	SpatialGrid grid(2.0f);
+	grid.Build(points.data(), (unsigned int)points.size());
+
+	// Small moves stay incremental, with some points overflowing
+	// (well under the default 5% over these frames)
+	unsigned int overflowed = 0;
+	for (unsigned int frame = 0; frame < 5; frame++)
+	{
+		MovePoints(frame, 0.01f, points);
+		CHECK(!grid.Update(points.data(), frame & 1 ? &jobs : 0));
+		CHECK(!grid.GetStats().rebuilt);
+		overflowed = grid.GetStats().overflowCount;
+	}
+	CHECK(overflowed > 0);
+	CHECK(QueriesMatchBruteForce(grid, points, 5));
+
+	// Moving everything a long way falls back to a full build
+	MovePoints(10, 10.0f, points);
+	CHECK(grid.Update(points.data(), &jobs));
+	CHECK(grid.GetStats().rebuilt && grid.GetStats().overflowCount == 0);
+	CHECK(QueriesMatchBruteForce(grid, points, 6));
+
+	// Never letting anything overflow means always rebuilding
+	grid.SetMaxOverflow(0.0f);
+	MovePoints(11, 0.01f, points);
+	CHECK(grid.Update(points.data()));
+	CHECK(QueriesMatchBruteForce(grid, points, 7));
+}
+
+TEST(SpatialGridNearestEdgeCases)
+{
+	const XMFLOAT3 points[3] = { XMFLOAT3(0, 0, 0), XMFLOAT3(3, 0, 0), XMFLOAT3(-10, 0, 0) };
+	SpatialGrid grid(1.0f);
+	unsigned int nearest[4];
+
+	// Nothing to find
+	grid.Build(points, 0);
+	CHECK(grid.QueryNearest(XMFLOAT3(0, 0, 0), 4, nearest) == 0);
+
+	// Asking for more than there are gets them all, nearest first
+	grid.Build(points, 3);
+	CHECK(grid.QueryNearest(XMFLOAT3(2, 0, 0), 4, nearest) == 3);
+	CHECK(nearest[0] == 1 && nearest[1] == 0 && nearest[2] == 2);
+	CHECK(grid.QueryNearest(XMFLOAT3(2, 0, 0), 0, nearest) == 0);
+
+	// Only within maxDistance
+	CHECK(grid.QueryNearest(XMFLOAT3(2, 0, 0), 4, nearest, 2.5f) == 2);
+	CHECK(grid.QueryNearest(XMFLOAT3(20, 0, 0), 4, nearest, 5.0f) == 0);
+}
+
+BENCHMARK(SpatialGridMillionPoints)
+{
+	const unsigned int count = 1000000;
+	std::vector<XMFLOAT3> points;
+	MakePoints(count, 8, points);
+	JobSystem jobs;
+
+	SpatialGrid grid(2.0f);
+	double serialMs = TimeBestMs(5, [&]() { grid.Build(points.data(), count); });
+	double threadedMs = TimeBestMs(5, [&]() { grid.Build(points.data(), count, &jobs); });
+	ReportBenchmark("Build", serialMs, "ms");
+	ReportBenchmark("Build, job system", threadedMs, "ms");
+
+	// Frames of small moves, incrementally and from scratch
+	double updateMs = 0.0;
+	unsigned int rebuilds = 0;
+	for (unsigned int frame = 0; frame < 10; frame++)
+	{
+		MovePoints(frame, 0.01f, points);
+		rebuilds += grid.Update(points.data(), &jobs) ? 1 : 0;
+		updateMs += grid.GetStats().buildMs / 10.0;
+	}
+	SpatialGrid rebuilt(2.0f);
+	double fullMs = TimeBestMs(5, [&]() { rebuilt.Build(points.data(), count, &jobs); });
+	ReportBenchmark("Update after small moves", updateMs, "ms");
+	ReportBenchmark("Full builds among 10 updates", rebuilds, "");
+	ReportBenchmark("Build after small moves", fullMs, "ms");
+
+	const unsigned int queries = 10000;
+	float extent = cbrtf((float)count) * 2.0f;
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> position(-extent, extent);
+	std::vector<XMFLOAT3> centers(queries);
+	for (unsigned int q = 0; q < queries; q++)
+		centers[q] = XMFLOAT3(position(random), position(random), position(random));
+
+	std::vector<unsigned int> found;
+	double radiusMs = TimeBestMs(3, [&]()
+		{
+			for (unsigned int q = 0; q < queries; q++)
+			{
+				found.clear();
+				grid.QueryRadius(centers[q], 4.0f, found);
+			}
+		});
+	double nearestMs = TimeBestMs(3, [&]()
+		{
+			unsigned int nearest[8];
+			for (unsigned int q = 0; q < queries; q++)
+				grid.QueryNearest(centers[q], 8, nearest);
+		});
+	ReportBenchmark("Radius query, radius 4", radiusMs * 1000.0 / queries, "us");
+	ReportBenchmark("Nearest 8", nearestMs * 1000.0 / queries, "us");
+}
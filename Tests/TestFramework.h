@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <string>
+
+// --------------------------------------------------------
+// A small test and benchmark runner for the modules with no
+// Direct3D or Windows dependencies, so they can be checked
+// on any platform (including build machines with no GPU)
+//
+//   TEST(Name) { ... CHECK(condition); ... }
+//   BENCHMARK(Name) { ... ReportBenchmark(...); }
+//
+// Running Tests with no arguments runs every test.  --bench
+// runs the benchmarks as well, and any other argument only
+// runs tests and benchmarks whose names contain it.
+// --------------------------------------------------------
+typedef void (*TestFunction)();
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, TestFunction function, bool benchmark);
+};
+
+void ReportFailure(const char* file, int line, const char* condition);
+void ReportBenchmark(const char* what, double value, const char* unit);
+std::string GetTestFilePath(const char* name);
+std::string GetSourceFilePath(const char* name);
+
+#define TEST(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static TestRegistration name##Registration(#name, name, true); \
+	static void name()
+
+// Fails the current test (and returns from it) if the
+// condition doesn't hold
+#define CHECK(condition) \
+	do { if (!(condition)) { ReportFailure(__FILE__, __LINE__, #condition); return; } } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+	CHECK(std::fabs((double)(a) - (double)(b)) <= (double)(tolerance))
+
+// --------------------------------------------------------
+// Runs a function a number of times, returning the fastest
+// run in milliseconds
+// --------------------------------------------------------
+template<typename Function>
+double TimeBestMs(unsigned int runs, Function function)
+{
+	typedef std::chrono::steady_clock BenchmarkClock;
+
+	double best = 0.0;
+	for (unsigned int i = 0; i < runs; i++)
+	{
+		BenchmarkClock::time_point start = BenchmarkClock::now();
+		function();
+		double ms = std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count();
+		if (i == 0 || ms < best)
+			best = ms;
+	}
+
+	return best;
+}
@@ -0,0 +1,107 @@
+#include "TestFramework.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+struct RegisteredTest
+{
+	const char* name;
+	TestFunction function;
+	bool benchmark;
+};
+
+// Function-local, so it exists before any registration's
+// static constructor runs
+static std::vector<RegisteredTest>& GetRegisteredTests()
+{
+	static std::vector<RegisteredTest> tests;
+	return tests;
+}
+
+static bool currentFailed = false;
+
+TestRegistration::TestRegistration(const char* name, TestFunction function, bool benchmark)
+{
+	RegisteredTest test = { name, function, benchmark };
+	GetRegisteredTests().push_back(test);
+}
+
+// --------------------------------------------------------
+// Marks the running test as failed, and says where
+// --------------------------------------------------------
+void ReportFailure(const char* file, int line, const char* condition)
+{
+	printf("    %s(%d): CHECK(%s) failed\n", file, line, condition);
+	currentFailed = true;
+}
+
+// --------------------------------------------------------
+// Prints one of a benchmark's results
+// --------------------------------------------------------
+void ReportBenchmark(const char* what, double value, const char* unit)
+{
+	printf("    %-56s %12.3f %s\n", what, value, unit);
+}
+
+// --------------------------------------------------------
+// Where a test can write a scratch file (in the working
+// directory, which it should clean up after itself)
+// --------------------------------------------------------
+std::string GetTestFilePath(const char* name)
+{
+	return std::string("TestScratch_") + name;
+}
+
+// --------------------------------------------------------
+// Where one of the project's own files is (like a shader),
+// for tests that check them against the C++ side - found
+// from where this file was compiled, so it doesn't depend
+// on the working directory
+// --------------------------------------------------------
+std::string GetSourceFilePath(const char* name)
+{
+	std::string path = __FILE__;
+	size_t slash = path.find_last_of("\\/");
+	path = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	return path + "../" + name;
+}
+
+// --------------------------------------------------------
+// Runs the tests (and benchmarks, with --bench) and
+// returns how many failed
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	bool benchmarks = false;
+	const char* filter = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bench") == 0)
+			benchmarks = true;
+		else
+			filter = argv[i];
+	}
+
+	int run = 0;
+	int failed = 0;
+	const std::vector<RegisteredTest>& tests = GetRegisteredTests();
+	for (size_t i = 0; i < tests.size(); i++)
+	{
+		const RegisteredTest& test = tests[i];
+		if ((test.benchmark && !benchmarks) || (filter && !strstr(test.name, filter)))
+			continue;
+
+		printf("%s %s\n", test.benchmark ? "[ BENCH ]" : "[ TEST  ]", test.name);
+		fflush(stdout);
+
+		currentFailed = false;
+		test.function();
+		run++;
+		if (currentFailed)
+			failed++;
+	}
+
+	printf("\n%d run, %d failed\n", run, failed);
+	return failed > 0 ? 1 : 0;
+}
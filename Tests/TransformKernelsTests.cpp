@@ -0,0 +1,203 @@
+#include "TestFramework.h"
+#include "TransformKernels.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// Random positions, rotations and scales, plus the matrices
+// DirectXMath makes from them
+struct TransformInputs
+{
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT4> rotations;
+	std::vector<XMFLOAT3> scales;
+	std::vector<XMFLOAT4X4> expected;
+};
+
+static void MakeTransforms(unsigned int count, TransformInputs& inputs)
+{
+	std::mt19937 random(count);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	inputs.positions.resize(count);
+	inputs.rotations.resize(count);
+	inputs.scales.resize(count);
+	inputs.expected.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		inputs.positions[i] = XMFLOAT3(unit(random) * 100.0f, unit(random) * 100.0f, unit(random) * 100.0f);
+		inputs.scales[i] = XMFLOAT3(unit(random) + 2.0f, unit(random) + 2.0f, unit(random) + 2.0f);
+		XMStoreFloat4(&inputs.rotations[i], XMQuaternionNormalize(
+			XMVectorSet(unit(random), unit(random), unit(random), unit(random))));
+
+		XMStoreFloat4x4(&inputs.expected[i], XMMatrixAffineTransformation(
+			XMLoadFloat3(&inputs.scales[i]),
+			XMVectorZero(),
+			XMLoadFloat4(&inputs.rotations[i]),
+			XMLoadFloat3(&inputs.positions[i])));
+	}
+}
+
+static float LargestDifference(const XMFLOAT4X4* a, const XMFLOAT4X4* b, unsigned int count)
+{
+	float largest = 0.0f;
+	for (unsigned int i = 0; i < count; i++)
+		for (unsigned int r = 0; r < 4; r++)
+			for (unsigned int c = 0; c < 4; c++)
+				largest = std::max(largest, std::fabs(a[i].m[r][c] - b[i].m[r][c]));
+	return largest;
+}
+
+static XMFLOAT4X4 MakeViewProjection()
+{
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(
+		XMMatrixLookAtLH(XMVectorSet(0, 0, -5, 1), XMVectorZero(), XMVectorSet(0, 1, 0, 0)),
+		XMMatrixPerspectiveFovLH(1.0f, 1.5f, 0.1f, 100.0f)));
+	return viewProjection;
+}
+
+TEST(TransformKernelsLocalMatricesMatchOnEveryPath)
+{
+	// Counts that leave every possible remainder after the
+	// four and eight wide loops
+	const unsigned int counts[] = { 1, 3, 4, 7, 8, 13, 17, 1000 };
+	TransformKernelPath original = GetTransformKernelPath();
+
+	for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+	{
+		TransformInputs inputs;
+		MakeTransforms(counts[c], inputs);
+
+		for (int path = TransformKernelScalar; path <= TransformKernelAVX2; path++)
+		{
+			SetTransformKernelPath((TransformKernelPath)path);
+
+			// One extra, which shouldn't be written
+			std::vector<XMFLOAT4X4> results(counts[c] + 1);
+			results[counts[c]].m[0][0] = 12345.0f;
+			ComputeLocalMatrices(
+				inputs.positions.data(), inputs.rotations.data(), inputs.scales.data(),
+				results.data(), counts[c]);
+
+			// Positions are up to 100, so allow for their rounding
+			CHECK(LargestDifference(results.data(), inputs.expected.data(), counts[c]) <= 1e-4f);
+			CHECK(results[counts[c]].m[0][0] == 12345.0f);
+		}
+	}
+
+	SetTransformKernelPath(original);
+}
+
+TEST(TransformKernelsWorldViewProjectionMatchesOnEveryPath)
+{
+	const unsigned int counts[] = { 1, 5, 8, 11, 257 };
+	XMFLOAT4X4 viewProjection = MakeViewProjection();
+	TransformKernelPath original = GetTransformKernelPath();
+
+	for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+	{
+		TransformInputs inputs;
+		MakeTransforms(counts[c], inputs);
+
+		for (int transpose = 0; transpose < 2; transpose++)
+		{
+			std::vector<XMFLOAT4X4> expected(counts[c]);
+			for (unsigned int i = 0; i < counts[c]; i++)
+			{
+				XMMATRIX m = XMMatrixMultiply(XMLoadFloat4x4(&inputs.expected[i]), XMLoadFloat4x4(&viewProjection));
+				XMStoreFloat4x4(&expected[i], transpose ? XMMatrixTranspose(m) : m);
+			}
+
+			for (int path = TransformKernelScalar; path <= TransformKernelAVX2; path++)
+			{
+				SetTransformKernelPath((TransformKernelPath)path);
+
+				std::vector<XMFLOAT4X4> results(counts[c]);
+				ComputeWorldViewProjection(inputs.expected.data(), viewProjection, results.data(), counts[c], transpose != 0);
+				CHECK(LargestDifference(results.data(), expected.data(), counts[c]) <= 1e-3f);
+			}
+		}
+	}
+
+	SetTransformKernelPath(original);
+}
+
+TEST(TransformKernelsFallBackToSupportedPath)
+{
+	// Asking for more than the CPU has gets the best it does have
+	TransformKernelPath original = GetTransformKernelPath();
+	CHECK(SetTransformKernelPath(TransformKernelScalar) == TransformKernelScalar);
+	TransformKernelPath best = SetTransformKernelPath(TransformKernelAVX2);
+	CHECK(best <= TransformKernelAVX2);
+	CHECK(GetTransformKernelPath() == best);
+	SetTransformKernelPath(original);
+}
+
+BENCHMARK(TransformKernelsPerPath)
+{
+	const unsigned int count = 100000;
+	TransformInputs inputs;
+	MakeTransforms(count, inputs);
+	XMFLOAT4X4 viewProjection = MakeViewProjection();
+	std::vector<XMFLOAT4X4> locals(count);
+	std::vector<XMFLOAT4X4> results(count);
+
+	// The baseline - what each entity would otherwise do, one
+	// DirectXMath call after another
+	XMMATRIX vp = XMLoadFloat4x4(&viewProjection);
+	double naiveMs = TimeBestMs(10, [&]()
+		{
+			for (unsigned int i = 0; i < count; i++)
+			{
+				XMMATRIX world = XMMatrixAffineTransformation(
+					XMLoadFloat3(&inputs.scales[i]),
+					XMVectorZero(),
+					XMLoadFloat4(&inputs.rotations[i]),
+					XMLoadFloat3(&inputs.positions[i]));
+				XMStoreFloat4x4(&results[i], XMMatrixTranspose(XMMatrixMultiply(world, vp)));
+			}
+		});
+	ReportBenchmark("Naive XMMatrixAffineTransformation loop, per matrix", naiveMs * 1e6 / count, "ns");
+
+	static const char* const pathNames[] = { "scalar", "SSE2", "AVX2" };
+	TransformKernelPath original = GetTransformKernelPath();
+	double scalarMs = 0.0;
+
+	for (int path = TransformKernelScalar; path <= TransformKernelAVX2; path++)
+	{
+		// Skip paths this CPU doesn't have, rather than timing
+		// a fallback twice
+		if (SetTransformKernelPath((TransformKernelPath)path) != path)
+			continue;
+
+		double localMs = TimeBestMs(10, [&]()
+			{
+				ComputeLocalMatrices(
+					inputs.positions.data(), inputs.rotations.data(), inputs.scales.data(),
+					locals.data(), count);
+			});
+		double wvpMs = TimeBestMs(10, [&]()
+			{
+				ComputeWorldViewProjection(locals.data(), viewProjection, results.data(), count, true);
+			});
+		if (path == TransformKernelScalar)
+			scalarMs = localMs + wvpMs;
+
+		char what[96];
+		snprintf(what, sizeof(what), "Local matrices, %s, per matrix", pathNames[path]);
+		ReportBenchmark(what, localMs * 1e6 / count, "ns");
+		snprintf(what, sizeof(what), "World view projection, %s, per matrix", pathNames[path]);
+		ReportBenchmark(what, wvpMs * 1e6 / count, "ns");
+		snprintf(what, sizeof(what), "Speedup over naive loop, %s", pathNames[path]);
+		ReportBenchmark(what, naiveMs / (localMs + wvpMs), "x");
+		snprintf(what, sizeof(what), "Speedup over scalar, %s", pathNames[path]);
+		ReportBenchmark(what, scalarMs / (localMs + wvpMs), "x");
+	}
+
+	SetTransformKernelPath(original);
+}
@@ -0,0 +1,190 @@
+#include "TestFramework.h"
+#include "TransformSystem.h"
+
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+// A forest of entities - about one in fifty is a root, and the
+// rest hang off a recent entity, up to four levels deep
+static void MakeHierarchy(unsigned int count, unsigned int seed, TransformSystem& transforms)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<unsigned int> depths(count);
+	transforms.Clear();
+	transforms.Reserve(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int parent = TransformSystem::NoParent;
+		depths[i] = 0;
+		if (i > 0 && random() % 50 != 0)
+		{
+			parent = i - 1 - random() % (i < 20 ? i : 20);
+			while (depths[parent] == 3)
+				parent = transforms.GetParent(parent);
+			depths[i] = depths[parent] + 1;
+		}
+		unsigned int entity = transforms.Create(parent);
+
+		XMFLOAT4 rotation;
+		XMStoreFloat4(&rotation, XMQuaternionNormalize(XMVectorSet(unit(random), unit(random), unit(random), unit(random))));
+		transforms.SetPosition(entity, XMFLOAT3(unit(random) * 10.0f, unit(random) * 10.0f, unit(random) * 10.0f));
+		transforms.SetRotation(entity, rotation);
+		transforms.SetScale(entity, XMFLOAT3(unit(random) * 0.2f + 1.0f, unit(random) * 0.2f + 1.0f, unit(random) * 0.2f + 1.0f));
+	}
+}
+
+// Every world matrix against its local transform times its
+// parent's (already checked) world matrix
+static bool WorldMatricesMatch(const TransformSystem& transforms)
+{
+	for (unsigned int i = 0; i < transforms.GetCount(); i++)
+	{
+		XMMATRIX world = XMMatrixAffineTransformation(
+			XMLoadFloat3(&transforms.GetScale(i)),
+			XMVectorZero(),
+			XMLoadFloat4(&transforms.GetRotation(i)),
+			XMLoadFloat3(&transforms.GetPosition(i)));
+		unsigned int parent = transforms.GetParent(i);
+		if (parent != TransformSystem::NoParent)
+			world = XMMatrixMultiply(world, XMLoadFloat4x4(&transforms.GetWorldMatrix(parent)));
+
+		XMFLOAT4X4 expected;
+		XMStoreFloat4x4(&expected, world);
+		const XMFLOAT4X4& actual = transforms.GetWorldMatrix(i);
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+				if (std::fabs(actual.m[r][c] - expected.m[r][c]) > 1e-3f * (1.0f + std::fabs(expected.m[r][c])))
+					return false;
+	}
+	return true;
+}
+
+// How many entities are, or are below, one of the given ones
+static unsigned int CountSubtrees(const TransformSystem& transforms, const std::vector<unsigned int>& changed)
+{
+	std::vector<bool> dirty(transforms.GetCount(), false);
+	for (size_t i = 0; i < changed.size(); i++)
+		dirty[changed[i]] = true;
+
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < transforms.GetCount(); i++)
+	{
+		unsigned int parent = transforms.GetParent(i);
+		if (parent != TransformSystem::NoParent && dirty[parent])
+			dirty[i] = true;
+		count += dirty[i] ? 1 : 0;
+	}
+	return count;
+}
+
+TEST(TransformSystemParentsBeforeChildren)
+{
+	// A chain, where each link only ends up in the right place
+	// if its parent was finished first
+	TransformSystem chain;
+	unsigned int parent = TransformSystem::NoParent;
+	for (unsigned int i = 0; i < 10; i++)
+	{
+		parent = chain.Create(parent);
+		chain.SetPosition(parent, XMFLOAT3(1, 0, 0));
+		chain.SetScale(parent, XMFLOAT3(2, 2, 2));
+	}
+	CHECK(chain.UpdateWorldMatrices() == 10);
+	CHECK(chain.GetWorldMatrix(9).m[3][0] == 1023.0f);
+	CHECK(chain.GetWorldMatrix(9).m[0][0] == 1024.0f);
+
+	TransformSystem transforms;
+	MakeHierarchy(5000, 1, transforms);
+	CHECK(transforms.UpdateWorldMatrices() == 5000);
+	CHECK(WorldMatricesMatch(transforms));
+}
+
+TEST(TransformSystemRebuildsOnlyDirtySubtrees)
+{
+	TransformSystem transforms;
+	MakeHierarchy(5000, 2, transforms);
+	transforms.UpdateWorldMatrices();
+
+	// Nothing changed, nothing rebuilt
+	CHECK(transforms.UpdateWorldMatrices() == 0);
+
+	std::mt19937 random(3);
+	for (unsigned int frame = 0; frame < 20; frame++)
+	{
+		// A few entities, sometimes one inside another's subtree,
+		// and sometimes the same one twice
+		std::vector<unsigned int> changed;
+		for (unsigned int i = 0; i < 1 + frame % 5; i++)
+			changed.push_back(random() % 5000);
+		if (frame % 4 == 0)
+			changed.push_back(changed[0]);
+
+		for (size_t i = 0; i < changed.size(); i++)
+			transforms.SetPosition(changed[i], XMFLOAT3((float)frame, (float)i, 1.0f));
+
+		CHECK(transforms.UpdateWorldMatrices() == CountSubtrees(transforms, changed));
+		CHECK(WorldMatricesMatch(transforms));
+	}
+
+	// A new entity only builds itself
+	unsigned int child = transforms.Create(10);
+	CHECK(transforms.UpdateWorldMatrices() == 1);
+	CHECK(transforms.GetParent(child) == 10);
+	CHECK(WorldMatricesMatch(transforms));
+}
+
+TEST(TransformSystemRejectsMissingParents)
+{
+	TransformSystem transforms;
+	CHECK(transforms.Create(0) == InvalidTransform);
+	CHECK(transforms.GetCount() == 0);
+
+	unsigned int root = transforms.Create();
+	CHECK(root == 0 && transforms.GetParent(root) == TransformSystem::NoParent);
+	CHECK(transforms.Create(1) == InvalidTransform);
+	CHECK(transforms.Create(500) == InvalidTransform);
+	CHECK(transforms.GetCount() == 1);
+	CHECK(transforms.Create(root) == 1);
+}
+
+BENCHMARK(TransformSystemHierarchy)
+{
+	const unsigned int count = 131072;
+	TransformSystem transforms;
+	MakeHierarchy(count, 4, transforms);
+	transforms.UpdateWorldMatrices();
+	ReportBenchmark("Entities", count, "entities");
+
+	// Every entity moved
+	unsigned int updated = 0;
+	double fullMs = TimeBestMs(5, [&]()
+		{
+			for (unsigned int i = 0; i < count; i++)
+				transforms.SetPosition(i, transforms.GetPosition(i));
+			updated = transforms.UpdateWorldMatrices();
+		});
+	ReportBenchmark("Full update", fullMs, "ms");
+	ReportBenchmark("Rebuilt by a full update", updated, "entities");
+
+	// One percent of entities moved, spread through the scene,
+	// along with whatever hangs off them
+	std::mt19937 random(5);
+	std::vector<unsigned int> moved(count / 100);
+	for (size_t i = 0; i < moved.size(); i++)
+		moved[i] = random() % count;
+	double partialMs = TimeBestMs(5, [&]()
+		{
+			for (size_t i = 0; i < moved.size(); i++)
+				transforms.SetPosition(moved[i], transforms.GetPosition(moved[i]));
+			updated = transforms.UpdateWorldMatrices();
+		});
+	ReportBenchmark("Partial update, 1% moved", partialMs, "ms");
+	ReportBenchmark("Rebuilt by a partial update", updated, "entities");
+
+	// Nothing moved - just the check for dirty entities
+	double idleMs = TimeBestMs(5, [&]() { updated = transforms.UpdateWorldMatrices(); });
+	ReportBenchmark("Update with nothing moved", idleMs, "ms");
+}
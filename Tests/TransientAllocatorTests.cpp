@@ -0,0 +1,173 @@
+#include "TestFramework.h"
+#include "TransientAllocator.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// A 1080p post processing chain - keys stand in for hashed
+// texture descriptions, sizes are what each format needs
+static const unsigned long long KeyHdr = 1;		// 1920x1080 RGBA16F
+static const unsigned long long KeyHalf = 2;	// 960x540 RGBA16F
+static const unsigned long long KeyLuminance = 3;	// 480x270 R16F
+static const unsigned long long KeyLdr = 4;		// 1920x1080 RGBA8
+static const size_t BytesHdr = 1920 * 1080 * 8;
+static const size_t BytesHalf = 960 * 540 * 8;
+static const size_t BytesLuminance = 480 * 270 * 2;
+static const size_t BytesLdr = 1920 * 1080 * 4;
+
+static void DeclarePostChain(TransientAllocator& allocator)
+{
+	allocator.Declare(KeyHdr, BytesHdr, 0, 3);			// Scene
+	allocator.Declare(KeyHalf, BytesHalf, 1, 2);		// Bloom down
+	allocator.Declare(KeyHalf, BytesHalf, 2, 3);		// Bloom blur
+	allocator.Declare(KeyHalf, BytesHalf, 3, 4);		// Bloom up
+	allocator.Declare(KeyLuminance, BytesLuminance, 2, 3);
+	allocator.Declare(KeyLuminance, BytesLuminance, 3, 4);	// Adapted
+	allocator.Declare(KeyHdr, BytesHdr, 4, 5);			// Combined
+	allocator.Declare(KeyLdr, BytesLdr, 5, 6);			// Tone mapped
+	allocator.Declare(KeyLdr, BytesLdr, 6, 7);			// Anti-aliased
+	allocator.Declare(KeyLdr, BytesLdr, 7, 8);			// Sharpened
+}
+
+TEST(TransientAllocatorSharesPostChain)
+{
+	TransientAllocator allocator;
+	DeclarePostChain(allocator);
+	CHECK(allocator.Allocate() == 7);
+
+	// The two HDR targets never overlap, so they share
+	CHECK(allocator.GetSlot(0) == allocator.GetSlot(6));
+	CHECK(allocator.GetSlot(1) == allocator.GetSlot(3));
+	CHECK(allocator.GetSlot(7) == allocator.GetSlot(9));
+	CHECK(allocator.GetSlot(1) != allocator.GetSlot(2));
+
+	const TransientStats& stats = allocator.GetStats();
+	CHECK(stats.transientCount == 10 && stats.slotCount == 7);
+	CHECK(stats.requestedBytes == 2 * BytesHdr + 3 * BytesHalf + 2 * BytesLuminance + 3 * BytesLdr);
+	CHECK(stats.allocatedBytes == BytesHdr + 2 * BytesHalf + 2 * BytesLuminance + 2 * BytesLdr);
+
+	size_t slotBytes = 0;
+	for (unsigned int s = 0; s < allocator.GetSlotCount(); s++)
+		slotBytes += allocator.GetSlotBytes(s);
+	CHECK(slotBytes == stats.allocatedBytes);
+}
+
+TEST(TransientAllocatorRandomLifetimes)
+{
+	std::mt19937 random(3);
+	for (unsigned int trial = 0; trial < 200; trial++)
+	{
+		unsigned int count = 1 + random() % 200;
+		unsigned int uses = 1 + random() % 30;
+		std::vector<unsigned long long> keys(count);
+		std::vector<unsigned int> firsts(count), lasts(count);
+
+		TransientAllocator allocator;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			keys[i] = random() % 4;
+			firsts[i] = random() % uses;
+			lasts[i] = firsts[i] + random() % 5;
+			allocator.Declare(keys[i], 100 + keys[i], firsts[i], lasts[i]);
+		}
+		unsigned int slotCount = allocator.Allocate();
+
+		// Sharing needs the same key and lifetimes that don't overlap
+		for (unsigned int i = 0; i < count; i++)
+		{
+			CHECK(allocator.GetSlot(i) < slotCount);
+			CHECK(allocator.GetSlotKey(allocator.GetSlot(i)) == keys[i]);
+			for (unsigned int j = i + 1; j < count; j++)
+			{
+				if (allocator.GetSlot(i) == allocator.GetSlot(j))
+					CHECK(lasts[i] < firsts[j] || lasts[j] < firsts[i]);
+			}
+		}
+
+		// No fewer slots are possible than the most transients of
+		// a key alive at once, and that's what it needs
+		unsigned int fewest = 0;
+		for (unsigned long long key = 0; key < 4; key++)
+		{
+			unsigned int peak = 0;
+			for (unsigned int use = 0; use < uses + 5; use++)
+			{
+				unsigned int alive = 0;
+				for (unsigned int i = 0; i < count; i++)
+					alive += keys[i] == key && firsts[i] <= use && use <= lasts[i];
+				peak = std::max(peak, alive);
+			}
+			fewest += peak;
+		}
+		CHECK(slotCount == fewest);
+	}
+}
+
+TEST(TransientAllocatorLifetimes)
+{
+	TransientAllocator allocator;
+
+	// Uses given backwards are swapped
+	TransientId a = allocator.Declare(7, 64, 5, 2);
+	CHECK(allocator.GetFirstUse(a) == 2 && allocator.GetLastUse(a) == 5);
+
+	// Use() stretches a lifetime either way, which stops a
+	// later transient sharing with it
+	TransientId b = allocator.Declare(7, 64, 6, 8);
+	CHECK(allocator.Allocate() == 1);
+	allocator.Use(a, 7);
+	allocator.Use(b, 1);
+	CHECK(allocator.GetFirstUse(b) == 1 && allocator.GetLastUse(a) == 7);
+	CHECK(allocator.Allocate() == 2);
+
+	// Touching at one use is still overlapping
+	allocator.Clear();
+	CHECK(allocator.GetTransientCount() == 0);
+	allocator.Declare(7, 64, 0, 3);
+	allocator.Declare(7, 64, 3, 4);
+	CHECK(allocator.Allocate() == 2);
+
+	// A slot is as big as the biggest transient in it
+	allocator.Clear();
+	allocator.Declare(7, 64, 0, 1);
+	allocator.Declare(7, 256, 2, 3);
+	CHECK(allocator.Allocate() == 1);
+	CHECK(allocator.GetSlotBytes(0) == 256);
+}
+
+BENCHMARK(TransientAllocatorFrames)
+{
+	TransientAllocator allocator;
+	DeclarePostChain(allocator);
+	allocator.Allocate();
+	const TransientStats& stats = allocator.GetStats();
+	ReportBenchmark("Post chain transients", stats.transientCount, "textures");
+	ReportBenchmark("Post chain slots", stats.slotCount, "textures");
+	ReportBenchmark("Post chain memory, unshared", stats.requestedBytes / 1048576.0, "MB");
+	ReportBenchmark("Post chain memory, shared", stats.allocatedBytes / 1048576.0, "MB");
+	ReportBenchmark("Memory saved", 100.0 * (1.0 - (double)stats.allocatedBytes / stats.requestedBytes), "%");
+
+	// A busy frame's worth, declared and allocated every frame
+	const unsigned int frames = 1000;
+	std::mt19937 random(5);
+	std::vector<unsigned int> firsts(64 * frames), lengths(64 * frames), keys(64 * frames);
+	for (size_t i = 0; i < firsts.size(); i++)
+	{
+		firsts[i] = random() % 32;
+		lengths[i] = random() % 6;
+		keys[i] = random() % 6;
+	}
+
+	double ms = TimeBestMs(3, [&]()
+		{
+			for (unsigned int frame = 0; frame < frames; frame++)
+			{
+				allocator.Clear();
+				for (unsigned int i = frame * 64; i < frame * 64 + 64; i++)
+					allocator.Declare(keys[i], 1, firsts[i], firsts[i] + lengths[i]);
+				allocator.Allocate();
+			}
+		});
+	ReportBenchmark("Declare and allocate 64 transients", ms * 1000.0 / frames, "us");
+}
@@ -0,0 +1,262 @@
+#include "TestFramework.h"
+#include "ShaderPermutations.h"
+#include "VertexFormat.h"
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace DirectX;
+
+static std::vector<Vertex> MakeRandomVertices(unsigned int count, bool white)
+{
+	std::mt19937 random(14);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> channel(0.0f, 1.0f);
+
+	std::vector<Vertex> vertices(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Vertex& v = vertices[i];
+		v.Position = XMFLOAT3(unit(random) * 50.0f, unit(random) * 2.0f + 10.0f, unit(random) * 300.0f);
+		XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0.0f)));
+		v.UV = XMFLOAT2(channel(random), channel(random));
+		v.Color = white ? XMFLOAT4(1, 1, 1, 1) : XMFLOAT4(channel(random), channel(random), channel(random), 1.0f);
+	}
+	return vertices;
+}
+
+// --------------------------------------------------------
+// The vertex shader's inputs for one permutation - each
+// semantic and how many components it's declared with -
+// read straight from VertexShader.hlsl's VertexShaderInput
+// --------------------------------------------------------
+static bool ReadShaderInputs(unsigned int key, std::map<std::string, unsigned int>& inputs)
+{
+	std::ifstream file(GetSourceFilePath("VertexShader.hlsl").c_str());
+	if (!file)
+		return false;
+
+	std::vector<bool> active(1, true);		// One per #if, innermost last
+	bool inStruct = false;
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream words(line);
+		std::string first;
+		words >> first;
+
+		if (first == "#if")
+		{
+			// Only the permutation defines are used in #ifs
+			std::string define;
+			words >> define;
+			bool set = false;
+			bool known = false;
+			for (unsigned int i = 0; i < ShaderFeatureCount; i++)
+			{
+				if (define == GetShaderFeatureDefine((ShaderFeature)(1 << i)))
+				{
+					set = (key & (1 << i)) != 0;
+					known = true;
+				}
+			}
+			if (!known)
+				return false;
+			active.push_back(active.back() && set);
+		}
+		else if (first == "#else")
+		{
+			bool wasActive = active.back();
+			active.pop_back();
+			active.push_back(active.back() && !wasActive);
+		}
+		else if (first == "#endif")
+		{
+			active.pop_back();
+		}
+		else if (first == "struct")
+		{
+			std::string name;
+			words >> name;
+			inStruct = name == "VertexShaderInput";
+		}
+		else if (inStruct && first.compare(0, 2, "};") == 0)
+		{
+			return true;
+		}
+		else if (inStruct && active.back() && first.compare(0, 5, "float") == 0)
+		{
+			// float3 name : SEMANTIC;
+			std::string name, colon, semantic;
+			words >> name >> colon >> semantic;
+			semantic = semantic.substr(0, semantic.find(';'));
+			inputs[semantic] = first.size() > 5 ? first[5] - '0' : 1;
+		}
+	}
+
+	return false;
+}
+
+TEST(VertexFormatQuantizedSizes)
+{
+	const VertexFormat& full = GetVertexFormat(VertexFormatFull);
+	const VertexFormat& quantized = GetVertexFormat(VertexFormatQuantized);
+	const VertexFormat& color = GetVertexFormat(VertexFormatQuantizedColor);
+	const VertexFormat& uv = GetVertexFormat(VertexFormatQuantizedUV);
+	const VertexFormat& colorUV = GetVertexFormat(VertexFormatQuantizedColorUV);
+	CHECK(full.stride == sizeof(Vertex));
+	CHECK(quantized.stride == 8);
+	CHECK(color.stride == 12);
+	CHECK(uv.stride == 12);
+	CHECK(colorUV.stride == 16);
+
+	// The normal sits where the position's fourth channel is
+	// read from, so nothing is wasted
+	CHECK(quantized.offsets[VertexAttributeNormal] == 6);
+	CHECK(quantized.types[VertexAttributeUV] == VertexElementNone);
+	CHECK(quantized.types[VertexAttributeColor] == VertexElementNone);
+	CHECK(color.offsets[VertexAttributeColor] == 8);
+	CHECK(uv.types[VertexAttributeUV] == VertexElementHalf2 && uv.offsets[VertexAttributeUV] == 8);
+	CHECK(colorUV.offsets[VertexAttributeUV] == 8 && colorUV.offsets[VertexAttributeColor] == 12);
+
+	// Whatever comes last, the four channels read for a
+	// Unorm16x3 stay inside the vertex
+	VertexFormat alone = MakeVertexFormat(VertexElementUnorm16x3, VertexElementNone, VertexElementNone, VertexElementNone);
+	CHECK(alone.stride == 8);
+	VertexFormat after = MakeVertexFormat(VertexElementFloat2, VertexElementOctahedral8, VertexElementNone, VertexElementUnorm16x3);
+	CHECK(after.offsets[VertexAttributeColor] % 4 == 0);
+	CHECK(after.offsets[VertexAttributeColor] + 8 <= after.stride);
+}
+
+TEST(VertexFormatQuantizedRoundTrip)
+{
+	std::vector<Vertex> vertices = MakeRandomVertices(100000, false);
+	const VertexFormat& format = GetVertexFormat(VertexFormatQuantizedColor);
+	VertexQuantization quantization = ComputeVertexQuantization(format, vertices.data(), (unsigned int)vertices.size());
+	VertexEncodingError error = MeasureVertexEncodingError(format, quantization, vertices.data(), (unsigned int)vertices.size());
+
+	// Half a step of the largest axis, about a degree for 8-bit
+	// octahedral normals, and half an 8-bit step for colors
+	CHECK(error.position <= 0.5f * quantization.positionScale.z / 65535.0f * 1.01f);
+	CHECK(error.normalDegrees <= 1.0f);
+	CHECK(error.color <= 0.5f / 255.0f + 1e-6f);
+}
+
+TEST(VertexFormatQuantizedHalfUVs)
+{
+	std::vector<Vertex> vertices = MakeRandomVertices(100000, false);
+	const VertexFormat& format = GetVertexFormat(VertexFormatQuantizedColorUV);
+	VertexQuantization quantization = ComputeVertexQuantization(format, vertices.data(), (unsigned int)vertices.size());
+	VertexEncodingError error = MeasureVertexEncodingError(format, quantization, vertices.data(), (unsigned int)vertices.size());
+
+	// UVs are between 0 and 1, where half floats round to
+	// within 2^-12 (half of a step of 2^-11)
+	CHECK(error.uv > 0.0f);
+	CHECK(error.uv <= 1.0f / 4096.0f);
+	CHECK(error.normalDegrees <= 1.0f);
+	CHECK(error.color <= 0.5f / 255.0f + 1e-6f);
+
+	// Tiled UVs keep the same relative precision
+	for (unsigned int i = 0; i < vertices.size(); i++)
+	{
+		vertices[i].UV.x = vertices[i].UV.x * 16.0f - 8.0f;
+		vertices[i].UV.y *= 16.0f;
+	}
+	error = MeasureVertexEncodingError(format, quantization, vertices.data(), (unsigned int)vertices.size());
+	CHECK(error.uv <= 16.0f / 4096.0f);
+}
+
+TEST(VertexFormatColorsAndUVsOnlyWhenNeeded)
+{
+	// White, with no UVs, like an OBJ without vt or colors
+	std::vector<Vertex> plain = MakeRandomVertices(1000, true);
+	for (unsigned int i = 0; i < plain.size(); i++)
+		plain[i].UV = XMFLOAT2(0, 0);
+	CHECK(ChooseQuantizedVertexFormat(plain.data(), (unsigned int)plain.size()) == VertexFormatQuantized);
+
+	std::vector<Vertex> colored = plain;
+	colored[500].Color.w = 0.5f;
+	CHECK(ChooseQuantizedVertexFormat(colored.data(), (unsigned int)colored.size()) == VertexFormatQuantizedColor);
+
+	// A single non-zero UV is enough to keep them
+	std::vector<Vertex> textured = plain;
+	textured[999].UV.y = 0.25f;
+	CHECK(ChooseQuantizedVertexFormat(textured.data(), (unsigned int)textured.size()) == VertexFormatQuantizedUV);
+	textured[0].Color.x = 0.0f;
+	CHECK(ChooseQuantizedVertexFormat(textured.data(), (unsigned int)textured.size()) == VertexFormatQuantizedColorUV);
+
+	// Decoding without colors gives back white, and without
+	// UVs gives back zero
+	const VertexFormat& format = GetVertexFormat(VertexFormatQuantized);
+	VertexQuantization quantization = ComputeVertexQuantization(format, plain.data(), (unsigned int)plain.size());
+	VertexEncodingError error = MeasureVertexEncodingError(format, quantization, plain.data(), (unsigned int)plain.size());
+	CHECK(error.color == 0.0f && error.uv == 0.0f);
+}
+
+TEST(VertexFormatMatchesVertexShaderInputs)
+{
+	// Every format's shader permutation has to declare exactly
+	// the elements the format stores, with the components the
+	// input assembler hands over for each
+	for (unsigned int id = 0; id < VertexFormatCount; id++)
+	{
+		const VertexFormat& format = GetVertexFormat((VertexFormatId)id);
+		unsigned int key = ShaderFeatureInstanced | GetVertexFormatShaderFeatures(format);
+
+		std::map<std::string, unsigned int> inputs;
+		CHECK(ReadShaderInputs(key, inputs));
+
+		for (unsigned int a = 0; a < VertexAttributeCount; a++)
+		{
+			const char* semantic = GetVertexAttributeSemantic((VertexAttribute)a);
+			std::map<std::string, unsigned int>::const_iterator input = inputs.find(semantic);
+			if (format.types[a] == VertexElementNone)
+			{
+				// The shader can't ask for what isn't there
+				CHECK(input == inputs.end());
+			}
+			else if (input != inputs.end())
+			{
+				// Extra elements in the layout are fine, but what
+				// the shader reads has to be what's stored
+				CHECK(input->second == GetVertexElementShaderComponents(format.types[a]));
+			}
+		}
+
+		// Positions need decoding if, and only if, they're quantized
+		bool relative = format.types[VertexAttributePosition] == VertexElementUnorm16x3;
+		CHECK(relative == ((key & ShaderFeatureQuantizedPositions) != 0));
+		CHECK(inputs.count("POSITION") == 1);
+		CHECK(inputs.count("NORMAL") == 1);
+	}
+}
+
+BENCHMARK(VertexFormatEncodeThroughput)
+{
+	std::vector<Vertex> vertices = MakeRandomVertices(1000000, false);
+	unsigned int count = (unsigned int)vertices.size();
+
+	for (unsigned int id = VertexFormatQuantized; id < VertexFormatCount; id++)
+	{
+		const VertexFormat& format = GetVertexFormat((VertexFormatId)id);
+		VertexQuantization quantization = ComputeVertexQuantization(format, vertices.data(), count);
+		std::vector<unsigned char> encoded((size_t)format.stride * count);
+		double ms = TimeBestMs(3, [&]()
+			{
+				EncodeVertices(format, quantization, vertices.data(), count, encoded.data());
+			});
+
+		static const char* const names[] = { "Full", "Quantized", "QuantizedColor", "QuantizedUV", "QuantizedColorUV" };
+		const char* name = names[id];
+		ReportBenchmark((std::string("Encode 1M vertices, ") + name).c_str(), ms, "ms");
+		ReportBenchmark((std::string("Size vs 48-byte full format, ") + name).c_str(),
+			(double)sizeof(Vertex) / format.stride, "x smaller");
+		ReportBenchmark((std::string("Size vs 28-byte position + color vertex, ") + name).c_str(),
+			28.0 / format.stride, "x smaller");
+	}
+}
@@ -0,0 +1,432 @@
+#include "TransformKernels.h"
+#include "CpuFeatures.h"
+
+#if CPU_X86
+#include <immintrin.h>
+#endif
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// The fastest path this CPU can run
+// --------------------------------------------------------
+static TransformKernelPath GetBestTransformKernelPath()
+{
+#if CPU_X86
+	const CpuFeatures& cpu = GetCpuFeatures();
+	if (cpu.avx2 && cpu.fma)
+		return TransformKernelAVX2;
+
+	// SSE2 is part of every x64 CPU (and on by default for Win32 builds)
+	return TransformKernelSSE2;
+#else
+	return TransformKernelScalar;
+#endif
+}
+
+static TransformKernelPath activePath = GetBestTransformKernelPath();
+
+// --------------------------------------------------------
+// Which path ComputeLocalMatrices() and friends are using
+// --------------------------------------------------------
+TransformKernelPath GetTransformKernelPath()
+{
+	return activePath;
+}
+
+// --------------------------------------------------------
+// Forces a particular path, as long as this CPU supports
+// it, and returns the path actually being used afterwards
+// --------------------------------------------------------
+TransformKernelPath SetTransformKernelPath(TransformKernelPath path)
+{
+	TransformKernelPath best = GetBestTransformKernelPath();
+	activePath = path > best ? best : path;
+	return activePath;
+}
+
+
+// ----------------------------------------------------------------
+// Scalar reference path - one entity at a time, plain float math
+// ----------------------------------------------------------------
+static void ComputeLocalMatricesScalar(
+	const XMFLOAT3* positions,
+	const XMFLOAT4* rotations,
+	const XMFLOAT3* scales,
+	XMFLOAT4X4* outMatrices,
+	unsigned int first,
+	unsigned int count)
+{
+	for (unsigned int i = first; i < count; i++)
+	{
+		const XMFLOAT4& q = rotations[i];
+		const XMFLOAT3& s = scales[i];
+		const XMFLOAT3& p = positions[i];
+
+		float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		float xw = q.x * q.w, yw = q.y * q.w, zw = q.z * q.w;
+
+		// Each row of the rotation matrix, scaled by the matching axis
+		XMFLOAT4X4& m = outMatrices[i];
+		m._11 = s.x * (1.0f - 2.0f * (yy + zz));
+		m._12 = s.x * (2.0f * (xy + zw));
+		m._13 = s.x * (2.0f * (xz - yw));
+		m._14 = 0.0f;
+
+		m._21 = s.y * (2.0f * (xy - zw));
+		m._22 = s.y * (1.0f - 2.0f * (xx + zz));
+		m._23 = s.y * (2.0f * (yz + xw));
+		m._24 = 0.0f;
+
+		m._31 = s.z * (2.0f * (xz + yw));
+		m._32 = s.z * (2.0f * (yz - xw));
+		m._33 = s.z * (1.0f - 2.0f * (xx + yy));
+		m._34 = 0.0f;
+
+		m._41 = p.x;
+		m._42 = p.y;
+		m._43 = p.z;
+		m._44 = 1.0f;
+	}
+}
+
+static void ComputeWorldViewProjectionScalar(
+	const XMFLOAT4X4* worldMatrices,
+	const XMFLOAT4X4& viewProjection,
+	XMFLOAT4X4* outMatrices,
+	unsigned int first,
+	unsigned int count,
+	bool transpose)
+{
+	for (unsigned int i = first; i < count; i++)
+	{
+		const XMFLOAT4X4& w = worldMatrices[i];
+		XMFLOAT4X4 result;
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				result.m[r][c] =
+					w.m[r][0] * viewProjection.m[0][c] +
+					w.m[r][1] * viewProjection.m[1][c] +
+					w.m[r][2] * viewProjection.m[2][c] +
+					w.m[r][3] * viewProjection.m[3][c];
+			}
+		}
+
+		for (int r = 0; r < 4; r++)
+			for (int c = 0; c < 4; c++)
+				outMatrices[i].m[r][c] = transpose ? result.m[c][r] : result.m[r][c];
+	}
+}
+
+
+#if CPU_X86
+// ----------------------------------------------------------------
+// SSE2 path - four entities at a time.  Each register holds the
+// same value (say, rotation.x) for four different entities, so the
+// math reads exactly like the scalar version.
+// ----------------------------------------------------------------
+
+// Splits four packed XMFLOAT3s (12 floats) into x, y and z registers
+static inline void LoadFloat3SoA(const XMFLOAT3* v, __m128& x, __m128& y, __m128& z)
+{
+	const float* f = &v->x;
+	__m128 a = _mm_loadu_ps(f);		// x0 y0 z0 x1
+	__m128 b = _mm_loadu_ps(f + 4);	// y1 z1 x2 y2
+	__m128 c = _mm_loadu_ps(f + 8);	// z2 x3 y3 z3
+
+	__m128 t1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2));	// x2 x2 x3 x3
+	x = _mm_shuffle_ps(a, t1, _MM_SHUFFLE(2, 0, 3, 0));			// x0 x1 x2 x3
+
+	__m128 t2 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));	// y0 y0 y1 y1
+	__m128 t3 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));	// y2 y2 y3 y3
+	y = _mm_shuffle_ps(t2, t3, _MM_SHUFFLE(2, 0, 2, 0));		// y0 y1 y2 y3
+
+	__m128 t4 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));	// z0 z0 z1 z1
+	__m128 t5 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));	// z2 z2 z3 z3
+	z = _mm_shuffle_ps(t4, t5, _MM_SHUFFLE(2, 0, 2, 0));		// z0 z1 z2 z3
+}
+
+// Splits four XMFLOAT4s into x, y, z and w registers
+static inline void LoadFloat4SoA(const XMFLOAT4* v, __m128& x, __m128& y, __m128& z, __m128& w)
+{
+	x = _mm_loadu_ps(&v[0].x);
+	y = _mm_loadu_ps(&v[1].x);
+	z = _mm_loadu_ps(&v[2].x);
+	w = _mm_loadu_ps(&v[3].x);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+}
+
+// Turns one row (for four entities) back into four separate rows
+static inline void StoreRowAoS(XMFLOAT4X4* out, int row, __m128 c0, __m128 c1, __m128 c2, __m128 c3)
+{
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	_mm_storeu_ps(out[0].m[row], c0);
+	_mm_storeu_ps(out[1].m[row], c1);
+	_mm_storeu_ps(out[2].m[row], c2);
+	_mm_storeu_ps(out[3].m[row], c3);
+}
+
+static void ComputeLocalMatricesSSE2(
+	const XMFLOAT3* positions,
+	const XMFLOAT4* rotations,
+	const XMFLOAT3* scales,
+	XMFLOAT4X4* outMatrices,
+	unsigned int first,
+	unsigned int count)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	unsigned int i = first;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 px, py, pz, sx, sy, sz, qx, qy, qz, qw;
+		LoadFloat3SoA(&positions[i], px, py, pz);
+		LoadFloat3SoA(&scales[i], sx, sy, sz);
+		LoadFloat4SoA(&rotations[i], qx, qy, qz, qw);
+
+		__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+		__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+		__m128 xw = _mm_mul_ps(qx, qw), yw = _mm_mul_ps(qy, qw), zw = _mm_mul_ps(qz, qw);
+
+		__m128 m00 = _mm_mul_ps(sx, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))));
+		__m128 m01 = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_add_ps(xy, zw)));
+		__m128 m02 = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_sub_ps(xz, yw)));
+
+		__m128 m10 = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_sub_ps(xy, zw)));
+		__m128 m11 = _mm_mul_ps(sy, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))));
+		__m128 m12 = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_add_ps(yz, xw)));
+
+		__m128 m20 = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_add_ps(xz, yw)));
+		__m128 m21 = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_sub_ps(yz, xw)));
+		__m128 m22 = _mm_mul_ps(sz, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))));
+
+		StoreRowAoS(&outMatrices[i], 0, m00, m01, m02, zero);
+		StoreRowAoS(&outMatrices[i], 1, m10, m11, m12, zero);
+		StoreRowAoS(&outMatrices[i], 2, m20, m21, m22, zero);
+		StoreRowAoS(&outMatrices[i], 3, px, py, pz, one);
+	}
+
+	// Leftovers that don't fill a whole register
+	ComputeLocalMatricesScalar(positions, rotations, scales, outMatrices, i, count);
+}
+
+static void ComputeWorldViewProjectionSSE2(
+	const XMFLOAT4X4* worldMatrices,
+	const XMFLOAT4X4& viewProjection,
+	XMFLOAT4X4* outMatrices,
+	unsigned int first,
+	unsigned int count,
+	bool transpose)
+{
+	__m128 vp0 = _mm_loadu_ps(viewProjection.m[0]);
+	__m128 vp1 = _mm_loadu_ps(viewProjection.m[1]);
+	__m128 vp2 = _mm_loadu_ps(viewProjection.m[2]);
+	__m128 vp3 = _mm_loadu_ps(viewProjection.m[3]);
+
+	for (unsigned int i = first; i < count; i++)
+	{
+		// Each output row is a blend of the four viewProjection
+		// rows, weighted by the matching world row's elements
+		__m128 rows[4];
+		for (int r = 0; r < 4; r++)
+		{
+			__m128 w = _mm_loadu_ps(worldMatrices[i].m[r]);
+			__m128 result = _mm_mul_ps(_mm_shuffle_ps(w, w, 0x00), vp0);
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(w, w, 0x55), vp1));
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(w, w, 0xAA), vp2));
+			result = _mm_add_ps(result, _mm_mul_ps(_mm_shuffle_ps(w, w, 0xFF), vp3));
+			rows[r] = result;
+		}
+
+		if (transpose)
+			_MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+
+		for (int r = 0; r < 4; r++)
+			_mm_storeu_ps(outMatrices[i].m[r], rows[r]);
+	}
+}
+
+
+// ----------------------------------------------------------------
+// AVX2 path - eight entities at a time, using fused multiply-add.
+// Loading and storing reuse the SSE helpers on each half.
+// ----------------------------------------------------------------
+TARGET_AVX2 static inline __m256 Combine(__m128 lo, __m128 hi)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+TARGET_AVX2 static inline void StoreRowAoS8(XMFLOAT4X4* out, int row, __m256 c0, __m256 c1, __m256 c2, __m256 c3)
+{
+	StoreRowAoS(out, row,
+		_mm256_castps256_ps128(c0), _mm256_castps256_ps128(c1),
+		_mm256_castps256_ps128(c2), _mm256_castps256_ps128(c3));
+	StoreRowAoS(out + 4, row,
+		_mm256_extractf128_ps(c0, 1), _mm256_extractf128_ps(c1, 1),
+		_mm256_extractf128_ps(c2, 1), _mm256_extractf128_ps(c3, 1));
+}
+
+TARGET_AVX2 static void ComputeLocalMatricesAVX2(
+	const XMFLOAT3* positions,
+	const XMFLOAT4* rotations,
+	const XMFLOAT3* scales,
+	XMFLOAT4X4* outMatrices,
+	unsigned int first,
+	unsigned int count)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	unsigned int i = first;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128 l[10], h[10];
+		LoadFloat3SoA(&positions[i], l[0], l[1], l[2]);
+		LoadFloat3SoA(&positions[i + 4], h[0], h[1], h[2]);
+		LoadFloat3SoA(&scales[i], l[3], l[4], l[5]);
+		LoadFloat3SoA(&scales[i + 4], h[3], h[4], h[5]);
+		LoadFloat4SoA(&rotations[i], l[6], l[7], l[8], l[9]);
+		LoadFloat4SoA(&rotations[i + 4], h[6], h[7], h[8], h[9]);
+
+		__m256 px = Combine(l[0], h[0]), py = Combine(l[1], h[1]), pz = Combine(l[2], h[2]);
+		__m256 sx = Combine(l[3], h[3]), sy = Combine(l[4], h[4]), sz = Combine(l[5], h[5]);
+		__m256 qx = Combine(l[6], h[6]), qy = Combine(l[7], h[7]), qz = Combine(l[8], h[8]), qw = Combine(l[9], h[9]);
+
+		__m256 xx = _mm256_mul_ps(qx, qx), yy = _mm256_mul_ps(qy, qy), zz = _mm256_mul_ps(qz, qz);
+		__m256 xy = _mm256_mul_ps(qx, qy), xz = _mm256_mul_ps(qx, qz), yz = _mm256_mul_ps(qy, qz);
+		__m256 xw = _mm256_mul_ps(qx, qw), yw = _mm256_mul_ps(qy, qw), zw = _mm256_mul_ps(qz, qw);
+
+		// 1 - 2(a + b) as a single negated multiply-add
+		__m256 m00 = _mm256_mul_ps(sx, _mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one));
+		__m256 m01 = _mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_add_ps(xy, zw)));
+		__m256 m02 = _mm256_mul_ps(sx, _mm256_mul_ps(two, _mm256_sub_ps(xz, yw)));
+
+		__m256 m10 = _mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_sub_ps(xy, zw)));
+		__m256 m11 = _mm256_mul_ps(sy, _mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one));
+		__m256 m12 = _mm256_mul_ps(sy, _mm256_mul_ps(two, _mm256_add_ps(yz, xw)));
+
+		__m256 m20 = _mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_add_ps(xz, yw)));
+		__m256 m21 = _mm256_mul_ps(sz, _mm256_mul_ps(two, _mm256_sub_ps(yz, xw)));
+		__m256 m22 = _mm256_mul_ps(sz, _mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one));
+
+		StoreRowAoS8(&outMatrices[i], 0, m00, m01, m02, zero);
+		StoreRowAoS8(&outMatrices[i], 1, m10, m11, m12, zero);
+		StoreRowAoS8(&outMatrices[i], 2, m20, m21, m22, zero);
+		StoreRowAoS8(&outMatrices[i], 3, px, py, pz, one);
+	}
+
+	// Avoid the penalty for mixing AVX and SSE code afterwards
+	_mm256_zeroupper();
+
+	// Leftovers go through the narrower path
+	ComputeLocalMatricesSSE2(positions, rotations, scales, outMatrices, i, count);
+}
+
+TARGET_AVX2 static void ComputeWorldViewProjectionAVX2(
+	const XMFLOAT4X4* worldMatrices,
+	const XMFLOAT4X4& viewProjection,
+	XMFLOAT4X4* outMatrices,
+	unsigned int first,
+	unsigned int count,
+	bool transpose)
+{
+	// Each viewProjection row, repeated in both halves so
+	// two world rows can be transformed at once
+	__m256 vp0 = _mm256_broadcast_ps((const __m128*)viewProjection.m[0]);
+	__m256 vp1 = _mm256_broadcast_ps((const __m128*)viewProjection.m[1]);
+	__m256 vp2 = _mm256_broadcast_ps((const __m128*)viewProjection.m[2]);
+	__m256 vp3 = _mm256_broadcast_ps((const __m128*)viewProjection.m[3]);
+
+	for (unsigned int i = first; i < count; i++)
+	{
+		__m256 rows[2];
+		for (int r = 0; r < 2; r++)
+		{
+			// Two world rows at a time - permute broadcasts within each half
+			__m256 w = _mm256_loadu_ps(worldMatrices[i].m[r * 2]);
+			__m256 result = _mm256_mul_ps(_mm256_permute_ps(w, 0xFF), vp3);
+			result = _mm256_fmadd_ps(_mm256_permute_ps(w, 0xAA), vp2, result);
+			result = _mm256_fmadd_ps(_mm256_permute_ps(w, 0x55), vp1, result);
+			result = _mm256_fmadd_ps(_mm256_permute_ps(w, 0x00), vp0, result);
+			rows[r] = result;
+		}
+
+		if (transpose)
+		{
+			__m128 r0 = _mm256_castps256_ps128(rows[0]);
+			__m128 r1 = _mm256_extractf128_ps(rows[0], 1);
+			__m128 r2 = _mm256_castps256_ps128(rows[1]);
+			__m128 r3 = _mm256_extractf128_ps(rows[1], 1);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			rows[0] = Combine(r0, r1);
+			rows[1] = Combine(r2, r3);
+		}
+
+		_mm256_storeu_ps(outMatrices[i].m[0], rows[0]);
+		_mm256_storeu_ps(outMatrices[i].m[2], rows[1]);
+	}
+
+	_mm256_zeroupper();
+}
+#endif
+
+
+// --------------------------------------------------------
+// Builds a local (scale * rotation * translation) matrix
+// for each entity
+//
+// positions   - One position per entity
+// rotations   - One (normalized) quaternion per entity
+// scales      - One scale per entity
+// outMatrices - Where to write one matrix per entity
+// count       - Number of entities
+// --------------------------------------------------------
+void ComputeLocalMatrices(
+	const XMFLOAT3* positions,
+	const XMFLOAT4* rotations,
+	const XMFLOAT3* scales,
+	XMFLOAT4X4* outMatrices,
+	unsigned int count)
+{
+	switch (activePath)
+	{
+#if CPU_X86
+	case TransformKernelAVX2: ComputeLocalMatricesAVX2(positions, rotations, scales, outMatrices, 0, count); break;
+	case TransformKernelSSE2: ComputeLocalMatricesSSE2(positions, rotations, scales, outMatrices, 0, count); break;
+#endif
+	default: ComputeLocalMatricesScalar(positions, rotations, scales, outMatrices, 0, count); break;
+	}
+}
+
+// --------------------------------------------------------
+// Multiplies each world matrix by a shared view-projection
+// matrix, for a batch of world-view-projection matrices
+//
+// worldMatrices  - One world matrix per entity
+// viewProjection - The camera's combined view and projection
+// outMatrices    - Where to write one matrix per entity
+// count          - Number of entities
+// transpose      - Transpose each result (for HLSL cbuffers)?
+// --------------------------------------------------------
+void ComputeWorldViewProjection(
+	const XMFLOAT4X4* worldMatrices,
+	const XMFLOAT4X4& viewProjection,
+	XMFLOAT4X4* outMatrices,
+	unsigned int count,
+	bool transpose)
+{
+	switch (activePath)
+	{
+#if CPU_X86
+	case TransformKernelAVX2: ComputeWorldViewProjectionAVX2(worldMatrices, viewProjection, outMatrices, 0, count, transpose); break;
+	case TransformKernelSSE2: ComputeWorldViewProjectionSSE2(worldMatrices, viewProjection, outMatrices, 0, count, transpose); break;
+#endif
+	default: ComputeWorldViewProjectionScalar(worldMatrices, viewProjection, outMatrices, 0, count, transpose); break;
+	}
+}
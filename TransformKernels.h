@@ -0,0 +1,44 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Batched matrix generation for many entities at once.
+//
+// Inputs are the parallel position/rotation/scale arrays
+// that TransformSystem stores, and outputs are tightly
+// packed row-major 4x4 matrices (the same layout as
+// XMFLOAT4X4), ready to copy into a constant or instance
+// buffer.
+//
+// Each function picks the fastest path this CPU supports
+// (AVX2, then SSE2, then plain scalar code) the first time
+// it's called.  SetTransformKernelPath() can force a slower
+// path, for comparing results or measuring the difference.
+// --------------------------------------------------------
+enum TransformKernelPath
+{
+	TransformKernelScalar,
+	TransformKernelSSE2,
+	TransformKernelAVX2
+};
+
+TransformKernelPath GetTransformKernelPath();
+TransformKernelPath SetTransformKernelPath(TransformKernelPath path);
+
+// Scale, then rotate, then translate - matches XMMatrixAffineTransformation
+void ComputeLocalMatrices(
+	const DirectX::XMFLOAT3* positions,
+	const DirectX::XMFLOAT4* rotations,
+	const DirectX::XMFLOAT3* scales,
+	DirectX::XMFLOAT4X4* outMatrices,
+	unsigned int count);
+
+// world * viewProjection for each matrix, optionally transposed
+// (HLSL cbuffers expect column-major matrices by default)
+void ComputeWorldViewProjection(
+	const DirectX::XMFLOAT4X4* worldMatrices,
+	const DirectX::XMFLOAT4X4& viewProjection,
+	DirectX::XMFLOAT4X4* outMatrices,
+	unsigned int count,
+	bool transpose = false);
@@ -0,0 +1,217 @@
+#include "TransformSystem.h"
+#include "TransformKernels.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+// Flag bits for each entity
+//  - LocalDirty: Position, rotation or scale changed since the last update
+//  - WorldChanged: World matrix was rebuilt during the current update,
+//    so any children need theirs rebuilt as well
+static const unsigned char LocalDirty = 1;
+static const unsigned char WorldChanged = 2;
+
+// --------------------------------------------------------
+// Constructor - Starts with no entities
+// --------------------------------------------------------
+TransformSystem::TransformSystem()
+	:
+	firstDirty(0)
+{
+}
+
+// --------------------------------------------------------
+// Pre-allocates space for a known number of entities so
+// creating them doesn't repeatedly grow every array
+// --------------------------------------------------------
+void TransformSystem::Reserve(unsigned int entityCount)
+{
+	positions.reserve(entityCount);
+	rotations.reserve(entityCount);
+	scales.reserve(entityCount);
+	parents.reserve(entityCount);
+	localMatrices.reserve(entityCount);
+	worldMatrices.reserve(entityCount);
+	flags.reserve(entityCount);
+}
+
+// --------------------------------------------------------
+// Removes every entity
+// --------------------------------------------------------
+void TransformSystem::Clear()
+{
+	positions.clear();
+	rotations.clear();
+	scales.clear();
+	parents.clear();
+	localMatrices.clear();
+	worldMatrices.clear();
+	flags.clear();
+	firstDirty = 0;
+}
+
+// --------------------------------------------------------
+// Creates a new entity with an identity transform and
+// returns its index, or InvalidTransform if the parent
+// doesn't exist
+//
+// parent - An existing entity to attach to, or NoParent.
+//          Since the parent must already exist, it always
+//          has a lower index than the new entity.
+// --------------------------------------------------------
+unsigned int TransformSystem::Create(unsigned int parent)
+{
+	unsigned int entity = (unsigned int)positions.size();
+	if (parent != NoParent && parent >= entity)
+		return InvalidTransform;
+
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+
+	positions.push_back(XMFLOAT3(0, 0, 0));
+	rotations.push_back(XMFLOAT4(0, 0, 0, 1));
+	scales.push_back(XMFLOAT3(1, 1, 1));
+	parents.push_back(parent);
+	localMatrices.push_back(identity);
+	worldMatrices.push_back(identity);
+	flags.push_back(0);
+
+	// New entities need their world matrix built once
+	MarkDirty(entity);
+	return entity;
+}
+
+// --------------------------------------------------------
+// Number of entities
+// --------------------------------------------------------
+unsigned int TransformSystem::GetCount() const
+{
+	return (unsigned int)positions.size();
+}
+
+// --------------------------------------------------------
+// Setters for each entity's local transform - these only
+// mark the entity dirty; matrices are rebuilt in bulk by
+// UpdateWorldMatrices()
+// --------------------------------------------------------
+void TransformSystem::SetPosition(unsigned int entity, const XMFLOAT3& position)
+{
+	positions[entity] = position;
+	MarkDirty(entity);
+}
+
+void TransformSystem::SetRotation(unsigned int entity, const XMFLOAT4& rotationQuaternion)
+{
+	rotations[entity] = rotationQuaternion;
+	MarkDirty(entity);
+}
+
+void TransformSystem::SetScale(unsigned int entity, const XMFLOAT3& scale)
+{
+	scales[entity] = scale;
+	MarkDirty(entity);
+}
+
+// --------------------------------------------------------
+// Getters for each entity's local transform and parent
+// --------------------------------------------------------
+const XMFLOAT3& TransformSystem::GetPosition(unsigned int entity) const { return positions[entity]; }
+const XMFLOAT4& TransformSystem::GetRotation(unsigned int entity) const { return rotations[entity]; }
+const XMFLOAT3& TransformSystem::GetScale(unsigned int entity) const { return scales[entity]; }
+unsigned int TransformSystem::GetParent(unsigned int entity) const { return parents[entity]; }
+
+// --------------------------------------------------------
+// Rebuilds world matrices for every dirty entity and every
+// descendant of a dirty entity, and returns how many were
+// rebuilt.  Since parents always come before children, one
+// front-to-back pass is enough: by the time we reach any
+// entity, its parent's world matrix is already up to date.
+// --------------------------------------------------------
+unsigned int TransformSystem::UpdateWorldMatrices()
+{
+	unsigned int count = GetCount();
+	unsigned int updated = 0;
+
+	// First, rebuild local matrices for each run of consecutive
+	// dirty entities in one batch (these don't depend on parents)
+	for (unsigned int i = firstDirty; i < count; )
+	{
+		if ((flags[i] & LocalDirty) == 0)
+		{
+			i++;
+			continue;
+		}
+
+		unsigned int runStart = i;
+		while (i < count && (flags[i] & LocalDirty) != 0)
+			i++;
+
+		ComputeLocalMatrices(
+			&positions[runStart],
+			&rotations[runStart],
+			&scales[runStart],
+			&localMatrices[runStart],
+			i - runStart);
+	}
+
+	// Then combine with parents - everything before the
+	// first dirty entity is untouched
+	for (unsigned int i = firstDirty; i < count; i++)
+	{
+		unsigned int parent = parents[i];
+		bool localDirty = (flags[i] & LocalDirty) != 0;
+		bool parentChanged = parent != NoParent && (flags[parent] & WorldChanged) != 0;
+
+		if (!localDirty && !parentChanged)
+			continue;
+
+		// Children are relative to their parent
+		if (parent == NoParent)
+		{
+			worldMatrices[i] = localMatrices[i];
+		}
+		else
+		{
+			XMMATRIX world = XMMatrixMultiply(
+				XMLoadFloat4x4(&localMatrices[i]),
+				XMLoadFloat4x4(&worldMatrices[parent]));
+			XMStoreFloat4x4(&worldMatrices[i], world);
+		}
+
+		flags[i] = WorldChanged;
+		updated++;
+	}
+
+	// Clear this update's flags so the next one starts fresh
+	if (firstDirty < count)
+		std::fill(flags.begin() + firstDirty, flags.end(), (unsigned char)0);
+
+	firstDirty = count;
+	return updated;
+}
+
+// --------------------------------------------------------
+// World matrix of a single entity, as of the last update
+// --------------------------------------------------------
+const XMFLOAT4X4& TransformSystem::GetWorldMatrix(unsigned int entity) const
+{
+	return worldMatrices[entity];
+}
+
+// --------------------------------------------------------
+// All world matrices, tightly packed in entity order
+// --------------------------------------------------------
+const XMFLOAT4X4* TransformSystem::GetWorldMatrices() const
+{
+	return worldMatrices.data();
+}
+
+// --------------------------------------------------------
+// Flags an entity's local transform as changed
+// --------------------------------------------------------
+void TransformSystem::MarkDirty(unsigned int entity)
+{
+	flags[entity] |= LocalDirty;
+	firstDirty = std::min(firstDirty, entity);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Returned by TransformSystem::Create() when it can't create an entity
+static const unsigned int InvalidTransform = 0xFFFFFFFF;
+
+// --------------------------------------------------------
+// Position, rotation, scale and hierarchy for every entity
+// in the scene, stored as parallel arrays (structure of
+// arrays) indexed by entity.
+//
+// Entities are always stored parent-before-child, so world
+// matrices can be rebuilt in a single front-to-back pass,
+// and only entities whose own transform (or an ancestor's)
+// changed are recomputed.
+//
+// This has no Direct3D dependencies at all.
+// --------------------------------------------------------
+class TransformSystem
+{
+public:
+	static const unsigned int NoParent = 0xFFFFFFFF;
+
+	TransformSystem();
+
+	void Reserve(unsigned int entityCount);
+	void Clear();
+	unsigned int Create(unsigned int parent = NoParent);
+	unsigned int GetCount() const;
+
+	void SetPosition(unsigned int entity, const DirectX::XMFLOAT3& position);
+	void SetRotation(unsigned int entity, const DirectX::XMFLOAT4& rotationQuaternion);
+	void SetScale(unsigned int entity, const DirectX::XMFLOAT3& scale);
+
+	const DirectX::XMFLOAT3& GetPosition(unsigned int entity) const;
+	const DirectX::XMFLOAT4& GetRotation(unsigned int entity) const;
+	const DirectX::XMFLOAT3& GetScale(unsigned int entity) const;
+	unsigned int GetParent(unsigned int entity) const;
+
+	unsigned int UpdateWorldMatrices();
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(unsigned int entity) const;
+	const DirectX::XMFLOAT4X4* GetWorldMatrices() const;
+
+private:
+	// Local transform data
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT4> rotations;	// Quaternions
+	std::vector<DirectX::XMFLOAT3> scales;
+
+	// Hierarchy - a parent's index is always lower than its children's
+	std::vector<unsigned int> parents;
+
+	// Cached matrices
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+
+	// Per-entity flags (see TransformSystem.cpp)
+	std::vector<unsigned char> flags;
+	unsigned int firstDirty;
+
+	void MarkDirty(unsigned int entity);
+};
@@ -0,0 +1,142 @@
+#include "TransientAllocator.h"
+
+#include <algorithm>
+
+// --------------------------------------------------------
+// Constructor - Starts with nothing declared
+// --------------------------------------------------------
+TransientAllocator::TransientAllocator()
+{
+}
+
+// --------------------------------------------------------
+// Forgets every transient and slot, ready for the next
+// frame (the stats stay until the next Allocate())
+// --------------------------------------------------------
+void TransientAllocator::Clear()
+{
+	transients.clear();
+	slots.clear();
+}
+
+// --------------------------------------------------------
+// Adds a transient, returning its id
+//
+// key      - Only transients with the same key share slots
+// bytes    - Its size, for the stats
+// firstUse - First use that needs it
+// lastUse  - Last use that needs it (inclusive)
+// --------------------------------------------------------
+TransientId TransientAllocator::Declare(unsigned long long key, size_t bytes, unsigned int firstUse, unsigned int lastUse)
+{
+	Transient transient;
+	transient.key = key;
+	transient.bytes = bytes;
+	transient.firstUse = firstUse < lastUse ? firstUse : lastUse;
+	transient.lastUse = firstUse < lastUse ? lastUse : firstUse;
+	transient.slot = 0;
+	transients.push_back(transient);
+	return (TransientId)(transients.size() - 1);
+}
+
+// --------------------------------------------------------
+// Stretches a transient's lifetime to cover another use
+// --------------------------------------------------------
+void TransientAllocator::Use(TransientId transient, unsigned int use)
+{
+	Transient& t = transients[transient];
+	if (use < t.firstUse)
+		t.firstUse = use;
+	if (use > t.lastUse)
+		t.lastUse = use;
+}
+
+// --------------------------------------------------------
+// Assigns every transient a slot, and returns how many
+// slots there are.  A slot is only freed for reuse after
+// the last use of whatever's in it, so two transients
+// needed by the same use never share.
+// --------------------------------------------------------
+unsigned int TransientAllocator::Allocate()
+{
+	slots.clear();
+	active.clear();
+	freed.clear();
+
+	order.resize(transients.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+		order[i] = i;
+
+	// Stable, so ties keep declaration order
+	std::stable_sort(order.begin(), order.end(),
+		[this](unsigned int a, unsigned int b) { return transients[a].firstUse < transients[b].firstUse; });
+
+	// Heap order puts the slot that frees up soonest first
+	auto freesLater = [this](unsigned int a, unsigned int b) { return slots[a].lastUse > slots[b].lastUse; };
+
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		Transient& t = transients[order[i]];
+
+		// Slots whose transients are done by now can be reused
+		while (!active.empty() && slots[active.front()].lastUse < t.firstUse)
+		{
+			std::pop_heap(active.begin(), active.end(), freesLater);
+			freed.push_back(active.back());
+			active.pop_back();
+		}
+
+		// A free slot with the same key, or a new one - there
+		// are usually only a handful free, so a search is fine
+		unsigned int slot = (unsigned int)slots.size();
+		for (unsigned int f = 0; f < freed.size(); f++)
+		{
+			if (slots[freed[f]].key == t.key)
+			{
+				slot = freed[f];
+				freed[f] = freed.back();
+				freed.pop_back();
+				break;
+			}
+		}
+
+		if (slot == slots.size())
+		{
+			Slot s;
+			s.key = t.key;
+			s.bytes = 0;
+			s.lastUse = 0;
+			slots.push_back(s);
+		}
+
+		Slot& s = slots[slot];
+		if (t.bytes > s.bytes)
+			s.bytes = t.bytes;
+		s.lastUse = t.lastUse;
+		t.slot = slot;
+
+		active.push_back(slot);
+		std::push_heap(active.begin(), active.end(), freesLater);
+	}
+
+	stats = TransientStats();
+	stats.transientCount = (unsigned int)transients.size();
+	stats.slotCount = (unsigned int)slots.size();
+	for (unsigned int i = 0; i < transients.size(); i++)
+		stats.requestedBytes += transients[i].bytes;
+	for (unsigned int i = 0; i < slots.size(); i++)
+		stats.allocatedBytes += slots[i].bytes;
+
+	return (unsigned int)slots.size();
+}
+
+unsigned int TransientAllocator::GetTransientCount() const { return (unsigned int)transients.size(); }
+unsigned int TransientAllocator::GetFirstUse(TransientId transient) const { return transients[transient].firstUse; }
+unsigned int TransientAllocator::GetLastUse(TransientId transient) const { return transients[transient].lastUse; }
+unsigned int TransientAllocator::GetSlot(TransientId transient) const { return transients[transient].slot; }
+
+unsigned int TransientAllocator::GetSlotCount() const { return (unsigned int)slots.size(); }
+unsigned long long TransientAllocator::GetSlotKey(unsigned int slot) const { return slots[slot].key; }
+size_t TransientAllocator::GetSlotBytes(unsigned int slot) const { return slots[slot].bytes; }
+
+const TransientStats& TransientAllocator::GetStats() const { return stats; }
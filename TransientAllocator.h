@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Which transient resource - an index in declaration order
+typedef unsigned int TransientId;
+
+// --------------------------------------------------------
+// How much sharing saved, for the last Allocate()
+// --------------------------------------------------------
+struct TransientStats
+{
+	unsigned int transientCount = 0;
+	unsigned int slotCount = 0;
+	size_t requestedBytes = 0;	// If every transient had its own resource
+	size_t allocatedBytes = 0;	// What the slots actually need
+};
+
+// --------------------------------------------------------
+// Works out which short-lived resources can share the same
+// actual resource within a frame.
+//
+// Each transient is declared with a key (resources are only
+// interchangeable if their keys match - a hash of their
+// description, say), a size, and the first and last "use"
+// (pass, step...) that needs it.  Allocate() then gives each
+// one a slot, and transients whose uses don't overlap share
+// slots wherever their keys allow - so a slot is one real
+// resource, reused by each transient assigned to it in turn.
+//
+// Slots are handed out in order of first use, always reusing
+// a freed one with the same key if there is one, which needs
+// the fewest slots possible (the most transients of a key
+// alive at any one use).
+//
+// No Direct3D dependencies.
+// --------------------------------------------------------
+class TransientAllocator
+{
+public:
+	TransientAllocator();
+
+	void Clear();
+	TransientId Declare(unsigned long long key, size_t bytes, unsigned int firstUse, unsigned int lastUse);
+	void Use(TransientId transient, unsigned int use);
+
+	unsigned int Allocate();
+
+	unsigned int GetTransientCount() const;
+	unsigned int GetFirstUse(TransientId transient) const;
+	unsigned int GetLastUse(TransientId transient) const;
+	unsigned int GetSlot(TransientId transient) const;
+
+	unsigned int GetSlotCount() const;
+	unsigned long long GetSlotKey(unsigned int slot) const;
+	size_t GetSlotBytes(unsigned int slot) const;
+
+	const TransientStats& GetStats() const;
+
+private:
+	struct Transient
+	{
+		unsigned long long key;
+		size_t bytes;
+		unsigned int firstUse;
+		unsigned int lastUse;
+		unsigned int slot;
+	};
+
+	struct Slot
+	{
+		unsigned long long key;
+		size_t bytes;
+		unsigned int lastUse;	// Of the transient using it most recently
+	};
+
+	std::vector<Transient> transients;
+	std::vector<Slot> slots;
+
+	// Scratch for Allocate(), kept so it doesn't allocate
+	std::vector<unsigned int> order;	// Transients by first use
+	std::vector<unsigned int> active;	// Slots in use, as a heap by last use
+	std::vector<unsigned int> freed;	// Slots free again
+
+	TransientStats stats;
+};
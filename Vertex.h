@@ -10,5 +10,7 @@
 struct Vertex
 {
 	DirectX::XMFLOAT3 Position;	    // The local position of the vertex
+	DirectX::XMFLOAT3 Normal;       // The direction the surface faces
+	DirectX::XMFLOAT2 UV;           // Texture coordinates
 	DirectX::XMFLOAT4 Color;        // The color of the vertex
 };
\ No newline at end of file
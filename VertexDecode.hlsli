@@ -0,0 +1,25 @@
+#ifndef __VERTEX_DECODE_HLSLI__
+#define __VERTEX_DECODE_HLSLI__
+
+// --------------------------------------------------------
+// Decoding for the quantized vertex format - these mirror
+// the CPU decoder in VertexFormat.cpp
+//
+// The input assembler already turns UNORM, SNORM and half
+// float elements into regular floats, and positions are
+// relative to the mesh's bounds, which the instance's
+// matrix accounts for.  That leaves just the normals.
+// --------------------------------------------------------
+
+// Octahedral-encoded unit vector (two SNORMs) back to 3D
+float3 DecodeOctahedral(float2 encoded)
+{
+	float3 n = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+
+	// Unfold the corners back under
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+
+#endif
@@ -0,0 +1,502 @@
+#include "VertexFormat.h"
+
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// --------------------------------------------------------
+// Bytes taken up by one element of each type
+// --------------------------------------------------------
+unsigned int GetVertexElementSize(VertexElementType type)
+{
+	switch (type)
+	{
+	case VertexElementFloat2: return 8;
+	case VertexElementFloat3: return 12;
+	case VertexElementFloat4: return 16;
+	case VertexElementUnorm16x3: return 6;
+	case VertexElementOctahedral16: return 4;
+	case VertexElementOctahedral8: return 2;
+	case VertexElementHalf2: return 4;
+	case VertexElementUnorm8x4: return 4;
+	default: return 0;
+	}
+}
+
+// --------------------------------------------------------
+// What an element's offset must be a multiple of - the
+// input assembler wants 4 bytes, or the element's size if
+// that's smaller
+// --------------------------------------------------------
+unsigned int GetVertexElementAlignment(VertexElementType type)
+{
+	unsigned int size = GetVertexElementSize(type);
+	return size < 4 ? (size > 0 ? size : 1) : 4;
+}
+
+// --------------------------------------------------------
+// How many components the vertex shader should declare for
+// an element (all of them floats)
+// --------------------------------------------------------
+unsigned int GetVertexElementShaderComponents(VertexElementType type)
+{
+	switch (type)
+	{
+	case VertexElementFloat2: return 2;
+	case VertexElementFloat3: return 3;
+	case VertexElementFloat4: return 4;
+	case VertexElementUnorm16x3: return 3;
+	case VertexElementOctahedral16: return 2;
+	case VertexElementOctahedral8: return 2;
+	case VertexElementHalf2: return 2;
+	case VertexElementUnorm8x4: return 4;
+	default: return 0;
+	}
+}
+
+// --------------------------------------------------------
+// The semantic each attribute has in VertexShader.hlsl
+// --------------------------------------------------------
+const char* GetVertexAttributeSemantic(VertexAttribute attribute)
+{
+	static const char* const semantics[VertexAttributeCount] =
+	{
+		"POSITION",
+		"NORMAL",
+		"TEXCOORD",
+		"COLOR"
+	};
+	return semantics[attribute];
+}
+
+VertexFormat MakeVertexFormat(
+	VertexElementType position,
+	VertexElementType normal,
+	VertexElementType uv,
+	VertexElementType color)
+{
+	VertexFormat format;
+	format.types[VertexAttributePosition] = position;
+	format.types[VertexAttributeNormal] = normal;
+	format.types[VertexAttributeUV] = uv;
+	format.types[VertexAttributeColor] = color;
+
+	// Padding the stride to 4 bytes also leaves room for
+	// Unorm16x3's fourth channel when it comes last
+	format.stride = 0;
+	for (unsigned int i = 0; i < VertexAttributeCount; i++)
+	{
+		unsigned int alignment = GetVertexElementAlignment(format.types[i]);
+		format.offsets[i] = (format.stride + alignment - 1) & ~(alignment - 1);
+		format.stride = format.offsets[i] + GetVertexElementSize(format.types[i]);
+	}
+	format.stride = (format.stride + 3) & ~3u;
+
+	return format;
+}
+
+const VertexFormat& GetVertexFormat(VertexFormatId id)
+{
+	static const VertexFormat formats[VertexFormatCount] =
+	{
+		MakeVertexFormat(VertexElementFloat3, VertexElementFloat3, VertexElementFloat2, VertexElementFloat4),
+		MakeVertexFormat(VertexElementUnorm16x3, VertexElementOctahedral8, VertexElementNone, VertexElementNone),
+		MakeVertexFormat(VertexElementUnorm16x3, VertexElementOctahedral8, VertexElementNone, VertexElementUnorm8x4),
+		MakeVertexFormat(VertexElementUnorm16x3, VertexElementOctahedral8, VertexElementHalf2, VertexElementNone),
+		MakeVertexFormat(VertexElementUnorm16x3, VertexElementOctahedral8, VertexElementHalf2, VertexElementUnorm8x4),
+	};
+	return formats[id];
+}
+
+// --------------------------------------------------------
+// The smallest quantized format that keeps everything these
+// vertices need - colors are only stored if any aren't white,
+// and UVs if any aren't zero (which is what decoding without
+// them gives back)
+// --------------------------------------------------------
+VertexFormatId ChooseQuantizedVertexFormat(const Vertex* vertices, unsigned int vertexCount)
+{
+	bool hasColors = false;
+	bool hasUVs = false;
+	for (unsigned int i = 0; i < vertexCount && !(hasColors && hasUVs); i++)
+	{
+		const XMFLOAT4& c = vertices[i].Color;
+		const XMFLOAT2& uv = vertices[i].UV;
+		hasColors = hasColors || c.x != 1.0f || c.y != 1.0f || c.z != 1.0f || c.w != 1.0f;
+		hasUVs = hasUVs || uv.x != 0.0f || uv.y != 0.0f;
+	}
+
+	if (hasUVs)
+		return hasColors ? VertexFormatQuantizedColorUV : VertexFormatQuantizedUV;
+	return hasColors ? VertexFormatQuantizedColor : VertexFormatQuantized;
+}
+
+// --------------------------------------------------------
+// Bounds of the positions, if the format stores positions
+// relative to them
+// --------------------------------------------------------
+VertexQuantization ComputeVertexQuantization(
+	const VertexFormat& format,
+	const Vertex* vertices,
+	unsigned int vertexCount)
+{
+	VertexQuantization quantization;
+	if (format.types[VertexAttributePosition] != VertexElementUnorm16x3 || vertexCount == 0)
+		return quantization;
+
+	XMVECTOR minimum = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR maximum = minimum;
+	for (unsigned int i = 1; i < vertexCount; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices[i].Position);
+		minimum = XMVectorMin(minimum, p);
+		maximum = XMVectorMax(maximum, p);
+	}
+
+	XMStoreFloat3(&quantization.positionOffset, minimum);
+	XMStoreFloat3(&quantization.positionScale, XMVectorSubtract(maximum, minimum));
+
+	// Flat along an axis - any scale works, but zero won't invert
+	float* scale = &quantization.positionScale.x;
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		if (scale[i] <= 0.0f)
+			scale[i] = 1.0f;
+	}
+
+	return quantization;
+}
+
+// --------------------------------------------------------
+// A matrix that turns stored positions into mesh positions,
+// to multiply on the left of a world matrix
+// --------------------------------------------------------
+XMFLOAT4X4 GetPositionDecodeMatrix(const VertexQuantization& quantization)
+{
+	XMFLOAT4X4 decode;
+	XMStoreFloat4x4(&decode, XMMatrixMultiply(
+		XMMatrixScaling(quantization.positionScale.x, quantization.positionScale.y, quantization.positionScale.z),
+		XMMatrixTranslation(quantization.positionOffset.x, quantization.positionOffset.y, quantization.positionOffset.z)));
+	return decode;
+}
+
+static float Clamp(float value, float low, float high)
+{
+	return std::min(std::max(value, low), high);
+}
+
+static unsigned short EncodeUnorm16(float value)
+{
+	return (unsigned short)(Clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+static short EncodeSnorm16(float value)
+{
+	return (short)std::lround(Clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+static signed char EncodeSnorm8(float value)
+{
+	return (signed char)std::lround(Clamp(value, -1.0f, 1.0f) * 127.0f);
+}
+
+static unsigned char EncodeUnorm8(float value)
+{
+	return (unsigned char)(Clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// --------------------------------------------------------
+// Octahedral encoding - projects the unit sphere onto an
+// octahedron, then unfolds that into a square
+// (Cigolle et al., "A Survey of Efficient Representations
+// for Independent Unit Vectors")
+// --------------------------------------------------------
+static void EncodeOctahedral(const XMFLOAT3& n, float* out)
+{
+	float length = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (length <= 0.0f)
+	{
+		// No direction at all - store straight out of the screen
+		out[0] = 0.0f;
+		out[1] = 0.0f;
+		return;
+	}
+
+	float x = n.x / length;
+	float y = n.y / length;
+	if (n.z < 0.0f)
+	{
+		// Fold the lower half out over the corners
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	out[0] = x;
+	out[1] = y;
+}
+
+// Takes the square's coordinates as the input assembler
+// gives them to the shader (SNORMs already turned to floats)
+static XMFLOAT3 DecodeOctahedral(float x, float y)
+{
+	float z = 1.0f - fabsf(x) - fabsf(y);
+
+	// Unfold the corners back under
+	float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	XMFLOAT3 n;
+	XMStoreFloat3(&n, XMVector3Normalize(XMVectorSet(x, y, z, 0.0f)));
+	return n;
+}
+
+// --------------------------------------------------------
+// Writes one attribute (as up to four floats) in the given
+// element type
+// --------------------------------------------------------
+static void EncodeElement(VertexElementType type, const float* value, unsigned char* out)
+{
+	switch (type)
+	{
+	case VertexElementFloat2:
+	case VertexElementFloat3:
+	case VertexElementFloat4:
+		memcpy(out, value, GetVertexElementSize(type));
+		break;
+
+	case VertexElementUnorm16x3:
+	{
+		unsigned short q[3] = { EncodeUnorm16(value[0]), EncodeUnorm16(value[1]), EncodeUnorm16(value[2]) };
+		memcpy(out, q, sizeof(q));
+		break;
+	}
+
+	case VertexElementOctahedral16:
+	{
+		float square[2];
+		EncodeOctahedral(XMFLOAT3(value[0], value[1], value[2]), square);
+		short q[2] = { EncodeSnorm16(square[0]), EncodeSnorm16(square[1]) };
+		memcpy(out, q, sizeof(q));
+		break;
+	}
+
+	case VertexElementOctahedral8:
+	{
+		float square[2];
+		EncodeOctahedral(XMFLOAT3(value[0], value[1], value[2]), square);
+		signed char q[2] = { EncodeSnorm8(square[0]), EncodeSnorm8(square[1]) };
+		memcpy(out, q, sizeof(q));
+		break;
+	}
+
+	case VertexElementHalf2:
+	{
+		HALF h[2] = { XMConvertFloatToHalf(value[0]), XMConvertFloatToHalf(value[1]) };
+		memcpy(out, h, sizeof(h));
+		break;
+	}
+
+	case VertexElementUnorm8x4:
+		for (unsigned int i = 0; i < 4; i++)
+			out[i] = EncodeUnorm8(value[i]);
+		break;
+
+	default:
+		break;
+	}
+}
+
+// --------------------------------------------------------
+// Reads one attribute back as floats - only as many as the
+// element type stores are written
+// --------------------------------------------------------
+static void DecodeElement(VertexElementType type, const unsigned char* in, float* value)
+{
+	switch (type)
+	{
+	case VertexElementFloat2:
+	case VertexElementFloat3:
+	case VertexElementFloat4:
+		memcpy(value, in, GetVertexElementSize(type));
+		break;
+
+	case VertexElementUnorm16x3:
+	{
+		unsigned short q[3];
+		memcpy(q, in, sizeof(q));
+		for (unsigned int i = 0; i < 3; i++)
+			value[i] = q[i] / 65535.0f;
+		break;
+	}
+
+	case VertexElementOctahedral16:
+	{
+		short q[2];
+		memcpy(q, in, sizeof(q));
+		XMFLOAT3 n = DecodeOctahedral(std::max(q[0] / 32767.0f, -1.0f), std::max(q[1] / 32767.0f, -1.0f));
+		value[0] = n.x;
+		value[1] = n.y;
+		value[2] = n.z;
+		break;
+	}
+
+	case VertexElementOctahedral8:
+	{
+		signed char q[2];
+		memcpy(q, in, sizeof(q));
+		XMFLOAT3 n = DecodeOctahedral(std::max(q[0] / 127.0f, -1.0f), std::max(q[1] / 127.0f, -1.0f));
+		value[0] = n.x;
+		value[1] = n.y;
+		value[2] = n.z;
+		break;
+	}
+
+	case VertexElementHalf2:
+	{
+		HALF h[2];
+		memcpy(h, in, sizeof(h));
+		value[0] = XMConvertHalfToFloat(h[0]);
+		value[1] = XMConvertHalfToFloat(h[1]);
+		break;
+	}
+
+	case VertexElementUnorm8x4:
+		for (unsigned int i = 0; i < 4; i++)
+			value[i] = in[i] / 255.0f;
+		break;
+
+	default:
+		break;
+	}
+}
+
+// --------------------------------------------------------
+// Converts vertices into the given format
+// --------------------------------------------------------
+void EncodeVertices(
+	const VertexFormat& format,
+	const VertexQuantization& quantization,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	void* output)
+{
+	const float* offset = &quantization.positionOffset.x;
+	const float* scale = &quantization.positionScale.x;
+	bool relativePositions = format.types[VertexAttributePosition] == VertexElementUnorm16x3;
+
+	unsigned char* out = (unsigned char*)output;
+	memset(out, 0, (size_t)format.stride * vertexCount);
+
+	for (unsigned int i = 0; i < vertexCount; i++, out += format.stride)
+	{
+		const Vertex& v = vertices[i];
+
+		float position[3] = { v.Position.x, v.Position.y, v.Position.z };
+		if (relativePositions)
+		{
+			for (unsigned int c = 0; c < 3; c++)
+				position[c] = (position[c] - offset[c]) / scale[c];
+		}
+
+		EncodeElement(format.types[VertexAttributePosition], position, out + format.offsets[VertexAttributePosition]);
+		EncodeElement(format.types[VertexAttributeNormal], &v.Normal.x, out + format.offsets[VertexAttributeNormal]);
+		EncodeElement(format.types[VertexAttributeUV], &v.UV.x, out + format.offsets[VertexAttributeUV]);
+		EncodeElement(format.types[VertexAttributeColor], &v.Color.x, out + format.offsets[VertexAttributeColor]);
+	}
+}
+
+// --------------------------------------------------------
+// Converts vertices from the given format back to Vertex,
+// using defaults for anything the format doesn't store
+// --------------------------------------------------------
+void DecodeVertices(
+	const VertexFormat& format,
+	const VertexQuantization& quantization,
+	const void* data,
+	unsigned int vertexCount,
+	Vertex* output)
+{
+	const float* offset = &quantization.positionOffset.x;
+	const float* scale = &quantization.positionScale.x;
+	bool relativePositions = format.types[VertexAttributePosition] == VertexElementUnorm16x3;
+
+	const unsigned char* in = (const unsigned char*)data;
+	for (unsigned int i = 0; i < vertexCount; i++, in += format.stride)
+	{
+		float position[3] = { 0, 0, 0 };
+		float normal[3] = { 0, 0, 1 };
+		float uv[2] = { 0, 0 };
+		float color[4] = { 1, 1, 1, 1 };
+
+		DecodeElement(format.types[VertexAttributePosition], in + format.offsets[VertexAttributePosition], position);
+		DecodeElement(format.types[VertexAttributeNormal], in + format.offsets[VertexAttributeNormal], normal);
+		DecodeElement(format.types[VertexAttributeUV], in + format.offsets[VertexAttributeUV], uv);
+		DecodeElement(format.types[VertexAttributeColor], in + format.offsets[VertexAttributeColor], color);
+
+		if (relativePositions)
+		{
+			for (unsigned int c = 0; c < 3; c++)
+				position[c] = offset[c] + position[c] * scale[c];
+		}
+
+		Vertex& v = output[i];
+		v.Position = XMFLOAT3(position[0], position[1], position[2]);
+		v.Normal = XMFLOAT3(normal[0], normal[1], normal[2]);
+		v.UV = XMFLOAT2(uv[0], uv[1]);
+		v.Color = XMFLOAT4(color[0], color[1], color[2], color[3]);
+	}
+}
+
+// --------------------------------------------------------
+// Encodes, decodes and compares against the originals
+// --------------------------------------------------------
+VertexEncodingError MeasureVertexEncodingError(
+	const VertexFormat& format,
+	const VertexQuantization& quantization,
+	const Vertex* vertices,
+	unsigned int vertexCount)
+{
+	std::vector<unsigned char> encoded((size_t)format.stride * vertexCount);
+	std::vector<Vertex> decoded(vertexCount);
+	EncodeVertices(format, quantization, vertices, vertexCount, encoded.data());
+	DecodeVertices(format, quantization, encoded.data(), vertexCount, decoded.data());
+
+	VertexEncodingError error;
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const Vertex& a = vertices[i];
+		const Vertex& b = decoded[i];
+
+		error.position = std::max(error.position, fabsf(a.Position.x - b.Position.x));
+		error.position = std::max(error.position, fabsf(a.Position.y - b.Position.y));
+		error.position = std::max(error.position, fabsf(a.Position.z - b.Position.z));
+
+		XMVECTOR normal = XMLoadFloat3(&a.Normal);
+		if (XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f)
+		{
+			// atan2 stays precise for tiny angles, where acos doesn't
+			XMVECTOR decodedNormal = XMLoadFloat3(&b.Normal);
+			float sine = XMVectorGetX(XMVector3Length(XMVector3Cross(normal, decodedNormal)));
+			float cosine = XMVectorGetX(XMVector3Dot(normal, decodedNormal));
+			error.normalDegrees = std::max(error.normalDegrees, XMConvertToDegrees(atan2f(sine, cosine)));
+		}
+
+		error.uv = std::max(error.uv, fabsf(a.UV.x - b.UV.x));
+		error.uv = std::max(error.uv, fabsf(a.UV.y - b.UV.y));
+
+		error.color = std::max(error.color, fabsf(a.Color.x - b.Color.x));
+		error.color = std::max(error.color, fabsf(a.Color.y - b.Color.y));
+		error.color = std::max(error.color, fabsf(a.Color.z - b.Color.z));
+		error.color = std::max(error.color, fabsf(a.Color.w - b.Color.w));
+	}
+
+	return error;
+}
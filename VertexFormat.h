@@ -0,0 +1,152 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Vertex formats - how each attribute of a Vertex is stored
+// in a vertex buffer.  The full format matches Vertex
+// exactly (48 bytes), while the quantized ones only keep
+// what a mesh has, in as little as 8 bytes (3.5x smaller
+// than the original 28-byte position and color vertex, 6x
+// smaller than the full format):
+//
+//  - Position: 16-bit UNORM per axis, relative to the
+//    mesh's bounds (see VertexQuantization)
+//  - Normal:   octahedral encoding in two 8-bit SNORMs,
+//    packed where the position's fourth channel would be
+//  - UV:       two half floats, only in the UV formats, for
+//    meshes that have UVs (4 more bytes)
+//  - Color:    8-bit UNORM per channel, only in the Color
+//    formats, for meshes that have colors (4 more bytes)
+//
+// One VertexFormat describes the layout for everything
+// else: the CPU encoder and decoder here, the input layout
+// (VertexFormatD3D11.h) and the matching vertex shader
+// inputs (VertexShader.hlsl, checked against these by
+// VertexFormatTests.cpp).
+//
+// This has no Direct3D dependencies at all.
+// --------------------------------------------------------
+enum VertexAttribute
+{
+	VertexAttributePosition,
+	VertexAttributeNormal,
+	VertexAttributeUV,
+	VertexAttributeColor,
+	VertexAttributeCount
+};
+
+enum VertexElementType
+{
+	VertexElementNone,			// Not stored - decodes to a default value
+	VertexElementFloat2,
+	VertexElementFloat3,
+	VertexElementFloat4,
+	VertexElementUnorm16x3,		// Position relative to bounds (read as four channels - see below)
+	VertexElementOctahedral16,	// Unit vector in two SNORM16s
+	VertexElementOctahedral8,	// Unit vector in two SNORM8s
+	VertexElementHalf2,
+	VertexElementUnorm8x4
+};
+
+// There's no three-channel 16-bit format for the input
+// assembler, so Unorm16x3 is read as four channels, and its
+// fourth is whatever 2 bytes come next (padding, or another
+// element like an Octahedral8) - which shaders ignore
+unsigned int GetVertexElementSize(VertexElementType type);
+unsigned int GetVertexElementAlignment(VertexElementType type);
+unsigned int GetVertexElementShaderComponents(VertexElementType type);
+const char* GetVertexAttributeSemantic(VertexAttribute attribute);
+
+struct VertexFormat
+{
+	VertexElementType types[VertexAttributeCount];
+	unsigned int offsets[VertexAttributeCount];	// In bytes, from the start of a vertex
+	unsigned int stride;
+};
+
+// Lays out the attributes in order, each at its type's
+// alignment, with the stride a multiple of 4 bytes
+VertexFormat MakeVertexFormat(
+	VertexElementType position,
+	VertexElementType normal,
+	VertexElementType uv,
+	VertexElementType color);
+
+// --------------------------------------------------------
+// The formats meshes can choose from - shaders and input
+// layouts are created for each of these
+// --------------------------------------------------------
+enum VertexFormatId
+{
+	VertexFormatFull,
+	VertexFormatQuantized,
+	VertexFormatQuantizedColor,
+	VertexFormatQuantizedUV,
+	VertexFormatQuantizedColorUV,
+	VertexFormatCount
+};
+
+const VertexFormat& GetVertexFormat(VertexFormatId id);
+VertexFormatId ChooseQuantizedVertexFormat(const Vertex* vertices, unsigned int vertexCount);
+
+// --------------------------------------------------------
+// Maps stored positions back to the mesh's space:
+//   position = offset + stored * scale
+// Identity (offset 0, scale 1) unless positions are stored
+// relative to bounds.  Since this is just a scale and a
+// translation, it can be folded into the world matrix.
+// --------------------------------------------------------
+struct VertexQuantization
+{
+	DirectX::XMFLOAT3 positionOffset = DirectX::XMFLOAT3(0, 0, 0);
+	DirectX::XMFLOAT3 positionScale = DirectX::XMFLOAT3(1, 1, 1);
+};
+
+VertexQuantization ComputeVertexQuantization(
+	const VertexFormat& format,
+	const Vertex* vertices,
+	unsigned int vertexCount);
+
+DirectX::XMFLOAT4X4 GetPositionDecodeMatrix(const VertexQuantization& quantization);
+
+// --------------------------------------------------------
+// Conversion between Vertex and any format
+//  - output must hold vertexCount * format.stride bytes
+// --------------------------------------------------------
+void EncodeVertices(
+	const VertexFormat& format,
+	const VertexQuantization& quantization,
+	const Vertex* vertices,
+	unsigned int vertexCount,
+	void* output);
+
+void DecodeVertices(
+	const VertexFormat& format,
+	const VertexQuantization& quantization,
+	const void* data,
+	unsigned int vertexCount,
+	Vertex* output);
+
+// --------------------------------------------------------
+// Worst-case precision lost by encoding then decoding
+//  - position: largest error on any axis, in mesh units
+//  - normal:   largest angle between before and after, in
+//              degrees (only counting non-zero normals)
+//  - uv/color: largest error in any component
+// --------------------------------------------------------
+struct VertexEncodingError
+{
+	float position = 0.0f;
+	float normalDegrees = 0.0f;
+	float uv = 0.0f;
+	float color = 0.0f;
+};
+
+VertexEncodingError MeasureVertexEncodingError(
+	const VertexFormat& format,
+	const VertexQuantization& quantization,
+	const Vertex* vertices,
+	unsigned int vertexCount);
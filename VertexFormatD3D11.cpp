@@ -0,0 +1,81 @@
+#include "VertexFormatD3D11.h"
+
+// --------------------------------------------------------
+// How the input assembler reads each element type
+// --------------------------------------------------------
+DXGI_FORMAT GetVertexElementDxgiFormat(VertexElementType type)
+{
+	switch (type)
+	{
+	case VertexElementFloat2: return DXGI_FORMAT_R32G32_FLOAT;
+	case VertexElementFloat3: return DXGI_FORMAT_R32G32B32_FLOAT;
+	case VertexElementFloat4: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	case VertexElementUnorm16x3: return DXGI_FORMAT_R16G16B16A16_UNORM;	// W overlaps what follows
+	case VertexElementOctahedral16: return DXGI_FORMAT_R16G16_SNORM;
+	case VertexElementOctahedral8: return DXGI_FORMAT_R8G8_SNORM;
+	case VertexElementHalf2: return DXGI_FORMAT_R16G16_FLOAT;
+	case VertexElementUnorm8x4: return DXGI_FORMAT_R8G8B8A8_UNORM;
+	default: return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+// --------------------------------------------------------
+// Builds the per-vertex part of an input layout
+//
+// format   - The vertex format to describe
+// elements - Where to write the descriptions (room for
+//            VertexAttributeCount of them)
+// --------------------------------------------------------
+unsigned int GetVertexInputElements(
+	const VertexFormat& format,
+	D3D11_INPUT_ELEMENT_DESC* elements)
+{
+	unsigned int count = 0;
+	for (unsigned int i = 0; i < VertexAttributeCount; i++)
+	{
+		if (format.types[i] == VertexElementNone)
+			continue;
+
+		D3D11_INPUT_ELEMENT_DESC& element = elements[count++];
+		element = {};
+		element.SemanticName = GetVertexAttributeSemantic((VertexAttribute)i);
+		element.Format = GetVertexElementDxgiFormat(format.types[i]);
+		element.InputSlot = 0;
+		element.AlignedByteOffset = format.offsets[i];
+		element.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	}
+
+	return count;
+}
+
+// --------------------------------------------------------
+// Builds a whole input layout for instanced drawing
+//
+// format   - The vertex format in slot 0
+// elements - Where to write the descriptions (room for
+//            InstancedInputElementCount of them)
+// --------------------------------------------------------
+unsigned int GetInstancedInputElements(
+	const VertexFormat& format,
+	D3D11_INPUT_ELEMENT_DESC* elements)
+{
+	unsigned int count = GetVertexInputElements(format, elements);
+
+	// The rest come from the instance buffer in slot 1 - one row
+	// of the world-view-projection matrix each, advancing once
+	// per instance rather than once per vertex
+	for (unsigned int row = 0; row < 4; row++)
+	{
+		D3D11_INPUT_ELEMENT_DESC& element = elements[count++];
+		element = {};
+		element.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		element.SemanticName = "INSTANCE_WVP";					// INSTANCE_WVP0 through INSTANCE_WVP3
+		element.SemanticIndex = row;
+		element.InputSlot = 1;									// Second vertex buffer
+		element.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
+		element.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		element.InstanceDataStepRate = 1;						// New data for every instance
+	}
+
+	return count;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <d3d11.h>
+
+#include "VertexFormat.h"
+
+// --------------------------------------------------------
+// Direct3D side of VertexFormat - the DXGI format each
+// element type is read as, and input layout elements for
+// a whole format.  The input assembler does the UNORM,
+// SNORM and half float conversions, so the vertex shader
+// only has to decode relative positions (folded into the
+// instance matrix) and octahedral normals.
+// --------------------------------------------------------
+DXGI_FORMAT GetVertexElementDxgiFormat(VertexElementType type);
+
+// Fills in input slot 0's elements and returns how many
+// were written (at most VertexAttributeCount)
+unsigned int GetVertexInputElements(
+	const VertexFormat& format,
+	D3D11_INPUT_ELEMENT_DESC* elements);
+
+// Slot 0's elements plus the per-instance world-view-projection
+// matrix from slot 1 (at most InstancedInputElementCount)
+static const unsigned int InstancedInputElementCount = VertexAttributeCount + 4;
+unsigned int GetInstancedInputElements(
+	const VertexFormat& format,
+	D3D11_INPUT_ELEMENT_DESC* elements);
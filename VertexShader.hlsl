@@ -1,7 +1,22 @@
 
+#include "DrawData.hlsli"
+#include "VertexDecode.hlsli"
+
+// Permutations of this shader are compiled with these set to
+// 0 or 1 (see ShaderPermutations.h), from wrappers named
+// after their keys, like VertexShader_5.hlsl
+//  - INSTANCED: the world-view-projection matrix comes per
+//     instance, from input slot 1.  Otherwise positions are
+//     already in world space, and only DrawData's view-projection
+//     applies (so quantized positions need INSTANCED too)
+//  - QUANTIZED_POSITIONS: the quantized vertex format - positions
+//     relative to the mesh's bounds, and octahedral normals
+//  - VERTEX_COLOR: color comes from the vertex, rather than white
+
 // Struct representing a single vertex worth of data
-// - This should match the vertex definition in our C++ code
-// - By "match", I mean the size, order and number of members
+// - This should match the vertex format in our C++ code (see VertexFormat.h),
+//   which VertexFormatTests.cpp checks for each permutation a format uses
+// - By "match", I mean the semantics and number of components
 // - The name of the struct itself is unimportant, but should be descriptive
 // - Each variable must have a semantic, which defines its usage
 struct VertexShaderInput
@@ -11,8 +26,25 @@ struct VertexShaderInput
 	//  |   Name          Semantic
 	//  |    |                |
 	//  v    v                v
+#if QUANTIZED_POSITIONS
+	float3 localPosition	: POSITION;     // XYZ position, 0-1 within the mesh's bounds
+	float2 normal			: NORMAL;       // Octahedral-encoded surface direction
+#else
 	float3 localPosition	: POSITION;     // XYZ position
+	float3 normal			: NORMAL;       // XYZ surface direction
+#endif
+#if VERTEX_COLOR
 	float4 color			: COLOR;        // RGBA color
+#endif
+
+#if INSTANCED
+	// Per-instance data (input slot 1) - the rows of
+	// this instance's world-view-projection matrix
+	float4 wvpRow0			: INSTANCE_WVP0;
+	float4 wvpRow1			: INSTANCE_WVP1;
+	float4 wvpRow2			: INSTANCE_WVP2;
+	float4 wvpRow3			: INSTANCE_WVP3;
+#endif
 };
 
 // Struct representing the data we're sending down the pipeline
@@ -29,6 +61,7 @@ struct VertexToPixel
 	//  v    v                v
 	float4 screenPosition	: SV_POSITION;	// XYZW position (System Value Position)
 	float4 color			: COLOR;        // RGBA color
+	float3 normal			: NORMAL;       // XYZ surface direction (unused so far)
 };
 
 // --------------------------------------------------------
@@ -43,20 +76,36 @@ VertexToPixel main( VertexShaderInput input )
 	// Set up output struct
 	VertexToPixel output;
 
-	// Here we're essentially passing the input position directly through to the next
-	// stage (rasterizer), though it needs to be a 4-component vector now.  
-	// - To be considered within the bounds of the screen, the X and Y components 
-	//   must be between -1 and 1.  
-	// - The Z component must be between 0 and 1.  
-	// - Each of these components is then automatically divided by the W component, 
-	//   which we're leaving at 1.0 for now (this is more useful when dealing with 
-	//   a perspective projection matrix, which we'll get to in the future).
-	output.screenPosition = float4(input.localPosition, 1.0f);
+	// Transform the position by this instance's world-view-projection
+	// matrix, which was packed row by row on the C++ side
+	// - float4x4() builds a matrix from rows, and multiplying a row
+	//   vector on the left matches DirectXMath's row-major convention
+	// - With no camera yet, the view and projection are both identity,
+	//   so X and Y still need to end up between -1 and 1, and Z between 0 and 1
+	// - Quantized positions are relative to the mesh's bounds, and the
+	//   matrix for those meshes starts by scaling and offsetting them back
+#if INSTANCED
+	float4x4 wvp = float4x4(input.wvpRow0, input.wvpRow1, input.wvpRow2, input.wvpRow3);
+#else
+	float4x4 wvp = viewProjection;
+#endif
+	output.screenPosition = mul(float4(input.localPosition, 1.0f), wvp);
 
 	// Pass the color through 
 	// - The values will be interpolated per-pixel by the rasterizer
 	// - We don't need to alter it here, but we do need to send it to the pixel shader
+#if VERTEX_COLOR
 	output.color = input.color;
+#else
+	output.color = float4(1.0f, 1.0f, 1.0f, 1.0f);
+#endif
+
+	// Normals are still in the mesh's space - there's no lighting yet
+#if QUANTIZED_POSITIONS
+	output.normal = DecodeOctahedral(input.normal);
+#else
+	output.normal = input.normal;
+#endif
 
 	// Whatever we return will make its way through the pipeline to the
 	// next programmable stage we're using (the pixel shader for now)
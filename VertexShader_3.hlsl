@@ -0,0 +1,7 @@
+// VertexShader.hlsl, permutation 0x3 (INSTANCED, QUANTIZED_POSITIONS) -
+// instanced meshes in the quantized vertex formats with no colors
+// (VertexFormatQuantized and VertexFormatQuantizedUV)
+#define INSTANCED 1
+#define QUANTIZED_POSITIONS 1
+#define VERTEX_COLOR 0
+#include "VertexShader.hlsl"
@@ -0,0 +1,6 @@
+// VertexShader.hlsl, permutation 0x5 (INSTANCED, VERTEX_COLOR) -
+// instanced meshes in the full vertex format (VertexFormatFull)
+#define INSTANCED 1
+#define QUANTIZED_POSITIONS 0
+#define VERTEX_COLOR 1
+#include "VertexShader.hlsl"
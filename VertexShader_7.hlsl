@@ -0,0 +1,7 @@
+// VertexShader.hlsl, permutation 0x7 (INSTANCED, QUANTIZED_POSITIONS,
+// VERTEX_COLOR) - instanced meshes in the quantized vertex format
+// with colors (VertexFormatQuantizedColor and VertexFormatQuantizedColorUV)
+#define INSTANCED 1
+#define QUANTIZED_POSITIONS 1
+#define VERTEX_COLOR 1
+#include "VertexShader.hlsl"